@@ -46,7 +46,7 @@ void usage()
 int main(int argc, char **argv)
 {
 	int x, y, z, ok, radialon, isotropic, sum;
-	irtkRealImage input, inputA, inputB, outputA, outputB;
+	irtkRealImage input, inputA, outputA, outputB;
 	bool clearSlices = false;
 
 	if (argc < 3) {
@@ -188,39 +188,25 @@ int main(int argc, char **argv)
 
 	// Threshold image
 	inputA = input;
-	inputB = input;
 	for (z = 0; z < input.GetZ(); z++) {
 		for (y = 0; y < input.GetY(); y++) {
 			for (x = 0; x < input.GetX(); x++) {
 				if (input(x, y, z) > 0.5) {
 					inputA(x, y, z) = 1;
-					inputB(x, y, z) = 0;
 				} else {
 					inputA(x, y, z) = 0;
-					inputB(x, y, z) = 1;
 				}
 			}
 		}
 	}
 
-	// Calculate EDT
+	// Calculate signed EDT, positive outside and negative inside
 	cout << "Finding Euclidean distance transform." << endl;
-	cout << "Doing outside DT" << endl;
+	cout << "Doing outside and inside DT" << endl;
+	edt->SetSigned(true);
 	edt->SetInput (& inputA);
 	edt->SetOutput(&outputA);
 	edt->Run();
-	cout << "Doing inside DT" << endl;
-	edt->SetInput (& inputB);
-	edt->SetOutput(&outputB);
-	edt->Run();
-
-	for (z = 0; z < input.GetZ(); z++) {
-		for (y = 0; y < input.GetY(); y++) {
-			for (x = 0; x < input.GetX(); x++) {
-				outputA(x, y, z)  = sqrt(outputA(x, y, z)) - sqrt(outputB(x, y, z));
-			}
-		}
-	}
 
 
 	if (clearSlices){
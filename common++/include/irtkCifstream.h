@@ -25,6 +25,7 @@ See LICENSE for details
  *
  * This class defines and implements functions for reading compressed file
  * streams. The file streams can be either uncompressed or compressed.
+ * Blocked gzip files written by irtkCofstream are decompressed in parallel.
  */
 
 class irtkCifstream : public irtkObject
@@ -42,6 +43,38 @@ class irtkCifstream : public irtkObject
   long _pos;
 #endif
 
+#ifdef HAS_ZLIB
+  /// File pointer to blocked gzip file (NULL if file is not blocked)
+  FILE *_blockedFile;
+
+  /// Number of gzip members of blocked gzip file
+  int _blocks;
+
+  /// Start of gzip members in file
+  long *_blockStart;
+
+  /// Start of gzip members in uncompressed data
+  long *_dataStart;
+
+  /// Uncompressed data of most recently read gzip member
+  char *_blockCache;
+
+  /// Index of gzip member in cache (-1 if none)
+  int _cachedBlock;
+
+  /// Current position in uncompressed data of blocked gzip file
+  long _blockedPos;
+
+  /// Open file if it is a blocked gzip file written by irtkCofstream
+  bool OpenBlocked(const char *);
+
+  /// Close blocked gzip file
+  void CloseBlocked();
+
+  /// Read data of blocked gzip file, decompressing gzip members in parallel
+  void ReadBlocked(char *, long, long);
+#endif
+
 protected:
 
   /// Flag whether file is swapped
@@ -108,6 +141,9 @@ public:
 inline void irtkCifstream::Open(const char *filename)
 {
 #ifdef HAS_ZLIB
+  // Blocked gzip files are read without zlib's gzFile interface
+  if (this->OpenBlocked(filename) == true) return;
+
   _file = gzopen(filename, "rb");
 #else
   _file = fopen(filename, "rb");
@@ -130,6 +166,9 @@ inline void irtkCifstream::Open(const char *filename)
 
 inline void irtkCifstream::Close()
 {
+#ifdef HAS_ZLIB
+  this->CloseBlocked();
+#endif
   if (_file != NULL) {
 #ifdef HAS_ZLIB
     gzclose(_file);
@@ -156,6 +195,7 @@ inline void irtkCifstream::IsSwapped(int swapped)
 inline long irtkCifstream::Tell()
 {
 #ifdef HAS_ZLIB
+  if (_blockedFile != NULL) return _blockedPos;
   return gztell(_file);
 #else
   return ftell(_file);
@@ -165,6 +205,10 @@ inline long irtkCifstream::Tell()
 inline void irtkCifstream::Seek(long offset)
 {
 #ifdef HAS_ZLIB
+  if (_blockedFile != NULL) {
+    _blockedPos = offset;
+    return;
+  }
   gzseek(_file, offset, SEEK_SET);
 #else
   fseek(_file, offset, SEEK_SET);
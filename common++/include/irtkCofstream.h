@@ -22,8 +22,10 @@ See LICENSE for details
  * Class for writing compressed file streams.
  *
  * This class defines and implements functions for writing compressed file
- * streams. At the moment only the writing of uncompressed file streams is
- * supported.
+ * streams. Files whose name contains .gz are written as blocked gzip files:
+ * the data is split into blocks of IRTK_GZIP_BLOCK_SIZE bytes which are
+ * compressed in parallel into independent gzip members. The result is a valid
+ * gzip file which irtkCifstream can decompress in parallel.
  */
 
 #include "irtkException.h"
@@ -36,7 +38,25 @@ class irtkCofstream : public irtkObject
 
 #ifdef HAS_ZLIB
   /// File pointer to compressed file
-  gzFile _compressedFile;
+  FILE *_compressedFile;
+
+  /// Uncompressed data which has not been written yet
+  char *_buffer;
+
+  /// Number of bytes in buffer
+  long _bufferLength;
+
+  /// Allocated size of buffer
+  long _bufferSize;
+
+  /// Start of buffer in uncompressed data
+  long _bufferStart;
+
+  /// Current position in uncompressed data
+  long _pos;
+
+  /// Compress and write buffered blocks (including incomplete last block if true)
+  void Flush(bool);
 #endif
 
 protected:
@@ -139,7 +159,10 @@ inline void irtkCofstream::Open(const char *filename)
   } else {
 #ifdef HAS_ZLIB
     _compressed = true;
-    _compressedFile = gzopen(filename, "wb");
+    _compressedFile = fopen(filename, "wb");
+    _bufferLength = 0;
+    _bufferStart = 0;
+    _pos = 0;
 
     // Check whether file was opened successful
     if (_compressedFile == NULL) {
@@ -165,7 +188,8 @@ inline void irtkCofstream::Close()
 {
 #ifdef HAS_ZLIB
   if (_compressedFile != NULL) {
-    gzclose(_compressedFile);
+    this->Flush(true);
+    fclose(_compressedFile);
     _compressedFile = NULL;
   }
 #endif
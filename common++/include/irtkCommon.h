@@ -78,6 +78,19 @@ extern int   ReadCompressed(gzFile, char *, long, long);
 extern int   ReadCompressed(FILE *, char *, long, long);
 #endif
 
+#ifdef HAS_ZLIB
+// Blocked gzip files (see gzipblock.cc)
+#define IRTK_GZIP_BLOCK_SIZE    1048576
+#define IRTK_GZIP_BLOCK_HEADER  20
+#define IRTK_GZIP_BLOCK_TRAILER 8
+
+extern long GzipBlockBound(long);
+extern long GzipBlockCompress(const char *, long, char *, int = Z_DEFAULT_COMPRESSION);
+extern long GzipBlockSize(const char *);
+extern long GzipBlockLength(const char *);
+extern bool GzipBlockDecompress(const char *, long, char *, long);
+#endif
+
 #define round round2
 
 inline int round(double x)
@@ -112,6 +125,7 @@ extern double weightedmedian(int, double,double, float*, float*);
 #include <irtkObject.h>
 #include <irtkCifstream.h>
 #include <irtkCofstream.h>
+#include <irtkMemoryMappedFile.h>
 #include <irtkAllocate.h>
 #include <irtkDeallocate.h>
 #include <irtkException.h>
@@ -67,4 +67,15 @@ template <class Type> inline Type ****Deallocate(Type ****matrix)
   return NULL;
 }
 
+/// Deallocate 4-dimensional array of pointers into memory which is not owned
+template <class Type> inline Type ****DeallocatePointers(Type ****matrix)
+{
+  delete []matrix[0][0];
+  delete []matrix[0];
+  delete []matrix;
+
+  matrix = NULL;
+  return NULL;
+}
+
 #endif
@@ -0,0 +1,112 @@
+/*=========================================================================
+
+  Library   : Image Registration Toolkit (IRTK)
+  Module    : $Id$
+  Copyright : Imperial College, Department of Computing
+              Visual Information Processing (VIP), 2008 onwards
+  Date      : $Date$
+  Version   : $Revision$
+  Changes   : $Author$
+
+Copyright (c) 1999-2014 and onwards, Imperial College London
+All rights reserved.
+See LICENSE for details
+
+=========================================================================*/
+
+#ifndef _IRTKMEMORYMAPPEDFILE_H
+
+#define _IRTKMEMORYMAPPEDFILE_H
+
+/// Modes for mapping files into memory
+typedef enum { MemoryMap_None, MemoryMap_ReadOnly, MemoryMap_CopyOnWrite, MemoryMap_ReadWrite } irtkMemoryMapMode;
+
+/**
+ * Class for memory mapped files.
+ *
+ * This class maps a whole file into the address space of the process. In
+ * read-only mode the mapped pages are shared with the page cache and must
+ * not be modified. In copy-on-write mode the pages can be modified, but the
+ * changes are private to the process and never written back to the file.
+ * In read-write mode changes are written back to the file, so the pages can
+ * be released from memory and are paged in again from the file when they
+ * are accessed. Compressed files cannot be mapped. Memory mapping is not
+ * available on Windows.
+ */
+
+class irtkMemoryMappedFile : public irtkObject
+{
+
+  /// Start of mapped memory
+  char *_data;
+
+  /// Length of mapped memory
+  long _length;
+
+  /// Mode of mapping
+  irtkMemoryMapMode _mode;
+
+public:
+
+  /// Constructor
+  irtkMemoryMappedFile();
+
+  /// Destructor
+  ~irtkMemoryMappedFile();
+
+  /// Map file into memory. Returns false if the file cannot be mapped
+  bool Open(const char *, irtkMemoryMapMode = MemoryMap_CopyOnWrite);
+
+  /** Map part of file with given offset and length into memory. The offset
+   *  must be a multiple of the page size. Returns false if the file cannot be
+   *  mapped
+   */
+  bool Open(const char *, irtkMemoryMapMode, long, long);
+
+  /// Unmap file
+  void Close();
+
+  /// Returns pointer to mapped memory at given offset from start of file
+  char *GetPointer(long = 0) const;
+
+  /// Returns size of mapped file
+  long GetSize() const;
+
+  /// Returns mode of mapping
+  irtkMemoryMapMode GetMode() const;
+
+  /** Release mapped pages from memory. They are paged in again from the file
+   *  when accessed. Has no effect for copy-on-write mappings
+   */
+  void Release();
+
+  /// Create file of given size or resize existing file. Returns false on failure
+  static bool Create(const char *, long);
+
+  /// Returns size of memory pages
+  static long GetPageSize();
+
+  /// Returns whether memory mapping is supported on this platform
+  static bool IsSupported();
+
+  /// Returns whether file is gzip or UNIX compressed
+  static bool IsCompressed(const char *);
+
+};
+
+inline char *irtkMemoryMappedFile::GetPointer(long offset) const
+{
+  return _data + offset;
+}
+
+inline long irtkMemoryMappedFile::GetSize() const
+{
+  return _length;
+}
+
+inline irtkMemoryMapMode irtkMemoryMappedFile::GetMode() const
+{
+  return _mode;
+}
+
+#endif
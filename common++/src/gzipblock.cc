@@ -0,0 +1,124 @@
+/*=========================================================================
+
+  Library   : Image Registration Toolkit (IRTK)
+  Module    : $Id$
+  Copyright : Imperial College, Department of Computing
+              Visual Information Processing (VIP), 2008 onwards
+  Date      : $Date$
+  Version   : $Revision$
+  Changes   : $Author$
+
+Copyright (c) 1999-2014 and onwards, Imperial College London
+All rights reserved.
+See LICENSE for details
+
+=========================================================================*/
+
+#include <irtkCommon.h>
+
+#ifdef HAS_ZLIB
+
+// Blocked gzip files are a concatenation of independent gzip members, each
+// holding up to IRTK_GZIP_BLOCK_SIZE bytes of uncompressed data. Every member
+// header has an extra field with subfield 'IR' which stores the compressed
+// size of the member. Since concatenated members are valid gzip files, these
+// files can be read by gzip, zcat and zlib, while irtkCifstream uses the
+// member sizes to decompress the members in parallel.
+
+static void PutUInt32(unsigned char *p, unsigned long v)
+{
+  p[0] = v & 0xff;
+  p[1] = (v >> 8) & 0xff;
+  p[2] = (v >> 16) & 0xff;
+  p[3] = (v >> 24) & 0xff;
+}
+
+static unsigned long GetUInt32(const unsigned char *p)
+{
+  return (unsigned long)p[0] | ((unsigned long)p[1] << 8) | ((unsigned long)p[2] << 16) | ((unsigned long)p[3] << 24);
+}
+
+long GzipBlockBound(long length)
+{
+  return compressBound(length) + IRTK_GZIP_BLOCK_HEADER + IRTK_GZIP_BLOCK_TRAILER;
+}
+
+long GzipBlockCompress(const char *data, long length, char *out, int level)
+{
+  z_stream strm;
+  unsigned char *p = reinterpret_cast<unsigned char *>(out);
+  long size;
+
+  // Compress raw deflate stream behind header
+  memset(&strm, 0, sizeof(strm));
+  if (deflateInit2(&strm, level, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK) return 0;
+  strm.next_in   = (Bytef *)data;
+  strm.avail_in  = length;
+  strm.next_out  = p + IRTK_GZIP_BLOCK_HEADER;
+  strm.avail_out = GzipBlockBound(length) - IRTK_GZIP_BLOCK_HEADER - IRTK_GZIP_BLOCK_TRAILER;
+  if (deflate(&strm, Z_FINISH) != Z_STREAM_END) {
+    deflateEnd(&strm);
+    return 0;
+  }
+  size = IRTK_GZIP_BLOCK_HEADER + strm.total_out + IRTK_GZIP_BLOCK_TRAILER;
+  deflateEnd(&strm);
+
+  // Header with extra field holding the member size
+  p[0]  = 0x1f;
+  p[1]  = 0x8b;
+  p[2]  = Z_DEFLATED;
+  p[3]  = 4;    // FEXTRA
+  PutUInt32(p + 4, 0);
+  p[8]  = 0;
+  p[9]  = 255;  // Unknown OS
+  p[10] = 8;    // XLEN
+  p[11] = 0;
+  p[12] = 'I';
+  p[13] = 'R';
+  p[14] = 4;    // LEN
+  p[15] = 0;
+  PutUInt32(p + 16, size);
+
+  // Trailer
+  PutUInt32(p + size - 8, crc32(crc32(0L, Z_NULL, 0), (const Bytef *)data, length));
+  PutUInt32(p + size - 4, length);
+
+  return size;
+}
+
+long GzipBlockSize(const char *header)
+{
+  const unsigned char *p = reinterpret_cast<const unsigned char *>(header);
+
+  if ((p[0] != 0x1f) || (p[1] != 0x8b) || (p[2] != Z_DEFLATED) || (p[3] != 4)) return 0;
+  if ((p[10] != 8) || (p[11] != 0) || (p[12] != 'I') || (p[13] != 'R') || (p[14] != 4) || (p[15] != 0)) return 0;
+  return GetUInt32(p + 16);
+}
+
+long GzipBlockLength(const char *trailer)
+{
+  return GetUInt32(reinterpret_cast<const unsigned char *>(trailer) + 4);
+}
+
+bool GzipBlockDecompress(const char *block, long size, char *out, long length)
+{
+  z_stream strm;
+  bool ok;
+
+  memset(&strm, 0, sizeof(strm));
+  if (inflateInit2(&strm, -MAX_WBITS) != Z_OK) return false;
+  strm.next_in   = (Bytef *)(block + IRTK_GZIP_BLOCK_HEADER);
+  strm.avail_in  = size - IRTK_GZIP_BLOCK_HEADER - IRTK_GZIP_BLOCK_TRAILER;
+  strm.next_out  = (Bytef *)out;
+  strm.avail_out = length;
+  ok = (inflate(&strm, Z_FINISH) == Z_STREAM_END) && ((long)strm.total_out == length);
+  inflateEnd(&strm);
+
+  // Check CRC
+  if (ok == true) {
+    ok = (crc32(crc32(0L, Z_NULL, 0), (const Bytef *)out, length) == GetUInt32(reinterpret_cast<const unsigned char *>(block) + size - 8));
+  }
+  return ok;
+}
+
+#endif
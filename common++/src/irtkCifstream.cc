@@ -16,9 +16,81 @@ See LICENSE for details
 
 #include <irtkCommon.h>
 
+#ifdef HAS_ZLIB
+
+class irtkMultiThreadedGzipBlockDecompression
+{
+
+  /// Compressed gzip members, starting with the first member to decompress
+  const char *_compressed;
+
+  /// Index of first member to decompress
+  int _first;
+
+  /// Start of gzip members in file and in uncompressed data
+  const long *_blockStart, *_dataStart;
+
+  /// Output data
+  char *_data;
+
+  /// Range of uncompressed data to read
+  long _start, _length;
+
+  /// Whether members were decompressed successfully
+  bool *_ok;
+
+public:
+
+  irtkMultiThreadedGzipBlockDecompression(const char *compressed, int first, const long *blockStart, const long *dataStart, char *data, long start, long length, bool *ok) {
+    _compressed = compressed;
+    _first = first;
+    _blockStart = blockStart;
+    _dataStart = dataStart;
+    _data = data;
+    _start = start;
+    _length = length;
+    _ok = ok;
+  }
+
+  void operator()(const blocked_range<int> &r) const {
+    int b;
+    long begin, end, from, to;
+    char *tmp;
+
+    for (b = r.begin(); b != r.end(); b++) {
+      const char *block = _compressed + (_blockStart[b] - _blockStart[_first]);
+      begin = _dataStart[b];
+      end   = _dataStart[b+1];
+      if ((begin >= _start) && (end <= _start + _length)) {
+        // Decompress member directly into output
+        _ok[b - _first] = GzipBlockDecompress(block, _blockStart[b+1] - _blockStart[b], _data + (begin - _start), end - begin);
+      } else {
+        // Decompress partially read member
+        tmp = new char[end - begin];
+        _ok[b - _first] = GzipBlockDecompress(block, _blockStart[b+1] - _blockStart[b], tmp, end - begin);
+        from = max(begin, _start);
+        to   = min(end, _start + _length);
+        memcpy(_data + (from - _start), tmp + (from - begin), to - from);
+        delete []tmp;
+      }
+    }
+  }
+};
+
+#endif
+
 irtkCifstream::irtkCifstream()
 {
   _file = NULL;
+#ifdef HAS_ZLIB
+  _blockedFile = NULL;
+  _blocks = 0;
+  _blockStart = NULL;
+  _dataStart = NULL;
+  _blockCache = NULL;
+  _cachedBlock = -1;
+  _blockedPos = 0;
+#endif
 #ifndef WORDS_BIGENDIAN
   _swapped = true;
 #else
@@ -34,8 +106,168 @@ irtkCifstream::~irtkCifstream()
   this->Close();
 }
 
+#ifdef HAS_ZLIB
+
+bool irtkCifstream::OpenBlocked(const char *filename)
+{
+  char header[IRTK_GZIP_BLOCK_HEADER], trailer[IRTK_GZIP_BLOCK_TRAILER];
+  long offset, size, n, capacity;
+  long *blockStart, *dataStart;
+  FILE *fp;
+
+  fp = fopen(filename, "rb");
+  if (fp == NULL) return false;
+
+  // Index gzip members using the member sizes stored in their headers
+  capacity   = 64;
+  blockStart = new long[capacity+1];
+  dataStart  = new long[capacity+1];
+  blockStart[0] = 0;
+  dataStart[0]  = 0;
+  offset = 0;
+  n = 0;
+  while ((size = fread(header, 1, IRTK_GZIP_BLOCK_HEADER, fp)) > 0) {
+    if (size == IRTK_GZIP_BLOCK_HEADER) {
+      size = GzipBlockSize(header);
+    } else {
+      size = 0;
+    }
+    // Not a blocked gzip file or truncated member
+    if ((size < IRTK_GZIP_BLOCK_HEADER + IRTK_GZIP_BLOCK_TRAILER) ||
+        (fseek(fp, offset + size - IRTK_GZIP_BLOCK_TRAILER, SEEK_SET) != 0) ||
+        (fread(trailer, 1, IRTK_GZIP_BLOCK_TRAILER, fp) != IRTK_GZIP_BLOCK_TRAILER)) {
+      n = 0;
+      break;
+    }
+    if (n == capacity) {
+      long *tmp;
+      tmp = new long[2*capacity+1];
+      memcpy(tmp, blockStart, (capacity+1) * sizeof(long));
+      delete []blockStart;
+      blockStart = tmp;
+      tmp = new long[2*capacity+1];
+      memcpy(tmp, dataStart, (capacity+1) * sizeof(long));
+      delete []dataStart;
+      dataStart = tmp;
+      capacity *= 2;
+    }
+    offset += size;
+    n++;
+    blockStart[n] = offset;
+    dataStart[n]  = dataStart[n-1] + GzipBlockLength(trailer);
+  }
+
+  if (n == 0) {
+    delete []blockStart;
+    delete []dataStart;
+    fclose(fp);
+    return false;
+  }
+
+  _blockedFile = fp;
+  _blocks      = n;
+  _blockStart  = blockStart;
+  _dataStart   = dataStart;
+  _cachedBlock = -1;
+  _blockedPos  = 0;
+
+  return true;
+}
+
+void irtkCifstream::CloseBlocked()
+{
+  if (_blockedFile != NULL) {
+    fclose(_blockedFile);
+    _blockedFile = NULL;
+  }
+  delete []_blockStart;
+  delete []_dataStart;
+  delete []_blockCache;
+  _blockStart  = NULL;
+  _dataStart   = NULL;
+  _blockCache  = NULL;
+  _blocks      = 0;
+  _cachedBlock = -1;
+  _blockedPos  = 0;
+}
+
+void irtkCifstream::ReadBlocked(char *mem, long start, long num)
+{
+  int first, last;
+  bool ok;
+
+  if (start == -1) start = _blockedPos;
+
+  // Like gzread, do not read beyond end of data
+  if (start + num > _dataStart[_blocks]) num = _dataStart[_blocks] - start;
+  if (num <= 0) return;
+  _blockedPos = start + num;
+
+  // Find gzip members which hold the data
+  first = upper_bound(_dataStart, _dataStart + _blocks + 1, start) - _dataStart - 1;
+  last  = upper_bound(_dataStart, _dataStart + _blocks + 1, start + num - 1) - _dataStart - 1;
+
+  if ((first == last) && (num < _dataStart[first+1] - _dataStart[first])) {
+    // Small reads, e.g. of headers, are served from the cached member
+    if (_cachedBlock != first) {
+      char *block = new char[_blockStart[first+1] - _blockStart[first]];
+      delete []_blockCache;
+      _blockCache = new char[_dataStart[first+1] - _dataStart[first]];
+      fseek(_blockedFile, _blockStart[first], SEEK_SET);
+      ok = (fread(block, _blockStart[first+1] - _blockStart[first], 1, _blockedFile) == 1) &&
+           GzipBlockDecompress(block, _blockStart[first+1] - _blockStart[first], _blockCache, _dataStart[first+1] - _dataStart[first]);
+      delete []block;
+      if (ok == false) {
+        _cachedBlock = -1;
+        stringstream msg;
+        msg << "cifstream::Read: Corrupt gzip member " << first << endl;
+        cerr << msg.str();
+        throw irtkException( msg.str(),
+                             __FILE__,
+                             __LINE__ );
+      }
+      _cachedBlock = first;
+    }
+    memcpy(mem, _blockCache + (start - _dataStart[first]), num);
+    return;
+  }
+
+  // Read all compressed members at once and decompress them in parallel
+  char *compressed = new char[_blockStart[last+1] - _blockStart[first]];
+  bool *status     = new bool[last - first + 1];
+  fseek(_blockedFile, _blockStart[first], SEEK_SET);
+  ok = (fread(compressed, _blockStart[last+1] - _blockStart[first], 1, _blockedFile) == 1);
+  if (ok == true) {
+    irtkMultiThreadedGzipBlockDecompression body(compressed, first, _blockStart, _dataStart, mem, start, num, status);
+    task_scheduler_init init(tbb_no_threads);
+    parallel_for(blocked_range<int>(first, last + 1), body);
+    init.terminate();
+    for (int b = 0; b <= last - first; b++) ok = ok && status[b];
+  }
+  delete []compressed;
+  delete []status;
+
+  if (ok == false) {
+    stringstream msg;
+    msg << "cifstream::Read: Corrupt gzip member in blocked gzip file" << endl;
+    cerr << msg.str();
+    throw irtkException( msg.str(),
+                         __FILE__,
+                         __LINE__ );
+  }
+}
+
+#endif
+
 void irtkCifstream::Read(char *mem, long start, long num)
 {
+#ifdef HAS_ZLIB
+  if (_blockedFile != NULL) {
+    this->ReadBlocked(mem, start, num);
+    return;
+  }
+#endif
+
   // Read data uncompressed
 #ifdef ENABLE_UNIX_COMPRESS
   if (start == -1) {
@@ -128,8 +360,18 @@ void irtkCifstream::ReadAsString(char *data, long length, long offset)
 {
   // Read string
 #ifdef HAS_ZLIB
-  if (offset != -1) gzseek(_file, offset, SEEK_SET);
-  gzgets(_file, data, length);
+  if (_blockedFile != NULL) {
+    long i = 0;
+    if (offset != -1) _blockedPos = offset;
+    while ((i < length - 1) && (_blockedPos < _dataStart[_blocks])) {
+      this->ReadBlocked(data + i, -1, 1);
+      if (data[i++] == '\n') break;
+    }
+    data[i] = '\0';
+  } else {
+    if (offset != -1) gzseek(_file, offset, SEEK_SET);
+    gzgets(_file, data, length);
+  }
 #else
   if (offset!= -1) fseek(_file, offset, SEEK_SET);
   fgets(data, length, _file);
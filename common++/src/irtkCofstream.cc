@@ -16,6 +16,49 @@ See LICENSE for details
 
 #include <irtkCommon.h>
 
+#ifdef HAS_ZLIB
+
+/// Amount of buffered data which is compressed at once
+#define IRTK_GZIP_FLUSH_SIZE (64 * IRTK_GZIP_BLOCK_SIZE)
+
+class irtkMultiThreadedGzipBlockCompression
+{
+
+  /// Uncompressed data
+  const char *_data;
+
+  /// Length of uncompressed data
+  long _length;
+
+  /// Compressed gzip members
+  char **_block;
+
+  /// Size of compressed gzip members
+  long *_size;
+
+public:
+
+  irtkMultiThreadedGzipBlockCompression(const char *data, long length, char **block, long *size) {
+    _data = data;
+    _length = length;
+    _block = block;
+    _size = size;
+  }
+
+  void operator()(const blocked_range<int> &r) const {
+    int i;
+    long length;
+
+    for (i = r.begin(); i != r.end(); i++) {
+      length = min(static_cast<long>(IRTK_GZIP_BLOCK_SIZE), _length - i * static_cast<long>(IRTK_GZIP_BLOCK_SIZE));
+      _block[i] = new char[GzipBlockBound(length)];
+      _size[i] = GzipBlockCompress(_data + i * static_cast<long>(IRTK_GZIP_BLOCK_SIZE), length, _block[i]);
+    }
+  }
+};
+
+#endif
+
 irtkCofstream::irtkCofstream()
 {
 #ifndef WORDS_BIGENDIAN
@@ -26,6 +69,11 @@ irtkCofstream::irtkCofstream()
 
 #ifdef HAS_ZLIB
   _compressedFile = NULL;
+  _buffer = NULL;
+  _bufferLength = 0;
+  _bufferSize = 0;
+  _bufferStart = 0;
+  _pos = 0;
 #endif
   _uncompressedFile = NULL;
 }
@@ -33,8 +81,66 @@ irtkCofstream::irtkCofstream()
 irtkCofstream::~irtkCofstream()
 {
   this->Close();
+#ifdef HAS_ZLIB
+  free(_buffer);
+#endif
 }
 
+#ifdef HAS_ZLIB
+
+void irtkCofstream::Flush(bool all)
+{
+  int i, n;
+  long length;
+  char **block;
+  long *size;
+  bool ok;
+
+  // Number of blocks to write
+  if (all == true) {
+    n = (_bufferLength + IRTK_GZIP_BLOCK_SIZE - 1) / IRTK_GZIP_BLOCK_SIZE;
+    // An empty file consists of a single empty member
+    if ((n == 0) && (_bufferStart == 0)) n = 1;
+  } else {
+    n = _bufferLength / IRTK_GZIP_BLOCK_SIZE;
+  }
+  if (n == 0) return;
+  length = min(_bufferLength, n * static_cast<long>(IRTK_GZIP_BLOCK_SIZE));
+
+  // Compress blocks in parallel
+  block = new char *[n];
+  size  = new long[n];
+  irtkMultiThreadedGzipBlockCompression body(_buffer, length, block, size);
+  task_scheduler_init init(tbb_no_threads);
+  parallel_for(blocked_range<int>(0, n), body);
+  init.terminate();
+
+  // Write gzip members in order
+  ok = true;
+  for (i = 0; i < n; i++) {
+    if ((size[i] == 0) || (fwrite(block[i], size[i], 1, _compressedFile) != 1)) ok = false;
+    delete []block[i];
+  }
+  delete []block;
+  delete []size;
+
+  if (ok == false) {
+    stringstream msg;
+    msg << "cofstream::Flush: Can't write compressed data" << endl;
+    cerr << msg.str();
+    throw irtkException( msg.str(),
+                         __FILE__,
+                         __LINE__ );
+  }
+
+  // Keep remaining data
+  memmove(_buffer, _buffer + length, _bufferLength - length);
+  _bufferLength -= length;
+  _bufferStart  += length;
+}
+
+#endif
+
 void irtkCofstream::Write(char *data, long offset, long length)
 {
   if (_compressed == false) {
@@ -42,18 +148,48 @@ void irtkCofstream::Write(char *data, long offset, long length)
     fwrite(data, length, 1, _uncompressedFile);
   } else {
 #ifdef HAS_ZLIB
+    long n, end;
+
     if (offset != -1) {
-      if (gztell(_compressedFile) > offset) {
+      // Data which has been compressed already cannot be overwritten
+      if (_bufferStart > offset) {
           stringstream msg;
-          msg << "Warning, writing compressed files only supports forward seek" << gztell(_compressedFile) << " " << offset << endl;
+          msg << "Warning, writing compressed files only supports forward seek" << _bufferStart << " " << offset << endl;
           cerr << msg.str();
           throw irtkException( msg.str(),
                                __FILE__,
                                __LINE__ );
       }
-      gzseek(_compressedFile, offset, SEEK_SET);
+      _pos = offset;
     }
-    gzwrite(_compressedFile, data, length);
+
+    // Buffer data and compress it in chunks to bound the buffer size
+    do {
+      n   = min(length, static_cast<long>(IRTK_GZIP_FLUSH_SIZE));
+      end = _pos - _bufferStart + n;
+      if (end > _bufferSize) {
+        _bufferSize = max(end, 2 * _bufferSize);
+        _buffer = static_cast<char *>(realloc(_buffer, _bufferSize));
+        if (_buffer == NULL) {
+          stringstream msg;
+          msg << "cofstream::Write: Can't allocate buffer of " << _bufferSize << " bytes" << endl;
+          cerr << msg.str();
+          throw irtkException( msg.str(),
+                               __FILE__,
+                               __LINE__ );
+        }
+      }
+      // Like gzseek, fill gaps with zeros
+      if (_pos - _bufferStart > _bufferLength) {
+        memset(_buffer + _bufferLength, 0, _pos - _bufferStart - _bufferLength);
+      }
+      memcpy(_buffer + (_pos - _bufferStart), data, n);
+      if (end > _bufferLength) _bufferLength = end;
+      _pos   += n;
+      data   += n;
+      length -= n;
+      if (_bufferLength >= IRTK_GZIP_FLUSH_SIZE) this->Flush(false);
+    } while (length > 0);
 #endif
   }
 }
@@ -199,8 +335,7 @@ void irtkCofstream::WriteAsString(char *data, long offset)
     fputs(data, _uncompressedFile);
   } else {
 #ifdef HAS_ZLIB
-    if (offset != -1) gzseek(_compressedFile, offset, SEEK_SET);
-    gzputs(_compressedFile, data);
+    this->Write(data, offset, strlen(data));
 #endif
   }
 }
@@ -0,0 +1,202 @@
+/*=========================================================================
+
+  Library   : Image Registration Toolkit (IRTK)
+  Module    : $Id$
+  Copyright : Imperial College, Department of Computing
+              Visual Information Processing (VIP), 2008 onwards
+  Date      : $Date$
+  Version   : $Revision$
+  Changes   : $Author$
+
+Copyright (c) 1999-2014 and onwards, Imperial College London
+All rights reserved.
+See LICENSE for details
+
+=========================================================================*/
+
+#include <irtkCommon.h>
+
+#ifndef WIN32
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+irtkMemoryMappedFile::irtkMemoryMappedFile()
+{
+  _data   = NULL;
+  _length = 0;
+  _mode   = MemoryMap_None;
+}
+
+irtkMemoryMappedFile::~irtkMemoryMappedFile()
+{
+  this->Close();
+}
+
+bool irtkMemoryMappedFile::IsSupported()
+{
+#ifndef WIN32
+  return true;
+#else
+  return false;
+#endif
+}
+
+bool irtkMemoryMappedFile::IsCompressed(const char *filename)
+{
+  unsigned char magic[2];
+  FILE *fp;
+
+  fp = fopen(filename, "rb");
+  if (fp == NULL) return false;
+  if (fread(magic, 1, 2, fp) != 2) {
+    fclose(fp);
+    return false;
+  }
+  fclose(fp);
+
+  // Check for gzip (1f 8b) and UNIX compress (1f 9d) magic numbers
+  return (magic[0] == 0x1f) && ((magic[1] == 0x8b) || (magic[1] == 0x9d));
+}
+
+#ifndef WIN32
+static void *irtkMemoryMappedFile_Map(int fd, irtkMemoryMapMode mode, long offset, long length)
+{
+  int prot, flags;
+
+  if (mode == MemoryMap_ReadOnly) {
+    prot  = PROT_READ;
+    flags = MAP_SHARED;
+  } else if (mode == MemoryMap_ReadWrite) {
+    prot  = PROT_READ | PROT_WRITE;
+    flags = MAP_SHARED;
+  } else {
+    prot  = PROT_READ | PROT_WRITE;
+    flags = MAP_PRIVATE;
+  }
+
+  return mmap(NULL, length, prot, flags, fd, offset);
+}
+#endif
+
+bool irtkMemoryMappedFile::Open(const char *filename, irtkMemoryMapMode mode)
+{
+  // Unmap previous file
+  this->Close();
+
+  if (mode == MemoryMap_None) return false;
+
+#ifndef WIN32
+  int fd;
+  void *data;
+  struct stat buf;
+  unsigned char magic[2];
+
+  fd = open(filename, (mode == MemoryMap_ReadWrite) ? O_RDWR : O_RDONLY);
+  if (fd == -1) return false;
+
+  // Size and magic number are taken from the opened file, which is the one being mapped
+  if ((fstat(fd, &buf) != 0) || (buf.st_size == 0)) {
+    close(fd);
+    return false;
+  }
+
+  // Compressed files have to be decompressed when read
+  if ((pread(fd, magic, 2, 0) == 2) && (magic[0] == 0x1f) && ((magic[1] == 0x8b) || (magic[1] == 0x9d))) {
+    close(fd);
+    return false;
+  }
+
+  data = irtkMemoryMappedFile_Map(fd, mode, 0, buf.st_size);
+
+  // The mapping stays valid after the file descriptor is closed
+  close(fd);
+
+  if (data == MAP_FAILED) return false;
+
+  _data   = static_cast<char *>(data);
+  _length = buf.st_size;
+  _mode   = mode;
+
+  return true;
+#else
+  return false;
+#endif
+}
+
+bool irtkMemoryMappedFile::Open(const char *filename, irtkMemoryMapMode mode, long offset, long length)
+{
+  // Unmap previous file
+  this->Close();
+
+  if ((mode == MemoryMap_None) || (length <= 0)) return false;
+
+#ifndef WIN32
+  int fd;
+  void *data;
+
+  fd = open(filename, (mode == MemoryMap_ReadWrite) ? O_RDWR : O_RDONLY);
+  if (fd == -1) return false;
+
+  data = irtkMemoryMappedFile_Map(fd, mode, offset, length);
+
+  // The mapping stays valid after the file descriptor is closed
+  close(fd);
+
+  if (data == MAP_FAILED) return false;
+
+  _data   = static_cast<char *>(data);
+  _length = length;
+  _mode   = mode;
+
+  return true;
+#else
+  return false;
+#endif
+}
+
+void irtkMemoryMappedFile::Close()
+{
+#ifndef WIN32
+  if (_data != NULL) munmap(_data, _length);
+#endif
+  _data   = NULL;
+  _length = 0;
+  _mode   = MemoryMap_None;
+}
+
+void irtkMemoryMappedFile::Release()
+{
+#ifndef WIN32
+  // Private changes of copy-on-write mappings would be lost
+  if ((_data != NULL) && (_mode != MemoryMap_CopyOnWrite)) madvise(_data, _length, MADV_DONTNEED);
+#endif
+}
+
+bool irtkMemoryMappedFile::Create(const char *filename, long length)
+{
+#ifndef WIN32
+  int fd;
+  bool ok;
+
+  fd = open(filename, O_RDWR | O_CREAT, 0600);
+  if (fd == -1) return false;
+  ok = (ftruncate(fd, length) == 0);
+  close(fd);
+  return ok;
+#else
+  return false;
+#endif
+}
+
+long irtkMemoryMappedFile::GetPageSize()
+{
+#ifndef WIN32
+  return sysconf(_SC_PAGESIZE);
+#else
+  return 4096;
+#endif
+}
@@ -30,8 +30,8 @@ See LICENSE for details
 
 #include <irtkImageToImage.h>
 
-/// In the 2D case, a flip may be necessary so that the singleton dimension
-/// is the z-direction. This makes processing easier.
+/// In the 2D case, the axes of the image are permuted so that the singleton
+/// dimension is the z-direction. This makes processing easier.
 typedef enum { irtkFlipNone, irtkFlipXY,  irtkFlipXZ,  irtkFlipYZ} irtkFlipType;
 
 template <class VoxelType> class irtkCityBlockDistanceTransform : public irtkImageToImage<VoxelType>
@@ -48,6 +48,9 @@ protected:
 
   irtkFlipType _flipType;
 
+  /// View of the output with the singleton dimension as z-direction (2D case)
+  irtkGenericImageView<VoxelType> _outputView;
+
   /// Returns the name of the class
   virtual const char *NameOfClass();
 
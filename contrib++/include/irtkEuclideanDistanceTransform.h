@@ -22,11 +22,30 @@ See LICENSE for details
 #define EDT_MAX_DISTANCE_SQUARED 2147329548
 #define EDT_MAX_DISTANCE_SQUARED_ANISOTROPIC 2147329548
 
+/// Number of neighbouring columns which are transformed together
+#define EDT_LINES 16
+
 #include <irtkImageToImage.h>
 
+template <class VoxelType> class irtkMultiThreadedEuclideanDistanceTransformPlanes;
+template <class VoxelType> class irtkMultiThreadedEuclideanDistanceTransformColumns;
+
+/**
+ * Class for the exact Euclidean distance transform.
+ *
+ * The output is the squared distance of each voxel to the nearest non-zero
+ * voxel of the input. In signed mode the output is the distance to the
+ * boundary of the non-zero voxels instead, which is positive outside and
+ * negative inside. The transform is separable and the lines of each pass
+ * are processed in parallel.
+ */
+
 template <class VoxelType> class irtkEuclideanDistanceTransform : public irtkImageToImage<VoxelType>
 {
 
+  friend class irtkMultiThreadedEuclideanDistanceTransformPlanes<VoxelType>;
+  friend class irtkMultiThreadedEuclideanDistanceTransformColumns<VoxelType>;
+
 public:
 
   /// 2D or 3D distance transform
@@ -37,8 +56,14 @@ protected:
   /// 2D or 3D distance transform
   irtkDistanceTransformMode _distanceTransformMode;
 
+  /// Signed distance transform
+  bool _Signed;
+
   /// Calculate the Vornoi diagram
-  int edtVornoiEDT(long *, long);
+  int edtVornoiEDT(long *, long, long *, long *);
+
+  /// Calculate the Vornoi diagram for neighbouring columns
+  void edtComputeColumns(long *, long, long, long);
 
   /// Calculate 2D distance transform
   void edtComputeEDT_2D(char *, long *, long, long);
@@ -47,7 +72,10 @@ protected:
   void edtComputeEDT_3D(char *, long *, long, long, long);
 
   /// Calculate the Vornoi diagram for anisotripic voxel sizes
-  int edtVornoiEDT_anisotropic(irtkRealPixel *, long, double);
+  int edtVornoiEDT_anisotropic(irtkRealPixel *, long, double, double *, double *);
+
+  /// Calculate the Vornoi diagram for neighbouring columns for anisotripic voxel sizes
+  void edtComputeColumns_anisotropic(irtkRealPixel *, long, long, long, double);
 
   /// Calculate 2D distance transform for anisotripic voxel sizes
   void edtComputeEDT_2D_anisotropic(irtkRealPixel *, irtkRealPixel *, long, long, double, double);
@@ -56,6 +84,9 @@ protected:
   void edtComputeEDT_3D_anisotropic(irtkRealPixel *, irtkRealPixel *, long, long, long, double, double,
                                     double);
 
+  /// Calculate 2D or 3D distance transforms of several images for anisotripic voxel sizes
+  void edtComputeEDT_anisotropic(irtkRealPixel **, int, long, long, long, double, double, double, bool);
+
   /// Returns the name of the class
   virtual const char *NameOfClass();
 
@@ -70,6 +101,12 @@ public:
   /// Destructor (empty).
   ~irtkEuclideanDistanceTransform() {};
 
+  /// Set signed distance transform
+  SetMacro(Signed, bool);
+
+  /// Get signed distance transform
+  GetMacro(Signed, bool);
+
   // Run distance transform
   virtual void Run();
 
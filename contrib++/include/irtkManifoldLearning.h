@@ -3,9 +3,15 @@
 
 #include <irtkEigenAnalysis.h>
 #include <string>
+#include <vector>
+
+class irtkMultiThreadedManifoldLearningNeighbours;
 
 class irtkManifoldLearning
 {
+
+	friend class irtkMultiThreadedManifoldLearningNeighbours;
+
 	protected:
 	
 	
@@ -14,7 +20,19 @@ class irtkManifoldLearning
 		int _nrSubjects;
 		double ** _features;
 		double ** _distances;
+
+		/// Sparse affinity graph in compressed row format, i.e. the
+		/// neighbours of subject i are _graphIndex[_graphStart[i]] to
+		/// _graphIndex[_graphStart[i+1]-1] with weights _graphWeight
+		vector<int> _graphStart;
+		vector<int> _graphIndex;
+		vector<double> _graphWeight;
+
 		void EstablishDistances();
+
+		/// Build symmetric graph W + W^T from k neighbours of each subject
+		void EstablishGraph(int, const vector<int> &, const vector<double> &);
+
 		irtkManifoldLearning();
 	
 	
@@ -23,6 +41,24 @@ class irtkManifoldLearning
 		void Initialize(string csvFilename);
 		void Initialize(double ** input);
 		void Initialize(irtkMatrix input);
+
+		/** Build sparse k-nearest neighbour graph from data vectors of
+		 *  given dimension. The affinity of neighbours i and j is
+		 *  exp(-d_ij^2 / (s_i s_j)), where s_i is the distance of subject i
+		 *  to its k-th nearest neighbour.
+		 */
+		void InitializeNeighbourGraph(double ** data, int nrDimensions, int nrNeighbours);
+
+		/** Build sparse graph from the k largest similarities of each
+		 *  subject, which are read row by row from a csv file. If a file
+		 *  with the similarities of a target to all other subjects is
+		 *  given, the target is appended as last subject.
+		 */
+		void InitializeNeighbourGraph(string csvFilename, string targetFilename, int nrNeighbours);
+
+		/// Returns whether a sparse affinity graph has been built
+		bool HasNeighbourGraph();
+
 		double ** GetEmbedding();
 		void WriteFeatures(string);
 		double GetDistance(int, int);
@@ -6,9 +6,29 @@
 #define NMI 1;
 #define SSD 2;
 
+/// Default number of subjects along each side of a tile of pairs
+#define PAIRWISE_SIMILARITY_TILE_SIZE 16
+
+class irtkSimilarityMetric;
+class irtkMultiThreadedPairwiseSimilarity;
+
+/**
+ * Similarities of all pairs of subjects, for each region.
+ *
+ * The matrix of pairs is evaluated in tiles of rows by columns. Only the
+ * images of the subjects of the current tile are kept in memory when the
+ * images are read from files, and the images of the rows of a tile are
+ * reused for all tiles of the same row. The pairs of a tile are evaluated in
+ * parallel and all regions of a pair are evaluated in a single pass over the
+ * images. If a checkpoint file is set, the results of each tile are appended
+ * to it once the tile is completed, so that an interrupted run can be resumed.
+ */
 
 class irtkPairwiseSimilarity
 {
+
+	friend class irtkMultiThreadedPairwiseSimilarity;
+
 	protected:
 	
 	private:
@@ -28,6 +48,45 @@ class irtkPairwiseSimilarity
 		bool _singleRegionMask;
 		int _padding;
 
+		/// File names of images which are read tile by tile
+		vector<string> _fileNames;
+
+		/// Number of histogram bins of each image
+		vector<int> _nrBins;
+
+		/// Number of subjects along each side of a tile
+		int _tileSize;
+
+		/// Name of checkpoint file
+		string _checkpointName;
+
+		/// Total number of subjects
+		int GetNumberOfImages();
+
+		/// Rescale intensities of image to histogram bins
+		void PrepareImage(int);
+
+		/// Keep only images of given rows and columns in memory
+		void LoadTile(int, int, int, int);
+
+		/// Similarity metric for pair of subjects
+		irtkSimilarityMetric *NewMetric(int, int);
+
+		/// Evaluate all regions of pair of subjects
+		void EvaluatePair(int, int);
+
+		/// Read results of completed tiles from checkpoint file, returns false if it has to be rewritten
+		bool ReadCheckpoint(vector<bool> &, int);
+
+		/// Write results of tile to stream
+		void WriteCheckpointTile(ostream &, int, int);
+
+		/// Replace checkpoint file by results of completed tiles
+		void WriteCheckpoint(const vector<bool> &, int);
+
+		/// Append results of tile to checkpoint file
+		void AppendCheckpoint(int, int);
+
 		
 		
 		
@@ -37,6 +96,7 @@ class irtkPairwiseSimilarity
 		void Initialize(int, bool	);
 		void Initialize(int, int, bool, irtkGreyImage **	,int, int);
 		void LoadImages(string imagefilename, string);
+		void LoadImages(vector<string> files, string);
 		void LoadImages(irtkGreyImage **);
 		void GetSimilarities();
 		int IsRegion(int, int, int);
@@ -45,6 +105,8 @@ class irtkPairwiseSimilarity
 		void SetTemplate(string filename);
 		double GetSimilarity(int region, int row, int col);
 		void SetPadding(int padding);
+		void SetTileSize(int tileSize);
+		void SetCheckpoint(string filename);
 		
 		
 		
@@ -5,15 +5,37 @@
 #include <irtkManifoldLearning.h>
 #include <string>
 
+class irtkMultiThreadedSpectralClusteringMultiply;
+
 class irtkSpectralClustering : public irtkManifoldLearning
 {
+
+	friend class irtkMultiThreadedSpectralClusteringMultiply;
+
 	protected:
+
+		/// Inverse square root of degree of each subject in sparse graph
+		vector<double> _invSqrtDegree;
+
+		/// Multiply vector by normalised affinity matrix D^-1/2 W D^-1/2 of sparse graph
+		void Multiply(double *, double *);
+
+		/** Spectral embedding of sparse graph. The leading eigenvectors of
+		 *  the normalised affinity matrix, i.e. the eigenvectors of the
+		 *  smallest eigenvalues of the normalised Laplacian, are computed by
+		 *  the Lanczos method with full reorthogonalisation. The basis is
+		 *  limited to a few times the number of features, the method is
+		 *  restarted with the leading Ritz vectors when it is full.
+		 */
+		void DoSparseSpectralEmbedding();
 	
 	private:
 
 	
 	public:
 		irtkSpectralClustering(int nrSubjects, int nrFeatures);
+
+		/// Spectral embedding of sparse graph if one has been built, otherwise of dense similarities
 		void DoSpectralEmbedding();
 
 };
@@ -37,24 +37,29 @@ template <class VoxelType> void irtkCityBlockDistanceTransform<VoxelType>::Initi
 		exit(1);
 	}
 
-	// Ensure the singleton spatial dimension is the z-dimension.
+	// Ensure the singleton spatial dimension is the z-dimension. The input and
+	// output are accessed through views with permuted axes instead of flipping
+	// the images.
+	irtkGenericImageView<VoxelType> input(*this->_input);
+	this->_outputView = irtkGenericImageView<VoxelType>(*this->_output);
 
 	// Default.
 	this->_flipType = irtkFlipNone;
 
 	if (attr._x == 1){
-		this->_input->FlipXZ(0);
-		this->_output->FlipXZ(0);
+		input = input.FlipXZ();
+		this->_outputView = this->_outputView.FlipXZ();
 		this->_flipType = irtkFlipXZ;
 	} else if (attr._y == 1) {
-		this->_input->FlipYZ(0);
-		this->_output->FlipYZ(0);
+		input = input.FlipYZ();
+		this->_outputView = this->_outputView.FlipYZ();
 		this->_flipType = irtkFlipYZ;
 	}
 
-
-	// Get the attributes again as they may have changed.
-	attr = this->_input->GetImageAttributes();
+	// Planar dimensions of the permuted image.
+	attr._x = input.GetX();
+	attr._y = input.GetY();
+	attr._z = input.GetZ();
 
 	// Increment the planar dimensions.
 	attr._x += 2;
@@ -73,23 +78,23 @@ template <class VoxelType> void irtkCityBlockDistanceTransform<VoxelType>::Initi
   	// columns of input image.
   	for (j = 1; j < ny - 1; ++j){
   		this->_data->Put(0   , j, 0, l,
-  				this->_input->Get(0   , j-1, 0, l) > 0 ? 1 : 0);
+  				input.Get(0   , j-1, 0, l) > 0 ? 1 : 0);
   		this->_data->Put(nx-1, j, 0, l,
-  				this->_input->Get(nx-3, j-1, 0, l) > 0 ? 1 : 0);
+  				input.Get(nx-3, j-1, 0, l) > 0 ? 1 : 0);
   	}
 
   	for (i = 1; i < nx - 1; ++i){
   		this->_data->Put(i, 0   , 0, l,
-  				this->_input->Get(i-1, 0   , 0, l) > 0 ? 1 : 0);
+  				input.Get(i-1, 0   , 0, l) > 0 ? 1 : 0);
   		this->_data->Put(i, ny-1, 0, l,
-  				this->_input->Get(i-1, ny-3, 0, l) > 0 ? 1 : 0);
+  				input.Get(i-1, ny-3, 0, l) > 0 ? 1 : 0);
   	}
 
   	// Copy original image into interior.
   	for (j = 1; j < ny - 1; ++j){
   		for (i = 1; i < nx - 1; ++i){
   			this->_data->Put(i, j, 0, l,
-  					this->_input->Get(i-1, j-1, 0, l) > 0 ? 1 : 0);
+  					input.Get(i-1, j-1, 0, l) > 0 ? 1 : 0);
   		}
   	}
   }
@@ -185,15 +190,6 @@ template <class VoxelType> void irtkCityBlockDistanceTransform<VoxelType>::Initi
 
 template <class VoxelType> void irtkCityBlockDistanceTransform<VoxelType>::Finalize()
 {
-	// If image is 2D, may need to undo a dimension flip.
-	if (this->_data->GetZ() == 1){
-		if (this->_flipType == irtkFlipXZ){
-			this->_output->FlipXZ(0);
-		} else if (this->_flipType == irtkFlipYZ) {
-			this->_output->FlipYZ(0);
-		}
-	}
-
 	delete this->_data;
 
 	this->irtkImageToImage<VoxelType>::Finalize();
@@ -232,8 +228,8 @@ template <class VoxelType> void irtkCityBlockDistanceTransform<VoxelType>::Run2D
 				for (i = 1; i < nx - 1; ++i){
 					if (this->_data->Get(i, j, 0, l) > 0){
 						++objectVoxelCount;
-						val = this->_output->Get(i-1, j-1, 0, l);
-						this->_output->Put(i-1, j-1, 0, l, 1 + val);
+						val = this->_outputView.Get(i-1, j-1, 0, l);
+						this->_outputView.Put(i-1, j-1, 0, l, 1 + val);
 					}
 				}
 			}
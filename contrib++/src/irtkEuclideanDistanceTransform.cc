@@ -18,9 +18,84 @@ See LICENSE for details
 
 #include <irtkEuclideanDistanceTransform.h>
 
+template <class VoxelType> class irtkMultiThreadedEuclideanDistanceTransformPlanes
+{
+
+  /// Pointer to distance transform filter
+  irtkEuclideanDistanceTransform<VoxelType> *_filter;
+
+  /// Distance transforms
+  irtkRealPixel **_edt;
+
+  /// Image dimensions
+  long _nX, _nY, _nZ;
+
+  /// Voxel dimensions
+  double _wX, _wY;
+
+public:
+
+  irtkMultiThreadedEuclideanDistanceTransformPlanes(irtkEuclideanDistanceTransform<VoxelType> *filter, irtkRealPixel **edt, long nX, long nY, long nZ, double wX, double wY) {
+    _filter = filter;
+    _edt = edt;
+    _nX = nX;
+    _nY = nY;
+    _nZ = nZ;
+    _wX = wX;
+    _wY = wY;
+  }
+
+  void operator()(const blocked_range<int> &r) const {
+    int l;
+
+    // Planes of all images are numbered consecutively
+    for (l = r.begin(); l != r.end(); l++) {
+      _filter->edtComputeEDT_2D_anisotropic(NULL, _edt[l / _nZ] + (l % _nZ) * _nX * _nY, _nX, _nY, _wX, _wY);
+    }
+  }
+};
+
+template <class VoxelType> class irtkMultiThreadedEuclideanDistanceTransformColumns
+{
+
+  /// Pointer to distance transform filter
+  irtkEuclideanDistanceTransform<VoxelType> *_filter;
+
+  /// Distance transforms
+  irtkRealPixel **_edt;
+
+  /// Image dimensions
+  long _nX, _nY, _nZ;
+
+  /// Voxel dimension along z
+  double _wZ;
+
+public:
+
+  irtkMultiThreadedEuclideanDistanceTransformColumns(irtkEuclideanDistanceTransform<VoxelType> *filter, irtkRealPixel **edt, long nX, long nY, long nZ, double wZ) {
+    _filter = filter;
+    _edt = edt;
+    _nX = nX;
+    _nY = nY;
+    _nZ = nZ;
+    _wZ = wZ;
+  }
+
+  void operator()(const blocked_range<int> &r) const {
+    int l;
+
+    // Rows of all images are numbered consecutively, each row starts the
+    // columns along z of its voxels
+    for (l = r.begin(); l != r.end(); l++) {
+      _filter->edtComputeColumns_anisotropic(_edt[l / _nY] + (l % _nY) * _nX, _nX, _nZ, _nX * _nY, _wZ);
+    }
+  }
+};
+
 template <class VoxelType> irtkEuclideanDistanceTransform<VoxelType>::irtkEuclideanDistanceTransform(irtkDistanceTransformMode distanceTransformMode) : irtkImageToImage<VoxelType>()
 {
   _distanceTransformMode = distanceTransformMode;
+  _Signed = false;
 }
 
 /*
@@ -55,7 +130,7 @@ template <class VoxelType> irtkEuclideanDistanceTransform<VoxelType>::irtkEuclid
 template <class VoxelType> void irtkEuclideanDistanceTransform<VoxelType>::edtComputeEDT_2D(char *img, long *edt, long nX, long nY)
 {
   char *c;
-  long i, j, nXY, d, *p, *q, *f;
+  long i, j, nXY, d, *p;
 
   /* nXY is number of voxels in 2D image */
   nXY = nX * nY;
@@ -117,31 +192,52 @@ template <class VoxelType> void irtkEuclideanDistanceTransform<VoxelType>::edtCo
 
   /* compute D_2 = squared EDT */
   /* solve 1D problem for each column (y direction) */
-  f = (long *)malloc(nY * sizeof(long));
-  if (f == NULL) {
-    fprintf(stderr, "Error in edtComputeEDT_2D()\n");
-    fprintf(stderr, "Cannot malloc f\n");
+  edtComputeColumns(edt, nX, nY, nX);
+} /* edtComputeEDT_2D */
+
+template <class VoxelType> void irtkEuclideanDistanceTransform<VoxelType>::edtComputeColumns(long *edt, long nX, long n, long stride)
+/*
+ * This procedure solves the 1D problem for nX neighbouring columns of length
+ * n, i.e. column i consists of the elements edt[i + j * stride]. The columns
+ * are copied in blocks of EDT_LINES, so that the image is read and written
+ * along rows instead of along columns.
+ */
+{
+  long i, j, b, m, *p, *f, *g, *h;
+
+  f = (long *)malloc(EDT_LINES * n * sizeof(long));
+  g = (long *)malloc(n * sizeof(long));
+  h = (long *)malloc(n * sizeof(long));
+  if (f == NULL || g == NULL || h == NULL) {
+    fprintf(stderr, "Error in edtComputeColumns()\n");
+    fprintf(stderr, "Cannot malloc f, g or h\n");
     exit(EXIT_FAILURE);
   }
-  for (i = 0; i < nX; i++) {
-    /* fill array f with D_1 distances in column */
+  for (i = 0; i < nX; i += EDT_LINES) {
+    m = (nX - i < EDT_LINES) ? nX - i : EDT_LINES;
+    /* fill array f with distances in block of columns, column b is at f + b * n */
     /* this is essentially line 4 in Procedure VoronoiEDT() in tPAMI paper */
     p = edt + i;
-    q = f;
-    for (j = 0; j < nY; j++, p += nX, q++) {
-      *q = *p;
+    for (j = 0; j < n; j++, p += stride) {
+      for (b = 0; b < m; b++) {
+        f[b * n + j] = p[b];
+      }
+    }
+    /* call edtVornoiEDT, which leaves f unchanged if column has no feature voxel */
+    for (b = 0; b < m; b++) {
+      edtVornoiEDT(f + b * n, n, g, h);
     }
-    /* call edtVornoiEDT */
-    if (edtVornoiEDT(f, nY)) {
-      p = edt + i;
-      q = f;
-      for (j = 0; j < nY; j++, p += nX, q++) {
-        *p = *q;
+    p = edt + i;
+    for (j = 0; j < n; j++, p += stride) {
+      for (b = 0; b < m; b++) {
+        p[b] = f[b * n + j];
       }
     }
   }
   free(f);
-} /* edtComputeEDT_2D */
+  free(g);
+  free(h);
+} /* edtComputeColumns */
 
 template <class VoxelType> void irtkEuclideanDistanceTransform<VoxelType>::edtComputeEDT_3D(char *img, long *edt, long nX, long nY, long nZ)
 /*
@@ -150,7 +246,7 @@ template <class VoxelType> void irtkEuclideanDistanceTransform<VoxelType>::edtCo
  */
 {
   char *c;
-  long i, k, nXY, nXYZ, *p, *q, *f;
+  long i, j, k, nXY, nXYZ, *p;
 
   /* nXY is number of voxels in each plane (xy) */
   /* nXYZ is number of voxels in 3D image */
@@ -175,70 +271,22 @@ template <class VoxelType> void irtkEuclideanDistanceTransform<VoxelType>::edtCo
   }
 
   /* compute D_3 */
-  /* solve 1D problem for each column (z direction) */
-  f = (long *)malloc(nZ * sizeof(long));
-  if (f == NULL) {
-    fprintf(stderr, "Error in edtComputeEDT_3D()\n");
-    fprintf(stderr, "Cannot malloc f\n");
-    exit(EXIT_FAILURE);
-  }
-  for (i = 0; i < nXY; i++) {
-    /* fill array f with D_2 distances in column */
-    /* this is essentially line 4 in Procedure VoronoiEDT() in tPAMI paper */
-    p = edt + i;
-    q = f;
-    for (k = 0; k < nZ; k++, p += nXY, q++) {
-      *q = *p;
-    }
-    /* call edtVornoiEDT */
-    if (edtVornoiEDT(f, nZ)) {
-      p = edt + i;
-      q = f;
-      for (k = 0; k < nZ; k++, p += nXY, q++) {
-        *p = *q;
-      }
-    }
+  /* solve 1D problem for each column (z direction), row by row */
+  for (j = 0; j < nY; j++) {
+    edtComputeColumns(edt + j * nX, nX, nZ, nXY);
   }
-  free(f);
 } /* edtComputeEDT_3D */
 
-template <class VoxelType> int irtkEuclideanDistanceTransform<VoxelType>::edtVornoiEDT(long *f, long n)
+template <class VoxelType> int irtkEuclideanDistanceTransform<VoxelType>::edtVornoiEDT(long *f, long n, long *g, long *h)
 /*
  * This is Procedure edtVornoiEDT() in tPAMI paper.
  */
 {
   long i, l, a, b, c, v, n_S, lhs, rhs;
-  static int firstCall = 1;
-  static long *g, *h, size_gh = 0;
-
-  /* this procedure is called often */
-  /* we keep static arrays to avoid frequent calls to malloc() */
-  /* the downside is that this memory is never freed, */
-  /* but it is not so much memory: max(nX,nY,nZ)*sizeof(long) */
-  /* need to check if arrays are sufficiently large */
-  if (n > size_gh && !firstCall) {
-    free(g);
-    free(h);
-    firstCall = 1;
-  }
-  /* malloc arrays if this is first call to procedure, or if arrays */
-  /* are too small and need to be reallocated */
-  if (firstCall) {
-    g = (long *)malloc(n * sizeof(long));
-    if (g == NULL) {
-      fprintf(stderr, "Error in edtVornoiEDT()\n");
-      fprintf(stderr, "Cannot malloc g\n");
-      exit(EXIT_FAILURE);
-    }
-    h = (long *)malloc(n * sizeof(long));
-    if (h == NULL) {
-      fprintf(stderr, "Error in edtVornoiEDT()\n");
-      fprintf(stderr, "Cannot malloc h\n");
-      exit(EXIT_FAILURE);
-    }
-    size_gh = n;
-    firstCall = 0;
-  }
+
+  /* this procedure is called often and from several threads */
+  /* the caller provides the arrays g and h of size n, so that */
+  /* they can be reused for all columns of a thread */
 
   /* construct partial Vornoi diagram */
   /* this loop is lines 1-14 in Procedure edtVornoiEDT() in tPAMI paper */
@@ -311,45 +359,15 @@ template <class VoxelType> int irtkEuclideanDistanceTransform<VoxelType>::edtVor
 } /* edtVornoiEDT */
 
 
-template <class VoxelType> int irtkEuclideanDistanceTransform<VoxelType>::edtVornoiEDT_anisotropic(irtkRealPixel *f, long n, double w)
+template <class VoxelType> int irtkEuclideanDistanceTransform<VoxelType>::edtVornoiEDT_anisotropic(irtkRealPixel *f, long n, double w, double *g, double *h)
 /*
  * This is Procedure edtVornoiEDT() in tPAMI paper.
  */
 {
   long i, l, n_S;
   double a, b, c, v, lhs, rhs;
-  static int firstCall = 1;
-  static long size_gh = 0;
-  static double *g, *h;
-
-  /* this procedure is called often */
-  /* we keep static arrays to avoid frequent calls to malloc() */
-  /* the downside is that this memory is never freed, */
-  /* but it is not so much memory: max(nX,nY,nZ)*sizeof(long) */
-  /* need to check if arrays are sufficiently large */
-  if (n > size_gh && !firstCall) {
-    free(g);
-    free(h);
-    firstCall = 1;
-  }
-  /* malloc arrays if this is first call to procedure, or if arrays */
-  /* are too small and need to be reallocated */
-  if (firstCall) {
-    g = (double *)malloc(n * sizeof(double));
-    if (g == NULL) {
-      fprintf(stderr, "Error in edtVornoiEDT()\n");
-      fprintf(stderr, "Cannot malloc g\n");
-      exit(EXIT_FAILURE);
-    }
-    h = (double *)malloc(n * sizeof(double));
-    if (h == NULL) {
-      fprintf(stderr, "Error in edtVornoiEDT()\n");
-      fprintf(stderr, "Cannot malloc h\n");
-      exit(EXIT_FAILURE);
-    }
-    size_gh = n;
-    firstCall = 0;
-  }
+
+  /* the caller provides the arrays g and h of size n, see edtVornoiEDT */
 
   /* construct partial Vornoi diagram */
   /* this loop is lines 1-14 in Procedure edtVornoiEDT() in tPAMI paper */
@@ -431,7 +449,7 @@ template <class VoxelType> void irtkEuclideanDistanceTransform<VoxelType>::edtCo
 {
   irtkRealPixel *c;
   long i, j, nXY;
-  irtkRealPixel d, *p, *q, *f;
+  irtkRealPixel d, *p;
 
   /* nXY is number of voxels in 2D image */
   nXY = nX * nY;
@@ -494,31 +512,52 @@ template <class VoxelType> void irtkEuclideanDistanceTransform<VoxelType>::edtCo
 
   /* compute D_2 = squared EDT */
   /* solve 1D problem for each column (y direction) */
-  f = (irtkRealPixel *)malloc(nY * sizeof(irtkRealPixel));
-  if (f == NULL) {
-    fprintf(stderr, "Error in edtComputeEDT_2D()\n");
-    fprintf(stderr, "Cannot malloc f\n");
+  edtComputeColumns_anisotropic(edt, nX, nY, nX, wY);
+} /* edtComputeEDT_2D_anisotropic */
+
+template <class VoxelType> void irtkEuclideanDistanceTransform<VoxelType>::edtComputeColumns_anisotropic(irtkRealPixel *edt, long nX, long n, long stride, double w)
+/*
+ * This procedure solves the 1D problem for nX neighbouring columns with
+ * anisotropic voxels. See notes for edtComputeColumns.
+ */
+{
+  long i, j, b, m;
+  irtkRealPixel *p, *f;
+  double *g, *h;
+
+  f = (irtkRealPixel *)malloc(EDT_LINES * n * sizeof(irtkRealPixel));
+  g = (double *)malloc(n * sizeof(double));
+  h = (double *)malloc(n * sizeof(double));
+  if (f == NULL || g == NULL || h == NULL) {
+    fprintf(stderr, "Error in edtComputeColumns_anisotropic()\n");
+    fprintf(stderr, "Cannot malloc f, g or h\n");
     exit(EXIT_FAILURE);
   }
-  for (i = 0; i < nX; i++) {
-    /* fill array f with D_1 distances in column */
+  for (i = 0; i < nX; i += EDT_LINES) {
+    m = (nX - i < EDT_LINES) ? nX - i : EDT_LINES;
+    /* fill array f with distances in block of columns, column b is at f + b * n */
     /* this is essentially line 4 in Procedure VoronoiEDT() in tPAMI paper */
     p = edt + i;
-    q = f;
-    for (j = 0; j < nY; j++, p += nX, q++) {
-      *q = *p;
+    for (j = 0; j < n; j++, p += stride) {
+      for (b = 0; b < m; b++) {
+        f[b * n + j] = p[b];
+      }
+    }
+    /* call edtVornoiEDT, which leaves f unchanged if column has no feature voxel */
+    for (b = 0; b < m; b++) {
+      edtVornoiEDT_anisotropic(f + b * n, n, w, g, h);
     }
-    /* call edtVornoiEDT */
-    if (edtVornoiEDT_anisotropic(f, nY, wY)) {
-      p = edt + i;
-      q = f;
-      for (j = 0; j < nY; j++, p += nX, q++) {
-        *p = *q;
+    p = edt + i;
+    for (j = 0; j < n; j++, p += stride) {
+      for (b = 0; b < m; b++) {
+        p[b] = f[b * n + j];
       }
     }
   }
   free(f);
-} /* edtComputeEDT_2D_anisotropic */
+  free(g);
+  free(h);
+} /* edtComputeColumns_anisotropic */
 
 
 /*
@@ -529,12 +568,10 @@ template <class VoxelType> void irtkEuclideanDistanceTransform<VoxelType>::edtCo
 template <class VoxelType> void irtkEuclideanDistanceTransform<VoxelType>::edtComputeEDT_3D_anisotropic(irtkRealPixel *img, irtkRealPixel *edt, long nX, long nY, long nZ, double wX, double wY, double wZ)
 {
   irtkRealPixel *c;
-  long i, k, nXY, nXYZ;
-  irtkRealPixel *p, *q, *f;
+  long i, nXYZ;
+  irtkRealPixel *p;
 
-  /* nXY is number of voxels in each plane (xy) */
   /* nXYZ is number of voxels in 3D image */
-  nXY = nX * nY;
   nXYZ = nX * nY * nZ;
 
   /* if binary image is provided in the array img, copy it to the arry edt */
@@ -547,45 +584,42 @@ template <class VoxelType> void irtkEuclideanDistanceTransform<VoxelType>::edtCo
     }
   }
 
+  /* compute D_2 and D_3 */
+  edtComputeEDT_anisotropic(&edt, 1, nX, nY, nZ, wX, wY, wZ, true);
+} /* edtComputeEDT_3D_anisotropic */
+
+template <class VoxelType> void irtkEuclideanDistanceTransform<VoxelType>::edtComputeEDT_anisotropic(irtkRealPixel **edt, int n, long nX, long nY, long nZ, double wX, double wY, double wZ, bool volume)
+/*
+ * This procedure computes the squared EDT of n binary images in place, either
+ * in 3D if volume is true or independently for each plane otherwise. The
+ * planes and the rows of columns along z of all images are processed in
+ * parallel, so that several transforms only require a single pass.
+ */
+{
+  task_scheduler_init init(tbb_no_threads);
+
   /* compute D_2 */
   /* call edtComputeEDT_2D for each plane */
-  p = edt;
-  for (k = 0; k < nZ; k++, p += nXY) {
-    edtComputeEDT_2D_anisotropic(NULL, p, nX, nY, wX, wY);
-  }
+  irtkMultiThreadedEuclideanDistanceTransformPlanes<VoxelType> planes(this, edt, nX, nY, nZ, wX, wY);
+  parallel_for(blocked_range<int>(0, n * nZ), planes);
 
   /* compute D_3 */
   /* solve 1D problem for each column (z direction) */
-  f = (irtkRealPixel *)malloc(nZ * sizeof(irtkRealPixel));
-  if (f == NULL) {
-    fprintf(stderr, "Error in edtComputeEDT_3D()\n");
-    fprintf(stderr, "Cannot malloc f\n");
-    exit(EXIT_FAILURE);
-  }
-  for (i = 0; i < nXY; i++) {
-    /* fill array f with D_2 distances in column */
-    /* this is essentially line 4 in Procedure VoronoiEDT() in tPAMI paper */
-    p = edt + i;
-    q = f;
-    for (k = 0; k < nZ; k++, p += nXY, q++) {
-      *q = *p;
-    }
-    /* call edtVornoiEDT */
-    if (edtVornoiEDT_anisotropic(f, nZ, wZ)) {
-      p = edt + i;
-      q = f;
-      for (k = 0; k < nZ; k++, p += nXY, q++) {
-	*p = *q;
-      }
-    }
+  if (volume) {
+    irtkMultiThreadedEuclideanDistanceTransformColumns<VoxelType> columns(this, edt, nX, nY, nZ, wZ);
+    parallel_for(blocked_range<int>(0, n * nY), columns);
   }
-  free(f);
-} /* edtComputeEDT_3D_anisotropic */
+
+  init.terminate();
+} /* edtComputeEDT_anisotropic */
 
 template <class VoxelType> void irtkEuclideanDistanceTransform<VoxelType>::Run()
 {
-  int nx, ny, nz, nt, z, t;
+  int nx, ny, nz, nt, t;
+  long i, n;
   double wx, wy, wz;
+  VoxelType *ptr1, *ptr2;
+  irtkRealPixel *edt[2];
 
   // Do the initial set up
   this->Initialize();
@@ -595,23 +629,43 @@ template <class VoxelType> void irtkEuclideanDistanceTransform<VoxelType>::Run()
   ny = this->_input->GetY();
   nz = this->_input->GetZ();
   nt = this->_input->GetT();
+  n  = long(nx) * ny * nz;
 
   // Calculate voxel size
   this->_input->GetPixelSize(&wx, &wy, &wz);
-  for ( t = 0; t < nt; t++){
-	  if (this->_distanceTransformMode == irtkEuclideanDistanceTransform::irtkDistanceTransform3D) {
-		  // Calculate 3D distance transform
-		  edtComputeEDT_3D_anisotropic( this->_input->GetPointerToVoxels(0,0,0,t),
-			  this->_output->GetPointerToVoxels(0,0,0,t),
-			  nx, ny, nz, wx, wy, wz);
-	  } else {
-		  for (z = 0; z < nz; z++) {
-			  // Calculate 2D distance transform slice by slice
-			  edtComputeEDT_2D_anisotropic( this->_input->GetPointerToVoxels(0, 0, z, t),
-				  this->_output->GetPointerToVoxels(0, 0, z, t),
-				  nx, ny, wx, wy);
-		  }
-	  }
+
+  // Allocate distance transform of background, the distance transform of
+  // the object is calculated in the output
+  if (_Signed) {
+    edt[1] = new irtkRealPixel[n];
+  }
+
+  for (t = 0; t < nt; t++) {
+    ptr1 = this->_input->GetPointerToVoxels(0, 0, 0, t);
+    ptr2 = this->_output->GetPointerToVoxels(0, 0, 0, t);
+    if (_Signed) {
+      // Distances outside to the object and inside to the background are
+      // calculated together
+      edt[0] = ptr2;
+      for (i = 0; i < n; i++) {
+        edt[1][i] = (ptr1[i] == 0);
+        edt[0][i] = (ptr1[i] != 0);
+      }
+      edtComputeEDT_anisotropic(edt, 2, nx, ny, nz, wx, wy, wz, this->_distanceTransformMode == irtkEuclideanDistanceTransform::irtkDistanceTransform3D);
+      for (i = 0; i < n; i++) {
+        ptr2[i] = sqrt(ptr2[i]) - sqrt(edt[1][i]);
+      }
+    } else {
+      // Calculate 3D distance transform or 2D distance transform slice by slice
+      for (i = 0; i < n; i++) {
+        ptr2[i] = ptr1[i];
+      }
+      edtComputeEDT_anisotropic(&ptr2, 1, nx, ny, nz, wx, wy, wz, this->_distanceTransformMode == irtkEuclideanDistanceTransform::irtkDistanceTransform3D);
+    }
+  }
+
+  if (_Signed) {
+    delete []edt[1];
   }
 
   // Do the final cleaning up
@@ -27,16 +27,76 @@ See LICENSE for details
 #include <errno.h>
 #include <sstream>
 
+class irtkMultiThreadedManifoldLearningNeighbours
+{
+
+	/// Pointer to manifold learning
+	irtkManifoldLearning *_filter;
+
+	/// Data vectors
+	double **_data;
+
+	/// Dimension of data vectors
+	int _nrDimensions;
+
+	/// Number of neighbours of each subject
+	int _nrNeighbours;
+
+	/// Neighbours of each subject with squared distances
+	int *_index;
+	double *_value;
+
+public:
+
+	irtkMultiThreadedManifoldLearningNeighbours(irtkManifoldLearning *filter, double **data, int nrDimensions, int nrNeighbours, int *index, double *value) {
+		_filter = filter;
+		_data = data;
+		_nrDimensions = nrDimensions;
+		_nrNeighbours = nrNeighbours;
+		_index = index;
+		_value = value;
+	}
+
+	void operator()(const blocked_range<int> &r) const {
+		int i, j, f, c;
+		double dist;
+		vector<pair<double, int> > candidates(_filter->_nrSubjects - 1);
+
+		for(i = r.begin(); i != r.end(); i++){
+			c = 0;
+			for(j = 0; j < _filter->_nrSubjects; j++){
+				if(j == i)
+					continue;
+				dist = 0;
+				for(f = 0; f < _nrDimensions; f++){
+					dist += (_data[i][f]-_data[j][f])*(_data[i][f]-_data[j][f]);
+				}
+				candidates[c] = make_pair(dist, j);
+				c++;
+			}
+			partial_sort(candidates.begin(), candidates.begin() + _nrNeighbours, candidates.end());
+			for(c = 0; c < _nrNeighbours; c++){
+				_index[i * _nrNeighbours + c] = candidates[c].second;
+				_value[i * _nrNeighbours + c] = candidates[c].first;
+			}
+		}
+	}
+};
  
 irtkManifoldLearning::irtkManifoldLearning(){
 	_distances = NULL;
 }
 
 double irtkManifoldLearning::GetDistance(int i, int j){
-	if(_distances == NULL){
-		EstablishDistances();
+	if(_distances != NULL){
+		return _distances[i][j];
 	}
-	return _distances[i][j];
+	// Compute distance on demand, so that no matrix of all distances is needed
+	double dist = 0;
+	for(int f = 0; f < _nrFeatures; f++){
+		dist += (_features[i][f]-_features[j][f])*(_features[i][f]-_features[j][f]);
+	}
+	return sqrt(dist);
 }
 
 void irtkManifoldLearning::EstablishDistances(){
@@ -62,11 +122,8 @@ void irtkManifoldLearning::EstablishDistances(){
 void irtkManifoldLearning::GetNeighbours(int node, int nrNeighbours, int * neighbours){
 	double * distTemp = new double[_nrSubjects];
 
-	if(_distances == NULL){
-		EstablishDistances();
-	}
 	for(int i = 0; i < _nrSubjects; i++){
-		distTemp[i] = _distances[node][i];
+		distTemp[i] = GetDistance(node, i);
 //		cout << _distances[node][i];
 	}
 
@@ -86,7 +143,165 @@ void irtkManifoldLearning::GetNeighbours(int node, int nrNeighbours, int * neigh
 		cout << nextNeighbour << endl;
 		neighbours[k] = nextNeighbour;		
 	}
-	delete distTemp;	
+	delete []distTemp;	
+}
+
+void irtkManifoldLearning::InitializeNeighbourGraph(double ** data, int nrDimensions, int nrNeighbours){
+	if(nrNeighbours < 1 || nrNeighbours >= _nrSubjects){
+		cerr << "irtkManifoldLearning::InitializeNeighbourGraph: Number of neighbours must be between 1 and " << _nrSubjects-1 << endl;
+		exit(1);
+	}
+	vector<int> index(_nrSubjects * nrNeighbours);
+	vector<double> value(_nrSubjects * nrNeighbours);
+
+	task_scheduler_init init(tbb_no_threads);
+	irtkMultiThreadedManifoldLearningNeighbours body(this, data, nrDimensions, nrNeighbours, &index[0], &value[0]);
+	parallel_for(blocked_range<int>(0, _nrSubjects), body);
+	init.terminate();
+
+	// Local scale of each subject is the distance to its k-th neighbour
+	vector<double> scale(_nrSubjects);
+	for(int i = 0; i < _nrSubjects; i++){
+		scale[i] = sqrt(value[i * nrNeighbours + nrNeighbours - 1]);
+	}
+	for(int i = 0; i < _nrSubjects; i++){
+		for(int k = 0; k < nrNeighbours; k++){
+			double s = scale[i] * scale[index[i * nrNeighbours + k]];
+			double d = value[i * nrNeighbours + k];
+			if(s > 0){
+				value[i * nrNeighbours + k] = exp(-d / s);
+			}
+			else{
+				value[i * nrNeighbours + k] = (d > 0) ? 0 : 1;
+			}
+		}
+	}
+	EstablishGraph(nrNeighbours, index, value);
+}
+
+void irtkManifoldLearning::InitializeNeighbourGraph(string csvFilename, string targetFilename, int nrNeighbours){
+	int i, j, c, rows;
+	string line, token;
+
+	if(nrNeighbours < 1 || nrNeighbours >= _nrSubjects){
+		cerr << "irtkManifoldLearning::InitializeNeighbourGraph: Number of neighbours must be between 1 and " << _nrSubjects-1 << endl;
+		exit(1);
+	}
+	ifstream input(csvFilename.c_str());
+	if(!input){
+		cerr << "irtkManifoldLearning::InitializeNeighbourGraph: Can't open file " << csvFilename << endl;
+		exit(1);
+	}
+
+	// Similarities of the target are needed for the rows of all other subjects
+	rows = _nrSubjects;
+	vector<double> target;
+	if(targetFilename != ""){
+		ifstream from(targetFilename.c_str());
+		if(!from){
+			cerr << "irtkManifoldLearning::InitializeNeighbourGraph: Can't open file " << targetFilename << endl;
+			exit(1);
+		}
+		rows--;
+		target.resize(rows);
+		for(i = 0; i < rows; i++){
+			if(!getline(from, line)){
+				cerr << "irtkManifoldLearning::InitializeNeighbourGraph: File " << targetFilename << " has less than " << rows << " similarities" << endl;
+				exit(1);
+			}
+			target[i] = atof(line.c_str());
+		}
+	}
+
+	// Only the k largest similarities of each row are kept, so that the
+	// matrix of all similarities is never held in memory
+	vector<int> index(_nrSubjects * nrNeighbours);
+	vector<double> value(_nrSubjects * nrNeighbours);
+	vector<pair<double, int> > candidates(_nrSubjects - 1);
+	for(i = 0; i < _nrSubjects; i++){
+		c = 0;
+		if(i < rows){
+			if(!getline(input, line)){
+				cerr << "irtkManifoldLearning::InitializeNeighbourGraph: File " << csvFilename << " has less than " << rows << " rows" << endl;
+				exit(1);
+			}
+			istringstream row(line);
+			for(j = 0; j < rows; j++){
+				if(!getline(row, token, ',')){
+					cerr << "irtkManifoldLearning::InitializeNeighbourGraph: Row " << i << " of file " << csvFilename << " has less than " << rows << " columns" << endl;
+					exit(1);
+				}
+				if(j != i){
+					candidates[c++] = make_pair(-atof(token.c_str()), j);
+				}
+			}
+			if(rows < _nrSubjects){
+				candidates[c++] = make_pair(-target[i], rows);
+			}
+		}
+		else{
+			for(j = 0; j < rows; j++){
+				candidates[c++] = make_pair(-target[j], j);
+			}
+		}
+
+		// Largest similarities first
+		partial_sort(candidates.begin(), candidates.begin() + nrNeighbours, candidates.end());
+		for(c = 0; c < nrNeighbours; c++){
+			index[i * nrNeighbours + c] = candidates[c].second;
+			value[i * nrNeighbours + c] = -candidates[c].first;
+		}
+	}
+	EstablishGraph(nrNeighbours, index, value);
+}
+
+void irtkManifoldLearning::EstablishGraph(int nrNeighbours, const vector<int> &index, const vector<double> &value){
+	int i, j, k, n;
+
+	// Count entries of each row of W + W^T
+	vector<int> start(_nrSubjects + 1, 0);
+	for(i = 0; i < _nrSubjects; i++){
+		for(k = 0; k < nrNeighbours; k++){
+			start[i + 1]++;
+			start[index[i * nrNeighbours + k] + 1]++;
+		}
+	}
+	for(i = 0; i < _nrSubjects; i++){
+		start[i + 1] += start[i];
+	}
+
+	// Fill rows with entries of W and W^T
+	vector<pair<int, double> > entries(start[_nrSubjects]);
+	vector<int> pos(start.begin(), start.end() - 1);
+	for(i = 0; i < _nrSubjects; i++){
+		for(k = 0; k < nrNeighbours; k++){
+			j = index[i * nrNeighbours + k];
+			entries[pos[i]++] = make_pair(j, value[i * nrNeighbours + k]);
+			entries[pos[j]++] = make_pair(i, value[i * nrNeighbours + k]);
+		}
+	}
+
+	// Sum entries of mutual neighbours
+	_graphStart.assign(_nrSubjects + 1, 0);
+	_graphIndex.clear();
+	_graphWeight.clear();
+	for(i = 0; i < _nrSubjects; i++){
+		sort(entries.begin() + start[i], entries.begin() + start[i + 1]);
+		for(n = start[i]; n < start[i + 1]; n++){
+			if(n > start[i] && entries[n].first == entries[n - 1].first){
+				_graphWeight.back() += entries[n].second;
+			}
+			else{
+				_graphIndex.push_back(entries[n].first);
+				_graphWeight.push_back(entries[n].second);
+			}
+		}
+		_graphStart[i + 1] = _graphIndex.size();
+	}
+}
+
+bool irtkManifoldLearning::HasNeighbourGraph(){
+	return !_graphStart.empty();
 }
 
 double ** irtkManifoldLearning::GetEmbedding(){
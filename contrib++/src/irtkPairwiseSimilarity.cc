@@ -12,179 +12,48 @@
 #include <sstream>
 #include <irtkPairwiseSimilarity.h>
 
-#ifdef HAS_TBB
-#include "tbb/task_scheduler_init.h"
-#include "tbb/parallel_for.h"
-#include "tbb/blocked_range.h"
+class irtkMultiThreadedPairwiseSimilarity
+{
 
-using namespace tbb;
+	/// Pointer to pairwise similarity
+	irtkPairwiseSimilarity *_filter;
 
-class MultiThreadedSimilarity {
+	/// First row and column of tile
+	int _row, _col;
 
-	bool _useMasks;
-	irtkGreyImage ** _images, ** _regions;
-	int i, _nrRegions, _similarityType, _nrRows;
-	double *** _results;
-	bool completeImage;
-	vector <string> _files;
-	bool _transformImages, _twoSets, _singleRegionMask;
-	int _padding;
+	/// Number of rows and columns of tile
+	int _nrRows, _nrCols;
 
 public:
-	MultiThreadedSimilarity(bool useMasks , irtkGreyImage ** images, irtkGreyImage ** masks, int _i, double *** results, int nrRegions, int simType, bool twoSets, int nrRows, bool singleRegionMask, int padding) {
-
-		_useMasks = useMasks;
-		_images = images;
-		_regions = masks;
-		i = _i;
-		_nrRegions = nrRegions;
-		completeImage = false;
-		_results = results;
-		_transformImages = false;
-		_similarityType = simType;
-		_twoSets = twoSets;
+
+	irtkMultiThreadedPairwiseSimilarity(irtkPairwiseSimilarity *filter, int row, int col, int nrRows, int nrCols) {
+		_filter = filter;
+		_row = row;
+		_col = col;
 		_nrRows = nrRows;
-		_singleRegionMask = singleRegionMask;
-		_padding = padding;
+		_nrCols = nrCols;
 	}
-	void operator()(const blocked_range<int> &r) const {
-		for (int j = r.begin(); j!= r.end(); j++) {
-			if(j > i || _twoSets) {
-
-				irtkSimilarityMetric **metrics;
-				metrics = new irtkSimilarityMetric*[_nrRegions];
-				irtkGreyImage *i1, *i2;
-				i1 = _images[i];
-				if(_transformImages) {
-
-				}
-				else {
-					i2 = _images[j];
-				}
-				cout << i << " " << j << endl;
-
-				irtkGreyPixel * i1Ptr = i1->GetPointerToVoxels();
-				irtkGreyPixel * i2Ptr = i2->GetPointerToVoxels();
-				int numberOfBins = 256;
-
-				for(int k = 0; k < _nrRegions; k++) {
-
-					switch(_similarityType) {
-//					if(_similarityType == 1){
-						case 1 :
-						irtkGreyPixel i1_min, i1_max, i1_nbinss;
-						irtkGreyPixel i2_min, i2_max, i2_nbinss;
-
-						i1->GetMinMax(&i1_min, &i1_max);
-						i2->GetMinMax(&i2_min, &i2_max);
-
-						i2_nbinss = irtkCalculateNumberOfBins(i2, numberOfBins,
-								i2_min, i2_max);
-						i1_nbinss = irtkCalculateNumberOfBins(i1, numberOfBins,
-								i1_min, i1_max);
-						metrics[k] = new irtkNormalisedMutualInformationSimilarityMetric(i1_nbinss, i2_nbinss);
-//					}
-						break;
-//					else{
-						case 2 :
-						metrics[k] = new irtkSSDSimilarityMetric();
-						break;
-						case 3 :
-						metrics[k] = new irtkCrossCorrelationSimilarityMetric();
-						break;
-						default:
-						metrics[k] = new irtkSSDSimilarityMetric();
-					}
-					metrics[k]->Reset();
-				}
-
-				cout << "region: finished. nrRegions: " << _nrRegions << endl;
-				irtkGreyPixel **regionPtr;
-				int nrRegionPointers = _nrRegions;
-				if(_singleRegionMask) {
-					nrRegionPointers = 1;
-				}
-				if(_useMasks) {
-					regionPtr = new irtkGreyPixel*[nrRegionPointers];
-					for(int k = 0; k < nrRegionPointers; k++) {
-						regionPtr[k] = new irtkGreyPixel;
-						regionPtr[k] = _regions[k]->GetPointerToVoxels();
-						//		cout << "region: " << k << endl;
-					}
-				}
-				else {
-					regionPtr = new irtkGreyPixel*[1];
-					regionPtr[0] = _regions[0]->GetPointerToVoxels();
-				}
-
-				int valCtr = 0;
-				for(int ii = 0; ii < i1->GetNumberOfVoxels(); ii++) {
-					int val1 = *i1Ptr;
-					int val2 = *i2Ptr;
-					if(val1 > _padding && val2 > _padding) {
-						for(int r = 0; r < _nrRegions; r++) {
-							bool voxelInRegion = false;
-							if(!_singleRegionMask) {
-								if(*regionPtr[r]==0) {
-									voxelInRegion = true;
-								}
-							}
-							else {
-								if(*regionPtr[0]==r) {
-									voxelInRegion = true;
-								}
-							}
-							if(voxelInRegion) {
-								//								if(valCtr == 11)
-								//if(valCtr <= 20)
-								//cout << ii << " " << val1 << ", " << val2 << endl;
-								//									cout << *regionPtr[0] << endl;
-								metrics[r]->Add(val1, val2);
-								valCtr += 1;
-							}
-
-						}
-					}
-					for(int r = 0; r < nrRegionPointers; r++) {
-						regionPtr[r]++;
-					}
-					i1Ptr++;
-					i2Ptr++;
-				}
-				cout << "Vals: " << valCtr << endl;
-				int noValue = 0;
-				for(int r = 0; r < _nrRegions; r++) {
-					double results = -1;
-
-					results = metrics[r]->Evaluate();
-					//cout << results << " " << i << " " << j << endl;
-					if(_twoSets) {
-						_results[r][i][j-_nrRows] = results;
-					}
-					else {
-						_results[r][i][j] = results;
-						_results[r][j][i] = results;
-					}
-				}
-
-				for(int r = 0; r < _nrRegions; r++) {
-					delete metrics[r];
-				}
-				delete [] metrics;
-				delete [] regionPtr;
 
+	void operator()(const blocked_range<int> &r) const {
+		for (int l = r.begin(); l != r.end(); l++) {
+			int i = _row + l / _nrCols;
+			int j = _col + l % _nrCols;
+			// Only pairs above the diagonal are evaluated for a single set
+			if (_filter->_twoSets || j > i) {
+				_filter->EvaluatePair(i, j);
 			}
 		}
 	}
 };
 
-#endif
-
 irtkPairwiseSimilarity::irtkPairwiseSimilarity()
 {
 	_nrRegions = -1;
 	_transformImages = false;
 	_padding = 0;
+	_twoSets = false;
+	_singleRegionMask = false;
+	_tileSize = PAIRWISE_SIMILARITY_TILE_SIZE;
 }
 ;
 void irtkPairwiseSimilarity::Initialize(int nrSubjects, int nrSubjects2, bool useMasks,
@@ -237,6 +106,8 @@ void irtkPairwiseSimilarity::Initialize(int nrSubjects, bool useMasks)
 {
 
 	_nrSubjects = nrSubjects;
+	_nrRows = nrSubjects;
+	_nrCols = nrSubjects;
 	_nrRegions = 1;
 	_useMasks = useMasks;
 	SetupRegions();
@@ -256,6 +127,11 @@ void irtkPairwiseSimilarity::Initialize(int nrSubjects, bool useMasks)
 void irtkPairwiseSimilarity::LoadImages(irtkGreyImage ** images)
 {
 	_images = images;
+	_fileNames.clear();
+	_nrBins.resize(GetNumberOfImages());
+	for (int i = 0; i < GetNumberOfImages(); i++) {
+		PrepareImage(i);
+	}
 	if (_nrRegions == -1)
 		SetupRegions();
 }
@@ -280,20 +156,25 @@ void irtkPairwiseSimilarity::LoadImages(string imagefilename, string imageDir)
 		from.close();
 	}
 
+	LoadImages(files, imageDir);
+}
+
+void irtkPairwiseSimilarity::LoadImages(vector<string> files, string imageDir)
+{
 	if ((int)files.size() != _nrSubjects && !(_twoSets && _nrRows + _nrCols == (int)files.size())) {
 		cerr << "Nr of files does not agree with nrSubjects provided" << endl;
 	}
-	int nrImages = _nrRows;
-	if (_twoSets)
-		nrImages += _nrCols;
-	for (int i = 0; i < nrImages; i++) {
-		cout << i << " " << files[i] << endl;
-		string name = imageDir + files[i];
-		_images[i] = new irtkGreyImage();
-		_images[i]->Read(name.c_str());
+	// Images are read tile by tile in GetSimilarities
+	_fileNames.clear();
+	_nrBins.resize(GetNumberOfImages());
+	for (int i = 0; i < GetNumberOfImages(); i++) {
+		_fileNames.push_back(imageDir + files[i]);
+		_images[i] = NULL;
 	}
-	if (_nrRegions == -1)
+	if (_nrRegions == -1) {
+		LoadTile(0, 1, 0, 1);
 		SetupRegions();
+	}
 }
 
 void irtkPairwiseSimilarity::SetTemplate(string filename)
@@ -359,6 +240,7 @@ void irtkPairwiseSimilarity::SetupRegions()
 			}
 		}
 		_nrRegions = ctr;
+		_singleRegionMask = true;
 		cout << "ctr " << ctr << endl;
 		_regions[0]->Write("/vol/vipdata/users/rw1008/ADNI/test_regions_20mm.nii.gz");
 
@@ -440,171 +322,325 @@ void irtkPairwiseSimilarity::WriteSimilarities(string dir, string namePrefix)
 	}
 }
 
-void irtkPairwiseSimilarity::GetSimilarities()
+int irtkPairwiseSimilarity::GetNumberOfImages()
 {
-	for (int i = 0; i < _nrRows; i++) {
-		cout << i << ": ";
-#ifdef HAS_TBB
-//			cout << "Nr of Regions: " << _nrRegions << endl;
-		task_scheduler_init init;
-		MultiThreadedSimilarity evaluate(_useMasks , _images, _regions,i, _results, _nrRegions,_similarityType, _twoSets, _nrRows,_singleRegionMask,_padding);
-		int blocks = -1;
-		if(i==0)
-		blocks = _nrSubjects;
-		else
-		blocks = 1;
-//			blocks = 10;
-//			blocks = 8;
-//			blocks = _nrSubjects;
-		if(_twoSets) {
-			if(i==0)
-			blocks = _nrRows+_nrCols;
-			else
-			blocks = 24;
-
-			parallel_for(blocked_range<int>(_nrRows, _nrRows+_nrCols, int(blocks)), evaluate);
+	if (_twoSets)
+		return _nrRows + _nrCols;
+	return _nrRows;
+}
+
+void irtkPairwiseSimilarity::PrepareImage(int i)
+{
+	irtkGreyPixel min, max;
+
+	// Rescale intensities once per image instead of once per pair
+	_nrBins[i] = 0;
+	if (_similarityType == 1) {
+		_images[i]->GetMinMax(&min, &max);
+		_nrBins[i] = irtkCalculateNumberOfBins(_images[i], 256, min, max);
+	}
+}
+
+void irtkPairwiseSimilarity::LoadTile(int row1, int row2, int col1, int col2)
+{
+	int i;
+	bool inTile;
+
+	// Images which have been passed in are kept in memory
+	if (_fileNames.empty())
+		return;
+
+	// Release images which are not in the tile, so that the images of the
+	// rows are kept for the next tile of the same rows
+	for (i = 0; i < GetNumberOfImages(); i++) {
+		inTile = (i >= row1 && i < row2) || (i >= col1 && i < col2);
+		if (!inTile && _images[i] != NULL) {
+			delete _images[i];
+			_images[i] = NULL;
 		}
-		else
-		parallel_for(blocked_range<int>(1, _nrRows, int(blocks)), evaluate);
-#else
-		for (int j = 0; j < _nrRows + _nrCols; j++) {
-			if (j > i || _twoSets) {
-				//	cout << _twoSets << " " << j << " " << _nrRows << " " << _nrSubjects << endl;
-				if (!_twoSets || (j > (_nrRows - 1))) {
-					irtkSimilarityMetric **metrics;
-					metrics = new irtkSimilarityMetric*[_nrRegions];
-					irtkGreyImage *i1, *i2;
-					i1 = _images[i];
-					if (_transformImages) {
+	}
+	for (i = 0; i < GetNumberOfImages(); i++) {
+		inTile = (i >= row1 && i < row2) || (i >= col1 && i < col2);
+		if (inTile && _images[i] == NULL) {
+			cout << i << " " << _fileNames[i] << endl;
+			_images[i] = new irtkGreyImage();
+			_images[i]->Read(_fileNames[i].c_str());
+			PrepareImage(i);
+		}
+	}
+}
 
-					}
-					else {
-						i2 = _images[j];
-					}
-					//cout << i << " " << j << endl;
-
-					irtkGreyPixel * i1Ptr = i1->GetPointerToVoxels();
-					irtkGreyPixel * i2Ptr = i2->GetPointerToVoxels();
-					int numberOfBins = 256;
-
-					for (int k = 0; k < _nrRegions; k++) {
-
-						switch (_similarityType)
-						{
-						//					if(_similarityType == 1){
-						case 1:
-							irtkGreyPixel i1_min, i1_max, i1_nbinss;
-							irtkGreyPixel i2_min, i2_max, i2_nbinss;
-
-							i1->GetMinMax(&i1_min, &i1_max);
-							i2->GetMinMax(&i2_min, &i2_max);
-
-							i2_nbinss = irtkCalculateNumberOfBins(i2, numberOfBins,
-									i2_min, i2_max);
-							i1_nbinss = irtkCalculateNumberOfBins(i1, numberOfBins,
-									i1_min, i1_max);
-							metrics[k] = new irtkNormalisedMutualInformationSimilarityMetric(i1_nbinss,
-									i2_nbinss);
-							//					}
-							break;
-							//					else{
-						case 2:
-							metrics[k] = new irtkSSDSimilarityMetric();
-							break;
-						case 3:
-							metrics[k] = new irtkCrossCorrelationSimilarityMetric();
-							break;
-						default:
-							metrics[k] = new irtkSSDSimilarityMetric();
-						}
-						metrics[k]->Reset();
-					}
+irtkSimilarityMetric *irtkPairwiseSimilarity::NewMetric(int i, int j)
+{
+	irtkSimilarityMetric *metric;
+
+	switch (_similarityType) {
+		case 1:
+			metric = new irtkNormalisedMutualInformationSimilarityMetric(_nrBins[i], _nrBins[j]);
+			break;
+		case 2:
+			metric = new irtkSSDSimilarityMetric();
+			break;
+		case 3:
+			metric = new irtkCrossCorrelationSimilarityMetric();
+			break;
+		default:
+			metric = new irtkSSDSimilarityMetric();
+	}
+	metric->Reset();
+	return metric;
+}
 
-//						cout << "region: finished. nrRegions: " << _nrRegions << endl;
-					irtkGreyPixel **regionPtr;
-					int nrRegionPointers = _nrRegions;
-					if (_singleRegionMask) {
-						nrRegionPointers = 1;
-					}
-					if (_useMasks) {
-						regionPtr = new irtkGreyPixel*[nrRegionPointers];
-						for (int k = 0; k < nrRegionPointers; k++) {
-							regionPtr[k] = new irtkGreyPixel;
-							regionPtr[k] = _regions[k]->GetPointerToVoxels();
-							//		cout << "region: " << k << endl;
-						}
-					}
-					else {
-						regionPtr = new irtkGreyPixel*[1];
-						regionPtr[0] = _regions[0]->GetPointerToVoxels();
-					}
-//						cout << "a" << endl;
-					int valCtr = 0;
-					for (int ii = 0; ii < i1->GetNumberOfVoxels(); ii++) {
-						int val1 = *i1Ptr;
-						int val2 = *i2Ptr;
-						if (val1 > 0 && val2 > 0) {
-							for (int r = 0; r < _nrRegions; r++) {
-								bool voxelInRegion = false;
-								if (!_singleRegionMask) {
-									if (*regionPtr[r] == 0) {
-										voxelInRegion = true;
-									}
-								}
-								else {
-									if (*regionPtr[0] == r) {
-										voxelInRegion = true;
-									}
-								}
-								if (voxelInRegion) {
-									//								if(valCtr == 11)
-									//if(valCtr <= 20)
-									//cout << ii << " " << val1 << ", " << val2 << endl;
-									//									cout << *regionPtr[0] << endl;
-									metrics[r]->Add(val1, val2);
-									valCtr += 1;
-								}
+void irtkPairwiseSimilarity::EvaluatePair(int i, int j)
+{
+	int n, r, nrVoxels;
+	irtkGreyPixel *i1Ptr, *i2Ptr, *labelPtr, **regionPtr;
+	irtkSimilarityMetric **metrics;
 
-							}
-						}
-						for (int r = 0; r < nrRegionPointers; r++) {
-							regionPtr[r]++;
-						}
-						i1Ptr++;
-						i2Ptr++;
-					}
-//						cout << "Vals: " << valCtr << endl;
-					for (int r = 0; r < _nrRegions; r++) {
-						double results = -1;
-//							cout << "a" << endl;
-						results = metrics[r]->Evaluate();
-//							cout << "res: " << results << endl;
-
-						cout << results << endl;
-						if (_twoSets) {
-//								cout << r << " " << i << " " << j << " " << _nrRows << endl;
-							_results[r][i][j - _nrRows] = results;
-//								cout << "b" << endl;
-						}
-						else {
-							_results[r][i][j] = results;
-							_results[r][j][i] = results;
-						}
-					}
+	metrics = new irtkSimilarityMetric*[_nrRegions];
+	for (r = 0; r < _nrRegions; r++) {
+		metrics[r] = NewMetric(i, j);
+	}
 
-					for (int r = 0; r < _nrRegions; r++) {
-						delete metrics[r];
+	i1Ptr = _images[i]->GetPointerToVoxels();
+	i2Ptr = _images[j]->GetPointerToVoxels();
+	nrVoxels = _images[i]->GetNumberOfVoxels();
+
+	// All regions are evaluated in a single pass over the images
+	if (_singleRegionMask) {
+		// Voxels with label r belong to region r
+		labelPtr = _regions[0]->GetPointerToVoxels();
+		for (n = 0; n < nrVoxels; n++) {
+			if (i1Ptr[n] > _padding && i2Ptr[n] > _padding && labelPtr[n] >= 0 && labelPtr[n] < _nrRegions) {
+				metrics[labelPtr[n]]->Add(i1Ptr[n], i2Ptr[n]);
+			}
+		}
+	}
+	else {
+		// Voxels with value 0 in mask r belong to region r
+		regionPtr = new irtkGreyPixel*[_nrRegions];
+		for (r = 0; r < _nrRegions; r++) {
+			regionPtr[r] = _regions[_useMasks ? r : 0]->GetPointerToVoxels();
+		}
+		for (n = 0; n < nrVoxels; n++) {
+			if (i1Ptr[n] > _padding && i2Ptr[n] > _padding) {
+				for (r = 0; r < _nrRegions; r++) {
+					if (regionPtr[r][n] == 0) {
+						metrics[r]->Add(i1Ptr[n], i2Ptr[n]);
 					}
-					delete[] metrics;
-					delete[] regionPtr;
+				}
+			}
+		}
+		delete[] regionPtr;
+	}
+
+	for (r = 0; r < _nrRegions; r++) {
+		double results = metrics[r]->Evaluate();
+		if (_twoSets) {
+			_results[r][i][j - _nrRows] = results;
+		}
+		else {
+			_results[r][i][j] = results;
+			_results[r][j][i] = results;
+		}
+		delete metrics[r];
+	}
+	delete[] metrics;
+}
+
+bool irtkPairwiseSimilarity::ReadCheckpoint(vector<bool> &done, int nrTileCols)
+{
+	string line, token, name;
+	int nrRows, nrCols, nrRegions, tileSize, twoSets, a, b, i, j, r, p, offset;
+	vector<int> rows, cols;
+	vector<double> values;
+
+	// Start from scratch if there is no checkpoint yet. All lines are written
+	// with a line break, a line without one has been cut off.
+	ifstream from(_checkpointName.c_str());
+	if (!from) {
+		return false;
+	}
+	if (!getline(from, line) || from.eof()) {
+		return false;
+	}
+	istringstream header(line);
+	if (!(header >> name >> nrRows >> nrCols >> nrRegions >> tileSize >> twoSets) || name != "irtkPairwiseSimilarity") {
+		return false;
+	}
+	if (nrRows != _nrRows || nrCols != _nrCols || nrRegions != _nrRegions || tileSize != _tileSize || twoSets != int(_twoSets)) {
+		cerr << "irtkPairwiseSimilarity::ReadCheckpoint: Checkpoint " << _checkpointName << " does not match similarities" << endl;
+		exit(1);
+	}
+	offset = _twoSets ? _nrRows : 0;
+
+	// Each tile starts with a line "tile a b" which is followed by the lines
+	// of all of its pairs. The results of a tile are only used if all of its
+	// pairs have been written, an interrupted tile is dropped.
+	while (getline(from, line)) {
+		istringstream tile(line);
+		if (from.eof() || !(tile >> token >> a >> b) || token != "tile" ||
+		    a < 0 || b < 0 || b >= nrTileCols || a * nrTileCols + b >= int(done.size())) {
+			return false;
+		}
+		rows.clear();
+		cols.clear();
+		values.clear();
+		for (i = a * _tileSize; i < min((a + 1) * _tileSize, _nrRows); i++) {
+			for (j = offset + b * _tileSize; j < offset + min((b + 1) * _tileSize, _nrCols); j++) {
+				if (_twoSets || j > i) {
+					rows.push_back(i);
+					cols.push_back(j);
+				}
+			}
+		}
+		for (p = 0; p < int(rows.size()); p++) {
+			if (!getline(from, line) || from.eof()) {
+				return false;
+			}
+			istringstream pair(line);
+			if (!(pair >> i >> j)) {
+				return false;
+			}
+			if (i != rows[p] || j != cols[p]) {
+				cerr << "irtkPairwiseSimilarity::ReadCheckpoint: Pair " << i << ", " << j << " of checkpoint "
+				     << _checkpointName << " is not in tile " << a << ", " << b << endl;
+				exit(1);
+			}
+			// Values may be nan or inf, so they are converted by strtod
+			for (r = 0; r < _nrRegions && (pair >> token); r++) {
+				values.push_back(strtod(token.c_str(), NULL));
+			}
+			if (r < _nrRegions) {
+				return false;
+			}
+		}
+		for (p = 0; p < int(rows.size()); p++) {
+			for (r = 0; r < _nrRegions; r++) {
+				if (_twoSets) {
+					_results[r][rows[p]][cols[p] - _nrRows] = values[p * _nrRegions + r];
+				}
+				else {
+					_results[r][rows[p]][cols[p]] = values[p * _nrRegions + r];
+					_results[r][cols[p]][rows[p]] = values[p * _nrRegions + r];
+				}
+			}
+		}
+		done[a * nrTileCols + b] = true;
+	}
+	return true;
+}
 
+void irtkPairwiseSimilarity::WriteCheckpointTile(ostream &to, int a, int b)
+{
+	int i, j, r, offset;
+
+	offset = _twoSets ? _nrRows : 0;
+	to << "tile " << a << " " << b << endl;
+	for (i = a * _tileSize; i < min((a + 1) * _tileSize, _nrRows); i++) {
+		for (j = offset + b * _tileSize; j < offset + min((b + 1) * _tileSize, _nrCols); j++) {
+			if (_twoSets || j > i) {
+				to << i << " " << j;
+				for (r = 0; r < _nrRegions; r++) {
+					to << " " << _results[r][i][j - offset];
 				}
+				to << endl;
 			}
 		}
+	}
+}
+
+void irtkPairwiseSimilarity::WriteCheckpoint(const vector<bool> &done, int nrTileCols)
+{
+	int a, b;
+
+	// The checkpoint is written to a temporary file which then replaces the
+	// previous checkpoint, so that an interrupted write leaves it intact
+	string name = _checkpointName + ".tmp";
+	ofstream to(name.c_str());
+	if (!to) {
+		cerr << "irtkPairwiseSimilarity::WriteCheckpoint: Can't open file " << name << endl;
+		exit(1);
+	}
+	to.precision(17);
+	to << "irtkPairwiseSimilarity " << _nrRows << " " << _nrCols << " " << _nrRegions << " " << _tileSize << " " << int(_twoSets) << endl;
 
+	for (a = 0; a * nrTileCols < int(done.size()); a++) {
+		for (b = 0; b < nrTileCols; b++) {
+			if (done[a * nrTileCols + b])
+				WriteCheckpointTile(to, a, b);
+		}
+	}
+	to.close();
+	if (!to) {
+		cerr << "irtkPairwiseSimilarity::WriteCheckpoint: Can't write file " << name << endl;
+		exit(1);
+	}
+
+#ifdef WIN32
+	// Existing files are not replaced by rename on Windows
+	remove(_checkpointName.c_str());
 #endif
+	if (rename(name.c_str(), _checkpointName.c_str()) != 0) {
+		cerr << "irtkPairwiseSimilarity::WriteCheckpoint: Can't rename " << name << " to " << _checkpointName << endl;
+		exit(1);
 	}
+}
 
+void irtkPairwiseSimilarity::AppendCheckpoint(int a, int b)
+{
+	ofstream to(_checkpointName.c_str(), ios::out | ios::app);
+	if (!to) {
+		cerr << "irtkPairwiseSimilarity::AppendCheckpoint: Can't open file " << _checkpointName << endl;
+		exit(1);
+	}
+	to.precision(17);
+	WriteCheckpointTile(to, a, b);
+	to.close();
+	if (!to) {
+		cerr << "irtkPairwiseSimilarity::AppendCheckpoint: Can't write file " << _checkpointName << endl;
+		exit(1);
+	}
+}
+
+void irtkPairwiseSimilarity::GetSimilarities()
+{
+	int a, b, nrTileRows, nrTileCols, row1, row2, col1, col2, offset;
+	vector<bool> done;
+
+	// Pairs are evaluated in tiles of _tileSize rows by _tileSize columns
+	nrTileRows = (_nrRows + _tileSize - 1) / _tileSize;
+	nrTileCols = (_nrCols + _tileSize - 1) / _tileSize;
+	done.assign(nrTileRows * nrTileCols, false);
+	offset = _twoSets ? _nrRows : 0;
+
+	// Resume from the completed tiles of the checkpoint. A new checkpoint, or
+	// one whose last tile was interrupted, is rewritten with the completed tiles.
+	if (_checkpointName != "" && !ReadCheckpoint(done, nrTileCols))
+		WriteCheckpoint(done, nrTileCols);
+
+	task_scheduler_init init(tbb_no_threads);
+	for (a = 0; a < nrTileRows; a++) {
+		for (b = 0; b < nrTileCols; b++) {
+			// Only tiles on or above the diagonal are evaluated for a single set
+			if (done[a * nrTileCols + b] || (!_twoSets && b < a))
+				continue;
+			row1 = a * _tileSize;
+			row2 = min(row1 + _tileSize, _nrRows);
+			col1 = offset + b * _tileSize;
+			col2 = offset + min((b + 1) * _tileSize, _nrCols);
+			cout << "Tile " << a << ", " << b << endl;
+
+			LoadTile(row1, row2, col1, col2);
+			irtkMultiThreadedPairwiseSimilarity evaluate(this, row1, col1, row2 - row1, col2 - col1);
+			parallel_for(blocked_range<int>(0, (row2 - row1) * (col2 - col1)), evaluate);
+
+			done[a * nrTileCols + b] = true;
+			if (_checkpointName != "")
+				AppendCheckpoint(a, b);
+		}
+	}
+	init.terminate();
 }
 
 void irtkPairwiseSimilarity::SetPadding(int padding)
@@ -617,3 +653,12 @@ double irtkPairwiseSimilarity::GetSimilarity(int region, int row, int col)
 	return _results[region][row][col];
 }
 
+void irtkPairwiseSimilarity::SetTileSize(int tileSize)
+{
+	_tileSize = tileSize;
+}
+
+void irtkPairwiseSimilarity::SetCheckpoint(string filename)
+{
+	_checkpointName = filename;
+}
@@ -27,6 +27,48 @@ See LICENSE for details
 #include <errno.h>
 #include <sstream>
 
+/// Tolerance of residuals of eigenvectors computed by the Lanczos method
+#define SPECTRAL_CLUSTERING_TOLERANCE 1e-10
+
+/// Maximum size of the Lanczos basis relative to the number of eigenvectors
+#define SPECTRAL_CLUSTERING_BASIS_FACTOR 4
+
+/// Maximum number of restarts of the Lanczos method
+#define SPECTRAL_CLUSTERING_MAX_RESTARTS 1000
+
+class irtkMultiThreadedSpectralClusteringMultiply
+{
+
+	/// Pointer to spectral clustering
+	irtkSpectralClustering *_filter;
+
+	/// Input and output vectors
+	double *_x, *_y;
+
+public:
+
+	irtkMultiThreadedSpectralClusteringMultiply(irtkSpectralClustering *filter, double *x, double *y) {
+		_filter = filter;
+		_x = x;
+		_y = y;
+	}
+
+	void operator()(const blocked_range<int> &r) const {
+		const vector<int> &start = _filter->_graphStart;
+		const vector<int> &index = _filter->_graphIndex;
+		const vector<double> &weight = _filter->_graphWeight;
+		const vector<double> &d = _filter->_invSqrtDegree;
+
+		for(int i = r.begin(); i != r.end(); i++){
+			double sum = 0;
+			for(int n = start[i]; n < start[i + 1]; n++){
+				sum += weight[n] * d[index[n]] * _x[index[n]];
+			}
+			_y[i] = d[i] * sum;
+		}
+	}
+};
+
 irtkSpectralClustering::irtkSpectralClustering(int nrSubjects, int nrFeatures){	
 	_nrSubjects = nrSubjects;
 	_nrFeatures = nrFeatures;
@@ -40,7 +82,190 @@ irtkSpectralClustering::irtkSpectralClustering(int nrSubjects, int nrFeatures){
 
 
 
+void irtkSpectralClustering::Multiply(double *x, double *y){
+	irtkMultiThreadedSpectralClusteringMultiply body(this, x, y);
+	parallel_for(blocked_range<int>(0, _nrSubjects), body);
+}
+
+void irtkSpectralClustering::DoSparseSpectralEmbedding(){
+	int i, j, l, m, n, nev, maxBasis, nrKept, restart, pass;
+	unsigned int seed;
+	double beta, dot;
+	bool converged;
+	vector<double *> q;
+	vector<double> h;
+	irtkEigenAnalysisD *ea;
+
+	n = _nrSubjects;
+	nev = _nrFeatures + 1;
+	if(nev > n){
+		cerr << "irtkSpectralClustering::DoSparseSpectralEmbedding: Number of features must be less than number of subjects" << endl;
+		exit(1);
+	}
+
+	// Degrees of subjects, isolated subjects are ignored
+	_invSqrtDegree.resize(n);
+	for(i = 0; i < n; i++){
+		double dVal = 0;
+		for(j = _graphStart[i]; j < _graphStart[i + 1]; j++){
+			dVal += _graphWeight[j];
+		}
+		_invSqrtDegree[i] = (dVal > 0) ? 1/sqrt(dVal) : 0;
+	}
+
+	// The basis is limited to a few times the number of eigenvectors. When it
+	// is full, the Lanczos method is restarted with the leading Ritz vectors.
+	maxBasis = min(n, SPECTRAL_CLUSTERING_BASIS_FACTOR * nev + 10);
+	nrKept = min(2 * nev, maxBasis - 1);
+
+	task_scheduler_init init(tbb_no_threads);
+
+	// Lanczos iterations for the largest eigenvalues of D^-1/2 W D^-1/2, which
+	// correspond to the smallest eigenvalues of the normalised Laplacian. With
+	// full reorthogonalisation the projection H = Q^T A Q is accumulated from
+	// the coefficients of the orthogonalisation, so that after a restart H is
+	// no longer tridiagonal but A Q = Q H + w e^T still holds.
+	double *w = new double[n];
+	h.assign(maxBasis * maxBasis, 0);
+	seed = 1;
+	beta = 0;
+	ea = NULL;
+	converged = false;
+	for(restart = 0; !converged; restart++){
+		for(m = q.size(); m < maxBasis && !converged; m++){
+
+			// Start with pseudo-random vector, and restart with a new one if
+			// the Krylov subspace is invariant
+			if(m == 0 || beta < SPECTRAL_CLUSTERING_TOLERANCE){
+				for(i = 0; i < n; i++){
+					seed = seed * 1103515245 + 12345;
+					w[i] = ((seed >> 16) & 0x7fff) / 32768.0 - 0.5;
+				}
+			}
+
+			// Orthogonalise against all basis vectors, applied twice
+			for(pass = 0; pass < 2; pass++){
+				for(l = 0; l < m; l++){
+					dot = 0;
+					for(i = 0; i < n; i++){
+						dot += q[l][i] * w[i];
+					}
+					for(i = 0; i < n; i++){
+						w[i] -= dot * q[l][i];
+					}
+				}
+				dot = 0;
+				for(i = 0; i < n; i++){
+					dot += w[i] * w[i];
+				}
+				dot = sqrt(dot);
+				for(i = 0; i < n; i++){
+					w[i] /= dot;
+				}
+			}
+			q.push_back(w);
+			w = new double[n];
+
+			Multiply(q[m], w);
+			for(l = 0; l <= m; l++){
+				h[l * maxBasis + m] = 0;
+			}
+			for(pass = 0; pass < 2; pass++){
+				for(l = 0; l <= m; l++){
+					dot = 0;
+					for(i = 0; i < n; i++){
+						dot += q[l][i] * w[i];
+					}
+					for(i = 0; i < n; i++){
+						w[i] -= dot * q[l][i];
+					}
+					h[l * maxBasis + m] += dot;
+				}
+			}
+			for(l = 0; l < m; l++){
+				h[m * maxBasis + l] = h[l * maxBasis + m];
+			}
+			beta = 0;
+			for(i = 0; i < n; i++){
+				beta += w[i] * w[i];
+			}
+			beta = sqrt(beta);
+
+			// Ritz values of projection, checked every few iterations and
+			// before a restart
+			l = m + 1;
+			if(l == n || l == maxBasis || (l >= nev && beta < SPECTRAL_CLUSTERING_TOLERANCE) || (l >= 2 * nev + 10 && l % 10 == 0)){
+				delete ea;
+				ea = new irtkEigenAnalysisD(l);
+				for(i = 0; i < l; i++){
+					for(j = 0; j < l; j++){
+						ea->Matrix(i, j) = h[i * maxBasis + j];
+					}
+				}
+				ea->DecrSortEigenStuff();
+				converged = (l >= nev);
+				for(j = 0; j < nev && l < n; j++){
+					if(beta * fabs(ea->Eigenvector(l - 1, j)) > SPECTRAL_CLUSTERING_TOLERANCE){
+						converged = false;
+					}
+				}
+			}
+		}
+		if(converged)
+			break;
+		if(restart == SPECTRAL_CLUSTERING_MAX_RESTARTS){
+			cerr << "irtkSpectralClustering::DoSparseSpectralEmbedding: No convergence after " << restart << " restarts" << endl;
+			break;
+		}
+
+		// Replace the basis by the leading Ritz vectors, whose projection is
+		// diagonal, and continue with the residual
+		vector<double *> y(nrKept);
+		for(j = 0; j < nrKept; j++){
+			y[j] = new double[n];
+			for(i = 0; i < n; i++){
+				double val = 0;
+				for(l = 0; l < maxBasis; l++){
+					val += q[l][i] * ea->Eigenvector(l, j);
+				}
+				y[j][i] = val;
+			}
+		}
+		for(l = 0; l < maxBasis; l++){
+			delete []q[l];
+		}
+		q = y;
+		h.assign(maxBasis * maxBasis, 0);
+		for(j = 0; j < nrKept; j++){
+			h[j * maxBasis + j] = ea->Eigenvalue(j);
+		}
+	}
+	delete []w;
+
+	// Ritz vectors, skipping the trivial eigenvector
+	for(i = 0; i < n; i++){
+		for(j = 0; j < _nrFeatures; j++){
+			double val = 0;
+			for(l = 0; l < (int)q.size(); l++){
+				val += q[l][i] * ea->Eigenvector(l, j + 1);
+			}
+			_features[i][j] = val;
+		}
+	}
+	for(l = 0; l < (int)q.size(); l++){
+		delete []q[l];
+	}
+	delete ea;
+	init.terminate();
+}
+
 void irtkSpectralClustering::DoSpectralEmbedding(){
+
+	// Use iterative solver for sparse graph
+	if(HasNeighbourGraph()){
+		DoSparseSpectralEmbedding();
+		return;
+	}
 		
 	int rows = _nrSubjects;
 	irtkMatrix wTrans;
@@ -33,6 +33,8 @@ See LICENSE for details
 class irtkBSplineInterpolateImageFunction : public irtkInterpolateImageFunction
 {
 
+  friend class irtkMultiThreadedBSplineInterpolateImageFunctionPrefilter;
+
 private:
 
   /// Degree of spline
@@ -62,6 +64,21 @@ private:
   /// Image of spline coefficient
   irtkRealImage _coeff;
 
+  /// Number of indices outside the image covered by the index tables
+  int _margin;
+
+  /// Tables of mirrored indices in X, Y and Z-direction (offset by margin)
+  int *_xIndex, *_yIndex, *_zIndex;
+
+  /// Mirror boundary condition for index of image with given dimension
+  static int Mirror(int, int, int);
+
+  /// Allocate table of mirrored indices for image with given dimension
+  int *IndexTable(int, int);
+
+  /// Evaluate B-spline of given degree with or without boundary conditions
+  template <int Degree> double EvaluateSpline(double, double, double, double, bool);
+
   /// Initialize anti-causal coefficients
   static double InitialAntiCausalCoefficient(double *, int, double z);
 
@@ -102,6 +119,11 @@ public:
    *  above, but is only defined inside the image domain. */
   virtual double EvaluateInside(double, double, double, double = 0);
 
+  /** Evaluate the filter at a batch of image locations (in pixels). This
+   *  avoids the dispatch on the spline degree and the virtual function call
+   *  for every location. */
+  virtual void Evaluate(int, const double *, const double *, const double *, double *, double = 0);
+
 };
 
 inline void irtkBSplineInterpolateImageFunction::PutSplineDegree(int SplineDegree)
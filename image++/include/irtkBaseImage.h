@@ -239,8 +239,8 @@ public:
   /// Flip z and t axis
   virtual void FlipZT(int) = 0;
 
-  /// Read file and construct image
-  static irtkBaseImage *New(const char *);
+  /// Read file and construct image, optionally wrapping a memory mapped file
+  static irtkBaseImage *New(const char *, irtkMemoryMapMode = MemoryMap_None);
 
   /// Read file and construct image
   static irtkBaseImage *New(const irtkBaseImage *);
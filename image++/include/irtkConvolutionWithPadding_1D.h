@@ -51,6 +51,11 @@ protected:
    */
   virtual double Run(int, int, int, int);
 
+  /** Convolve a block of lines. This method overrides the member function
+   *  ConvolveLines() of the base class and ignores any padded values.
+   */
+  virtual void ConvolveLines(const VoxelType *, int, int, VoxelType *, long, long);
+
 public:
 
   /// Constructor
@@ -18,18 +18,26 @@ See LICENSE for details
 
 #define _IRTKCONVOLUTION_1D_H
 
+/// Number of neighbouring lines which are convolved together
+#define IRTK_CONVOLUTION_LINES 16
+
+template <class VoxelType> class irtkMultiThreadedConvolution_1D;
+
 /**
  * Class for one-dimensional convolution.
  *
  * This class defines and implements one-dimensional convolutions of an image
  * with a filter kernel. The convolution is computed along the x-axis. This
  * class assumes that the filter kernel is one-dimensional and its size along
- * the y- and z-axis must be 1.
+ * the y- and z-axis must be 1. Alternatively, the convolution can be applied
+ * to image views, in which case it is computed along the x-axis of the view.
  */
 
 template <class VoxelType> class irtkConvolution_1D : public irtkConvolution<VoxelType>
 {
 
+  friend class irtkMultiThreadedConvolution_1D<VoxelType>;
+
 protected:
 
   /// Second input, i.e. the filter kernel
@@ -48,6 +56,13 @@ protected:
    */
   virtual double Run(int, int, int, int);
 
+  /** Convolve a block of lines. The first argument is a copy of the m input
+   *  lines of length n, interleaved such that voxel i of line b is at
+   *  position i*m+b. Voxel i of output line b is written to out[i*stride +
+   *  b*offset].
+   */
+  virtual void ConvolveLines(const VoxelType *, int n, int m, VoxelType *out, long stride, long offset);
+
 public:
 
   /// Constructor
@@ -58,6 +73,13 @@ public:
 
   /// Initialize the convolution filter
   virtual void Initialize();
+
+  /** Run the convolution filter along the x-axis of an image view. The input
+   *  and output views must have the same size. They must either be the same
+   *  view (in-place filtering) or not share any part of the image buffer.
+   *  The filter kernel must be set via SetInput2().
+   */
+  virtual void Run(const irtkGenericImageView<VoxelType> &, const irtkGenericImageView<VoxelType> &);
 };
 
 #endif
@@ -32,7 +32,7 @@ class irtkFileToImage : protected irtkCifstream
 {
 
   /// File name of image file
-  const char *_imagename;
+  char *_imagename;
 
 protected:
 
@@ -66,6 +66,14 @@ protected:
   /// Debug flag
   int _debug;
 
+  /// Memory mapping mode (default: MemoryMap_None)
+  irtkMemoryMapMode _mapping;
+
+  /** Map image data into memory. Returns NULL if the image data cannot be
+   *  mapped, e.g. because the file is compressed or needs byte swapping.
+   */
+  virtual irtkImage *MapOutput();
+
   /** Read header. This is an abstract function. Each derived class has to
    *  implement this function in order to initialize image dimensions, voxel
    *  dimensions, voxel type and a lookup table which the address for each
@@ -106,6 +114,13 @@ public:
   /// Put debug flag
   virtual void PutDebugFlag(int);
 
+  /// Get memory mapping mode
+  virtual irtkMemoryMapMode GetMemoryMapMode();
+
+  /// Put memory mapping mode. If the image data can be mapped, GetOutput()
+  /// returns an image which wraps the mapped file instead of a copy
+  virtual void PutMemoryMapMode(irtkMemoryMapMode);
+
   /// Print image file information
   virtual void Print();
 
@@ -46,6 +46,12 @@ protected:
   /// Pointer to image data
   VoxelType ****_matrix;
 
+  /// Memory mapped file holding the image data (NULL if image data is owned)
+  irtkMemoryMappedFile *_mappedFile;
+
+  /// Free image data, unmaps the file if image data is memory mapped
+  void FreeMatrix(VoxelType ****);
+
 public:
 
   /// Default constructor
@@ -69,14 +75,33 @@ public:
   /// Destructor
   ~irtkGenericImage(void);
 
-  /// Initialize an image
+  /** Initialize an image with voxels set to zero. Memory mapped image data
+   *  is replaced by newly allocated memory and the mapped file is unchanged.
+   */
   void Initialize(const irtkImageAttributes &);
 
+  /** Initialize an image whose data is stored at the given offset of a memory
+   *  mapped file. The image takes ownership of the mapped file. Voxels must
+   *  be stored in native byte order.
+   */
+  void Initialize(const irtkImageAttributes &, irtkMemoryMappedFile *, long);
+
+  /// Returns whether image data is memory mapped
+  bool IsMemoryMapped() const;
+
+  /** Release memory of image data mapped in read-only or read-write mode.
+   *  The data is paged in again from the file when it is accessed.
+   */
+  void ReleaseMappedMemory();
+
   /// Clear an image
   void Clear();
 
-  /// Read image from file
-  void Read (const char *);
+  /** Read image from file. Uncompressed files with voxels of the same type
+   *  and in native byte order can be memory mapped instead of read. Files
+   *  whose intensities are scaled are always mapped copy-on-write.
+   */
+  void Read (const char *, irtkMemoryMapMode = MemoryMap_None);
 
   /// Write image to file
   void Write(const char *);
@@ -389,6 +414,16 @@ template <class VoxelType> inline VoxelType& irtkGenericImage<VoxelType>::operat
 #endif
 }
 
+template <class VoxelType> inline bool irtkGenericImage<VoxelType>::IsMemoryMapped() const
+{
+  return (_mappedFile != NULL);
+}
+
+template <class VoxelType> inline void irtkGenericImage<VoxelType>::ReleaseMappedMemory()
+{
+  if (_mappedFile != NULL) _mappedFile->Release();
+}
+
 template <class VoxelType> inline int irtkGenericImage<VoxelType>::VoxelToIndex(int x, int y, int z, int t) const
 {
 #ifdef NO_BOUNDS
@@ -0,0 +1,330 @@
+/*=========================================================================
+
+  Library   : Image Registration Toolkit (IRTK)
+  Module    : $Id$
+  Copyright : Imperial College, Department of Computing
+              Visual Information Processing (VIP), 2008 onwards
+  Date      : $Date$
+  Version   : $Revision$
+  Changes   : $Author$
+
+Copyright (c) 1999-2014 and onwards, Imperial College London
+All rights reserved.
+See LICENSE for details
+
+=========================================================================*/
+
+#ifndef _IRTKGENERICIMAGEVIEW_H
+
+#define _IRTKGENERICIMAGEVIEW_H
+
+/**
+ * Non-owning strided view of the voxels of an image.
+ *
+ * A view consists of a pointer to its first voxel, its size along the four
+ * axes and the distance in memory (stride, in voxels) between neighbouring
+ * voxels along each axis. Regions, time frames, axis permutations and
+ * reflections of a view are again views of the same memory, so they can be
+ * created without copying any voxels. A view does not keep the image alive
+ * and is invalidated when the image is reallocated or deleted. It carries no
+ * geometric information (voxel size, origin, orientation).
+ */
+
+template <class VoxelType> class irtkGenericImageView
+{
+
+  /// Pointer to voxel (0, 0, 0, 0)
+  VoxelType *_data;
+
+  /// Size of view
+  int _x, _y, _z, _t;
+
+  /// Strides (in voxels)
+  long _sx, _sy, _sz, _st;
+
+public:
+
+  /// Default constructor (empty view)
+  irtkGenericImageView();
+
+  /// Constructor for view of given memory, size and strides
+  irtkGenericImageView(VoxelType *, int, int, int, int, long, long, long, long);
+
+  /// Constructor for view of entire image
+  irtkGenericImageView(const irtkGenericImage<VoxelType> &);
+
+  /// Size of view along x
+  int GetX() const;
+
+  /// Size of view along y
+  int GetY() const;
+
+  /// Size of view along z
+  int GetZ() const;
+
+  /// Size of view along t
+  int GetT() const;
+
+  /// Number of voxels in view
+  int GetNumberOfVoxels() const;
+
+  /// Stride along x
+  long GetXStride() const;
+
+  /// Stride along y
+  long GetYStride() const;
+
+  /// Stride along z
+  long GetZStride() const;
+
+  /// Stride along t
+  long GetTStride() const;
+
+  /// Returns whether the voxels of the view are stored contiguously in x, y, z, t order
+  bool IsContiguous() const;
+
+  /// Function for pixel access via pointers
+  VoxelType *GetPointerToVoxels(int = 0, int = 0, int = 0, int = 0) const;
+
+  /// Function for pixel access via operators
+  VoxelType &operator()(int, int, int, int = 0) const;
+
+  /// Function for pixel get access
+  VoxelType Get(int, int, int, int = 0) const;
+
+  /// Function for pixel put access
+  void Put(int, int, int, int, VoxelType) const;
+
+  /// View of region [x1, x2) x [y1, y2) x [z1, z2) of all time frames
+  irtkGenericImageView Region(int, int, int, int, int, int) const;
+
+  /// View of region [x1, x2) x [y1, y2) x [z1, z2) x [t1, t2)
+  irtkGenericImageView Region(int, int, int, int, int, int, int, int) const;
+
+  /// View of time frame
+  irtkGenericImageView Frame(int) const;
+
+  /// View with x and y axis swapped (same voxel order as irtkGenericImage::FlipXY)
+  irtkGenericImageView FlipXY() const;
+
+  /// View with x and z axis swapped (same voxel order as irtkGenericImage::FlipXZ)
+  irtkGenericImageView FlipXZ() const;
+
+  /// View with y and z axis swapped (same voxel order as irtkGenericImage::FlipYZ)
+  irtkGenericImageView FlipYZ() const;
+
+  /// View with x and t axis swapped (same voxel order as irtkGenericImage::FlipXT)
+  irtkGenericImageView FlipXT() const;
+
+  /// View reflected along x (same voxel order as irtkGenericImage::ReflectX)
+  irtkGenericImageView ReflectX() const;
+
+  /// View reflected along y (same voxel order as irtkGenericImage::ReflectY)
+  irtkGenericImageView ReflectY() const;
+
+  /// View reflected along z (same voxel order as irtkGenericImage::ReflectZ)
+  irtkGenericImageView ReflectZ() const;
+
+  /// Copy voxels of another view of the same size into this view
+  void Copy(const irtkGenericImageView &) const;
+
+};
+
+template <class VoxelType> inline irtkGenericImageView<VoxelType>::irtkGenericImageView()
+{
+  _data = NULL;
+  _x  = _y  = _z  = _t  = 0;
+  _sx = _sy = _sz = _st = 0;
+}
+
+template <class VoxelType> inline irtkGenericImageView<VoxelType>::irtkGenericImageView(VoxelType *data, int x, int y, int z, int t, long sx, long sy, long sz, long st)
+{
+  _data = data;
+  _x  = x;
+  _y  = y;
+  _z  = z;
+  _t  = t;
+  _sx = sx;
+  _sy = sy;
+  _sz = sz;
+  _st = st;
+}
+
+template <class VoxelType> inline irtkGenericImageView<VoxelType>::irtkGenericImageView(const irtkGenericImage<VoxelType> &image)
+{
+  _x  = image.GetX();
+  _y  = image.GetY();
+  _z  = image.GetZ();
+  _t  = image.GetT();
+  _data = (_x*_y*_z*_t > 0) ? image.GetPointerToVoxels() : NULL;
+  _sx = 1;
+  _sy = _x;
+  _sz = static_cast<long>(_x) * _y;
+  _st = static_cast<long>(_x) * _y * _z;
+}
+
+template <class VoxelType> inline int irtkGenericImageView<VoxelType>::GetX() const
+{
+  return _x;
+}
+
+template <class VoxelType> inline int irtkGenericImageView<VoxelType>::GetY() const
+{
+  return _y;
+}
+
+template <class VoxelType> inline int irtkGenericImageView<VoxelType>::GetZ() const
+{
+  return _z;
+}
+
+template <class VoxelType> inline int irtkGenericImageView<VoxelType>::GetT() const
+{
+  return _t;
+}
+
+template <class VoxelType> inline int irtkGenericImageView<VoxelType>::GetNumberOfVoxels() const
+{
+  return _x * _y * _z * _t;
+}
+
+template <class VoxelType> inline long irtkGenericImageView<VoxelType>::GetXStride() const
+{
+  return _sx;
+}
+
+template <class VoxelType> inline long irtkGenericImageView<VoxelType>::GetYStride() const
+{
+  return _sy;
+}
+
+template <class VoxelType> inline long irtkGenericImageView<VoxelType>::GetZStride() const
+{
+  return _sz;
+}
+
+template <class VoxelType> inline long irtkGenericImageView<VoxelType>::GetTStride() const
+{
+  return _st;
+}
+
+template <class VoxelType> inline bool irtkGenericImageView<VoxelType>::IsContiguous() const
+{
+  return ((_x == 1) || (_sx == 1)) &&
+         ((_y == 1) || (_sy == _x)) &&
+         ((_z == 1) || (_sz == static_cast<long>(_x) * _y)) &&
+         ((_t == 1) || (_st == static_cast<long>(_x) * _y * _z));
+}
+
+template <class VoxelType> inline VoxelType *irtkGenericImageView<VoxelType>::GetPointerToVoxels(int x, int y, int z, int t) const
+{
+  return _data + x * _sx + y * _sy + z * _sz + t * _st;
+}
+
+template <class VoxelType> inline VoxelType &irtkGenericImageView<VoxelType>::operator()(int x, int y, int z, int t) const
+{
+#ifdef NO_BOUNDS
+  return _data[x * _sx + y * _sy + z * _sz + t * _st];
+#else
+  if ((x >= _x) || (x < 0) || (y >= _y) || (y < 0) || (z >= _z) || (z < 0) || (t >= _t) || (t < 0)) {
+    cout << "irtkGenericImageView<Type>::operator(): parameter out of range\n";
+    return _data[0];
+  } else {
+    return _data[x * _sx + y * _sy + z * _sz + t * _st];
+  }
+#endif
+}
+
+template <class VoxelType> inline VoxelType irtkGenericImageView<VoxelType>::Get(int x, int y, int z, int t) const
+{
+  return (*this)(x, y, z, t);
+}
+
+template <class VoxelType> inline void irtkGenericImageView<VoxelType>::Put(int x, int y, int z, int t, VoxelType val) const
+{
+  (*this)(x, y, z, t) = val;
+}
+
+template <class VoxelType> inline irtkGenericImageView<VoxelType> irtkGenericImageView<VoxelType>::Region(int x1, int y1, int z1, int x2, int y2, int z2) const
+{
+  return this->Region(x1, y1, z1, 0, x2, y2, z2, _t);
+}
+
+template <class VoxelType> inline irtkGenericImageView<VoxelType> irtkGenericImageView<VoxelType>::Region(int x1, int y1, int z1, int t1, int x2, int y2, int z2, int t2) const
+{
+  if ((x1 < 0) || (x1 >= x2) || (x2 > _x) ||
+      (y1 < 0) || (y1 >= y2) || (y2 > _y) ||
+      (z1 < 0) || (z1 >= z2) || (z2 > _z) ||
+      (t1 < 0) || (t1 >= t2) || (t2 > _t)) {
+    cerr << "irtkGenericImageView<VoxelType>::Region: Parameter out of range\n";
+    exit(1);
+  }
+  return irtkGenericImageView(this->GetPointerToVoxels(x1, y1, z1, t1), x2 - x1, y2 - y1, z2 - z1, t2 - t1, _sx, _sy, _sz, _st);
+}
+
+template <class VoxelType> inline irtkGenericImageView<VoxelType> irtkGenericImageView<VoxelType>::Frame(int t) const
+{
+  return this->Region(0, 0, 0, t, _x, _y, _z, t + 1);
+}
+
+template <class VoxelType> inline irtkGenericImageView<VoxelType> irtkGenericImageView<VoxelType>::FlipXY() const
+{
+  return irtkGenericImageView(_data, _y, _x, _z, _t, _sy, _sx, _sz, _st);
+}
+
+template <class VoxelType> inline irtkGenericImageView<VoxelType> irtkGenericImageView<VoxelType>::FlipXZ() const
+{
+  return irtkGenericImageView(_data, _z, _y, _x, _t, _sz, _sy, _sx, _st);
+}
+
+template <class VoxelType> inline irtkGenericImageView<VoxelType> irtkGenericImageView<VoxelType>::FlipYZ() const
+{
+  return irtkGenericImageView(_data, _x, _z, _y, _t, _sx, _sz, _sy, _st);
+}
+
+template <class VoxelType> inline irtkGenericImageView<VoxelType> irtkGenericImageView<VoxelType>::FlipXT() const
+{
+  return irtkGenericImageView(_data, _t, _y, _z, _x, _st, _sy, _sz, _sx);
+}
+
+template <class VoxelType> inline irtkGenericImageView<VoxelType> irtkGenericImageView<VoxelType>::ReflectX() const
+{
+  return irtkGenericImageView(this->GetPointerToVoxels(_x - 1, 0, 0, 0), _x, _y, _z, _t, -_sx, _sy, _sz, _st);
+}
+
+template <class VoxelType> inline irtkGenericImageView<VoxelType> irtkGenericImageView<VoxelType>::ReflectY() const
+{
+  return irtkGenericImageView(this->GetPointerToVoxels(0, _y - 1, 0, 0), _x, _y, _z, _t, _sx, -_sy, _sz, _st);
+}
+
+template <class VoxelType> inline irtkGenericImageView<VoxelType> irtkGenericImageView<VoxelType>::ReflectZ() const
+{
+  return irtkGenericImageView(this->GetPointerToVoxels(0, 0, _z - 1, 0), _x, _y, _z, _t, _sx, _sy, -_sz, _st);
+}
+
+template <class VoxelType> void irtkGenericImageView<VoxelType>::Copy(const irtkGenericImageView &view) const
+{
+  int x, y, z, t;
+  VoxelType *ptr1, *ptr2;
+
+  if ((_x != view._x) || (_y != view._y) || (_z != view._z) || (_t != view._t)) {
+    cerr << "irtkGenericImageView<VoxelType>::Copy: Size mismatch in views\n";
+    exit(1);
+  }
+
+  for (t = 0; t < _t; t++) {
+    for (z = 0; z < _z; z++) {
+      for (y = 0; y < _y; y++) {
+        ptr1 = this->GetPointerToVoxels(0, y, z, t);
+        ptr2 = view.GetPointerToVoxels(0, y, z, t);
+        for (x = 0; x < _x; x++) {
+          *ptr1 = *ptr2;
+          ptr1 += _sx;
+          ptr2 += view._sx;
+        }
+      }
+    }
+  }
+}
+
+#endif
@@ -29,6 +29,7 @@ template <class Type> class irtkGenericImage;
 
 #include <irtkBaseImage.h>
 #include <irtkGenericImage.h>
+#include <irtkGenericImageView.h>
 
 /// Unsigned char image
 typedef class irtkGenericImage<irtkBytePixel> irtkByteImage;
@@ -76,6 +76,11 @@ public:
    *  above, but is only defined inside the image domain. */
   virtual double EvaluateInside(double, double, double, double = 0) = 0;
 
+  /** Evaluate the filter at a batch of image locations (in pixels), e.g. the
+   *  locations of a row of an output image. The default implementation calls
+   *  the method above for each location. */
+  virtual void Evaluate(int, const double *, const double *, const double *, double *, double = 0);
+
   /** Check if the location is inside the image domain for which this image
    *  interpolation function can be used without handling any form of boundary
    *  conditions. */
@@ -18,6 +18,149 @@ See LICENSE for details
 
 #include <irtkImageFunction.h>
 
+class irtkMultiThreadedBSplineInterpolateImageFunctionPrefilter
+{
+
+  /// Pointer to interpolation function
+  irtkBSplineInterpolateImageFunction *_filter;
+
+  /// Direction of lines (0 = x, 1 = y, 2 = z)
+  int _dir;
+
+  /// Poles of the prefilter
+  double *_pole;
+
+  /// Number of poles
+  int _npoles;
+
+public:
+
+  irtkMultiThreadedBSplineInterpolateImageFunctionPrefilter(irtkBSplineInterpolateImageFunction *filter, int dir, double *pole, int npoles) {
+    _filter = filter;
+    _dir    = dir;
+    _pole   = pole;
+    _npoles = npoles;
+  }
+
+  void operator()(const blocked_range<int> &r) const {
+    int i, l, n, X, Y, Z, stride, offset;
+    double *data;
+
+    X = _filter->_x;
+    Y = _filter->_y;
+    Z = _filter->_z;
+    irtkRealPixel *ptr = _filter->_coeff.GetPointerToVoxels();
+
+    // Length and stride of lines
+    switch (_dir) {
+    case 0:
+      n = X;
+      stride = 1;
+      break;
+    case 1:
+      n = Y;
+      stride = X;
+      break;
+    default:
+      n = Z;
+      stride = X * Y;
+      break;
+    }
+
+    data = new double[n];
+    for (l = r.begin(); l != r.end(); l++) {
+      // Offset of first voxel of line
+      switch (_dir) {
+      case 0:
+        offset = l * X;
+        break;
+      case 1:
+        offset = (l / X) * X * Y + l % X;
+        break;
+      default:
+        offset = (l / (X * Y)) * X * Y * Z + l % (X * Y);
+        break;
+      }
+
+      if (_dir == 0) {
+        // Samples are read in double precision from the input image
+        for (i = 0; i < n; i++) {
+          data[i] = _filter->_input->GetAsDouble(i, l % Y, (l / Y) % Z, l / (Y * Z));
+        }
+      } else {
+        for (i = 0; i < n; i++) {
+          data[i] = ptr[offset + i * stride];
+        }
+      }
+      irtkBSplineInterpolateImageFunction::ConvertToInterpolationCoefficients(data, n, _pole, _npoles, DBL_EPSILON);
+      for (i = 0; i < n; i++) {
+        ptr[offset + i * stride] = data[i];
+      }
+    }
+    delete []data;
+  }
+};
+
+// Compute first index and weights of B-spline of given degree at location x
+template <int Degree> static inline void irtkBSplineWeights(double x, int &i, double *weight)
+{
+  double w, w2, w4, t, t0, t1;
+
+  if (Degree & 1) {
+    i = (int)floor(x) - Degree / 2;
+  } else {
+    i = (int)floor(x + 0.5) - Degree / 2;
+  }
+
+  switch (Degree) {
+  case 2:
+    w = x - (double)(i + 1);
+    weight[1] = 3.0 / 4.0 - w * w;
+    weight[2] = (1.0 / 2.0) * (w - weight[1] + 1.0);
+    weight[0] = 1.0 - weight[1] - weight[2];
+    break;
+  case 3:
+    w = x - (double)(i + 1);
+    weight[3] = (1.0 / 6.0) * w * w * w;
+    weight[0] = (1.0 / 6.0) + (1.0 / 2.0) * w * (w - 1.0) - weight[3];
+    weight[2] = w + weight[0] - 2.0 * weight[3];
+    weight[1] = 1.0 - weight[0] - weight[2] - weight[3];
+    break;
+  case 4:
+    w = x - (double)(i + 2);
+    w2 = w * w;
+    t = (1.0 / 6.0) * w2;
+    weight[0] = 1.0 / 2.0 - w;
+    weight[0] *= weight[0];
+    weight[0] *= (1.0 / 24.0) * weight[0];
+    t0 = w * (t - 11.0 / 24.0);
+    t1 = 19.0 / 96.0 + w2 * (1.0 / 4.0 - t);
+    weight[1] = t1 + t0;
+    weight[3] = t1 - t0;
+    weight[4] = weight[0] + t0 + (1.0 / 2.0) * w;
+    weight[2] = 1.0 - weight[0] - weight[1] - weight[3] - weight[4];
+    break;
+  case 5:
+    w = x - (double)(i + 2);
+    w2 = w * w;
+    weight[5] = (1.0 / 120.0) * w * w2 * w2;
+    w2 -= w;
+    w4 = w2 * w2;
+    w -= 1.0 / 2.0;
+    t = w2 * (w2 - 3.0);
+    weight[0] = (1.0 / 24.0) * (1.0 / 5.0 + w2 + w4) - weight[5];
+    t0 = (1.0 / 24.0) * (w2 * (w2 - 5.0) + 46.0 / 5.0);
+    t1 = (-1.0 / 12.0) * w * (t + 4.0);
+    weight[2] = t0 + t1;
+    weight[3] = t0 - t1;
+    t0 = (1.0 / 16.0) * (9.0 / 5.0 - t);
+    t1 = (1.0 / 24.0) * w * (w4 - w2 - 5.0);
+    weight[1] = t0 + t1;
+    weight[4] = t0 - t1;
+    break;
+  }
+}
+
 irtkBSplineInterpolateImageFunction::irtkBSplineInterpolateImageFunction(int SplineDegree)
 {
   if ((SplineDegree < 2) || (SplineDegree > 5)) {
@@ -25,10 +168,18 @@ irtkBSplineInterpolateImageFunction::irtkBSplineInterpolateImageFunction(int Spl
     exit(1);
   }
   _SplineDegree = SplineDegree;
+  _margin = 0;
+  _xIndex = NULL;
+  _yIndex = NULL;
+  _zIndex = NULL;
 }
 
 irtkBSplineInterpolateImageFunction::~irtkBSplineInterpolateImageFunction(void)
-{}
+{
+  delete []_xIndex;
+  delete []_yIndex;
+  delete []_zIndex;
+}
 
 const char *irtkBSplineInterpolateImageFunction::NameOfClass()
 {
@@ -62,6 +213,15 @@ void irtkBSplineInterpolateImageFunction::Initialize()
   // Compute min and max values
   this->_input->GetMinMaxAsDouble(&this->_min, &this->_max);
 
+  // Tables of mirrored indices for locations up to a few voxels outside the image
+  this->_margin = _SplineDegree + 3;
+  delete []this->_xIndex;
+  delete []this->_yIndex;
+  delete []this->_zIndex;
+  this->_xIndex = this->IndexTable(this->_x, this->_xhalf);
+  this->_yIndex = this->IndexTable(this->_y, this->_yhalf);
+  this->_zIndex = this->IndexTable(this->_z, this->_zhalf);
+
   // Allocate coefficient image
   this->_coeff = irtkRealImage(this->_x, this->_y, this->_z, this->_t);
 
@@ -69,6 +229,27 @@ void irtkBSplineInterpolateImageFunction::Initialize()
   this->ComputeCoefficients();
 }
 
+int irtkBSplineInterpolateImageFunction::Mirror(int i, int n, int n2)
+{
+  int m;
+
+  if (n == 1) return 0;
+  m = (i < 0) ? (-i - n2 * ((-i) / n2)) : (i - n2 * (i / n2));
+  if (n <= m) m = n2 - m;
+  return m;
+}
+
+int *irtkBSplineInterpolateImageFunction::IndexTable(int n, int n2)
+{
+  int i, *table;
+
+  table = new int[n + 2 * this->_margin];
+  for (i = 0; i < n + 2 * this->_margin; i++) {
+    table[i] = Mirror(i - this->_margin, n, n2);
+  }
+  return table;
+}
+
 double irtkBSplineInterpolateImageFunction::InitialAntiCausalCoefficient(double c[], int DataLength, double z)
 {
   /* this initialization corresponds to mirror boundaries */
@@ -149,10 +330,8 @@ void irtkBSplineInterpolateImageFunction::ConvertToInterpolationCoefficients(dou
 
 void irtkBSplineInterpolateImageFunction::ComputeCoefficients()
 {
-  double *data;
   double Pole[2];
   int NbPoles;
-  int x, y, z, t;
 
   /* recover the poles from a lookup table */
   switch (_SplineDegree) {
@@ -181,249 +360,61 @@ void irtkBSplineInterpolateImageFunction::ComputeCoefficients()
     exit(1);
   }
 
-  /* convert the image samples into interpolation coefficients */
-
-  /* in-place separable process, along x */
-  data = new double[_x];
-  for (t = 0; t < this->_t; t++) {
-    for (z = 0; z < this->_z; z++) {
-      for (y = 0; y < this->_y; y++) {
-        for (x = 0; x < this->_x; x++) {
-          data[x] = this->_input->GetAsDouble(x, y, z, t);
-        }
-        ConvertToInterpolationCoefficients(data, this->_x, Pole, NbPoles, DBL_EPSILON);
-        for (x = 0; x < this->_x; x++) {
-          _coeff(x, y, z, t) = data[x];
-        }
-      }
-    }
-  }
-  delete []data;
-
-  /* in-place separable process, along y */
-  data = new double[_y];
-  for (t = 0; t < this->_t; t++) {
-    for (z = 0; z < this->_z; z++) {
-      for (x = 0; x < this->_x; x++) {
-        for (y = 0; y < this->_y; y++) {
-          data[y] = this->_coeff(x, y, z, t);
-        }
-        ConvertToInterpolationCoefficients(data, this->_y, Pole, NbPoles, DBL_EPSILON);
-        for (y = 0; y < this->_y; y++) {
-          _coeff(x, y, z, t) = data[y];
-        }
-      }
-    }
+  /* convert the image samples into interpolation coefficients, separable
+     process along x, y and z with lines processed in parallel */
+  task_scheduler_init init(tbb_no_threads);
+  parallel_for(blocked_range<int>(0, this->_y * this->_z * this->_t),
+               irtkMultiThreadedBSplineInterpolateImageFunctionPrefilter(this, 0, Pole, NbPoles));
+  if (this->_y > 1) {
+    parallel_for(blocked_range<int>(0, this->_x * this->_z * this->_t),
+                 irtkMultiThreadedBSplineInterpolateImageFunctionPrefilter(this, 1, Pole, NbPoles));
   }
-  delete []data;
-
-  /* in-place separable process, along z */
-  data = new double[_z];
-  for (t = 0; t < this->_t; t++) {
-    for (y = 0; y < this->_y; y++) {
-      for (x = 0; x < this->_x; x++) {
-        for (z = 0; z < this->_z; z++) {
-          data[z] = this->_coeff(x, y, z, t);
-        }
-        ConvertToInterpolationCoefficients(data, this->_z, Pole, NbPoles, DBL_EPSILON);
-        for (z = 0; z < this->_z; z++) {
-          _coeff(x, y, z, t) = data[z];
-        }
-      }
-    }
+  if (this->_z > 1) {
+    parallel_for(blocked_range<int>(0, this->_x * this->_y * this->_t),
+                 irtkMultiThreadedBSplineInterpolateImageFunctionPrefilter(this, 2, Pole, NbPoles));
   }
-  delete []data;
+  init.terminate();
 }
 
-double irtkBSplineInterpolateImageFunction::Evaluate(double x, double y, double z, double time)
+template <int Degree> double irtkBSplineInterpolateImageFunction::EvaluateSpline(double x, double y, double z, double time, bool inside)
 {
-  int i, j, k, l, m;
-  int xIndex[6], yIndex[6], zIndex[6];
-  double xWeight[6], yWeight[6], zWeight[6];
-  double value, w, w2, w4, t, t0, t1;
-
-  /* compute the interpolation indexes */
-  if (_SplineDegree & 1) {
-    i = (int)floor(x) - this->_SplineDegree / 2;
-    j = (int)floor(y) - this->_SplineDegree / 2;
-    k = (int)floor(z) - this->_SplineDegree / 2;
-    for (m = 0; m <= this->_SplineDegree; m++) {
-      xIndex[m] = i++;
-      yIndex[m] = j++;
-      zIndex[m] = k++;
-    }
-  } else {
-    i = (int)floor(x + 0.5) - this->_SplineDegree / 2;
-    j = (int)floor(y + 0.5) - this->_SplineDegree / 2;
-    k = (int)floor(z + 0.5) - this->_SplineDegree / 2;
-    for (m = 0; m <= this->_SplineDegree; m++) {
-      xIndex[m] = i++;
-      yIndex[m] = j++;
-      zIndex[m] = k++;
-    }
-  }
-
-  /* compute the interpolation weights */
-  switch (_SplineDegree) {
-  case 2:
-    /* x */
-    w = x - (double)xIndex[1];
-    xWeight[1] = 3.0 / 4.0 - w * w;
-    xWeight[2] = (1.0 / 2.0) * (w - xWeight[1] + 1.0);
-    xWeight[0] = 1.0 - xWeight[1] - xWeight[2];
-    /* y */
-    w = y - (double)yIndex[1];
-    yWeight[1] = 3.0 / 4.0 - w * w;
-    yWeight[2] = (1.0 / 2.0) * (w - yWeight[1] + 1.0);
-    yWeight[0] = 1.0 - yWeight[1] - yWeight[2];
-    /* z */
-    w = z - (double)zIndex[1];
-    zWeight[1] = 3.0 / 4.0 - w * w;
-    zWeight[2] = (1.0 / 2.0) * (w - zWeight[1] + 1.0);
-    zWeight[0] = 1.0 - zWeight[1] - zWeight[2];
-    break;
-  case 3:
-    /* x */
-    w = x - (double)xIndex[1];
-    xWeight[3] = (1.0 / 6.0) * w * w * w;
-    xWeight[0] = (1.0 / 6.0) + (1.0 / 2.0) * w * (w - 1.0) - xWeight[3];
-    xWeight[2] = w + xWeight[0] - 2.0 * xWeight[3];
-    xWeight[1] = 1.0 - xWeight[0] - xWeight[2] - xWeight[3];
-    /* y */
-    w = y - (double)yIndex[1];
-    yWeight[3] = (1.0 / 6.0) * w * w * w;
-    yWeight[0] = (1.0 / 6.0) + (1.0 / 2.0) * w * (w - 1.0) - yWeight[3];
-    yWeight[2] = w + yWeight[0] - 2.0 * yWeight[3];
-    yWeight[1] = 1.0 - yWeight[0] - yWeight[2] - yWeight[3];
-    /* z */
-    w = z - (double)zIndex[1];
-    zWeight[3] = (1.0 / 6.0) * w * w * w;
-    zWeight[0] = (1.0 / 6.0) + (1.0 / 2.0) * w * (w - 1.0) - zWeight[3];
-    zWeight[2] = w + zWeight[0] - 2.0 * zWeight[3];
-    zWeight[1] = 1.0 - zWeight[0] - zWeight[2] - zWeight[3];
-    break;
-  case 4:
-    /* x */
-    w = x - (double)xIndex[2];
-    w2 = w * w;
-    t = (1.0 / 6.0) * w2;
-    xWeight[0] = 1.0 / 2.0 - w;
-    xWeight[0] *= xWeight[0];
-    xWeight[0] *= (1.0 / 24.0) * xWeight[0];
-    t0 = w * (t - 11.0 / 24.0);
-    t1 = 19.0 / 96.0 + w2 * (1.0 / 4.0 - t);
-    xWeight[1] = t1 + t0;
-    xWeight[3] = t1 - t0;
-    xWeight[4] = xWeight[0] + t0 + (1.0 / 2.0) * w;
-    xWeight[2] = 1.0 - xWeight[0] - xWeight[1] - xWeight[3] - xWeight[4];
-    /* y */
-    w = y - (double)yIndex[2];
-    w2 = w * w;
-    t = (1.0 / 6.0) * w2;
-    yWeight[0] = 1.0 / 2.0 - w;
-    yWeight[0] *= yWeight[0];
-    yWeight[0] *= (1.0 / 24.0) * yWeight[0];
-    t0 = w * (t - 11.0 / 24.0);
-    t1 = 19.0 / 96.0 + w2 * (1.0 / 4.0 - t);
-    yWeight[1] = t1 + t0;
-    yWeight[3] = t1 - t0;
-    yWeight[4] = yWeight[0] + t0 + (1.0 / 2.0) * w;
-    yWeight[2] = 1.0 - yWeight[0] - yWeight[1] - yWeight[3] - yWeight[4];
-    /* z */
-    w = z - (double)zIndex[2];
-    w2 = w * w;
-    t = (1.0 / 6.0) * w2;
-    zWeight[0] = 1.0 / 2.0 - w;
-    zWeight[0] *= zWeight[0];
-    zWeight[0] *= (1.0 / 24.0) * zWeight[0];
-    t0 = w * (t - 11.0 / 24.0);
-    t1 = 19.0 / 96.0 + w2 * (1.0 / 4.0 - t);
-    zWeight[1] = t1 + t0;
-    zWeight[3] = t1 - t0;
-    zWeight[4] = zWeight[0] + t0 + (1.0 / 2.0) * w;
-    zWeight[2] = 1.0 - zWeight[0] - zWeight[1] - zWeight[3] - zWeight[4];
-    break;
-  case 5:
-    /* x */
-    w = x - (double)xIndex[2];
-    w2 = w * w;
-    xWeight[5] = (1.0 / 120.0) * w * w2 * w2;
-    w2 -= w;
-    w4 = w2 * w2;
-    w -= 1.0 / 2.0;
-    t = w2 * (w2 - 3.0);
-    xWeight[0] = (1.0 / 24.0) * (1.0 / 5.0 + w2 + w4) - xWeight[5];
-    t0 = (1.0 / 24.0) * (w2 * (w2 - 5.0) + 46.0 / 5.0);
-    t1 = (-1.0 / 12.0) * w * (t + 4.0);
-    xWeight[2] = t0 + t1;
-    xWeight[3] = t0 - t1;
-    t0 = (1.0 / 16.0) * (9.0 / 5.0 - t);
-    t1 = (1.0 / 24.0) * w * (w4 - w2 - 5.0);
-    xWeight[1] = t0 + t1;
-    xWeight[4] = t0 - t1;
-    /* y */
-    w = y - (double)yIndex[2];
-    w2 = w * w;
-    yWeight[5] = (1.0 / 120.0) * w * w2 * w2;
-    w2 -= w;
-    w4 = w2 * w2;
-    w -= 1.0 / 2.0;
-    t = w2 * (w2 - 3.0);
-    yWeight[0] = (1.0 / 24.0) * (1.0 / 5.0 + w2 + w4) - yWeight[5];
-    t0 = (1.0 / 24.0) * (w2 * (w2 - 5.0) + 46.0 / 5.0);
-    t1 = (-1.0 / 12.0) * w * (t + 4.0);
-    yWeight[2] = t0 + t1;
-    yWeight[3] = t0 - t1;
-    t0 = (1.0 / 16.0) * (9.0 / 5.0 - t);
-    t1 = (1.0 / 24.0) * w * (w4 - w2 - 5.0);
-    yWeight[1] = t0 + t1;
-    yWeight[4] = t0 - t1;
-    /* z */
-    w = z - (double)zIndex[2];
-    w2 = w * w;
-    zWeight[5] = (1.0 / 120.0) * w * w2 * w2;
-    w2 -= w;
-    w4 = w2 * w2;
-    w -= 1.0 / 2.0;
-    t = w2 * (w2 - 3.0);
-    zWeight[0] = (1.0 / 24.0) * (1.0 / 5.0 + w2 + w4) - zWeight[5];
-    t0 = (1.0 / 24.0) * (w2 * (w2 - 5.0) + 46.0 / 5.0);
-    t1 = (-1.0 / 12.0) * w * (t + 4.0);
-    zWeight[2] = t0 + t1;
-    zWeight[3] = t0 - t1;
-    t0 = (1.0 / 16.0) * (9.0 / 5.0 - t);
-    t1 = (1.0 / 24.0) * w * (w4 - w2 - 5.0);
-    zWeight[1] = t0 + t1;
-    zWeight[4] = t0 - t1;
-    break;
-  default:
-    printf("Invalid spline degree\n");
-    return(0.0);
-  }
-
-  /* apply the mirror boundary conditions */
-  for (m = 0; m <= this->_SplineDegree; m++) {
-    xIndex[m] = (_x == 1) ? (0) : ((xIndex[m] < 0) ? (-xIndex[m] - this->_xhalf * ((-xIndex[m]) / this->_xhalf)) : (xIndex[m] - this->_xhalf * (xIndex[m] / this->_xhalf)));
-    if (_x <= xIndex[m]) {
-      xIndex[m] = this->_xhalf - xIndex[m];
-    }
-    yIndex[m] = (_y == 1) ? (0) : ((yIndex[m] < 0) ? (-yIndex[m] - this->_yhalf * ((-yIndex[m]) / this->_yhalf)) : (yIndex[m] - this->_yhalf * (yIndex[m] / this->_yhalf)));
-    if (_y <= yIndex[m]) {
-      yIndex[m] = this->_yhalf - yIndex[m];
-    }
-    zIndex[m] = (_z == 1) ? (0) : ((zIndex[m] < 0) ? (-zIndex[m] - this->_zhalf * ((-zIndex[m]) / this->_zhalf)) : (zIndex[m] - this->_zhalf * (zIndex[m] / this->_zhalf)));
-    if (_z <= zIndex[m]) {
-      zIndex[m] = this->_zhalf - zIndex[m];
+  int i, j, k, l, i0, j0, k0, X, Y;
+  int xIndex[Degree+1], yIndex[Degree+1], zIndex[Degree+1];
+  double xWeight[Degree+1], yWeight[Degree+1], zWeight[Degree+1];
+  double value;
+
+  /* compute the interpolation indexes and weights */
+  irtkBSplineWeights<Degree>(x, i0, xWeight);
+  irtkBSplineWeights<Degree>(y, j0, yWeight);
+  irtkBSplineWeights<Degree>(z, k0, zWeight);
+
+  X = this->_x;
+  Y = this->_y;
+  l = round(time);
+  irtkRealPixel *ptr = this->_coeff.GetPointerToVoxels(0, 0, 0, l);
+
+  /* apply the mirror boundary conditions, using the index tables close to the image */
+  for (i = 0; i <= Degree; i++) {
+    if (inside) {
+      xIndex[i] = i0 + i;
+      yIndex[i] = (j0 + i) * X;
+      zIndex[i] = (k0 + i) * X * Y;
+    } else {
+      xIndex[i] = ((i0 + i + _margin >= 0) && (i0 + i < this->_x + _margin)) ? _xIndex[i0 + i + _margin] : Mirror(i0 + i, this->_x, this->_xhalf);
+      yIndex[i] = ((j0 + i + _margin >= 0) && (j0 + i < this->_y + _margin)) ? _yIndex[j0 + i + _margin] : Mirror(j0 + i, this->_y, this->_yhalf);
+      zIndex[i] = ((k0 + i + _margin >= 0) && (k0 + i < this->_z + _margin)) ? _zIndex[k0 + i + _margin] : Mirror(k0 + i, this->_z, this->_zhalf);
+      yIndex[i] *= X;
+      zIndex[i] *= X * Y;
     }
   }
 
   /* perform interpolation */
-  l = round(time);
   value = 0.0;
-  for (k = 0; k <= this->_SplineDegree; k++) {
-    for (j = 0; j <= this->_SplineDegree; j++) {
-      for (i = 0; i <= this->_SplineDegree; i++) {
-        value += xWeight[i] * yWeight[j] * zWeight[k] * this->_coeff(xIndex[i], yIndex[j], zIndex[k], l);
+  for (k = 0; k <= Degree; k++) {
+    for (j = 0; j <= Degree; j++) {
+      const irtkRealPixel *row = ptr + zIndex[k] + yIndex[j];
+      for (i = 0; i <= Degree; i++) {
+        value += xWeight[i] * yWeight[j] * zWeight[k] * row[xIndex[i]];
       }
     }
   }
@@ -436,187 +427,59 @@ double irtkBSplineInterpolateImageFunction::Evaluate(double x, double y, double
   return(value);
 }
 
+double irtkBSplineInterpolateImageFunction::Evaluate(double x, double y, double z, double time)
+{
+  switch (_SplineDegree) {
+  case 2:
+    return this->EvaluateSpline<2>(x, y, z, time, false);
+  case 3:
+    return this->EvaluateSpline<3>(x, y, z, time, false);
+  case 4:
+    return this->EvaluateSpline<4>(x, y, z, time, false);
+  case 5:
+    return this->EvaluateSpline<5>(x, y, z, time, false);
+  default:
+    printf("Invalid spline degree\n");
+    return(0.0);
+  }
+}
+
 double irtkBSplineInterpolateImageFunction::EvaluateInside(double x, double y, double z, double time)
 {
-  int i, j, k, l, m;
-  int xIndex[6], yIndex[6], zIndex[6];
-  double xWeight[6], yWeight[6], zWeight[6];
-  double value, w, w2, w4, t, t0, t1;
-
-  /* compute the interpolation indexes */
-  if (_SplineDegree & 1) {
-    i = (int)floor(x) - this->_SplineDegree / 2;
-    j = (int)floor(y) - this->_SplineDegree / 2;
-    k = (int)floor(z) - this->_SplineDegree / 2;
-    for (m = 0; m <= this->_SplineDegree; m++) {
-      xIndex[m] = i++;
-      yIndex[m] = j++;
-      zIndex[m] = k++;
-    }
-  } else {
-    i = (int)floor(x + 0.5) - this->_SplineDegree / 2;
-    j = (int)floor(y + 0.5) - this->_SplineDegree / 2;
-    k = (int)floor(z + 0.5) - this->_SplineDegree / 2;
-    for (m = 0; m <= this->_SplineDegree; m++) {
-      xIndex[m] = i++;
-      yIndex[m] = j++;
-      zIndex[m] = k++;
-    }
+  switch (_SplineDegree) {
+  case 2:
+    return this->EvaluateSpline<2>(x, y, z, time, true);
+  case 3:
+    return this->EvaluateSpline<3>(x, y, z, time, true);
+  case 4:
+    return this->EvaluateSpline<4>(x, y, z, time, true);
+  case 5:
+    return this->EvaluateSpline<5>(x, y, z, time, true);
+  default:
+    printf("Invalid spline degree\n");
+    return(0.0);
   }
+}
+
+void irtkBSplineInterpolateImageFunction::Evaluate(int n, const double *x, const double *y, const double *z, double *value, double time)
+{
+  int i;
 
-  /* compute the interpolation weights */
   switch (_SplineDegree) {
   case 2:
-    /* x */
-    w = x - (double)xIndex[1];
-    xWeight[1] = 3.0 / 4.0 - w * w;
-    xWeight[2] = (1.0 / 2.0) * (w - xWeight[1] + 1.0);
-    xWeight[0] = 1.0 - xWeight[1] - xWeight[2];
-    /* y */
-    w = y - (double)yIndex[1];
-    yWeight[1] = 3.0 / 4.0 - w * w;
-    yWeight[2] = (1.0 / 2.0) * (w - yWeight[1] + 1.0);
-    yWeight[0] = 1.0 - yWeight[1] - yWeight[2];
-    /* z */
-    w = z - (double)zIndex[1];
-    zWeight[1] = 3.0 / 4.0 - w * w;
-    zWeight[2] = (1.0 / 2.0) * (w - zWeight[1] + 1.0);
-    zWeight[0] = 1.0 - zWeight[1] - zWeight[2];
+    for (i = 0; i < n; i++) value[i] = this->EvaluateSpline<2>(x[i], y[i], z[i], time, false);
     break;
   case 3:
-    /* x */
-    w = x - (double)xIndex[1];
-    xWeight[3] = (1.0 / 6.0) * w * w * w;
-    xWeight[0] = (1.0 / 6.0) + (1.0 / 2.0) * w * (w - 1.0) - xWeight[3];
-    xWeight[2] = w + xWeight[0] - 2.0 * xWeight[3];
-    xWeight[1] = 1.0 - xWeight[0] - xWeight[2] - xWeight[3];
-    /* y */
-    w = y - (double)yIndex[1];
-    yWeight[3] = (1.0 / 6.0) * w * w * w;
-    yWeight[0] = (1.0 / 6.0) + (1.0 / 2.0) * w * (w - 1.0) - yWeight[3];
-    yWeight[2] = w + yWeight[0] - 2.0 * yWeight[3];
-    yWeight[1] = 1.0 - yWeight[0] - yWeight[2] - yWeight[3];
-    /* z */
-    w = z - (double)zIndex[1];
-    zWeight[3] = (1.0 / 6.0) * w * w * w;
-    zWeight[0] = (1.0 / 6.0) + (1.0 / 2.0) * w * (w - 1.0) - zWeight[3];
-    zWeight[2] = w + zWeight[0] - 2.0 * zWeight[3];
-    zWeight[1] = 1.0 - zWeight[0] - zWeight[2] - zWeight[3];
+    for (i = 0; i < n; i++) value[i] = this->EvaluateSpline<3>(x[i], y[i], z[i], time, false);
     break;
   case 4:
-    /* x */
-    w = x - (double)xIndex[2];
-    w2 = w * w;
-    t = (1.0 / 6.0) * w2;
-    xWeight[0] = 1.0 / 2.0 - w;
-    xWeight[0] *= xWeight[0];
-    xWeight[0] *= (1.0 / 24.0) * xWeight[0];
-    t0 = w * (t - 11.0 / 24.0);
-    t1 = 19.0 / 96.0 + w2 * (1.0 / 4.0 - t);
-    xWeight[1] = t1 + t0;
-    xWeight[3] = t1 - t0;
-    xWeight[4] = xWeight[0] + t0 + (1.0 / 2.0) * w;
-    xWeight[2] = 1.0 - xWeight[0] - xWeight[1] - xWeight[3] - xWeight[4];
-    /* y */
-    w = y - (double)yIndex[2];
-    w2 = w * w;
-    t = (1.0 / 6.0) * w2;
-    yWeight[0] = 1.0 / 2.0 - w;
-    yWeight[0] *= yWeight[0];
-    yWeight[0] *= (1.0 / 24.0) * yWeight[0];
-    t0 = w * (t - 11.0 / 24.0);
-    t1 = 19.0 / 96.0 + w2 * (1.0 / 4.0 - t);
-    yWeight[1] = t1 + t0;
-    yWeight[3] = t1 - t0;
-    yWeight[4] = yWeight[0] + t0 + (1.0 / 2.0) * w;
-    yWeight[2] = 1.0 - yWeight[0] - yWeight[1] - yWeight[3] - yWeight[4];
-    /* z */
-    w = z - (double)zIndex[2];
-    w2 = w * w;
-    t = (1.0 / 6.0) * w2;
-    zWeight[0] = 1.0 / 2.0 - w;
-    zWeight[0] *= zWeight[0];
-    zWeight[0] *= (1.0 / 24.0) * zWeight[0];
-    t0 = w * (t - 11.0 / 24.0);
-    t1 = 19.0 / 96.0 + w2 * (1.0 / 4.0 - t);
-    zWeight[1] = t1 + t0;
-    zWeight[3] = t1 - t0;
-    zWeight[4] = zWeight[0] + t0 + (1.0 / 2.0) * w;
-    zWeight[2] = 1.0 - zWeight[0] - zWeight[1] - zWeight[3] - zWeight[4];
+    for (i = 0; i < n; i++) value[i] = this->EvaluateSpline<4>(x[i], y[i], z[i], time, false);
     break;
   case 5:
-    /* x */
-    w = x - (double)xIndex[2];
-    w2 = w * w;
-    xWeight[5] = (1.0 / 120.0) * w * w2 * w2;
-    w2 -= w;
-    w4 = w2 * w2;
-    w -= 1.0 / 2.0;
-    t = w2 * (w2 - 3.0);
-    xWeight[0] = (1.0 / 24.0) * (1.0 / 5.0 + w2 + w4) - xWeight[5];
-    t0 = (1.0 / 24.0) * (w2 * (w2 - 5.0) + 46.0 / 5.0);
-    t1 = (-1.0 / 12.0) * w * (t + 4.0);
-    xWeight[2] = t0 + t1;
-    xWeight[3] = t0 - t1;
-    t0 = (1.0 / 16.0) * (9.0 / 5.0 - t);
-    t1 = (1.0 / 24.0) * w * (w4 - w2 - 5.0);
-    xWeight[1] = t0 + t1;
-    xWeight[4] = t0 - t1;
-    /* y */
-    w = y - (double)yIndex[2];
-    w2 = w * w;
-    yWeight[5] = (1.0 / 120.0) * w * w2 * w2;
-    w2 -= w;
-    w4 = w2 * w2;
-    w -= 1.0 / 2.0;
-    t = w2 * (w2 - 3.0);
-    yWeight[0] = (1.0 / 24.0) * (1.0 / 5.0 + w2 + w4) - yWeight[5];
-    t0 = (1.0 / 24.0) * (w2 * (w2 - 5.0) + 46.0 / 5.0);
-    t1 = (-1.0 / 12.0) * w * (t + 4.0);
-    yWeight[2] = t0 + t1;
-    yWeight[3] = t0 - t1;
-    t0 = (1.0 / 16.0) * (9.0 / 5.0 - t);
-    t1 = (1.0 / 24.0) * w * (w4 - w2 - 5.0);
-    yWeight[1] = t0 + t1;
-    yWeight[4] = t0 - t1;
-    /* z */
-    w = z - (double)zIndex[2];
-    w2 = w * w;
-    zWeight[5] = (1.0 / 120.0) * w * w2 * w2;
-    w2 -= w;
-    w4 = w2 * w2;
-    w -= 1.0 / 2.0;
-    t = w2 * (w2 - 3.0);
-    zWeight[0] = (1.0 / 24.0) * (1.0 / 5.0 + w2 + w4) - zWeight[5];
-    t0 = (1.0 / 24.0) * (w2 * (w2 - 5.0) + 46.0 / 5.0);
-    t1 = (-1.0 / 12.0) * w * (t + 4.0);
-    zWeight[2] = t0 + t1;
-    zWeight[3] = t0 - t1;
-    t0 = (1.0 / 16.0) * (9.0 / 5.0 - t);
-    t1 = (1.0 / 24.0) * w * (w4 - w2 - 5.0);
-    zWeight[1] = t0 + t1;
-    zWeight[4] = t0 - t1;
+    for (i = 0; i < n; i++) value[i] = this->EvaluateSpline<5>(x[i], y[i], z[i], time, false);
     break;
   default:
     printf("Invalid spline degree\n");
-    return(0.0);
+    for (i = 0; i < n; i++) value[i] = 0;
   }
-
-  /* perform interpolation */
-  l = round(time);
-  value = 0.0;
-  for (k = 0; k <= this->_SplineDegree; k++) {
-    for (j = 0; j <= this->_SplineDegree; j++) {
-      for (i = 0; i <= this->_SplineDegree; i++) {
-        value += xWeight[i] * yWeight[j] * zWeight[k] * this->_coeff(xIndex[i], yIndex[j], zIndex[k], l);
-      }
-    }
-  }
-
-  if (this->_clamped) {
-    if (value > this->_max) return this->_max;
-    if (value < this->_min) return this->_min;
-  }
-
-  return(value);
 }
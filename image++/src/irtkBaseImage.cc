@@ -44,11 +44,12 @@ irtkBaseImage::~irtkBaseImage()
   this->UpdateMatrix();
 }
 
-irtkBaseImage *irtkBaseImage::New(const char *filename)
+irtkBaseImage *irtkBaseImage::New(const char *filename, irtkMemoryMapMode mode)
 {
   irtkBaseImage *image;
 
   irtkFileToImage *reader = irtkFileToImage::New(filename);
+  reader->PutMemoryMapMode(mode);
   image = reader->GetOutput();
   delete reader;
 
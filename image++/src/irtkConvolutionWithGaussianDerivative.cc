@@ -48,6 +48,9 @@ template <class VoxelType> void irtkConvolutionWithGaussianDerivative<VoxelType>
   // Do the initial set up
   this->Initialize();
 
+  // Views of input and output
+  irtkGenericImageView<VoxelType> input(*this->_input), output(*this->_output);
+
   // Get voxel dimensions
   this->_input->GetPixelSize(&xsize, &ysize, &zsize);
 
@@ -63,13 +66,8 @@ template <class VoxelType> void irtkConvolutionWithGaussianDerivative<VoxelType>
 
   // Do convolution
   irtkConvolution_1D<VoxelType> convolutionX;
-  convolutionX.SetInput ( this->_input);
   convolutionX.SetInput2(&kernelX);
-  convolutionX.SetOutput(this->_output);
-  convolutionX.irtkImageToImage<VoxelType>::Run();
-
-  // Flip x and y axis of image
-  this->_output->FlipXY(1);
+  convolutionX.Run(input, output);
 
   // Create scalar function which corresponds to a 1D Gaussian function in Y
   irtkScalarGaussian gaussianY(this->_Sigma/ysize, 1, 1, 0, 0, 0);
@@ -85,16 +83,11 @@ template <class VoxelType> void irtkConvolutionWithGaussianDerivative<VoxelType>
 
   // Do convolution
   irtkConvolution_1D<VoxelType> convolutionY;
-  convolutionY.SetInput (this->_output);
   convolutionY.SetInput2(&kernelY);
-  convolutionY.SetOutput(this->_output);
   convolutionY.SetNormalization(true);
-  convolutionY.irtkImageToImage<VoxelType>::Run();
-
-  // Flip x and z axis of image
-  this->_output->FlipXZ(1);
+  convolutionY.Run(output.FlipXY(), output.FlipXY());
 
-  if (this->_output->GetX() != 1) {
+  if (this->_output->GetZ() != 1) {
     // Create scalar function which corresponds to a 1D Gaussian function in Z
     irtkScalarGaussian gaussianZ(this->_Sigma/zsize, 1, 1, 0, 0, 0);
 
@@ -109,17 +102,11 @@ template <class VoxelType> void irtkConvolutionWithGaussianDerivative<VoxelType>
 
     // Do convolution
     irtkConvolution_1D<VoxelType> convolutionZ;
-    convolutionZ.SetInput (this->_output);
     convolutionZ.SetInput2(&kernelZ);
-    convolutionZ.SetOutput(this->_output);
     convolutionZ.SetNormalization(true);
-    convolutionZ.irtkImageToImage<VoxelType>::Run();
+    convolutionZ.Run(output.FlipXZ(), output.FlipXZ());
   }
 
-  // Flip image back, first x and z axis, then x and y axis
-  this->_output->FlipXZ(1);
-  this->_output->FlipXY(1);
-
   // Do the final cleaning up
   this->Finalize();
 
@@ -132,6 +119,9 @@ template <class VoxelType> void irtkConvolutionWithGaussianDerivative<VoxelType>
   // Do the initial set up
   this->Initialize();
 
+  // Views of input and output
+  irtkGenericImageView<VoxelType> input(*this->_input), output(*this->_output);
+
   // Get voxel dimensions
   this->_input->GetPixelSize(&xsize, &ysize, &zsize);
 
@@ -149,14 +139,9 @@ template <class VoxelType> void irtkConvolutionWithGaussianDerivative<VoxelType>
 
   // Do convolution
   irtkConvolution_1D<VoxelType> convolutionX;
-  convolutionX.SetInput ( this->_input);
   convolutionX.SetInput2(&kernelX);
-  convolutionX.SetOutput(this->_output);
   convolutionX.SetNormalization(true);
-  convolutionX.irtkImageToImage<VoxelType>::Run();
-
-  // Flip x and y axis of image
-  this->_output->FlipXY(1);
+  convolutionX.Run(input, output);
 
   // Create scalar function which corresponds to a 1D Gaussian function in Y
   irtkScalarGaussianDx gaussianDy(this->_Sigma/ysize, 1, 1, 0, 0, 0);
@@ -172,15 +157,10 @@ template <class VoxelType> void irtkConvolutionWithGaussianDerivative<VoxelType>
 
   // Do convolution
   irtkConvolution_1D<VoxelType> convolutionY;
-  convolutionY.SetInput (this->_output);
   convolutionY.SetInput2(&kernelY);
-  convolutionY.SetOutput(this->_output);
-  convolutionY.irtkImageToImage<VoxelType>::Run();
+  convolutionY.Run(output.FlipXY(), output.FlipXY());
 
-  // Flip x and z axis of image
-  this->_output->FlipXZ(1);
-
-  if (this->_output->GetX() != 1) {
+  if (this->_output->GetZ() != 1) {
     // Create scalar function which corresponds to a 1D Gaussian function in Z
     irtkScalarGaussian gaussianZ(this->_Sigma/zsize, 1, 1, 0, 0, 0);
 
@@ -195,17 +175,11 @@ template <class VoxelType> void irtkConvolutionWithGaussianDerivative<VoxelType>
 
     // Do convolution
     irtkConvolution_1D<VoxelType> convolutionZ;
-    convolutionZ.SetInput (this->_output);
     convolutionZ.SetInput2(&kernelZ);
-    convolutionZ.SetOutput(this->_output);
     convolutionZ.SetNormalization(true);
-    convolutionZ.irtkImageToImage<VoxelType>::Run();
+    convolutionZ.Run(output.FlipXZ(), output.FlipXZ());
   }
 
-  // Flip image back, first x and z axis, then x and y axis
-  this->_output->FlipXZ(1);
-  this->_output->FlipXY(1);
-
   // Do the final cleaning up
   this->Finalize();
 }
@@ -217,6 +191,9 @@ template <class VoxelType> void irtkConvolutionWithGaussianDerivative<VoxelType>
   // Do the initial set up
   this->Initialize();
 
+  // Views of input and output
+  irtkGenericImageView<VoxelType> input(*this->_input), output(*this->_output);
+
   // Get voxel dimensions
   this->_input->GetPixelSize(&xsize, &ysize, &zsize);
 
@@ -234,14 +211,9 @@ template <class VoxelType> void irtkConvolutionWithGaussianDerivative<VoxelType>
 
   // Do convolution
   irtkConvolution_1D<VoxelType> convolutionX;
-  convolutionX.SetInput ( this->_input);
   convolutionX.SetInput2(&kernelX);
-  convolutionX.SetOutput(this->_output);
   convolutionX.SetNormalization(true);
-  convolutionX.irtkImageToImage<VoxelType>::Run();
-
-  // Flip x and y axis of image
-  this->_output->FlipXY(1);
+  convolutionX.Run(input, output);
 
   // Create scalar function which corresponds to a 1D Gaussian function in Y
   irtkScalarGaussian gaussianY(this->_Sigma/ysize, 1, 1, 0, 0, 0);
@@ -257,16 +229,11 @@ template <class VoxelType> void irtkConvolutionWithGaussianDerivative<VoxelType>
 
   // Do convolution
   irtkConvolution_1D<VoxelType> convolutionY;
-  convolutionY.SetInput (this->_output);
   convolutionY.SetInput2(&kernelY);
-  convolutionY.SetOutput(this->_output);
   convolutionY.SetNormalization(true);
-  convolutionY.irtkImageToImage<VoxelType>::Run();
-
-  // Flip x and z axis of image
-  this->_output->FlipXZ(1);
+  convolutionY.Run(output.FlipXY(), output.FlipXY());
 
-  if (this->_output->GetX() != 1) {
+  if (this->_output->GetZ() != 1) {
     // Create scalar function which corresponds to a 1D Gaussian function in Z
     irtkScalarGaussianDx gaussianDz(this->_Sigma/zsize, 1, 1, 0, 0, 0);
 
@@ -281,16 +248,10 @@ template <class VoxelType> void irtkConvolutionWithGaussianDerivative<VoxelType>
 
     // Do convolution
     irtkConvolution_1D<VoxelType> convolutionZ;
-    convolutionZ.SetInput (this->_output);
     convolutionZ.SetInput2(&kernelZ);
-    convolutionZ.SetOutput(this->_output);
-    convolutionZ.irtkImageToImage<VoxelType>::Run();
+    convolutionZ.Run(output.FlipXZ(), output.FlipXZ());
   }
 
-  // Flip image back, first x and z axis, then x and y axis
-  this->_output->FlipXZ(1);
-  this->_output->FlipXY(1);
-
   // Do the final cleaning up
   this->Finalize();
 }
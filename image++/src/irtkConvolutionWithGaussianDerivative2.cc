@@ -57,6 +57,9 @@ template <class VoxelType> void irtkConvolutionWithGaussianDerivative2<VoxelType
   // Do the initial set up
   this->Initialize();
 
+  // Views of input and output
+  irtkGenericImageView<VoxelType> input(*this->_input), output(*this->_output);
+
   // Get voxel dimensions
   this->_input->GetPixelSize(&xsize, &ysize, &zsize);
 
@@ -72,13 +75,8 @@ template <class VoxelType> void irtkConvolutionWithGaussianDerivative2<VoxelType
 
   // Do convolution
   irtkConvolution_1D<VoxelType> convolutionX;
-  convolutionX.SetInput ( this->_input);
   convolutionX.SetInput2(&kernelX);
-  convolutionX.SetOutput(this->_output);
-  convolutionX.irtkImageToImage<VoxelType>::Run();
-
-  // Flip x and y axis of image
-  this->_output->FlipXY(1);
+  convolutionX.Run(input, output);
 
   // Create scalar function which corresponds to a 1D Gaussian function in Y
   irtkScalarGaussian gaussianY(this->_Sigma/ysize, 1, 1, 0, 0, 0);
@@ -94,15 +92,10 @@ template <class VoxelType> void irtkConvolutionWithGaussianDerivative2<VoxelType
 
   // Do convolution
   irtkConvolution_1D<VoxelType> convolutionY;
-  convolutionY.SetInput (this->_output);
   convolutionY.SetInput2(&kernelY);
-  convolutionY.SetOutput(this->_output);
   convolutionY.SetNormalization(true);
-  convolutionY.irtkImageToImage<VoxelType>::Run();
-  // Flip x and z axis of image
-  this->_output->FlipXZ(1);
-
-  if (this->_output->GetX() != 1) {
+  convolutionY.Run(output.FlipXY(), output.FlipXY());
+  if (this->_output->GetZ() != 1) {
     // Create scalar function which corresponds to a 1D Gaussian function in Z
     irtkScalarGaussian gaussianZ(this->_Sigma/zsize, 1, 1, 0, 0, 0);
 
@@ -117,17 +110,11 @@ template <class VoxelType> void irtkConvolutionWithGaussianDerivative2<VoxelType
 
     // Do convolution
     irtkConvolution_1D<VoxelType> convolutionZ;
-    convolutionZ.SetInput (this->_output);
     convolutionZ.SetInput2(&kernelZ);
-    convolutionZ.SetOutput(this->_output);
     convolutionZ.SetNormalization(true);
-    convolutionZ.irtkImageToImage<VoxelType>::Run();
+    convolutionZ.Run(output.FlipXZ(), output.FlipXZ());
   }
 
-  // Flip image back, first x and z axis, then x and y axis
-  this->_output->FlipXZ(1);
-  this->_output->FlipXY(1);
-
   // Do the final cleaning up
   this->Finalize();
 
@@ -140,6 +127,9 @@ template <class VoxelType> void irtkConvolutionWithGaussianDerivative2<VoxelType
   // Do the initial set up
   this->Initialize();
 
+  // Views of input and output
+  irtkGenericImageView<VoxelType> input(*this->_input), output(*this->_output);
+
   // Get voxel dimensions
   this->_input->GetPixelSize(&xsize, &ysize, &zsize);
 
@@ -156,13 +146,8 @@ template <class VoxelType> void irtkConvolutionWithGaussianDerivative2<VoxelType
 
   // Do convolution
   irtkConvolution_1D<VoxelType> convolutionX;
-  convolutionX.SetInput ( this->_input);
   convolutionX.SetInput2(&kernelX);
-  convolutionX.SetOutput(this->_output);
-  convolutionX.irtkImageToImage<VoxelType>::Run();
-
-  // Flip x and y axis of image
-  this->_output->FlipXY(1);
+  convolutionX.Run(input, output);
 
   // Create scalar function which corresponds to a 1D Gaussian function in Y
   irtkScalarGaussianDx gaussianDy(this->_Sigma/ysize, 1, 1, 0, 0, 0);
@@ -178,15 +163,10 @@ template <class VoxelType> void irtkConvolutionWithGaussianDerivative2<VoxelType
 
   // Do convolution
   irtkConvolution_1D<VoxelType> convolutionY;
-  convolutionY.SetInput (this->_output);
   convolutionY.SetInput2(&kernelY);
-  convolutionY.SetOutput(this->_output);
-  convolutionY.irtkImageToImage<VoxelType>::Run();
-
-  // Flip x and z axis of image
-  this->_output->FlipXZ(1);
+  convolutionY.Run(output.FlipXY(), output.FlipXY());
 
-  if (this->_output->GetX() != 1) {
+  if (this->_output->GetZ() != 1) {
     // Create scalar function which corresponds to a 1D Gaussian function in Z
     irtkScalarGaussian gaussianZ(this->_Sigma/zsize, 1, 1, 0, 0, 0);
 
@@ -201,17 +181,11 @@ template <class VoxelType> void irtkConvolutionWithGaussianDerivative2<VoxelType
 
     // Do convolution
     irtkConvolution_1D<VoxelType> convolutionZ;
-    convolutionZ.SetInput (this->_output);
     convolutionZ.SetInput2(&kernelZ);
-    convolutionZ.SetOutput(this->_output);
     convolutionZ.SetNormalization(true);
-    convolutionZ.irtkImageToImage<VoxelType>::Run();
+    convolutionZ.Run(output.FlipXZ(), output.FlipXZ());
   }
 
-  // Flip image back, first x and z axis, then x and y axis
-  this->_output->FlipXZ(1);
-  this->_output->FlipXY(1);
-
   // Do the final cleaning up
   this->Finalize();
 
@@ -224,6 +198,9 @@ template <class VoxelType> void irtkConvolutionWithGaussianDerivative2<VoxelType
   // Do the initial set up
   this->Initialize();
 
+  // Views of input and output
+  irtkGenericImageView<VoxelType> input(*this->_input), output(*this->_output);
+
   // Get voxel dimensions
   this->_input->GetPixelSize(&xsize, &ysize, &zsize);
 
@@ -240,13 +217,8 @@ template <class VoxelType> void irtkConvolutionWithGaussianDerivative2<VoxelType
 
   // Do convolution
   irtkConvolution_1D<VoxelType> convolutionX;
-  convolutionX.SetInput ( this->_input);
   convolutionX.SetInput2(&kernelX);
-  convolutionX.SetOutput(this->_output);
-  convolutionX.irtkImageToImage<VoxelType>::Run();
-
-  // Flip x and y axis of image
-  this->_output->FlipXY(1);
+  convolutionX.Run(input, output);
 
   // Create scalar function which corresponds to a 1D Gaussian function in Y
   irtkScalarGaussian gaussianY(this->_Sigma/ysize, 1, 1, 0, 0, 0);
@@ -262,16 +234,11 @@ template <class VoxelType> void irtkConvolutionWithGaussianDerivative2<VoxelType
 
   // Do convolution
   irtkConvolution_1D<VoxelType> convolutionY;
-  convolutionY.SetInput (this->_output);
   convolutionY.SetInput2(&kernelY);
-  convolutionY.SetOutput(this->_output);
   convolutionY.SetNormalization(true);
-  convolutionY.irtkImageToImage<VoxelType>::Run();
+  convolutionY.Run(output.FlipXY(), output.FlipXY());
 
-  // Flip x and z axis of image
-  this->_output->FlipXZ(1);
-
-  if (this->_output->GetX() != 1) {
+  if (this->_output->GetZ() != 1) {
     // Create scalar function which corresponds to a 1D Gaussian function in Z
     irtkScalarGaussianDx gaussianDz(this->_Sigma/zsize, 1, 1, 0, 0, 0);
 
@@ -286,16 +253,10 @@ template <class VoxelType> void irtkConvolutionWithGaussianDerivative2<VoxelType
 
     // Do convolution
     irtkConvolution_1D<VoxelType> convolutionZ;
-    convolutionZ.SetInput (this->_output);
     convolutionZ.SetInput2(&kernelZ);
-    convolutionZ.SetOutput(this->_output);
-    convolutionZ.irtkImageToImage<VoxelType>::Run();
+    convolutionZ.Run(output.FlipXZ(), output.FlipXZ());
   }
 
-  // Flip image back, first x and z axis, then x and y axis
-  this->_output->FlipXZ(1);
-  this->_output->FlipXY(1);
-
   // Do the final cleaning up
   this->Finalize();
 }
@@ -307,6 +268,9 @@ template <class VoxelType> void irtkConvolutionWithGaussianDerivative2<VoxelType
   // Do the initial set up
   this->Initialize();
 
+  // Views of input and output
+  irtkGenericImageView<VoxelType> input(*this->_input), output(*this->_output);
+
   // Get voxel dimensions
   this->_input->GetPixelSize(&xsize, &ysize, &zsize);
 
@@ -323,14 +287,9 @@ template <class VoxelType> void irtkConvolutionWithGaussianDerivative2<VoxelType
 
   // Do convolution
   irtkConvolution_1D<VoxelType> convolutionX;
-  convolutionX.SetInput ( this->_input);
   convolutionX.SetInput2(&kernelX);
-  convolutionX.SetOutput(this->_output);
   convolutionX.SetNormalization(true);
-  convolutionX.irtkImageToImage<VoxelType>::Run();
-
-  // Flip x and y axis of image
-  this->_output->FlipXY(1);
+  convolutionX.Run(input, output);
 
   // Create scalar function which corresponds to a 1D Gaussian function in Y
   irtkScalarGaussianDxDx gaussianDyDy(this->_Sigma/ysize, 1, 1, 0, 0, 0);
@@ -346,15 +305,10 @@ template <class VoxelType> void irtkConvolutionWithGaussianDerivative2<VoxelType
 
   // Do convolution
   irtkConvolution_1D<VoxelType> convolutionY;
-  convolutionY.SetInput (this->_output);
   convolutionY.SetInput2(&kernelY);
-  convolutionY.SetOutput(this->_output);
-  convolutionY.irtkImageToImage<VoxelType>::Run();
+  convolutionY.Run(output.FlipXY(), output.FlipXY());
 
-  // Flip x and z axis of image
-  this->_output->FlipXZ(1);
-
-  if (this->_output->GetX() != 1) {
+  if (this->_output->GetZ() != 1) {
     // Create scalar function which corresponds to a 1D Gaussian function in Z
     irtkScalarGaussian gaussianZ(this->_Sigma/zsize, 1, 1, 0, 0, 0);
 
@@ -369,17 +323,11 @@ template <class VoxelType> void irtkConvolutionWithGaussianDerivative2<VoxelType
 
     // Do convolution
     irtkConvolution_1D<VoxelType> convolutionZ;
-    convolutionZ.SetInput (this->_output);
     convolutionZ.SetInput2(&kernelZ);
-    convolutionZ.SetOutput(this->_output);
     convolutionZ.SetNormalization(true);
-    convolutionZ.irtkImageToImage<VoxelType>::Run();
+    convolutionZ.Run(output.FlipXZ(), output.FlipXZ());
   }
 
-  // Flip image back, first x and z axis, then x and y axis
-  this->_output->FlipXZ(1);
-  this->_output->FlipXY(1);
-
   // Do the final cleaning up
   this->Finalize();
 }
@@ -391,6 +339,9 @@ template <class VoxelType> void irtkConvolutionWithGaussianDerivative2<VoxelType
   // Do the initial set up
   this->Initialize();
 
+  // Views of input and output
+  irtkGenericImageView<VoxelType> input(*this->_input), output(*this->_output);
+
   // Get voxel dimensions
   this->_input->GetPixelSize(&xsize, &ysize, &zsize);
 
@@ -408,14 +359,9 @@ template <class VoxelType> void irtkConvolutionWithGaussianDerivative2<VoxelType
 
   // Do convolution
   irtkConvolution_1D<VoxelType> convolutionX;
-  convolutionX.SetInput ( this->_input);
   convolutionX.SetInput2(&kernelX);
-  convolutionX.SetOutput(this->_output);
   convolutionX.SetNormalization(true);
-  convolutionX.irtkImageToImage<VoxelType>::Run();
-
-  // Flip x and y axis of image
-  this->_output->FlipXY(1);
+  convolutionX.Run(input, output);
 
   // Create scalar function which corresponds to a 1D Gaussian function in Y
   irtkScalarGaussianDx gaussianDy(this->_Sigma/ysize, 1, 1, 0, 0, 0);
@@ -431,13 +377,8 @@ template <class VoxelType> void irtkConvolutionWithGaussianDerivative2<VoxelType
 
   // Do convolution
   irtkConvolution_1D<VoxelType> convolutionY;
-  convolutionY.SetInput (this->_output);
   convolutionY.SetInput2(&kernelY);
-  convolutionY.SetOutput(this->_output);
-  convolutionY.irtkImageToImage<VoxelType>::Run();
-
-  // Flip x and z axis of image
-  this->_output->FlipXZ(1);
+  convolutionY.Run(output.FlipXY(), output.FlipXY());
 
   if (this->_output->GetZ() != 1) {
     // Create scalar function which corresponds to a 1D Gaussian function in Z
@@ -454,16 +395,10 @@ template <class VoxelType> void irtkConvolutionWithGaussianDerivative2<VoxelType
 
     // Do convolution
     irtkConvolution_1D<VoxelType> convolutionZ;
-    convolutionZ.SetInput (this->_output);
     convolutionZ.SetInput2(&kernelZ);
-    convolutionZ.SetOutput(this->_output);
-    convolutionZ.irtkImageToImage<VoxelType>::Run();
+    convolutionZ.Run(output.FlipXZ(), output.FlipXZ());
   }
 
-  // Flip image back, first x and z axis, then x and y axis
-  this->_output->FlipXZ(1);
-  this->_output->FlipXY(1);
-
   // Do the final cleaning up
   this->Finalize();
 }
@@ -475,6 +410,9 @@ template <class VoxelType> void irtkConvolutionWithGaussianDerivative2<VoxelType
   // Do the initial set up
   this->Initialize();
 
+  // Views of input and output
+  irtkGenericImageView<VoxelType> input(*this->_input), output(*this->_output);
+
   // Get voxel dimensions
   this->_input->GetPixelSize(&xsize, &ysize, &zsize);
 
@@ -492,14 +430,9 @@ template <class VoxelType> void irtkConvolutionWithGaussianDerivative2<VoxelType
 
   // Do convolution
   irtkConvolution_1D<VoxelType> convolutionX;
-  convolutionX.SetInput ( this->_input);
   convolutionX.SetInput2(&kernelX);
-  convolutionX.SetOutput(this->_output);
   convolutionX.SetNormalization(true);
-  convolutionX.irtkImageToImage<VoxelType>::Run();
-
-  // Flip x and y axis of image
-  this->_output->FlipXY(1);
+  convolutionX.Run(input, output);
 
   // Create scalar function which corresponds to a 1D Gaussian function in Y
   irtkScalarGaussian gaussianY(this->_Sigma/ysize, 1, 1, 0, 0, 0);
@@ -515,16 +448,11 @@ template <class VoxelType> void irtkConvolutionWithGaussianDerivative2<VoxelType
 
   // Do convolution
   irtkConvolution_1D<VoxelType> convolutionY;
-  convolutionY.SetInput (this->_output);
   convolutionY.SetInput2(&kernelY);
-  convolutionY.SetOutput(this->_output);
   convolutionY.SetNormalization(true);
-  convolutionY.irtkImageToImage<VoxelType>::Run();
+  convolutionY.Run(output.FlipXY(), output.FlipXY());
 
-  // Flip x and z axis of image
-  this->_output->FlipXZ(1);
-
-  if (this->_output->GetX() != 1) {
+  if (this->_output->GetZ() != 1) {
     // Create scalar function which corresponds to a 1D Gaussian function in Z
     irtkScalarGaussianDxDx gaussianDzDz(this->_Sigma/zsize, 1, 1, 0, 0, 0);
 
@@ -539,16 +467,10 @@ template <class VoxelType> void irtkConvolutionWithGaussianDerivative2<VoxelType
 
     // Do convolution
     irtkConvolution_1D<VoxelType> convolutionZ;
-    convolutionZ.SetInput (this->_output);
     convolutionZ.SetInput2(&kernelZ);
-    convolutionZ.SetOutput(this->_output);
-    convolutionZ.irtkImageToImage<VoxelType>::Run();
+    convolutionZ.Run(output.FlipXZ(), output.FlipXZ());
   }
 
-  // Flip image back, first x and z axis, then x and y axis
-  this->_output->FlipXZ(1);
-  this->_output->FlipXY(1);
-
   // Do the final cleaning up
   this->Finalize();
 }
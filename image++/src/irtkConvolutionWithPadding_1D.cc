@@ -124,6 +124,55 @@ template <class VoxelType> double irtkConvolutionWithPadding_1D<VoxelType>::Run(
   }
 }
 
+template <class VoxelType> void irtkConvolutionWithPadding_1D<VoxelType>::ConvolveLines(const VoxelType *in, int n, int m, VoxelType *out, long stride, long offset)
+{
+  int x, x1, x2, i, b, r;
+  irtkRealPixel *kernel, w;
+  double val[IRTK_CONVOLUTION_LINES], sum[IRTK_CONVOLUTION_LINES];
+  const VoxelType *ptr;
+
+  kernel = this->_input2->GetPointerToVoxels();
+  r = this->_input2->GetX()/2;
+
+  for (x = 0; x < n; x++) {
+
+    // Clip kernel at boundaries of line
+    x1 = (x - r < 0) ? 0 : x - r;
+    x2 = (x + r > n - 1) ? n - 1 : x + r;
+
+    // Convolve all lines of block at once, ignoring padded voxels
+    for (b = 0; b < m; b++) {
+      val[b] = 0;
+      sum[b] = 0;
+    }
+    for (i = x1; i <= x2; i++) {
+      w   = kernel[i - x + r];
+      ptr = in + i * m;
+      for (b = 0; b < m; b++) {
+        if (ptr[b] > this->_padding) {
+          val[b] += w * ptr[b];
+          sum[b] += w;
+        }
+      }
+    }
+
+    for (b = 0; b < m; b++) {
+      if (in[x * m + b] <= this->_padding) {
+        out[x * stride + b * offset] = this->_padding;
+        continue;
+      }
+
+      if (this->_Normalization == true) {
+        val[b] = (sum[b] > 0) ? val[b] / sum[b] : 0;
+      }
+
+      if (val[b] > voxel_limits<VoxelType>::max()) val[b] = voxel_limits<VoxelType>::max();
+      if (val[b] < voxel_limits<VoxelType>::min()) val[b] = voxel_limits<VoxelType>::min();
+      out[x * stride + b * offset] = static_cast<VoxelType>(val[b]);
+    }
+  }
+}
+
 template class irtkConvolutionWithPadding_1D<unsigned char>;
 template class irtkConvolutionWithPadding_1D<short>;
 template class irtkConvolutionWithPadding_1D<unsigned short>;
@@ -18,9 +18,98 @@ See LICENSE for details
 
 #include <irtkConvolution.h>
 
+template <class VoxelType> class irtkMultiThreadedConvolution_1D
+{
+
+  /// Pointer to convolution filter
+  irtkConvolution_1D<VoxelType> *_filter;
+
+  /// Input and output views
+  irtkGenericImageView<VoxelType> _input, _output;
+
+  /// Number of blocks of lines along y
+  int _blocks;
+
+public:
+
+  irtkMultiThreadedConvolution_1D(irtkConvolution_1D<VoxelType> *filter, const irtkGenericImageView<VoxelType> &input, const irtkGenericImageView<VoxelType> &output) {
+    _filter = filter;
+    _input  = input;
+    _output = output;
+    _blocks = (input.GetY() + IRTK_CONVOLUTION_LINES - 1) / IRTK_CONVOLUTION_LINES;
+  }
+
+  void operator()(const blocked_range<int> &r) const {
+    int i, j, k, l, m, n, b, t;
+    VoxelType *buffer, *ptr;
+
+    n = _input.GetX();
+    buffer = new VoxelType[n * IRTK_CONVOLUTION_LINES];
+
+    for (l = r.begin(); l != r.end(); l++) {
+      j = (l % _blocks) * IRTK_CONVOLUTION_LINES;
+      k = (l / _blocks) % _input.GetZ();
+      t = (l / _blocks) / _input.GetZ();
+      m = (_input.GetY() - j < IRTK_CONVOLUTION_LINES) ? _input.GetY() - j : IRTK_CONVOLUTION_LINES;
+
+      // Copy block of input lines, so that input and output may overlap. The
+      // lines are interleaved, so that voxel i of line b is at buffer[i*m+b]
+      for (i = 0; i < n; i++) {
+        ptr = _input.GetPointerToVoxels(i, j, k, t);
+        for (b = 0; b < m; b++) {
+          buffer[i * m + b] = *ptr;
+          ptr += _input.GetYStride();
+        }
+      }
+      _filter->ConvolveLines(buffer, n, m, _output.GetPointerToVoxels(0, j, k, t), _output.GetXStride(), _output.GetYStride());
+    }
+
+    delete []buffer;
+  }
+};
+
+template <class VoxelType> static void irtkConvolution_1D_Extent(const irtkGenericImageView<VoxelType> &view, VoxelType *&first, VoxelType *&last)
+{
+  long offset1, offset2, stride[4];
+  int i, n[4];
+
+  stride[0] = view.GetXStride();
+  stride[1] = view.GetYStride();
+  stride[2] = view.GetZStride();
+  stride[3] = view.GetTStride();
+  n[0] = view.GetX();
+  n[1] = view.GetY();
+  n[2] = view.GetZ();
+  n[3] = view.GetT();
+
+  // Offsets of the voxels with the lowest and highest address
+  offset1 = 0;
+  offset2 = 0;
+  for (i = 0; i < 4; i++) {
+    if (stride[i] < 0) {
+      offset1 += stride[i] * (n[i] - 1);
+    } else {
+      offset2 += stride[i] * (n[i] - 1);
+    }
+  }
+  first = view.GetPointerToVoxels() + offset1;
+  last  = view.GetPointerToVoxels() + offset2;
+}
+
+template <class VoxelType> static bool irtkConvolution_1D_Overlap(const irtkGenericImageView<VoxelType> &input, const irtkGenericImageView<VoxelType> &output)
+{
+  VoxelType *first1, *last1, *first2, *last2;
+
+  irtkConvolution_1D_Extent(input, first1, last1);
+  irtkConvolution_1D_Extent(output, first2, last2);
+  return (first1 <= last2) && (first2 <= last1);
+}
+
 template <class VoxelType> irtkConvolution_1D<VoxelType>::irtkConvolution_1D(bool Normalization) :
     irtkConvolution<VoxelType>(Normalization)
-{}
+{
+  _input2 = NULL;
+}
 
 template <class VoxelType> bool irtkConvolution_1D<VoxelType>::RequiresBuffering(void)
 {
@@ -121,6 +210,88 @@ template <class VoxelType> double irtkConvolution_1D<VoxelType>::Run(int x, int
   }
 }
 
+template <class VoxelType> void irtkConvolution_1D<VoxelType>::ConvolveLines(const VoxelType *in, int n, int m, VoxelType *out, long stride, long offset)
+{
+  int x, x1, x2, i, b, r;
+  irtkRealPixel *kernel, w;
+  irtkRealPixel val[IRTK_CONVOLUTION_LINES], sum;
+  const VoxelType *ptr;
+  double value;
+
+  kernel = this->_input2->GetPointerToVoxels();
+  r = this->_input2->GetX()/2;
+
+  for (x = 0; x < n; x++) {
+
+    // Clip kernel at boundaries of line
+    x1 = (x - r < 0) ? 0 : x - r;
+    x2 = (x + r > n - 1) ? n - 1 : x + r;
+
+    // Convolve all lines of block at once
+    for (b = 0; b < m; b++) val[b] = 0;
+    sum = 0;
+    for (i = x1; i <= x2; i++) {
+      w   = kernel[i - x + r];
+      ptr = in + i * m;
+      for (b = 0; b < m; b++) val[b] += w * ptr[b];
+      sum += w;
+    }
+
+    for (b = 0; b < m; b++) {
+
+      //  Normalize filter value by sum of filter elements
+      if (this->_Normalization == true) {
+        value = (sum > 0) ? val[b] / sum : 0;
+      } else {
+        value = val[b];
+      }
+
+      if (value > voxel_limits<VoxelType>::max()) value = voxel_limits<VoxelType>::max();
+      if (value < voxel_limits<VoxelType>::min()) value = voxel_limits<VoxelType>::min();
+      out[x * stride + b * offset] = static_cast<VoxelType>(value);
+    }
+  }
+}
+
+template <class VoxelType> void irtkConvolution_1D<VoxelType>::Run(const irtkGenericImageView<VoxelType> &input, const irtkGenericImageView<VoxelType> &output)
+{
+  // Check kernel
+  if (this->_input2 == NULL) {
+    cerr << this->NameOfClass() << "::Run: Filter has no second input" << endl;
+    exit(1);
+  }
+
+  // Check views
+  if ((input.GetX() != output.GetX()) || (input.GetY() != output.GetY()) ||
+      (input.GetZ() != output.GetZ()) || (input.GetT() != output.GetT())) {
+    cerr << this->NameOfClass() << "::Run: Input and output views differ in size" << endl;
+    exit(1);
+  }
+  if (input.GetNumberOfVoxels() == 0) return;
+
+  // Each line is buffered before it is overwritten, so input and output may
+  // only share voxels if they are the same view
+  if ((irtkConvolution_1D_Overlap(input, output) == true) &&
+      ((input.GetPointerToVoxels() != output.GetPointerToVoxels()) ||
+       (input.GetXStride() != output.GetXStride()) || (input.GetYStride() != output.GetYStride()) ||
+       (input.GetZStride() != output.GetZStride()) || (input.GetTStride() != output.GetTStride()))) {
+    cerr << this->NameOfClass() << "::Run: Input and output views overlap" << endl;
+    exit(1);
+  }
+
+  // Lines are processed in blocks of neighbours along y, so use the axis
+  // with the smaller stride as y
+  if (labs(input.GetZStride()) < labs(input.GetYStride())) {
+    this->Run(input.FlipYZ(), output.FlipYZ());
+    return;
+  }
+
+  task_scheduler_init init(tbb_no_threads);
+  irtkMultiThreadedConvolution_1D<VoxelType> body(this, input, output);
+  parallel_for(blocked_range<int>(0, (input.GetY() + IRTK_CONVOLUTION_LINES - 1) / IRTK_CONVOLUTION_LINES * input.GetZ() * input.GetT()), body);
+  init.terminate();
+}
+
 template <class VoxelType> void irtkConvolution_1D<VoxelType>::Initialize()
 {
   // Check kernel
@@ -29,7 +29,7 @@ irtkFileToImage::irtkFileToImage()
   _debug = true;
   _start = 0;
   _imagename = NULL;
-
+  _mapping = MemoryMap_None;
 }
 
 irtkFileToImage::~irtkFileToImage()
@@ -42,8 +42,8 @@ irtkFileToImage::~irtkFileToImage()
   _reflectZ = false;
   _debug = true;
   _start = 0;
-  if (_imagename != NULL) 
-      _imagename = NULL;
+  if (_imagename != NULL) free(_imagename);
+  _imagename = NULL;
 }
 
 irtkFileToImage *irtkFileToImage::New(const char *imagename)
@@ -119,6 +119,16 @@ void irtkFileToImage::PutDebugFlag(int debug)
   _debug = debug;
 }
 
+irtkMemoryMapMode irtkFileToImage::GetMemoryMapMode()
+{
+  return _mapping;
+}
+
+void irtkFileToImage::PutMemoryMapMode(irtkMemoryMapMode mapping)
+{
+  _mapping = mapping;
+}
+
 const char *irtkFileToImage::NameOfClass()
 {
   return "irtkFileToImage";
@@ -130,7 +140,9 @@ void irtkFileToImage::SetInput(const char *imagename)
   this->Close();
 
   // Copy new file name
-  _imagename = imagename;
+  char *copy = strdup(imagename);
+  if (_imagename != NULL) free(_imagename);
+  _imagename = copy;
 
   // Open new file for reading
   this->Open(_imagename);
@@ -139,10 +151,80 @@ void irtkFileToImage::SetInput(const char *imagename)
   this->ReadHeader();
 }
 
+irtkImage *irtkFileToImage::MapOutput()
+{
+  irtkImage *output = NULL;
+  irtkMemoryMappedFile *file;
+  long size;
+
+  if ((_mapping == MemoryMap_None) || (irtkMemoryMappedFile::IsSupported() == false)) return NULL;
+
+  // Voxels must be usable as stored in the file
+  if ((_swapped == true) && (_bytes > 1)) return NULL;
+  if ((_reflectX == true) || (_reflectY == true) || (_reflectZ == true)) return NULL;
+  if ((_bytes <= 0) || (_start % _bytes != 0)) return NULL;
+
+  // Map file
+  file = new irtkMemoryMappedFile;
+  if (file->Open(_imagename, _mapping) == false) {
+    delete file;
+    return NULL;
+  }
+
+  // Check that file holds all voxels
+  size = static_cast<long>(_attr._x) * _attr._y * _attr._z * _attr._t * _bytes;
+  if (file->GetSize() < _start + size) {
+    delete file;
+    return NULL;
+  }
+
+  switch (_type) {
+  case IRTK_VOXEL_CHAR:
+    output = new irtkGenericImage<char>;
+    dynamic_cast<irtkGenericImage<char> *>(output)->Initialize(_attr, file, _start);
+    break;
+  case IRTK_VOXEL_UNSIGNED_CHAR:
+    output = new irtkGenericImage<unsigned char>;
+    dynamic_cast<irtkGenericImage<unsigned char> *>(output)->Initialize(_attr, file, _start);
+    break;
+  case IRTK_VOXEL_SHORT:
+    output = new irtkGenericImage<short>;
+    dynamic_cast<irtkGenericImage<short> *>(output)->Initialize(_attr, file, _start);
+    break;
+  case IRTK_VOXEL_UNSIGNED_SHORT:
+    output = new irtkGenericImage<unsigned short>;
+    dynamic_cast<irtkGenericImage<unsigned short> *>(output)->Initialize(_attr, file, _start);
+    break;
+  case IRTK_VOXEL_INT:
+    output = new irtkGenericImage<int>;
+    dynamic_cast<irtkGenericImage<int> *>(output)->Initialize(_attr, file, _start);
+    break;
+  case IRTK_VOXEL_UNSIGNED_INT:
+    output = new irtkGenericImage<unsigned int>;
+    dynamic_cast<irtkGenericImage<unsigned int> *>(output)->Initialize(_attr, file, _start);
+    break;
+  case IRTK_VOXEL_FLOAT:
+    output = new irtkGenericImage<float>;
+    dynamic_cast<irtkGenericImage<float> *>(output)->Initialize(_attr, file, _start);
+    break;
+  case IRTK_VOXEL_DOUBLE:
+    output = new irtkGenericImage<double>;
+    dynamic_cast<irtkGenericImage<double> *>(output)->Initialize(_attr, file, _start);
+    break;
+  default:
+    delete file;
+  }
+
+  return output;
+}
+
 irtkImage *irtkFileToImage::GetOutput()
 {
   irtkImage *output = NULL;
 
+  // Wrap memory mapped file if possible
+  if ((output = this->MapOutput()) != NULL) return output;
+
   // Bring image to correct size
   switch (_type) {
   case IRTK_VOXEL_CHAR: {
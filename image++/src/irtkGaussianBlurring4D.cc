@@ -48,6 +48,9 @@ template <class VoxelType> void irtkGaussianBlurring4D<VoxelType>::Run()
   // Do the initial set up
   this->Initialize();
 
+  // Views of input and output
+  irtkGenericImageView<VoxelType> input(*this->_input), output(*this->_output);
+
   // Get voxel dimensions
   this->_input->GetPixelSize(&xsize, &ysize, &zsize, &tsize);
 
@@ -65,14 +68,9 @@ template <class VoxelType> void irtkGaussianBlurring4D<VoxelType>::Run()
 
   // Do convolution
   irtkConvolution_1D<VoxelType> convolutionX;
-  convolutionX.SetInput ( this->_input);
   convolutionX.SetInput2(&kernelX);
-  convolutionX.SetOutput(this->_output);
   convolutionX.SetNormalization(true);
-  convolutionX.irtkImageToImage<VoxelType>::Run();
-
-  // Flip x and y axis of image
-  this->_output->FlipXY(1);
+  convolutionX.Run(input, output);
 
   // Create scalar function which corresponds to a 1D Gaussian function in Y
   irtkScalarGaussian gaussianY(this->_Sigma/ysize, 1, 1, 0, 0, 0);
@@ -88,16 +86,11 @@ template <class VoxelType> void irtkGaussianBlurring4D<VoxelType>::Run()
 
   // Do convolution
   irtkConvolution_1D<VoxelType> convolutionY;
-  convolutionY.SetInput (this->_output);
   convolutionY.SetInput2(&kernelY);
-  convolutionY.SetOutput(this->_output);
   convolutionY.SetNormalization(true);
-  convolutionY.irtkImageToImage<VoxelType>::Run();
-
-  // Flip x and z axis of image
-  this->_output->FlipXZ(1);
+  convolutionY.Run(output.FlipXY(), output.FlipXY());
 
-  if (this->_output->GetX() != 1) {
+  if (this->_output->GetZ() != 1) {
     // Create scalar function which corresponds to a 1D Gaussian function in Z
     irtkScalarGaussian gaussianZ(this->_Sigma/zsize, 1, 1, 0, 0, 0);
 
@@ -112,16 +105,11 @@ template <class VoxelType> void irtkGaussianBlurring4D<VoxelType>::Run()
 
     // Do convolution
     irtkConvolution_1D<VoxelType> convolutionZ;
-    convolutionZ.SetInput (this->_output);
     convolutionZ.SetInput2(&kernelZ);
-    convolutionZ.SetOutput(this->_output);
     convolutionZ.SetNormalization(true);
-    convolutionZ.irtkImageToImage<VoxelType>::Run();
+    convolutionZ.Run(output.FlipXZ(), output.FlipXZ());
   }
 
-  // Flip x and t axis of image
-  this->_output->FlipXT(1);
-
   // Create scalar function which corresponds to a 1D Gaussian function in T
   irtkScalarGaussian gaussianT(this->_Sigma/tsize, 1, 1, 0, 0, 0);
 
@@ -136,16 +124,9 @@ template <class VoxelType> void irtkGaussianBlurring4D<VoxelType>::Run()
 
   // Do convolution
   irtkConvolution_1D<VoxelType> convolutionT;
-  convolutionT.SetInput (this->_output);
   convolutionT.SetInput2(&kernelT);
-  convolutionT.SetOutput(this->_output);
   convolutionT.SetNormalization(true);
-  convolutionT.irtkImageToImage<VoxelType>::Run();
-
-  // Flip image back, first t and z axis, then x and z axis and finally x and y axis
-  this->_output->FlipXT(1);
-  this->_output->FlipXZ(1);
-  this->_output->FlipXY(1);
+  convolutionT.Run(output.FlipXT(), output.FlipXT());
 
   // Do the final cleaning up
   this->Finalize();
@@ -44,6 +44,9 @@ template <class VoxelType> void irtkGaussianBlurringWithPadding<VoxelType>::Run(
   // Do the initial set up
   this->Initialize();
 
+  // Views of input and output
+  irtkGenericImageView<VoxelType> input(*this->_input), output(*this->_output);
+
   // Get voxel dimensions
   this->_input->GetPixelSize(&xsize, &ysize, &zsize);
 
@@ -61,14 +64,9 @@ template <class VoxelType> void irtkGaussianBlurringWithPadding<VoxelType>::Run(
 
   // Do convolution
   irtkConvolutionWithPadding_1D<VoxelType> convolutionX(this->_PaddingValue);
-  convolutionX.SetInput ( this->_input);
   convolutionX.SetInput2(&kernelX);
-  convolutionX.SetOutput(this->_output);
   convolutionX.SetNormalization(true);
-  convolutionX.irtkImageToImage<VoxelType>::Run();
-
-  // Flip x and y axis of image
-  this->_output->FlipXY(1);
+  convolutionX.irtkConvolution_1D<VoxelType>::Run(input, output);
 
   // Create scalar function which corresponds to a 1D Gaussian function in Y
   irtkScalarGaussian gaussianY(this->_Sigma/ysize, 1, 1, 0, 0, 0);
@@ -84,16 +82,11 @@ template <class VoxelType> void irtkGaussianBlurringWithPadding<VoxelType>::Run(
 
   // Do convolution
   irtkConvolutionWithPadding_1D<VoxelType> convolutionY(this->_PaddingValue);
-  convolutionY.SetInput (this->_output);
   convolutionY.SetInput2(&kernelY);
-  convolutionY.SetOutput(this->_output);
   convolutionY.SetNormalization(true);
-  convolutionY.irtkImageToImage<VoxelType>::Run();
+  convolutionY.irtkConvolution_1D<VoxelType>::Run(output.FlipXY(), output.FlipXY());
 
-  // Flip x and z axis of image
-  this->_output->FlipXZ(1);
-
-  if (this->_output->GetX() != 1) {
+  if (this->_output->GetZ() != 1) {
     // Create scalar function which corresponds to a 1D Gaussian function in Z
     irtkScalarGaussian gaussianZ(this->_Sigma/zsize, 1, 1, 0, 0, 0);
 
@@ -108,17 +101,11 @@ template <class VoxelType> void irtkGaussianBlurringWithPadding<VoxelType>::Run(
 
     // Do convolution
     irtkConvolutionWithPadding_1D<VoxelType> convolutionZ(this->_PaddingValue);
-    convolutionZ.SetInput (this->_output);
     convolutionZ.SetInput2(&kernelZ);
-    convolutionZ.SetOutput(this->_output);
     convolutionZ.SetNormalization(true);
-    convolutionZ.irtkImageToImage<VoxelType>::Run();
+    convolutionZ.irtkConvolution_1D<VoxelType>::Run(output.FlipXZ(), output.FlipXZ());
   }
 
-  // Flip image back, first x and z axis, then x and y axis
-  this->_output->FlipXZ(1);
-  this->_output->FlipXY(1);
-
   // Do the final cleaning up
   this->Finalize();
 }
@@ -130,16 +117,13 @@ template <class VoxelType> void irtkGaussianBlurringWithPadding<VoxelType>::RunZ
   // Do the initial set up
   this->Initialize();
 
+  // Views of input and output
+  irtkGenericImageView<VoxelType> input(*this->_input), output(*this->_output);
+
   // Get voxel dimensions
   this->_input->GetPixelSize(&xsize, &ysize, &zsize);
 
-  // Flip x and y axis of image
-  this->_output->FlipXY(1);
-
-  // Flip x and z axis of image
-  this->_output->FlipXZ(1);
-
-  if (this->_output->GetX() != 1) {
+  if (this->_output->GetZ() != 1) {
     // Create scalar function which corresponds to a 1D Gaussian function in Z
     irtkScalarGaussian gaussianZ(this->_Sigma/zsize, 1, 1, 0, 0, 0);
 
@@ -154,17 +138,13 @@ template <class VoxelType> void irtkGaussianBlurringWithPadding<VoxelType>::RunZ
 
     // Do convolution
     irtkConvolutionWithPadding_1D<VoxelType> convolutionZ(this->_PaddingValue);
-    convolutionZ.SetInput (this->_output);
     convolutionZ.SetInput2(&kernelZ);
-    convolutionZ.SetOutput(this->_output);
     convolutionZ.SetNormalization(true);
-    convolutionZ.irtkImageToImage<VoxelType>::Run();
+    convolutionZ.irtkConvolution_1D<VoxelType>::Run(input.FlipXZ(), output.FlipXZ());
+  } else if (this->_input != this->_output) {
+    output.Copy(input);
   }
 
-  // Flip image back, first x and z axis, then x and y axis
-  this->_output->FlipXZ(1);
-  this->_output->FlipXY(1);
-
   // Do the final cleaning up
   this->Finalize();
 }
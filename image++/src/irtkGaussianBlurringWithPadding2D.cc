@@ -34,6 +34,9 @@ template <class VoxelType> void irtkGaussianBlurringWithPadding2D<VoxelType>::Ru
   // Do the initial set up
   this->Initialize();
 
+  // Views of input and output
+  irtkGenericImageView<VoxelType> input(*this->_input), output(*this->_output);
+
   // Get voxel dimensions
   this->_input->GetPixelSize(&xsize, &ysize, &zsize);
 
@@ -51,14 +54,9 @@ template <class VoxelType> void irtkGaussianBlurringWithPadding2D<VoxelType>::Ru
 
   // Do convolution
   irtkConvolutionWithPadding_1D<VoxelType> convolutionX(this->_PaddingValue);
-  convolutionX.SetInput ( this->_input);
   convolutionX.SetInput2(&kernelX);
-  convolutionX.SetOutput(this->_output);
   convolutionX.SetNormalization(true);
-  convolutionX.irtkImageToImage<VoxelType>::Run();
-
-  // Flip x and y axis of image
-  this->_output->FlipXY(1);
+  convolutionX.irtkConvolution_1D<VoxelType>::Run(input, output);
 
   // Create scalar function which corresponds to a 1D Gaussian function in Y
   irtkScalarGaussian gaussianY(this->_Sigma/ysize, 1, 1, 0, 0, 0);
@@ -74,14 +72,9 @@ template <class VoxelType> void irtkGaussianBlurringWithPadding2D<VoxelType>::Ru
 
   // Do convolution
   irtkConvolutionWithPadding_1D<VoxelType> convolutionY(this->_PaddingValue);
-  convolutionY.SetInput (this->_output);
   convolutionY.SetInput2(&kernelY);
-  convolutionY.SetOutput(this->_output);
   convolutionY.SetNormalization(true);
-  convolutionY.irtkImageToImage<VoxelType>::Run();
-
-  // Flip image back (x and y axis)
-  this->_output->FlipXY(1);
+  convolutionY.irtkConvolution_1D<VoxelType>::Run(output.FlipXY(), output.FlipXY());
 
   // Do the final cleaning up
   this->Finalize();
@@ -30,6 +30,7 @@ template <class VoxelType> irtkGenericImage<VoxelType>::irtkGenericImage(void) :
 
   // Initialize data
   _matrix  = NULL;
+  _mappedFile = NULL;
 }
 
 template <class VoxelType> irtkGenericImage<VoxelType>::irtkGenericImage(int x, int y, int z, int t) : irtkBaseImage()
@@ -43,6 +44,7 @@ template <class VoxelType> irtkGenericImage<VoxelType>::irtkGenericImage(int x,
 
   // Initialize data
   _matrix = NULL;
+  _mappedFile = NULL;
 
   // Initialize rest of class
   this->Initialize(attr);
@@ -52,6 +54,7 @@ template <class VoxelType> irtkGenericImage<VoxelType>::irtkGenericImage(char *f
 {
   // Initialize data
   _matrix = NULL;
+  _mappedFile = NULL;
 
   // Read image
   this->Read(filename);
@@ -61,6 +64,7 @@ template <class VoxelType> irtkGenericImage<VoxelType>::irtkGenericImage(const i
 {
   // Initialize data
   _matrix  = NULL;
+  _mappedFile = NULL;
 
   // Initialize rest of class
   this->Initialize(attr);
@@ -73,6 +77,7 @@ template <class VoxelType> irtkGenericImage<VoxelType>::irtkGenericImage(const i
 
   // Initialize data
   _matrix = NULL;
+  _mappedFile = NULL;
 
   // Initialize rest of class
   this->Initialize(image._attr);
@@ -93,6 +98,7 @@ template <class VoxelType> template <class VoxelType2> irtkGenericImage<VoxelTyp
 
   // Initialize data
   _matrix = NULL;
+  _mappedFile = NULL;
 
   // Initialize rest of class
   this->Initialize(image.GetImageAttributes());
@@ -108,7 +114,7 @@ template <class VoxelType> template <class VoxelType2> irtkGenericImage<VoxelTyp
 template <class VoxelType> irtkGenericImage<VoxelType>::~irtkGenericImage(void)
 {
   if (_matrix != NULL) {
-    Deallocate<VoxelType>(_matrix);
+    this->FreeMatrix(_matrix);
     _matrix = NULL;
   }
   _attr._x = 0;
@@ -159,10 +165,12 @@ template <> const char *irtkGenericImage<double>::NameOfClass()
 
 template <class VoxelType> void irtkGenericImage<VoxelType>::Initialize(const irtkImageAttributes &attr)
 {
-  // Free memory
-  if ((_attr._x != attr._x) || (_attr._y != attr._y) || (_attr._z != attr._z) || (_attr._t != attr._t)) {
+  // Free memory (memory mapped image data is never reused, clearing the voxels
+  // below would otherwise overwrite a file which is mapped read-write)
+  if ((_attr._x != attr._x) || (_attr._y != attr._y) || (_attr._z != attr._z) || (_attr._t != attr._t) ||
+      (_mappedFile != NULL)) {
     // Free old memory
-    if (_matrix != NULL) Deallocate<VoxelType>(_matrix);
+    if (_matrix != NULL) this->FreeMatrix(_matrix);
     // Allocate new memory
     if (attr._x*attr._y*attr._z*attr._t > 0) {
       _matrix = Allocate(_matrix, attr._x, attr._y, attr._z, attr._t);
@@ -178,11 +186,40 @@ template <class VoxelType> void irtkGenericImage<VoxelType>::Initialize(const ir
   *this = VoxelType();
 }
 
+template <class VoxelType> void irtkGenericImage<VoxelType>::Initialize(const irtkImageAttributes &attr, irtkMemoryMappedFile *file, long offset)
+{
+  // Free old memory
+  if (_matrix != NULL) this->FreeMatrix(_matrix);
+  _matrix = NULL;
+
+  // Wrap mapped memory, the file stays mapped until the image data is freed
+  if (attr._x*attr._y*attr._z*attr._t > 0) {
+    _matrix = Allocate(_matrix, attr._x, attr._y, attr._z, attr._t, reinterpret_cast<VoxelType *>(file->GetPointer(offset)));
+  }
+  _mappedFile = file;
+
+  // Initialize base class
+  this->irtkBaseImage::Update(attr);
+}
+
+template <class VoxelType> void irtkGenericImage<VoxelType>::FreeMatrix(VoxelType ****matrix)
+{
+  if (_mappedFile != NULL) {
+    // Image data belongs to memory mapped file
+    if (matrix != NULL) DeallocatePointers<VoxelType>(matrix);
+    delete _mappedFile;
+    _mappedFile = NULL;
+  } else {
+    Deallocate<VoxelType>(matrix);
+  }
+}
+
 template <class VoxelType> void irtkGenericImage<VoxelType>::Clear()
 {
 	// Free memory
 	if (_matrix != NULL)
-		Deallocate<VoxelType>(_matrix);
+		this->FreeMatrix(_matrix);
+	_matrix = NULL;
 
   _attr._x = 0;
   _attr._y = 0;
@@ -191,40 +228,62 @@ template <class VoxelType> void irtkGenericImage<VoxelType>::Clear()
 
 }
 
-template <class VoxelType> void irtkGenericImage<VoxelType>::Read(const char *filename)
+template <class VoxelType> void irtkGenericImage<VoxelType>::Read(const char *filename, irtkMemoryMapMode mode)
 {
   irtkBaseImage *image;
+  irtkGenericImage<VoxelType> *same;
 
   // Allocate file reader
   irtkFileToImage *reader = irtkFileToImage::New(filename);
 
+  // Intensities are scaled in place which requires private writable memory,
+  // scaling a read-write mapping would write the scaled voxels to the file
+  if ((mode != MemoryMap_None) && (reader->GetSlope() != 0) && ((reader->GetSlope() != 1) || (reader->GetIntercept() != 0))) {
+    if (mode == MemoryMap_ReadWrite) {
+      cerr << this->NameOfClass() << "::Read: Intensities of " << filename << " are scaled, changes are not written to the file" << endl;
+    }
+    mode = MemoryMap_CopyOnWrite;
+  }
+
+  // Set memory mapping mode
+  reader->PutMemoryMapMode(mode);
+
   // Get output
   image = reader->GetOutput();
 
-  // Convert image
-  switch (reader->GetDataType()) {
-          
-  case IRTK_VOXEL_CHAR: { *this = *(dynamic_cast<irtkGenericImage<char> *>(image)); } break;
+  // Take over image data of same type instead of copying it
+  if ((same = dynamic_cast<irtkGenericImage<VoxelType> *>(image)) != NULL) {
+    swap(_matrix, same->_matrix);
+    swap(_mappedFile, same->_mappedFile);
+    this->irtkBaseImage::Update(same->_attr);
+  } else {
+
+    // Convert image
+    switch (reader->GetDataType()) {
+
+    case IRTK_VOXEL_CHAR: { *this = *(dynamic_cast<irtkGenericImage<char> *>(image)); } break;
 
-  case IRTK_VOXEL_UNSIGNED_CHAR: { *this = *(dynamic_cast<irtkGenericImage<unsigned char> *>(image)); } break;
+    case IRTK_VOXEL_UNSIGNED_CHAR: { *this = *(dynamic_cast<irtkGenericImage<unsigned char> *>(image)); } break;
 
-  case IRTK_VOXEL_SHORT: { *this = *(dynamic_cast<irtkGenericImage<short> *>(image)); } break;
+    case IRTK_VOXEL_SHORT: { *this = *(dynamic_cast<irtkGenericImage<short> *>(image)); } break;
 
-  case IRTK_VOXEL_UNSIGNED_SHORT: { *this = *(dynamic_cast<irtkGenericImage<unsigned short> *>(image)); } break;
-    
-  case IRTK_VOXEL_INT: { *this = *(dynamic_cast<irtkGenericImage<int> *>(image)); } break;
+    case IRTK_VOXEL_UNSIGNED_SHORT: { *this = *(dynamic_cast<irtkGenericImage<unsigned short> *>(image)); } break;
 
-  case IRTK_VOXEL_UNSIGNED_INT: { *this = *(dynamic_cast<irtkGenericImage<unsigned int> *>(image)); } break;
+    case IRTK_VOXEL_INT: { *this = *(dynamic_cast<irtkGenericImage<int> *>(image)); } break;
 
-  case IRTK_VOXEL_FLOAT: { *this = *(dynamic_cast<irtkGenericImage<float> *>(image)); } break;
+    case IRTK_VOXEL_UNSIGNED_INT: { *this = *(dynamic_cast<irtkGenericImage<unsigned int> *>(image)); } break;
 
-  case IRTK_VOXEL_DOUBLE: { *this = *(dynamic_cast<irtkGenericImage<double> *>(image)); } break;
+    case IRTK_VOXEL_FLOAT: { *this = *(dynamic_cast<irtkGenericImage<float> *>(image)); } break;
 
-  default:
-      cout << "irtkGenericImage::GetOutput: Unknown voxel type" << endl;
+    case IRTK_VOXEL_DOUBLE: { *this = *(dynamic_cast<irtkGenericImage<double> *>(image)); } break;
+
+    default:
+        cout << "irtkGenericImage::GetOutput: Unknown voxel type" << endl;
+    }
   }
 
-  if (reader->GetSlope() != 0) {
+  // Scale intensities (skipped for identity, which leaves mapped pages untouched)
+  if ((reader->GetSlope() != 0) && ((reader->GetSlope() != 1) || (reader->GetIntercept() != 0))) {
       switch (this->GetScalarType()) {
 
       case IRTK_VOXEL_FLOAT: {
@@ -1167,7 +1226,7 @@ template <class VoxelType> void irtkGenericImage<VoxelType>::FlipXY(int modifyOr
   swap(matrix, _matrix);
 
   // Deallocate memory
-  matrix = Deallocate<VoxelType>(matrix);
+  this->FreeMatrix(matrix);
 
   // Swap image dimensions
   swap(_attr._x, _attr._y);
@@ -1207,7 +1266,7 @@ template <class VoxelType> void irtkGenericImage<VoxelType>::FlipXZ(int modifyOr
   swap(matrix, _matrix);
 
   // Deallocate memory
-  matrix = Deallocate<VoxelType>(matrix);
+  this->FreeMatrix(matrix);
 
   // Swap image dimensions
   swap(_attr._x, _attr._z);
@@ -1246,7 +1305,7 @@ template <class VoxelType> void irtkGenericImage<VoxelType>::FlipYZ(int modifyOr
   swap(matrix, _matrix);
 
   // Deallocate memory
-  matrix = Deallocate<VoxelType>(matrix);
+  this->FreeMatrix(matrix);
 
   // Swap image dimensions
   swap(_attr._y, _attr._z);
@@ -1285,7 +1344,7 @@ template <class VoxelType> void irtkGenericImage<VoxelType>::FlipXT(int modifyOr
   swap(matrix, _matrix);
 
   // Deallocate memory
-  matrix = Deallocate<VoxelType>(matrix);
+  this->FreeMatrix(matrix);
 
   // Swap image dimensions
   swap(_attr._x, _attr._t);
@@ -1325,7 +1384,7 @@ template <class VoxelType> void irtkGenericImage<VoxelType>::FlipYT(int modifyOr
   swap(matrix, _matrix);
 
   // Deallocate memory
-  matrix = Deallocate<VoxelType>(matrix);
+  this->FreeMatrix(matrix);
 
   // Swap image dimensions
   swap(_attr._y, _attr._t);
@@ -1365,7 +1424,7 @@ template <class VoxelType> void irtkGenericImage<VoxelType>::FlipZT(int modifyOr
   swap(matrix, _matrix);
 
   // Deallocate memory
-  matrix = Deallocate<VoxelType>(matrix);
+  this->FreeMatrix(matrix);
 
   // Swap image dimensions
   swap(_attr._z, _attr._t);
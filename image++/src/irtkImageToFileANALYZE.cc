@@ -37,7 +37,7 @@ void irtkImageToFileANALYZE::SetOutput(const char *name)
   char *imagename;
 
   if (this->_headername != NULL) free(this->_headername);
-  if (strstr(name, ".gz") == NULL) {
+  if (strstr(basename2(name), ".gz") == NULL) {
     this->_headername = strdup(name);
     imagename   = strdup(name);
     length      = strlen(name);
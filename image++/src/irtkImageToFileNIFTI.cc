@@ -139,11 +139,25 @@ void irtkImageToFileNIFTI::Run()
 	_hdr.nim = nifti_convert_nhdr2nim(nhdr, this->_output);// This sets fname and iname
 	_hdr.nim->iname_offset = 352;// Some nifti versions lose this on the way!
 
-	/// Set data pointer in nifti image struct
-	_hdr.nim->data = this->_input->GetScalarPointer();
+	if (strstr(basename2(this->_output), ".gz") != NULL) {
+		char extender[4] = {0, 0, 0, 0};
+
+		// Write compressed hdr and data with irtkCofstream which compresses in parallel
+		nhdr = nifti_convert_nim2nhdr(_hdr.nim);
+		this->Open(this->_output);
+		this->IsSwapped(false);
+		this->WriteAsChar((char *)&nhdr, sizeof(nhdr), 0);
+		this->WriteAsChar(extender, 4, sizeof(nhdr));
+		this->Write((char *)this->_input->GetScalarPointer(), _hdr.nim->iname_offset,
+		            static_cast<long>(_hdr.nim->nvox) * _hdr.nim->nbyper);
+		this->Close();
+	} else {
+		/// Set data pointer in nifti image struct
+		_hdr.nim->data = this->_input->GetScalarPointer();
 
-	// Write hdr and data
-	nifti_image_write(_hdr.nim);
+		// Write hdr and data
+		nifti_image_write(_hdr.nim);
+	}
 
 	// Finalize filter
 	this->Finalize();
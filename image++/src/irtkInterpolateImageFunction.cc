@@ -97,3 +97,12 @@ void irtkInterpolateImageFunction::Initialize()
   this->_z2 = +0.5;
 }
 
+void irtkInterpolateImageFunction::Evaluate(int n, const double *x, const double *y, const double *z, double *value, double time)
+{
+  int i;
+
+  for (i = 0; i < n; i++) {
+    value[i] = this->Evaluate(x[i], y[i], z[i], time);
+  }
+}
+
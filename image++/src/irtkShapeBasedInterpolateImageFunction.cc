@@ -152,7 +152,7 @@ void irtkShapeBasedInterpolateImageFunction::Initialize()
       labelcount ++;
       // Dmap _tinput to _dmap
       {
-	irtkRealImage inputA, inputB, outputA, outputB;
+	irtkRealImage inputA;
 
 	// Default mode
 	irtkEuclideanDistanceTransform<irtkRealPixel> 
@@ -161,39 +161,25 @@ void irtkShapeBasedInterpolateImageFunction::Initialize()
 
 	// Threshold image
 	inputA = _tinput;
-	inputB = _tinput;
 	for (t = 0; t < _tinput.GetT(); t++){
 	  for (z = 0; z < _tinput.GetZ(); z++) {
 	    for (y = 0; y < _tinput.GetY(); y++) {
 	      for (x = 0; x < _tinput.GetX(); x++) {
 		if (_tinput(x, y, z, t) > 0.5) {
 		  inputA(x, y, z, t) = 1;
-		  inputB(x, y, z, t) = 0;
 		} else {
 		  inputA(x, y, z, t) = 0;
-		  inputB(x, y, z, t) = 1;
 		}
 	      }
 	    }
 	  }
 	}
 
-	// Calculate EDT
+	// Calculate signed EDT, positive outside and negative inside
+	edt->SetSigned(true);
 	edt->SetInput (& inputA);
-	edt->SetOutput(&outputA);
-	edt->Run();		  
-	edt->SetInput (& inputB);
-	edt->SetOutput(&outputB);
+	edt->SetOutput(&_dmap);
 	edt->Run();
-	for (t = 0 ; t < _tinput.GetT(); t++){
-	  for (z = 0; z < _tinput.GetZ(); z++) {
-	    for (y = 0; y < _tinput.GetY(); y++) {
-	      for (x = 0; x < _tinput.GetX(); x++) {
-		_dmap(x, y, z, t)  = sqrt(outputA(x, y, z, t)) - sqrt(outputB(x, y, z, t));
-	      }
-	    }
-	  }
-	}
 	//fix the result to better visiualization and cspline interpolation
 	/*_dmap.GetMinMaxAsDouble(&dmin,&dmax);
 	  if( abs(dmin) > abs(dmax))
@@ -371,7 +357,7 @@ void irtkShapeBasedInterpolateImageFunction::Refine()
     if(sumcount > 0){
       // Dmap _tinput to _dmap
       {
-	irtkRealImage inputA, inputB, outputA, outputB;
+	irtkRealImage inputA;
 
 	// Default mode
 	irtkEuclideanDistanceTransform<irtkRealPixel> 
@@ -380,38 +366,24 @@ void irtkShapeBasedInterpolateImageFunction::Refine()
 		  
 	// Threshold image
 	inputA = _tinput;
-	inputB = _tinput;
 	for (t = 0; t < _tinput.GetT(); t++){
 	  for (z = 0; z < _tinput.GetZ(); z++) {
 	    for (y = 0; y < _tinput.GetY(); y++) {
 	      for (x = 0; x < _tinput.GetX(); x++) {
 		if (_tinput(x, y, z, t) > 0.5) {
 		  inputA(x, y, z, t) = 1;
-		  inputB(x, y, z, t) = 0;
 		} else {
 		  inputA(x, y, z, t) = 0;
-		  inputB(x, y, z, t) = 1;
 		}
 	      }
 	    }
 	  }
 	}
 
+	edt->SetSigned(true);
 	edt->SetInput (& inputA);
-	edt->SetOutput(&outputA);
-	edt->Run();		  
-	edt->SetInput (& inputB);
-	edt->SetOutput(&outputB);
+	edt->SetOutput(&_dmap);
 	edt->Run();
-	for (t = 0 ; t < _tinput.GetT(); t++){
-	  for (z = 0; z < _tinput.GetZ(); z++) {
-	    for (y = 0; y < _tinput.GetY(); y++) {
-	      for (x = 0; x < _tinput.GetX(); x++) {
-		_dmap(x, y, z, t)  = sqrt(outputA(x, y, z, t)) - sqrt(outputB(x, y, z, t));
-	      }
-	    }
-	  }
-	}
       }
 
       /*_dmap.GetMinMaxAsDouble(&dmin,&dmax);
@@ -3,12 +3,14 @@
 #include <irtkSpectralClustering.h>
 
 irtkMatrix read_csv(string csvFilename1, string csvFilename2);
+int read_rows(string csvFilename);
 void writeAtlases(string filename, int * atlases, int nrAtlases);
 void writeAtlasNames(string filename, int * atlases, int nrAtlases, vector<string> atlasNames);
 void usage()
 {
 	cerr << "usage LEAPatlas_selection [Atlas Similarities] [Target Similarities] [N selected atlases] [output]" << endl;
 	cerr << "-atlasNames [list of atlas names]. With this option, atlas names are written instead of numbers." << endl;
+	cerr << "-neighbours [k]. Embed sparse graph of the k most similar subjects of each subject." << endl;
 
 		
 }
@@ -36,6 +38,7 @@ int main(int argc, char **argv)
 	bool ok;
 	bool useAtlasNames = false;
 	vector<string> atlasNames = vector<string>();
+	int nrNeighbours = 0;
 	while (argc > 1){
 		ok = false;
 		if ((ok == false) && (strcmp(argv[1], "-atlasNames") == 0)){
@@ -64,15 +67,30 @@ int main(int argc, char **argv)
 		  useAtlasNames = true;
 		  ok = true;
 		}
+		if ((ok == false) && (strcmp(argv[1], "-neighbours") == 0)){
+		  argc--;
+		  argv++;
+		  nrNeighbours = atoi(argv[1]);
+		  argc--;
+		  argv++;
+		  ok = true;
+		}
 		if (ok == false){
 			cerr << "Can not parse argument " << argv[1] << endl;
 			usage();
 		}
 	}
-	cout << "Read similarity matrices" << endl;
+	int nrSubjects;
 	irtkMatrix w;
 	try{
-		w = read_csv(atlassims, targetsims);
+		if(nrNeighbours > 0){
+			nrSubjects = read_rows(atlassims) + 1;
+		}
+		else{
+			cout << "Read similarity matrices" << endl;
+			w = read_csv(atlassims, targetsims);
+			nrSubjects = w.Rows();
+		}
 	}
 	catch (int e){
 		if(e == 1){
@@ -80,13 +98,20 @@ int main(int argc, char **argv)
 		}
 		return -1;
 	}
-	irtkSpectralClustering le(w.Rows(), 2);
+	irtkSpectralClustering le(nrSubjects, 2);
+	if(nrNeighbours > 0){
+		// Similarities are streamed, the matrix of all similarities is not needed
+		cout << "Build graph of " << nrNeighbours << " most similar subjects" << endl;
+		le.InitializeNeighbourGraph(atlassims, targetsims, nrNeighbours);
+	}
+	else{
+		le.Initialize(w);
+	}
 	cout << "Do manifold embedding" << endl;
-	le.Initialize(w);
 	le.DoSpectralEmbedding();
 	int *selected_atlases = new int[nrAtlases];
 	cout << "Select " << nrAtlases << " closest atlases (IDs in [0...nAtlases-1]): " << endl;
-	le.GetNeighbours(w.Rows()-1, nrAtlases, selected_atlases);
+	le.GetNeighbours(nrSubjects-1, nrAtlases, selected_atlases);
 
 	if(useAtlasNames)
 		writeAtlasNames(outname, selected_atlases, nrAtlases, atlasNames);
@@ -95,6 +120,25 @@ int main(int argc, char **argv)
     delete []selected_atlases;
 }
 
+int read_rows(string csvFilename){
+
+	ifstream input;
+	input.open(csvFilename.c_str());
+	string value;
+	int rows = 0;
+	if(! input){
+		cerr << "File " << csvFilename << " does not exist" << endl;
+		throw 1;
+	}
+	while(input.good()){
+		getline(input, value, '\n');
+		rows++;
+
+	}
+	rows--;
+	return rows;
+}
+
 irtkMatrix read_csv(string csvFilename1, string csvFilename2){
 
 	ifstream input;
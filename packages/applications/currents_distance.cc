@@ -184,11 +184,26 @@ int main(int argc, char **argv)
 	if (dofinA_name != NULL){
 		// Apply the transformation to the points of surface A.
 		irtkTransformation *transformation = irtkTransformation::New(dofinA_name);
+		double *x = new double[surfaceA->GetNumberOfPoints()];
+		double *y = new double[surfaceA->GetNumberOfPoints()];
+		double *z = new double[surfaceA->GetNumberOfPoints()];
 		for (i = 0; i < surfaceA->GetNumberOfPoints(); i++) {
 			(surfaceA->GetPoints())->GetPoint(i, pt1);
-			transformation->Transform(pt1[0], pt1[1], pt1[2]);
+			x[i] = pt1[0];
+			y[i] = pt1[1];
+			z[i] = pt1[2];
+		}
+		// Transform all points at once
+		transformation->Transform(surfaceA->GetNumberOfPoints(), x, y, z);
+		for (i = 0; i < surfaceA->GetNumberOfPoints(); i++) {
+			pt1[0] = x[i];
+			pt1[1] = y[i];
+			pt1[2] = z[i];
 			surfaceA->GetPoints()->SetPoint(i, pt1);
 		}
+		delete []x;
+		delete []y;
+		delete []z;
 		surfaceA->Modified();
 	}
 
@@ -31,6 +31,7 @@ void usage()
   cerr << "<-total image>             Store the total displacement in image" << endl;
   cerr << "<-scale factor>            Scale displacement by a factor" << endl;
   cerr << "<-padding value>           Ignore padded region" << endl;
+  cerr << "<-cache>                   Cache displacement of multi-level FFD for all frames" << endl;
   cerr << "<-Rx1 value>               Region of interest in image" << endl;
   cerr << "<-Ry1 value>               Region of interest in image" << endl;
   cerr << "<-Rz1 value>               Region of interest in image" << endl;
@@ -42,7 +43,7 @@ void usage()
 
 int main(int argc, char **argv)
 {
-  int x, y, z, t, ok, invert, imaged, periodic;
+  int x, y, z, t, ok, invert, imaged, periodic, cache;
   int x1, y1, z1, t1, x2, y2, z2, t2;
   irtkGreyPixel padding;
   double p1[3], p2[3], scale;
@@ -90,6 +91,7 @@ int main(int argc, char **argv)
   invert  = false;
   imaged   = false;
   periodic = false;
+  cache    = false;
 
   // Parse arguments
   while (argc > 1) {
@@ -102,6 +104,12 @@ int main(int argc, char **argv)
       argv++;
       ok = true;
     }
+    if ((ok == false) && (strcmp(argv[1], "-cache") == 0)) {
+      argc--;
+      argv++;
+      cache = true;
+      ok = true;
+    }
     if ((ok == false) && (strcmp(argv[1], "-total") == 0)) {
       argc--;
       argv++;
@@ -219,6 +227,14 @@ int main(int argc, char **argv)
   irtkRealImage dy(image);
   irtkRealImage dz(image);
 
+  // Rasterize displacement once for all frames of the image
+  if ((cache == true) && (invert == false)) {
+    irtkMultiLevelFreeFormTransformation *mffd = dynamic_cast<irtkMultiLevelFreeFormTransformation *>(transform);
+    if (mffd != NULL) {
+      mffd->CacheDisplacement(image.GetImageAttributes(), periodic ? 0 : image.ImageToTime(0));
+    }
+  }
+
   // Initialize point structure with transformed point positions
   for (t = 0; t < image.GetT(); t++) {
     double time = image.ImageToTime(t);
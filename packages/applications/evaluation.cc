@@ -59,8 +59,8 @@ int main(int argc, char **argv)
   irtkTransformation *transformation = NULL;
   irtkInterpolateImageFunction *interpolator = NULL;
   irtkRealPixel target_min, source_min, target_max, source_max;
-  int ok, i, x, y, z, i1, j1, k1, i2, j2, k2, verbose;
-  double x1, y1, z1, x2, y2, z2, Tp, widthx, widthy, val;
+  int ok, i, n, x, y, z, i1, j1, k1, i2, j2, k2, verbose;
+  double x1, y1, z1, x2, y2, z2, Tp, widthx, widthy, val, *px, *py, *pz;
 
   // Check command line
   if (argc < 3) {
@@ -342,9 +342,28 @@ int main(int argc, char **argv)
 
   double sum = 0;
 
+  px = new double[target.GetX()];
+  py = new double[target.GetX()];
+  pz = new double[target.GetX()];
+
   // Fill histogram
   for (z = 0; z < target.GetZ(); z++) {
     for (y = 0; y < target.GetY(); y++) {
+
+      // Transform all voxels of the row inside the mask at once
+      n = 0;
+      for (x = 0; x < target.GetX(); x++) {
+        if (mask(x, y, z) > 0) {
+          px[n] = x;
+          py[n] = y;
+          pz[n] = z;
+          target.ImageToWorld(px[n], py[n], pz[n]);
+          n++;
+        }
+      }
+      transformation->Transform(n, px, py, pz);
+
+      n = 0;
       for (x = 0; x < target.GetX(); x++) {
 
         if (mask(x, y, z) > 0) {
@@ -355,11 +374,8 @@ int main(int argc, char **argv)
           if (val < target_min)
             target_min = val;
 
-          irtkPoint p(x, y, z);
-          // Transform point into world coordinates
-          target.ImageToWorld(p);
-          // Transform point
-          transformation->Transform(p);
+          irtkPoint p(px[n], py[n], pz[n]);
+          n++;
           // Transform point into image coordinates
           source.WorldToImage(p);
 
@@ -404,6 +420,10 @@ int main(int argc, char **argv)
     }
   }
 
+  delete []px;
+  delete []py;
+  delete []pz;
+
   sum = sum/target.GetNumberOfVoxels();
 
   sum = 20*log10(target_max) - 10*log10(sum);
@@ -154,31 +154,60 @@ int main(int argc, char **argv)
 
   vtkUnstructuredGrid* surface = reader->GetOutput();
   vtkPoints*   points  = surface->GetPoints();
+  double p[3], *x, *y, *z;
+  int i, n;
 
-  for (int i=0; i < points->GetNumberOfPoints(); i++) {
-    double p[3];
+  // Number of points to transform, the rest is copied
+  n = points->GetNumberOfPoints();
+  if ((pnumber > 0) && (pnumber < n)) n = pnumber;
+  x = new double[n];
+  y = new double[n];
+  z = new double[n];
+
+  for (i = 0; i < points->GetNumberOfPoints(); i++) {
     points->GetPoint(i,p);
-	if(sourceon&&targeton){
-		target.WorldToImage(p[0],p[1],p[2]);
-		//p[1] = target.GetY() - p[1];
-		source.ImageToWorld(p[0],p[1],p[2]);
-	}
-	if(i<pnumber || pnumber == 0){
-		if (invert == false) {
-			if(time >= 0){
-				//TFFD with time
-				transformation->Transform(p[0],p[1],p[2],time);
-			}else{
-				transformation->Transform(p[0],p[1],p[2]);
-			}
-		} else {
-			transformation->Inverse(p[0],p[1],p[2]);
-		}
-	}
-    points->SetPoint(i,p);
+    if(sourceon&&targeton){
+      target.WorldToImage(p[0],p[1],p[2]);
+      //p[1] = target.GetY() - p[1];
+      source.ImageToWorld(p[0],p[1],p[2]);
+    }
+    if (i < n) {
+      x[i] = p[0];
+      y[i] = p[1];
+      z[i] = p[2];
+    } else {
+      points->SetPoint(i,p);
+    }
+  }
+
+  // Transform all points at once
+  if (invert == false) {
+    if (time >= 0) {
+      //TFFD with time
+      transformation->Transform(n, x, y, z, time);
+    } else {
+      transformation->Transform(n, x, y, z);
+    }
+  } else {
+    transformation->InverseRow(n, x, y, z);
+  }
+
+  for (i = 0; i < points->GetNumberOfPoints(); i++) {
+    if (i < n) {
+      p[0] = x[i];
+      p[1] = y[i];
+      p[2] = z[i];
+      points->SetPoint(i,p);
+    } else {
+      points->GetPoint(i,p);
+    }
     irtkpointset.Add(p);
   }
 
+  delete []x;
+  delete []y;
+  delete []z;
+
   // Write the final set
   vtkUnstructuredGridWriter   *writer = vtkUnstructuredGridWriter::New();
   writer->SetFileName(output_name);
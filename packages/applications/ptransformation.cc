@@ -146,9 +146,17 @@ int main(int argc, char **argv)
 
   vtkPolyData* surface = reader->GetOutput();
   vtkPoints*   points  = surface->GetPoints();
-  double p[3];
+  double p[3], *x, *y, *z;
+  int i, n;
 
-  for (int i=0; i < points->GetNumberOfPoints(); i++) {
+  // Number of points to transform, the rest is copied
+  n = points->GetNumberOfPoints();
+  if ((noOfPointsToTransform > 0) && (noOfPointsToTransform < n)) n = noOfPointsToTransform;
+  x = new double[n];
+  y = new double[n];
+  z = new double[n];
+
+  for (i = 0; i < points->GetNumberOfPoints(); i++) {
 
     points->GetPoint(i,p);
 
@@ -157,23 +165,38 @@ int main(int argc, char **argv)
       source.ImageToWorld(p[0],p[1],p[2]);
     }
 
-    if(i < noOfPointsToTransform || noOfPointsToTransform == 0){
-
-      if (invert == false) {
-		  if(time >= 0){
-				//TFFD with time
-				transformation->Transform(p[0],p[1],p[2],time);
-			}else{
-				transformation->Transform(p[0],p[1],p[2]);
-			}
-      } else {
-        transformation->Inverse(p[0],p[1],p[2]);
-      }
+    if (i < n) {
+      x[i] = p[0];
+      y[i] = p[1];
+      z[i] = p[2];
+    } else {
+      points->SetPoint(i,p);
     }
+  }
 
+  // Transform all points at once
+  if (invert == false) {
+    if (time >= 0) {
+      //TFFD with time
+      transformation->Transform(n, x, y, z, time);
+    } else {
+      transformation->Transform(n, x, y, z);
+    }
+  } else {
+    transformation->InverseRow(n, x, y, z);
+  }
+
+  for (i = 0; i < n; i++) {
+    p[0] = x[i];
+    p[1] = y[i];
+    p[2] = z[i];
     points->SetPoint(i,p);
   }
 
+  delete []x;
+  delete []y;
+  delete []z;
+
   // Write the final set
   vtkPolyDataWriter   *writer = vtkPolyDataWriter::New();
   writer->SetFileName(output_name);
@@ -39,7 +39,7 @@ void usage()
 
 int main(int argc, char **argv)
 {
-  int i, ok;
+  int i, n, ok;
   irtkTransformation *transformation = NULL;
 
   // Check command line
@@ -86,21 +86,30 @@ int main(int argc, char **argv)
     transformation = new irtkRigidTransformation;
   }
 
-  if (surface->GetPoints()->GetData()->GetNumberOfComponents() == 3) {
-    double coord[3];
-    for (i = 0; i < surface->GetNumberOfPoints(); i++) {
+  if ((surface->GetPoints()->GetData()->GetNumberOfComponents() == 3) ||
+      (surface->GetPoints()->GetData()->GetNumberOfComponents() == 4)) {
+    double coord[4], *x, *y, *z;
+    n = surface->GetNumberOfPoints();
+    x = new double[n];
+    y = new double[n];
+    z = new double[n];
+    for (i = 0; i < n; i++) {
       (surface->GetPoints())->GetPoint(i, coord);
-      transformation->Transform(coord[0], coord[1], coord[2]);
-      surface->GetPoints()->SetPoint(i, coord);
+      x[i] = coord[0];
+      y[i] = coord[1];
+      z[i] = coord[2];
     }
-    surface->Modified();
-  } else if (surface->GetPoints()->GetData()->GetNumberOfComponents() == 4) {
-    double coord[4];
-    for (i = 0; i < surface->GetNumberOfPoints(); i++) {
-      (surface->GetPoints())->GetPoint(i, coord);
-      transformation->Transform(coord[0], coord[1], coord[2]);
+    // Transform all points at once
+    transformation->Transform(n, x, y, z);
+    for (i = 0; i < n; i++) {
+      coord[0] = x[i];
+      coord[1] = y[i];
+      coord[2] = z[i];
       surface->GetPoints()->SetPoint(i, coord);
     }
+    delete []x;
+    delete []y;
+    delete []z;
     surface->Modified();
   }
 
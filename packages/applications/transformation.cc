@@ -54,6 +54,7 @@ void usage()
     cerr << "<-Tp value>        Target padding value" << endl;
     cerr << "<-Sp value>        Source padding value" << endl;
     cerr << "<-invert>          Invert transformation" << endl;
+    cerr << "<-cache>           Cache displacement of multi-level FFD on target lattice" << endl;
     cerr << "<-nn>              Nearst Neighbor interpolation" << endl;
     cerr << "<-linear>          Linear interpolation" << endl;
     cerr << "<-bspline>         B-spline interpolation" << endl;
@@ -72,7 +73,7 @@ void usage()
 
 int main(int argc, char **argv)
 {
-    int ok, invert, twod;
+    int ok, invert, twod, cache;
     int target_padding, source_padding;
     int target_x1, target_y1, target_z1, target_x2, target_y2, target_z2;
     int source_x1, source_y1, source_z1, source_x2, source_y2, source_z2;
@@ -121,6 +122,7 @@ int main(int argc, char **argv)
 
     // Other options
     invert = false;
+    cache = false;
     twod = false;
     source_padding = 0;
     target_padding = MIN_GREY;
@@ -318,6 +320,12 @@ int main(int argc, char **argv)
             invert = true;
             ok = true;
         }
+        if ((ok == false) && (strcmp(argv[1], "-cache") == 0)) {
+            argc--;
+            argv++;
+            cache = true;
+            ok = true;
+        }
         if ((ok == false) && (strcmp(argv[1], "-2d") == 0)) {
             argc--;
             argv++;
@@ -439,6 +447,15 @@ int main(int argc, char **argv)
         transformation = new irtkRigidTransformation;
     }
 
+    // Rasterize displacement once for all frames of the target image
+    if (cache == true) {
+        irtkMultiLevelFreeFormTransformation *mffd = dynamic_cast<irtkMultiLevelFreeFormTransformation *>(transformation);
+        if (mffd != NULL) {
+            cout << "Caching displacement ... "; cout.flush();
+            mffd->CacheDisplacement(target->GetImageAttributes());
+            cout << "done" << endl;
+        }
+    }
 
     // Create image transformation
     irtkImageTransformation *imagetransformation =
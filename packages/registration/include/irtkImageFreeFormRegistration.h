@@ -28,6 +28,9 @@ class irtkMultiThreadedImageFreeFormRegistrationEvaluateGradient;
 
 #endif
 
+class irtkMultiThreadedImageFreeFormRegistrationMetricDerivative;
+class irtkMultiThreadedImageFreeFormRegistrationAnalyticGradient;
+
 /**
  * Filter for non-rigid registration based on voxel similarity measures.
  *
@@ -47,6 +50,9 @@ class irtkImageFreeFormRegistration : public irtkImageRegistration
 
 #endif
 
+  friend class irtkMultiThreadedImageFreeFormRegistrationMetricDerivative;
+  friend class irtkMultiThreadedImageFreeFormRegistrationAnalyticGradient;
+
   /// Friend declaration of NR optimization routines
   friend float irtkFreeFormRegistration_Ptr2NRfunc (float *x);
 
@@ -108,6 +114,14 @@ protected:
   /// Multilevel mode
   bool _MFFDMode;
 
+  /// Use analytic gradient instead of finite differences
+  bool _AnalyticGradient;
+
+  /** Derivative of the similarity metric with respect to the source
+      intensity of a single sample for each (target, source) bin pair. This
+      table is only used for histogram based similarity metrics. */
+  double *_metricDerivativeTable;
+
   /// Initial set up for the registration
   virtual void Initialize();
 
@@ -165,6 +179,24 @@ protected:
    */
   virtual double EvaluateGradient(float, float *);
 
+  /** Evaluates the derivative of a similarity metric with respect to the
+   *  source intensity of a single sample. The derivative is approximated by
+   *  moving the sample by one intensity level (or histogram bin) in either
+   *  direction. The metric is restored before the function returns.
+   */
+  virtual double EvaluateMetricDerivative(irtkSimilarityMetric *, int, int, int);
+
+  /** Evaluates the gradient of the similarity metric analytically. The
+   *  derivative of the metric with respect to the transformed source
+   *  intensities is multiplied by the source image gradient at each voxel
+   *  and projected onto the control points through the B-spline basis. All
+   *  partial derivatives are thus obtained in a single pass over the target.
+   *  The derivatives are scaled by twice the step size so that they match
+   *  the central differences of EvaluateDerivative. Penalty terms are still
+   *  differentiated numerically.
+   */
+  virtual void EvaluateGradientAnalytic(float, float *);
+
   /// Update lookup table
   virtual void UpdateLUT();
 
@@ -207,6 +239,9 @@ public:
 
   virtual SetMacro(MFFDMode, bool);
   virtual GetMacro(MFFDMode, bool);
+
+  virtual SetMacro(AnalyticGradient, bool);
+  virtual GetMacro(AnalyticGradient, bool);
 };
 
 inline void irtkImageFreeFormRegistration::SetOutput(irtkTransformation *transformation)
@@ -29,11 +29,12 @@ typedef enum { DownhillDescent,
                GradientDescentConstrained,
                SteepestGradientDescent,
                ConjugateGradientDescent,
-               ClosedForm
+               ClosedForm,
+               LimitedMemoryBFGS
              } irtkOptimizationMethod;
 
 // Definition of available similarity measures
-typedef enum { JE, CC, MI, NMI, SSD, CR_XY, CR_YX, LC, K, ML, NGD, NGP, NGS }
+typedef enum { JE, CC, MI, NMI, SSD, CR_XY, CR_YX, LC, K, ML, NGD, NGP, NGS, LNCC }
 irtkSimilarityMeasure;
 
 #include <irtkImage.h>
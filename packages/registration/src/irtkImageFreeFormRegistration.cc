@@ -24,6 +24,222 @@ extern irtkGreyImage *tmp_target, *tmp_source;
 
 #include <irtkMultiThreadedImageFreeFormRegistration.h>
 
+class irtkMultiThreadedImageFreeFormRegistrationMetricDerivative
+{
+
+  /// Pointer to image registration class
+  irtkImageFreeFormRegistration *_filter;
+
+public:
+
+  irtkMultiThreadedImageFreeFormRegistrationMetricDerivative(irtkImageFreeFormRegistration *filter) {
+    _filter = filter;
+  }
+
+  void operator()(const blocked_range<int> &r) const {
+    int i, j, ny;
+    irtkHistogramSimilarityMetric *metric;
+
+    // Each thread perturbs its own copy of the metric
+    metric = dynamic_cast<irtkHistogramSimilarityMetric *>(irtkSimilarityMetric::New(_filter->_metric));
+    metric->ResetAndCopy(_filter->_metric);
+
+    ny = metric->NumberOfBinsY();
+    for (i = r.begin(); i != r.end(); i++) {
+      for (j = 0; j < ny; j++) {
+        // Only bins which contain samples are needed
+        if (metric->GetPointerToHistogram()->irtkHistogram_2D<double>::operator()(i, j) > 0) {
+          _filter->_metricDerivativeTable[i * ny + j] = _filter->EvaluateMetricDerivative(metric, i, j, ny - 1);
+        } else {
+          _filter->_metricDerivativeTable[i * ny + j] = 0;
+        }
+      }
+    }
+    delete metric;
+  }
+};
+
+class irtkMultiThreadedImageFreeFormRegistrationAnalyticGradient
+{
+
+  /// Pointer to image registration class
+  irtkImageFreeFormRegistration *_filter;
+
+  /// Copy of similarity metric (only if the derivatives are not tabulated)
+  irtkSimilarityMetric *_metric;
+
+  /// Number of control points
+  int _n;
+
+  /// Mapping from world to source image coordinates
+  double _w2i[3][3];
+
+public:
+
+  /// Gradient of similarity metric with respect to the DOFs
+  double *_gradient;
+
+  irtkMultiThreadedImageFreeFormRegistrationAnalyticGradient(irtkImageFreeFormRegistration *filter) {
+    int i, j;
+
+    _filter = filter;
+    _n      = _filter->_affd->GetX() * _filter->_affd->GetY() * _filter->_affd->GetZ();
+
+    irtkMatrix m = _filter->_source->GetWorldToImageMatrix();
+    for (i = 0; i < 3; i++) {
+      for (j = 0; j < 3; j++) {
+        _w2i[i][j] = m(i, j);
+      }
+    }
+    this->Initialize();
+  }
+
+  irtkMultiThreadedImageFreeFormRegistrationAnalyticGradient(irtkMultiThreadedImageFreeFormRegistrationAnalyticGradient &r, split) {
+    int i, j;
+
+    _filter = r._filter;
+    _n      = r._n;
+    for (i = 0; i < 3; i++) {
+      for (j = 0; j < 3; j++) {
+        _w2i[i][j] = r._w2i[i][j];
+      }
+    }
+    this->Initialize();
+  }
+
+  ~irtkMultiThreadedImageFreeFormRegistrationAnalyticGradient() {
+    delete []_gradient;
+    delete _metric;
+  }
+
+  void Initialize() {
+    int i;
+
+    _gradient = new double[3*_n];
+    for (i = 0; i < 3*_n; i++) {
+      _gradient[i] = 0;
+    }
+
+    // Each thread perturbs its own copy of the metric
+    if (_filter->_metricDerivativeTable == NULL) {
+      _metric = irtkSimilarityMetric::New(_filter->_metric);
+      _metric->ResetAndCopy(_filter->_metric);
+    } else {
+      _metric = NULL;
+    }
+  }
+
+  void join(irtkMultiThreadedImageFreeFormRegistrationAnalyticGradient &rhs) {
+    int i;
+
+    for (i = 0; i < 3*_n; i++) {
+      _gradient[i] += rhs._gradient[i];
+    }
+  }
+
+  void operator()(const blocked_range<int> &r) {
+    int i, j, k, t, a, b, c, l, m, n, ii, jj, kk, ny, index, _2D;
+    double x, y, z, x1, x2, derivative, g[3], dg[3], wx[4], wy[4], wz[4], w;
+    irtkGreyPixel *ptr2target, *ptr2tmp;
+    float *ptr;
+
+    irtkImageFreeFormRegistration *filter = _filter;
+    irtkBSplineFreeFormTransformation *affd = filter->_affd;
+    irtkInterpolateImageFunction *interpolator = filter->_interpolator;
+
+    _2D = (affd->GetZ() == 1);
+    if (filter->_metricDerivativeTable != NULL) {
+      ny = dynamic_cast<irtkHistogramSimilarityMetric *>(filter->_metric)->NumberOfBinsY();
+    } else {
+      ny = 0;
+    }
+
+    // Loop over all voxels in the target (reference) volume
+    for (t = 0; t < filter->_target->GetT(); t++) {
+      for (k = r.begin(); k != r.end(); k++) {
+        ptr2target = filter->_target->GetPointerToVoxels(0, 0, k, t);
+        ptr2tmp    = _tmpImage->GetPointerToVoxels(0, 0, k, t);
+        ptr        = &(filter->_affdLookupTable[3*k*filter->_target->GetX()*filter->_target->GetY()]);
+        for (j = 0; j < filter->_target->GetY(); j++) {
+          for (i = 0; i < filter->_target->GetX(); i++, ptr2target++, ptr2tmp++, ptr += 3) {
+
+            // Check whether reference point is valid and has been sampled
+            if ((*ptr2target < 0) || (*ptr2tmp == -1)) continue;
+
+            // Derivative of metric with respect to the transformed source intensity
+            if (ny > 0) {
+              derivative = filter->_metricDerivativeTable[*ptr2target * ny + *ptr2tmp];
+            } else {
+              derivative = filter->EvaluateMetricDerivative(_metric, *ptr2target, *ptr2tmp, MAX_GREY);
+            }
+            if (derivative == 0) continue;
+
+            // Gradient of source image at transformed point (in voxels)
+            x = ptr[0];
+            y = ptr[1];
+            z = ptr[2];
+            filter->_source->WorldToImage(x, y, z);
+            x1 = (x - 0.5 > filter->_source_x1) ? x - 0.5 : x;
+            x2 = (x + 0.5 < filter->_source_x2) ? x + 0.5 : x;
+            g[0] = (x2 > x1) ? (interpolator->EvaluateInside(x2, y, z, t) - interpolator->EvaluateInside(x1, y, z, t)) / (x2 - x1) : 0;
+            x1 = (y - 0.5 > filter->_source_y1) ? y - 0.5 : y;
+            x2 = (y + 0.5 < filter->_source_y2) ? y + 0.5 : y;
+            g[1] = (x2 > x1) ? (interpolator->EvaluateInside(x, x2, z, t) - interpolator->EvaluateInside(x, x1, z, t)) / (x2 - x1) : 0;
+            x1 = (z - 0.5 > filter->_source_z1) ? z - 0.5 : z;
+            x2 = (z + 0.5 < filter->_source_z2) ? z + 0.5 : z;
+            g[2] = (x2 > x1) ? (interpolator->EvaluateInside(x, y, x2, t) - interpolator->EvaluateInside(x, y, x1, t)) / (x2 - x1) : 0;
+
+            // Chain rule: derivative of metric with respect to displacement (in mm)
+            for (a = 0; a < 3; a++) {
+              dg[a] = derivative * (g[0] * _w2i[0][a] + g[1] * _w2i[1][a] + g[2] * _w2i[2][a]);
+            }
+
+            // B-spline weights of the control points in the support of the voxel
+            x = i;
+            y = j;
+            z = k;
+            filter->_target->ImageToWorld(x, y, z);
+            affd->WorldToLattice(x, y, z);
+            l = (int)floor(x);
+            m = (int)floor(y);
+            n = (int)floor(z);
+            for (a = 0; a < 4; a++) {
+              wx[a] = affd->B(a, x - l);
+              wy[a] = affd->B(a, y - m);
+              wz[a] = affd->B(a, z - n);
+            }
+
+            // Project derivative onto control points
+            for (c = 0; c < 4; c++) {
+              if (_2D) {
+                if (c > 0) break;
+                kk = 0;
+                wz[0] = 1;
+              } else {
+                kk = n - 1 + c;
+                if ((kk < 0) || (kk >= affd->GetZ())) continue;
+              }
+              for (b = 0; b < 4; b++) {
+                jj = m - 1 + b;
+                if ((jj < 0) || (jj >= affd->GetY())) continue;
+                for (a = 0; a < 4; a++) {
+                  ii = l - 1 + a;
+                  if ((ii < 0) || (ii >= affd->GetX())) continue;
+                  w     = wx[a] * wy[b] * wz[c];
+                  index = affd->LatticeToIndex(ii, jj, kk);
+                  _gradient[index]        += w * dg[0];
+                  _gradient[index + _n]   += w * dg[1];
+                  _gradient[index + 2*_n] += w * dg[2];
+                }
+              }
+            }
+          }
+        }
+      }
+    }
+  }
+};
+
 irtkImageFreeFormRegistration::irtkImageFreeFormRegistration()
 {
   // Print debugging information
@@ -45,6 +261,10 @@ irtkImageFreeFormRegistration::irtkImageFreeFormRegistration()
   _Subdivision = true;
   _Mode        = RegisterXYZ;
   _MFFDMode    = true;
+
+  // Default gradient computation
+  _AnalyticGradient      = false;
+  _metricDerivativeTable = NULL;
 }
 
 void irtkImageFreeFormRegistration::GuessParameter()
@@ -190,6 +410,14 @@ void irtkImageFreeFormRegistration::Initialize(int level)
   _tmpMetricA = irtkSimilarityMetric::New(_metric);
   _tmpMetricB = irtkSimilarityMetric::New(_metric);
 
+  // Allocate memory for metric derivatives of histogram based metrics
+  irtkHistogramSimilarityMetric *histogram = dynamic_cast<irtkHistogramSimilarityMetric *>(_metric);
+  if ((_AnalyticGradient == true) && (histogram != NULL)) {
+    _metricDerivativeTable = new double[histogram->NumberOfBinsX() * histogram->NumberOfBinsY()];
+  } else {
+    _metricDerivativeTable = NULL;
+  }
+
   _tmpImage = new irtkGreyImage(_target->GetX(),
                                 _target->GetY(),
                                 _target->GetZ(),
@@ -308,6 +536,8 @@ void irtkImageFreeFormRegistration::Finalize(int level)
   delete _tmpMetricB;
   delete []_affdLookupTable;
   delete []_mffdLookupTable;
+  delete []_metricDerivativeTable;
+  _metricDerivativeTable = NULL;
 }
 
 void irtkImageFreeFormRegistration::UpdateLUT()
@@ -759,6 +989,98 @@ double irtkImageFreeFormRegistration::EvaluateDerivative(int index, double step)
   return similarityA - similarityB;
 }
 
+double irtkImageFreeFormRegistration::EvaluateMetricDerivative(irtkSimilarityMetric *metric, int target, int source, int max)
+{
+  int source1, source2;
+  double similarity1, similarity2;
+
+  // Use one-sided differences at the boundary of the intensity range
+  source1 = (source > 0)   ? source - 1 : source;
+  source2 = (source < max) ? source + 1 : source;
+  if (source1 == source2) return 0;
+
+  // Move sample down
+  metric->Delete(target, source);
+  metric->Add(target, source1);
+  similarity1 = metric->Evaluate();
+  metric->Delete(target, source1);
+
+  // Move sample up
+  metric->Add(target, source2);
+  similarity2 = metric->Evaluate();
+  metric->Delete(target, source2);
+
+  // Restore sample
+  metric->Add(target, source);
+
+  return (similarity2 - similarity1) / (source2 - source1);
+}
+
+void irtkImageFreeFormRegistration::EvaluateGradientAnalytic(float step, float *dx)
+{
+  int i, n;
+  double dof, similarityA, similarityB;
+
+  // Print debugging information
+  this->Debug("irtkImageFreeFormRegistration::EvaluateGradientAnalytic");
+
+  // Tabulate metric derivatives for histogram based metrics
+  if (_metricDerivativeTable != NULL) {
+    irtkMultiThreadedImageFreeFormRegistrationMetricDerivative derivative(this);
+    parallel_for(blocked_range<int>(0, dynamic_cast<irtkHistogramSimilarityMetric *>(_metric)->NumberOfBinsX(), 1), derivative);
+  }
+
+  // Accumulate the metric gradient at the control points
+  irtkMultiThreadedImageFreeFormRegistrationAnalyticGradient gradient(this);
+  parallel_reduce(blocked_range<int>(0, _target->GetZ(), 1), gradient);
+
+  n = _affd->NumberOfDOFs();
+  for (i = 0; i < n; i++) {
+    if (_affd->irtkTransformation::GetStatus(i) == _Active) {
+
+      // Central difference of similarity measure
+      similarityA = step * gradient._gradient[i];
+      similarityB = -similarityA;
+
+      if ((this->_Lambda1 > 0) || (this->_Lambda2 > 0) || (this->_Lambda3 > 0)) {
+
+        // Save value of DOF for which we calculate the derivative
+        dof = _affd->Get(i);
+
+        // Add penalties
+        _affd->Put(i, dof + step);
+        if (this->_Lambda1 > 0) {
+          similarityA += this->_Lambda1*this->SmoothnessPenalty(i);
+        }
+        if (this->_Lambda2 > 0) {
+          similarityA += this->_Lambda2*this->VolumePreservationPenalty(i);
+        }
+        if (this->_Lambda3 > 0) {
+          similarityA += this->_Lambda3*this->TopologyPreservationPenalty(i);
+        }
+
+        // Add penalties
+        _affd->Put(i, dof - step);
+        if (this->_Lambda1 > 0) {
+          similarityB += this->_Lambda1*this->SmoothnessPenalty(i);
+        }
+        if (this->_Lambda2 > 0) {
+          similarityB += this->_Lambda2*this->VolumePreservationPenalty(i);
+        }
+        if (this->_Lambda3 > 0) {
+          similarityB += this->_Lambda3*this->TopologyPreservationPenalty(i);
+        }
+
+        // Restore value of DOF for which we calculate the derivative
+        _affd->Put(i, dof);
+      }
+      dx[i] = similarityA - similarityB;
+    } else {
+      dx[i] = 0;
+    }
+  }
+}
+
 double irtkImageFreeFormRegistration::EvaluateGradient(float step, float *dx)
 {
   int i;
@@ -767,17 +1089,21 @@ double irtkImageFreeFormRegistration::EvaluateGradient(float step, float *dx)
   // Update lookup table
   this->UpdateLUT();
 
+  if (_AnalyticGradient == true) {
+    this->EvaluateGradientAnalytic(step, dx);
+  } else {
 #ifdef HAS_TBB
-  parallel_for(blocked_range<int>(0, _affd->NumberOfDOFs(), 1), irtkMultiThreadedImageFreeFormRegistrationEvaluateGradient(this, dx, step));
+    parallel_for(blocked_range<int>(0, _affd->NumberOfDOFs(), 1), irtkMultiThreadedImageFreeFormRegistrationEvaluateGradient(this, dx, step));
 #else
-  for (i = 0; i < _affd->NumberOfDOFs(); i++) {
-    if (_affd->irtkTransformation::GetStatus(i) == _Active) {
-      dx[i] = this->EvaluateDerivative(i, step);
-    } else {
-      dx[i] = 0;
+    for (i = 0; i < _affd->NumberOfDOFs(); i++) {
+      if (_affd->irtkTransformation::GetStatus(i) == _Active) {
+        dx[i] = this->EvaluateDerivative(i, step);
+      } else {
+        dx[i] = 0;
+      }
     }
-  }
 #endif
+  }
 
   // Calculate norm of vector
   norm = 0;
@@ -870,6 +1196,21 @@ bool irtkImageFreeFormRegistration::Read(char *buffer1, char *buffer2, int &leve
     }
     ok = true;
   }
+  if (strstr(buffer1, "Analytic gradient") != NULL) {
+    if ((strcmp(buffer2, "False") == 0) || (strcmp(buffer2, "No") == 0)) {
+      this->_AnalyticGradient = false;
+      cout << "Analytic gradient is ... false" << endl;
+    } else {
+      if ((strcmp(buffer2, "True") == 0) || (strcmp(buffer2, "Yes") == 0)) {
+        this->_AnalyticGradient = true;
+        cout << "Analytic gradient is ... true" << endl;
+      } else {
+        cerr << "Can't read boolean value = " << buffer2 << endl;
+        exit(1);
+      }
+    }
+    ok = true;
+  }
   if (ok == false) {
     return this->irtkImageRegistration::Read(buffer1, buffer2, level);
   } else {
@@ -897,6 +1238,11 @@ void irtkImageFreeFormRegistration::Write(ostream &to)
   } else {
     to << "MFFDMode                          = False" << endl;
   }
+  if (_AnalyticGradient == true) {
+    to << "Analytic gradient                 = True" << endl;
+  } else {
+    to << "Analytic gradient                 = False" << endl;
+  }
 
   this->irtkImageRegistration::Write(to);
 }
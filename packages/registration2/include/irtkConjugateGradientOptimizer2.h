@@ -0,0 +1,63 @@
+/*=========================================================================
+
+  Library   : Image Registration Toolkit (IRTK)
+  Module    : $Id$
+  Copyright : Imperial College, Department of Computing
+              Visual Information Processing (VIP), 2009 onwards
+  Date      : $Date$
+  Version   : $Revision$
+  Changes   : $Author$
+
+Copyright (c) 1999-2014 and onwards, Imperial College London
+All rights reserved.
+See LICENSE for details
+
+=========================================================================*/
+
+#ifndef _IRTKCONJUGATEGRADIENTOPTIMIZER2_H
+
+#define _IRTKCONJUGATEGRADIENTOPTIMIZER2_H
+
+/**
+ * Polak-Ribiere conjugate gradient optimization of registration2 filters.
+ *
+ * The conjugate direction is reset to the gradient whenever the Polak-Ribiere
+ * coefficient becomes negative (PR+).
+ */
+
+class irtkConjugateGradientOptimizer2 : public irtkOptimizer2
+{
+
+protected:
+
+  /// Squared norm of gradient of previous iteration
+  double _gg;
+
+  /// Whether the previous search direction can be used
+  bool _HasDirection;
+
+  /// Compute conjugate search direction
+  virtual void ComputeDirection();
+
+  /// Discard previous search direction
+  virtual void Reset();
+
+  /// Update after accepted step
+  virtual void Update(const double *, const double *);
+
+public:
+
+  /// Constructor
+  irtkConjugateGradientOptimizer2();
+
+  /// Print name of the class
+  virtual const char *NameOfClass();
+
+};
+
+inline const char *irtkConjugateGradientOptimizer2::NameOfClass()
+{
+  return "irtkConjugateGradientOptimizer2";
+}
+
+#endif
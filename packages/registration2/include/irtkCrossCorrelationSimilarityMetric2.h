@@ -0,0 +1,68 @@
+/*=========================================================================
+
+  Library   : Image Registration Toolkit (IRTK)
+  Module    : $Id$
+  Copyright : Imperial College, Department of Computing
+              Visual Information Processing (VIP), 2009 onwards
+  Date      : $Date$
+  Version   : $Revision$
+  Changes   : $Author$
+
+Copyright (c) 1999-2014 and onwards, Imperial College London
+All rights reserved.
+See LICENSE for details
+
+=========================================================================*/
+
+#ifndef _IRTKCROSSCORRELATIONSIMILARITYMETRIC2_H
+
+#define _IRTKCROSSCORRELATIONSIMILARITYMETRIC2_H
+
+/**
+ * Class for voxel similarity measure based on global cross correlation
+ *
+ */
+
+class irtkCrossCorrelationSimilarityMetric2 : public irtkSimilarityMetric2
+{
+
+  /// Mean intensities of target and source
+  double _mean_t, _mean_s;
+
+  /// Centered sums of products of target and source
+  double _tt, _ss, _ts;
+
+  /// Compute means and centered sums, returns number of samples
+  int ComputeStatistics();
+
+public:
+
+  /// Constructor
+  irtkCrossCorrelationSimilarityMetric2();
+
+  /// Evaluate similarity measure
+  virtual double Evaluate();
+
+  /// Evaluate gradient of similarity measure
+  virtual void EvaluateGradient(irtkRealImage *, irtkRealImage *);
+
+  /// Returns the name of the class
+  virtual const char *NameOfClass();
+
+};
+
+inline irtkCrossCorrelationSimilarityMetric2::irtkCrossCorrelationSimilarityMetric2()
+{
+  _mean_t = 0;
+  _mean_s = 0;
+  _tt = 0;
+  _ss = 0;
+  _ts = 0;
+}
+
+inline const char *irtkCrossCorrelationSimilarityMetric2::NameOfClass()
+{
+  return "irtkCrossCorrelationSimilarityMetric2";
+}
+
+#endif
@@ -30,6 +30,8 @@ See LICENSE for details
 class irtkImageFreeFormRegistration2 : public irtkImageRegistration2
 {
 
+  friend class irtkMultiThreadedImageFreeFormRegistration2UpdateSource;
+
 protected:
 
   /// Pointer to the local transformation which is currently optimized
@@ -38,9 +40,6 @@ protected:
   /// Pointer to the global transformation which is constant
   irtkMultiLevelFreeFormTransformation *_mffd;
 
-  /// Pointer to lattice coordinates for every voxel
-  double *_latticeCoordLUT;
-
   /// Pointer to static displacements for every voxel
   double *_displacementLUT;
 
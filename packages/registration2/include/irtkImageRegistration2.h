@@ -18,6 +18,18 @@ See LICENSE for details
 
 #define _IRTKIMAGEREGISTRATION2_H
 
+/** Strategies for the sampling of target voxels during the optimization.
+ *  Random sampling keeps each target voxel with the sampling ratio as
+ *  probability. Stratified sampling draws one target voxel from each cell
+ *  of a regular grid, whose integer cell size gives the ratio closest to
+ *  the requested one, so the achieved ratio is only approximate. Gradient
+ *  sampling keeps voxels with a probability which increases with the
+ *  target gradient magnitude. Its samples are not weighted by the inverse
+ *  of their probability, so it changes the objective function towards the
+ *  similarity of edges rather than estimating the similarity of all voxels.
+ */
+typedef enum { SamplingAll, SamplingRandom, SamplingStratified, SamplingGradient } irtkSamplingStrategy;
+
 /**
  * Generic for image registration based on voxel similarity measures.
  *
@@ -58,6 +70,15 @@ protected:
   //Distance image for masking used/unused voxels and determine the distance to the closest one
   irtkGenericImage<irtkGreyPixel> _distanceMask;
 
+  /** Mask of all target voxels which can be used at the current level. If
+   *  voxels are sampled, _distanceMask only contains the current sample of
+   *  these voxels.
+   */
+  irtkGenericImage<irtkGreyPixel> _domainMask;
+
+  /// Probability of each target voxel to be sampled (gradient sampling only)
+  irtkGenericImage<irtkRealPixel> _samplingProbability;
+
   /** Current estimate of the source image transformed back into the target
    *  coordinate system. This is updated every time the Update function is
    *  called.
@@ -79,6 +100,9 @@ protected:
   /// 2D histogram (this is not used for all similarity metrics)
   irtkHistogram_2D<double> *_histogram;
 
+  /// Similarity metric
+  irtkSimilarityMetric2 *_metric;
+
   /// Interpolator for source image
   irtkInterpolateImageFunction *_interpolator;
 
@@ -121,12 +145,30 @@ protected:
   /// Similarity measure for registration
   irtkSimilarityMeasure  _SimilarityMeasure;
 
+  /// Local window for LNCC (in mm)
+  double _LocalWindowSize;
+
+  /// Local window type for LNCC
+  irtkLocalWindowType _LocalWindowType;
+
   /// Optimization method for registration
   irtkOptimizationMethod _OptimizationMethod;
 
   /// Interpolation mode to use during resampling and registration
   irtkInterpolationMode _InterpolationMode;
 
+  /// Strategy for the sampling of target voxels
+  irtkSamplingStrategy _SamplingStrategy;
+
+  /// Fraction of target voxels which are sampled per iteration
+  double _SamplingRatio[MAX_NO_RESOLUTIONS];
+
+  /// State of the random number generator used for sampling
+  unsigned int _SamplingSeed;
+
+  /// Size of the cells of stratified sampling along each axis
+  int _SamplingCellSize;
+
   /// Convergence parameter for optimization based on change in similarity.
   double _Epsilon;
 
@@ -144,6 +186,12 @@ protected:
   /// Current iteration during the optimization
   int _CurrentIteration;
 
+  /// Number of updates of the transformed source image at the current level
+  int _NumberOfUpdates;
+
+  /// Number of updates of the transformed source image and its gradient at the current level
+  int _NumberOfGradientUpdates;
+
   /// Source image domain which can be interpolated fast
   double _source_x1, _source_y1, _source_z1;
   double _source_x2, _source_y2, _source_z2;
@@ -160,6 +208,16 @@ protected:
   /// Final set up for the registration at a multiresolution level
   virtual void Finalize(int);
 
+  /// Initial set up for the sampling of target voxels at a multiresolution level
+  virtual void InitializeSampling(int);
+
+  /** Draws a new sample of target voxels at the current level. The sample
+   *  replaces the distance mask, so that voxels which are not sampled are
+   *  skipped when the source image is transformed and when the similarity
+   *  and its gradient are evaluated.
+   */
+  virtual void Sample();
+
   /// Update state of the registration based on current transformation estimate
   virtual void Update(bool);
 
@@ -169,17 +227,14 @@ protected:
   /// Update state of the registration based on current transformation estimate (source image and source image gradient)
   virtual void UpdateSourceAndGradient() = 0;
 
-  /// Evaluate similarity measure: SSD
-  virtual double EvaluateSSD();
-
-  /// Evaluate gradient of similarity measure: SSD
-  virtual void EvaluateGradientSSD();
+  /// Returns whether the transformation is optimized by an irtkOptimizer2
+  virtual bool UseOptimizer();
 
-  /// Evaluate similarity measure: NMI
-  virtual double EvaluateNMI();
+  /// Optimize parameters of given transformation at the current level by an irtkOptimizer2
+  virtual void RunOptimizer(irtkTransformation *);
 
-  /// Evaluate gradient of similarity measure: NMI
-  virtual void EvaluateGradientNMI();
+  /// Prints number of updates at the current level
+  virtual void PrintNumberOfUpdates();
 
 public:
 
@@ -216,6 +271,13 @@ public:
    */
   virtual double EvaluateGradient(double *);
 
+  /** Updates the registration for the current transformation parameters and
+   *  evaluates the similarity metric and its gradient with respect to the
+   *  transformation parameters. This function returns the value of the
+   *  similarity measure.
+   */
+  virtual double EvaluateWithGradient(double *);
+
   /// Returns the name of the class
   virtual const char *NameOfClass() = 0;
 
@@ -247,6 +309,8 @@ public:
   virtual GetMacro(TargetPadding, int);
   virtual SetMacro(OptimizationMethod, irtkOptimizationMethod);
   virtual GetMacro(OptimizationMethod, irtkOptimizationMethod);
+  virtual SetMacro(SamplingStrategy, irtkSamplingStrategy);
+  virtual GetMacro(SamplingStrategy, irtkSamplingStrategy);
 
 };
 
@@ -261,6 +325,11 @@ inline void irtkImageRegistration2::Debug(string message)
   if (_DebugFlag == true) cout << message << endl;
 }
 
+inline bool irtkImageRegistration2::UseOptimizer()
+{
+  return ((_OptimizationMethod == ConjugateGradientDescent) || (_OptimizationMethod == LimitedMemoryBFGS));
+}
+
 #include <irtkImageRigidRegistration2.h>
 #include <irtkImageAffineRegistration2.h>
 #include <irtkImageFreeFormRegistration2.h>
@@ -0,0 +1,90 @@
+/*=========================================================================
+
+  Library   : Image Registration Toolkit (IRTK)
+  Module    : $Id$
+  Copyright : Imperial College, Department of Computing
+              Visual Information Processing (VIP), 2009 onwards
+  Date      : $Date$
+  Version   : $Revision$
+  Changes   : $Author$
+
+Copyright (c) 1999-2014 and onwards, Imperial College London
+All rights reserved.
+See LICENSE for details
+
+=========================================================================*/
+
+#ifndef _IRTKJOINTHISTOGRAMNMI_H
+
+#define _IRTKJOINTHISTOGRAMNMI_H
+
+/**
+ * Multi-threaded evaluation of (normalized) mutual information.
+ *
+ * The joint histogram is filled with parallel_reduce: each thread bins its
+ * share of the voxels into a private histogram and the partial histograms
+ * are summed when the threads are joined. Since the bins hold integer counts
+ * the result does not depend on the number of threads. The gradient pass
+ * computes the log joint and marginal histograms once and then evaluates
+ * the Parzen window derivative of the NMI for all voxels in parallel.
+ *
+ * Only voxels for which the mask is zero and the source intensity is above
+ * the padding value contribute. The mask is optional.
+ */
+
+class irtkJointHistogramNMI : public irtkObject
+{
+
+  /// Joint histogram (not owned)
+  irtkHistogram_2D<double> *_histogram;
+
+  /// Target image
+  irtkRealImage *_target;
+
+  /// Transformed source image
+  irtkRealImage *_source;
+
+  /// Mask of voxels to be ignored where non-zero (optional)
+  irtkGreyImage *_mask;
+
+  /// Padding value of source image
+  double _padding;
+
+  /// Intensity range of target image
+  double _target_min, _target_max;
+
+  /// Intensity range of source image
+  double _source_min, _source_max;
+
+  /// Evaluate gradient of NMI (true) or MI (false)
+  void EvaluateGradient(irtkRealImage *, irtkRealImage *, bool);
+
+public:
+
+  /// Constructor
+  irtkJointHistogramNMI(irtkHistogram_2D<double> *, irtkRealImage *, irtkRealImage *, irtkGreyImage *, double,
+                        double, double, double, double);
+
+  /// Fill and smooth joint histogram and return the NMI
+  double Evaluate();
+
+  /** Evaluate NMI gradient from the histogram computed by the last call of
+   *  Evaluate() and the gradient of the transformed source image. The
+   *  gradient images have three components in t.
+   */
+  void EvaluateGradient(irtkRealImage *, irtkRealImage *);
+
+  /// Evaluate MI gradient from the histogram computed by the last call of Evaluate()
+  void EvaluateGradientMI(irtkRealImage *, irtkRealImage *);
+
+  /// Returns the name of the class
+  virtual const char *NameOfClass();
+
+};
+
+inline const char *irtkJointHistogramNMI::NameOfClass()
+{
+  return "irtkJointHistogramNMI";
+}
+
+#endif
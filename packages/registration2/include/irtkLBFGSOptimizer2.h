@@ -0,0 +1,92 @@
+/*=========================================================================
+
+  Library   : Image Registration Toolkit (IRTK)
+  Module    : $Id$
+  Copyright : Imperial College, Department of Computing
+              Visual Information Processing (VIP), 2009 onwards
+  Date      : $Date$
+  Version   : $Revision$
+  Changes   : $Author$
+
+Copyright (c) 1999-2014 and onwards, Imperial College London
+All rights reserved.
+See LICENSE for details
+
+=========================================================================*/
+
+#ifndef _IRTKLBFGSOPTIMIZER2_H
+
+#define _IRTKLBFGSOPTIMIZER2_H
+
+/// Default number of steps kept by the L-BFGS optimizer
+#define LBFGS_MEMORY 5
+
+/**
+ * Limited memory BFGS optimization of registration2 filters.
+ *
+ * The search direction is the gradient multiplied by an approximation of
+ * the inverse Hessian, which is computed by the two-loop recursion from the
+ * changes of parameters and gradients of the last few steps.
+ */
+
+class irtkLBFGSOptimizer2 : public irtkOptimizer2
+{
+
+protected:
+
+  /// Max. number of steps kept
+  int _Memory;
+
+  /// Number of steps kept
+  int _NumberOfSteps;
+
+  /// Index of most recent step
+  int _Last;
+
+  /// Changes of parameters and of negated gradient of the kept steps
+  double **_S, **_Y;
+
+  /// Inverse curvature of the kept steps
+  double *_rho;
+
+  /// Coefficients of two-loop recursion
+  double *_alpha;
+
+  /// Initial set up for the optimization
+  virtual void Initialize();
+
+  /// Final set up for the optimization
+  virtual void Finalize();
+
+  /// Compute quasi-Newton search direction
+  virtual void ComputeDirection();
+
+  /// Initial step length of line search
+  virtual double InitialStep(double);
+
+  /// Discard kept steps
+  virtual void Reset();
+
+  /// Keep accepted step
+  virtual void Update(const double *, const double *);
+
+public:
+
+  /// Constructor
+  irtkLBFGSOptimizer2();
+
+  /// Print name of the class
+  virtual const char *NameOfClass();
+
+  virtual SetMacro(Memory, int);
+
+  virtual GetMacro(Memory, int);
+
+};
+
+inline const char *irtkLBFGSOptimizer2::NameOfClass()
+{
+  return "irtkLBFGSOptimizer2";
+}
+
+#endif
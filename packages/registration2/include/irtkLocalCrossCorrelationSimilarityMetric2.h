@@ -0,0 +1,93 @@
+/*=========================================================================
+
+  Library   : Image Registration Toolkit (IRTK)
+  Module    : $Id$
+  Copyright : Imperial College, Department of Computing
+              Visual Information Processing (VIP), 2009 onwards
+  Date      : $Date$
+  Version   : $Revision$
+  Changes   : $Author$
+
+Copyright (c) 1999-2014 and onwards, Imperial College London
+All rights reserved.
+See LICENSE for details
+
+=========================================================================*/
+
+#ifndef _IRTKLOCALCROSSCORRELATIONSIMILARITYMETRIC2_H
+
+#define _IRTKLOCALCROSSCORRELATIONSIMILARITYMETRIC2_H
+
+/// Definition of available local windows
+typedef enum { LocalWindowGaussian, LocalWindowBox } irtkLocalWindowType;
+
+/**
+ * Class for voxel similarity measure based on local normalized cross
+ * correlation (LNCC).
+ *
+ * Local means and (co-)variances are computed by convolving the masked
+ * images with a separable Gaussian or box window. For the Gaussian window
+ * the window size is its standard deviation, for the box window its half
+ * width (both in mm). The metric is the mean of the local correlation
+ * coefficients over all foreground voxels. Its derivative with respect to
+ * the source intensities is obtained with four further convolutions of the
+ * same window, so the cost of the gradient is independent of the number
+ * of transformation parameters.
+ */
+
+class irtkLocalCrossCorrelationSimilarityMetric2 : public irtkSimilarityMetric2
+{
+
+  /// Window type
+  irtkLocalWindowType _WindowType;
+
+  /// Window size (in mm)
+  double _WindowSize;
+
+  /// Local window weights (sum of weighted foreground voxels)
+  irtkRealImage _w;
+
+  /// Local means of target and source
+  irtkRealImage _mt, _ms;
+
+  /// Local variances of target and source, local covariance
+  irtkRealImage _vt, _vs, _vts;
+
+  /// Number of foreground voxels
+  int _n;
+
+  /// Convolve image with local window
+  void Convolve(irtkRealImage &);
+
+  /// Compute local statistics and local correlation coefficients
+  double ComputeStatistics(irtkRealImage &);
+
+public:
+
+  /// Constructor
+  irtkLocalCrossCorrelationSimilarityMetric2(double = 5, irtkLocalWindowType = LocalWindowGaussian);
+
+  /// Evaluate similarity measure
+  virtual double Evaluate();
+
+  /// Evaluate gradient of similarity measure
+  virtual void EvaluateGradient(irtkRealImage *, irtkRealImage *);
+
+  /// Returns the name of the class
+  virtual const char *NameOfClass();
+
+};
+
+inline irtkLocalCrossCorrelationSimilarityMetric2::irtkLocalCrossCorrelationSimilarityMetric2(double size, irtkLocalWindowType type)
+{
+  _WindowSize = size;
+  _WindowType = type;
+  _n = 0;
+}
+
+inline const char *irtkLocalCrossCorrelationSimilarityMetric2::NameOfClass()
+{
+  return "irtkLocalCrossCorrelationSimilarityMetric2";
+}
+
+#endif
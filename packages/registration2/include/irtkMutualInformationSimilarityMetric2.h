@@ -0,0 +1,74 @@
+/*=========================================================================
+
+  Library   : Image Registration Toolkit (IRTK)
+  Module    : $Id$
+  Copyright : Imperial College, Department of Computing
+              Visual Information Processing (VIP), 2009 onwards
+  Date      : $Date$
+  Version   : $Revision$
+  Changes   : $Author$
+
+Copyright (c) 1999-2014 and onwards, Imperial College London
+All rights reserved.
+See LICENSE for details
+
+=========================================================================*/
+
+#ifndef _IRTKMUTUALINFORMATIONSIMILARITYMETRIC2_H
+
+#define _IRTKMUTUALINFORMATIONSIMILARITYMETRIC2_H
+
+/**
+ * Class for voxel similarity measure based on mutual information
+ *
+ * The joint histogram is provided by the caller and binned over the given
+ * target and source intensity ranges. The gradient uses the joint histogram
+ * computed by the last call of Evaluate().
+ */
+
+class irtkMutualInformationSimilarityMetric2 : public irtkSimilarityMetric2
+{
+
+protected:
+
+  /// Joint histogram (not owned)
+  irtkHistogram_2D<double> *_histogram;
+
+  /// Intensity range of target image
+  double _target_min, _target_max;
+
+  /// Intensity range of source image
+  double _source_min, _source_max;
+
+public:
+
+  /// Constructor
+  irtkMutualInformationSimilarityMetric2(irtkHistogram_2D<double> *, double, double, double, double);
+
+  /// Evaluate similarity measure
+  virtual double Evaluate();
+
+  /// Evaluate gradient of similarity measure
+  virtual void EvaluateGradient(irtkRealImage *, irtkRealImage *);
+
+  /// Returns the name of the class
+  virtual const char *NameOfClass();
+
+};
+
+inline irtkMutualInformationSimilarityMetric2::irtkMutualInformationSimilarityMetric2(irtkHistogram_2D<double> *histogram,
+    double target_min, double target_max, double source_min, double source_max)
+{
+  _histogram  = histogram;
+  _target_min = target_min;
+  _target_max = target_max;
+  _source_min = source_min;
+  _source_max = source_max;
+}
+
+inline const char *irtkMutualInformationSimilarityMetric2::NameOfClass()
+{
+  return "irtkMutualInformationSimilarityMetric2";
+}
+
+#endif
@@ -0,0 +1,56 @@
+/*=========================================================================
+
+  Library   : Image Registration Toolkit (IRTK)
+  Module    : $Id$
+  Copyright : Imperial College, Department of Computing
+              Visual Information Processing (VIP), 2009 onwards
+  Date      : $Date$
+  Version   : $Revision$
+  Changes   : $Author$
+
+Copyright (c) 1999-2014 and onwards, Imperial College London
+All rights reserved.
+See LICENSE for details
+
+=========================================================================*/
+
+#ifndef _IRTKNORMALISEDMUTUALINFORMATIONSIMILARITYMETRIC2_H
+
+#define _IRTKNORMALISEDMUTUALINFORMATIONSIMILARITYMETRIC2_H
+
+/**
+ * Class for voxel similarity measure based on normalized mutual information
+ *
+ */
+
+class irtkNormalisedMutualInformationSimilarityMetric2 : public irtkMutualInformationSimilarityMetric2
+{
+
+public:
+
+  /// Constructor
+  irtkNormalisedMutualInformationSimilarityMetric2(irtkHistogram_2D<double> *, double, double, double, double);
+
+  /// Evaluate similarity measure
+  virtual double Evaluate();
+
+  /// Evaluate gradient of similarity measure
+  virtual void EvaluateGradient(irtkRealImage *, irtkRealImage *);
+
+  /// Returns the name of the class
+  virtual const char *NameOfClass();
+
+};
+
+inline irtkNormalisedMutualInformationSimilarityMetric2::irtkNormalisedMutualInformationSimilarityMetric2(irtkHistogram_2D<double> *histogram,
+    double target_min, double target_max, double source_min, double source_max)
+  : irtkMutualInformationSimilarityMetric2(histogram, target_min, target_max, source_min, source_max)
+{
+}
+
+inline const char *irtkNormalisedMutualInformationSimilarityMetric2::NameOfClass()
+{
+  return "irtkNormalisedMutualInformationSimilarityMetric2";
+}
+
+#endif
@@ -0,0 +1,161 @@
+/*=========================================================================
+
+  Library   : Image Registration Toolkit (IRTK)
+  Module    : $Id$
+  Copyright : Imperial College, Department of Computing
+              Visual Information Processing (VIP), 2009 onwards
+  Date      : $Date$
+  Version   : $Revision$
+  Changes   : $Author$
+
+Copyright (c) 1999-2014 and onwards, Imperial College London
+All rights reserved.
+See LICENSE for details
+
+=========================================================================*/
+
+#ifndef _IRTKOPTIMIZER2_H
+
+#define _IRTKOPTIMIZER2_H
+
+/// Forward declaration
+class irtkImageRegistration2;
+
+/**
+ * Generic class for gradient-based optimization of registration2 filters.
+ *
+ * This class maximises the similarity of an image registration by moving
+ * the transformation parameters along a search direction computed by the
+ * derived class. The step length along the search direction is found by a
+ * line search for a step which increases the similarity and satisfies the
+ * curvature condition of the strong Wolfe conditions. As the gradients of
+ * the similarity metrics are only known up to a positive factor, the line
+ * search only compares slopes with slopes and similarities with
+ * similarities. The similarity and its gradient are evaluated together for
+ * each trial step, and the gradient of the accepted step is reused for the
+ * next search direction, so that no trial step has to be evaluated twice.
+ * This is the abstract base class which defines a common interface for
+ * these optimizers.
+ *
+ */
+
+class irtkOptimizer2 : public irtkObject
+{
+
+protected:
+
+  /// Pointer to transformation
+  irtkTransformation *_Transformation;
+
+  /// Pointer to registration
+  irtkImageRegistration2 *_Registration;
+
+  /// Number of transformation parameters
+  int _NumberOfDOFs;
+
+  /// Minimum change of parameters along search direction
+  double _MinStep;
+
+  /// Maximum change of parameters along search direction
+  double _MaxStep;
+
+  /// Convergence parameter based on change in similarity
+  double _Epsilon;
+
+  /// Max. number of iterations
+  int _NumberOfIterations;
+
+  /// Parameter of curvature condition of line search
+  double _Curvature;
+
+  /// Current parameters and similarity
+  double *_x, _Value;
+
+  /// Gradient of similarity at current parameters
+  double *_gradient;
+
+  /// Search direction
+  double *_direction;
+
+  /// Change of parameters and change of gradient of last accepted step
+  double *_s, *_y;
+
+  /// Gradient at trial step and at best trial step of line search
+  double *_trialGradient, *_bestGradient;
+
+  /// Step length and slope along search direction of last accepted step
+  double _Step, _Slope;
+
+  /// Initial set up for the optimization
+  virtual void Initialize();
+
+  /// Final set up for the optimization
+  virtual void Finalize();
+
+  /// Evaluates similarity and its gradient at step length along search direction
+  virtual double EvaluateStep(double, double *, double &);
+
+  /** Line search along search direction with given slope. Returns false
+   *  if no step which increases the similarity has been found.
+   */
+  virtual bool LineSearch(double);
+
+  /// Compute search direction from gradient
+  virtual void ComputeDirection() = 0;
+
+  /** Initial step length of line search for given slope, or zero for the
+   *  maximum step length. By default the change of similarity of the last
+   *  accepted step is assumed for the first trial step.
+   */
+  virtual double InitialStep(double);
+
+  /// Discard information of previous steps
+  virtual void Reset();
+
+  /// Update after accepted step with change of parameters and change of negated gradient
+  virtual void Update(const double *, const double *);
+
+public:
+
+  /// Constructor
+  irtkOptimizer2();
+
+  /// Destructor
+  virtual ~irtkOptimizer2();
+
+  /// Run the optimizer
+  virtual double Run();
+
+  /// Print name of the class
+  virtual const char *NameOfClass() = 0;
+
+  virtual SetMacro(Transformation, irtkTransformation *);
+
+  virtual GetMacro(Transformation, irtkTransformation *);
+
+  virtual SetMacro(Registration, irtkImageRegistration2 *);
+
+  virtual GetMacro(Registration, irtkImageRegistration2 *);
+
+  virtual SetMacro(MinStep, double);
+
+  virtual GetMacro(MinStep, double);
+
+  virtual SetMacro(MaxStep, double);
+
+  virtual GetMacro(MaxStep, double);
+
+  virtual SetMacro(Epsilon, double);
+
+  virtual GetMacro(Epsilon, double);
+
+  virtual SetMacro(NumberOfIterations, int);
+
+  virtual GetMacro(NumberOfIterations, int);
+
+};
+
+#include <irtkConjugateGradientOptimizer2.h>
+#include <irtkLBFGSOptimizer2.h>
+
+#endif
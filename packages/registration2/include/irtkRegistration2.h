@@ -33,6 +33,9 @@ public:
 
 };
 
+#include <irtkJointHistogramNMI.h>
+#include <irtkSimilarityMetric2.h>
+#include <irtkOptimizer2.h>
 #include <irtkImageRegistration2.h>
 #include <irtkMultipleImageRegistration2.h>
 
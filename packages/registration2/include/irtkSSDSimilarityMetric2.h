@@ -0,0 +1,60 @@
+/*=========================================================================
+
+  Library   : Image Registration Toolkit (IRTK)
+  Module    : $Id$
+  Copyright : Imperial College, Department of Computing
+              Visual Information Processing (VIP), 2009 onwards
+  Date      : $Date$
+  Version   : $Revision$
+  Changes   : $Author$
+
+Copyright (c) 1999-2014 and onwards, Imperial College London
+All rights reserved.
+See LICENSE for details
+
+=========================================================================*/
+
+#ifndef _IRTKSSDSIMILARITYMETRIC2_H
+
+#define _IRTKSSDSIMILARITYMETRIC2_H
+
+/**
+ * Class for voxel similarity measure based on sums-of-squared differences.
+ *
+ * The metric is normalized by the number of samples and the maximum
+ * possible squared difference and negated so that it is to be maximized.
+ */
+
+class irtkSSDSimilarityMetric2 : public irtkSimilarityMetric2
+{
+
+  /// Maximum possible squared difference between target and source
+  double _maxDiff;
+
+public:
+
+  /// Constructor
+  irtkSSDSimilarityMetric2(double);
+
+  /// Evaluate similarity measure
+  virtual double Evaluate();
+
+  /// Evaluate gradient of similarity measure
+  virtual void EvaluateGradient(irtkRealImage *, irtkRealImage *);
+
+  /// Returns the name of the class
+  virtual const char *NameOfClass();
+
+};
+
+inline irtkSSDSimilarityMetric2::irtkSSDSimilarityMetric2(double maxDiff)
+{
+  _maxDiff = maxDiff;
+}
+
+inline const char *irtkSSDSimilarityMetric2::NameOfClass()
+{
+  return "irtkSSDSimilarityMetric2";
+}
+
+#endif
@@ -0,0 +1,103 @@
+/*=========================================================================
+
+  Library   : Image Registration Toolkit (IRTK)
+  Module    : $Id$
+  Copyright : Imperial College, Department of Computing
+              Visual Information Processing (VIP), 2009 onwards
+  Date      : $Date$
+  Version   : $Revision$
+  Changes   : $Author$
+
+Copyright (c) 1999-2014 and onwards, Imperial College London
+All rights reserved.
+See LICENSE for details
+
+=========================================================================*/
+
+#ifndef _IRTKSIMILARITYMETRIC2_H
+
+#define _IRTKSIMILARITYMETRIC2_H
+
+/**
+ * Generic class for voxel similarity measures with analytic gradients.
+ *
+ * This abstract class implements the interface between the registration2
+ * filters and the similarity measures. A metric compares the target image
+ * with the transformed source image and returns a value which is to be
+ * maximized. Its gradient is evaluated voxel-wise: for each target voxel
+ * the derivative of the metric with respect to the transformed source
+ * intensity is multiplied with the gradient of the transformed source.
+ *
+ * Only voxels for which the mask is zero and the transformed source is
+ * above the source padding value contribute to the metric.
+ */
+
+class irtkSimilarityMetric2 : public irtkObject
+{
+
+protected:
+
+  /// Target image
+  irtkRealImage *_target;
+
+  /// Transformed source image
+  irtkRealImage *_source;
+
+  /// Mask of voxels to be ignored where non-zero (optional)
+  irtkGreyImage *_mask;
+
+  /// Padding value of source image
+  double _SourcePadding;
+
+public:
+
+  /// Constructor
+  irtkSimilarityMetric2();
+
+  /// Destructor
+  virtual ~irtkSimilarityMetric2();
+
+  /// Set target image, transformed source image, mask and source padding
+  virtual void SetInput(irtkRealImage *, irtkRealImage *, irtkGreyImage *, double);
+
+  /// Evaluate similarity measure
+  virtual double Evaluate() = 0;
+
+  /** Evaluate gradient of similarity measure given the gradient of the
+   *  transformed source image. Both gradient images have three components
+   *  in t.
+   */
+  virtual void EvaluateGradient(irtkRealImage *, irtkRealImage *) = 0;
+
+  /// Returns the name of the class
+  virtual const char *NameOfClass() = 0;
+
+};
+
+inline irtkSimilarityMetric2::irtkSimilarityMetric2()
+{
+  _target = NULL;
+  _source = NULL;
+  _mask   = NULL;
+  _SourcePadding = MIN_GREY;
+}
+
+inline irtkSimilarityMetric2::~irtkSimilarityMetric2()
+{
+}
+
+inline void irtkSimilarityMetric2::SetInput(irtkRealImage *target, irtkRealImage *source, irtkGreyImage *mask, double padding)
+{
+  _target = target;
+  _source = source;
+  _mask   = mask;
+  _SourcePadding = padding;
+}
+
+#include <irtkSSDSimilarityMetric2.h>
+#include <irtkCrossCorrelationSimilarityMetric2.h>
+#include <irtkLocalCrossCorrelationSimilarityMetric2.h>
+#include <irtkMutualInformationSimilarityMetric2.h>
+#include <irtkNormalisedMutualInformationSimilarityMetric2.h>
+
+#endif
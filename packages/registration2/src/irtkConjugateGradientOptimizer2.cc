@@ -0,0 +1,59 @@
+/*=========================================================================
+
+  Library   : Image Registration Toolkit (IRTK)
+  Module    : $Id$
+  Copyright : Imperial College, Department of Computing
+              Visual Information Processing (VIP), 2009 onwards
+  Date      : $Date$
+  Version   : $Revision$
+  Changes   : $Author$
+
+Copyright (c) 1999-2014 and onwards, Imperial College London
+All rights reserved.
+See LICENSE for details
+
+=========================================================================*/
+
+#include <irtkRegistration2.h>
+
+irtkConjugateGradientOptimizer2::irtkConjugateGradientOptimizer2()
+{
+  // Conjugate directions require a more accurate line search
+  _Curvature    = 0.1;
+  _gg           = 0;
+  _HasDirection = false;
+}
+
+void irtkConjugateGradientOptimizer2::ComputeDirection()
+{
+  int i;
+  double gg, gy, beta;
+
+  gg = 0;
+  gy = 0;
+  for (i = 0; i < _NumberOfDOFs; i++) {
+    gg += _gradient[i] * _gradient[i];
+    gy += _gradient[i] * _y[i];
+  }
+
+  // Polak-Ribiere coefficient, where _y holds the previous minus the current gradient
+  beta = 0;
+  if ((_HasDirection == true) && (_gg > 0)) {
+    beta = -gy / _gg;
+    if (beta < 0) beta = 0;
+  }
+  for (i = 0; i < _NumberOfDOFs; i++) {
+    _direction[i] = _gradient[i] + beta * _direction[i];
+  }
+  _gg = gg;
+}
+
+void irtkConjugateGradientOptimizer2::Reset()
+{
+  _HasDirection = false;
+}
+
+void irtkConjugateGradientOptimizer2::Update(const double *, const double *)
+{
+  _HasDirection = true;
+}
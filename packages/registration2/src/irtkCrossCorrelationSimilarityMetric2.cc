@@ -0,0 +1,229 @@
+/*=========================================================================
+
+  Library   : Image Registration Toolkit (IRTK)
+  Module    : $Id$
+  Copyright : Imperial College, Department of Computing
+              Visual Information Processing (VIP), 2009 onwards
+  Date      : $Date$
+  Version   : $Revision$
+  Changes   : $Author$
+
+Copyright (c) 1999-2014 and onwards, Imperial College London
+All rights reserved.
+See LICENSE for details
+
+=========================================================================*/
+
+#include <irtkRegistration2.h>
+
+class irtkMultiThreadedCrossCorrelationStatistics
+{
+
+  /// Pointer to voxels in images
+  const irtkRealPixel *_target, *_source;
+
+  /// Pointer to voxels in mask (may be NULL)
+  const irtkGreyPixel *_mask;
+
+  /// Padding value of source image
+  double _padding;
+
+  /// Number of voxels per slice
+  int _n;
+
+  /// Means subtracted before summation
+  double _mean_t, _mean_s;
+
+public:
+
+  /// Number of samples
+  int _samples;
+
+  /// Sums of (centered) intensities and their products
+  double _t, _s, _tt, _ss, _ts;
+
+  irtkMultiThreadedCrossCorrelationStatistics(const irtkRealPixel *target, const irtkRealPixel *source, const irtkGreyPixel *mask, double padding, int n, double mean_t, double mean_s) {
+    _target  = target;
+    _source  = source;
+    _mask    = mask;
+    _padding = padding;
+    _n       = n;
+    _mean_t  = mean_t;
+    _mean_s  = mean_s;
+    _samples = 0;
+    _t = _s = _tt = _ss = _ts = 0;
+  }
+
+  irtkMultiThreadedCrossCorrelationStatistics(irtkMultiThreadedCrossCorrelationStatistics &r, split) {
+    _target  = r._target;
+    _source  = r._source;
+    _mask    = r._mask;
+    _padding = r._padding;
+    _n       = r._n;
+    _mean_t  = r._mean_t;
+    _mean_s  = r._mean_s;
+    _samples = 0;
+    _t = _s = _tt = _ss = _ts = 0;
+  }
+
+  void join(irtkMultiThreadedCrossCorrelationStatistics &rhs) {
+    _samples += rhs._samples;
+    _t  += rhs._t;
+    _s  += rhs._s;
+    _tt += rhs._tt;
+    _ss += rhs._ss;
+    _ts += rhs._ts;
+  }
+
+  void operator()(const blocked_range<int> &r) {
+    int i;
+    double t, s;
+
+    for (i = r.begin() * _n; i < r.end() * _n; i++) {
+      if (((_mask == NULL) || (_mask[i] == 0)) && (_source[i] > _padding)) {
+        t = _target[i] - _mean_t;
+        s = _source[i] - _mean_s;
+        _t  += t;
+        _s  += s;
+        _tt += t * t;
+        _ss += s * s;
+        _ts += t * s;
+        _samples++;
+      }
+    }
+  }
+};
+
+class irtkMultiThreadedCrossCorrelationGradient
+{
+
+  /// Pointer to voxels in images
+  const irtkRealPixel *_target, *_source, *_sourceGradient;
+
+  /// Pointer to voxels in gradient of similarity
+  irtkRealPixel *_similarityGradient;
+
+  /// Pointer to voxels in mask (may be NULL)
+  const irtkGreyPixel *_mask;
+
+  /// Padding value of source image
+  double _padding;
+
+  /// Number of voxels per slice and per frame
+  int _n, _N;
+
+  /// Coefficients of the gradient
+  double _a, _b, _mean_t, _mean_s;
+
+public:
+
+  irtkMultiThreadedCrossCorrelationGradient(const irtkRealPixel *target, const irtkRealPixel *source, const irtkGreyPixel *mask, double padding,
+                                            const irtkRealPixel *sourceGradient, irtkRealPixel *similarityGradient,
+                                            int n, int N, double a, double b, double mean_t, double mean_s) {
+    _target  = target;
+    _source  = source;
+    _mask    = mask;
+    _padding = padding;
+    _sourceGradient     = sourceGradient;
+    _similarityGradient = similarityGradient;
+    _n = n;
+    _N = N;
+    _a = a;
+    _b = b;
+    _mean_t = mean_t;
+    _mean_s = mean_s;
+  }
+
+  void operator()(const blocked_range<int> &r) const {
+    int i, l;
+    double grad;
+
+    for (i = r.begin() * _n; i < r.end() * _n; i++) {
+      if (((_mask == NULL) || (_mask[i] == 0)) && (_source[i] > _padding)) {
+        grad = _a * (_target[i] - _mean_t) - _b * (_source[i] - _mean_s);
+      } else {
+        grad = 0;
+      }
+      for (l = 0; l < 3; l++) {
+        _similarityGradient[i + l * _N] = grad * _sourceGradient[i + l * _N];
+      }
+    }
+  }
+};
+
+int irtkCrossCorrelationSimilarityMetric2::ComputeStatistics()
+{
+  int n;
+
+  // Pointer to voxels in images
+  irtkRealPixel *ptr2target = _target->GetPointerToVoxels();
+  irtkRealPixel *ptr2source = _source->GetPointerToVoxels();
+  irtkGreyPixel *ptr2mask   = (_mask != NULL) ? _mask->GetPointerToVoxels() : NULL;
+
+  n = _target->GetX() * _target->GetY();
+
+  task_scheduler_init init(tbb_no_threads);
+
+  // Compute means
+  irtkMultiThreadedCrossCorrelationStatistics means(ptr2target, ptr2source, ptr2mask, _SourcePadding, n, 0, 0);
+  parallel_reduce(blocked_range<int>(0, _target->GetZ()), means);
+  if (means._samples == 0) {
+    init.terminate();
+    return 0;
+  }
+  _mean_t = means._t / means._samples;
+  _mean_s = means._s / means._samples;
+
+  // Compute centered sums
+  irtkMultiThreadedCrossCorrelationStatistics sums(ptr2target, ptr2source, ptr2mask, _SourcePadding, n, _mean_t, _mean_s);
+  parallel_reduce(blocked_range<int>(0, _target->GetZ()), sums);
+  _tt = sums._tt;
+  _ss = sums._ss;
+  _ts = sums._ts;
+
+  init.terminate();
+
+  return sums._samples;
+}
+
+double irtkCrossCorrelationSimilarityMetric2::Evaluate()
+{
+  if (this->ComputeStatistics() == 0) {
+    cerr << "irtkCrossCorrelationSimilarityMetric2::Evaluate: No samples available" << endl;
+    return 0;
+  }
+  if ((_tt > 0) && (_ss > 0)) {
+    return _ts / sqrt(_tt * _ss);
+  } else {
+    return 0;
+  }
+}
+
+void irtkCrossCorrelationSimilarityMetric2::EvaluateGradient(irtkRealImage *sourceGradient, irtkRealImage *similarityGradient)
+{
+  int n, N;
+  double a, b, cc;
+
+  // The derivative of CC with respect to the source intensity s_i is
+  // (t_i - mean_t) / sqrt(tt * ss) - CC * (s_i - mean_s) / ss
+  if ((this->ComputeStatistics() > 0) && (_tt > 0) && (_ss > 0)) {
+    cc = _ts / sqrt(_tt * _ss);
+    a  = 1.0 / sqrt(_tt * _ss);
+    b  = cc / _ss;
+  } else {
+    a  = 0;
+    b  = 0;
+  }
+
+  n = _target->GetX() * _target->GetY();
+  N = n * _target->GetZ();
+
+  // Compute gradient
+  irtkMultiThreadedCrossCorrelationGradient gradient(_target->GetPointerToVoxels(), _source->GetPointerToVoxels(),
+                                                     (_mask != NULL) ? _mask->GetPointerToVoxels() : NULL, _SourcePadding,
+                                                     sourceGradient->GetPointerToVoxels(), similarityGradient->GetPointerToVoxels(),
+                                                     n, N, a, b, _mean_t, _mean_s);
+  task_scheduler_init init(tbb_no_threads);
+  parallel_for(blocked_range<int>(0, _target->GetZ()), gradient);
+  init.terminate();
+}
@@ -15,6 +15,7 @@ See LICENSE for details
 =========================================================================*/
 
 #include <irtkRegistration2.h>
+#include <irtkBSplineFreeFormTransformation3DIterator.h>
 
 #ifdef WIN32
 #include <time.h>
@@ -24,6 +25,260 @@ See LICENSE for details
 
 #define MAX_NO_LINE_ITERATIONS 12
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/// Linear interpolation of n samples (2D) given their offsets and fractional coordinates
+inline void irtkFFDInterpolate2D(int n, const int *index, const int *offset, const double *x, const double *y,
+                                 const int *o, const irtkRealPixel *input, irtkRealPixel *output)
+{
+    int l = 0;
+    const irtkRealPixel *ptr;
+    double t1, t2, u1, u2;
+
+#ifdef __SSE2__
+    const irtkRealPixel *ptr2;
+    __m128d T1, T2, U1, U2, one = _mm_set1_pd(1.0), value;
+
+    // Two samples at a time, the order of operations is identical to the scalar code below
+    for (; l + 1 < n; l += 2) {
+        ptr  = input + offset[l];
+        ptr2 = input + offset[l+1];
+        T1 = _mm_loadu_pd(x + l);
+        U1 = _mm_loadu_pd(y + l);
+        T2 = _mm_sub_pd(one, T1);
+        U2 = _mm_sub_pd(one, U1);
+        value = _mm_add_pd(_mm_mul_pd(T1, _mm_add_pd(_mm_mul_pd(U2, _mm_setr_pd(ptr[o[1]], ptr2[o[1]])),
+                                                     _mm_mul_pd(U1, _mm_setr_pd(ptr[o[3]], ptr2[o[3]])))),
+                           _mm_mul_pd(T2, _mm_add_pd(_mm_mul_pd(U2, _mm_setr_pd(ptr[o[0]], ptr2[o[0]])),
+                                                     _mm_mul_pd(U1, _mm_setr_pd(ptr[o[2]], ptr2[o[2]])))));
+        _mm_storel_pd(output + index[l],   value);
+        _mm_storeh_pd(output + index[l+1], value);
+    }
+#endif
+
+    for (; l < n; l++) {
+        ptr = input + offset[l];
+        t1 = x[l];
+        u1 = y[l];
+        t2 = 1 - t1;
+        u2 = 1 - u1;
+        output[index[l]] = t1 * (u2 * ptr[o[1]] + u1 * ptr[o[3]]) + t2 * (u2 * ptr[o[0]] + u1 * ptr[o[2]]);
+    }
+}
+
+/// Linear interpolation of n samples (3D) given their offsets and fractional coordinates
+inline void irtkFFDInterpolate3D(int n, const int *index, const int *offset, const double *x, const double *y, const double *z,
+                                 const int *o, const irtkRealPixel *input, irtkRealPixel *output)
+{
+    int l = 0;
+    const irtkRealPixel *ptr;
+    double t1, t2, u1, u2, v1, v2;
+
+#ifdef __SSE2__
+    const irtkRealPixel *ptr2;
+    __m128d T1, T2, U1, U2, V1, V2, one = _mm_set1_pd(1.0), value;
+
+    // Two samples at a time, the order of operations is identical to the scalar code below
+    for (; l + 1 < n; l += 2) {
+        ptr  = input + offset[l];
+        ptr2 = input + offset[l+1];
+        T1 = _mm_loadu_pd(x + l);
+        U1 = _mm_loadu_pd(y + l);
+        V1 = _mm_loadu_pd(z + l);
+        T2 = _mm_sub_pd(one, T1);
+        U2 = _mm_sub_pd(one, U1);
+        V2 = _mm_sub_pd(one, V1);
+        value = _mm_add_pd(
+            _mm_mul_pd(T1, _mm_add_pd(
+                _mm_mul_pd(U2, _mm_add_pd(_mm_mul_pd(V2, _mm_setr_pd(ptr[o[1]], ptr2[o[1]])), _mm_mul_pd(V1, _mm_setr_pd(ptr[o[5]], ptr2[o[5]])))),
+                _mm_mul_pd(U1, _mm_add_pd(_mm_mul_pd(V2, _mm_setr_pd(ptr[o[3]], ptr2[o[3]])), _mm_mul_pd(V1, _mm_setr_pd(ptr[o[7]], ptr2[o[7]])))))),
+            _mm_mul_pd(T2, _mm_add_pd(
+                _mm_mul_pd(U2, _mm_add_pd(_mm_mul_pd(V2, _mm_setr_pd(ptr[o[0]], ptr2[o[0]])), _mm_mul_pd(V1, _mm_setr_pd(ptr[o[4]], ptr2[o[4]])))),
+                _mm_mul_pd(U1, _mm_add_pd(_mm_mul_pd(V2, _mm_setr_pd(ptr[o[2]], ptr2[o[2]])), _mm_mul_pd(V1, _mm_setr_pd(ptr[o[6]], ptr2[o[6]])))))));
+        _mm_storel_pd(output + index[l],   value);
+        _mm_storeh_pd(output + index[l+1], value);
+    }
+#endif
+
+    for (; l < n; l++) {
+        ptr = input + offset[l];
+        t1 = x[l];
+        u1 = y[l];
+        v1 = z[l];
+        t2 = 1 - t1;
+        u2 = 1 - u1;
+        v2 = 1 - v1;
+        output[index[l]] = (t1 * (u2 * (v2 * ptr[o[1]] + v1 * ptr[o[5]]) +
+            u1 * (v2 * ptr[o[3]] + v1 * ptr[o[7]])) +
+            t2 * (u2 * (v2 * ptr[o[0]] + v1 * ptr[o[4]]) +
+            u1 * (v2 * ptr[o[2]] + v1 * ptr[o[6]])));
+    }
+}
+
+class irtkMultiThreadedImageFreeFormRegistration2UpdateSource
+{
+
+    /// Pointer to registration filter
+    irtkImageFreeFormRegistration2 *_filter;
+
+    /// Whether to transform the source image gradient as well
+    bool _gradient;
+
+    /// Whether the images are 2D
+    bool _2D;
+
+    /// Offsets of the eight neighbours used for linear interpolation
+    int _offset[8];
+
+    /// Transform and interpolate a single row of the target image given the local displacements of the row
+    void Row(int j, int k, const double *dx, const double *dy, const double *dz, int *index, int *offset, double *wx, double *wy, double *wz) const {
+        int i, l, n, a, b, c, X, Y;
+        double x, y, z;
+        irtkRealPixel *output, *gradient[3];
+
+        irtkImageFreeFormRegistration2 *filter = _filter;
+        irtkRealImage *source = filter->_source;
+
+        X = filter->_target->GetX();
+        Y = filter->_target->GetY();
+        const irtkGreyPixel *ptr2mask = filter->_distanceMask.GetPointerToVoxels(0, j, k);
+        const double *ptr2disp = &(filter->_displacementLUT[3 * (k * X * Y + j * X)]);
+
+        output = filter->_transformedSource.GetPointerToVoxels(0, j, k);
+        for (l = 0; l < (_2D ? 2 : 3); l++) {
+            gradient[l] = (_gradient ? filter->_transformedSourceGradient.GetPointerToVoxels(0, j, k, l) : NULL);
+        }
+
+        // Transform all voxels of the row, linear interpolation is deferred and done in one go below
+        n = 0;
+        for (i = 0; i < X; i++) {
+            if (ptr2mask[i] == 0) {
+                x = dx[i] + ptr2disp[3*i];
+                y = dy[i] + ptr2disp[3*i+1];
+                z = (_2D ? 0 : dz[i]) + ptr2disp[3*i+2];
+                source->WorldToImage(x, y, z);
+
+                // Check whether transformed point is inside volume
+                if ((x > 0) && (x < source->GetX()-1) &&
+                    (y > 0) && (y < source->GetY()-1) &&
+                    (_2D || ((z > 0) && (z < source->GetZ()-1)))) {
+
+                    if (filter->_InterpolationMode == Interpolation_Linear) {
+                        // Calculated integer coordinates
+                        a = int(x);
+                        b = int(y);
+                        c = (_2D ? 0 : int(z));
+
+                        // Remember sample for linear interpolation
+                        index[n]  = i;
+                        offset[n] = (c * source->GetY() + b) * source->GetX() + a;
+                        wx[n] = x - a;
+                        wy[n] = y - b;
+                        wz[n] = z - c;
+                        n++;
+                    } else {
+                        if (_2D) z = 0;
+
+                        // Interpolation in source image
+                        output[i] = filter->_interpolator->Evaluate(x, y, z);
+
+                        // Interpolation in gradient image
+                        if (_gradient) {
+                            for (l = 0; l < (_2D ? 2 : 3); l++) {
+                                gradient[l][i] = filter->_interpolatorGradient->Evaluate(x, y, z, l);
+                            }
+                        }
+                    }
+                    continue;
+                }
+            }
+            output[i] = filter->_SourcePadding;
+            if (_gradient) {
+                for (l = 0; l < (_2D ? 2 : 3); l++) gradient[l][i] = 0;
+            }
+        }
+
+        // Linear interpolation in source image (and gradient image)
+        if (_2D) {
+            irtkFFDInterpolate2D(n, index, offset, wx, wy, _offset, source->GetPointerToVoxels(), output);
+            if (_gradient) {
+                for (l = 0; l < 2; l++) {
+                    irtkFFDInterpolate2D(n, index, offset, wx, wy, _offset, filter->_sourceGradient.GetPointerToVoxels(0, 0, 0, l), gradient[l]);
+                }
+            }
+        } else {
+            irtkFFDInterpolate3D(n, index, offset, wx, wy, wz, _offset, source->GetPointerToVoxels(), output);
+            if (_gradient) {
+                for (l = 0; l < 3; l++) {
+                    irtkFFDInterpolate3D(n, index, offset, wx, wy, wz, _offset, filter->_sourceGradient.GetPointerToVoxels(0, 0, 0, l), gradient[l]);
+                }
+            }
+        }
+    }
+
+public:
+
+    irtkMultiThreadedImageFreeFormRegistration2UpdateSource(irtkImageFreeFormRegistration2 *filter, bool gradient) {
+        _filter   = filter;
+        _gradient = gradient;
+        _2D       = (filter->_target->GetZ() == 1) && (filter->_source->GetZ() == 1);
+
+        // Calculate offsets for fast pixel access
+        _offset[0] = 0;
+        _offset[1] = 1;
+        _offset[2] = filter->_source->GetX();
+        _offset[3] = filter->_source->GetX()+1;
+        _offset[4] = filter->_source->GetX()*filter->_source->GetY();
+        _offset[5] = filter->_source->GetX()*filter->_source->GetY()+1;
+        _offset[6] = filter->_source->GetX()*filter->_source->GetY()+filter->_source->GetX();
+        _offset[7] = filter->_source->GetX()*filter->_source->GetY()+filter->_source->GetX()+1;
+    }
+
+    /// Process slices (3D) or rows (2D) of the target image
+    void operator()(const blocked_range<int> &r) const {
+        int j, l, X;
+
+        // Per-thread buffers for the samples and local displacements of a row
+        X = _filter->_target->GetX();
+        int    *index  = new int[X];
+        int    *offset = new int[X];
+        double *wx     = new double[3*X];
+        double *dx     = new double[3*X];
+
+        // Local displacements are evaluated slice by slice and row by row
+        irtkBSplineFreeFormTransformation3DIterator iterator(_filter->_affd);
+        iterator.Initialize(_filter->_target);
+
+        if (_2D) iterator.Slice(0);
+        for (l = r.begin(); l != r.end(); l++) {
+            if (_2D) {
+                iterator.Row(l, dx, dx + X, dx + 2*X);
+                this->Row(l, 0, dx, dx + X, dx + 2*X, index, offset, wx, wx + X, wx + 2*X);
+            } else {
+                iterator.Slice(l);
+                for (j = 0; j < _filter->_target->GetY(); j++) {
+                    iterator.Row(j, dx, dx + X, dx + 2*X);
+                    this->Row(j, l, dx, dx + X, dx + 2*X, index, offset, wx, wx + X, wx + 2*X);
+                }
+            }
+        }
+
+        delete []index;
+        delete []offset;
+        delete []wx;
+        delete []dx;
+    }
+
+    /// Run over the whole target image
+    void operator()() const {
+        task_scheduler_init init(tbb_no_threads);
+        parallel_for(blocked_range<int>(0, (_2D ? _filter->_target->GetY() : _filter->_target->GetZ()), 1), *this);
+        init.terminate();
+    }
+};
+
 irtkImageFreeFormRegistration2::irtkImageFreeFormRegistration2()
 {
     // Print debugging information
@@ -167,7 +422,7 @@ void irtkImageFreeFormRegistration2::Initialize()
 void irtkImageFreeFormRegistration2::Initialize(int level)
 {
     int i, j, k;
-    double x, y, z, *ptr2latt, *ptr2disp;
+    double x, y, z, *ptr2disp;
     irtkGreyPixel *ptr2mask;
 
     // Print debugging information
@@ -221,11 +476,7 @@ void irtkImageFreeFormRegistration2::Initialize(int level)
     // Allocate memory for global displacements
     _displacementLUT = new double[_target->GetNumberOfVoxels() * 3];
 
-    // Allocate memory for lattice coordinates
-    _latticeCoordLUT = new double[_target->GetNumberOfVoxels() * 3];
-
     ptr2disp = _displacementLUT;
-    ptr2latt = _latticeCoordLUT;
     ptr2mask = _distanceMask.GetPointerToVoxels();
     for (k = 0; k < _target->GetZ(); k++) {
         for (j = 0; j < _target->GetY(); j++) {
@@ -239,24 +490,12 @@ void irtkImageFreeFormRegistration2::Initialize(int level)
                     ptr2disp[0] = x;
                     ptr2disp[1] = y;
                     ptr2disp[2] = z;
-                    x = i;
-                    y = j;
-                    z = k;
-                    _target->ImageToWorld(x, y, z);
-                    _affd->WorldToLattice(x, y, z);
-                    ptr2latt[0] = x;
-                    ptr2latt[1] = y;
-                    ptr2latt[2] = z;
                 } else {
                     ptr2disp[0] = 0;
                     ptr2disp[1] = 0;
                     ptr2disp[2] = 0;
-                    ptr2latt[0] = 0;
-                    ptr2latt[1] = 0;
-                    ptr2latt[2] = 0;
                 }
                 ptr2disp += 3;
-                ptr2latt += 3;
                 ptr2mask++;
             }
         }
@@ -309,303 +548,32 @@ void irtkImageFreeFormRegistration2::Finalize(int level)
     _adjugate = new irtkMatrix[_affd->NumberOfDOFs()/3];
     _determinant = new double[_affd->NumberOfDOFs()/3];
     delete []_displacementLUT;
-    delete []_latticeCoordLUT;
 }
 
 void irtkImageFreeFormRegistration2::UpdateSource()
 {
-    double *ptr1;
-    double x, y, z, t1, t2, u1, u2, v1, v2;
-    int a, b, c, i, j, k, offset1, offset2, offset3, offset4, offset5, offset6, offset7, offset8;
-
     IRTK_START_TIMING();
 
     // Generate transformed tmp image
     _transformedSource = *_target;
 
-    // Calculate offsets for fast pixel access
-    offset1 = 0;
-    offset2 = 1;
-    offset3 = this->_source->GetX();
-    offset4 = this->_source->GetX()+1;
-    offset5 = this->_source->GetX()*this->_source->GetY();
-    offset6 = this->_source->GetX()*this->_source->GetY()+1;
-    offset7 = this->_source->GetX()*this->_source->GetY()+this->_source->GetX();
-    offset8 = this->_source->GetX()*this->_source->GetY()+this->_source->GetX()+1;
-
-    double *ptr2disp = _displacementLUT;
-    double *ptr2latt = _latticeCoordLUT;
-    if ((_target->GetZ() == 1) && (_source->GetZ() == 1)) {
-        for (j = 0; j < _target->GetY(); j++) {
-            for (i = 0; i < _target->GetX(); i++) {
-            	if (_distanceMask(i, j, 0) == 0) {
-                    x = ptr2latt[0];
-                    y = ptr2latt[1];
-                    z = 0;
-                    _affd->FFD2D(x, y);
-                    x += ptr2disp[0];
-                    y += ptr2disp[1];
-                    z += ptr2disp[2];
-                    _source->WorldToImage(x, y, z);
-
-                    // Check whether transformed point is inside volume
-                    if ((x > 0) && (x < _source->GetX()-1) &&
-                        (y > 0) && (y < _source->GetY()-1)) {
-
-                            if (_InterpolationMode == Interpolation_Linear) {
-                                // Calculated integer coordinates
-                                a  = int(x);
-                                b  = int(y);
-
-                                // Calculated fractional coordinates
-                                t1 = x - a;
-                                u1 = y - b;
-                                t2 = 1 - t1;
-                                u2 = 1 - u1;
-
-                                // Linear interpolation in source image
-                                ptr1 = (double *)_source->GetScalarPointer(a, b, 0);
-                                _transformedSource(i, j, 0) = t1 * (u2 * ptr1[offset2] + u1 * ptr1[offset4]) + t2 * (u2 * ptr1[offset1] + u1 * ptr1[offset3]);
-                            } else {
-                                // Interpolation in source image
-                                _transformedSource(i, j, 0) = _interpolator->Evaluate(x, y, 0);
-                            }
-                    } else {
-                        _transformedSource(i, j, 0) = _SourcePadding;
-                    }
-                } else {
-                    _transformedSource(i, j, 0) = _SourcePadding;
-                }
-                ptr2disp += 3;
-                ptr2latt += 3;
-            }
-        }
-    } else {
-        for (k = 0; k < _target->GetZ(); k++) {
-            for (j = 0; j < _target->GetY(); j++) {
-                for (i = 0; i < _target->GetX(); i++) {
-                	if (_distanceMask(i, j, k) == 0) {
-                        x = ptr2latt[0];
-                        y = ptr2latt[1];
-                        z = ptr2latt[2];
-                        _affd->FFD3D(x, y, z);
-                        x += ptr2disp[0];
-                        y += ptr2disp[1];
-                        z += ptr2disp[2];
-                        _source->WorldToImage(x, y, z);
-
-                        // Check whether transformed point is inside volume
-                        if ((x > 0) && (x < _source->GetX()-1) &&
-                            (y > 0) && (y < _source->GetY()-1) &&
-                            (z > 0) && (z < _source->GetZ()-1)) {
-                                if (_InterpolationMode == Interpolation_Linear) {
-
-                                    // Calculated integer coordinates
-                                    a  = int(x);
-                                    b  = int(y);
-                                    c  = int(z);
-
-                                    // Calculated fractional coordinates
-                                    t1 = x - a;
-                                    u1 = y - b;
-                                    v1 = z - c;
-                                    t2 = 1 - t1;
-                                    u2 = 1 - u1;
-                                    v2 = 1 - v1;
-
-                                    // Linear interpolation in source image
-                                    ptr1 = (double *)_source->GetScalarPointer(a, b, c);
-                                    _transformedSource(i, j, k) = (t1 * (u2 * (v2 * ptr1[offset2] + v1 * ptr1[offset6]) +
-                                        u1 * (v2 * ptr1[offset4] + v1 * ptr1[offset8])) +
-                                        t2 * (u2 * (v2 * ptr1[offset1] + v1 * ptr1[offset5]) +
-                                        u1 * (v2 * ptr1[offset3] + v1 * ptr1[offset7])));
-                                } else {
-                                    // Interpolation in source image
-                                    _transformedSource(i, j, k) = _interpolator->Evaluate(x, y, z);
-                                }
-                        } else {
-                            _transformedSource(i, j, k) = _SourcePadding;
-                        }
-                    } else {
-                        _transformedSource(i, j, k) = _SourcePadding;
-                    }
-                    ptr2disp += 3;
-                    ptr2latt += 3;
-                }
-            }
-        }
-    }
+    // Transform and interpolate target slices (3D) or rows (2D) in parallel
+    irtkMultiThreadedImageFreeFormRegistration2UpdateSource update(this, false);
+    update();
 
     IRTK_END_TIMING("irtkImageFreeFormRegistration2::UpdateSource");
 }
 
 void irtkImageFreeFormRegistration2::UpdateSourceAndGradient()
 {
-	irtkRealPixel *ptr1, *ptr2;
-	double x, y, z, t1, t2, u1, u2, v1, v2;
-    int a, b, c, i, j, k, offset1, offset2, offset3, offset4, offset5, offset6, offset7, offset8;
-
     IRTK_START_TIMING();
 
     // Generate transformed tmp image
     _transformedSource = *_target;
 
-    // Calculate offsets for fast pixel access
-    offset1 = 0;
-    offset2 = 1;
-    offset3 = this->_source->GetX();
-    offset4 = this->_source->GetX()+1;
-    offset5 = this->_source->GetX()*this->_source->GetY();
-    offset6 = this->_source->GetX()*this->_source->GetY()+1;
-    offset7 = this->_source->GetX()*this->_source->GetY()+this->_source->GetX();
-    offset8 = this->_source->GetX()*this->_source->GetY()+this->_source->GetX()+1;
-
-    double *ptr2disp = _displacementLUT;
-    double *ptr2latt = _latticeCoordLUT;
-    if ((_target->GetZ() == 1) && (_source->GetZ() == 1)) {
-        for (j = 0; j < _target->GetY(); j++) {
-            for (i = 0; i < _target->GetX(); i++) {
-            	if (_distanceMask(i, j, 0) == 0) {
-                    x = ptr2latt[0];
-                    y = ptr2latt[1];
-                    z = 0;
-                    _affd->FFD2D(x, y);
-                    x += ptr2disp[0];
-                    y += ptr2disp[1];
-                    z += ptr2disp[2];
-                    _source->WorldToImage(x, y, z);
-
-                    // Check whether transformed point is inside volume
-                    if ((x > 0) && (x < _source->GetX()-1) &&
-                        (y > 0) && (y < _source->GetY()-1)) {
-
-                            if (_InterpolationMode == Interpolation_Linear) {
-                                // Calculated integer coordinates
-                                a  = int(x);
-                                b  = int(y);
-
-                                // Calculated fractional coordinates
-                                t1 = x - a;
-                                u1 = y - b;
-                                t2 = 1 - t1;
-                                u2 = 1 - u1;
-
-                                // Linear interpolation in source image
-                                ptr1 = (irtkRealPixel *)_source->GetScalarPointer(a, b, 0);
-                                _transformedSource(i, j, 0) = t1 * (u2 * ptr1[offset2] + u1 * ptr1[offset4]) + t2 * (u2 * ptr1[offset1] + u1 * ptr1[offset3]);
-
-                                // Linear interpolation in gradient image
-                                ptr2 = _sourceGradient.GetPointerToVoxels(a, b, 0, 0);
-                                _transformedSourceGradient(i, j, 0, 0) = t1 * (u2 * ptr2[offset2] + u1 * ptr2[offset4]) + t2 * (u2 * ptr2[offset1] + u1 * ptr2[offset3]);
-                                ptr2 = _sourceGradient.GetPointerToVoxels(a, b, 0, 1);
-                                _transformedSourceGradient(i, j, 0, 1) = t1 * (u2 * ptr2[offset2] + u1 * ptr2[offset4]) + t2 * (u2 * ptr2[offset1] + u1 * ptr2[offset3]);
-
-                            } else {
-                                // Interpolation in source image
-                                _transformedSource(i, j, 0) = _interpolator->Evaluate(x, y, 0);
-
-                                // Interpolation in gradient image
-                                _transformedSourceGradient(i, j, 0, 0) = _interpolatorGradient->Evaluate(x, y, 0, 0);
-                                _transformedSourceGradient(i, j, 0, 1) = _interpolatorGradient->Evaluate(x, y, 0, 1);
-                            }
-                    } else {
-                        _transformedSource(i, j, 0) = _SourcePadding;
-                        _transformedSourceGradient(i, j, 0, 0) = 0;
-                        _transformedSourceGradient(i, j, 0, 1) = 0;
-                    }
-                } else {
-                    _transformedSource(i, j, 0) = _SourcePadding;
-                    _transformedSourceGradient(i, j, 0, 0) = 0;
-                    _transformedSourceGradient(i, j, 0, 1) = 0;
-                }
-                ptr2disp += 3;
-                ptr2latt += 3;
-            }
-        }
-    } else {
-        for (k = 0; k < _target->GetZ(); k++) {
-            for (j = 0; j < _target->GetY(); j++) {
-                for (i = 0; i < _target->GetX(); i++) {
-                	if (_distanceMask(i, j, k) == 0) {
-                        x = ptr2latt[0];
-                        y = ptr2latt[1];
-                        z = ptr2latt[2];
-                        _affd->FFD3D(x, y, z);
-                        x += ptr2disp[0];
-                        y += ptr2disp[1];
-                        z += ptr2disp[2];
-                        _source->WorldToImage(x, y, z);
-
-                        // Check whether transformed point is inside volume
-                        if ((x > 0) && (x < _source->GetX()-1) &&
-                            (y > 0) && (y < _source->GetY()-1) &&
-                            (z > 0) && (z < _source->GetZ()-1)) {
-
-                                if (_InterpolationMode == Interpolation_Linear) {
-                                    // Calculated integer coordinates
-                                    a  = int(x);
-                                    b  = int(y);
-                                    c  = int(z);
-
-                                    // Calculated fractional coordinates
-                                    t1 = x - a;
-                                    u1 = y - b;
-                                    v1 = z - c;
-                                    t2 = 1 - t1;
-                                    u2 = 1 - u1;
-                                    v2 = 1 - v1;
-
-                                    // Linear interpolation in source image
-                                    ptr1 = (irtkRealPixel *)_source->GetScalarPointer(a, b, c);
-                                    _transformedSource(i, j, k) = (t1 * (u2 * (v2 * ptr1[offset2] + v1 * ptr1[offset6]) +
-                                        u1 * (v2 * ptr1[offset4] + v1 * ptr1[offset8])) +
-                                        t2 * (u2 * (v2 * ptr1[offset1] + v1 * ptr1[offset5]) +
-                                        u1 * (v2 * ptr1[offset3] + v1 * ptr1[offset7])));
-
-                                    // Linear interpolation in gradient image
-                                    ptr2 = _sourceGradient.GetPointerToVoxels(a, b, c, 0);
-                                    _transformedSourceGradient(i, j, k, 0) = (t1 * (u2 * (v2 * ptr2[offset2] + v1 * ptr2[offset6]) +
-                                        u1 * (v2 * ptr2[offset4] + v1 * ptr2[offset8])) +
-                                        t2 * (u2 * (v2 * ptr2[offset1] + v1 * ptr2[offset5]) +
-                                        u1 * (v2 * ptr2[offset3] + v1 * ptr2[offset7])));
-                                    ptr2 = _sourceGradient.GetPointerToVoxels(a, b, c, 1);
-                                    _transformedSourceGradient(i, j, k, 1) = (t1 * (u2 * (v2 * ptr2[offset2] + v1 * ptr2[offset6]) +
-                                        u1 * (v2 * ptr2[offset4] + v1 * ptr2[offset8])) +
-                                        t2 * (u2 * (v2 * ptr2[offset1] + v1 * ptr2[offset5]) +
-                                        u1 * (v2 * ptr2[offset3] + v1 * ptr2[offset7])));
-                                    ptr2 = _sourceGradient.GetPointerToVoxels(a, b, c, 2);
-                                    _transformedSourceGradient(i, j, k, 2) = (t1 * (u2 * (v2 * ptr2[offset2] + v1 * ptr2[offset6]) +
-                                        u1 * (v2 * ptr2[offset4] + v1 * ptr2[offset8])) +
-                                        t2 * (u2 * (v2 * ptr2[offset1] + v1 * ptr2[offset5]) +
-                                        u1 * (v2 * ptr2[offset3] + v1 * ptr2[offset7])));
-
-                                } else {
-                                    // Interpolation in source image
-                                    _transformedSource(i, j, k) = _interpolator->Evaluate(x, y, z);
-
-                                    // Interpolation in gradient image
-                                    _transformedSourceGradient(i, j, k, 0) = _interpolatorGradient->Evaluate(x, y, z, 0);
-                                    _transformedSourceGradient(i, j, k, 1) = _interpolatorGradient->Evaluate(x, y, z, 1);
-                                    _transformedSourceGradient(i, j, k, 2) = _interpolatorGradient->Evaluate(x, y, z, 2);
-                                }
-                        } else {
-                            _transformedSource(i, j, k) = _SourcePadding;
-                            _transformedSourceGradient(i, j, k, 0) = 0;
-                            _transformedSourceGradient(i, j, k, 1) = 0;
-                            _transformedSourceGradient(i, j, k, 2) = 0;
-                        }
-                    } else {
-                        _transformedSource(i, j, k) = _SourcePadding;
-                        _transformedSourceGradient(i, j, k, 0) = 0;
-                        _transformedSourceGradient(i, j, k, 1) = 0;
-                        _transformedSourceGradient(i, j, k, 2) = 0;
-                    }
-                    ptr2disp += 3;
-                    ptr2latt += 3;
-                }
-            }
-        }
-    }
+    // Transform and interpolate target slices (3D) or rows (2D) in parallel
+    irtkMultiThreadedImageFreeFormRegistration2UpdateSource update(this, true);
+    update();
 
     IRTK_END_TIMING("irtkImageFreeFormRegistration2::UpdateSourceAndGradient");
 }
@@ -869,7 +837,7 @@ void irtkImageFreeFormRegistration2::EvaluateGradient2D(double *gradient)
 
 void irtkImageFreeFormRegistration2::EvaluateGradient3D(double *gradient)
 {
-    double basis, *ptr;
+    double basis, pos[3], m[3][4];
     int i, j, k, i1, i2, j1, j2, k1, k2, x, y, z, index, index2, index3;
 
     // Initialize gradient to zero
@@ -877,6 +845,14 @@ void irtkImageFreeFormRegistration2::EvaluateGradient3D(double *gradient)
         gradient[i] = 0;
     }
 
+    // Image to lattice coordinates
+    irtkMatrix matrix = _affd->_matW2L * _target->GetImageToWorldMatrix();
+    for (j = 0; j < 3; j++) {
+        for (i = 0; i < 4; i++) {
+            m[j][i] = matrix(j, i);
+        }
+    }
+
     // Loop over control points
     for (z = 0; z < _affd->GetZ(); z++) {
         for (y = 0; y < _affd->GetY(); y++) {
@@ -899,12 +875,15 @@ void irtkImageFreeFormRegistration2::EvaluateGradient3D(double *gradient)
                     //
                     for (k = k1; k <= k2; k++) {
                         for (j = j1; j <= j2; j++) {
-                            ptr = &(_latticeCoordLUT[3 * (k * (_target->GetX()*_target->GetY()) + j * _target->GetX() + i1)]);
+                            // Lattice coordinates of first voxel in row
+                            pos[0] = m[0][0] * i1 + m[0][1] * j + m[0][2] * k + m[0][3];
+                            pos[1] = m[1][0] * i1 + m[1][1] * j + m[1][2] * k + m[1][3];
+                            pos[2] = m[2][0] * i1 + m[2][1] * j + m[2][2] * k + m[2][3];
                             for (i = i1; i <= i2; i++) {
                                 // Check whether reference point is valid
                             	if ((_distanceMask(i, j, k) == 0) && (_transformedSource(i, j, k) > _SourcePadding)) {
                                     // Compute B-spline tensor product at current position
-                                    basis = _affd->B(ptr[0] - x) * _affd->B(ptr[1] - y) * _affd->B(ptr[2] - z);
+                                    basis = _affd->B(pos[0] - x) * _affd->B(pos[1] - y) * _affd->B(pos[2] - z);
 
                                     // Convert voxel-based gradient into gradient with respect to parameters (chain rule)
                                     //
@@ -914,7 +893,9 @@ void irtkImageFreeFormRegistration2::EvaluateGradient3D(double *gradient)
                                     gradient[index2] += basis * _similarityGradient(i, j, k, 1);
                                     gradient[index3] += basis * _similarityGradient(i, j, k, 2);
                                 }
-                                ptr += 3;
+                                pos[0] += m[0][0];
+                                pos[1] += m[1][0];
+                                pos[2] += m[2][0];
                             }
                         }
                     }
@@ -985,12 +966,12 @@ double irtkImageFreeFormRegistration2::EvaluateGradient(double *gradient)
 		this->VolumePreservationPenaltyGradient(gradient);
 	}
 
-	if(this->_Lambda3 > 0){
+	if((this->_Lambda3 > 0) && (this->UseOptimizer() == false)){
 		this->NormalizeGradient(gradient);
 	}
 
-    // Update gradient
-    if (_CurrentIteration == 0) {
+    // Update gradient to be conjugate, unless the search direction is computed by an irtkOptimizer2
+    if ((this->UseOptimizer() == false) && (_CurrentIteration == 0)) {
         // First iteration, so let's initialize
         if (g != NULL) delete []g;
         g = new double [_affd->NumberOfDOFs()];
@@ -1000,7 +981,7 @@ double irtkImageFreeFormRegistration2::EvaluateGradient(double *gradient)
             g[i] = -gradient[i];
             h[i] = g[i];
         }
-    } else {
+    } else if (this->UseOptimizer() == false) {
         // Update gradient direction to be conjugate
         gg = 0;
         dgg = 0;
@@ -1089,14 +1070,26 @@ void irtkImageFreeFormRegistration2::Run()
         sprintf(buffer, "target_%d.nii.gz", _CurrentLevel);
         if (_DebugFlag == true) _target->Write(buffer);
 
+        // Count updates of the transformed source image at this level
+        _NumberOfUpdates = 0;
+        _NumberOfGradientUpdates = 0;
+
+        // Run quasi-Newton or conjugate gradient optimizer at this resolution
+        if (this->UseOptimizer() == true) {
+            this->RunOptimizer(_affd);
+        }
+
         // Allocate memory for gradient vector
         gradient = new double[_affd->NumberOfDOFs()];
 
-        // Run the registration filter at this resolution
+        // Run the registration filter at this resolution, unless an irtkOptimizer2 has been run
         _CurrentIteration = 0;
-        while (_CurrentIteration < _NumberOfIterations[_CurrentLevel]) {
+        while ((this->UseOptimizer() == false) && (_CurrentIteration < _NumberOfIterations[_CurrentLevel])) {
             cout << "Iteration = " << _CurrentIteration + 1 << " (out of " << _NumberOfIterations[_CurrentLevel] << ")"<< endl;
 
+            // Draw new sample of target voxels
+            this->Sample();
+
             // Update source image
             this->Update(true);
 
@@ -1191,6 +1184,9 @@ void irtkImageFreeFormRegistration2::Run()
         // Delete gradient
         delete gradient;
 
+        // Print number of updates of the transformed source image
+        this->PrintNumberOfUpdates();
+
         // Do the final cleaning up for this level
         this->Finalize(_CurrentLevel);
     }
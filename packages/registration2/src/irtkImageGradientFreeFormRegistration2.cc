@@ -15,6 +15,7 @@ See LICENSE for details
 =========================================================================*/
 
 #include <irtkRegistration2.h>
+#include <irtkBSplineFreeFormTransformation3DIterator.h>
 
 #include <irtkGradientImageFilter.h>
 
@@ -325,15 +326,23 @@ void irtkImageGradientFreeFormRegistration2::UpdateSource()
   result3 = new double[3];
 
   double *ptr2disp = _displacementLUT;
-  double *ptr2latt = _latticeCoordLUT;
+  double *dx = new double[3*_target->GetX()];
+  double *dy = dx + _target->GetX();
+  double *dz = dy + _target->GetX();
+
+  // Local displacements are evaluated slice by slice and row by row
+  irtkBSplineFreeFormTransformation3DIterator iterator(_affd);
+  iterator.Initialize(_target);
+
   if ((_target->GetZ() == 1) && (_source->GetZ() == 1)) {
+    iterator.Slice(0);
     for (j = 0; j < _target->GetY(); j++) {
+      iterator.Row(j, dx, dy, dz);
       for (i = 0; i < _target->GetX(); i++) {
         if (_distanceMask.Get(i, j, 0) == 0) {
-          x = ptr2latt[0];
-		  y = ptr2latt[1];
+          x = dx[i];
+		  y = dy[i];
 		  z = 0;
-		  _affd->FFD2D(x, y);
 		  x += ptr2disp[0];
 		  y += ptr2disp[1];
 		  z += ptr2disp[2];
@@ -411,18 +420,18 @@ void irtkImageGradientFreeFormRegistration2::UpdateSource()
           _transformedNormalisedGradientSource(i, j, 0, 1) = -2;
         }
         ptr2disp += 3;
-        ptr2latt += 3;
       }
     }
   } else {
     for (k = 0; k < _target->GetZ(); k++) {
+      iterator.Slice(k);
       for (j = 0; j < _target->GetY(); j++) {
+        iterator.Row(j, dx, dy, dz);
         for (i = 0; i < _target->GetX(); i++) {
           if (_distanceMask.Get(i, j, k) == 0) {
-        	x = ptr2latt[0];
-			y = ptr2latt[1];
-			z = ptr2latt[2];
-			_affd->FFD3D(x, y, z);
+        	x = dx[i];
+			y = dy[i];
+			z = dz[i];
 			x += ptr2disp[0];
 			y += ptr2disp[1];
 			z += ptr2disp[2];
@@ -543,12 +552,12 @@ void irtkImageGradientFreeFormRegistration2::UpdateSource()
         	_transformedNormalisedGradientSource(i, j, k, 2) = -2;
           }
           ptr2disp += 3;
-		  ptr2latt += 3;
         }
       }
     }
   }
 
+  delete []dx;
   delete vector1;
   delete vector2;
   delete result1;
@@ -627,15 +636,23 @@ void irtkImageGradientFreeFormRegistration2::UpdateSourceAndGradient()
   result3_gradZ = new double[3];
 
   double *ptr2disp = _displacementLUT;
-  double *ptr2latt = _latticeCoordLUT;
+  double *dx = new double[3*_target->GetX()];
+  double *dy = dx + _target->GetX();
+  double *dz = dy + _target->GetX();
+
+  // Local displacements are evaluated slice by slice and row by row
+  irtkBSplineFreeFormTransformation3DIterator iterator(_affd);
+  iterator.Initialize(_target);
+
   if ((_target->GetZ() == 1) && (_source->GetZ() == 1)) {
+    iterator.Slice(0);
     for (j = 0; j < _target->GetY(); j++) {
+      iterator.Row(j, dx, dy, dz);
       for (i = 0; i < _target->GetX(); i++) {
         if (_distanceMask.Get(i, j, 0) == 0) {
-          x = ptr2latt[0];
-		  y = ptr2latt[1];
+          x = dx[i];
+		  y = dy[i];
 		  z = 0;
-		  _affd->FFD2D(x, y);
 		  x += ptr2disp[0];
 		  y += ptr2disp[1];
 		  z += ptr2disp[2];
@@ -785,18 +802,18 @@ void irtkImageGradientFreeFormRegistration2::UpdateSourceAndGradient()
 		  _transformedNormalisedGradientSourceGradient[1](i, j, 0, 1) = 0;
         }
         ptr2disp += 3;
-		ptr2latt += 3;
       }
     }
   } else {
     for (k = 0; k < _target->GetZ(); k++) {
+      iterator.Slice(k);
       for (j = 0; j < _target->GetY(); j++) {
+        iterator.Row(j, dx, dy, dz);
         for (i = 0; i < _target->GetX(); i++) {
           if (_distanceMask.Get(i, j, k) == 0) {
-        	x = ptr2latt[0];
-			y = ptr2latt[1];
-			z = ptr2latt[2];
-			_affd->FFD3D(x, y, z);
+        	x = dx[i];
+			y = dy[i];
+			z = dz[i];
 			x += ptr2disp[0];
 			y += ptr2disp[1];
 			z += ptr2disp[2];
@@ -1108,12 +1125,12 @@ void irtkImageGradientFreeFormRegistration2::UpdateSourceAndGradient()
 			_transformedNormalisedGradientSourceGradient[2](i, j, k, 2) = 0;
 		  }
           ptr2disp += 3;
-		  ptr2latt += 3;
         }
       }
     }
   }
 
+  delete []dx;
   delete vector1;
   delete vector2;
   delete result1;
@@ -1193,7 +1210,7 @@ void irtkImageGradientFreeFormRegistration2::EvaluateGradient2D(double *gradient
 
 void irtkImageGradientFreeFormRegistration2::EvaluateGradient3D(double *gradient)
 {
-    double basis, *ptr;
+    double basis, pos[3], m[3][4];
     int i, j, k, i1, i2, j1, j2, k1, k2, x, y, z, index, index2, index3;
 
     // Initialize gradient to zero
@@ -1201,6 +1218,14 @@ void irtkImageGradientFreeFormRegistration2::EvaluateGradient3D(double *gradient
         gradient[i] = 0;
     }
 
+    // Image to lattice coordinates
+    irtkMatrix matrix = _affd->_matW2L * _target->GetImageToWorldMatrix();
+    for (j = 0; j < 3; j++) {
+        for (i = 0; i < 4; i++) {
+            m[j][i] = matrix(j, i);
+        }
+    }
+
     // Loop over control points
     for (z = 0; z < _affd->GetZ(); z++) {
         for (y = 0; y < _affd->GetY(); y++) {
@@ -1223,12 +1248,15 @@ void irtkImageGradientFreeFormRegistration2::EvaluateGradient3D(double *gradient
                     //
                     for (k = k1; k <= k2; k++) {
                         for (j = j1; j <= j2; j++) {
-                            ptr = &(_latticeCoordLUT[3 * (k * (_target->GetX()*_target->GetY()) + j * _target->GetX() + i1)]);
+                            // Lattice coordinates of first voxel in row
+                            pos[0] = m[0][0] * i1 + m[0][1] * j + m[0][2] * k + m[0][3];
+                            pos[1] = m[1][0] * i1 + m[1][1] * j + m[1][2] * k + m[1][3];
+                            pos[2] = m[2][0] * i1 + m[2][1] * j + m[2][2] * k + m[2][3];
                             for (i = i1; i <= i2; i++) {
                                 // Check whether reference point is valid
                             	if ((_distanceMask(i, j, k) == 0) && (_transformedNormalisedGradientSource(i, j, k, 0) >= -1)) {
                                     // Compute B-spline tensor product at current position
-                                    basis = _affd->B(ptr[0] - x) * _affd->B(ptr[1] - y) * _affd->B(ptr[2] - z);
+                                    basis = _affd->B(pos[0] - x) * _affd->B(pos[1] - y) * _affd->B(pos[2] - z);
 
                                     // Convert voxel-based gradient into gradient with respect to parameters (chain rule)
                                     //
@@ -1238,7 +1266,9 @@ void irtkImageGradientFreeFormRegistration2::EvaluateGradient3D(double *gradient
                                     gradient[index2] += basis * _similarityGradient(i, j, k, 1);
                                     gradient[index3] += basis * _similarityGradient(i, j, k, 2);
                                 }
-                                ptr += 3;
+                                pos[0] += m[0][0];
+                                pos[1] += m[1][0];
+                                pos[2] += m[2][0];
                             }
                         }
                     }
@@ -1341,8 +1371,16 @@ double irtkImageGradientFreeFormRegistration2::EvaluateGradient(double *gradient
     this->EvaluateGradient3D(gradient);
   }
 
-  // Update gradient
-  if (_CurrentIteration == 0) {
+  if (this->_Lambda1 > 0) {
+    this->SmoothnessPenaltyGradient(gradient);
+  }
+
+  if (this->_Lambda2 > 0) {
+    this->VolumePreservationPenaltyGradient(gradient);
+  }
+
+  // Update gradient to be conjugate, unless the search direction is computed by an irtkOptimizer2
+  if ((this->UseOptimizer() == false) && (_CurrentIteration == 0)) {
     // First iteration, so let's initialize
     if (g != NULL) delete []g;
     g = new double [_affd->NumberOfDOFs()];
@@ -1352,7 +1390,7 @@ double irtkImageGradientFreeFormRegistration2::EvaluateGradient(double *gradient
       g[i] = -gradient[i];
       h[i] = g[i];
     }
-  } else {
+  } else if (this->UseOptimizer() == false) {
     // Update gradient direction to be conjugate
     gg = 0;
     dgg = 0;
@@ -1368,14 +1406,6 @@ double irtkImageGradientFreeFormRegistration2::EvaluateGradient(double *gradient
     }
   }
 
-  if (this->_Lambda1 > 0) {
-    this->SmoothnessPenaltyGradient(gradient);
-  }
-
-  if (this->_Lambda2 > 0) {
-    this->VolumePreservationPenaltyGradient(gradient);
-  }
-
   // Calculate maximum of gradient vector
   max_length = 0;
   for (z = 0; z < _affd->GetZ(); z++) {
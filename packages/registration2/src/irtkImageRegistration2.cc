@@ -28,39 +28,40 @@ See LICENSE for details
 
 #define MAX_NO_LINE_ITERATIONS 20
 
-extern irtkRealImage *tmp_target, *tmp_source;
-
-inline double GetBasisSplineValue(double x)
+// Linear congruential generator for the sampling of target voxels, returns value in [0, 1)
+static inline double irtkSamplingRandom(unsigned int &seed)
 {
-  x = fabs(x);
-  double value = 0.0;
-  if (x < 2.0) {
-    if (x < 1.0) {
-      value = (double)(2.0f/3.0f + (0.5f*x-1.0)*x*x);
-    } else {
-      x -= 2.0f;
-      value = -x*x*x/6.0f;
-    }
-  }
-  return value;
+  seed = seed * 1103515245 + 12345;
+  return ((seed >> 8) & 0xffffff) / 16777216.0;
 }
 
-inline double GetBasisSplineDerivativeValue(double x)
+// Number of cells of given size along each axis which contain voxels of the domain (mask value 0)
+static int irtkSamplingCells(irtkGreyImage &domain, int size)
 {
-  double y = fabs(x);
-  double value = 0.0;
-  if(y < 2.0) {
-    if(y < 1.0) {
-      value = (double)((1.5*y-2.0)*x);
-    }  else {
-      y -= 2.0;
-      value = -0.5 * y * y;
-      if(x < 0.0) value =-value;
+  int i, j, k, i0, j0, k0, count;
+  bool found;
+
+  count = 0;
+  for (k0 = 0; k0 < domain.GetZ(); k0 += size) {
+    for (j0 = 0; j0 < domain.GetY(); j0 += size) {
+      for (i0 = 0; i0 < domain.GetX(); i0 += size) {
+        found = false;
+        for (k = k0; (k < min(k0 + size, domain.GetZ())) && (found == false); k++) {
+          for (j = j0; (j < min(j0 + size, domain.GetY())) && (found == false); j++) {
+            for (i = i0; (i < min(i0 + size, domain.GetX())) && (found == false); i++) {
+              if (domain(i, j, k) == 0) found = true;
+            }
+          }
+        }
+        if (found == true) count++;
+      }
     }
   }
-  return value;
+  return count;
 }
 
+extern irtkRealImage *tmp_target, *tmp_source;
+
 irtkImageRegistration2::irtkImageRegistration2()
 {
   int i;
@@ -82,6 +83,9 @@ irtkImageRegistration2::irtkImageRegistration2()
     _NumberOfIterations[i] = 20;
     _MinStep[i]            = 0.01;
     _MaxStep[i]            = 1;
+
+    // Default parameters for sampling
+    _SamplingRatio[i]      = 1;
   }
 
   // Default parameters for registration
@@ -90,9 +94,19 @@ irtkImageRegistration2::irtkImageRegistration2()
 
   // Default parameters for optimization
   _SimilarityMeasure  = NMI;
+  _OptimizationMethod = GradientDescent;
   _InterpolationMode  = Interpolation_Linear;
   _Epsilon            = 0;
 
+  // Default parameters for sampling
+  _SamplingStrategy   = SamplingAll;
+  _SamplingSeed       = 1;
+  _SamplingCellSize   = 1;
+
+  // Default parameters for LNCC
+  _LocalWindowSize    = 5;
+  _LocalWindowType    = LocalWindowGaussian;
+
   // Default parameters for debugging
   _DebugFlag = false;
 
@@ -109,6 +123,7 @@ irtkImageRegistration2::irtkImageRegistration2()
 
   // Set metric
   _histogram = NULL;
+  _metric    = NULL;
 
   // Allocate interpolation object
   _interpolator = NULL;
@@ -259,13 +274,25 @@ void irtkImageRegistration2::Initialize(int level)
   //Compute distance mask image if necessary
   irtkPadding(*_target, _TargetPadding, &_distanceMask);
 
+  // Set up sampling of target voxels
+  this->InitializeSampling(level);
+
   if (_SourcePadding > MIN_GREY) {
     cout << "Source padding is " << _SourcePadding << endl;
   }
 
-  // Allocate memory for histogram if necessary
+  // Allocate memory for histogram and similarity metric if necessary
   switch (_SimilarityMeasure) {
     case SSD:
+      _metric = new irtkSSDSimilarityMetric2(_maxDiff);
+      break;
+    case CC:
+      _metric = new irtkCrossCorrelationSimilarityMetric2;
+      break;
+    case LNCC:
+      cout << "Local window is " << _LocalWindowSize << " mm" << endl;
+      _metric = new irtkLocalCrossCorrelationSimilarityMetric2(_LocalWindowSize, _LocalWindowType);
+      break;
     case NGP:
     case NGS:
       break;
@@ -275,11 +302,20 @@ void irtkImageRegistration2::Initialize(int level)
       //Create histogram
       cout << "Number of bins is " << _NumberOfBins << endl;
       _histogram = new irtkHistogram_2D<double>(_NumberOfBins, _NumberOfBins);
+      if (_SimilarityMeasure == MI) {
+        _metric = new irtkMutualInformationSimilarityMetric2(_histogram, _target_min, _target_max, _source_min, _source_max);
+      }
+      if (_SimilarityMeasure == NMI) {
+        _metric = new irtkNormalisedMutualInformationSimilarityMetric2(_histogram, _target_min, _target_max, _source_min, _source_max);
+      }
       break;
     default:
       cerr << this->NameOfClass() << "::Initialize(int): No such metric implemented" << endl;
       exit(1);
   }
+  if (_metric != NULL) {
+    _metric->SetInput(_target, &_transformedSource, &_distanceMask, _SourcePadding);
+  }
 
   // Compute spatial gradient of source image
   irtkGradientImageFilter<irtkRealPixel> gradient(irtkGradientImageFilter<irtkRealPixel>::GRADIENT_VECTOR);
@@ -355,6 +391,168 @@ void irtkImageRegistration2::Finalize(int level)
     delete _histogram;
     _histogram = NULL;
   }
+  if (_metric != NULL) {
+    delete _metric;
+    _metric = NULL;
+  }
+}
+
+void irtkImageRegistration2::InitializeSampling(int level)
+{
+  int i, n, count;
+  double ratio, sum, offset, p;
+
+  // Keep mask of all target voxels which can be used at this level
+  _domainMask = _distanceMask;
+
+  ratio = _SamplingRatio[level];
+  if ((_SamplingStrategy == SamplingAll) || (ratio >= 1)) return;
+
+  if (_SimilarityMeasure == LNCC) {
+    cerr << this->NameOfClass() << "::InitializeSampling: Sampling not supported for LNCC, using all voxels" << endl;
+    return;
+  }
+  if (ratio <= 0) {
+    cerr << this->NameOfClass() << "::InitializeSampling: Sampling ratio must be positive" << endl;
+    exit(1);
+  }
+
+  switch (_SamplingStrategy) {
+    case SamplingRandom:
+      cout << "Sampling " << ratio << " of target voxels at random" << endl;
+      break;
+    case SamplingStratified:
+      // The achieved ratio is the number of cells which contain target voxels
+      // over the number of target voxels, so only integer cell sizes whose
+      // ratio is closest to the requested one can be chosen
+      _SamplingCellSize = 1;
+      n = 0;
+      for (i = 0; i < _domainMask.GetNumberOfVoxels(); i++) {
+        if (_domainMask.GetPointerToVoxels()[i] == 0) n++;
+      }
+      if (n == 0) break;
+      p = 1;
+      while (p > ratio) {
+        count = irtkSamplingCells(_domainMask, _SamplingCellSize + 1);
+        if ((ratio - double(count) / n > p - ratio) || (_SamplingCellSize + 1 > max(_target->GetX(), max(_target->GetY(), _target->GetZ())))) break;
+        _SamplingCellSize++;
+        p = double(count) / n;
+      }
+      cout << "Sampling " << p << " of target voxels stratified (requested " << ratio << ")" << endl;
+      break;
+    case SamplingGradient:
+      // Samples are not weighted by the inverse of their probability, so
+      // regions of high gradient contribute more to the similarity
+      cout << "Sampling " << ratio << " of target voxels weighted by gradient" << endl;
+      break;
+    default:
+      break;
+  }
+
+  if (_SamplingStrategy == SamplingGradient) {
+    // Compute gradient magnitude of target image
+    irtkGradientImageFilter<irtkRealPixel> gradient(irtkGradientImageFilter<irtkRealPixel>::GRADIENT_MAGNITUDE);
+    irtkGenericImage<irtkRealPixel> tmp = *_target;
+    gradient.SetInput (&tmp);
+    gradient.SetOutput(&_samplingProbability);
+    gradient.SetPadding(_TargetPadding);
+    gradient.Run();
+
+    n = _target->GetNumberOfVoxels();
+    irtkGreyPixel *ptr2mask = _domainMask.GetPointerToVoxels();
+    irtkRealPixel *ptr2prob = _samplingProbability.GetPointerToVoxels();
+
+    count = 0;
+    sum   = 0;
+    for (i = 0; i < n; i++) {
+      if (ptr2mask[i] == 0) {
+        sum += ptr2prob[i];
+        count++;
+      }
+    }
+
+    // Add a fraction of the mean gradient magnitude, so that homogeneous regions are sampled as well
+    offset = (sum > 0) ? 0.1 * sum / count : 1;
+    sum   += offset * count;
+
+    // Probabilities such that the expected number of samples matches the sampling ratio
+    for (i = 0; i < n; i++) {
+      if (ptr2mask[i] == 0) {
+        p = ratio * count * (ptr2prob[i] + offset) / sum;
+        ptr2prob[i] = (p < 1) ? p : 1;
+      } else {
+        ptr2prob[i] = 0;
+      }
+    }
+  }
+}
+
+void irtkImageRegistration2::Sample()
+{
+  int i, j, k, i0, j0, k0, n, X, Y, Z, size, count, sample;
+  double ratio;
+
+  ratio = _SamplingRatio[_CurrentLevel];
+  if ((_SamplingStrategy == SamplingAll) || (ratio >= 1) || (_SimilarityMeasure == LNCC)) return;
+
+  IRTK_START_TIMING();
+
+  X = _target->GetX();
+  Y = _target->GetY();
+  Z = _target->GetZ();
+  n = X * Y * Z;
+
+  irtkGreyPixel *ptr2domain = _domainMask.GetPointerToVoxels();
+  irtkGreyPixel *ptr2mask   = _distanceMask.GetPointerToVoxels();
+
+  // Exclude all voxels which are not sampled below
+  for (i = 0; i < n; i++) {
+    ptr2mask[i] = 1;
+  }
+
+  switch (_SamplingStrategy) {
+    case SamplingRandom:
+      for (i = 0; i < n; i++) {
+        if ((ptr2domain[i] == 0) && (irtkSamplingRandom(_SamplingSeed) < ratio)) ptr2mask[i] = 0;
+      }
+      break;
+    case SamplingGradient: {
+      irtkRealPixel *ptr2prob = _samplingProbability.GetPointerToVoxels();
+      for (i = 0; i < n; i++) {
+        if ((ptr2domain[i] == 0) && (irtkSamplingRandom(_SamplingSeed) < ptr2prob[i])) ptr2mask[i] = 0;
+      }
+      break;
+    }
+    case SamplingStratified:
+      // Draw one voxel from the target voxels of each cell of a regular grid
+      size = _SamplingCellSize;
+      for (k0 = 0; k0 < Z; k0 += size) {
+        for (j0 = 0; j0 < Y; j0 += size) {
+          for (i0 = 0; i0 < X; i0 += size) {
+            count  = 0;
+            sample = -1;
+            for (k = k0; k < min(k0 + size, Z); k++) {
+              for (j = j0; j < min(j0 + size, Y); j++) {
+                for (i = i0; i < min(i0 + size, X); i++) {
+                  n = (k * Y + j) * X + i;
+                  if (ptr2domain[n] == 0) {
+                    // Replace sample with probability 1 / count, so that each voxel is equally likely
+                    count++;
+                    if (irtkSamplingRandom(_SamplingSeed) * count < 1) sample = n;
+                  }
+                }
+              }
+            }
+            if (sample >= 0) ptr2mask[sample] = 0;
+          }
+        }
+      }
+      break;
+    default:
+      break;
+  }
+
+  IRTK_END_TIMING("irtkImageRegistration2::Sample");
 }
 
 void irtkImageRegistration2::Update(bool updateGradient)
@@ -362,11 +560,62 @@ void irtkImageRegistration2::Update(bool updateGradient)
   // Update
   if (updateGradient == true) {
     this->UpdateSourceAndGradient();
+    _NumberOfGradientUpdates++;
   } else {
     this->UpdateSource();
+    _NumberOfUpdates++;
   }
 }
 
+double irtkImageRegistration2::EvaluateWithGradient(double *gradient)
+{
+  double similarity;
+
+  // Update source image and its gradient
+  this->Update(true);
+
+  // Compute current metric value and its gradient
+  similarity = this->Evaluate();
+  this->EvaluateGradient(gradient);
+
+  return similarity;
+}
+
+void irtkImageRegistration2::RunOptimizer(irtkTransformation *transformation)
+{
+  irtkOptimizer2 *optimizer;
+
+  switch (_OptimizationMethod) {
+  case ConjugateGradientDescent:
+    optimizer = new irtkConjugateGradientOptimizer2;
+    break;
+  case LimitedMemoryBFGS:
+    optimizer = new irtkLBFGSOptimizer2;
+    break;
+  default:
+    cerr << this->NameOfClass() << "::RunOptimizer: Unknown optimizer" << endl;
+    exit(1);
+  }
+  optimizer->SetTransformation(transformation);
+  optimizer->SetRegistration(this);
+  optimizer->SetMinStep(_MinStep[_CurrentLevel]);
+  optimizer->SetMaxStep(_MaxStep[_CurrentLevel]);
+  optimizer->SetEpsilon(_Epsilon);
+  optimizer->SetNumberOfIterations(_NumberOfIterations[_CurrentLevel]);
+
+  // The line search requires the same sample of target voxels for all steps
+  this->Sample();
+
+  optimizer->Run();
+  delete optimizer;
+}
+
+void irtkImageRegistration2::PrintNumberOfUpdates()
+{
+  cout << "Number of updates at resolution level no. " << _CurrentLevel+1 << " is " << _NumberOfUpdates + _NumberOfGradientUpdates
+       << " (" << _NumberOfGradientUpdates << " with gradient)" << endl;
+}
+
 void irtkImageRegistration2::Run()
 {
   int i, k;
@@ -413,14 +662,26 @@ void irtkImageRegistration2::Run()
     sprintf(buffer, "target_%d.nii.gz", _CurrentLevel);
     if (_DebugFlag == true) _target->Write(buffer);
 
+    // Count updates of the transformed source image at this level
+    _NumberOfUpdates = 0;
+    _NumberOfGradientUpdates = 0;
+
+    // Run quasi-Newton or conjugate gradient optimizer at this resolution
+    if (this->UseOptimizer() == true) {
+      this->RunOptimizer(_transformation);
+    }
+
     // Allocate memory for gradient vector
     gradient = new double[_transformation->NumberOfDOFs()];
 
-    // Run the registration filter at this resolution
+    // Run the registration filter at this resolution, unless an irtkOptimizer2 has been run
     _CurrentIteration = 0;
-    while (_CurrentIteration < _NumberOfIterations[_CurrentLevel]) {
+    while ((this->UseOptimizer() == false) && (_CurrentIteration < _NumberOfIterations[_CurrentLevel])) {
       cout << "Iteration = " << _CurrentIteration + 1 << " (out of " << _NumberOfIterations[_CurrentLevel] << ")"<< endl;
 
+      // Draw new sample of target voxels
+      this->Sample();
+
       // Update source image
       this->Update(true);
 
@@ -475,6 +736,9 @@ void irtkImageRegistration2::Run()
     // Delete gradient
     delete gradient;
 
+    // Print number of updates of the transformed source image
+    this->PrintNumberOfUpdates();
+
     // Do the final cleaning up for this level
     this->Finalize(_CurrentLevel);
   }
@@ -483,244 +747,22 @@ void irtkImageRegistration2::Run()
   this->Finalize();
 }
 
-double irtkImageRegistration2::EvaluateSSD()
-{
-  int i, n;
-  double norm, ssd;
-
-  // Print debugging information
-  this->Debug("irtkImageRegistration2::EvaluateSSD");
-
-  // Pointer to voxels in images
-  irtkRealPixel *ptr2target  = _target->GetPointerToVoxels();
-  irtkRealPixel *ptr2source  = _transformedSource.GetPointerToVoxels();
-  irtkGreyPixel  *ptr2mask    = _distanceMask.GetPointerToVoxels();
-
-  // Initialize metric
-  n = 0;
-  ssd = 0;
-
-  // Compute metric
-  for (i = 0; i < _target->GetNumberOfVoxels(); i++) {
-	if ((*ptr2mask == 0) && (*ptr2source > _SourcePadding)) {
-      ssd += (*ptr2target - *ptr2source) * (*ptr2target - *ptr2source);
-      n++;
-    }
-    ptr2target++;
-    ptr2source++;
-    ptr2mask++;
-  }
-
-  // Normalize similarity measure by number of voxels and maximum SSD
-  norm = 1.0 / ((double)n * (double)_maxDiff);
-
-  // Return similarity measure
-  if (norm > 0) {
-    return -ssd * norm;
-  } else {
-    cerr << "irtkImageRegistration2::EvaluateSSD: No samples available" << endl;
-    return 0;
-  }
-}
-
-double irtkImageRegistration2::EvaluateNMI()
-{
-  int i, targetBinValue, sourceBinValue;
-
-  // Print debugging information
-  this->Debug("irtkImageRegistration2::EvaluateNMI");
-
-  // Pointer to voxels in images
-  irtkRealPixel *ptr2target = _target->GetPointerToVoxels();
-  irtkRealPixel *ptr2source = _transformedSource.GetPointerToVoxels();
-  irtkGreyPixel  *ptr2mask   = _distanceMask.GetPointerToVoxels();
-
-  // Initialize metric
-  _histogram->Reset();
-
-  // Compute metric
-  for (i = 0; i < _target->GetNumberOfVoxels(); i++) {
-	if ((*ptr2mask == 0) && (*ptr2source > _SourcePadding)) {
-	  targetBinValue = irtkGetBinIndex(*ptr2target, _target_min, _target_max, _histogram->NumberOfBinsX());
-	  sourceBinValue = irtkGetBinIndex(*ptr2source, _source_min, _source_max, _histogram->NumberOfBinsY());
-      _histogram->Add(targetBinValue, sourceBinValue);
-    }
-    ptr2target++;
-    ptr2source++;
-    ptr2mask++;
-  }
-
-  // Smooth histogram if appropriate
-  _histogram->Smooth();
-
-  // Evaluate similarity measure
-  return _histogram->NormalizedMutualInformation();
-}
-
 double irtkImageRegistration2::Evaluate()
 {
   IRTK_START_TIMING();
 
   this->Debug("irtkImageRegistration2::Evaluate");
 
-  double metric;
-  switch (_SimilarityMeasure) {
-    case SSD:
-      metric = this->EvaluateSSD();
-      break;
-    case NMI:
-      metric = this->EvaluateNMI();
-      break;
-    default:
-      metric = 0;
-      cerr << this->NameOfClass() << "::Evaluate: No such metric implemented" << endl;
-      exit(1);
+  if (_metric == NULL) {
+    cerr << this->NameOfClass() << "::Evaluate: No such metric implemented" << endl;
+    exit(1);
   }
+  double metric = _metric->Evaluate();
 
   IRTK_END_TIMING("irtkImageRegistration2::Evaluate");
   return metric;
 }
 
-void irtkImageRegistration2::EvaluateGradientSSD()
-{
-  double ssd;
-  int i, j, k;
-
-  // Print debugging information
-  this->Debug("irtkImageRegistration2::EvaluateGradient");
-
-  // Pointer to voxels in images
-  irtkRealPixel *ptr2target = _target->GetPointerToVoxels();
-  irtkRealPixel *ptr2source = _transformedSource.GetPointerToVoxels();
-  irtkGreyPixel  *ptr2mask   = _distanceMask.GetPointerToVoxels();
-
-  // Compute gradient
-  for (k = 0; k < _target->GetZ(); k++) {
-    for (j = 0; j < _target->GetY(); j++) {
-      for (i = 0; i < _target->GetX(); i++) {
-    	if ((*ptr2mask == 0) && (*ptr2source > _SourcePadding)) {
-          ssd = 2 * (*ptr2target - *ptr2source) / _maxDiff;
-          _similarityGradient(i, j, k, 0) = ssd * _transformedSourceGradient(i, j, k, 0);
-          _similarityGradient(i, j, k, 1) = ssd * _transformedSourceGradient(i, j, k, 1);
-          _similarityGradient(i, j, k, 2) = ssd * _transformedSourceGradient(i, j, k, 2);
-        } else {
-          _similarityGradient(i, j, k, 0) = 0;
-          _similarityGradient(i, j, k, 1) = 0;
-          _similarityGradient(i, j, k, 2) = 0;
-        }
-        ptr2target++;
-        ptr2source++;
-        ptr2mask++;
-      }
-    }
-  }
-}
-
-void irtkImageRegistration2::EvaluateGradientNMI()
-{
-  int i, j, k, l, t, r;
-  double w, je, nmi, tmp, targetEntropyGrad[3], sourceEntropyGrad[3], jointEntropyGrad[3];
-
-  //Compute constant values
-  je  = _histogram->JointEntropy();
-  nmi = _histogram->NormalizedMutualInformation();
-
-  // Allocate new histograms
-  irtkHistogram_1D<double> logMarginalXHistogram(_histogram->NumberOfBinsX());
-  irtkHistogram_1D<double> logMarginalYHistogram(_histogram->NumberOfBinsY());
-  irtkHistogram_2D<double> logJointHistogram(_histogram->NumberOfBinsX(), _histogram->NumberOfBinsY());
-
-  // Recompute joint histogram
-  for (j = 0; j < _histogram->NumberOfBinsY(); j++) {
-    for (i = 0; i < _histogram->NumberOfBinsX(); i++) {
-      logJointHistogram.Add(i, j, (double)_histogram->irtkHistogram_2D<double>::operator()(i, j));
-    }
-  }
-
-  // Recompute marginal histogram for X
-  for (i = 0; i < _histogram->NumberOfBinsX(); i++) {
-    for (j = 0; j < _histogram->NumberOfBinsY(); j++) {
-      logMarginalXHistogram.Add(i, (double)_histogram->irtkHistogram_2D<double>::operator()(i, j));
-    }
-  }
-  // Recompute marginal histogram for Y
-  for (j = 0; j < _histogram->NumberOfBinsY(); j++) {
-    for (i = 0; i < _histogram->NumberOfBinsX(); i++) {
-      logMarginalYHistogram.Add(j, (double)_histogram->irtkHistogram_2D<double>::operator()(i, j));
-    }
-  }
-
-  // Log transform histograms
-  logJointHistogram.Log();
-  logMarginalXHistogram.Log();
-  logMarginalYHistogram.Log();
-
-  // Pointer to voxels in images
-  irtkRealPixel *ptr2target = _target->GetPointerToVoxels();
-  irtkRealPixel *ptr2source = _transformedSource.GetPointerToVoxels();
-  irtkGreyPixel  *ptr2mask   = _distanceMask.GetPointerToVoxels();
-
-  // Loop over images
-  for (k = 0; k < _target->GetZ(); k++) {
-    for (j = 0; j < _target->GetY(); j++) {
-      for (i = 0; i < _target->GetX(); i++) {
-
-        // This code is based on an idea from Marc Modat for computing the NMI derivative as suggested in his niftyreg package
-    	if ((*ptr2mask == 0) && (*ptr2source > _SourcePadding)) {
-    	  int targetBinValue = irtkGetBinIndex(*ptr2target, _target_min, _target_max, _histogram->NumberOfBinsX());
-    	  int sourceBinValue = irtkGetBinIndex(*ptr2source, _source_min, _source_max, _histogram->NumberOfBinsY());
-
-          for (l = 0; l < 3; l++) {
-            jointEntropyGrad [l] = 0;
-            targetEntropyGrad[l] = 0;
-            sourceEntropyGrad[l] = 0;
-          }
-
-          for (t = targetBinValue-1; t <= targetBinValue+1; t++) {
-            if ((t >= 0) && (t < _histogram->NumberOfBinsX())) {
-              for (r = sourceBinValue-1; r <= sourceBinValue+1; r++) {
-                if ((r >= 0) && (r < _histogram->NumberOfBinsY())) {
-                  w = GetBasisSplineValue((double)t-(double)targetBinValue) * GetBasisSplineDerivativeValue((double)r-(double)sourceBinValue);
-
-                  double jointLog  = logJointHistogram(t, r);
-                  double targetLog = logMarginalXHistogram(t);
-                  double resultLog = logMarginalYHistogram(r);
-
-                  tmp = -w * _transformedSourceGradient(i, j, k, 0);
-                  jointEntropyGrad[0]  -= tmp * jointLog;
-                  targetEntropyGrad[0] -= tmp * targetLog;
-                  sourceEntropyGrad[0] -= tmp * resultLog;
-
-                  tmp = -w * _transformedSourceGradient(i, j, k, 1);
-                  jointEntropyGrad[1]  -= tmp * jointLog;
-                  targetEntropyGrad[1] -= tmp * targetLog;
-                  sourceEntropyGrad[1] -= tmp * resultLog;
-
-                  tmp = -w * _transformedSourceGradient(i, j, k, 2);
-                  jointEntropyGrad[2]  -= tmp * jointLog;
-                  targetEntropyGrad[2] -= tmp * targetLog;
-                  sourceEntropyGrad[2] -= tmp * resultLog;
-                }
-              }
-            }
-          }
-
-          _similarityGradient(i, j, k, 0) = ((targetEntropyGrad[0] + sourceEntropyGrad[0] - nmi * jointEntropyGrad[0]) / je);
-          _similarityGradient(i, j, k, 1) = ((targetEntropyGrad[1] + sourceEntropyGrad[1] - nmi * jointEntropyGrad[1]) / je);
-          _similarityGradient(i, j, k, 2) = ((targetEntropyGrad[2] + sourceEntropyGrad[2] - nmi * jointEntropyGrad[2]) / je);
-        } else {
-          _similarityGradient(i, j, k, 0) = 0;
-          _similarityGradient(i, j, k, 1) = 0;
-          _similarityGradient(i, j, k, 2) = 0;
-        }
-        ptr2target++;
-        ptr2source++;
-        ptr2mask++;
-      }
-    }
-  }
-}
-
 double irtkImageRegistration2::EvaluateGradient(double *)
 {
   int i, j, k;
@@ -728,22 +770,12 @@ double irtkImageRegistration2::EvaluateGradient(double *)
 
   IRTK_START_TIMING();
 
-  char buffer[500];
-
-  // Allocate memory for metric
-  switch (_SimilarityMeasure) {
-    case SSD:
-      this->EvaluateGradientSSD();
-      sprintf(buffer, "/homes/sp2010/biomedic/debug/similarityGrad_SSD_%d_%d.nii.gz", _CurrentLevel, _CurrentIteration);
-      break;
-    case NMI:
-      this->EvaluateGradientNMI();
-      sprintf(buffer, "/homes/sp2010/biomedic/debug/similarityGrad_NMI_%d_%d.nii.gz", _CurrentLevel, _CurrentIteration);
-      break;
-    default:
-      cerr << this->NameOfClass() << "::Evaluate: No such metric implemented" << endl;
-      exit(1);
+  // Compute voxel-wise gradient of metric
+  if (_metric == NULL) {
+    cerr << this->NameOfClass() << "::EvaluateGradient: No such metric implemented" << endl;
+    exit(1);
   }
+  _metric->EvaluateGradient(&_transformedSourceGradient, &_similarityGradient);
 
 
   // Extract matrix for reorientation of gradient
@@ -771,8 +803,6 @@ double irtkImageRegistration2::EvaluateGradient(double *)
     }
   }
 
-  //_similarityGradient.Write(buffer);
-
   IRTK_END_TIMING("irtkImageRegistration2::EvaluateGradient()");
 
   // This function always returns 0
@@ -921,8 +951,24 @@ bool irtkImageRegistration2::Read(char *buffer1, char *buffer2, int &level)
     this->_SourcePadding = atof(buffer2);
     ok = true;
   }
+  if (strstr(buffer1, "Local window size (in mm)") != NULL) {
+    this->_LocalWindowSize = atof(buffer2);
+    ok = true;
+  }
+  if (strstr(buffer1, "Local window type") != NULL) {
+    if (strstr(buffer2, "Box") != NULL) {
+      this->_LocalWindowType = LocalWindowBox;
+      ok = true;
+    } else if (strstr(buffer2, "Gaussian") != NULL) {
+      this->_LocalWindowType = LocalWindowGaussian;
+      ok = true;
+    }
+  }
   if (strstr(buffer1, "Similarity measure") != NULL) {
-    if (strstr(buffer2, "CC") != NULL) {
+    if (strstr(buffer2, "LNCC") != NULL) {
+      this->_SimilarityMeasure = LNCC;
+      ok = true;
+    } else if (strstr(buffer2, "CC") != NULL) {
       this->_SimilarityMeasure = CC;
       ok = true;
     } else {
@@ -1014,6 +1060,55 @@ bool irtkImageRegistration2::Read(char *buffer1, char *buffer2, int &level)
     }
   }
 
+  if (strstr(buffer1, "Sampling strategy") != NULL) {
+    if (strstr(buffer2, "Random") != NULL) {
+      this->_SamplingStrategy = SamplingRandom;
+      ok = true;
+    } else {
+      if (strstr(buffer2, "Stratified") != NULL) {
+        this->_SamplingStrategy = SamplingStratified;
+        ok = true;
+      } else {
+        if (strstr(buffer2, "Gradient") != NULL) {
+          this->_SamplingStrategy = SamplingGradient;
+          ok = true;
+        } else {
+          if (strstr(buffer2, "All") != NULL) {
+            this->_SamplingStrategy = SamplingAll;
+            ok = true;
+          }
+        }
+      }
+    }
+  }
+  if (strstr(buffer1, "Sampling ratio") != NULL) {
+    if (level == -1) {
+      for (i = 0; i < MAX_NO_RESOLUTIONS; i++) {
+        this->_SamplingRatio[i] = atof(buffer2);
+      }
+    } else {
+      this->_SamplingRatio[level] = atof(buffer2);
+    }
+    ok = true;
+  }
+
+  if (strstr(buffer1, "Optimization method") != NULL) {
+    if (strstr(buffer2, "LimitedMemoryBFGS") != NULL) {
+      this->_OptimizationMethod = LimitedMemoryBFGS;
+      ok = true;
+    } else {
+      if (strstr(buffer2, "ConjugateGradientDescent") != NULL) {
+        this->_OptimizationMethod = ConjugateGradientDescent;
+        ok = true;
+      } else {
+        if (strstr(buffer2, "GradientDescent") != NULL) {
+          this->_OptimizationMethod = GradientDescent;
+          ok = true;
+        }
+      }
+    }
+  }
+
   if (ok == false) {
     cerr << "irtkImageRegistration2::Read: Can't parse line " << buffer1 << endl;
     exit(1);
@@ -1070,6 +1165,17 @@ void irtkImageRegistration2::Write(ostream &to)
     case NGS:
       to << "Similarity measure                = NGS" << endl;
       break;
+    case LNCC:
+      to << "Similarity measure                = LNCC" << endl;
+      break;
+  }
+  if (this->_SimilarityMeasure == LNCC) {
+    to << "Local window size (in mm)         = " << this->_LocalWindowSize << endl;
+    if (this->_LocalWindowType == LocalWindowBox) {
+      to << "Local window type                 = Box" << endl;
+    } else {
+      to << "Local window type                 = Gaussian" << endl;
+    }
   }
 
   switch (this->_InterpolationMode) {
@@ -1096,6 +1202,33 @@ void irtkImageRegistration2::Write(ostream &to)
       exit(1);
   }
 
+  switch (this->_OptimizationMethod) {
+    case ConjugateGradientDescent:
+      to << "Optimization method               = ConjugateGradientDescent" << endl;
+      break;
+    case LimitedMemoryBFGS:
+      to << "Optimization method               = LimitedMemoryBFGS" << endl;
+      break;
+    default:
+      to << "Optimization method               = GradientDescent" << endl;
+      break;
+  }
+
+  switch (this->_SamplingStrategy) {
+    case SamplingRandom:
+      to << "Sampling strategy                 = Random" << endl;
+      break;
+    case SamplingStratified:
+      to << "Sampling strategy                 = Stratified" << endl;
+      break;
+    case SamplingGradient:
+      to << "Sampling strategy                 = Gradient" << endl;
+      break;
+    default:
+      to << "Sampling strategy                 = All" << endl;
+      break;
+  }
+
   for (i = 0; i < this->_NumberOfLevels; i++) {
     to << "\n#\n# Registration parameters for resolution level " << i+1 << "\n#\n\n";
     to << "Resolution level                  = " << i+1 << endl;
@@ -1106,6 +1239,7 @@ void irtkImageRegistration2::Write(ostream &to)
     to << "No. of iterations                 = " << this->_NumberOfIterations[i] << endl;
     to << "Minimum length of steps           = " << this->_MinStep[i] << endl;
     to << "Maximum length of steps           = " << this->_MaxStep[i] << endl;
+    to << "Sampling ratio                    = " << this->_SamplingRatio[i] << endl;
   }
 }
 
@@ -472,8 +472,8 @@ double irtkImageRigidRegistration2::EvaluateGradient(double *gradient)
     }
   }
 
-  // Update gradient
-  if (_CurrentIteration == 0) {
+  // Update gradient to be conjugate, unless the search direction is computed by an irtkOptimizer2
+  if ((this->UseOptimizer() == false) && (_CurrentIteration == 0)) {
     // First iteration, so let's initialize
     if (g != NULL) delete []g;
     g = new double [_transformation->NumberOfDOFs()];
@@ -483,7 +483,7 @@ double irtkImageRigidRegistration2::EvaluateGradient(double *gradient)
       g[i] = -gradient[i];
       h[i] = g[i];
     }
-  } else {
+  } else if (this->UseOptimizer() == false) {
     // Update gradient direction to be conjugate
     gg = 0;
     dgg = 0;
@@ -0,0 +1,337 @@
+/*=========================================================================
+
+  Library   : Image Registration Toolkit (IRTK)
+  Module    : $Id$
+  Copyright : Imperial College, Department of Computing
+              Visual Information Processing (VIP), 2009 onwards
+  Date      : $Date$
+  Version   : $Revision$
+  Changes   : $Author$
+
+Copyright (c) 1999-2014 and onwards, Imperial College London
+All rights reserved.
+See LICENSE for details
+
+=========================================================================*/
+
+#include <irtkRegistration2.h>
+
+inline double GetBasisSplineValue(double x)
+{
+  x = fabs(x);
+  double value = 0.0;
+  if (x < 2.0) {
+    if (x < 1.0) {
+      value = (double)(2.0f/3.0f + (0.5f*x-1.0)*x*x);
+    } else {
+      x -= 2.0f;
+      value = -x*x*x/6.0f;
+    }
+  }
+  return value;
+}
+
+inline double GetBasisSplineDerivativeValue(double x)
+{
+  double y = fabs(x);
+  double value = 0.0;
+  if(y < 2.0) {
+    if(y < 1.0) {
+      value = (double)((1.5*y-2.0)*x);
+    }  else {
+      y -= 2.0;
+      value = -0.5 * y * y;
+      if(x < 0.0) value =-value;
+    }
+  }
+  return value;
+}
+
+class irtkMultiThreadedJointHistogramNMIEvaluate
+{
+
+  irtkRealPixel *_target;
+  irtkRealPixel *_source;
+  irtkGreyPixel *_mask;
+  double _padding;
+  double _target_min, _target_max;
+  double _source_min, _source_max;
+
+public:
+
+  irtkHistogram_2D<double> _histogram;
+
+  void operator()(const blocked_range<int> &r) {
+    int i, targetBinValue, sourceBinValue;
+
+    for (i = r.begin(); i != r.end(); i++) {
+      if (((_mask == NULL) || (_mask[i] == 0)) && (_source[i] > _padding)) {
+        targetBinValue = irtkGetBinIndex(_target[i], _target_min, _target_max, _histogram.NumberOfBinsX());
+        sourceBinValue = irtkGetBinIndex(_source[i], _source_min, _source_max, _histogram.NumberOfBinsY());
+        _histogram.Add(targetBinValue, sourceBinValue);
+      }
+    }
+  }
+
+  irtkMultiThreadedJointHistogramNMIEvaluate(irtkMultiThreadedJointHistogramNMIEvaluate &x, split) :
+    _histogram(x._histogram.NumberOfBinsX(), x._histogram.NumberOfBinsY())
+  {
+    _target     = x._target;
+    _source     = x._source;
+    _mask       = x._mask;
+    _padding    = x._padding;
+    _target_min = x._target_min;
+    _target_max = x._target_max;
+    _source_min = x._source_min;
+    _source_max = x._source_max;
+  }
+
+  void join(const irtkMultiThreadedJointHistogramNMIEvaluate &y) {
+    int i, j;
+
+    for (j = 0; j < _histogram.NumberOfBinsY(); j++) {
+      for (i = 0; i < _histogram.NumberOfBinsX(); i++) {
+        if (y._histogram(i, j) > 0) _histogram.Add(i, j, y._histogram(i, j));
+      }
+    }
+  }
+
+  irtkMultiThreadedJointHistogramNMIEvaluate(irtkHistogram_2D<double> *histogram, irtkRealImage *target, irtkRealImage *source, irtkGreyImage *mask,
+      double padding, double target_min, double target_max, double source_min, double source_max) :
+    _histogram(*histogram)
+  {
+    _target     = target->GetPointerToVoxels();
+    _source     = source->GetPointerToVoxels();
+    _mask       = (mask != NULL) ? mask->GetPointerToVoxels() : NULL;
+    _padding    = padding;
+    _target_min = target_min;
+    _target_max = target_max;
+    _source_min = source_min;
+    _source_max = source_max;
+    _histogram.Reset();
+  }
+
+  // execute
+  void operator()(int n) {
+    task_scheduler_init init(tbb_no_threads);
+    parallel_reduce(blocked_range<int>(0, n), *this);
+    init.terminate();
+  }
+
+};
+
+class irtkMultiThreadedJointHistogramNMIGradient
+{
+
+  irtkRealImage *_target;
+  irtkRealImage *_source;
+  irtkGreyImage *_mask;
+  irtkRealImage *_sourceGradient;
+  irtkRealImage *_similarityGradient;
+  double _padding;
+  double _target_min, _target_max;
+  double _source_min, _source_max;
+  double _je, _nmi;
+  int _nbins_x, _nbins_y;
+
+  irtkHistogram_1D<double> *_logMarginalXHistogram;
+  irtkHistogram_1D<double> *_logMarginalYHistogram;
+  irtkHistogram_2D<double> *_logJointHistogram;
+
+  /// Parzen window weights for bin offsets -1, 0, +1 in target and source
+  double _w[3][3];
+
+public:
+
+  irtkMultiThreadedJointHistogramNMIGradient(irtkHistogram_2D<double> *logJointHistogram,
+      irtkHistogram_1D<double> *logMarginalXHistogram, irtkHistogram_1D<double> *logMarginalYHistogram,
+      double je, double nmi, irtkRealImage *target, irtkRealImage *source, irtkGreyImage *mask, double padding,
+      double target_min, double target_max, double source_min, double source_max,
+      irtkRealImage *sourceGradient, irtkRealImage *similarityGradient)
+  {
+    int t, r;
+
+    _logJointHistogram     = logJointHistogram;
+    _logMarginalXHistogram = logMarginalXHistogram;
+    _logMarginalYHistogram = logMarginalYHistogram;
+    _nbins_x = logJointHistogram->NumberOfBinsX();
+    _nbins_y = logJointHistogram->NumberOfBinsY();
+    _je  = je;
+    _nmi = nmi;
+    _target = target;
+    _source = source;
+    _mask   = mask;
+    _padding    = padding;
+    _target_min = target_min;
+    _target_max = target_max;
+    _source_min = source_min;
+    _source_max = source_max;
+    _sourceGradient     = sourceGradient;
+    _similarityGradient = similarityGradient;
+
+    for (t = -1; t <= 1; t++) {
+      for (r = -1; r <= 1; r++) {
+        _w[t+1][r+1] = GetBasisSplineValue((double)t) * GetBasisSplineDerivativeValue((double)r);
+      }
+    }
+  }
+
+  void operator()(const blocked_range<int> &range) const {
+    int i, j, k, l, n, t, r;
+    double w, tmp, targetEntropyGrad[3], sourceEntropyGrad[3], jointEntropyGrad[3];
+
+    for (n = range.begin(); n != range.end(); n++) {
+      j = n % _target->GetY();
+      k = n / _target->GetY();
+
+      irtkRealPixel *ptr2target = _target->GetPointerToVoxels(0, j, k);
+      irtkRealPixel *ptr2source = _source->GetPointerToVoxels(0, j, k);
+      irtkGreyPixel *ptr2mask   = (_mask != NULL) ? _mask->GetPointerToVoxels(0, j, k) : NULL;
+      irtkRealPixel *ptr2grad[3], *ptr2sim[3];
+      for (l = 0; l < 3; l++) {
+        ptr2grad[l] = _sourceGradient    ->GetPointerToVoxels(0, j, k, l);
+        ptr2sim [l] = _similarityGradient->GetPointerToVoxels(0, j, k, l);
+      }
+
+      for (i = 0; i < _target->GetX(); i++) {
+
+        // This code is based on an idea from Marc Modat for computing the NMI derivative as suggested in his niftyreg package
+        if (((ptr2mask == NULL) || (ptr2mask[i] == 0)) && (ptr2source[i] > _padding)) {
+          int targetBinValue = irtkGetBinIndex(ptr2target[i], _target_min, _target_max, _nbins_x);
+          int sourceBinValue = irtkGetBinIndex(ptr2source[i], _source_min, _source_max, _nbins_y);
+
+          for (l = 0; l < 3; l++) {
+            jointEntropyGrad [l] = 0;
+            targetEntropyGrad[l] = 0;
+            sourceEntropyGrad[l] = 0;
+          }
+
+          for (t = targetBinValue-1; t <= targetBinValue+1; t++) {
+            if ((t >= 0) && (t < _nbins_x)) {
+              for (r = sourceBinValue-1; r <= sourceBinValue+1; r++) {
+                if ((r >= 0) && (r < _nbins_y)) {
+                  w = _w[t-targetBinValue+1][r-sourceBinValue+1];
+
+                  double jointLog  = (*_logJointHistogram)(t, r);
+                  double targetLog = (*_logMarginalXHistogram)(t);
+                  double resultLog = (*_logMarginalYHistogram)(r);
+
+                  for (l = 0; l < 3; l++) {
+                    tmp = -w * ptr2grad[l][i];
+                    jointEntropyGrad[l]  -= tmp * jointLog;
+                    targetEntropyGrad[l] -= tmp * targetLog;
+                    sourceEntropyGrad[l] -= tmp * resultLog;
+                  }
+                }
+              }
+            }
+          }
+
+          for (l = 0; l < 3; l++) {
+            ptr2sim[l][i] = ((targetEntropyGrad[l] + sourceEntropyGrad[l] - _nmi * jointEntropyGrad[l]) / _je);
+          }
+        } else {
+          for (l = 0; l < 3; l++) ptr2sim[l][i] = 0;
+        }
+      }
+    }
+  }
+
+  // execute
+  void operator()() const {
+    task_scheduler_init init(tbb_no_threads);
+    parallel_for(blocked_range<int>(0, _target->GetY() * _target->GetZ()), *this);
+    init.terminate();
+  }
+
+};
+
+irtkJointHistogramNMI::irtkJointHistogramNMI(irtkHistogram_2D<double> *histogram, irtkRealImage *target, irtkRealImage *source,
+    irtkGreyImage *mask, double padding, double target_min, double target_max, double source_min, double source_max)
+{
+  _histogram  = histogram;
+  _target     = target;
+  _source     = source;
+  _mask       = mask;
+  _padding    = padding;
+  _target_min = target_min;
+  _target_max = target_max;
+  _source_min = source_min;
+  _source_max = source_max;
+}
+
+double irtkJointHistogramNMI::Evaluate()
+{
+  // Fill thread-local histograms and merge them
+  irtkMultiThreadedJointHistogramNMIEvaluate evaluate(_histogram, _target, _source, _mask, _padding,
+      _target_min, _target_max, _source_min, _source_max);
+  evaluate(_target->GetNumberOfVoxels());
+  _histogram->Reset(evaluate._histogram);
+
+  // Smooth histogram if appropriate
+  _histogram->Smooth();
+
+  // Evaluate similarity measure
+  return _histogram->NormalizedMutualInformation();
+}
+
+void irtkJointHistogramNMI::EvaluateGradient(irtkRealImage *sourceGradient, irtkRealImage *similarityGradient)
+{
+  this->EvaluateGradient(sourceGradient, similarityGradient, true);
+}
+
+void irtkJointHistogramNMI::EvaluateGradientMI(irtkRealImage *sourceGradient, irtkRealImage *similarityGradient)
+{
+  this->EvaluateGradient(sourceGradient, similarityGradient, false);
+}
+
+void irtkJointHistogramNMI::EvaluateGradient(irtkRealImage *sourceGradient, irtkRealImage *similarityGradient, bool normalized)
+{
+  int i, j;
+  double je, nmi;
+
+  //Compute constant values, for MI the joint entropy gradient is not weighted
+  if (normalized == true) {
+    je  = _histogram->JointEntropy();
+    nmi = _histogram->NormalizedMutualInformation();
+  } else {
+    je  = 1;
+    nmi = 1;
+  }
+
+  // Allocate new histograms
+  irtkHistogram_1D<double> logMarginalXHistogram(_histogram->NumberOfBinsX());
+  irtkHistogram_1D<double> logMarginalYHistogram(_histogram->NumberOfBinsY());
+  irtkHistogram_2D<double> logJointHistogram(_histogram->NumberOfBinsX(), _histogram->NumberOfBinsY());
+
+  // Recompute joint histogram
+  for (j = 0; j < _histogram->NumberOfBinsY(); j++) {
+    for (i = 0; i < _histogram->NumberOfBinsX(); i++) {
+      logJointHistogram.Add(i, j, (double)_histogram->irtkHistogram_2D<double>::operator()(i, j));
+    }
+  }
+
+  // Recompute marginal histogram for X
+  for (i = 0; i < _histogram->NumberOfBinsX(); i++) {
+    for (j = 0; j < _histogram->NumberOfBinsY(); j++) {
+      logMarginalXHistogram.Add(i, (double)_histogram->irtkHistogram_2D<double>::operator()(i, j));
+    }
+  }
+  // Recompute marginal histogram for Y
+  for (j = 0; j < _histogram->NumberOfBinsY(); j++) {
+    for (i = 0; i < _histogram->NumberOfBinsX(); i++) {
+      logMarginalYHistogram.Add(j, (double)_histogram->irtkHistogram_2D<double>::operator()(i, j));
+    }
+  }
+
+  // Log transform histograms
+  logJointHistogram.Log();
+  logMarginalXHistogram.Log();
+  logMarginalYHistogram.Log();
+
+  // Evaluate gradient for all voxels
+  irtkMultiThreadedJointHistogramNMIGradient gradient(&logJointHistogram, &logMarginalXHistogram, &logMarginalYHistogram,
+      je, nmi, _target, _source, _mask, _padding, _target_min, _target_max, _source_min, _source_max,
+      sourceGradient, similarityGradient);
+  gradient();
+}
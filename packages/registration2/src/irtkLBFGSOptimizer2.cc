@@ -0,0 +1,156 @@
+/*=========================================================================
+
+  Library   : Image Registration Toolkit (IRTK)
+  Module    : $Id$
+  Copyright : Imperial College, Department of Computing
+              Visual Information Processing (VIP), 2009 onwards
+  Date      : $Date$
+  Version   : $Revision$
+  Changes   : $Author$
+
+Copyright (c) 1999-2014 and onwards, Imperial College London
+All rights reserved.
+See LICENSE for details
+
+=========================================================================*/
+
+#include <irtkRegistration2.h>
+
+irtkLBFGSOptimizer2::irtkLBFGSOptimizer2()
+{
+  _Memory        = LBFGS_MEMORY;
+  _NumberOfSteps = 0;
+  _Last          = -1;
+  _S             = NULL;
+  _Y             = NULL;
+  _rho           = NULL;
+  _alpha         = NULL;
+}
+
+void irtkLBFGSOptimizer2::Initialize()
+{
+  int i;
+
+  // Initialize base class
+  this->irtkOptimizer2::Initialize();
+
+  if (_Memory < 1) {
+    cerr << "irtkLBFGSOptimizer2::Initialize: Number of kept steps must be at least 1" << endl;
+    exit(1);
+  }
+
+  _S     = new double *[_Memory];
+  _Y     = new double *[_Memory];
+  _rho   = new double[_Memory];
+  _alpha = new double[_Memory];
+  for (i = 0; i < _Memory; i++) {
+    _S[i] = new double[_NumberOfDOFs];
+    _Y[i] = new double[_NumberOfDOFs];
+  }
+}
+
+void irtkLBFGSOptimizer2::Finalize()
+{
+  int i;
+
+  for (i = 0; i < _Memory; i++) {
+    delete []_S[i];
+    delete []_Y[i];
+  }
+  delete []_S;
+  delete []_Y;
+  delete []_rho;
+  delete []_alpha;
+  _S     = NULL;
+  _Y     = NULL;
+  _rho   = NULL;
+  _alpha = NULL;
+
+  // Finalize base class
+  this->irtkOptimizer2::Finalize();
+}
+
+void irtkLBFGSOptimizer2::ComputeDirection()
+{
+  int i, j, k;
+  double gamma, beta, yy;
+
+  // Two-loop recursion for the negated gradient, which is minimised
+  for (i = 0; i < _NumberOfDOFs; i++) {
+    _direction[i] = -_gradient[i];
+  }
+  for (j = 0; j < _NumberOfSteps; j++) {
+    k = (_Last - j + _Memory) % _Memory;
+    _alpha[k] = 0;
+    for (i = 0; i < _NumberOfDOFs; i++) {
+      _alpha[k] += _S[k][i] * _direction[i];
+    }
+    _alpha[k] *= _rho[k];
+    for (i = 0; i < _NumberOfDOFs; i++) {
+      _direction[i] -= _alpha[k] * _Y[k][i];
+    }
+  }
+
+  // Scale initial inverse Hessian by curvature of most recent step
+  gamma = 1;
+  if (_NumberOfSteps > 0) {
+    yy = 0;
+    for (i = 0; i < _NumberOfDOFs; i++) {
+      yy += _Y[_Last][i] * _Y[_Last][i];
+    }
+    gamma = 1.0 / (_rho[_Last] * yy);
+  }
+  for (i = 0; i < _NumberOfDOFs; i++) {
+    _direction[i] *= gamma;
+  }
+
+  for (j = _NumberOfSteps - 1; j >= 0; j--) {
+    k = (_Last - j + _Memory) % _Memory;
+    beta = 0;
+    for (i = 0; i < _NumberOfDOFs; i++) {
+      beta += _Y[k][i] * _direction[i];
+    }
+    beta *= _rho[k];
+    for (i = 0; i < _NumberOfDOFs; i++) {
+      _direction[i] += (_alpha[k] - beta) * _S[k][i];
+    }
+  }
+
+  // Search direction increases the similarity
+  for (i = 0; i < _NumberOfDOFs; i++) {
+    _direction[i] = -_direction[i];
+  }
+}
+
+double irtkLBFGSOptimizer2::InitialStep(double)
+{
+  // Quasi-Newton step, otherwise maximum step length
+  return (_NumberOfSteps > 0) ? 1 : 0;
+}
+
+void irtkLBFGSOptimizer2::Reset()
+{
+  _NumberOfSteps = 0;
+  _Last          = -1;
+}
+
+void irtkLBFGSOptimizer2::Update(const double *s, const double *y)
+{
+  int i;
+  double sy;
+
+  // Skip steps without positive curvature
+  sy = 0;
+  for (i = 0; i < _NumberOfDOFs; i++) {
+    sy += s[i] * y[i];
+  }
+  if (sy <= 0) return;
+
+  _Last = (_Last + 1) % _Memory;
+  for (i = 0; i < _NumberOfDOFs; i++) {
+    _S[_Last][i] = s[i];
+    _Y[_Last][i] = y[i];
+  }
+  _rho[_Last] = 1.0 / sy;
+  if (_NumberOfSteps < _Memory) _NumberOfSteps++;
+}
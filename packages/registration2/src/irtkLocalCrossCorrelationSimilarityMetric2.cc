@@ -0,0 +1,297 @@
+/*=========================================================================
+
+  Library   : Image Registration Toolkit (IRTK)
+  Module    : $Id$
+  Copyright : Imperial College, Department of Computing
+              Visual Information Processing (VIP), 2009 onwards
+  Date      : $Date$
+  Version   : $Revision$
+  Changes   : $Author$
+
+Copyright (c) 1999-2014 and onwards, Imperial College London
+All rights reserved.
+See LICENSE for details
+
+=========================================================================*/
+
+#include <irtkRegistration2.h>
+
+#define LNCC_EPSILON 1e-6
+
+class irtkMultiThreadedLocalCrossCorrelationConvolution
+{
+
+  irtkRealPixel *_data;
+  double *_kernel;
+  int _radius;
+  int _dir;
+  int _nx, _ny, _nz;
+
+public:
+
+  irtkMultiThreadedLocalCrossCorrelationConvolution(irtkRealImage *image, double *kernel, int radius, int dir)
+  {
+    _data   = image->GetPointerToVoxels();
+    _kernel = kernel;
+    _radius = radius;
+    _dir    = dir;
+    _nx     = image->GetX();
+    _ny     = image->GetY();
+    _nz     = image->GetZ();
+  }
+
+  void operator()(const blocked_range<int> &r) const {
+    int i, k, l, n, offset, stride;
+    double value, *line;
+
+    // Length and stride of lines in direction of convolution
+    if (_dir == 0) {
+      n = _nx;
+      stride = 1;
+    } else if (_dir == 1) {
+      n = _ny;
+      stride = _nx;
+    } else {
+      n = _nz;
+      stride = _nx * _ny;
+    }
+    line = new double[n + 1];
+
+    for (l = r.begin(); l != r.end(); l++) {
+      if (_dir == 0) {
+        offset = l * _nx;
+      } else if (_dir == 1) {
+        offset = (l % _nx) + (l / _nx) * _nx * _ny;
+      } else {
+        offset = l;
+      }
+
+      irtkRealPixel *ptr = _data + offset;
+      for (i = 0; i < n; i++) line[i] = ptr[i * stride];
+
+      // Voxels outside the image do not contribute
+      if (_kernel == NULL) {
+        // Box window from running sums, independent of the window size
+        value = 0;
+        for (i = n; i > 0; i--) line[i] = line[i - 1];
+        line[0] = 0;
+        for (i = 1; i <= n; i++) {
+          value  += line[i];
+          line[i] = value;
+        }
+        for (i = 0; i < n; i++) {
+          ptr[i * stride] = line[(i + _radius + 1 < n) ? i + _radius + 1 : n] - line[(i - _radius > 0) ? i - _radius : 0];
+        }
+      } else {
+        for (i = 0; i < n; i++) {
+          value = 0;
+          for (k = ((i - _radius < 0) ? -i : -_radius); k <= _radius && i + k < n; k++) {
+            value += _kernel[k + _radius] * line[i + k];
+          }
+          ptr[i * stride] = value;
+        }
+      }
+    }
+
+    delete []line;
+  }
+
+  // execute
+  void operator()() const {
+    int n;
+
+    if (_dir == 0) {
+      n = _ny * _nz;
+    } else if (_dir == 1) {
+      n = _nx * _nz;
+    } else {
+      n = _nx * _ny;
+    }
+    task_scheduler_init init(tbb_no_threads);
+    parallel_for(blocked_range<int>(0, n), *this);
+    init.terminate();
+  }
+
+};
+
+void irtkLocalCrossCorrelationSimilarityMetric2::Convolve(irtkRealImage &image)
+{
+  int i, d, radius;
+  double ds[3], sigma, *kernel;
+
+  image.GetPixelSize(&ds[0], &ds[1], &ds[2]);
+
+  for (d = 0; d < 3; d++) {
+    if ((d == 2) && (image.GetZ() == 1)) break;
+
+    // Compute window in voxels along this direction
+    if (_WindowType == LocalWindowGaussian) {
+      sigma  = _WindowSize / ds[d];
+      radius = (int)ceil(3 * sigma);
+    } else {
+      sigma  = 0;
+      radius = round(_WindowSize / ds[d]);
+    }
+    if (radius < 1) continue;
+
+    // Box windows are summed without kernel
+    kernel = NULL;
+    if (_WindowType == LocalWindowGaussian) {
+      kernel = new double[2 * radius + 1];
+      for (i = -radius; i <= radius; i++) {
+        kernel[i + radius] = exp(-0.5 * i * i / (sigma * sigma));
+      }
+    }
+
+    irtkMultiThreadedLocalCrossCorrelationConvolution convolution(&image, kernel, radius, d);
+    convolution();
+
+    delete []kernel;
+  }
+}
+
+double irtkLocalCrossCorrelationSimilarityMetric2::ComputeStatistics(irtkRealImage &lncc)
+{
+  int i, n;
+  double m, t, s, w, sum;
+
+  // Statistics are computed for the first frame only
+  irtkImageAttributes attr = _target->GetImageAttributes();
+  attr._t = 1;
+  _w  .Initialize(attr);
+  _mt .Initialize(attr);
+  _ms .Initialize(attr);
+  _vt .Initialize(attr);
+  _vs .Initialize(attr);
+  _vts.Initialize(attr);
+  lncc.Initialize(attr);
+  n = _w.GetNumberOfVoxels();
+
+  // Pointer to voxels in images
+  irtkRealPixel *ptr2target = _target->GetPointerToVoxels();
+  irtkRealPixel *ptr2source = _source->GetPointerToVoxels();
+  irtkGreyPixel *ptr2mask   = (_mask != NULL) ? _mask->GetPointerToVoxels() : NULL;
+  irtkRealPixel *ptr2w      = _w  .GetPointerToVoxels();
+  irtkRealPixel *ptr2mt     = _mt .GetPointerToVoxels();
+  irtkRealPixel *ptr2ms     = _ms .GetPointerToVoxels();
+  irtkRealPixel *ptr2vt     = _vt .GetPointerToVoxels();
+  irtkRealPixel *ptr2vs     = _vs .GetPointerToVoxels();
+  irtkRealPixel *ptr2vts    = _vts.GetPointerToVoxels();
+  irtkRealPixel *ptr2lncc   = lncc.GetPointerToVoxels();
+
+  // Masked images and their products
+  _n = 0;
+  for (i = 0; i < n; i++) {
+    if (((ptr2mask == NULL) || (ptr2mask[i] == 0)) && (ptr2source[i] > _SourcePadding)) {
+      t = ptr2target[i];
+      s = ptr2source[i];
+      ptr2w  [i] = 1;
+      ptr2mt [i] = t;
+      ptr2ms [i] = s;
+      ptr2vt [i] = t * t;
+      ptr2vs [i] = s * s;
+      ptr2vts[i] = t * s;
+      _n++;
+    }
+  }
+
+  // Local sums
+  this->Convolve(_w);
+  this->Convolve(_mt);
+  this->Convolve(_ms);
+  this->Convolve(_vt);
+  this->Convolve(_vs);
+  this->Convolve(_vts);
+
+  // Local means, variances and correlation coefficients
+  sum = 0;
+  for (i = 0; i < n; i++) {
+    w = ptr2w[i];
+    if (w > 0) {
+      ptr2mt [i] /= w;
+      ptr2ms [i] /= w;
+      ptr2vt [i]  = ptr2vt [i] / w - ptr2mt[i] * ptr2mt[i];
+      ptr2vs [i]  = ptr2vs [i] / w - ptr2ms[i] * ptr2ms[i];
+      ptr2vts[i]  = ptr2vts[i] / w - ptr2mt[i] * ptr2ms[i];
+    }
+    m = (((ptr2mask == NULL) || (ptr2mask[i] == 0)) && (ptr2source[i] > _SourcePadding)) ? 1 : 0;
+    if ((m > 0) && (ptr2vt[i] > LNCC_EPSILON) && (ptr2vs[i] > LNCC_EPSILON)) {
+      ptr2lncc[i] = ptr2vts[i] / sqrt(ptr2vt[i] * ptr2vs[i]);
+      sum += ptr2lncc[i];
+    }
+  }
+
+  if (_n > 0) {
+    return sum / _n;
+  } else {
+    cerr << "irtkLocalCrossCorrelationSimilarityMetric2::Evaluate: No samples available" << endl;
+    return 0;
+  }
+}
+
+double irtkLocalCrossCorrelationSimilarityMetric2::Evaluate()
+{
+  irtkRealImage lncc;
+
+  return this->ComputeStatistics(lncc);
+}
+
+void irtkLocalCrossCorrelationSimilarityMetric2::EvaluateGradient(irtkRealImage *sourceGradient, irtkRealImage *similarityGradient)
+{
+  int i, l, n;
+  double a, b, grad;
+  irtkRealImage lncc;
+
+  this->ComputeStatistics(lncc);
+
+  // Pointer to voxels in images
+  irtkRealPixel *ptr2target = _target->GetPointerToVoxels();
+  irtkRealPixel *ptr2source = _source->GetPointerToVoxels();
+  irtkGreyPixel *ptr2mask   = (_mask != NULL) ? _mask->GetPointerToVoxels() : NULL;
+  irtkRealPixel *ptr2w      = _w  .GetPointerToVoxels();
+  irtkRealPixel *ptr2mt     = _mt .GetPointerToVoxels();
+  irtkRealPixel *ptr2ms     = _ms .GetPointerToVoxels();
+  irtkRealPixel *ptr2vt     = _vt .GetPointerToVoxels();
+  irtkRealPixel *ptr2vs     = _vs .GetPointerToVoxels();
+  irtkRealPixel *ptr2vts    = _vts.GetPointerToVoxels();
+  irtkRealPixel *ptr2lncc   = lncc.GetPointerToVoxels();
+
+  // With w(x, y) the normalized window weight of voxel y at x, the derivative
+  // of LNCC(x) with respect to s(y) is
+  //   w(x, y) * [(t(y) - mt(x)) / sqrt(vt(x) vs(x)) - LNCC(x) * (s(y) - ms(x)) / vs(x)].
+  // Summing over x gives four convolutions of the terms a = 1 / (W sqrt(vt vs)),
+  // a * mt, b = LNCC / (W vs) and b * ms, which are stored in vt, vts, vs and lncc.
+  for (i = 0; i < lncc.GetNumberOfVoxels(); i++) {
+    if ((((ptr2mask == NULL) || (ptr2mask[i] == 0)) && (ptr2source[i] > _SourcePadding)) &&
+        (ptr2vt[i] > LNCC_EPSILON) && (ptr2vs[i] > LNCC_EPSILON)) {
+      a = 1.0 / (ptr2w[i] * sqrt(ptr2vt[i] * ptr2vs[i]));
+      b = ptr2lncc[i] / (ptr2w[i] * ptr2vs[i]);
+    } else {
+      a = 0;
+      b = 0;
+    }
+    ptr2vt  [i] = a;
+    ptr2vts [i] = a * ptr2mt[i];
+    ptr2vs  [i] = b;
+    ptr2lncc[i] = b * ptr2ms[i];
+  }
+  this->Convolve(_vt);
+  this->Convolve(_vts);
+  this->Convolve(_vs);
+  this->Convolve(lncc);
+
+  // Compute gradient
+  irtkRealPixel *ptr2sourceGradient     = sourceGradient->GetPointerToVoxels();
+  irtkRealPixel *ptr2similarityGradient = similarityGradient->GetPointerToVoxels();
+  n = lncc.GetNumberOfVoxels();
+  for (i = 0; i < n; i++) {
+    if ((_n > 0) && ((ptr2mask == NULL) || (ptr2mask[i] == 0)) && (ptr2source[i] > _SourcePadding)) {
+      grad = (ptr2target[i] * ptr2vt[i] - ptr2vts[i] - ptr2source[i] * ptr2vs[i] + ptr2lncc[i]) / _n;
+    } else {
+      grad = 0;
+    }
+    for (l = 0; l < 3; l++) {
+      ptr2similarityGradient[i + l * n] = grad * ptr2sourceGradient[i + l * n];
+    }
+  }
+}
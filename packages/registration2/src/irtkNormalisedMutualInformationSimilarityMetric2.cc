@@ -0,0 +1,31 @@
+/*=========================================================================
+
+  Library   : Image Registration Toolkit (IRTK)
+  Module    : $Id$
+  Copyright : Imperial College, Department of Computing
+              Visual Information Processing (VIP), 2009 onwards
+  Date      : $Date$
+  Version   : $Revision$
+  Changes   : $Author$
+
+Copyright (c) 1999-2014 and onwards, Imperial College London
+All rights reserved.
+See LICENSE for details
+
+=========================================================================*/
+
+#include <irtkRegistration2.h>
+
+double irtkNormalisedMutualInformationSimilarityMetric2::Evaluate()
+{
+  irtkJointHistogramNMI nmi(_histogram, _target, _source, _mask, _SourcePadding,
+                            _target_min, _target_max, _source_min, _source_max);
+  return nmi.Evaluate();
+}
+
+void irtkNormalisedMutualInformationSimilarityMetric2::EvaluateGradient(irtkRealImage *sourceGradient, irtkRealImage *similarityGradient)
+{
+  irtkJointHistogramNMI nmi(_histogram, _target, _source, _mask, _SourcePadding,
+                            _target_min, _target_max, _source_min, _source_max);
+  nmi.EvaluateGradient(sourceGradient, similarityGradient);
+}
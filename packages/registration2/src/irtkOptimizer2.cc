@@ -0,0 +1,315 @@
+/*=========================================================================
+
+  Library   : Image Registration Toolkit (IRTK)
+  Module    : $Id$
+  Copyright : Imperial College, Department of Computing
+              Visual Information Processing (VIP), 2009 onwards
+  Date      : $Date$
+  Version   : $Revision$
+  Changes   : $Author$
+
+Copyright (c) 1999-2014 and onwards, Imperial College London
+All rights reserved.
+See LICENSE for details
+
+=========================================================================*/
+
+#include <irtkRegistration2.h>
+
+#define MAX_NO_LINE_ITERATIONS 20
+
+irtkOptimizer2::irtkOptimizer2()
+{
+  // Set parameters
+  _MinStep            = 0.01;
+  _MaxStep            = 1;
+  _Epsilon            = 0;
+  _NumberOfIterations = 20;
+  _Curvature          = 0.9;
+
+  // Set pointers
+  _Transformation = NULL;
+  _Registration   = NULL;
+  _x              = NULL;
+  _gradient       = NULL;
+  _direction      = NULL;
+  _s              = NULL;
+  _y              = NULL;
+  _trialGradient  = NULL;
+  _bestGradient   = NULL;
+}
+
+irtkOptimizer2::~irtkOptimizer2()
+{
+}
+
+void irtkOptimizer2::Initialize()
+{
+  int i;
+
+  if (_Transformation == NULL) {
+    cerr << this->NameOfClass() << "::Initialize: Optimizer has no transformation" << endl;
+    exit(1);
+  }
+
+  if (_Registration == NULL) {
+    cerr << this->NameOfClass() << "::Initialize: Optimizer has no registration" << endl;
+    exit(1);
+  }
+
+  _NumberOfDOFs  = _Transformation->NumberOfDOFs();
+  _x             = new double[_NumberOfDOFs];
+  _gradient      = new double[_NumberOfDOFs];
+  _direction     = new double[_NumberOfDOFs];
+  _s             = new double[_NumberOfDOFs];
+  _y             = new double[_NumberOfDOFs];
+  _trialGradient = new double[_NumberOfDOFs];
+  _bestGradient  = new double[_NumberOfDOFs];
+  for (i = 0; i < _NumberOfDOFs; i++) {
+    _x[i]         = _Transformation->Get(i);
+    _direction[i] = 0;
+    _s[i]         = 0;
+    _y[i]         = 0;
+  }
+  _Step  = 0;
+  _Slope = 0;
+}
+
+void irtkOptimizer2::Finalize()
+{
+  int i;
+
+  // Make sure that the transformation holds the final parameters
+  for (i = 0; i < _NumberOfDOFs; i++) {
+    _Transformation->Put(i, _x[i]);
+  }
+
+  delete []_x;
+  delete []_gradient;
+  delete []_direction;
+  delete []_s;
+  delete []_y;
+  delete []_trialGradient;
+  delete []_bestGradient;
+  _x             = NULL;
+  _gradient      = NULL;
+  _direction     = NULL;
+  _s             = NULL;
+  _y             = NULL;
+  _trialGradient = NULL;
+  _bestGradient  = NULL;
+}
+
+double irtkOptimizer2::InitialStep(double slope)
+{
+  if ((_Step > 0) && (slope > 0)) {
+    return _Step * _Slope / slope;
+  }
+  return 0;
+}
+
+void irtkOptimizer2::Reset()
+{
+}
+
+void irtkOptimizer2::Update(const double *, const double *)
+{
+}
+
+double irtkOptimizer2::EvaluateStep(double step, double *gradient, double &slope)
+{
+  int i;
+  double value;
+
+  // Move along search direction
+  for (i = 0; i < _NumberOfDOFs; i++) {
+    _Transformation->Put(i, _x[i] + step * _direction[i]);
+  }
+
+  // Evaluate similarity and gradient
+  value = _Registration->EvaluateWithGradient(gradient);
+
+  // Compute slope along search direction
+  slope = 0;
+  for (i = 0; i < _NumberOfDOFs; i++) {
+    slope += gradient[i] * _direction[i];
+  }
+  return value;
+}
+
+bool irtkOptimizer2::LineSearch(double slope)
+{
+  int i;
+  double a, a_lo, a_hi, a_min, a_max, a_last, f, f_lo, df, df_lo, df_hi, length, width, *tmp;
+  bool bracket, accept;
+
+  // Largest change of parameters per unit step length
+  length = 0;
+  for (i = 0; i < _NumberOfDOFs; i++) {
+    if (fabs(_direction[i]) > length) length = fabs(_direction[i]);
+  }
+  if (length == 0) return false;
+  a_min = _MinStep / length;
+  a_max = _MaxStep / length;
+
+  // Initial step length
+  a = this->InitialStep(slope);
+  if ((a <= 0) || (a > a_max)) a = a_max;
+  if (a < a_min) a = a_min;
+
+  // Best step so far, with step length zero for the current parameters
+  a_lo  = 0;
+  f_lo  = _Value;
+  df_lo = slope;
+  a_hi  = df_hi = 0;
+
+  bracket = false;
+  accept  = false;
+  a_last  = 0;
+  for (i = 0; (i < MAX_NO_LINE_ITERATIONS) && (accept == false); i++) {
+    f = this->EvaluateStep(a, _trialGradient, df);
+    a_last = a;
+
+    if (f <= f_lo) {
+      // Step is too long, so the maximum is bracketed by the best step and this one
+      cout << "Rejected objective function value is " << f << "; step = " << a * length << endl;
+      a_hi    = a;
+      df_hi   = df;
+      bracket = true;
+    } else {
+      cout << "New objective function value is " << f << "; step = " << a * length << endl;
+
+      // Keep gradient of best step
+      tmp            = _bestGradient;
+      _bestGradient  = _trialGradient;
+      _trialGradient = tmp;
+
+      // Accept step which satisfies the strong Wolfe conditions
+      if (fabs(df) <= _Curvature * slope) {
+        accept = true;
+      } else if (df < 0) {
+        // Step has passed the maximum
+        a_hi    = a_lo;
+        df_hi   = df_lo;
+        bracket = true;
+      }
+      a_lo  = a;
+      f_lo  = f;
+      df_lo = df;
+    }
+
+    if (accept == false) {
+      if (bracket == true) {
+        // Stop if the bracket is too small
+        width = fabs(a_hi - a_lo);
+        if (width < a_min) break;
+
+        // Zero of linear interpolation of slopes, otherwise bisection
+        a = 0.5 * (a_lo + a_hi);
+        if (df_lo * df_hi < 0) {
+          a = a_lo + df_lo * (a_hi - a_lo) / (df_lo - df_hi);
+        }
+
+        // Keep step away from the ends of the bracket
+        if (a < min(a_lo, a_hi) + 0.1 * width) a = min(a_lo, a_hi) + 0.1 * width;
+        if (a > max(a_lo, a_hi) - 0.1 * width) a = max(a_lo, a_hi) - 0.1 * width;
+      } else {
+        // Extrapolate until the maximum is bracketed or the step is too long
+        if (a_lo >= a_max) break;
+        a = min(2 * a_lo, a_max);
+      }
+    }
+  }
+
+  // Check whether the similarity has increased at all
+  if (a_lo == 0) {
+    for (i = 0; i < _NumberOfDOFs; i++) {
+      _Transformation->Put(i, _x[i]);
+    }
+    return false;
+  }
+
+  // Re-apply best step if a later trial step has been rejected, so that the
+  // transformation and the transformed source of the registration are those
+  // of the accepted step when the next gradient is computed
+  if (a_last != a_lo) {
+    f_lo = this->EvaluateStep(a_lo, _bestGradient, df_lo);
+  }
+
+  // Move to best step and reuse its gradient
+  for (i = 0; i < _NumberOfDOFs; i++) {
+    _s[i] = a_lo * _direction[i];
+    _y[i] = _gradient[i] - _bestGradient[i];
+    _x[i] += _s[i];
+    _Transformation->Put(i, _x[i]);
+  }
+  tmp           = _gradient;
+  _gradient     = _bestGradient;
+  _bestGradient = tmp;
+  _Value        = f_lo;
+  _Step         = a_lo;
+  _Slope        = slope;
+
+  return true;
+}
+
+double irtkOptimizer2::Run()
+{
+  int i, k;
+  double slope, old_value;
+  bool restart;
+
+  // Do the initial set up
+  this->Initialize();
+  this->Reset();
+
+  // Evaluate similarity and gradient at initial parameters
+  _Value = _Registration->EvaluateWithGradient(_gradient);
+
+  restart = true;
+  for (i = 0; i < _NumberOfIterations; i++) {
+    cout << "Iteration = " << i + 1 << " (out of " << _NumberOfIterations << ")"<< endl;
+    cout << "Current objective function value is " << _Value << endl;
+
+    // Compute search direction
+    this->ComputeDirection();
+    slope = 0;
+    for (k = 0; k < _NumberOfDOFs; k++) {
+      slope += _gradient[k] * _direction[k];
+    }
+
+    // Restart along gradient if search direction does not increase the similarity
+    if (slope <= 0) {
+      this->Reset();
+      restart = true;
+      slope = 0;
+      for (k = 0; k < _NumberOfDOFs; k++) {
+        _direction[k] = _gradient[k];
+        slope += _gradient[k] * _gradient[k];
+      }
+    }
+    if (slope <= 0) break;
+
+    // Line search along search direction
+    old_value = _Value;
+    if (this->LineSearch(slope) == false) {
+      // Check for convergence
+      if (restart == true) break;
+
+      // Try again along gradient
+      this->Reset();
+      restart = true;
+      continue;
+    }
+    restart = false;
+    this->Update(_s, _y);
+
+    // Check for convergence
+    if (_Value - old_value <= _Epsilon) break;
+  }
+
+  // Do the final clean up
+  this->Finalize();
+
+  return _Value;
+}
@@ -0,0 +1,82 @@
+/*=========================================================================
+
+  Library   : Image Registration Toolkit (IRTK)
+  Module    : $Id$
+  Copyright : Imperial College, Department of Computing
+              Visual Information Processing (VIP), 2009 onwards
+  Date      : $Date$
+  Version   : $Revision$
+  Changes   : $Author$
+
+Copyright (c) 1999-2014 and onwards, Imperial College London
+All rights reserved.
+See LICENSE for details
+
+=========================================================================*/
+
+#include <irtkRegistration2.h>
+
+double irtkSSDSimilarityMetric2::Evaluate()
+{
+  int i, n;
+  double norm, ssd;
+
+  // Pointer to voxels in images
+  irtkRealPixel *ptr2target  = _target->GetPointerToVoxels();
+  irtkRealPixel *ptr2source  = _source->GetPointerToVoxels();
+  irtkGreyPixel *ptr2mask    = (_mask != NULL) ? _mask->GetPointerToVoxels() : NULL;
+
+  // Initialize metric
+  n = 0;
+  ssd = 0;
+
+  // Compute metric
+  for (i = 0; i < _target->GetNumberOfVoxels(); i++) {
+    if (((ptr2mask == NULL) || (ptr2mask[i] == 0)) && (ptr2source[i] > _SourcePadding)) {
+      ssd += (ptr2target[i] - ptr2source[i]) * (ptr2target[i] - ptr2source[i]);
+      n++;
+    }
+  }
+
+  // Normalize similarity measure by number of voxels and maximum SSD
+  norm = 1.0 / ((double)n * (double)_maxDiff);
+
+  // Return similarity measure
+  if (norm > 0) {
+    return -ssd * norm;
+  } else {
+    cerr << "irtkSSDSimilarityMetric2::Evaluate: No samples available" << endl;
+    return 0;
+  }
+}
+
+void irtkSSDSimilarityMetric2::EvaluateGradient(irtkRealImage *sourceGradient, irtkRealImage *similarityGradient)
+{
+  double ssd;
+  int i, j, k, n;
+
+  // Pointer to voxels in images
+  irtkRealPixel *ptr2target = _target->GetPointerToVoxels();
+  irtkRealPixel *ptr2source = _source->GetPointerToVoxels();
+  irtkGreyPixel *ptr2mask   = (_mask != NULL) ? _mask->GetPointerToVoxels() : NULL;
+
+  // Compute gradient
+  n = 0;
+  for (k = 0; k < _target->GetZ(); k++) {
+    for (j = 0; j < _target->GetY(); j++) {
+      for (i = 0; i < _target->GetX(); i++) {
+        if (((ptr2mask == NULL) || (ptr2mask[n] == 0)) && (ptr2source[n] > _SourcePadding)) {
+          ssd = 2 * (ptr2target[n] - ptr2source[n]) / _maxDiff;
+          similarityGradient->Put(i, j, k, 0, ssd * sourceGradient->Get(i, j, k, 0));
+          similarityGradient->Put(i, j, k, 1, ssd * sourceGradient->Get(i, j, k, 1));
+          similarityGradient->Put(i, j, k, 2, ssd * sourceGradient->Get(i, j, k, 2));
+        } else {
+          similarityGradient->Put(i, j, k, 0, 0);
+          similarityGradient->Put(i, j, k, 1, 0);
+          similarityGradient->Put(i, j, k, 2, 0);
+        }
+        n++;
+      }
+    }
+  }
+}
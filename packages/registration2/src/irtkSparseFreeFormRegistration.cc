@@ -25,6 +25,7 @@ See LICENSE for details
 #define MAX_NO_LINE_ITERATIONS 12
 #define MAX_SSD 0
 #define MAX_NMI 2
+#define MAX_CC 1
 
 extern irtkRealImage *tmp_target, *tmp_source;
 
@@ -207,6 +208,8 @@ void irtkSparseFreeFormRegistration::Initialize()
         _MaxSimilarity = MAX_SSD;
     }else if(_SimilarityMeasure == NMI){
         _MaxSimilarity = MAX_NMI;
+    }else if(_SimilarityMeasure == CC || _SimilarityMeasure == LNCC){
+        _MaxSimilarity = MAX_CC;
     }
 
     _Lambda3tmp = _Lambda3;
@@ -1456,6 +1459,12 @@ void irtkSparseFreeFormRegistration::Run()
         exit(1);
     }
 
+    // The optimization below does not draw samples of target voxels
+    if (_SamplingStrategy != SamplingAll) {
+        cerr << "irtkSparseFreeFormRegistration::Run: Sampling not supported, using all voxels" << endl;
+        _SamplingStrategy = SamplingAll;
+    }
+
     // Do the initial set up for all levels
     this->Initialize();
 
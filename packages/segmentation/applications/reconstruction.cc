@@ -67,6 +67,10 @@ void usage()
   cerr << "\t-log_prefix [prefix]      Prefix for the log file."<<endl;
   cerr << "\t-info [filename]          Filename for slice information in\
                                        tab-sparated columns."<<endl;
+  cerr << "\t-coeff_tolerance [f]      Displacement of a slice up to which its PSF coefficients are kept,"<<endl;
+  cerr << "\t                          as fraction of the PSF sampling step. [Default: 0.1]"<<endl;
+  cerr << "\t-scratch [folder] [MB]    Store slice data in scratch files in folder and process slices in batches within memory budget."<<endl;
+  cerr << "\t-gather                   Gather slices into volume instead of using a copy of the volume for each thread."<<endl;
   cerr << "\t-debug                    Debug mode - save intermediate results."<<endl;
   cerr << "\t-no_log                   Do not redirect cout and cerr to log files."<<endl;
   cerr << "\t" << endl;
@@ -115,6 +119,11 @@ int main(int argc, char **argv)
   double averageValue = 700;
   double smooth_mask = 4;
   bool global_bias_correction = false;
+  bool gather = false;
+  double coeff_tolerance = 0.1;
+  //folder for scratch files and memory budget for slice data, if given
+  char *scratch_folder = NULL;
+  double scratch_budget = 0;
   double low_intensity_cutoff = 0.01;
   //folder for slice-to-volume registrations, if given
   char * folder=NULL;
@@ -371,6 +380,37 @@ int main(int argc, char **argv)
       ok = true;
     }
 
+    //Displacement of slices up to which PSF coefficients are kept
+    if ((ok == false) && (strcmp(argv[1], "-coeff_tolerance") == 0)){
+      argc--;
+      argv++;
+      coeff_tolerance=atof(argv[1]);
+      argc--;
+      argv++;
+      ok = true;
+    }
+
+    //Store slice data in scratch files
+    if ((ok == false) && (strcmp(argv[1], "-scratch") == 0)){
+      argc--;
+      argv++;
+      scratch_folder=argv[1];
+      argc--;
+      argv++;
+      scratch_budget=atof(argv[1]);
+      argc--;
+      argv++;
+      ok = true;
+    }
+
+    //Gather slices into volume
+    if ((ok == false) && (strcmp(argv[1], "-gather") == 0)){
+      argc--;
+      argv++;
+      gather=true;
+      ok = true;
+    }
+
     //Debug mode
     if ((ok == false) && (strcmp(argv[1], "-debug") == 0)){
       argc--;
@@ -686,6 +726,15 @@ int main(int argc, char **argv)
   else 
     reconstruction.GlobalBiasCorrectionOff();
     
+  //Set gather flag
+  if (gather)
+    reconstruction.GatherOn();
+    
+  reconstruction.SetCoeffInitTolerance(coeff_tolerance);
+
+  if (scratch_folder!=NULL)
+    reconstruction.SetScratchFolder(scratch_folder, scratch_budget);
+    
   //if given read slice-to-volume registrations
   if (folder!=NULL)
     reconstruction.ReadTransformation(folder);
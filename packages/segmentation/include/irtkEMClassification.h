@@ -34,6 +34,12 @@ Expectation Maximisation Algorithm
 class irtkEMClassification : public irtkObject
 {
 
+  friend class irtkMultiThreadedEMClassificationPosteriors;
+  friend class irtkMultiThreadedEMClassificationMeans;
+  friend class irtkMultiThreadedEMClassificationVariances;
+  friend class irtkMultiThreadedEMClassificationLogLikelihood;
+  friend class irtkMultiThreadedEMClassificationWeights;
+
 protected:
 
   /// Input image
@@ -103,6 +109,37 @@ protected:
   /// Debug flag
   bool _debug;
 
+  /// Indices of voxels inside the mask
+  vector<int> _voxels;
+
+  /// Gathers indices of voxels inside the mask
+  void GatherVoxels();
+
+  /// Evaluates likelihood of tissue for n intensities
+  virtual void Likelihood(int, const double *, double *, int);
+
+  /** Computes posteriors of voxels inside the mask from the given prior
+   *  probability maps (uniform if NULL) times the given mixing coefficients
+   *  (ones if NULL). Tissues with zero mixing coefficient are ignored. If the
+   *  flag is set, the program exits if all tissues have zero probability.
+   */
+  void ComputePosteriors(irtkRealPixel **, const double *, bool);
+
+  /// Sets posteriors of voxels outside the mask to given values
+  void ComputeBackgroundPosteriors(const double *);
+
+  /// Computes sums of posteriors times intensities and sums of posteriors
+  void ComputeMeans(double *, double *);
+
+  /// Computes sums of posteriors times squared distances to the means
+  void ComputeVariances(double *);
+
+  /// Computes log likelihood for given priors and mixing coefficients (see ComputePosteriors)
+  double ComputeLogLikelihood(irtkRealPixel **, const double *);
+
+  /// Computes weights and image estimate
+  void ComputeWeights();
+
 public:
 
   /// Estimates posterior probabilities
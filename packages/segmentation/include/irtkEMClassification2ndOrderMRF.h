@@ -75,6 +75,10 @@ private:
 
   double getTau(int index, int tissue);
 
+protected:
+  /// Likelihood integrated over the intensity bin of the voxel
+  virtual void Likelihood(int, const double *, double *, int);
+
 public:
   /// Constructor
   irtkEMClassification2ndOrderMRF();
@@ -89,8 +93,6 @@ public:
   irtkEMClassification2ndOrderMRF(int noTissues, irtkRealImage **atlas);
 
   void SetLogTransformed(bool);
-  double LogLikelihood();
-  void EStep();
 
   void GetBiasField(irtkRealImage &image);
 
@@ -25,8 +25,16 @@ struct NearstNeighbor{
 	double weight;
 };
 
+class irtkMultiThreadedMAPatchMatchInitialize;
+class irtkMultiThreadedMAPatchMatchPropagation;
+class irtkMultiThreadedMAPatchMatchRandomSearch;
+
 class irtkMAPatchMatch{
 
+	friend class irtkMultiThreadedMAPatchMatchInitialize;
+	friend class irtkMultiThreadedMAPatchMatchPropagation;
+	friend class irtkMultiThreadedMAPatchMatchRandomSearch;
+
 protected:
 
 	/// target image
@@ -53,8 +61,16 @@ protected:
 	int nneighbour;
 	/// Max distance between patches
 	int maxdistance;
+	/// Seed of the random search
+	unsigned int randomseed;
+	/// Number of random search passes so far
+	int randompass;
+	/// Distance to the neighbours in the first propagation (jump flooding)
+	int jumpstep;
 	/// initialize field's weight
 	virtual double initialize();
+	/// calculate the weight of the initial fields, in parallel
+	double initializeweights();
 	/// initial guess of the mapping
 	virtual void initialguess();
 	/// find minum flow
@@ -63,14 +79,22 @@ protected:
 	virtual double minimizeflowwithdebug();
 	/// calculate distance between patches
 	virtual double distance(int x1, int y1, int z1, int x2, int y2, int z2, int n);
-	/// random search the space to find a better link
-	int randomlink(int i, int j, int k, int n, int index = -1);
+	/// random search the space to find a better link, pass selects the random sequence
+	int randomlink(int i, int j, int k, int n, int index = -1, int pass = 0);
 	/// createsearchimage
 	void createsearchimages();
 	/// test if it is search
 	virtual int checkissearch(int i, int j, int k, int n);
 	/// propergate from one to another using the offset
 	int propergate(int x, int y, int z, int i, int j, int k, int offsetx, int offsety, int offestz, int index1 = -1, int index2 = -1);
+	/// propergate from the neighbours before (or after if reverse) at the given distance to all voxels, returns number of voxels changed
+	int propergation(int step, bool reverse);
+	/// random search for all voxels, returns number of links changed
+	int randomsearch();
+	/// one iteration of propergation and random search, returns sum of the distances
+	double searchflow(int &fcount, int &bcount, int &rcount);
+	/// reset the jump flooding step
+	void initializejumpstep();
 	/// vote weight matrix
 	virtual void voteweight(int zd, int mode);
 public:
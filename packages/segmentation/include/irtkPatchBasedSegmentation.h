@@ -12,9 +12,18 @@
 #include <irtkRegistration.h>
 #include <irtkGaussian.h>
 
+class irtkMultiThreadedPatchBasedSegmentationMeasures;
+class irtkMultiThreadedPatchBasedSegmentationDifferences;
+class irtkMultiThreadedPatchBasedSegmentationDistances;
+class irtkMultiThreadedPatchBasedSegmentationWeights;
 
 class irtkPatchBasedSegmentation{
 
+	friend class irtkMultiThreadedPatchBasedSegmentationMeasures;
+	friend class irtkMultiThreadedPatchBasedSegmentationDifferences;
+	friend class irtkMultiThreadedPatchBasedSegmentationDistances;
+	friend class irtkMultiThreadedPatchBasedSegmentationWeights;
+
 private:
 
 	irtkRealImage _image, _hdimage, **_atlases;
@@ -31,9 +40,8 @@ private:
 	int _simMeasure;
 	int _maxVal, _padding;
 	//_patchSize: nr of voxels around voxel of interest
-	double _sigma, _beta, _epsilon, * _wMin;
+	double _sigma, _beta, _epsilon;
 	//int _x_image, _y_image, _z_image;
-	double EvaluatePatch(int x_image, int y_image, int z_image, int x_atlas, int y_atlas, int z_atlas, int atlasNo);
 	double *** _allSimilarities;
 
 	int * _availableLabels;
@@ -46,16 +54,21 @@ private:
 	bool _useMask, _patchMeasuresAvailable;
 	bool _winnerTakesAll;
 	irtkGreyImage _mask;
-	void FindImage(int, int, int, double ****);
+	/// Whether the atlas patch at (x_atlas, y_atlas, z_atlas) is similar enough to be compared with the image patch
+	bool IsCandidate(int x_image, int y_image, int z_image, int x_atlas, int y_atlas, int z_atlas, int atlasNo);
+	/// Sum over patches of the voxels of rows [y1, y2) of slices [z1, z2) of one or two blocks of y rows and z slices (separable box filter)
+	void BoxSum(double *data1, double *data2, int y, int z, int y1, int y2, int z1, int z2);
+	/// Sum of squared differences and number of voxels compared of all patches of rows [y1, y2) of slices [z1, z2) for given atlas and offset
+	void EvaluatePatches(int y1, int y2, int z1, int z2, int atlasNo, int dx, int dy, int dz, double *ssd, double *count);
+	/// Segment rows [y1, y2) of slices [z1, z2)
+	void RunSlab(int y1, int y2, int z1, int z2);
 
 
 public:
 	irtkPatchBasedSegmentation(irtkRealImage, irtkRealImage **, irtkGreyImage **, int, int, int);
 	~irtkPatchBasedSegmentation();
 	bool IsForeground(int, int, int);
-	void EvaluateNeighbourhood(int, int, int, int, double ***);
 	int GetLabel(int, int, int, int);
-	void FindLabel(int, int, int, int, double ***);
 	void Run();
 	void WriteSegmentation(char *);
 	void EstablishPatchMeasures();
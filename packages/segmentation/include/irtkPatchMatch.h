@@ -17,6 +17,26 @@ See LICENSE for details
 #ifndef irtkPatchMatch_H_
 #define irtkPatchMatch_H_
 
+/// Hash the seed, the pass and the voxel index into the state of a random sequence
+inline unsigned int patchmatchseed(unsigned int seed, int pass, int index)
+{
+	unsigned int h = seed;
+	h ^= (unsigned int)pass * 0x9e3779b9u + (unsigned int)index * 0x85ebca6bu;
+	h ^= h >> 16;
+	h *= 0x7feb352du;
+	h ^= h >> 15;
+	h *= 0x846ca68bu;
+	h ^= h >> 16;
+	return h;
+}
+
+/// Next random number in [0, 2^24) of the sequence (linear congruential generator)
+inline int patchmatchrandom(unsigned int &state)
+{
+	state = state * 1664525u + 1013904223u;
+	return state >> 8;
+}
+
 struct NearstNeighborFlow{
 	int x;
 	int y;
@@ -24,8 +44,16 @@ struct NearstNeighborFlow{
 	double weight;
 };
 
+class irtkMultiThreadedPatchMatchInitialize;
+class irtkMultiThreadedPatchMatchPropagation;
+class irtkMultiThreadedPatchMatchRandomSearch;
+
 class irtkPatchMatch{
 
+	friend class irtkMultiThreadedPatchMatchInitialize;
+	friend class irtkMultiThreadedPatchMatchPropagation;
+	friend class irtkMultiThreadedPatchMatchRandomSearch;
+
 protected:
 
 	/// target image
@@ -44,6 +72,12 @@ protected:
 	int nneighbour;
 	/// Max distance between patches
 	int maxdistance;
+	/// Seed of the random search
+	unsigned int randomseed;
+	/// Number of random search passes so far
+	int randompass;
+	/// Distance to the neighbours in the first propagation (jump flooding)
+	int jumpstep;
 	/// initialize field's weight
 	virtual double initialize();
 	/// initial guess of the mapping
@@ -64,10 +98,18 @@ protected:
 	virtual double selfdistance3D(int x1, int y1, int z1, int x2, int y2, int z2, int mode = 0);
 	/// calculate distance between patches of same image
 	virtual double selfdistance2D(int x1, int y1, int x2, int y2, int mode = 0);
-	/// random search the space to find a better link
-	int randomlink(int i, int j, int k, int n, int index = -1);
+	/// random search the space to find a better link, pass selects the random sequence
+	int randomlink(int i, int j, int k, int n, int index = -1, int pass = 0);
 	/// propergate from one to another using the offset
 	int propergate(int x, int y, int z, int i, int j, int k, int offsetx, int offsety, int offestz, int index1 = -1, int index2 = -1);
+	/// propergate from the neighbours before (or after if reverse) at the given distance to all voxels, returns number of voxels changed
+	int propergation(int step, bool reverse);
+	/// random search for all voxels, returns number of links changed
+	int randomsearch();
+	/// one iteration of propergation and random search, returns sum of the distances
+	double searchflow(int &fcount, int &bcount, int &rcount);
+	/// reset the jump flooding step
+	void initializejumpstep();
 	/// vote weight matrix
 	virtual void voteweight(int zd, int mode);
 public:
@@ -87,6 +87,9 @@ public:
   /// Sets intensity value at position
   void SetValue(int x, int y, int z, int t, unsigned int tissue, irtkRealPixel value);
 
+  /// Returns pointer to first voxel of probability map
+  irtkRealPixel *GetPointerToVoxels(unsigned int channel);
+
   /// Returns number of voxels
   int GetNumberOfVoxels();
 
@@ -187,6 +190,15 @@ inline void irtkProbabilisticAtlas::SetValue(int x, int y, int z, int t, unsigne
   }
 }
 
+inline irtkRealPixel *irtkProbabilisticAtlas::GetPointerToVoxels(unsigned int channel)
+{
+  if (channel < _images.size()) return _images[channel].GetPointerToVoxels();
+  else {
+    cerr << "Channel identificator " << channel <<" out of range." <<endl;
+    exit(1);
+  }
+}
+
 inline int irtkProbabilisticAtlas::GetNumberOfVoxels()
 {
   return _number_of_voxels;
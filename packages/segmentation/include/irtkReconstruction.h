@@ -22,6 +22,8 @@ See LICENSE for details
 #include <irtkTransformation.h>
 #include <irtkGaussianBlurring.h>
 #include <irtkBSplineReconstruction.h>
+#include <irtkSliceToVolumeMatrix.h>
+#include <irtkVolumeToSliceMatrix.h>
 
 
 #include <vector>
@@ -33,24 +35,33 @@ using namespace std;
 
 */
 
-struct POINT3D
-{
-    short x;
-    short y;
-    short z;
-    double value;
-};
-
-typedef std::vector<POINT3D> VOXELCOEFFS; 
-typedef std::vector<std::vector<VOXELCOEFFS> > SLICECOEFFS;
-
 class irtkReconstruction : public irtkObject
 {
 
  protected:
 
     //Structures to store the matrix of transformation between volume and slices
-    std::vector<SLICECOEFFS> _volcoeffs;
+    vector<irtkSliceToVolumeMatrix> _volcoeffs;
+    /// Transpose of the slice-volume matrices, used in gather mode
+    irtkVolumeToSliceMatrix _voxcoeffs;
+    /// Flag to say whether the slices are gathered into the volume
+    bool _gather;
+    /// Transformation matrices for which the slice-volume matrices were computed
+    vector<irtkMatrix> _volcoeffs_matrices;
+    /// Volume mask for which the slice-volume matrices were computed
+    irtkRealImage _volcoeffs_mask;
+    /// Quality factor for which the slice-volume matrices were computed
+    double _volcoeffs_quality_factor;
+    /// Indicator whether the slice-volume matrix of a slice is recomputed
+    vector<bool> _volcoeffs_update;
+    /// Maximum displacement of a slice for which its slice-volume matrix is kept,
+    /// as a fraction of the PSF sampling step (voxel size divided by quality factor)
+    double _coeff_init_tolerance;
+
+    /// Folder for scratch files holding the slice data, empty if kept in memory
+    string _scratch_folder;
+    /// Memory budget (in bytes) for slice data processed at once
+    double _scratch_budget;
 
     //SLICES
     /// Slices
@@ -164,6 +175,16 @@ class irtkReconstruction : public irtkObject
     ///Uniform PDF
     inline double M(double m);
 
+    ///Maximum displacement of a slice since its slice-volume matrix was computed
+    double SliceDisplacement(int inputIndex);
+
+    ///Move slice data which is not stored in a scratch file yet to a new scratch file
+    void MapSlices();
+    ///End of batch of slices starting with given slice whose data fits into the memory budget
+    size_t SliceBatchEnd(size_t begin);
+    ///Release memory of slice data stored in scratch files
+    void ReleaseSlices(size_t begin, size_t end);
+
     int _directions[13][3];
     
     ///BSpline reconstruction
@@ -286,7 +307,8 @@ class irtkReconstruction : public irtkObject
     ///Set reconstructed image
     void SetTemplate(irtkRealImage tempImage);
   
-    ///Calculate transformation matrix between slices and voxels
+    ///Calculate transformation matrix between slices and voxels, keeping
+    ///the matrices of slices which have not moved since the last call
     void CoeffInit();
     
     ///Calculate transformation matrix between slices and voxels for BSpline interpolation
@@ -378,6 +400,21 @@ class irtkReconstruction : public irtkObject
     ///Use slower better quality reconstruction
     inline void SpeedupOff();
   
+    ///Gather slices into volume using transposed slice-volume matrix,
+    ///which avoids a copy of the volume for each thread
+    inline void GatherOn();
+  
+    ///Scatter slices into volume using a copy of the volume for each thread
+    inline void GatherOff();
+  
+    ///Set maximum displacement of a slice for which CoeffInit keeps its
+    ///slice-volume matrix, as a fraction of the PSF sampling step
+    inline void SetCoeffInitTolerance( double tolerance );
+  
+    ///Store slice data in scratch files in the given folder and process
+    ///slices in batches whose data fits into the memory budget (in MB)
+    void SetScratchFolder( const char *folder, double budget );
+  
     ///Switch on global bias correction
     inline void GlobalBiasCorrectionOn();
   
@@ -449,11 +486,14 @@ class irtkReconstruction : public irtkObject
     friend class ParallelSliceToVolumeRegistration;
     friend class ParallelCoeffInit;
     friend class ParallelSuperresolution;
+    friend class ParallelSuperresolutionValues;
+    friend class ParallelGather;
     friend class ParallelMStep;
     friend class ParallelEStep;
     friend class ParallelBias;
     friend class ParallelScale;
     friend class ParallelNormaliseBias;
+    friend class ParallelNormaliseBiasValues;
     friend class ParallelSimulateSlices;
     friend class ParallelAverage;
     friend class ParallelSliceAverage;
@@ -523,6 +563,21 @@ inline void irtkReconstruction::SpeedupOff()
     _quality_factor=2;
 }
 
+inline void irtkReconstruction::GatherOn()
+{
+    _gather=true;
+}
+
+inline void irtkReconstruction::GatherOff()
+{
+    _gather=false;
+}
+
+inline void irtkReconstruction::SetCoeffInitTolerance(double tolerance)
+{
+    _coeff_init_tolerance=tolerance;
+}
+
 inline void irtkReconstruction::GlobalBiasCorrectionOn()
 {
     _global_bias_correction=true;
@@ -0,0 +1,194 @@
+/*=========================================================================
+
+  Library   : Image Registration Toolkit (IRTK)
+  Module    : $Id$
+  Copyright : Imperial College, Department of Computing
+              Visual Information Processing (VIP), 2008 onwards
+  Date      : $Date$
+  Version   : $Revision$
+  Changes   : $Author$
+
+Copyright (c) 1999-2014 and onwards, Imperial College London
+All rights reserved.
+See LICENSE for details
+
+=========================================================================*/
+
+#ifndef _IRTKSLICETOVOLUMEMATRIX_H
+
+#define _IRTKSLICETOVOLUMEMATRIX_H
+
+#include <irtkImage.h>
+
+#include <vector>
+using namespace std;
+
+/**
+ * Sparse matrix which maps a volume onto a slice.
+ *
+ * Each row of the matrix corresponds to a slice voxel (i, j) and holds the
+ * weights of the PSF of this slice voxel for the volume voxels it covers.
+ * The matrix is stored in compressed sparse row format, i.e. the linear
+ * indices of the volume voxels and the weights of all rows are stored in two
+ * flat arrays and each row is a range of these arrays. Rows are ordered by
+ * slice voxel with j varying fastest. The matrix is built by adding the
+ * entries of each row with Add() followed by EndRow(), for all slice voxels
+ * in order.
+ */
+
+class irtkSliceToVolumeMatrix : public irtkObject
+{
+
+  /// Size of slice
+  int _x, _y;
+
+  /// Start of each row in _index and _value, followed by number of entries
+  vector<int> _start;
+
+  /// Linear indices of volume voxels
+  vector<int> _index;
+
+  /// Weights of volume voxels
+  vector<float> _value;
+
+public:
+
+  /// Constructor
+  irtkSliceToVolumeMatrix();
+
+  /// Clear matrix and start building matrix for slice of given size
+  void Initialize(int, int);
+
+  /// Clear matrix and release memory
+  void Clear();
+
+  /// Add entry for volume voxel with given linear index to current row
+  void Add(int, double);
+
+  /// Finish current row and start next row
+  void EndRow();
+
+  /// Returns whether all rows have been built
+  bool IsComplete() const;
+
+  /// Size of slice along x
+  int GetX() const;
+
+  /// Size of slice along y
+  int GetY() const;
+
+  /// Number of volume voxels to which slice voxel (i, j) is mapped
+  int GetSize(int, int) const;
+
+  /// Linear indices of volume voxels of slice voxel (i, j)
+  const int *GetIndices(int, int) const;
+
+  /// Weights of volume voxels of slice voxel (i, j)
+  const float *GetValues(int, int) const;
+
+  /// Total number of entries
+  int GetNumberOfEntries() const;
+
+  /// Memory used by matrix in bytes
+  long GetMemorySize() const;
+
+  /** Forward operator for slice voxel (i, j). Returns the weighted sum of the
+   *  given volume voxels and the sum of weights.
+   */
+  double Forward(int, int, const irtkRealPixel *, double &) const;
+
+  /** Adjoint operator for slice voxel (i, j). Adds the given value times the
+   *  weights to the given volume voxels.
+   */
+  void Adjoint(int, int, double, irtkRealPixel *) const;
+
+};
+
+inline void irtkSliceToVolumeMatrix::Add(int index, double value)
+{
+  _index.push_back(index);
+  _value.push_back(static_cast<float>(value));
+}
+
+inline void irtkSliceToVolumeMatrix::EndRow()
+{
+  _start.push_back(_index.size());
+
+  // Release unused memory once the last row has been built
+  if (this->IsComplete()) {
+    vector<int>(_index).swap(_index);
+    vector<float>(_value).swap(_value);
+  }
+}
+
+inline bool irtkSliceToVolumeMatrix::IsComplete() const
+{
+  return (int)_start.size() == _x * _y + 1;
+}
+
+inline int irtkSliceToVolumeMatrix::GetX() const
+{
+  return _x;
+}
+
+inline int irtkSliceToVolumeMatrix::GetY() const
+{
+  return _y;
+}
+
+inline int irtkSliceToVolumeMatrix::GetSize(int i, int j) const
+{
+  return _start[i * _y + j + 1] - _start[i * _y + j];
+}
+
+inline const int *irtkSliceToVolumeMatrix::GetIndices(int i, int j) const
+{
+  return _index.empty() ? NULL : &_index[0] + _start[i * _y + j];
+}
+
+inline const float *irtkSliceToVolumeMatrix::GetValues(int i, int j) const
+{
+  return _value.empty() ? NULL : &_value[0] + _start[i * _y + j];
+}
+
+inline int irtkSliceToVolumeMatrix::GetNumberOfEntries() const
+{
+  return _index.size();
+}
+
+inline double irtkSliceToVolumeMatrix::Forward(int i, int j, const irtkRealPixel *volume, double &weight) const
+{
+  int k, n;
+  const int *index;
+  const float *value;
+  double sum;
+
+  n     = this->GetSize(i, j);
+  index = this->GetIndices(i, j);
+  value = this->GetValues(i, j);
+
+  sum    = 0;
+  weight = 0;
+  for (k = 0; k < n; k++) {
+    sum    += value[k] * volume[index[k]];
+    weight += value[k];
+  }
+  return sum;
+}
+
+inline void irtkSliceToVolumeMatrix::Adjoint(int i, int j, double a, irtkRealPixel *volume) const
+{
+  int k, n;
+  const int *index;
+  const float *value;
+
+  n     = this->GetSize(i, j);
+  index = this->GetIndices(i, j);
+  value = this->GetValues(i, j);
+
+  for (k = 0; k < n; k++) {
+    volume[index[k]] += value[k] * a;
+  }
+}
+
+#endif
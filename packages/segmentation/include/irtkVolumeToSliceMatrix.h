@@ -0,0 +1,145 @@
+/*=========================================================================
+
+  Library   : Image Registration Toolkit (IRTK)
+  Module    : $Id$
+  Copyright : Imperial College, Department of Computing
+              Visual Information Processing (VIP), 2008 onwards
+  Date      : $Date$
+  Version   : $Revision$
+  Changes   : $Author$
+
+Copyright (c) 1999-2014 and onwards, Imperial College London
+All rights reserved.
+See LICENSE for details
+
+=========================================================================*/
+
+#ifndef _IRTKVOLUMETOSLICEMATRIX_H
+
+#define _IRTKVOLUMETOSLICEMATRIX_H
+
+#include <irtkSliceToVolumeMatrix.h>
+
+/**
+ * Transpose of the slice-to-volume matrices of all slices.
+ *
+ * Each row of the matrix corresponds to a volume voxel and holds the PSF
+ * weights of all slice voxels which contribute to this volume voxel. Slice
+ * voxels are numbered consecutively over all slices, i.e. slice voxel (i, j)
+ * of slice s has the index GetOffset(s) + i * y + j. The matrix allows the
+ * adjoint operator to be evaluated as a gather for each volume voxel, so
+ * that the volume voxels can be updated in parallel without accumulating
+ * into a separate volume for each thread.
+ */
+
+class irtkVolumeToSliceMatrix : public irtkObject
+{
+
+  /// Index of first voxel of each slice, followed by number of slice voxels
+  vector<int> _offset;
+
+  /// Start of each row in _index and _value, followed by number of entries
+  vector<int> _start;
+
+  /// Indices of slice voxels
+  vector<int> _index;
+
+  /// Weights of slice voxels
+  vector<float> _value;
+
+public:
+
+  /// Constructor
+  irtkVolumeToSliceMatrix();
+
+  /// Build transpose of slice-to-volume matrices for volume with given number of voxels
+  void Initialize(const vector<irtkSliceToVolumeMatrix> &, int);
+
+  /// Clear matrix and release memory
+  void Clear();
+
+  /// Returns whether the matrix is empty
+  bool IsEmpty() const;
+
+  /// Number of volume voxels
+  int GetNumberOfVoxels() const;
+
+  /// Total number of slice voxels
+  int GetNumberOfSliceVoxels() const;
+
+  /// Index of first voxel of slice
+  int GetOffset(int) const;
+
+  /// Number of slice voxels which contribute to volume voxel
+  int GetSize(int) const;
+
+  /// Indices of slice voxels which contribute to volume voxel
+  const int *GetIndices(int) const;
+
+  /// Weights of slice voxels which contribute to volume voxel
+  const float *GetValues(int) const;
+
+  /// Memory used by matrix in bytes
+  long GetMemorySize() const;
+
+  /** Adjoint operator of slice-to-volume matrices for volume voxel. Returns
+   *  the weighted sum of the given values of all slice voxels.
+   */
+  double Gather(int, const double *) const;
+
+};
+
+inline bool irtkVolumeToSliceMatrix::IsEmpty() const
+{
+  return _start.size() < 2;
+}
+
+inline int irtkVolumeToSliceMatrix::GetNumberOfVoxels() const
+{
+  return _start.size() - 1;
+}
+
+inline int irtkVolumeToSliceMatrix::GetNumberOfSliceVoxels() const
+{
+  return _offset.back();
+}
+
+inline int irtkVolumeToSliceMatrix::GetOffset(int slice) const
+{
+  return _offset[slice];
+}
+
+inline int irtkVolumeToSliceMatrix::GetSize(int voxel) const
+{
+  return _start[voxel + 1] - _start[voxel];
+}
+
+inline const int *irtkVolumeToSliceMatrix::GetIndices(int voxel) const
+{
+  return _index.empty() ? NULL : &_index[0] + _start[voxel];
+}
+
+inline const float *irtkVolumeToSliceMatrix::GetValues(int voxel) const
+{
+  return _value.empty() ? NULL : &_value[0] + _start[voxel];
+}
+
+inline double irtkVolumeToSliceMatrix::Gather(int voxel, const double *values) const
+{
+  int k, n;
+  const int *index;
+  const float *value;
+  double sum;
+
+  n     = this->GetSize(voxel);
+  index = this->GetIndices(voxel);
+  value = this->GetValues(voxel);
+
+  sum = 0;
+  for (k = 0; k < n; k++) {
+    sum += value[k] * values[index[k]];
+  }
+  return sum;
+}
+
+#endif
@@ -16,6 +16,323 @@ See LICENSE for details
 
 #include <irtkEMClassification.h>
 
+// Number of voxels which are processed together, so that the likelihoods of
+// each tissue are evaluated for contiguous arrays of intensities
+#define EM_BLOCK_SIZE 256
+
+class irtkMultiThreadedEMClassificationPosteriors
+{
+
+  /// Pointer to classification
+  irtkEMClassification *_filter;
+
+  /// Prior probability maps (uniform if NULL)
+  irtkRealPixel **_prior;
+
+  /// Mixing coefficients (ones if NULL)
+  const double *_c;
+
+  /// Exit if all tissues have zero probability
+  bool _exit_on_zero;
+
+public:
+
+  irtkMultiThreadedEMClassificationPosteriors(irtkEMClassification *filter, irtkRealPixel **prior, const double *c, bool exit_on_zero) {
+    _filter       = filter;
+    _prior        = prior;
+    _c            = c;
+    _exit_on_zero = exit_on_zero;
+  }
+
+  void operator()(const blocked_range<int> &r) const {
+    int i, b, k, n, index[EM_BLOCK_SIZE];
+    double x[EM_BLOCK_SIZE], denominator[EM_BLOCK_SIZE], value, *numerator;
+    irtkRealPixel *ptr, *output;
+
+    int number_of_tissues = _filter->_number_of_tissues;
+    vector<double> buffer(number_of_tissues * EM_BLOCK_SIZE);
+    ptr = _filter->_input.GetPointerToVoxels();
+
+    for (i = r.begin(); i < r.end(); i += n) {
+      n = min(EM_BLOCK_SIZE, r.end() - i);
+
+      // Gather intensities of block
+      for (b = 0; b < n; b++) {
+        index[b] = _filter->_voxels[i + b];
+        x[b] = ptr[index[b]];
+        denominator[b] = 0;
+      }
+
+      // Likelihoods times priors of all tissues
+      for (k = 0; k < number_of_tissues; k++) {
+        numerator = &buffer[k * EM_BLOCK_SIZE];
+        if ((_c != NULL) && (_c[k] == 0)) {
+          for (b = 0; b < n; b++) numerator[b] = 0;
+          continue;
+        }
+        _filter->Likelihood(k, x, numerator, n);
+        if (_prior != NULL) {
+          for (b = 0; b < n; b++) numerator[b] *= _prior[k][index[b]];
+        }
+        if (_c != NULL) {
+          for (b = 0; b < n; b++) numerator[b] *= _c[k];
+        }
+        for (b = 0; b < n; b++) denominator[b] += numerator[b];
+      }
+
+      // Normalise
+      for (k = 0; k < number_of_tissues; k++) {
+        numerator = &buffer[k * EM_BLOCK_SIZE];
+        output = _filter->_output.GetPointerToVoxels(k);
+        for (b = 0; b < n; b++) {
+          if (denominator[b] != 0) {
+            value = numerator[b] / denominator[b];
+            output[index[b]] = value;
+            if ((value < 0) || (value > 1)) {
+              cerr << "Probability value out of range = " << value << endl;
+              cerr << value << " " << k << " " << index[b] << " " << _filter->_sigma[k] << endl;
+              exit(1);
+            }
+          } else {
+            cerr << "Division by 0 while computing probabilities" << endl;
+            cerr << "tissue=" << k;
+            if (_exit_on_zero) exit(1);
+            if (k == 0) output[index[b]] = 1;
+            else        output[index[b]] = 0;
+          }
+        }
+      }
+    }
+  }
+};
+
+class irtkMultiThreadedEMClassificationMeans
+{
+
+  /// Pointer to classification
+  irtkEMClassification *_filter;
+
+public:
+
+  /// Sums of posteriors times intensities
+  vector<double> _mi_num;
+
+  /// Sums of posteriors
+  vector<double> _denom;
+
+  irtkMultiThreadedEMClassificationMeans(irtkEMClassification *filter) {
+    _filter = filter;
+    _mi_num.assign(_filter->_number_of_tissues, 0);
+    _denom.assign(_filter->_number_of_tissues, 0);
+  }
+
+  irtkMultiThreadedEMClassificationMeans(irtkMultiThreadedEMClassificationMeans &r, split) {
+    _filter = r._filter;
+    _mi_num.assign(_filter->_number_of_tissues, 0);
+    _denom.assign(_filter->_number_of_tissues, 0);
+  }
+
+  void join(irtkMultiThreadedEMClassificationMeans &rhs) {
+    int k;
+
+    for (k = 0; k < _filter->_number_of_tissues; k++) {
+      _mi_num[k] += rhs._mi_num[k];
+      _denom[k]  += rhs._denom[k];
+    }
+  }
+
+  void operator()(const blocked_range<int> &r) {
+    int i, k, index;
+    double mi_num, denom;
+    irtkRealPixel *ptr, *output;
+
+    ptr = _filter->_input.GetPointerToVoxels();
+    for (k = 0; k < _filter->_number_of_tissues; k++) {
+      output = _filter->_output.GetPointerToVoxels(k);
+      mi_num = _mi_num[k];
+      denom  = _denom[k];
+      for (i = r.begin(); i != r.end(); i++) {
+        index   = _filter->_voxels[i];
+        mi_num += output[index] * ptr[index];
+        denom  += output[index];
+      }
+      _mi_num[k] = mi_num;
+      _denom[k]  = denom;
+    }
+  }
+};
+
+class irtkMultiThreadedEMClassificationVariances
+{
+
+  /// Pointer to classification
+  irtkEMClassification *_filter;
+
+public:
+
+  /// Sums of posteriors times squared distances to the means
+  vector<double> _sigma_num;
+
+  irtkMultiThreadedEMClassificationVariances(irtkEMClassification *filter) {
+    _filter = filter;
+    _sigma_num.assign(_filter->_number_of_tissues, 0);
+  }
+
+  irtkMultiThreadedEMClassificationVariances(irtkMultiThreadedEMClassificationVariances &r, split) {
+    _filter = r._filter;
+    _sigma_num.assign(_filter->_number_of_tissues, 0);
+  }
+
+  void join(irtkMultiThreadedEMClassificationVariances &rhs) {
+    int k;
+
+    for (k = 0; k < _filter->_number_of_tissues; k++) {
+      _sigma_num[k] += rhs._sigma_num[k];
+    }
+  }
+
+  void operator()(const blocked_range<int> &r) {
+    int i, k, index;
+    double mi, sigma_num;
+    irtkRealPixel *ptr, *output;
+
+    ptr = _filter->_input.GetPointerToVoxels();
+    for (k = 0; k < _filter->_number_of_tissues; k++) {
+      output = _filter->_output.GetPointerToVoxels(k);
+      mi = _filter->_mi[k];
+      sigma_num = _sigma_num[k];
+      for (i = r.begin(); i != r.end(); i++) {
+        index = _filter->_voxels[i];
+        sigma_num += output[index] * (ptr[index] - mi) * (ptr[index] - mi);
+      }
+      _sigma_num[k] = sigma_num;
+    }
+  }
+};
+
+class irtkMultiThreadedEMClassificationLogLikelihood
+{
+
+  /// Pointer to classification
+  irtkEMClassification *_filter;
+
+  /// Prior probability maps (uniform if NULL)
+  irtkRealPixel **_prior;
+
+  /// Mixing coefficients (ones if NULL)
+  const double *_c;
+
+public:
+
+  /// Sum of log likelihoods
+  double _f;
+
+  irtkMultiThreadedEMClassificationLogLikelihood(irtkEMClassification *filter, irtkRealPixel **prior, const double *c) {
+    _filter = filter;
+    _prior  = prior;
+    _c      = c;
+    _f      = 0;
+  }
+
+  irtkMultiThreadedEMClassificationLogLikelihood(irtkMultiThreadedEMClassificationLogLikelihood &r, split) {
+    _filter = r._filter;
+    _prior  = r._prior;
+    _c      = r._c;
+    _f      = 0;
+  }
+
+  void join(irtkMultiThreadedEMClassificationLogLikelihood &rhs) {
+    _f += rhs._f;
+  }
+
+  void operator()(const blocked_range<int> &r) {
+    int i, b, k, n, index[EM_BLOCK_SIZE];
+    double x[EM_BLOCK_SIZE], gv[EM_BLOCK_SIZE], temp[EM_BLOCK_SIZE];
+    irtkRealPixel *ptr;
+
+    ptr = _filter->_input.GetPointerToVoxels();
+    for (i = r.begin(); i < r.end(); i += n) {
+      n = min(EM_BLOCK_SIZE, r.end() - i);
+
+      // Gather intensities of block
+      for (b = 0; b < n; b++) {
+        index[b] = _filter->_voxels[i + b];
+        x[b] = ptr[index[b]];
+        temp[b] = 0;
+      }
+
+      for (k = 0; k < _filter->_number_of_tissues; k++) {
+        if ((_c != NULL) && (_c[k] == 0)) continue;
+        // Estimation of gaussian probability of intensities for tissue k
+        _filter->Likelihood(k, x, gv, n);
+        // Probability that voxels are from tissue k
+        if (_prior != NULL) {
+          for (b = 0; b < n; b++) gv[b] *= _prior[k][index[b]];
+        }
+        if (_c != NULL) {
+          for (b = 0; b < n; b++) gv[b] *= _c[k];
+        }
+        for (b = 0; b < n; b++) temp[b] += gv[b];
+      }
+
+      for (b = 0; b < n; b++) {
+        if ((temp[b] > 1) || (temp[b] < 0)) {
+          cerr << "Could not compute likelihood, probability out of range = " << temp[b] << endl;
+          exit(1);
+        }
+        _f += log(temp[b]);
+      }
+    }
+  }
+};
+
+class irtkMultiThreadedEMClassificationWeights
+{
+
+  /// Pointer to classification
+  irtkEMClassification *_filter;
+
+public:
+
+  irtkMultiThreadedEMClassificationWeights(irtkEMClassification *filter) {
+    _filter = filter;
+  }
+
+  void operator()(const blocked_range<int> &r) const {
+    int i, k, index;
+    double num, den;
+    irtkRealPixel *pi, *pw, *pwB, *pe;
+
+    int number_of_tissues = _filter->_number_of_tissues;
+    vector<irtkRealPixel *> output(number_of_tissues);
+    for (k = 0; k < number_of_tissues; k++) {
+      output[k] = _filter->_output.GetPointerToVoxels(k);
+    }
+    pi  = _filter->_input.GetPointerToVoxels();
+    pw  = _filter->_weights.GetPointerToVoxels();
+    pwB = _filter->_weightsB.GetPointerToVoxels();
+    pe  = _filter->_estimate.GetPointerToVoxels();
+
+    for (i = r.begin(); i != r.end(); i++) {
+      index = _filter->_voxels[i];
+      if (pi[index] != _filter->_padding) {
+        num = 0;
+        den = 0;
+        for (k = 0; k < number_of_tissues; k++) {
+          num += output[k][index] * _filter->_mi[k] / _filter->_sigma[k];
+          den += output[k][index] / _filter->_sigma[k];
+        }
+        pw[index]  = den;
+        pwB[index] = output[0][index] / _filter->_sigma[0];
+        pe[index]  = num / den;
+      } else {
+        pw[index] = _filter->_padding;
+        pe[index] = _filter->_padding;
+      }
+    }
+  }
+};
+
 irtkEMClassification::irtkEMClassification()
 {
   _padding = MIN_GREY;
@@ -104,11 +421,124 @@ void irtkEMClassification::CreateMask()
     else *p=0;
     p++;
   }
+  GatherVoxels();
 }
 
 void irtkEMClassification::SetMask(irtkRealImage &mask)
 {
   _mask=mask;
+  GatherVoxels();
+}
+
+void irtkEMClassification::GatherVoxels()
+{
+  int i;
+
+  _voxels.clear();
+  irtkRealPixel *pm = _mask.GetPointerToVoxels();
+  for (i = 0; i < _mask.GetNumberOfVoxels(); i++) {
+    if (pm[i] == 1) _voxels.push_back(i);
+  }
+}
+
+void irtkEMClassification::Likelihood(int k, const double *x, double *g, int n)
+{
+  int i;
+  irtkGaussian G;
+
+  G.Initialise(_mi[k], _sigma[k]);
+  for (i = 0; i < n; i++) {
+    g[i] = G.Evaluate(x[i]);
+  }
+}
+
+void irtkEMClassification::ComputePosteriors(irtkRealPixel **prior, const double *c, bool exit_on_zero)
+{
+  irtkMultiThreadedEMClassificationPosteriors posteriors(this, prior, c, exit_on_zero);
+
+  task_scheduler_init init(tbb_no_threads);
+  parallel_for(blocked_range<int>(0, _voxels.size()), posteriors);
+  init.terminate();
+}
+
+void irtkEMClassification::ComputeBackgroundPosteriors(const double *value)
+{
+  int i, k;
+  irtkRealPixel *ptr, *pm;
+
+  for (k = 0; k < _number_of_tissues; k++) {
+    ptr = _output.GetPointerToVoxels(k);
+    pm = _mask.GetPointerToVoxels();
+    for (i = 0; i < _input.GetNumberOfVoxels(); i++) {
+      if (*pm != 1) *ptr = value[k];
+      ptr++;
+      pm++;
+    }
+  }
+}
+
+void irtkEMClassification::ComputeMeans(double *mi_num, double *denom)
+{
+  int k;
+  irtkMultiThreadedEMClassificationMeans means(this);
+
+  task_scheduler_init init(tbb_no_threads);
+  parallel_reduce(blocked_range<int>(0, _voxels.size()), means);
+  init.terminate();
+
+  for (k = 0; k < _number_of_tissues; k++) {
+    mi_num[k] = means._mi_num[k];
+    denom[k]  = means._denom[k];
+  }
+}
+
+void irtkEMClassification::ComputeVariances(double *sigma_num)
+{
+  int k;
+  irtkMultiThreadedEMClassificationVariances variances(this);
+
+  task_scheduler_init init(tbb_no_threads);
+  parallel_reduce(blocked_range<int>(0, _voxels.size()), variances);
+  init.terminate();
+
+  for (k = 0; k < _number_of_tissues; k++) {
+    sigma_num[k] = variances._sigma_num[k];
+  }
+}
+
+double irtkEMClassification::ComputeLogLikelihood(irtkRealPixel **prior, const double *c)
+{
+  irtkMultiThreadedEMClassificationLogLikelihood loglikelihood(this, prior, c);
+
+  task_scheduler_init init(tbb_no_threads);
+  parallel_reduce(blocked_range<int>(0, _voxels.size()), loglikelihood);
+  init.terminate();
+
+  return loglikelihood._f;
+}
+
+void irtkEMClassification::ComputeWeights()
+{
+  int i;
+  irtkMultiThreadedEMClassificationWeights weights(this);
+
+  task_scheduler_init init(tbb_no_threads);
+  parallel_for(blocked_range<int>(0, _voxels.size()), weights);
+  init.terminate();
+
+  // Voxels outside the mask
+  irtkRealPixel *pw=_weights.GetPointerToVoxels();
+  irtkRealPixel *pe=_estimate.GetPointerToVoxels();
+  irtkRealPixel *pm=_mask.GetPointerToVoxels();
+  for (i=0; i< _input.GetNumberOfVoxels(); i++) {
+    if (*pm != 1) {
+      *pw=_padding;
+      *pe=_padding;
+    }
+    pm++;
+    pw++;
+    pe++;
+  }
 }
 
 void irtkEMClassification::Initialise()
@@ -305,39 +735,12 @@ void irtkEMClassification::InitialiseGMMParameters(int n, double *m, double *s,
 
 void irtkEMClassification::MStep()
 {
-  int i, k;
+  int k;
   vector<double> mi_num(_number_of_tissues);
   vector<double> sigma_num(_number_of_tissues);
   vector<double> denom(_number_of_tissues);
 
-  for (k = 0; k < _number_of_tissues; k++) {
-    mi_num[k] = 0;
-  }
-
-  for (k = 0; k < _number_of_tissues; k++) {
-    sigma_num[k] = 0;
-  }
-
-  for (k = 0; k < _number_of_tissues; k++) {
-    denom[k] = 0;
-  }
-
-  _output.First();
-  irtkRealPixel *ptr = _input.GetPointerToVoxels();
-  irtkRealPixel *pm = _mask.GetPointerToVoxels();
-
-  for (i = 0; i < _input.GetNumberOfVoxels(); i++) {
-    // Check for backgound
-    if (*pm == 1) {
-      for (k = 0; k < _number_of_tissues; k++) {
-        mi_num[k] += _output.GetValue(k) * *ptr;
-        denom[k]  += _output.GetValue(k);
-      }
-    }
-    ptr++;
-    pm++;
-    _output.Next();
-  }
+  this->ComputeMeans(&mi_num[0], &denom[0]);
 
   for (k = 0; k < _number_of_tissues; k++) {
     if (denom[k] != 0) {
@@ -348,21 +751,7 @@ void irtkEMClassification::MStep()
     }
   }
 
-  _output.First();
-  ptr = _input.GetPointerToVoxels();
-  pm = _mask.GetPointerToVoxels();
-
-  for (i = 0; i < _input.GetNumberOfVoxels(); i++) {
-    // Check for backgound
-    if (*pm == 1) {
-      for (k = 0; k <_number_of_tissues; k++) {
-        sigma_num[k] += (_output.GetValue(k) * (*ptr - _mi[k]) * (*ptr - _mi[k]));
-      }
-    }
-    ptr++;
-    pm++;
-    _output.Next();
-  }
+  this->ComputeVariances(&sigma_num[0]);
 
   for (k = 0; k <_number_of_tissues; k++) {
     _sigma[k] = sigma_num[k] / denom[k];
@@ -371,108 +760,24 @@ void irtkEMClassification::MStep()
 
 void irtkEMClassification::EStep()
 {
-  int i, k;
-  double x;
-
-  irtkGaussian* G = new irtkGaussian[_number_of_tissues];
+  int k;
+  vector<irtkRealPixel *> prior(_number_of_tissues);
+  vector<double> background(_number_of_tissues);
 
   for (k = 0; k < _number_of_tissues; k++) {
-    G[k].Initialise( _mi[k], _sigma[k]);
-  }
-
-  _atlas.First();
-  _output.First();
-  irtkRealPixel *ptr = _input.GetPointerToVoxels();
-  irtkRealPixel *pm = _mask.GetPointerToVoxels();
-  for (i=0; i< _input.GetNumberOfVoxels(); i++) {
-    double* gv = new double[_number_of_tissues];
-    double* numerator = new double[_number_of_tissues];
-    double denominator=0, temp=0;
-    if (*pm == 1) {
-      x = *ptr;
-      for (k = 0; k < _number_of_tissues; k++) {
-        temp = G[k].Evaluate(x);
-        gv[k] = temp;
-        temp = temp * _atlas.GetValue(k);
-        numerator[k] = temp;
-        denominator += temp;
-      }
-      for (k = 0; k < _number_of_tissues; k++) {
-        if (denominator != 0) {
-          double value = numerator[k]/denominator;
-          _output.SetValue(k, value);
-          if ((value < 0) || (value > 1)) {
-            cerr << "Probability value out of range = " << value << endl;
-            cerr << value << " " << k << " " << i << " " << _atlas.GetValue(k) <<  " " << _sigma[k] << endl;
-            exit(1);
-          }
-        } else {
-          cerr << "Division by 0 while computing probabilities" << endl;
-          cerr<<"tissue="<<k;
-          if (k==0) _output.SetValue(k, 1);
-          else     _output.SetValue(k, 0);
-        }
-      }
-    } else {
-      for (k = 0; k < _number_of_tissues - 1; k++) {
-        _output.SetValue(k, 0);
-      }
-      _output.SetValue(_number_of_tissues - 1, 1);
-    }
-    ptr++;
-    pm++;
-    _atlas.Next();
-    _output.Next();
-    delete[] gv;
-    delete[] numerator;
+    prior[k] = _atlas.GetPointerToVoxels(k);
+    background[k] = 0;
   }
-  delete[] G;
+  background[_number_of_tissues - 1] = 1;
 
+  this->ComputePosteriors(&prior[0], NULL, false);
+  this->ComputeBackgroundPosteriors(&background[0]);
 }
 
 void irtkEMClassification::WStep()
 {
-  int i,k;
-  double num, den;
   cerr<<"Calculating weights ...";
-  irtkRealPixel *pi=_input.GetPointerToVoxels();
-  irtkRealPixel *pw=_weights.GetPointerToVoxels();
-  irtkRealPixel *pwB=_weightsB.GetPointerToVoxels();
-  irtkRealPixel *pe=_estimate.GetPointerToVoxels();
-  irtkRealPixel *pm=_mask.GetPointerToVoxels();
-  _output.First();
-  _atlas.First();
-
-  for (i=0; i< _input.GetNumberOfVoxels(); i++) {
-    if ((*pm == 1)&&(*pi != _padding)) {
-      num=0;
-      den=0;
-      for (k=0; k<_number_of_tissues; k++) {
-        num += _output.GetValue(k)*_mi[k]/_sigma[k];
-        den += _output.GetValue(k)/_sigma[k];
-      }
-      *pw=den;
-      *pwB=_output.GetValue(0)/_sigma[0];
-      *pe=num/den;
-
-      /*if(_background_tissue >=0)
-      {
-        if(_atlas.GetValue(_background_tissue) == 1) *pe=_padding;
-      }
-      */
-    } else {
-      *pw=_padding;
-      *pe=_padding;
-    }
-
-    pi++;
-    pm++;
-    pw++;
-    pwB++;
-    pe++;
-    _output.Next();
-    _atlas.Next();
-  }
+  this->ComputeWeights();
   _estimate.Write("_e.nii.gz");
   _weights.Write("_weights.nii.gz");
   _weightsR.Write("_weightsR.nii.gz");
@@ -521,45 +826,12 @@ void irtkEMClassification::BrainmaskInput()
 
 void irtkEMClassification::MStepGMM(bool uniform_prior)
 {
-  int i, k;
+  int k;
   vector<double> mi_num(_number_of_tissues);
   vector<double> sigma_num(_number_of_tissues);
   vector<double> denom(_number_of_tissues);
-  vector<double> num_vox(_number_of_tissues);
-
-  for (k = 0; k < _number_of_tissues; k++) {
-    mi_num[k] = 0;
-  }
-
-  for (k = 0; k < _number_of_tissues; k++) {
-    sigma_num[k] = 0;
-  }
-
-  for (k = 0; k < _number_of_tissues; k++) {
-    denom[k] = 0;
-  }
-
-  for (k = 0; k < _number_of_tissues; k++) {
-    num_vox[k] = 0;
-  }
 
-  _output.First();
-  irtkRealPixel *ptr = _input.GetPointerToVoxels();
-  irtkRealPixel *pm = _mask.GetPointerToVoxels();
-
-  for (i = 0; i < _input.GetNumberOfVoxels(); i++) {
-    // Check for backgound
-    if (*pm == 1) {
-      for (k = 0; k < _number_of_tissues; k++) {
-        mi_num[k] += _output.GetValue(k) * *ptr;
-        denom[k]  += _output.GetValue(k);
-        num_vox[k]+= 1;
-      }
-    }
-    ptr++;
-    pm++;
-    _output.Next();
-  }
+  this->ComputeMeans(&mi_num[0], &denom[0]);
 
   for (k = 0; k < _number_of_tissues; k++) {
     if (denom[k] != 0) {
@@ -569,24 +841,10 @@ void irtkEMClassification::MStepGMM(bool uniform_prior)
       exit(1);
     }
      if (uniform_prior) _c[k]=1.0/_number_of_tissues;
-     else _c[k]=denom[k]/num_vox[k];
+     else _c[k]=denom[k]/_voxels.size();
   }
 
-  _output.First();
-  ptr = _input.GetPointerToVoxels();
-  pm = _mask.GetPointerToVoxels();
-
-  for (i = 0; i < _input.GetNumberOfVoxels(); i++) {
-    // Check for backgound
-    if (*pm == 1) {
-      for (k = 0; k <_number_of_tissues; k++) {
-        sigma_num[k] += (_output.GetValue(k) * (*ptr - _mi[k]) * (*ptr - _mi[k]));
-      }
-    }
-    ptr++;
-    pm++;
-    _output.Next();
-  }
+  this->ComputeVariances(&sigma_num[0]);
 
   for (k = 0; k <_number_of_tissues; k++) {
     _sigma[k] = sigma_num[k] / denom[k];
@@ -597,45 +855,12 @@ void irtkEMClassification::MStepGMM(bool uniform_prior)
 
 void irtkEMClassification::MStepVarGMM(bool uniform_prior)
 {
-  int i, k;
+  int k;
   vector<double> mi_num(_number_of_tissues);
-  double sigma_num;
+  vector<double> sigma_num(_number_of_tissues);
   vector<double> denom(_number_of_tissues);
-  vector<double> num_vox(_number_of_tissues);
-
-  for (k = 0; k < _number_of_tissues; k++) {
-    mi_num[k] = 0;
-  }
-
-    sigma_num = 0;
-
-  for (k = 0; k < _number_of_tissues; k++) {
-    denom[k] = 0;
-  }
-
-  for (k = 0; k < _number_of_tissues; k++) {
-    num_vox[k] = 0;
-  }
-
-
-  _output.First();
-  irtkRealPixel *ptr = _input.GetPointerToVoxels();
-  irtkRealPixel *pm = _mask.GetPointerToVoxels();
-
-  for (i = 0; i < _input.GetNumberOfVoxels(); i++) {
-    // Check for backgound
-    if (*pm == 1) {
-      for (k = 0; k < _number_of_tissues; k++) {
-        mi_num[k] += _output.GetValue(k) * *ptr;
-        denom[k]  += _output.GetValue(k);
-        num_vox[k]+= 1;
-      }
-    }
-    ptr++;
-    pm++;
-    _output.Next();
-  }
 
+  this->ComputeMeans(&mi_num[0], &denom[0]);
 
   for (k = 0; k < _number_of_tissues; k++) {
     if (denom[k] != 0) {
@@ -645,29 +870,16 @@ void irtkEMClassification::MStepVarGMM(bool uniform_prior)
       //exit(1);
     }
      if (uniform_prior) _c[k]=1.0/_number_of_tissues;
-     else _c[k]=denom[k]/num_vox[k];
+     else _c[k]=denom[k]/_voxels.size();
   }
 
-  _output.First();
-  ptr = _input.GetPointerToVoxels();
-  pm = _mask.GetPointerToVoxels();
+  this->ComputeVariances(&sigma_num[0]);
 
-  for (i = 0; i < _input.GetNumberOfVoxels(); i++) {
-    // Check for backgound
-    if (*pm == 1) {
-      for (k = 0; k <_number_of_tissues; k++) {
-        sigma_num += (_output.GetValue(k) * (*ptr - _mi[k]) * (*ptr - _mi[k]));
-      }
-    }
-    ptr++;
-    pm++;
-    _output.Next();
-  }
-
-  double sum =0;
+  double sum =0, sum_sigma_num = 0;
   for (k = 0; k <_number_of_tissues; k++) sum += denom[k];
+  for (k = 0; k <_number_of_tissues; k++) sum_sigma_num += sigma_num[k];
   for (k = 0; k <_number_of_tissues; k++) {
-    if (sum>0) _sigma[k] = sigma_num / sum;
+    if (sum>0) _sigma[k] = sum_sigma_num / sum;
   }
 }
 
@@ -675,59 +887,16 @@ void irtkEMClassification::MStepVarGMM(bool uniform_prior)
 
 void irtkEMClassification::EStepGMM(bool uniform_prior)
 {
-  int i, k;
-  double x;
-  double *gv = new double[_number_of_tissues];
-  double *numerator = new double[_number_of_tissues];
-  irtkGaussian *G = new irtkGaussian[_number_of_tissues];
+  int k;
+  vector<double> background(_number_of_tissues);
 
   for (k = 0; k < _number_of_tissues; k++) {
-    G[k].Initialise( _mi[k], _sigma[k]);
-  }
-
-  _output.First();
-  irtkRealPixel *ptr = _input.GetPointerToVoxels();
-  irtkRealPixel *pm = _mask.GetPointerToVoxels();
-
-  for (i=0; i< _input.GetNumberOfVoxels(); i++) {
-    double denominator=0, temp=0;
-    if (*pm == 1) {
-      x = *ptr;
-      for (k = 0; k < _number_of_tissues; k++) {
-        temp = G[k].Evaluate(x);
-        gv[k] = temp;
-        if (!uniform_prior) temp = temp * _c[k];
-        numerator[k] = temp;
-        denominator += temp;
-      }
-      for (k = 0; k < _number_of_tissues; k++) {
-        if (denominator != 0) {
-          double value = numerator[k]/denominator;
-          _output.SetValue(k, value);
-          if ((value < 0) || (value > 1)) {
-            cerr << "Probability value out of range = " << value << endl;
-            exit(1);
-          }
-        } else {
-          cerr << "Division by 0 while computing probabilities" << endl;
-          cerr<<"tissue="<<k;
-          exit(1);
-        }
-      }
-    } else {
-      for (k = 0; k < _number_of_tissues - 1; k++) {
-        _output.SetValue(k, 0);
-      }
-      _output.SetValue(_number_of_tissues - 1, 1);
-    }
-    ptr++;
-    pm++;
-    _output.Next();
+    background[k] = 0;
   }
+  background[_number_of_tissues - 1] = 1;
 
-  delete[] G;
-  delete[] gv;
-  delete[] numerator;
+  this->ComputePosteriors(NULL, uniform_prior ? NULL : _c, true);
+  this->ComputeBackgroundPosteriors(&background[0]);
 }
 
 void irtkEMClassification::Print()
@@ -779,40 +948,16 @@ double irtkEMClassification::IterateGMM(int iteration, bool equal_var, bool unif
 
 double irtkEMClassification::LogLikelihood()
 {
-  int i, k;
-  double temp, f;
+  int k;
+  double f;
   cerr<< "Log likelihood: ";
-  irtkGaussian* G = new irtkGaussian[_number_of_tissues];
-  double* gv = new double[_number_of_tissues];
+  vector<irtkRealPixel *> prior(_number_of_tissues);
 
   for (k = 0; k < _number_of_tissues; k++) {
-    G[k].Initialise( _mi[k], _sigma[k]);
+    prior[k] = _output.GetPointerToVoxels(k);
   }
 
-  irtkRealPixel *ptr = _input.GetPointerToVoxels();
-  irtkRealPixel *pm = _mask.GetPointerToVoxels();
-  _output.First();
-  f = 0;
-  for (i = 0; i < _input.GetNumberOfVoxels(); i++) {
-    if (*pm == 1) {
-      temp = 0;
-      for (k=0; k < _number_of_tissues; k++) {
-        // Estimation of gaussian probability of intensity (*ptr) for tissue k
-        gv[k] = G[k].Evaluate(*ptr);
-        // Probability that current voxel is from tissue k
-        temp += gv[k] * _output.GetValue(k);
-      }
-
-      if ((temp > 1) || (temp < 0)) {
-        cerr << "Could not compute likelihood, probability out of range = " << temp << endl;
-        exit(1);
-      }
-      f += log(temp);
-    }
-    ptr++;
-    pm++;
-    _output.Next();
-  }
+  f = this->ComputeLogLikelihood(&prior[0], NULL);
 
   f = -f;
   double diff, rel_diff;
@@ -824,48 +969,16 @@ double irtkEMClassification::LogLikelihood()
   _f=f;
 
   cerr << "f= "<< f << " diff = " << diff << " rel_diff = " << rel_diff <<endl;
-  delete[] G;
-  delete[] gv;
 
   return rel_diff;
 }
 
 double irtkEMClassification::LogLikelihoodGMM()
 {
-  int i, k;
-  double temp, f;
+  double f;
   cerr<< "Log likelihood: ";
-  irtkGaussian* G = new irtkGaussian[_number_of_tissues];
-  double* gv = new double[_number_of_tissues];
-
-  for (k = 0; k < _number_of_tissues; k++) {
-    G[k].Initialise( _mi[k], _sigma[k]);
-  }
 
-  irtkRealPixel *ptr = _input.GetPointerToVoxels();
-  irtkRealPixel *pm = _mask.GetPointerToVoxels();
-  _output.First();
-  f = 0;
-  for (i = 0; i < _input.GetNumberOfVoxels(); i++) {
-    if (*pm == 1) {
-      temp = 0;
-      for (k=0; k < _number_of_tissues; k++) {
-        // Estimation of gaussian probability of intensity (*ptr) for tissue k
-        gv[k] = G[k].Evaluate(*ptr);
-        // Probability that current voxel is from tissue k
-        temp += gv[k] * _c[k];
-      }
-
-      if ((temp > 1) || (temp < 0)) {
-        cerr << "Could not compute likelihood, probability out of range = " << temp << endl;
-        exit(1);
-      }
-      f += log(temp);
-    }
-    ptr++;
-    pm++;
-    _output.Next();
-  }
+  f = this->ComputeLogLikelihood(NULL, _c);
 
   f = -f;
   double diff, rel_diff;
@@ -877,8 +990,6 @@ double irtkEMClassification::LogLikelihoodGMM()
   _f=f;
 
   cerr << "f= "<< f << " diff = " << diff << " rel_diff = " << rel_diff <<endl;
-  delete[] G;
-  delete[] gv;
 
   return rel_diff;
 }
@@ -1283,7 +1283,7 @@ bool irtkEMClassification2ndOrderMRF::isPVclass(int pvclass)
 // Alternative cardoso implementation, not necessarily better!!
 void irtkEMClassification2ndOrderMRF::MStepPV()
 {
-  int i, k;
+  int k;
   vector<double> mi_num(_number_of_tissues);
   vector<double> sigma_num(_number_of_tissues);
   vector<double> denom(_number_of_tissues);
@@ -1294,37 +1294,7 @@ void irtkEMClassification2ndOrderMRF::MStepPV()
 	isPV[k] = isPVclass(k);
   }
 
-  for (k = 0; k < _number_of_tissues; k++) {
-    mi_num[k] = 0;
-  }
-
-  for (k = 0; k < _number_of_tissues; k++) {
-    sigma_num[k] = 0;
-  }
-
-  for (k = 0; k < _number_of_tissues; k++) {
-    denom[k] = 0;
-  }
-
-  _output.First();
-  irtkRealPixel *ptr = _input.GetPointerToVoxels();
-  irtkRealPixel *pm = _mask.GetPointerToVoxels();
-
-  for (i = 0; i < _input.GetNumberOfVoxels(); i++) {
-    // Check for backgound
-    if (*pm == 1) {
-      for (k = 0; k < _number_of_tissues; k++) {
-    	  if( !isPV[k] )
-    	  {
-    		  mi_num[k] += _output.GetValue(k) * *ptr;
-    		  denom[k]  += _output.GetValue(k);
-    	  }
-      }
-    }
-    ptr++;
-    pm++;
-    _output.Next();
-  }
+  this->ComputeMeans(&mi_num[0], &denom[0]);
 
   for (k = 0; k < _number_of_tissues; k++) {
 	  if( !isPV[k] )
@@ -1338,24 +1308,7 @@ void irtkEMClassification2ndOrderMRF::MStepPV()
 	  }
   }
 
-  _output.First();
-  ptr = _input.GetPointerToVoxels();
-  pm = _mask.GetPointerToVoxels();
-
-  for (i = 0; i < _input.GetNumberOfVoxels(); i++) {
-    // Check for backgound
-    if (*pm == 1) {
-      for (k = 0; k <_number_of_tissues; k++) {
-    	  if( !isPV[k] )
-    	  {
-    		  sigma_num[k] += (_output.GetValue(k) * (*ptr - _mi[k]) * (*ptr - _mi[k]));
-    	  }
-      }
-    }
-    ptr++;
-    pm++;
-    _output.Next();
-  }
+  this->ComputeVariances(&sigma_num[0]);
 
   for (k = 0; k <_number_of_tissues; k++) {
 	  if( !isPV[k] )
@@ -1381,138 +1334,23 @@ void irtkEMClassification2ndOrderMRF::MStepPV()
   }
 }
 
-double irtkEMClassification2ndOrderMRF::LogLikelihood()
+void irtkEMClassification2ndOrderMRF::Likelihood(int k, const double *x, double *g, int n)
 {
-  int i, k;
-  double temp, f;
-  double x;
-  cerr<< "Log likelihood: ";
-  irtkGaussian* G = new irtkGaussian[_number_of_tissues];
-  double* gv = new double[_number_of_tissues];
-
-  for (k = 0; k < _number_of_tissues; k++) {
-    G[k].Initialise( _mi[k], _sigma[k]);
-  }
-
-  irtkRealPixel *ptr = _input.GetPointerToVoxels();
-  irtkRealPixel *pm = _mask.GetPointerToVoxels();
-  _output.First();
-  f = 0;
-  for (i = 0; i < _input.GetNumberOfVoxels(); i++) {
-    if (*pm == 1) {
-      temp = 0;
-      x = *ptr;
-
-      for (k=0; k < _number_of_tissues; k++) {
-		double hp = 0.5;
-		double hm = 0.5;
-		if( _isLogTransformed )
-		{
-			hp = log( exp(x)+0.5 ) - x;
-			hm = x - log( (exp(x) - 0.5) > 0 ? exp(x) - 0.5 : exp(x) );
-		}
-        // Estimation of gaussian probability of intensity (*ptr) for tissue k
-        gv[k] = 0.5 * ( hm + hp ) * (G[k].Evaluate(x+hp)+G[k].Evaluate(x-hm));
-
-        // Probability that current voxel is from tissue k
-        temp += gv[k] * _output.GetValue(k);
-
-      }
-      if( temp < 0 || temp > 1)
-      {
-          cerr << "Could not compute likelihood, probability out of range = " << temp << endl;
-          exit(1);
-      }
-
-      f += log(temp);
-    }
-    ptr++;
-    pm++;
-    _output.Next();
-  }
-
-  f = -f;
-  double diff, rel_diff;
-  diff = _f-f;
-
-  if (_f == 0) rel_diff = 1;
-  else rel_diff = diff/_f;
-
-  _f=f;
-
-  cerr << "f= "<< f << " diff = " << diff << " rel_diff = " << rel_diff <<endl;
-  delete[] G;
-  delete[] gv;
-
-  return rel_diff;
-}
-
-void irtkEMClassification2ndOrderMRF::EStep()
-{
-  int i, k;
-  double x;
-
-  irtkGaussian* G = new irtkGaussian[_number_of_tissues];
-
-  for (k = 0; k < _number_of_tissues; k++) {
-    G[k].Initialise( _mi[k], _sigma[k]);
-  }
-
-  _atlas.First();
-  _output.First();
-  irtkRealPixel *ptr = _input.GetPointerToVoxels();
-  irtkRealPixel *pm = _mask.GetPointerToVoxels();
-  for (i=0; i< _input.GetNumberOfVoxels(); i++) {
-    double* gv = new double[_number_of_tissues];
-    double* numerator = new double[_number_of_tissues];
-    double denominator=0, temp=0;
-    if (*pm == 1) {
-      x = *ptr;
-	  double hp = 0.5;
-	  double hm = 0.5;
-	  if( _isLogTransformed )
-	  {
-			hp = log( exp(x)+0.5 ) - x;
-			hm = x - log( (exp(x) - 0.5) > 0 ? exp(x) - 0.5 : exp(x) );
-	  }
-      for (k = 0; k < _number_of_tissues; k++) {
-        temp = 0.5 * ( hm + hp ) * (G[k].Evaluate(x+hp)+G[k].Evaluate(x-hm));
-    	//temp = G[k].Evaluate(x);
-        gv[k] = temp;
-        temp = temp * _atlas.GetValue(k);
-        numerator[k] = temp;
-        denominator += temp;
-      }
-      for (k = 0; k < _number_of_tissues; k++) {
-        if (denominator != 0) {
-          double value = numerator[k]/denominator;
-          _output.SetValue(k, value);
-          if ((value < 0) || (value > 1)) {
-            cerr << "Probability value out of range = " << value << endl;
-            cerr << value << " " << k << " " << i << " " << _atlas.GetValue(k) <<  " " << _sigma[k] << endl;
-            exit(1);
-          }
-        } else {
-          cerr << "Division by 0 while computing probabilities" << endl;
-          cerr<<"tissue="<<k;
-          if (k==0) _output.SetValue(k, 1);
-          else     _output.SetValue(k, 0);
-        }
-      }
-    } else {
-      for (k = 0; k < _number_of_tissues - 1; k++) {
-        _output.SetValue(k, 0);
-      }
-      _output.SetValue(_number_of_tissues - 1, 1);
+  int i;
+  double hp, hm;
+  irtkGaussian G;
+
+  G.Initialise(_mi[k], _sigma[k]);
+  for (i = 0; i < n; i++) {
+    // Integrate over intensity bin of voxel
+    hp = 0.5;
+    hm = 0.5;
+    if( _isLogTransformed )
+    {
+      hp = log( exp(x[i])+0.5 ) - x[i];
+      hm = x[i] - log( (exp(x[i]) - 0.5) > 0 ? exp(x[i]) - 0.5 : exp(x[i]) );
     }
-    ptr++;
-    pm++;
-    _atlas.Next();
-    _output.Next();
-    delete[] gv;
-    delete[] numerator;
+    g[i] = 0.5 * ( hm + hp ) * (G.Evaluate(x[i]+hp)+G.Evaluate(x[i]-hm));
   }
-  delete[] G;
-
 }
 
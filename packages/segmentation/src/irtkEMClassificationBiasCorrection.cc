@@ -206,48 +206,15 @@ double irtkEMClassificationBiasCorrection::IterateGMM(int iteration, bool equal_
 
 void irtkEMClassificationBiasCorrection::WStep()
 {
-  int i,k;
-  double num, den;
+  unsigned int i;
   cerr<<"Calculating weights ...";
+  this->ComputeWeights();
+
+  // Weights are scaled by the intensities
   irtkRealPixel *pi=_input.GetPointerToVoxels();
   irtkRealPixel *pw=_weights.GetPointerToVoxels();
-  irtkRealPixel *pwB=_weightsB.GetPointerToVoxels();
-  irtkRealPixel *pb=_bias.GetPointerToVoxels();
-  irtkRealPixel *pe=_estimate.GetPointerToVoxels();
-  irtkRealPixel *pm=_mask.GetPointerToVoxels();
-  _output.First();
-  _atlas.First();
-
-  for (i=0; i< _input.GetNumberOfVoxels(); i++) {
-    if ((*pm == 1)&&(*pi != _padding)) {
-      num=0;
-      den=0;
-      for (k=0; k<_number_of_tissues; k++) {
-        num += _output.GetValue(k)*_mi[k]/_sigma[k];
-        den += _output.GetValue(k)/_sigma[k];
-      }
-      *pw=den*(*pi);
-      *pwB=_output.GetValue(0)/_sigma[0];
-      *pe=num/den;
-
-      /*if(_background_tissue >=0)
-      {
-        if(_atlas.GetValue(_background_tissue) == 1) *pe=_padding;
-      }
-      */
-    } else {
-      *pw=_padding;
-      *pe=_padding;
-    }
-
-    pi++;
-    pm++;
-    pw++;
-    pb++;
-    pwB++;
-    pe++;
-    _output.Next();
-    _atlas.Next();
+  for (i=0; i< _voxels.size(); i++) {
+    if (pi[_voxels[i]] != _padding) pw[_voxels[i]] *= pi[_voxels[i]];
   }
   _estimate.Write("estimate.nii.gz");
   //_weights.Write("_weights.nii.gz");
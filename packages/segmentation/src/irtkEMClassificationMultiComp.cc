@@ -204,40 +204,13 @@ void irtkEMClassificationMultiComp::Initialise()
 
 void irtkEMClassificationMultiComp::MStep()
 {
-  int i, j, k;
+  int j, k;
   double fraction;
   vector<double> mi_num(_number_of_tissues);
   vector<double> sigma_num(_number_of_tissues);
   vector<double> denom(_number_of_tissues);
 
-  for (k = 0; k < _number_of_tissues; k++) {
-    mi_num[k] = 0;
-  }
-
-  for (k = 0; k < _number_of_tissues; k++) {
-    sigma_num[k] = 0;
-  }
-
-  for (k = 0; k < _number_of_tissues; k++) {
-    denom[k] = 0;
-  }
-
-  _output.First();
-  irtkRealPixel *ptr = _input.GetPointerToVoxels();
-  irtkRealPixel *pm = _mask.GetPointerToVoxels();
-
-  for (i = 0; i < _input.GetNumberOfVoxels(); i++) {
-    // Check for backgound
-    if (*pm == 1) {
-      for (k = 0; k < _number_of_tissues; k++) {
-        mi_num[k] += _output.GetValue(k) * *ptr;
-        denom[k]  += _output.GetValue(k);
-      }
-    }
-    ptr++;
-    pm++;
-    _output.Next();
-  }
+  this->ComputeMeans(&mi_num[0], &denom[0]);
 
   for (k = 0; k < _number_of_tissues; k++) {
     if (denom[k] != 0) {
@@ -260,22 +233,7 @@ void irtkEMClassificationMultiComp::MStep()
 	  }
   }
 
-  _output.First();
-  ptr = _input.GetPointerToVoxels();
-  pm = _mask.GetPointerToVoxels();
-
-  for (i = 0; i < _input.GetNumberOfVoxels(); i++) {
-    // Check for backgound
-    if (*pm == 1) {
-      for (k = 0; k <_number_of_tissues; k++) {
-		  if(_mi[k]!=-1)
-			 sigma_num[k] += (_output.GetValue(k) * (*ptr - _mi[k]) * (*ptr - _mi[k]));
-      }
-    }
-    ptr++;
-    pm++;
-    _output.Next();
-  }
+  this->ComputeVariances(&sigma_num[0]);
 
   for (k = 0; k <_number_of_tissues; k++) {
 	  if(_mi[k]!=-1)
@@ -287,129 +245,25 @@ void irtkEMClassificationMultiComp::MStep()
 
 void irtkEMClassificationMultiComp::EStep()
 {
-  int i, j, k, x, y, z, t;
-  double v;
-  //,distance;
-
-  irtkGaussian* G = new irtkGaussian[_number_of_tissues];
-  double *center_x = new double[_number_of_tissues];
-  double *center_z = new double[_number_of_tissues];
-  double *center_y = new double[_number_of_tissues];
-  double *center_weight = new double[_number_of_tissues];
-
-  for (k = 0; k < _number_of_tissues; k++) {
-    G[k].Initialise( _mi[k], _sigma[k]);
-	center_x[k] = 0; center_y[k] = 0; 
-	center_z[k] = 0; center_weight[k] = 0;
-  }
-
-  _atlas.First();
-  _output.First();
-  irtkRealPixel *ptr = _input.GetPointerToVoxels();
-  irtkRealPixel *pm = _mask.GetPointerToVoxels();
-  for (i=0; i< _input.GetNumberOfVoxels(); i++) {
-	  double* gv = new double[_number_of_tissues];
-	  double* numerator = new double[_number_of_tissues];
-	  if (*pm == 1) {
-		  v = *ptr;
-		  for (j = 0; j < _number_of_atlas; j++){
-			  for (k = _ns[j]; k < _ne[j]; k++) {
-				  if(_mi[k]!=-1){
-					  gv[k] = G[k].Evaluate(v);
-					  numerator[k] = gv[k] * _atlas.GetValue(j);
-					  center_weight[k] += numerator[k];
-					  _input.GetImageAttributes().IndexToLattice(i,&x,&y,&z,&t);
-					  center_x[k] += x*numerator[k]; 
-					  center_y[k] += y*numerator[k]; 
-					  center_z[k] += z*numerator[k];
-				  }
-			  }
-		  }
-	  }
-	  ptr++;
-	  pm++;
-	  _atlas.Next();
-	  _output.Next();
-	  delete[] gv;
-	  delete[] numerator;
-  }
-  for (k = 0; k < _number_of_tissues; k++) {
-	  if(center_weight[k] != 0){
-		  center_x[k] = center_x[k]/center_weight[k];
-		  center_y[k] = center_y[k]/center_weight[k];
-		  center_z[k] = center_z[k]/center_weight[k];
-	  }
-  }
+  int j, k;
+  vector<irtkRealPixel *> prior(_number_of_tissues);
+  vector<double> c(_number_of_tissues);
+  vector<double> background(_number_of_tissues);
 
-  _atlas.First();
-  _output.First();
-  ptr = _input.GetPointerToVoxels();
-  pm = _mask.GetPointerToVoxels();
-  for (i=0; i< _input.GetNumberOfVoxels(); i++) {
-    double* gv = new double[_number_of_tissues];
-    double* numerator = new double[_number_of_tissues];
-    double denominator=0;
-    if (*pm == 1) {
-      v = *ptr;
-	  for (j = 0; j < _number_of_atlas; j++){
-		  for (k = _ns[j]; k < _ne[j]; k++) {
-			  if(_mi[k]!=-1){
-				  gv[k] = G[k].Evaluate(v);
-				  //if(k == _ns[j]){
-                      numerator[k] = gv[k] * _atlas.GetValue(j) * _c[k];
-                  //}else{
-                     // _input.GetImageAttributes().IndexToLattice(i,&x,&y,&z,&t);
-                      //distance = sqrt(pow(x-center_x[k],2)+pow(y-center_y[k],2)+pow(z-center_z[k],2)) + 1;
-                     // numerator[k] = gv[k] * _atlas.GetValue(j) * _c[k] / distance;
-                  //}
-				  denominator += numerator[k];
-			  }else{
-				  numerator[k] = 0;
-			  }
-		  }
+  // Components share the probability map of their atlas, components
+  // without voxels are ignored
+  for (j = 0; j < _number_of_atlas; j++) {
+	  for (k = _ns[j]; k < _ne[j]; k++) {
+		  prior[k] = _atlas.GetPointerToVoxels(j);
+		  if(_mi[k]!=-1) c[k] = _c[k];
+		  else c[k] = 0;
+		  if (j == _number_of_atlas - 1) background[k] = 1;
+		  else background[k] = 0;
 	  }
-      for (k = 0; k < _number_of_tissues; k++) {
-        if (denominator != 0) {
-          double value = numerator[k]/denominator;
-          _output.SetValue(k, value);
-          if ((value < 0) || (value > 1)) {
-            cerr << "Probability value out of range = " << value << endl;
-            cerr << value << " " << k << " " << i << " " << _atlas.GetValue(k) <<  " " << _sigma[k] << endl;
-            exit(1);
-          }
-        } else {
-          cerr << "Division by 0 while computing probabilities" << endl;
-          cerr<<"tissue="<<k;
-          if (k==0) _output.SetValue(k, 1);
-          else     _output.SetValue(k, 0);
-
-
-          //exit(1);
-        }
-      }
-    } else {
-		for (j = 0; j < _number_of_atlas - 1; j++) {
-			for (k = _ns[j]; k < _ne[j]; k++) {
-				_output.SetValue(k, 0);
-			}
-		}
-		for (k = _ns[_number_of_atlas - 1]; k < _ne[_number_of_atlas - 1]; k++) {
-			_output.SetValue(k, 1);
-		}
-    }
-    ptr++;
-    pm++;
-    _atlas.Next();
-    _output.Next();
-    delete[] gv;
-    delete[] numerator;
   }
-  delete[] G;
-  delete[] center_x;
-  delete[] center_y;
-  delete[] center_z;
-  delete[] center_weight;
 
+  this->ComputePosteriors(&prior[0], &c[0], false);
+  this->ComputeBackgroundPosteriors(&background[0]);
 }
 
 void irtkEMClassificationMultiComp::InitialMStep(int j, int n)
@@ -563,40 +417,19 @@ double irtkEMClassificationMultiComp::Iterate(int)
 
 double irtkEMClassificationMultiComp::LogLikelihood()
 {
-  int i, k;
-  double temp, f;
+  int k;
+  double f;
   cerr<< "Log likelihood: ";
-  irtkGaussian* G = new irtkGaussian[_number_of_tissues];
-  double* gv = new double[_number_of_tissues];
+  vector<irtkRealPixel *> prior(_number_of_tissues);
+  vector<double> c(_number_of_tissues);
 
+  // Components without voxels are ignored
   for (k = 0; k < _number_of_tissues; k++) {
-    G[k].Initialise( _mi[k], _sigma[k]);
+    prior[k] = _output.GetPointerToVoxels(k);
+    c[k] = (_mi[k] != -1) ? 1 : 0;
   }
 
-  irtkRealPixel *ptr = _input.GetPointerToVoxels();
-  irtkRealPixel *pm = _mask.GetPointerToVoxels();
-  _output.First();
-  f = 0;
-  for (i = 0; i < _input.GetNumberOfVoxels(); i++) {
-    if (*pm == 1) {
-      temp = 0;
-      for (k=0; k < _number_of_tissues; k++) {
-        // Estimation of gaussian probability of intensity (*ptr) for tissue k
-        gv[k] = G[k].Evaluate(*ptr);
-        // Probability that current voxel is from tissue k
-        temp += gv[k] *	_output.GetValue(k);
-      }
-
-      if ((temp > 1) || (temp < 0)) {
-        cerr << "Could not compute likelihood, probability out of range = " << temp << endl;
-        exit(1);
-      }
-      f += log(temp);
-    }
-    ptr++;
-    pm++;
-    _output.Next();
-  }
+  f = this->ComputeLogLikelihood(&prior[0], &c[0]);
 
   f = -f;
   double diff, rel_diff;
@@ -608,8 +441,6 @@ double irtkEMClassificationMultiComp::LogLikelihood()
   _f=f;
 
   cerr << "f= "<< f << " diff = " << diff << " rel_diff = " << rel_diff <<endl;
-  delete[] G;
-  delete[] gv;
 
   return rel_diff;
 }
@@ -16,6 +16,157 @@ See LICENSE for details
 
 #include <irtkSegmentationFunction.h>
 
+class irtkMultiThreadedMAPatchMatchInitialize
+{
+	/// Pointer to patchmatch
+	irtkMAPatchMatch *_filter;
+
+public:
+
+	irtkMultiThreadedMAPatchMatchInitialize(irtkMAPatchMatch *filter){
+		_filter = filter;
+	}
+
+	void operator()(const blocked_range<int> &r) const{
+		int i, j, k, n, index, iteration;
+		NearstNeighbor *nnf;
+
+		for(k = r.begin(); k != r.end(); k++){
+			index = k*_filter->target->GetX()*_filter->target->GetY();
+			for(j = 0; j < _filter->target->GetY(); j++){
+				for(i = 0; i < _filter->target->GetX(); i++){
+					nnf = _filter->nnfs[index];
+					for(n = 0; n < _filter->nneighbour; n++){
+						nnf[n].weight = _filter->distance(i,j,k,nnf[n].x,nnf[n].y,nnf[n].z,nnf[n].n);
+
+						// if weight == maxdistance, the link is not good try to find a better link
+						iteration = 0;
+						while(nnf[n].weight >= _filter->maxdistance && iteration < 10){
+							_filter->randomlink(i,j,k,n,index,_filter->randompass + iteration);
+							iteration++;
+						}
+					}
+					index++;
+				}
+			}
+		}
+	}
+};
+
+class irtkMultiThreadedMAPatchMatchPropagation
+{
+	/// Pointer to patchmatch
+	irtkMAPatchMatch *_filter;
+
+	/// Distance to the neighbours
+	int _step;
+
+	/// Colour of the voxels which are updated
+	int _colour;
+
+	/// Propergate from the voxels before (1) or after (-1) along each axis
+	int _direction;
+
+public:
+
+	/// Number of voxels changed
+	int _count;
+
+	irtkMultiThreadedMAPatchMatchPropagation(irtkMAPatchMatch *filter, int step, int colour, int direction){
+		_filter = filter;
+		_step = step;
+		_colour = colour;
+		_direction = direction;
+		_count = 0;
+	}
+
+	irtkMultiThreadedMAPatchMatchPropagation(irtkMultiThreadedMAPatchMatchPropagation &r, split){
+		_filter = r._filter;
+		_step = r._step;
+		_colour = r._colour;
+		_direction = r._direction;
+		_count = 0;
+	}
+
+	void join(irtkMultiThreadedMAPatchMatchPropagation &rhs){
+		_count += rhs._count;
+	}
+
+	void operator()(const blocked_range<int> &r){
+		int i, j, k, x, s, d, count, index, dx, dy, dz;
+
+		dx = 1;
+		dy = _filter->target->GetX();
+		dz = _filter->target->GetX()*_filter->target->GetY();
+		s = _step;
+		d = _direction*s;
+
+		for(k = r.begin(); k != r.end(); k++){
+			for(j = 0; j < _filter->target->GetY(); j++){
+				// voxels of the other colour are not changed, so all neighbours are fixed
+				i = ((k/s + j/s + _colour) % 2)*s;
+				for(; i < _filter->target->GetX(); i += 2*s){
+					index = k*dz + j*dy + i;
+					for(x = i; x < i + s && x < _filter->target->GetX(); x++, index++){
+						count = 0;
+						if(x - d >= 0 && x - d < _filter->target->GetX())
+							count += _filter->propergate(x-d,j,k,x,j,k,d,0,0,index-d*dx,index);
+						if(j - d >= 0 && j - d < _filter->target->GetY())
+							count += _filter->propergate(x,j-d,k,x,j,k,0,d,0,index-d*dy,index);
+						if(k - d >= 0 && k - d < _filter->target->GetZ())
+							count += _filter->propergate(x,j,k-d,x,j,k,0,0,d,index-d*dz,index);
+						if(count > 0)
+							_count++;
+					}
+				}
+			}
+		}
+	}
+};
+
+class irtkMultiThreadedMAPatchMatchRandomSearch
+{
+	/// Pointer to patchmatch
+	irtkMAPatchMatch *_filter;
+
+public:
+
+	/// Number of links changed
+	int _count;
+
+	irtkMultiThreadedMAPatchMatchRandomSearch(irtkMAPatchMatch *filter){
+		_filter = filter;
+		_count = 0;
+	}
+
+	irtkMultiThreadedMAPatchMatchRandomSearch(irtkMultiThreadedMAPatchMatchRandomSearch &r, split){
+		_filter = r._filter;
+		_count = 0;
+	}
+
+	void join(irtkMultiThreadedMAPatchMatchRandomSearch &rhs){
+		_count += rhs._count;
+	}
+
+	void operator()(const blocked_range<int> &r){
+		int i, j, k, o, index;
+
+		for(k = r.begin(); k != r.end(); k++){
+			index = k*_filter->target->GetX()*_filter->target->GetY();
+			for(j = 0; j < _filter->target->GetY(); j++){
+				for(i = 0; i < _filter->target->GetX(); i++){
+					for(o = 0; o < _filter->nneighbour; o++){
+						if(_filter->randomlink(i,j,k,o,index,_filter->randompass) > 0){
+							_count++;
+						}
+					}
+					index++;
+				}
+			}
+		}
+	}
+};
+
 irtkMAPatchMatch::irtkMAPatchMatch(irtkGreyImage *target, irtkGreyImage **source, int radius, int nimages, int nneighbour){
 
 	this->target = target;
@@ -25,6 +176,9 @@ irtkMAPatchMatch::irtkMAPatchMatch(irtkGreyImage *target, irtkGreyImage **source
 	this->nneighbour = nneighbour;
 	this->randomrate = 0.5;
 	this->debug = false;
+	this->randomseed = time(NULL);
+	this->randompass = 0;
+	this->jumpstep = 1;
 	short minvalue, maxvalue;
 	target->GetMinMax(&minvalue, &maxvalue);
 	maxdistance = maxvalue - minvalue;
@@ -72,12 +226,15 @@ void irtkMAPatchMatch::initialguess(){
 	srand ( time(NULL) );
 	int index = 0;
 	double x,y,z;
+	unsigned int state;
 	for(int k = 0; k < target->GetZ(); k++){
 		for(int j = 0; j < target->GetY(); j++){
 			for(int i = 0; i < target->GetX(); i++){
 				for(int n = 0; n < nneighbour; n++){
 					//TODO need to change this if source dimention != target dimention
-					nnfs[index][n].n = rand()%nimages;
+					// the atlas is drawn from the random sequence of the link, like the random search
+					state = patchmatchseed(randomseed, -1, index*nneighbour + n);
+					nnfs[index][n].n = patchmatchrandom(state)%nimages;
 					x = i;
 					y = j;
 					z = k;
@@ -130,6 +287,8 @@ void irtkMAPatchMatch::run(int maxiterations){
 
 	localweight = this->initialize();
 
+	this->initializejumpstep();
+
 	cout << "minimizing NNF..." << endl;
 
 	//debug tmpflow
@@ -191,41 +350,51 @@ double irtkMAPatchMatch::initialize(){
 
 	cout << "initialize NNF's weight...";
 	cout.flush();
-	double totalweight = 0;
-	/// recalculate of the fields
-	int index = 0, iteration;
-	for(int k = 0; k < target->GetZ(); k++){
-		for(int j = 0; j < target->GetY(); j++){
-			for(int i = 0; i < target->GetX(); i++){
-				for(int n = 0; n < nneighbour; n++){
-					double difference = this->distance(i,j,k,
-						nnfs[index][n].x,nnfs[index][n].y,
-						nnfs[index][n].z,nnfs[index][n].n);
+	double totalweight = this->initializeweights();
+	cout << "done" << endl;
 
-					nnfs[index][n].weight = difference;
+	return totalweight;
+}
 
-					// if weight == maxdistance, the link is not good try to find a better link
-					iteration = 0;
-					while(nnfs[index][n].weight >= maxdistance && iteration < 10){
-						randomlink(i,j,k, n, index);
-						iteration++;
-					}
-					totalweight += nnfs[index][n].weight;
-				}
-				index++;
-			}
+/// calculate the weight of the initial fields, in parallel
+double irtkMAPatchMatch::initializeweights(){
+	irtkMultiThreadedMAPatchMatchInitialize body(this);
+
+	task_scheduler_init init(tbb_no_threads);
+	parallel_for(blocked_range<int>(0, target->GetZ()), body);
+	init.terminate();
+
+	// each try of the random search uses its own sequence
+	randompass += 10;
+
+	double totalweight = 0;
+	for(int index = 0; index < target->GetNumberOfVoxels(); index++){
+		for(int n = 0; n < nneighbour; n++){
+			totalweight += nnfs[index][n].weight;
 		}
 	}
-	cout << "done" << endl;
 
 	return totalweight;
 }
 
-int irtkMAPatchMatch::randomlink(int i, int j, int k, int o, int index){
+/// reset the jump flooding step to the largest power of two below an eighth of the image size
+void irtkMAPatchMatch::initializejumpstep(){
+	int size = min(target->GetX(), target->GetY());
+	if(target->GetZ() > 1)
+		size = min(size, target->GetZ());
+
+	jumpstep = 1;
+	while(2*jumpstep <= size/8)
+		jumpstep *= 2;
+}
+
+int irtkMAPatchMatch::randomlink(int i, int j, int k, int o, int index, int pass){
 	int x, y, z, n, ti, tj, tk, tn, wi, wj, wk, count;
 	if(index < 0)
 		index = target->VoxelToIndex(i,j,k);
 	double dp;
+	// every voxel has its own random sequence, independent of the order of the voxels
+	unsigned int state = patchmatchseed(randomseed, pass, index*nneighbour + o);
 
 	count = 0;
 
@@ -257,11 +426,11 @@ int irtkMAPatchMatch::randomlink(int i, int j, int k, int o, int index){
 
 			n = tn;
 
-			x = ti + rand()%(2*wi+1)-wi;
-			y = tj + rand()%(2*wi+1)-wi;
+			x = ti + patchmatchrandom(state)%(2*wi+1)-wi;
+			y = tj + patchmatchrandom(state)%(2*wi+1)-wi;
 
 			if(target->GetZ() > 1)
-				z = tk + rand()%(2*wi+1)-wi;
+				z = tk + patchmatchrandom(state)%(2*wi+1)-wi;
 			else
 				z = tk;
 
@@ -304,11 +473,11 @@ int irtkMAPatchMatch::randomlink(int i, int j, int k, int o, int index){
 
 		while(wi>0) {
 
-			n = rand()%nimages;
+			n = patchmatchrandom(state)%nimages;
 
-			x = ti + rand()%(2*wi+1)-wi;
-			y = tj + rand()%(2*wi+1)-wi;
-			z = tk + rand()%(2*wi+1)-wi;
+			x = ti + patchmatchrandom(state)%(2*wi+1)-wi;
+			y = tj + patchmatchrandom(state)%(2*wi+1)-wi;
+			z = tk + patchmatchrandom(state)%(2*wi+1)-wi;
 
 			if(x < 0) x = 0;
 			if(y < 0) y = 0;
@@ -347,136 +516,75 @@ int irtkMAPatchMatch::randomlink(int i, int j, int k, int o, int index){
 }
 
 
-/// find minum flow
-double irtkMAPatchMatch::minimizeflow(){
-	int i,j,k, x,y,z,fcount, bcount, rcount, count, index,index1,index2,index3;
-	double sumweight = 0;
-	/// Forward propergation
-	fcount = 0;
-	index = 0;
-	//x-1
-	index1 = -1;
-	//y-1
-	index2 = -target->GetX();
-	//z-1
-	index3 = -target->GetX()*target->GetY();
-	for(int k = 0; k < target->GetZ(); k++){
-		for(int j = 0; j < target->GetY(); j++){
-			for(int i = 0; i < target->GetX(); i++){
-				count = 0;
-				//propergate from x - 1
-				if(i > 0){
-					x = i -1;
-					y = j;
-					z = k;
-					count += this->propergate(x,y,z,i,j,k,1,0,0,index1,index);
-				}
-				//propergate from y - 1
-				if(j > 0){
-					x = i;
-					y = j - 1;
-					z = k;
-					count += this->propergate(x,y,z,i,j,k,0,1,0,index2,index);
-				}
-				//propergate from z - 1
-				if(k > 0){
-					x = i;
-					y = j;
-					z = k - 1;
-					count += this->propergate(x,y,z,i,j,k,0,0,1,index3,index);
-				}
+/// propergate from the neighbours at the given distance to all voxels
+int irtkMAPatchMatch::propergation(int step, bool reverse){
+	int colour, count = 0;
 
-				if(count > 0)
-					fcount ++;
+	// red-black ordering: the voxels of one colour only propergate from the
+	// voxels of the other colour, so that all voxels of a colour can be updated
+	// in parallel
+	for(int c = 0; c < 2; c++){
+		colour = (reverse == true) ? 1 - c : c;
 
-				index++;
-				index1++;
-				index2++;
-				index3++;
-			}
-		}
-	}
+		irtkMultiThreadedMAPatchMatchPropagation body(this, step, colour, (reverse == true) ? -1 : 1);
 
-	/// Random search
-	rcount = 0;
-	index = 0;
-	for(int k = 0; k < target->GetZ(); k++){
-		for(int j = 0; j < target->GetY(); j++){
-			for(int i = 0; i < target->GetX(); i++){
-				for(int o = 0; o < nneighbour; o++){
-					if(this->randomlink(i,j,k,o,index) > 0){
-						rcount++;
-					}
-				}
-				index++;
-			}
-		}
+		task_scheduler_init init(tbb_no_threads);
+		parallel_reduce(blocked_range<int>(0, target->GetZ()), body);
+		init.terminate();
+
+		count += body._count;
 	}
 
-	/// Backward propergation
-	bcount = 0;
-	index = target->GetNumberOfVoxels() - 1;
-	//x-1
-	index1 = index+1;
-	//y-1
-	index2 = index+target->GetX();
-	//z-1
-	index3 = index+target->GetX()*target->GetY();
-	for(int k = target->GetZ() - 1; k >= 0; k--){
-		for(int j = target->GetY() - 1; j >= 0; j--){
-			for(int i = target->GetX() - 1; i >=0 ; i--){
-				count = 0;
-				//propergate from x + 1
-				if(i < target->GetX() - 1){
-					x = i + 1;
-					y = j;
-					z = k;
-					count += this->propergate(x,y,z,i,j,k,-1,0,0,index1,index);
-				}
-				//propergate from y + 1
-				if(j < target->GetY() - 1){
-					x = i;
-					y = j + 1;
-					z = k;
-					count += this->propergate(x,y,z,i,j,k,0,-1,0,index2,index);
-				}
-				//propergate from z + 1
-				if(k < target->GetZ() - 1){
-					x = i;
-					y = j;
-					z = k + 1;
-					count += this->propergate(x,y,z,i,j,k,0,0,-1,index3,index);
-				}
+	return count;
+}
 
-				if(count > 0)
-					bcount ++;
+/// random search for all voxels
+int irtkMAPatchMatch::randomsearch(){
+	irtkMultiThreadedMAPatchMatchRandomSearch body(this);
 
-				index--;
-				index1--;
-				index2--;
-				index3--;
-			}
-		}
-	}
+	task_scheduler_init init(tbb_no_threads);
+	parallel_reduce(blocked_range<int>(0, target->GetZ()), body);
+	init.terminate();
+
+	randompass++;
+
+	return body._count;
+}
+
+/// one iteration of propergation and random search
+double irtkMAPatchMatch::searchflow(int &fcount, int &bcount, int &rcount){
+	double sumweight = 0;
+
+	/// Forward propergation from distant neighbours, the distance halves every iteration (jump flooding)
+	fcount = this->propergation(jumpstep, false);
+	if(jumpstep > 1)
+		jumpstep /= 2;
 
 	/// Random search
-	index = 0;
-	for(int k = 0; k < target->GetZ(); k++){
-		for(int j = 0; j < target->GetY(); j++){
-			for(int i = 0; i < target->GetX(); i++){
-				for(int o = 0; o < nneighbour; o++){
-					if(this->randomlink(i,j,k,o,index) > 0){
-						rcount++;
-					}
-					if(this->nnfs[index][o].weight < maxdistance - 1){
-						sumweight += this->nnfs[index][o].weight;
-					}
-				}
-				index++;
+	rcount = this->randomsearch();
+
+	/// Backward propergation from direct neighbours
+	bcount = this->propergation(1, true);
+
+	/// Random search
+	rcount += this->randomsearch();
+
+	for(int index = 0; index < target->GetNumberOfVoxels(); index++){
+		for(int o = 0; o < nneighbour; o++){
+			if(this->nnfs[index][o].weight < maxdistance - 1){
+				sumweight += this->nnfs[index][o].weight;
 			}
 		}
 	}
 
+	return sumweight;
+}
+
+/// find minum flow
+double irtkMAPatchMatch::minimizeflow(){
+	int fcount, bcount, rcount;
+	double sumweight = this->searchflow(fcount, bcount, rcount);
+
 	cout << "number of fields changed: " << fcount << " " << bcount << " " << rcount << " ";
 
 	if(debug == true){
@@ -571,7 +679,7 @@ double irtkMAPatchMatch::minimizeflowwithdebug(){
 		for(int j = 0; j < target->GetY(); j++){
 			for(int i = 0; i < target->GetX(); i++){
 				for(int o = 0; o < nneighbour; o++){
-					if(this->randomlink(i,j,k,o,index) > 0){
+					if(this->randomlink(i,j,k,o,index,randompass) > 0){
 						rcount++;
 					}
 				}
@@ -581,6 +689,7 @@ double irtkMAPatchMatch::minimizeflowwithdebug(){
 		if(k%4 == 0)
 			this->voteweight(k,1);
 	}
+	randompass++;
 
 	/// Backward propergation
 	bcount = 0;
@@ -636,7 +745,7 @@ double irtkMAPatchMatch::minimizeflowwithdebug(){
 		for(int j = 0; j < target->GetY(); j++){
 			for(int i = 0; i < target->GetX(); i++){
 				for(int o = 0; o < nneighbour; o++){
-					if(this->randomlink(i,j,k,o,index) > 0){
+					if(this->randomlink(i,j,k,o,index,randompass) > 0){
 						rcount++;
 					}
 					if(this->nnfs[index][o].weight < maxdistance - 1){
@@ -649,6 +758,7 @@ double irtkMAPatchMatch::minimizeflowwithdebug(){
 		if(k%4 == 0)
 			this->voteweight(k,3);
 	}
+	randompass++;
 
 	cout << "number of fields changed: " << fcount << " " << bcount << " " << rcount << " ";
 
@@ -791,44 +901,80 @@ double irtkMAPatchMatch::distance(int x1, int y1, int z1, int x2, int y2, int z2
 		return maxdistance - 1;
 	}
 
-	for(k = - tmpradiusz; k <= tmpradiusz; k+=increase){
-		k1 = k + z1;
-		k2 = k + z2;
-		for(j = -tmpradiusy; j <= tmpradiusy; j+=increase){
-			j1 = j + y1;
-			j2 = j + y2;
-			for(i = -tmpradiusx; i <= tmpradiusx; i+=increase){
-				i1 = i + x1;
-				i2 = i + x2;
-				if(i1 < 0|| i2 < 0 ||
-					(i1 > target->GetX() - 1) 
-					|| (i2 > sources[n]->GetX() - 1)
-					|| j1 < 0|| j2 < 0
-					|| (j1 > target->GetY() - 1) 
-					|| (j2 > sources[n]->GetY() - 1)
-					|| k1 < 0|| k2 < 0
-					|| (k1 > target->GetZ() - 1) 
-					|| (k2 > sources[n]->GetZ() - 1)){
-						dif += maxdistance*4;
-						count += 4;
-				}else{
-					//reconstructed image not just decimated image
-					value1 = target->Get(i1,j1,k1);
-					if(value1 >= 0){		
-						values = sources[n]->Get(i2,j2,k2);
-						tmp = double(value1 - values);
-						dif += sqrt(tmp*tmp);
+	if(x1 - tmpradiusx >= 0 && x1 + tmpradiusx < target->GetX()
+		&& y1 - tmpradiusy >= 0 && y1 + tmpradiusy < target->GetY()
+		&& z1 - tmpradiusz >= 0 && z1 + tmpradiusz < target->GetZ()
+		&& x2 - tmpradiusx >= 0 && x2 + tmpradiusx < sources[n]->GetX()
+		&& y2 - tmpradiusy >= 0 && y2 + tmpradiusy < sources[n]->GetY()
+		&& z2 - tmpradiusz >= 0 && z2 + tmpradiusz < sources[n]->GetZ()){
+		// both patches are inside the images, walk along the rows with pointers
+		short *ptr1, *ptr2, *gptr1, *gptr2;
+		int frame1 = target->GetNumberOfVoxels();
+		int frame2 = sources[n]->GetNumberOfVoxels();
+
+		for(k = - tmpradiusz; k <= tmpradiusz; k++){
+			for(j = -tmpradiusy; j <= tmpradiusy; j++){
+				ptr1  = target->GetPointerToVoxels(x1 - tmpradiusx, y1 + j, z1 + k);
+				ptr2  = sources[n]->GetPointerToVoxels(x2 - tmpradiusx, y2 + j, z2 + k);
+				gptr1 = targetgradient->GetPointerToVoxels(x1 - tmpradiusx, y1 + j, z1 + k);
+				gptr2 = sourcesgradient[n]->GetPointerToVoxels(x2 - tmpradiusx, y2 + j, z2 + k);
+				for(i = -tmpradiusx; i <= tmpradiusx; i++){
+					if(*ptr1 >= 0){
+						dif += fabs(double(*ptr1 - *ptr2));
 						count++;
 						//distance between gradient
 						for(g = 0; g < 3; g++){
-							value1 = targetgradient->Get(i1,j1,k1,g);
-							value2 = sourcesgradient[n]->Get(i2,j2,k2,g);
-							tmp = double(value1 - value2);
-							dif += sqrt(tmp*tmp);
+							dif += fabs(double(gptr1[g*frame1] - gptr2[g*frame2]));
 							count++;
 						}
 					}
-				}	
+					ptr1++;
+					ptr2++;
+					gptr1++;
+					gptr2++;
+				}
+			}
+		}
+	}else{
+		for(k = - tmpradiusz; k <= tmpradiusz; k+=increase){
+			k1 = k + z1;
+			k2 = k + z2;
+			for(j = -tmpradiusy; j <= tmpradiusy; j+=increase){
+				j1 = j + y1;
+				j2 = j + y2;
+				for(i = -tmpradiusx; i <= tmpradiusx; i+=increase){
+					i1 = i + x1;
+					i2 = i + x2;
+					if(i1 < 0|| i2 < 0 ||
+						(i1 > target->GetX() - 1) 
+						|| (i2 > sources[n]->GetX() - 1)
+						|| j1 < 0|| j2 < 0
+						|| (j1 > target->GetY() - 1) 
+						|| (j2 > sources[n]->GetY() - 1)
+						|| k1 < 0|| k2 < 0
+						|| (k1 > target->GetZ() - 1) 
+						|| (k2 > sources[n]->GetZ() - 1)){
+							dif += maxdistance*4;
+							count += 4;
+					}else{
+						//reconstructed image not just decimated image
+						value1 = target->Get(i1,j1,k1);
+						if(value1 >= 0){		
+							values = sources[n]->Get(i2,j2,k2);
+							tmp = double(value1 - values);
+							dif += fabs(tmp);
+							count++;
+							//distance between gradient
+							for(g = 0; g < 3; g++){
+								value1 = targetgradient->Get(i1,j1,k1,g);
+								value2 = sourcesgradient[n]->Get(i2,j2,k2,g);
+								tmp = double(value1 - value2);
+								dif += fabs(tmp);
+								count++;
+							}
+						}
+					}	
+				}
 			}
 		}
 	}
@@ -247,133 +247,8 @@ double irtkMAPatchMatchSegmentation::minimizeflow(){
 	if(debug == true)
 		cout << "irtkMAPatchMatchSegmentation::minimizeflow" << endl;
 
-	int i,j,k, x,y,z,fcount, bcount, rcount, count, index,index1,index2,index3;
-	double sumweight = 0;
-	/// Forward propergation
-	fcount = 0;
-	index = 0;
-	//x-1
-	index1 = -1;
-	//y-1
-	index2 = -target->GetX();
-	//z-1
-	index3 = -target->GetX()*target->GetY();
-	for(int k = 0; k < target->GetZ(); k++){
-		for(int j = 0; j < target->GetY(); j++){
-			for(int i = 0; i < target->GetX(); i++){
-				count = 0;
-				//propergate from x - 1
-				if(i > 0){
-					x = i -1;
-					y = j;
-					z = k;
-					count += this->propergate(x,y,z,i,j,k,1,0,0,index1,index);
-				}
-				//propergate from y - 1
-				if(j > 0){
-					x = i;
-					y = j - 1;
-					z = k;
-					count += this->propergate(x,y,z,i,j,k,0,1,0,index2,index);
-				}
-				//propergate from z - 1
-				if(k > 0){
-					x = i;
-					y = j;
-					z = k - 1;
-					count += this->propergate(x,y,z,i,j,k,0,0,1,index3,index);
-				}
-
-				if(count > 0)
-					fcount ++;
-
-				index++;
-				index1++;
-				index2++;
-				index3++;
-			}
-		}
-	}
-
-	/// Random search
-	rcount = 0;
-	index = 0;
-	for(int k = 0; k < target->GetZ(); k++){
-		for(int j = 0; j < target->GetY(); j++){
-			for(int i = 0; i < target->GetX(); i++){
-				for(int o = 0; o < nneighbour; o++){
-					if(this->randomlink(i,j,k,o,index) > 0){
-						rcount++;
-					}
-				}
-				index++;
-			}
-		}
-	}
-
-	/// Backward propergation
-	bcount = 0;
-	index = target->GetNumberOfVoxels() - 1;
-	//x-1
-	index1 = index+1;
-	//y-1
-	index2 = index+target->GetX();
-	//z-1
-	index3 = index+target->GetX()*target->GetY();
-	for(int k = target->GetZ() - 1; k >= 0; k--){
-		for(int j = target->GetY() - 1; j >= 0; j--){
-			for(int i = target->GetX() - 1; i >=0 ; i--){
-				count = 0;
-				//propergate from x + 1
-				if(i < target->GetX() - 1){
-					x = i + 1;
-					y = j;
-					z = k;
-					count += this->propergate(x,y,z,i,j,k,-1,0,0,index1,index);
-				}
-				//propergate from y + 1
-				if(j < target->GetY() - 1){
-					x = i;
-					y = j + 1;
-					z = k;
-					count += this->propergate(x,y,z,i,j,k,0,-1,0,index2,index);
-				}
-				//propergate from z + 1
-				if(k < target->GetZ() - 1){
-					x = i;
-					y = j;
-					z = k + 1;
-					count += this->propergate(x,y,z,i,j,k,0,0,-1,index3,index);
-				}
-
-				if(count > 0)
-					bcount ++;
-
-				index--;
-				index1--;
-				index2--;
-				index3--;
-			}
-		}
-	}
-
-	/// Random search
-	index = 0;
-	for(int k = 0; k < target->GetZ(); k++){
-		for(int j = 0; j < target->GetY(); j++){
-			for(int i = 0; i < target->GetX(); i++){
-				for(int o = 0; o < nneighbour; o++){
-					if(this->randomlink(i,j,k,o,index) > 0){
-						rcount++;
-					}
-					if(this->nnfs[index][o].weight < maxdistance - 1){
-						sumweight += this->nnfs[index][o].weight;
-					}
-				}
-				index++;
-			}
-		}
-	}
+	int fcount, bcount, rcount;
+	double sumweight = this->searchflow(fcount, bcount, rcount);
 
 	cout << "number of fields changed: " << fcount << " " << bcount << " " << rcount << " ";
 
@@ -459,12 +334,15 @@ void irtkMAPatchMatchSegmentation::initialguess(){
 	srand ( time(NULL) );
 	int index = 0;
 	double x,y,z;
+	unsigned int state;
 	for(int k = 0; k < target->GetZ(); k++){
 		for(int j = 0; j < target->GetY(); j++){
 			for(int i = 0; i < target->GetX(); i++){
 				for(int n = 0; n < nneighbour; n++){
 					//TODO need to change this if source dimention != target dimention
-					nnfs[index][n].n = rand()%nimages;
+					// the atlas is drawn from the random sequence of the link, like the random search
+					state = patchmatchseed(randomseed, -1, index*nneighbour + n);
+					nnfs[index][n].n = patchmatchrandom(state)%nimages;
 					//x = rand()%target->GetX();
 					//y = rand()%target->GetY();
 					//z = rand()%target->GetZ();
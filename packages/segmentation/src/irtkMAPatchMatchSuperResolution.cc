@@ -64,6 +64,8 @@ void irtkMAPatchMatchSuperResolution::runEMIteration(int maxiterations){
 
 	localweight = this->initialize();
 
+	this->initializejumpstep();
+
 	cout << "minimizing NNF..." << endl;
 
 	//debug tmpflow
@@ -146,31 +148,7 @@ double irtkMAPatchMatchSuperResolution::initialize(){
 
 	cout << "initialize NNF's weight...";
 	cout.flush();
-	double totalweight = 0;
-	/// recalculate of the fields
-	int index = 0, iteration;
-	for(int k = 0; k < target->GetZ(); k++){
-		for(int j = 0; j < target->GetY(); j++){
-			for(int i = 0; i < target->GetX(); i++){
-				for(int n = 0; n < nneighbour; n++){
-					double difference = this->distance(i,j,k,
-						nnfs[index][n].x,nnfs[index][n].y,
-						nnfs[index][n].z,nnfs[index][n].n);
-
-					nnfs[index][n].weight = difference;
-
-					// if weight == maxdistance, the link is not good try to find a better link
-					iteration = 0;
-					while(nnfs[index][n].weight >= maxdistance && iteration < 10){
-						randomlink(i,j,k, n, index);
-						iteration++;
-					}
-					totalweight += nnfs[index][n].weight;
-				}
-				index++;
-			}
-		}
-	}
+	double totalweight = this->initializeweights();
 	cout << "done" << endl;
 
 	return totalweight;
@@ -261,133 +239,8 @@ void irtkMAPatchMatchSuperResolution::EMstep(){
 
 /// find minum flow
 double irtkMAPatchMatchSuperResolution::minimizeflow(){
-	int i,j,k, x,y,z,fcount, bcount, rcount, count, index,index1,index2,index3;
-	double sumweight = 0;
-	/// Forward propergation
-	fcount = 0;
-	index = 0;
-	//x-1
-	index1 = -1;
-	//y-1
-	index2 = -target->GetX();
-	//z-1
-	index3 = -target->GetX()*target->GetY();
-	for(int k = 0; k < target->GetZ(); k++){
-		for(int j = 0; j < target->GetY(); j++){
-			for(int i = 0; i < target->GetX(); i++){
-				count = 0;
-				//propergate from x - 1
-				if(i > 0){
-					x = i -1;
-					y = j;
-					z = k;
-					count += this->propergate(x,y,z,i,j,k,1,0,0,index1,index);
-				}
-				//propergate from y - 1
-				if(j > 0){
-					x = i;
-					y = j - 1;
-					z = k;
-					count += this->propergate(x,y,z,i,j,k,0,1,0,index2,index);
-				}
-				//propergate from z - 1
-				if(k > 0){
-					x = i;
-					y = j;
-					z = k - 1;
-					count += this->propergate(x,y,z,i,j,k,0,0,1,index3,index);
-				}
-
-				if(count > 0)
-					fcount ++;
-
-				index++;
-				index1++;
-				index2++;
-				index3++;
-			}
-		}
-	}
-
-	/// Random search
-	rcount = 0;
-	index = 0;
-	for(int k = 0; k < target->GetZ(); k++){
-		for(int j = 0; j < target->GetY(); j++){
-			for(int i = 0; i < target->GetX(); i++){
-				for(int o = 0; o < nneighbour; o++){
-					if(this->randomlink(i,j,k,o,index) > 0){
-						rcount++;
-					}
-				}
-				index++;
-			}
-		}
-	}
-
-	/// Backward propergation
-	bcount = 0;
-	index = target->GetNumberOfVoxels() - 1;
-	//x-1
-	index1 = index+1;
-	//y-1
-	index2 = index+target->GetX();
-	//z-1
-	index3 = index+target->GetX()*target->GetY();
-	for(int k = target->GetZ() - 1; k >= 0; k--){
-		for(int j = target->GetY() - 1; j >= 0; j--){
-			for(int i = target->GetX() - 1; i >=0 ; i--){
-				count = 0;
-				//propergate from x + 1
-				if(i < target->GetX() - 1){
-					x = i + 1;
-					y = j;
-					z = k;
-					count += this->propergate(x,y,z,i,j,k,-1,0,0,index1,index);
-				}
-				//propergate from y + 1
-				if(j < target->GetY() - 1){
-					x = i;
-					y = j + 1;
-					z = k;
-					count += this->propergate(x,y,z,i,j,k,0,-1,0,index2,index);
-				}
-				//propergate from z + 1
-				if(k < target->GetZ() - 1){
-					x = i;
-					y = j;
-					z = k + 1;
-					count += this->propergate(x,y,z,i,j,k,0,0,-1,index3,index);
-				}
-
-				if(count > 0)
-					bcount ++;
-
-				index--;
-				index1--;
-				index2--;
-				index3--;
-			}
-		}
-	}
-
-	/// Random search
-	index = 0;
-	for(int k = 0; k < target->GetZ(); k++){
-		for(int j = 0; j < target->GetY(); j++){
-			for(int i = 0; i < target->GetX(); i++){
-				for(int o = 0; o < nneighbour; o++){
-					if(this->randomlink(i,j,k,o,index) > 0){
-						rcount++;
-					}
-					if(this->nnfs[index][o].weight < maxdistance - 1){
-						sumweight += this->nnfs[index][o].weight;
-					}
-				}
-				index++;
-			}
-		}
-	}
+	int fcount, bcount, rcount;
+	double sumweight = this->searchflow(fcount, bcount, rcount);
 
 	cout << "number of fields changed: " << fcount << " " << bcount << " " << rcount << " ";
 
@@ -590,7 +443,7 @@ double irtkMAPatchMatchSuperResolution::minimizeflowwithdebug(){
 		for(int j = 0; j < target->GetY(); j++){
 			for(int i = 0; i < target->GetX(); i++){
 				for(int o = 0; o < nneighbour; o++){
-					if(this->randomlink(i,j,k,o,index) > 0){
+					if(this->randomlink(i,j,k,o,index,randompass) > 0){
 						rcount++;
 					}
 				}
@@ -600,6 +453,7 @@ double irtkMAPatchMatchSuperResolution::minimizeflowwithdebug(){
 		if(k%4 == 0)
 			this->voteweight(k,1);
 	}
+	randompass++;
 
 	/// Backward propergation
 	bcount = 0;
@@ -655,7 +509,7 @@ double irtkMAPatchMatchSuperResolution::minimizeflowwithdebug(){
 		for(int j = 0; j < target->GetY(); j++){
 			for(int i = 0; i < target->GetX(); i++){
 				for(int o = 0; o < nneighbour; o++){
-					if(this->randomlink(i,j,k,o,index) > 0){
+					if(this->randomlink(i,j,k,o,index,randompass) > 0){
 						rcount++;
 					}
 					if(this->nnfs[index][o].weight < maxdistance - 1){
@@ -668,6 +522,7 @@ double irtkMAPatchMatchSuperResolution::minimizeflowwithdebug(){
 		if(k%4 == 0)
 			this->voteweight(k,3);
 	}
+	randompass++;
 
 	cout << "number of fields changed: " << fcount << " " << bcount << " " << rcount << " ";
 
@@ -8,6 +8,377 @@
 #include<irtkPatchBasedSegmentation.h>
 #include<math.h>
 
+// Maximum number of patch distances and label weights of the slabs of voxels which are segmented together
+#define PATCH_SLAB_SIZE 16777216
+
+class irtkMultiThreadedPatchBasedSegmentationBoxSum
+{
+	/// Blocks of voxels, the second block is optional
+	double *_data1, *_data2;
+
+	/// Size of blocks
+	int _x, _y, _z;
+
+	/// Rows and slices of the blocks whose sums are needed
+	int _y1, _y2, _z1, _z2;
+
+	/// Radius of box
+	int _radius;
+
+	/// Axis along which the voxels are summed
+	int _axis;
+
+public:
+
+	irtkMultiThreadedPatchBasedSegmentationBoxSum(double *data1, double *data2, int x, int y, int z, int y1, int y2, int z1, int z2, int radius, int axis){
+		_data1 = data1;
+		_data2 = data2;
+		_x = x;
+		_y = y;
+		_z = z;
+		_y1 = y1;
+		_y2 = y2;
+		_z1 = z1;
+		_z2 = z2;
+		_radius = radius;
+		_axis = axis;
+	}
+
+	/// Sum along one line using its running sum, boxes are clipped at the ends of the line and only [i1, i2) is written
+	void SumLine(double *ptr, int n, int stride, int i1, int i2, double *sum) const{
+		int i;
+
+		sum[0] = 0;
+		for(i = 0; i < n; i++){
+			sum[i+1] = sum[i] + ptr[i*stride];
+		}
+		for(i = i1; i < i2; i++){
+			ptr[i*stride] = sum[min(i + _radius, n - 1) + 1] - sum[max(i - _radius, 0)];
+		}
+	}
+
+	void operator()(const blocked_range<int> &r) const{
+		int l, x, y, z, offset;
+		vector<double> sum(max(_x, max(_y, _z)) + 1);
+
+		// lines along x are processed by row of the blocks, lines along y by
+		// column of all slices and lines along z by column of the needed rows
+		for(l = r.begin(); l != r.end(); l++){
+			if(_axis == 0){
+				offset = l*_x;
+				this->SumLine(_data1 + offset, _x, 1, 0, _x, &sum[0]);
+				if(_data2 != NULL) this->SumLine(_data2 + offset, _x, 1, 0, _x, &sum[0]);
+			}else if(_axis == 1){
+				x = l % _x;
+				z = l / _x;
+				offset = z*_y*_x + x;
+				this->SumLine(_data1 + offset, _y, _x, _y1, _y2, &sum[0]);
+				if(_data2 != NULL) this->SumLine(_data2 + offset, _y, _x, _y1, _y2, &sum[0]);
+			}else{
+				x = l % _x;
+				y = _y1 + l / _x;
+				offset = y*_x + x;
+				this->SumLine(_data1 + offset, _z, _x*_y, _z1, _z2, &sum[0]);
+				if(_data2 != NULL) this->SumLine(_data2 + offset, _z, _x*_y, _z1, _z2, &sum[0]);
+			}
+		}
+	}
+};
+
+class irtkMultiThreadedPatchBasedSegmentationMeasures
+{
+	/// Pointer to segmentation
+	irtkPatchBasedSegmentation *_filter;
+
+	/// Image or atlas
+	int _imageNo;
+
+	/// Sums of intensities of all patches
+	const double *_sum;
+
+public:
+
+	irtkMultiThreadedPatchBasedSegmentationMeasures(irtkPatchBasedSegmentation *filter, int imageNo, const double *sum){
+		_filter = filter;
+		_imageNo = imageNo;
+		_sum = sum;
+	}
+
+	void operator()(const blocked_range<int> &r) const{
+		int x, y, z, x1, y1, z1, index;
+		double mean, std;
+
+		int p = _filter->_patchSize;
+		int X = _filter->_image.GetX();
+		int Y = _filter->_image.GetY();
+		irtkRealImage *image = (_imageNo == 0) ? &_filter->_image : _filter->_atlases[_imageNo-1];
+		double ctr = (2*p+1)*(2*p+1)*(2*p+1);
+
+		for(z = r.begin(); z != r.end(); z++){
+			for(y = p; y < Y-(p+1); y++){
+				for(x = p; x < X-(p+1); x++){
+					if(_filter->_image.Get(x, y, z) > 0){
+						index = _filter->_image.VoxelToIndex(x, y, z);
+						mean = _sum[index];
+						if(_imageNo > 0 && mean<0)
+							mean = 0;
+						if(mean>0)
+							mean /= ctr;
+						// deviations are summed in the same order as before the
+						// means were box filtered, which gives the same rounding
+						std = 0;
+						for(x1 = x-p; x1<=x+p; x1++){
+							for(y1 = y-p; y1<=y+p; y1++){
+								for(z1 = z-p; z1<=z+p; z1++){
+									std += (image->Get(x1, y1, z1)-mean)*(image->Get(x1, y1, z1)-mean);
+								}
+							}
+						}
+						if(std>0){
+							std /= ctr;
+							std = sqrt(std);
+						}
+						_filter->_patchMean[_imageNo]->Put(x, y, z, mean);
+						_filter->_patchStd[_imageNo]->Put(x, y, z, std);
+					}
+				}
+			}
+		}
+	}
+};
+
+class irtkMultiThreadedPatchBasedSegmentationDifferences
+{
+	/// Pointer to segmentation
+	irtkPatchBasedSegmentation *_filter;
+
+	/// Rows and first slice of block
+	int _yb, _ye, _zb;
+
+	/// Atlas
+	int _atlasNo;
+
+	/// Offset of atlas patches
+	int _dx, _dy, _dz;
+
+	/// Squared differences and voxels compared
+	double *_ssd, *_count;
+
+public:
+
+	irtkMultiThreadedPatchBasedSegmentationDifferences(irtkPatchBasedSegmentation *filter, int yb, int ye, int zb, int atlasNo, int dx, int dy, int dz, double *ssd, double *count){
+		_filter = filter;
+		_yb = yb;
+		_ye = ye;
+		_zb = zb;
+		_atlasNo = atlasNo;
+		_dx = dx;
+		_dy = dy;
+		_dz = dz;
+		_ssd = ssd;
+		_count = count;
+	}
+
+	void operator()(const blocked_range<int> &r) const{
+		int l, x, y, z, index, val_image, val_atlas;
+		irtkRealPixel *iPtr;
+		irtkRealImage *atlas = _filter->_atlases[_atlasNo];
+
+		int X = _filter->_image.GetX();
+		int Y = _filter->_image.GetY();
+		int Z = _filter->_image.GetZ();
+
+		// rows of the block
+		for(l = r.begin(); l != r.end(); l++){
+			y = _yb + l % (_ye - _yb);
+			z = _zb + l / (_ye - _yb);
+			iPtr = _filter->_image.GetPointerToVoxels(0, y, z);
+			index = l*X;
+			for(x = 0; x < X; x++){
+				_ssd[index] = 0;
+				_count[index] = 0;
+				if(!( x+_dx < 0 || x+_dx >= X ||
+					y+_dy < 0 || y+_dy >= Y ||
+					z+_dz < 0 || z+_dz >= Z )){
+						val_atlas = atlas->Get(x+_dx, y+_dy, z+_dz);
+						val_image = *iPtr;
+						if(val_image > 0 && val_atlas > 0){
+							_ssd[index] = (val_atlas - val_image) * (val_atlas - val_image);
+							_count[index] = 1;
+						}
+				}
+				iPtr++;
+				index++;
+			}
+		}
+	}
+};
+
+class irtkMultiThreadedPatchBasedSegmentationDistances
+{
+	/// Pointer to segmentation
+	irtkPatchBasedSegmentation *_filter;
+
+	/// Rows and first slice of block of patch sums
+	int _yb, _ye, _zb;
+
+	/// Rows and first slice of slab
+	int _y1, _y2, _z1;
+
+	/// Atlas
+	int _atlasNo;
+
+	/// Offset of atlas patches
+	int _dx, _dy, _dz;
+
+	/// Patch sums
+	const double *_ssd, *_count;
+
+	/// Patch distance and minimum distance of each voxel of slab
+	double *_distance, *_h;
+
+public:
+
+	irtkMultiThreadedPatchBasedSegmentationDistances(irtkPatchBasedSegmentation *filter, int yb, int ye, int zb, int y1, int y2, int z1, int atlasNo, int dx, int dy, int dz,
+		const double *ssd, const double *count, double *distance, double *h){
+		_filter = filter;
+		_yb = yb;
+		_ye = ye;
+		_zb = zb;
+		_y1 = y1;
+		_y2 = y2;
+		_z1 = z1;
+		_atlasNo = atlasNo;
+		_dx = dx;
+		_dy = dy;
+		_dz = dz;
+		_ssd = ssd;
+		_count = count;
+		_distance = distance;
+		_h = h;
+	}
+
+	void operator()(const blocked_range<int> &r) const{
+		int l, x, y, z, index, block;
+		double val;
+
+		int X = _filter->_image.GetX();
+		int Y = _filter->_image.GetY();
+		int Z = _filter->_image.GetZ();
+
+		// rows of the slab
+		for(l = r.begin(); l != r.end(); l++){
+			y = _y1 + l % (_y2 - _y1);
+			z = _z1 + l / (_y2 - _y1);
+			index = l*X;
+			block = ((z - _zb)*(_ye - _yb) + y - _yb)*X;
+			for(x = 0; x < X; x++){
+				val = _filter->_maxVal;
+				if(_filter->IsForeground(x, y, z) &&
+					!( x+_dx < 0 || x+_dx >= X ||
+					y+_dy < 0 || y+_dy >= Y ||
+					z+_dz < 0 || z+_dz >= Z ) &&
+					_filter->IsCandidate(x, y, z, x+_dx, y+_dy, z+_dz, _atlasNo)){
+						val = _ssd[block] / _count[block];
+						if(val > 0 && val < _h[index]){
+							_h[index] = val;
+						}
+				}
+				_distance[index] = val;
+				index++;
+				block++;
+			}
+		}
+	}
+};
+
+class irtkMultiThreadedPatchBasedSegmentationWeights
+{
+	/// Pointer to segmentation
+	irtkPatchBasedSegmentation *_filter;
+
+	/// Rows and first slice of slab
+	int _y1, _y2, _z1;
+
+	/// Atlas
+	int _atlasNo;
+
+	/// Offset of atlas patches
+	int _dx, _dy, _dz;
+
+	/// Patch distance and minimum distance of each voxel of slab
+	const double *_distance, *_h;
+
+	/// Weights of labels, sum of weights of labels, weighted sum of atlas intensities and sum of weights of each voxel of slab
+	double *_probLabels, *_overallVal, *_hdVal, *_totalWeight;
+
+public:
+
+	irtkMultiThreadedPatchBasedSegmentationWeights(irtkPatchBasedSegmentation *filter, int y1, int y2, int z1, int atlasNo, int dx, int dy, int dz, const double *distance, const double *h,
+		double *probLabels, double *overallVal, double *hdVal, double *totalWeight){
+		_filter = filter;
+		_y1 = y1;
+		_y2 = y2;
+		_z1 = z1;
+		_atlasNo = atlasNo;
+		_dx = dx;
+		_dy = dy;
+		_dz = dz;
+		_distance = distance;
+		_h = h;
+		_probLabels = probLabels;
+		_overallVal = overallVal;
+		_hdVal = hdVal;
+		_totalWeight = totalWeight;
+	}
+
+	void operator()(const blocked_range<int> &r) const{
+		int l, x, y, z, index, label;
+		double val;
+
+		int X = _filter->_image.GetX();
+		int x_atlas, y_atlas, z_atlas;
+		irtkGreyImage *labels = _filter->_labels[_atlasNo];
+		irtkRealImage *atlas = _filter->_atlases[_atlasNo];
+
+		// rows of the slab
+		for(l = r.begin(); l != r.end(); l++){
+			y = _y1 + l % (_y2 - _y1);
+			z = _z1 + l / (_y2 - _y1);
+			for(x = 0; x < X; x++){
+				if(_filter->IsForeground(x, y, z)){
+					x_atlas = x + _dx;
+					y_atlas = y + _dy;
+					z_atlas = z + _dz;
+					index = l*X + x;
+					val = exp(-_distance[index]/(_h[index]));
+
+					label = _filter->_padding;
+					if(!( x_atlas < 0 ||   x_atlas  >= labels->GetX() ||
+						y_atlas < 0 || y_atlas >= labels->GetY() ||
+						z_atlas < 0 || z_atlas >= labels->GetZ() )){
+							label = labels->Get(x_atlas, y_atlas, z_atlas);
+					}
+					if(label > _filter->_padding){
+						_probLabels[index*_filter->_nrLabels+label] += val;
+						if(_filter->_winnerTakesAll && _probLabels[index*_filter->_nrLabels+label] < val){
+							_probLabels[index*_filter->_nrLabels+label] = val;
+						}
+						_overallVal[index] += val;
+					}
+
+					if(!( x_atlas < 0 ||   x_atlas  >= atlas->GetX() ||
+						y_atlas < 0 || y_atlas >= atlas->GetY() ||
+						z_atlas < 0 || z_atlas >= atlas->GetZ() )){
+							_hdVal[index] += atlas->Get(x_atlas, y_atlas, z_atlas) * val;
+							_totalWeight[index] += val;
+					}
+				}
+			}
+		}
+	}
+};
+
 irtkPatchBasedSegmentation::irtkPatchBasedSegmentation(irtkRealImage image, irtkRealImage ** atlases, irtkGreyImage ** labels, int nAtlases, int patchSize, int neighbourhoodsize){
 	_image = image;
 	_atlases = atlases;
@@ -22,13 +393,10 @@ irtkPatchBasedSegmentation::irtkPatchBasedSegmentation(irtkRealImage image, irtk
 	_segmentations = new irtkGreyImage*[nAtlases];
 	_verbose = 0;
 	_padding = -1;
-	_wMin = new double[_nAtlases];
 	_maxVal = 65000;
 	for(int i = 0 ; i < _nAtlases; i++){
 		_segmentations[i] = new irtkGreyImage;
 		_segmentations[i]->Initialize(_labels[0]->GetImageAttributes());
-		_wMin[i] = _maxVal;
-
 	}
 	_useMask = false;
 	_patchMeasuresAvailable = false;
@@ -51,145 +419,165 @@ int irtkPatchBasedSegmentation::GetNeighbourhoodSize(){
 
 
 
-double irtkPatchBasedSegmentation::EvaluatePatch(int x_image, int y_image, int z_image, int x_atlas, int y_atlas, int z_atlas, int atlasNo){
-	double w = 0;
-	int N = 0;
-	for(int x = -_patchSize; x <= _patchSize; x++){
-		for(int y = -_patchSize; y <= _patchSize; y++){
-			for(int z = -_patchSize; z <= _patchSize; z++){
-				if(!((x_atlas + x ) < 0 || ( x_atlas + x ) >= _image.GetX() ||
-					(y_atlas + y )< 0 || ( y_atlas + y ) >= _image.GetY() ||
-					(z_atlas + z )< 0 || (z_atlas + z )>= _image.GetZ() ||
-					(x_image + x )< 0 || (x_image + x )>= _image.GetX() ||
-					(y_image + y )< 0 || (y_image + y ) >= _image.GetY() ||
-					(z_image + z )< 0 || (z_image + z )>= _image.GetZ() )){
-						int val_atlas = _atlases[atlasNo]->Get(x_atlas+x, y_atlas+y, z_atlas+z);
-						int val_image = _image.Get(x_image+x, y_image+y, z_image+z);
-						if(val_image > 0 && val_atlas > 0 ){
-							w += (val_atlas - val_image) * (val_atlas - val_image);
-							N++ ;
-						}
+bool irtkPatchBasedSegmentation::IsCandidate(int x_image, int y_image, int z_image, int x_atlas, int y_atlas, int z_atlas, int atlasNo){
+	double my_i = _patchMean[0]->Get(x_image, y_image, z_image);
+	double sigma_i = _patchStd[0]->Get(x_image, y_image, z_image);
+	double my_a = _patchMean[atlasNo]->Get(x_atlas, y_atlas, z_atlas);
+	double sigma_a = _patchStd[atlasNo]->Get(x_atlas, y_atlas, z_atlas);
+	double ss = (2*my_i*my_a / (my_i*my_i + my_a*my_a)) * (2*sigma_i*sigma_a / (sigma_i*sigma_i + sigma_a*sigma_a));
+	return (ss>.95) && IsForeground(x_atlas, y_atlas, z_atlas);
+}
+
+void irtkPatchBasedSegmentation::BoxSum(double *data1, double *data2, int y, int z, int y1, int y2, int z1, int z2){
+	int X = _image.GetX();
+
+	// all rows are summed along x, as the sums along y and z need them, but
+	// only the needed rows are summed along y and the needed slices along z
+	irtkMultiThreadedPatchBasedSegmentationBoxSum xsum(data1, data2, X, y, z, y1, y2, z1, z2, _patchSize, 0);
+	parallel_for(blocked_range<int>(0, y*z), xsum);
+	irtkMultiThreadedPatchBasedSegmentationBoxSum ysum(data1, data2, X, y, z, y1, y2, z1, z2, _patchSize, 1);
+	parallel_for(blocked_range<int>(0, X*z), ysum);
+	irtkMultiThreadedPatchBasedSegmentationBoxSum zsum(data1, data2, X, y, z, y1, y2, z1, z2, _patchSize, 2);
+	parallel_for(blocked_range<int>(0, X*(y2 - y1)), zsum);
+}
+
+void irtkPatchBasedSegmentation::EvaluatePatches(int y1, int y2, int z1, int z2, int atlasNo, int dx, int dy, int dz, double *ssd, double *count){
+	// Patches of rows [y1, y2) of slices [z1, z2) cover the block of rows
+	// [yb, ye) of slices [zb, ze)
+	int yb = max(y1 - _patchSize, 0);
+	int ye = min(y2 + _patchSize, _image.GetY());
+	int zb = max(z1 - _patchSize, 0);
+	int ze = min(z2 + _patchSize, _image.GetZ());
+
+	// The squared differences are integers, so their box sums are the same as
+	// the sums over each patch
+	irtkMultiThreadedPatchBasedSegmentationDifferences differences(this, yb, ye, zb, atlasNo, dx, dy, dz, ssd, count);
+	parallel_for(blocked_range<int>(0, (ye - yb)*(ze - zb)), differences);
+
+	// The block around the slab is only needed for the sums of the patches of
+	// the slab, both blocks are summed in the same passes
+	this->BoxSum(ssd, count, ye - yb, ze - zb, y1 - yb, y2 - yb, z1 - zb, z2 - zb);
+}
+
+void irtkPatchBasedSegmentation::RunSlab(int y1, int y2, int z1, int z2){
+	int a, i, j, k, l, o, x, y, z, index;
+	double maxVal, maxLabel, combVal;
+
+	int X = _image.GetX();
+	int yb = max(y1 - _patchSize, 0);
+	int ye = min(y2 + _patchSize, _image.GetY());
+	int zb = max(z1 - _patchSize, 0);
+	int ze = min(z2 + _patchSize, _image.GetZ());
+	int nSlab = X*(y2 - y1)*(z2 - z1);
+	int nOffsets = (2*_neighbourhoodSize+1)*(2*_neighbourhoodSize+1)*(2*_neighbourhoodSize+1);
+
+	vector<double> ssd(X*(ye - yb)*(ze - zb)), count(X*(ye - yb)*(ze - zb));
+	vector<double> distance(nSlab*nOffsets*_nAtlases), h(nSlab, _maxVal);
+	vector<double> probLabels(nSlab*_nrLabels), overallVal(nSlab), hdVal(nSlab, 0), totalWeight(nSlab, 0);
+
+	// Distances of all atlas patches and smallest distance of each voxel
+	for(a = 0; a < _nAtlases; a++){
+		o = 0;
+		for(i = -_neighbourhoodSize; i <= _neighbourhoodSize; i++){
+			for(j = -_neighbourhoodSize; j <= _neighbourhoodSize; j++){
+				for(k = -_neighbourhoodSize; k <= _neighbourhoodSize; k++){
+					this->EvaluatePatches(y1, y2, z1, z2, a, i, j, k, &ssd[0], &count[0]);
+					irtkMultiThreadedPatchBasedSegmentationDistances distances(this, yb, ye, zb, y1, y2, z1, a, i, j, k, &ssd[0], &count[0],
+						&distance[(a*nOffsets + o)*nSlab], &h[0]);
+					parallel_for(blocked_range<int>(0, (y2 - y1)*(z2 - z1)), distances);
+					o++;
 				}
 			}
 		}
 	}
-	double ret_val = w / N;
-	return ret_val;
-}
 
+	// Weights of atlas patches, summed in the order of the atlas neighbourhood
+	for(a = 0; a < _nAtlases; a++){
+		probLabels.assign(probLabels.size(), 0);
+		overallVal.assign(overallVal.size(), 0);
+		o = 0;
+		for(i = -_neighbourhoodSize; i <= _neighbourhoodSize; i++){
+			for(j = -_neighbourhoodSize; j <= _neighbourhoodSize; j++){
+				for(k = -_neighbourhoodSize; k <= _neighbourhoodSize; k++){
+					irtkMultiThreadedPatchBasedSegmentationWeights weights(this, y1, y2, z1, a, i, j, k, &distance[(a*nOffsets + o)*nSlab], &h[0],
+						&probLabels[0], &overallVal[0], &hdVal[0], &totalWeight[0]);
+					parallel_for(blocked_range<int>(0, (y2 - y1)*(z2 - z1)), weights);
+					o++;
+				}
+			}
+		}
 
-
-void irtkPatchBasedSegmentation::EvaluateNeighbourhood(int x_image, int y_image, int z_image, int atlasNo, double *** tmpVals){
-
-	int xCtr = 0;
-	double my_i = _patchMean[0]->Get(x_image, y_image, z_image);
-	double sigma_i = _patchStd[0]->Get(x_image, y_image, z_image);
-	irtkRealImage i;
-	for(int x = x_image-_neighbourhoodSize; x <= x_image+_neighbourhoodSize; x++){
-		int yCtr = 0;
-		for(int y = y_image-_neighbourhoodSize; y <= y_image+_neighbourhoodSize; y++){
-			int zCtr = 0;
-			for(int z = z_image-_neighbourhoodSize; z <= z_image+_neighbourhoodSize; z++){
-				if(!( x < 0 ||   x  >= _image.GetX() ||
-					y < 0 || y >= _image.GetY() ||
-					z < 0 || z >= _image.GetZ() )){
-						double my_a = _patchMean[atlasNo]->Get(x, y, z);
-						double sigma_a = _patchStd[atlasNo]->Get(x, y, z);
-						double ss = (2*my_i*my_a / (my_i*my_i + my_a*my_a)) * (2*sigma_i*sigma_a / (sigma_i*sigma_i + sigma_a*sigma_a));
-						double val = _maxVal;
-						if(ss>.95)
-							if(IsForeground(x, y, z)){
-								val = EvaluatePatch(x_image, y_image, z_image, x, y, z, atlasNo);
-								tmpVals[xCtr][yCtr][zCtr] = val;
-							}
-							if(val > 0 && val < _wMin[atlasNo]){
-								_wMin[atlasNo] = val;
+		index = 0;
+		for(z = z1; z < z2; z++){
+			for(y = y1; y < y2; y++){
+				for(x = 0; x < X; x++){
+					if(IsForeground(x, y, z)){
+						maxVal = 0;
+						maxLabel = -1;
+						for(l = 0; l < _nrLabels; l++){
+							combVal = probLabels[index*_nrLabels+l] / overallVal[index];
+							if(combVal > maxVal){
+								maxVal = combVal;
+								maxLabel = l;
 							}
+						}
+						_segmentations[a]->Put(x, y, z, maxLabel);
+					}
+					index++;
 				}
+			}
+		}
+	}
 
-				zCtr++;
+	index = 0;
+	for(z = z1; z < z2; z++){
+		for(y = y1; y < y2; y++){
+			for(x = 0; x < X; x++){
+				if(IsForeground(x, y, z)){
+					if(totalWeight[index] > 0)
+						_hdimage.Put(x, y, z, hdVal[index]/totalWeight[index]);
+					else
+						_hdimage.Put(x, y, z, hdVal[index]);
+				}
+				index++;
 			}
-			yCtr++;
 		}
-		xCtr++;
 	}
 }
 
 void irtkPatchBasedSegmentation::Run(){
-	irtkGreyImage seg;
+	int nVoxels, nRows, nSlices;
+
 	if(! _patchMeasuresAvailable){
 		EstablishPatchMeasures();
 	}
 
 	_hdimage.Initialize(_image.GetImageAttributes());
 
-	int nSize = _neighbourhoodSize*2+1;
-	for(int z = 0; z < _image.GetZ(); z++){
-		for(int y = 0; y < _image.GetY(); y++){
-			for(int x = 0; x < _image.GetX(); x++){
-
-				if(IsForeground(x, y, z)){
-					for(int a = 0; a < _nAtlases; a++){
-						_wMin[a] = _maxVal;
-					}
-					double **** tmpVals;
-					tmpVals = new double***[_nAtlases];
-					for(int i = 0; i < _nAtlases; i++){
-						tmpVals[i] = new double**[nSize];
-						for(int j = 0; j < nSize; j++){
-							tmpVals[i][j] = new double*[nSize];
-							for(int k = 0; k < nSize; k++){
-								tmpVals[i][j][k] = new double[nSize];
-								for(int l = 0; l < nSize; l++){
-									tmpVals[i][j][k][l] = _maxVal;
-								}
-							}
-						}
-					}
-					for(int i = 0; i < _nAtlases; i++){
-						EvaluateNeighbourhood(x, y, z, i, tmpVals[i]);
-					}
-
-					double h = _maxVal;
-					for(int a = 0; a < _nAtlases; a++){
-						if(_wMin[a] < h)
-							h = _wMin[a];
-					}
-					for(int a = 0; a < _nAtlases; a++){
-						for(int i = 0; i < nSize; i++){
-							for(int j = 0; j < nSize; j++){
-								for(int k = 0; k < nSize; k++){
-									double valNew = tmpVals[a][i][j][k];
-									valNew = exp(-valNew/(h));
-									tmpVals[a][i][j][k] = valNew;
-								}
-							}
-						}
-					}
-
-					_hdimage.Put(x,y,z,0);
-
-					FindImage(x,y,z,tmpVals);
-
-					for(int i = 0; i < _nAtlases; i++){
-						FindLabel(i, x, y, z, tmpVals[i]);
-					}
-
-					for(int i = 0; i < _nAtlases; i++){
-						for(int j = 0; j < nSize; j++){
-							for(int k = 0; k < nSize; k++){
-								delete [] tmpVals[i][j][k];
-							}
-							delete [] tmpVals[i][j];
-						}
-						delete [] tmpVals[i];
-					}
-					delete [] tmpVals;
-				}
+	// The atlas patches of all offsets are compared with all image patches of
+	// a slab at once. The slabs bound the memory needed for the patch distances
+	// and the weights of the labels. Slabs are made of whole slices if a slice
+	// fits into the memory, otherwise of rows of a slice. The rows of a slab
+	// are processed in parallel.
+	int X = _image.GetX();
+	int Y = _image.GetY();
+	int nOffsets = (2*_neighbourhoodSize+1)*(2*_neighbourhoodSize+1)*(2*_neighbourhoodSize+1);
+	nVoxels = max(1, PATCH_SLAB_SIZE / max(1, _nrLabels + _nAtlases*nOffsets));
+	if(nVoxels >= X*Y){
+		nSlices = nVoxels / (X*Y);
+		nRows = Y;
+	}else{
+		nSlices = 1;
+		nRows = max(1, nVoxels / X);
+	}
 
-			}
+	task_scheduler_init init(tbb_no_threads);
+	for(int z = 0; z < _image.GetZ(); z += nSlices){
+		for(int y = 0; y < Y; y += nRows){
+			RunSlab(y, min(y + nRows, Y), z, min(z + nSlices, _image.GetZ()));
 		}
 	}
+	init.terminate();
 }
 
 bool irtkPatchBasedSegmentation::IsForeground(int x, int y, int z){
@@ -204,89 +592,6 @@ bool irtkPatchBasedSegmentation::IsForeground(int x, int y, int z){
 
 
 
-void irtkPatchBasedSegmentation::FindLabel(int atlasNo, int x_image, int y_image, int z_image, double *** tmpVals){
-
-	double *probLabels = new double[_nrLabels];
-	for(int i = 0; i < _nrLabels; i++){
-		probLabels[i] = 0;
-	}
-	double overallVal = 0;
-	int nSize = _neighbourhoodSize*2 + 1;
-
-	for(int i = 0; i < nSize; i++){
-		for(int j = 0; j < nSize; j++){
-			for(int k = 0; k < nSize; k++){
-				int x_atlas = x_image - _neighbourhoodSize + i;
-				int y_atlas = y_image - _neighbourhoodSize + j;
-				int z_atlas = z_image - _neighbourhoodSize + k;
-				int label = _padding;
-				if(!( x_atlas < 0 ||   x_atlas  >= _labels[atlasNo]->GetX() ||
-					y_atlas < 0 || y_atlas >= _labels[atlasNo]->GetY() ||
-					z_atlas < 0 || z_atlas >= _labels[atlasNo]->GetZ() )){
-						label = _labels[atlasNo]->Get(x_atlas, y_atlas, z_atlas);
-				}
-				if(label > _padding){
-					probLabels[label] += tmpVals[i][j][k];
-					if(_winnerTakesAll && probLabels[label] < tmpVals[i][j][k]){
-						cout << "Winner takes all" << endl;
-						probLabels[label] = tmpVals[i][j][k];
-					}
-					overallVal += tmpVals[i][j][k];
-				}
-			}
-		}
-	}
-	double maxVal = 0;
-	double maxLabel = -1;
-	_verbose = 0;
-	for(int i = 0; i < _nrLabels; i++){
-		probLabels[i] /= overallVal;
-		if(_verbose)
-			cout << "label " << i << ". Prob " << probLabels[i] << endl;
-		double combVal = probLabels[i];
-		if(combVal> maxVal){
-			maxVal = combVal;
-			maxLabel = i;
-		}
-
-	}
-
-	_segmentations[atlasNo]->Put(x_image, y_image, z_image, maxLabel);
-
-	delete []probLabels;
-}
-
-void irtkPatchBasedSegmentation::FindImage(int x_image, int y_image, int z_image, double **** tmpVals){
-
-	double overallVal = 0;
-	int nSize = _neighbourhoodSize*2 + 1;
-
-	double totalweight = 0;
-	for(int a = 0; a < _nAtlases; a++){
-		for(int i = 0; i < nSize; i++){
-			for(int j = 0; j < nSize; j++){
-				for(int k = 0; k < nSize; k++){
-					int x_atlas = x_image - _neighbourhoodSize + i;
-					int y_atlas = y_image - _neighbourhoodSize + j;
-					int z_atlas = z_image - _neighbourhoodSize + k;
-					if(!( x_atlas < 0 ||   x_atlas  >= _atlases[a]->GetX() ||
-						y_atlas < 0 || y_atlas >= _atlases[a]->GetY() ||
-						z_atlas < 0 || z_atlas >= _atlases[a]->GetZ() )){
-							_hdimage.Put(x_image,y_image,z_image,
-							_hdimage.Get(x_image,y_image,z_image)
-							+_atlases[a]->Get(x_atlas,y_atlas,z_atlas)
-							*tmpVals[a][i][j][k]);
-
-						totalweight += tmpVals[a][i][j][k];
-					}
-				}
-			}
-		}
-	}
-	if(totalweight > 0)
-		_hdimage.Put(x_image,y_image,z_image,_hdimage.Get(x_image,y_image,z_image)/totalweight);
-}
-
 void irtkPatchBasedSegmentation::EstablishPatchMeasures(){
 	cout << "Establish patch measures..." << endl;
 	_patchMean = new irtkGreyImage*[_nAtlases+1];
@@ -297,71 +602,25 @@ void irtkPatchBasedSegmentation::EstablishPatchMeasures(){
 		_patchStd[i] = new irtkGreyImage;
 		_patchStd[i]->Initialize(_image.GetImageAttributes());
 	}
-	for(int x = _patchSize; x < _image.GetX()-(_patchSize+1); x++){
-		for(int y = _patchSize; y < _image.GetY()-(_patchSize+1); y++){
-			for(int z = _patchSize; z < _image.GetZ()-(_patchSize+1); z++){
-				if(_image.Get(x, y, z) > 0){
-					double mean = 0;
-					double std = 0;
-					int ctr = 0;
-					for(int x1 = x-_patchSize; x1<=x+_patchSize; x1++){
-						for(int y1 = y-_patchSize; y1<=y+_patchSize; y1++){
-							for(int z1 = z-_patchSize; z1<=z+_patchSize; z1++){
-
-								mean += _image.Get(x1, y1, z1);
-								ctr++;
-							}
-						}
-					}
-					if(mean>0)
-						mean /= ctr;
-					for(int x1 = x-_patchSize; x1<=x+_patchSize; x1++){
-						for(int y1 = y-_patchSize; y1<=y+_patchSize; y1++){
-							for(int z1 = z-_patchSize; z1<=z+_patchSize; z1++){
-								std += (_image.Get(x1, y1, z1)-mean)*(_image.Get(x1, y1, z1)-mean);
-							}
-						}
-					}
-					if(std>0){
-						std /= ctr;
-						std = sqrt(std);
-					}
-					_patchMean[0]->Put(x, y, z, mean);
-					_patchStd[0]->Put(x, y, z, std);
-					for(int i = 1; i < _nAtlases+1; i++){
-						double mean = 0;
-						double std = 0;
-						int ctr = 0;
-						for(int x1 = x-_patchSize; x1<=x+_patchSize; x1++){
-							for(int y1 = y-_patchSize; y1<=y+_patchSize; y1++){
-								for(int z1 = z-_patchSize; z1<=z+_patchSize; z1++){
-									mean += _atlases[i-1]->Get(x1, y1, z1);
-									ctr++;
-								}
-							}
-						}
-						if(mean<0)
-							mean = 0;
-						if(mean>0)
-							mean /= ctr;
-						for(int x1 = x-_patchSize; x1<=x+_patchSize; x1++){
-							for(int y1 = y-_patchSize; y1<=y+_patchSize; y1++){
-								for(int z1 = z-_patchSize; z1<=z+_patchSize; z1++){
-									std += (_atlases[i-1]->Get(x1, y1, z1)-mean)*(_atlases[i-1]->Get(x1, y1, z1)-mean);
-								}
-							}
-						}
-						if(std>0){
-							std /= ctr;
-							std = sqrt(std);
-						}
-						_patchMean[i]->Put(x, y, z, mean);
-						_patchStd[i]->Put(x, y, z, std);
-					}
-				}
-			}
+
+	// Sums of intensities of all patches
+	int n = _image.GetNumberOfVoxels();
+	vector<double> sum(n);
+
+	task_scheduler_init init(tbb_no_threads);
+	for(int i = 0; i < _nAtlases+1; i++){
+		irtkRealImage *image = (i == 0) ? &_image : _atlases[i-1];
+		irtkRealPixel *ptr = image->GetPointerToVoxels();
+		for(int j = 0; j < n; j++){
+			sum[j] = ptr[j];
 		}
+		BoxSum(&sum[0], NULL, _image.GetY(), _image.GetZ(), 0, _image.GetY(), 0, _image.GetZ());
+
+		irtkMultiThreadedPatchBasedSegmentationMeasures measures(this, i, &sum[0]);
+		parallel_for(blocked_range<int>(_patchSize, max(_patchSize, _image.GetZ()-(_patchSize+1))), measures);
 	}
+	init.terminate();
+
 	cout << "done" << endl;
 	_patchMeasuresAvailable = true;
 
@@ -16,6 +16,159 @@ See LICENSE for details
 
 #include <irtkSegmentationFunction.h>
 
+class irtkMultiThreadedPatchMatchInitialize
+{
+	/// Pointer to patchmatch
+	irtkPatchMatch *_filter;
+
+public:
+
+	irtkMultiThreadedPatchMatchInitialize(irtkPatchMatch *filter){
+		_filter = filter;
+	}
+
+	void operator()(const blocked_range<int> &r) const{
+		int i, j, k, n, index, iteration;
+		NearstNeighborFlow *nnf;
+
+		for(k = r.begin(); k != r.end(); k++){
+			index = k*_filter->target->GetX()*_filter->target->GetY();
+			for(j = 0; j < _filter->target->GetY(); j++){
+				for(i = 0; i < _filter->target->GetX(); i++){
+					nnf = _filter->nnfs[index];
+					for(n = 0; n < _filter->nneighbour; n++){
+						nnf[n].weight = _filter->distance(i,j,k,i+nnf[n].x,j+nnf[n].y,k+nnf[n].z);
+
+						// if weight == maxdistance, the link is not good try to find a better link
+						iteration = 0;
+						while(nnf[n].weight >= _filter->maxdistance && iteration < 10){
+							_filter->randomlink(i,j,k,n,index,_filter->randompass + iteration);
+							iteration++;
+						}
+					}
+					index++;
+				}
+			}
+		}
+	}
+};
+
+class irtkMultiThreadedPatchMatchPropagation
+{
+	/// Pointer to patchmatch
+	irtkPatchMatch *_filter;
+
+	/// Distance to the neighbours
+	int _step;
+
+	/// Colour of the voxels which are updated
+	int _colour;
+
+	/// Propergate from the voxels before (1) or after (-1) along each axis
+	int _direction;
+
+public:
+
+	/// Number of voxels changed
+	int _count;
+
+	irtkMultiThreadedPatchMatchPropagation(irtkPatchMatch *filter, int step, int colour, int direction){
+		_filter = filter;
+		_step = step;
+		_colour = colour;
+		_direction = direction;
+		_count = 0;
+	}
+
+	irtkMultiThreadedPatchMatchPropagation(irtkMultiThreadedPatchMatchPropagation &r, split){
+		_filter = r._filter;
+		_step = r._step;
+		_colour = r._colour;
+		_direction = r._direction;
+		_count = 0;
+	}
+
+	void join(irtkMultiThreadedPatchMatchPropagation &rhs){
+		_count += rhs._count;
+	}
+
+	void operator()(const blocked_range<int> &r){
+		int i, j, k, x, s, d, count, index, dx, dy, dz;
+
+		dx = 1;
+		dy = _filter->target->GetX();
+		dz = _filter->target->GetX()*_filter->target->GetY();
+		s = _step;
+		d = _direction*s;
+
+		// the flow is stored relative to the voxel, so the flow of the
+		// neighbours is propergated without offset
+		for(k = r.begin(); k != r.end(); k++){
+			for(j = 0; j < _filter->target->GetY(); j++){
+				// voxels of the other colour are not changed, so all neighbours are fixed
+				i = ((k/s + j/s + _colour) % 2)*s;
+				for(; i < _filter->target->GetX(); i += 2*s){
+					index = k*dz + j*dy + i;
+					for(x = i; x < i + s && x < _filter->target->GetX(); x++, index++){
+						count = 0;
+						if(x - d >= 0 && x - d < _filter->target->GetX())
+							count += _filter->propergate(x-d,j,k,x,j,k,0,0,0,index-d*dx,index);
+						if(j - d >= 0 && j - d < _filter->target->GetY())
+							count += _filter->propergate(x,j-d,k,x,j,k,0,0,0,index-d*dy,index);
+						if(k - d >= 0 && k - d < _filter->target->GetZ())
+							count += _filter->propergate(x,j,k-d,x,j,k,0,0,0,index-d*dz,index);
+						if(count > 0)
+							_count++;
+					}
+				}
+			}
+		}
+	}
+};
+
+class irtkMultiThreadedPatchMatchRandomSearch
+{
+	/// Pointer to patchmatch
+	irtkPatchMatch *_filter;
+
+public:
+
+	/// Number of links changed
+	int _count;
+
+	irtkMultiThreadedPatchMatchRandomSearch(irtkPatchMatch *filter){
+		_filter = filter;
+		_count = 0;
+	}
+
+	irtkMultiThreadedPatchMatchRandomSearch(irtkMultiThreadedPatchMatchRandomSearch &r, split){
+		_filter = r._filter;
+		_count = 0;
+	}
+
+	void join(irtkMultiThreadedPatchMatchRandomSearch &rhs){
+		_count += rhs._count;
+	}
+
+	void operator()(const blocked_range<int> &r){
+		int i, j, k, o, index;
+
+		for(k = r.begin(); k != r.end(); k++){
+			index = k*_filter->target->GetX()*_filter->target->GetY();
+			for(j = 0; j < _filter->target->GetY(); j++){
+				for(i = 0; i < _filter->target->GetX(); i++){
+					for(o = 0; o < _filter->nneighbour; o++){
+						if(_filter->randomlink(i,j,k,o,index,_filter->randompass) > 0){
+							_count++;
+						}
+					}
+					index++;
+				}
+			}
+		}
+	}
+};
+
 irtkPatchMatch::irtkPatchMatch(irtkGreyImage *target, irtkGreyImage *source, int radius, int nneighbour){
 
 	this->target = target;
@@ -24,6 +177,9 @@ irtkPatchMatch::irtkPatchMatch(irtkGreyImage *target, irtkGreyImage *source, int
 	this->nneighbour = nneighbour;
 	this->randomrate = 0.5;
 	this->debug = false;
+	this->randomseed = time(NULL);
+	this->randompass = 0;
+	this->jumpstep = 1;
 	short minvalue, maxvalue;
 	target->GetMinMax(&minvalue, &maxvalue);
 	maxdistance = maxvalue - minvalue;
@@ -89,6 +245,8 @@ void irtkPatchMatch::run(int maxiterations){
 
 	localweight = this->initialize();
 
+	this->initializejumpstep();
+
 	cout << "minimizing NNF..." << endl;
 
 	//debug tmpflow
@@ -140,28 +298,19 @@ double irtkPatchMatch::initialize(){
 
 	cout << "initialize NNF's weight...";
 	cout.flush();
-	double totalweight = 0;
-	/// recalculate of the fields
-	int index = 0, iteration;
-	for(int k = 0; k < target->GetZ(); k++){
-		for(int j = 0; j < target->GetY(); j++){
-			for(int i = 0; i < target->GetX(); i++){
-				for(int n = 0; n < nneighbour; n++){
-					double difference = this->distance(i,j,k,
-						i+nnfs[index][n].x,j+nnfs[index][n].y,k+nnfs[index][n].z);
+	irtkMultiThreadedPatchMatchInitialize body(this);
 
-					nnfs[index][n].weight = difference;
+	task_scheduler_init init(tbb_no_threads);
+	parallel_for(blocked_range<int>(0, target->GetZ()), body);
+	init.terminate();
 
-					// if weight == maxdistance, the link is not good try to find a better link
-					iteration = 0;
-					while(nnfs[index][n].weight >= maxdistance && iteration < 10){
-						randomlink(i,j,k, n, index);
-						iteration++;
-					}
-					totalweight += nnfs[index][n].weight;
-				}
-				index++;
-			}
+	// each try of the random search uses its own sequence
+	randompass += 10;
+
+	double totalweight = 0;
+	for(int index = 0; index < target->GetNumberOfVoxels(); index++){
+		for(int n = 0; n < nneighbour; n++){
+			totalweight += nnfs[index][n].weight;
 		}
 	}
 	cout << "done" << endl;
@@ -169,11 +318,13 @@ double irtkPatchMatch::initialize(){
 	return totalweight;
 }
 
-int irtkPatchMatch::randomlink(int i, int j, int k, int o, int index){
+int irtkPatchMatch::randomlink(int i, int j, int k, int o, int index, int pass){
 	int x, y, z, ti, tj, tk, wi, wj, wk, count;
 	if(index < 0)
 		index = target->VoxelToIndex(i,j,k);
 	double dp;
+	// every voxel has its own random sequence, independent of the order of the voxels
+	unsigned int state = patchmatchseed(randomseed, pass, index*nneighbour + o);
 
 	count = 0;
 
@@ -202,10 +353,10 @@ int irtkPatchMatch::randomlink(int i, int j, int k, int o, int index){
 
 		while(wi>0) {
 
-			x = ti + rand()%(2*wi+1)-wi;
-			y = tj + rand()%(2*wi+1)-wi;
+			x = ti + patchmatchrandom(state)%(2*wi+1)-wi;
+			y = tj + patchmatchrandom(state)%(2*wi+1)-wi;
 			if(target->GetZ() > 1)
-				z = tk + rand()%(2*wi+1)-wi;
+				z = tk + patchmatchrandom(state)%(2*wi+1)-wi;
 			else
 				z = tk;
 
@@ -235,136 +386,86 @@ int irtkPatchMatch::randomlink(int i, int j, int k, int o, int index){
 }
 
 
-/// find minum flow
-double irtkPatchMatch::minimizeflow(){
-	int i,j,k, x,y,z,fcount, bcount, rcount, count, index,index1,index2,index3;
-	double sumweight = 0;
-	/// Forward propergation
-	fcount = 0;
-	index = 0;
-	//x-1
-	index1 = -1;
-	//y-1
-	index2 = -target->GetX();
-	//z-1
-	index3 = -target->GetX()*target->GetY();
-	for(int k = 0; k < target->GetZ(); k++){
-		for(int j = 0; j < target->GetY(); j++){
-			for(int i = 0; i < target->GetX(); i++){
-				count = 0;
-				//propergate from x - 1
-				if(i > 0){
-					x = i -1;
-					y = j;
-					z = k;
-					count += this->propergate(x,y,z,i,j,k,1,0,0,index1,index);
-				}
-				//propergate from y - 1
-				if(j > 0){
-					x = i;
-					y = j - 1;
-					z = k;
-					count += this->propergate(x,y,z,i,j,k,0,1,0,index2,index);
-				}
-				//propergate from z - 1
-				if(k > 0){
-					x = i;
-					y = j;
-					z = k - 1;
-					count += this->propergate(x,y,z,i,j,k,0,0,1,index3,index);
-				}
+/// reset the jump flooding step to the largest power of two below an eighth of the image size
+void irtkPatchMatch::initializejumpstep(){
+	int size = min(target->GetX(), target->GetY());
+	if(target->GetZ() > 1)
+		size = min(size, target->GetZ());
 
-				if(count > 0)
-					fcount ++;
+	jumpstep = 1;
+	while(2*jumpstep <= size/8)
+		jumpstep *= 2;
+}
 
-				index++;
-				index1++;
-				index2++;
-				index3++;
-			}
-		}
-	}
+/// propergate from the neighbours at the given distance to all voxels
+int irtkPatchMatch::propergation(int step, bool reverse){
+	int colour, count = 0;
 
-	/// Random search
-	rcount = 0;
-	index = 0;
-	for(int k = 0; k < target->GetZ(); k++){
-		for(int j = 0; j < target->GetY(); j++){
-			for(int i = 0; i < target->GetX(); i++){
-				for(int o = 0; o < nneighbour; o++){
-					if(this->randomlink(i,j,k,o,index) > 0){
-						rcount++;
-					}
-				}
-				index++;
-			}
-		}
-	}
+	// red-black ordering: the voxels of one colour only propergate from the
+	// voxels of the other colour, so that all voxels of a colour can be updated
+	// in parallel
+	for(int c = 0; c < 2; c++){
+		colour = (reverse == true) ? 1 - c : c;
 
-	/// Backward propergation
-	bcount = 0;
-	index = target->GetNumberOfVoxels() - 1;
-	//x-1
-	index1 = index+1;
-	//y-1
-	index2 = index+target->GetX();
-	//z-1
-	index3 = index+target->GetX()*target->GetY();
-	for(int k = target->GetZ() - 1; k >= 0; k--){
-		for(int j = target->GetY() - 1; j >= 0; j--){
-			for(int i = target->GetX() - 1; i >=0 ; i--){
-				count = 0;
-				//propergate from x + 1
-				if(i < target->GetX() - 1){
-					x = i + 1;
-					y = j;
-					z = k;
-					count += this->propergate(x,y,z,i,j,k,-1,0,0,index1,index);
-				}
-				//propergate from y + 1
-				if(j < target->GetY() - 1){
-					x = i;
-					y = j + 1;
-					z = k;
-					count += this->propergate(x,y,z,i,j,k,0,-1,0,index2,index);
-				}
-				//propergate from z + 1
-				if(k < target->GetZ() - 1){
-					x = i;
-					y = j;
-					z = k + 1;
-					count += this->propergate(x,y,z,i,j,k,0,0,-1,index3,index);
-				}
+		irtkMultiThreadedPatchMatchPropagation body(this, step, colour, (reverse == true) ? -1 : 1);
 
-				if(count > 0)
-					bcount ++;
+		task_scheduler_init init(tbb_no_threads);
+		parallel_reduce(blocked_range<int>(0, target->GetZ()), body);
+		init.terminate();
 
-				index--;
-				index1--;
-				index2--;
-				index3--;
-			}
-		}
+		count += body._count;
 	}
 
+	return count;
+}
+
+/// random search for all voxels
+int irtkPatchMatch::randomsearch(){
+	irtkMultiThreadedPatchMatchRandomSearch body(this);
+
+	task_scheduler_init init(tbb_no_threads);
+	parallel_reduce(blocked_range<int>(0, target->GetZ()), body);
+	init.terminate();
+
+	randompass++;
+
+	return body._count;
+}
+
+/// one iteration of propergation and random search
+double irtkPatchMatch::searchflow(int &fcount, int &bcount, int &rcount){
+	double sumweight = 0;
+
+	/// Forward propergation from distant neighbours, the distance halves every iteration (jump flooding)
+	fcount = this->propergation(jumpstep, false);
+	if(jumpstep > 1)
+		jumpstep /= 2;
+
 	/// Random search
-	index = 0;
-	for(int k = 0; k < target->GetZ(); k++){
-		for(int j = 0; j < target->GetY(); j++){
-			for(int i = 0; i < target->GetX(); i++){
-				for(int o = 0; o < nneighbour; o++){
-					if(this->randomlink(i,j,k,o,index) > 0){
-						rcount++;
-					}
-					if(this->nnfs[index][o].weight < maxdistance - 1){
-						sumweight += this->nnfs[index][o].weight;
-					}
-				}
-				index++;
+	rcount = this->randomsearch();
+
+	/// Backward propergation from direct neighbours
+	bcount = this->propergation(1, true);
+
+	/// Random search
+	rcount += this->randomsearch();
+
+	for(int index = 0; index < target->GetNumberOfVoxels(); index++){
+		for(int o = 0; o < nneighbour; o++){
+			if(this->nnfs[index][o].weight < maxdistance - 1){
+				sumweight += this->nnfs[index][o].weight;
 			}
 		}
 	}
 
+	return sumweight;
+}
+
+/// find minum flow
+double irtkPatchMatch::minimizeflow(){
+	int fcount, bcount, rcount;
+	double sumweight = this->searchflow(fcount, bcount, rcount);
+
 	cout << "number of fields changed: " << fcount << " " << bcount << " " << rcount << " ";
 
 	if(debug == true){
@@ -458,7 +559,7 @@ double irtkPatchMatch::minimizeflowwithdebug(){
 		for(int j = 0; j < target->GetY(); j++){
 			for(int i = 0; i < target->GetX(); i++){
 				for(int o = 0; o < nneighbour; o++){
-					if(this->randomlink(i,j,k,o,index) > 0){
+					if(this->randomlink(i,j,k,o,index,randompass) > 0){
 						rcount++;
 					}
 				}
@@ -468,6 +569,7 @@ double irtkPatchMatch::minimizeflowwithdebug(){
 		if(k%4 == 0)
 			this->voteweight(k,1);
 	}
+	randompass++;
 
 	/// Backward propergation
 	bcount = 0;
@@ -523,7 +625,7 @@ double irtkPatchMatch::minimizeflowwithdebug(){
 		for(int j = 0; j < target->GetY(); j++){
 			for(int i = 0; i < target->GetX(); i++){
 				for(int o = 0; o < nneighbour; o++){
-					if(this->randomlink(i,j,k,o,index) > 0){
+					if(this->randomlink(i,j,k,o,index,randompass) > 0){
 						rcount++;
 					}
 					if(this->nnfs[index][o].weight < maxdistance - 1){
@@ -536,6 +638,7 @@ double irtkPatchMatch::minimizeflowwithdebug(){
 		if(k%4 == 0)
 			this->voteweight(k,3);
 	}
+	randompass++;
 
 	cout << "number of fields changed: " << fcount << " " << bcount << " " << rcount << " ";
 
@@ -770,7 +873,7 @@ double irtkPatchMatch::distance2D(int x1, int y1, int x2, int y2){
 					if(value1 >= 0){		
 						values = source->Get(i2,j2,0,o);
 						tmp = double(value1 - values);
-						dif += sqrt(tmp*tmp);
+						dif += fabs(tmp);
 						count++;
 					}
 				}	
@@ -836,7 +939,7 @@ double irtkPatchMatch::distance3D(int x1, int y1, int z1, int x2, int y2, int z2
 						if(value1 >= 0){		
 							values = source->Get(i2,j2,k2,o);
 							tmp = double(value1 - values);
-							dif += sqrt(tmp*tmp);
+							dif += fabs(tmp);
 							count++;
 						}
 					}	
@@ -891,7 +994,7 @@ double irtkPatchMatch::selfdistance2D(int x1, int y1, int x2, int y2, int mode){
 						if(value1 >= 0){		
 							values = target->Get(i2,j2,0,o);
 							tmp = double(value1 - values);
-							dif += sqrt(tmp*tmp);
+							dif += fabs(tmp);
 							count++;
 						}
 					}	
@@ -930,7 +1033,7 @@ double irtkPatchMatch::selfdistance2D(int x1, int y1, int x2, int y2, int mode){
 						if(value1 >= 0){		
 							values = source->Get(i2,j2,0,o);
 							tmp = double(value1 - values);
-							dif += sqrt(tmp*tmp);
+							dif += fabs(tmp);
 							count++;
 						}
 					}	
@@ -998,7 +1101,7 @@ double irtkPatchMatch::selfdistance3D(int x1, int y1, int z1, int x2, int y2, in
 							if(value1 >= 0){		
 								values = target->Get(i2,j2,k2,o);
 								tmp = double(value1 - values);
-								dif += sqrt(tmp*tmp);
+								dif += fabs(tmp);
 								count++;
 							}
 						}	
@@ -1044,7 +1147,7 @@ double irtkPatchMatch::selfdistance3D(int x1, int y1, int z1, int x2, int y2, in
 							if(value1 >= 0){		
 								values = source->Get(i2,j2,k2,o);
 								tmp = double(value1 - values);
-								dif += sqrt(tmp*tmp);
+								dif += fabs(tmp);
 								count++;
 							}
 						}	
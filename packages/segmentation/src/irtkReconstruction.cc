@@ -23,6 +23,10 @@ See LICENSE for details
 #include <irtkMeanShift.h>
 #include <irtkCRF.h>
 
+#ifndef WIN32
+#include <unistd.h>
+#endif
+
 /* Auxiliary functions (not reconstruction specific) */
 
 void bbox( irtkRealImage &stack,
@@ -167,6 +171,10 @@ irtkReconstruction::irtkReconstruction()
     _low_intensity_cutoff = 0.01;
     _global_bias_correction = false;
     _adaptive = false;
+    _gather = false;
+    _volcoeffs_quality_factor = 0;
+    _coeff_init_tolerance = 0.1;
+    _scratch_budget = 0;
 
     int directions[13][3] = {
         { 1, 0, -1 },
@@ -1268,6 +1276,7 @@ void irtkReconstruction::RestoreSliceIntensities()
             if(*p>0) *p = *p / factor;
             p++;
         } 
+        ReleaseSlices(inputIndex, inputIndex + 1);
     }
 }
 
@@ -1299,6 +1308,7 @@ void irtkReconstruction::ScaleVolume()
                         scaleden += w(i, j, 0) * _slice_weight[inputIndex] * sim(i, j, 0) * sim(i, j, 0);
                     }
                 }
+        ReleaseSlices(inputIndex, inputIndex + 1);
     } //end of loop for a slice inputIndex
     
     //calculate scale for the volume
@@ -1336,19 +1346,21 @@ public:
 
             reconstructor->_slice_inside[inputIndex] = false;
             
-            POINT3D p;
+            const irtkSliceToVolumeMatrix& coeffs = reconstructor->_volcoeffs[inputIndex];
+            irtkRealPixel *reconstructed = reconstructor->_reconstructed.GetPointerToVoxels();
+            irtkRealPixel *mask = reconstructor->_mask.GetPointerToVoxels();
             for ( unsigned int i = 0; i < reconstructor->_slices[inputIndex].GetX(); i++ )
                 for ( unsigned int j = 0; j < reconstructor->_slices[inputIndex].GetY(); j++ )
                     if ( reconstructor->_slices[inputIndex](i, j, 0) != -1 ) {
-                        double weight = 0;
-                        int n = reconstructor->_volcoeffs[inputIndex][i][j].size();
-                        for ( unsigned int k = 0; k < n; k++ ) {
-                            p = reconstructor->_volcoeffs[inputIndex][i][j][k];
-                            reconstructor->_simulated_slices[inputIndex](i, j, 0) += p.value * reconstructor->_reconstructed(p.x, p.y, p.z);
-                            weight += p.value;
-                            if (reconstructor->_mask(p.x, p.y, p.z) == 1) {
+                        double weight;
+                        reconstructor->_simulated_slices[inputIndex](i, j, 0) = coeffs.Forward(i, j, reconstructed, weight);
+                        int n = coeffs.GetSize(i, j);
+                        const int *index = coeffs.GetIndices(i, j);
+                        for ( int k = 0; k < n; k++ ) {
+                            if (mask[index[k]] == 1) {
                                 reconstructor->_simulated_inside[inputIndex](i, j, 0) = 1;
                                 reconstructor->_slice_inside[inputIndex] = true;
+                                break;
                             }
                         }                    
                         if( weight > 0 ) {
@@ -1363,8 +1375,13 @@ public:
     // execute
     void operator() () const {
         task_scheduler_init init(tbb_no_threads);
-        parallel_for( blocked_range<size_t>(0, reconstructor->_slices.size() ),
-                      *this );
+        size_t begin, end;
+        for (begin = 0; begin < reconstructor->_slices.size(); begin = end) {
+            end = reconstructor->SliceBatchEnd(begin);
+            parallel_for( blocked_range<size_t>(begin, end),
+                          *this );
+            reconstructor->ReleaseSlices(begin, end);
+        }
         init.terminate();
     }
 
@@ -1388,9 +1405,8 @@ void irtkReconstruction::SimulateStacks(vector<irtkRealImage>& stacks)
         cout<<"Simulating stacks."<<endl;
   
     unsigned int inputIndex;
-    int i, j, k, n;
+    int i, j;
     irtkRealImage sim;
-    POINT3D p;
     double weight;
   
     int z, current_stack;
@@ -1414,13 +1430,7 @@ void irtkReconstruction::SimulateStacks(vector<irtkRealImage>& stacks)
           for (i = 0; i < slice.GetX(); i++)
             for (j = 0; j < slice.GetY(); j++)
                 if (slice(i, j, 0) != -1) {
-                    weight=0;
-                    n = _volcoeffs[inputIndex][i][j].size();
-                    for (k = 0; k < n; k++) {
-                        p = _volcoeffs[inputIndex][i][j][k];
-                        sim(i, j, 0) += p.value * _reconstructed(p.x, p.y, p.z);
-                        weight += p.value;
-                    }
+                    sim(i, j, 0) = _volcoeffs[inputIndex].Forward(i, j, _reconstructed.GetPointerToVoxels(), weight);
                     if(weight>0.99)
                         sim(i,j,0)/=weight;
 		    else
@@ -1439,6 +1449,7 @@ void irtkReconstruction::SimulateStacks(vector<irtkRealImage>& stacks)
             for(j=0;j<sim.GetY();j++) {
                 stacks[_stack_index[inputIndex]](i,j,z)=sim(i,j,0);
             }
+        ReleaseSlices(inputIndex, inputIndex + 1);
         //end of loop for a slice inputIndex
     }   
 }
@@ -1677,6 +1688,122 @@ void irtkReconstruction::MatchStackIntensitiesWithMasking(vector<irtkRealImage>&
 }
 
 
+void irtkReconstruction::SetScratchFolder(const char *folder, double budget)
+{
+    if (!irtkMemoryMappedFile::IsSupported()) {
+        cerr << "irtkReconstruction::SetScratchFolder: Memory mapped files are not supported, slices are kept in memory" << endl;
+        return;
+    }
+    _scratch_folder = folder;
+    _scratch_budget = budget * 1024 * 1024;
+
+    //move existing slice data to scratch file
+    MapSlices();
+}
+
+void irtkReconstruction::MapSlices()
+{
+    if (_scratch_folder.empty())
+        return;
+
+#ifndef WIN32
+    unsigned int i, k;
+    long offset, length, page;
+    vector<irtkRealImage*> images;
+    vector<long> offsets;
+    vector<irtkRealImage>* data[6] = { &_slices, &_simulated_slices, &_simulated_weights,
+                                       &_simulated_inside, &_weights, &_bias };
+
+    //find slice data which is not stored in a scratch file yet
+    for (k = 0; k < 6; k++)
+        for (i = 0; i < data[k]->size(); i++)
+            if ((!(*data[k])[i].IsMemoryMapped()) && ((*data[k])[i].GetNumberOfVoxels() > 0))
+                images.push_back(&(*data[k])[i]);
+    if (images.empty())
+        return;
+
+    //images are mapped separately and thus start at multiples of the page size
+    page = irtkMemoryMappedFile::GetPageSize();
+    offset = 0;
+    for (i = 0; i < images.size(); i++) {
+        offsets.push_back(offset);
+        length = images[i]->GetNumberOfVoxels() * sizeof(irtkRealPixel);
+        offset += ((length + page - 1) / page) * page;
+    }
+
+    //create scratch file
+    string filename = _scratch_folder + "/irtkReconstruction-XXXXXX";
+    vector<char> name(filename.begin(), filename.end());
+    name.push_back('\0');
+    int fd = mkstemp(&name[0]);
+    if (fd == -1) {
+        cerr << "irtkReconstruction::MapSlices: Can't create scratch file in " << _scratch_folder << endl;
+        exit(1);
+    }
+    close(fd);
+    if (!irtkMemoryMappedFile::Create(&name[0], offset)) {
+        cerr << "irtkReconstruction::MapSlices: Can't allocate " << offset << " bytes for scratch file " << &name[0] << endl;
+        exit(1);
+    }
+
+    //move slice data to scratch file
+    for (i = 0; i < images.size(); i++) {
+        length = images[i]->GetNumberOfVoxels() * sizeof(irtkRealPixel);
+        irtkMemoryMappedFile *file = new irtkMemoryMappedFile;
+        if (!file->Open(&name[0], MemoryMap_ReadWrite, offsets[i], length)) {
+            cerr << "irtkReconstruction::MapSlices: Can't map scratch file " << &name[0] << endl;
+            exit(1);
+        }
+        memcpy(file->GetPointer(), images[i]->GetPointerToVoxels(), length);
+        images[i]->Initialize(images[i]->GetImageAttributes(), file, 0);
+        images[i]->ReleaseMappedMemory();
+    }
+
+    //the file is deleted once all images using it are freed
+    unlink(&name[0]);
+#endif
+}
+
+size_t irtkReconstruction::SliceBatchEnd(size_t begin)
+{
+    size_t end, threads;
+    double size;
+
+    if (_scratch_folder.empty())
+        return _slices.size();
+
+    //number of threads processing the batch
+#ifdef HAS_TBB
+    threads = (tbb_no_threads > 0) ? tbb_no_threads : task_scheduler_init::default_num_threads();
+#else
+    threads = 1;
+#endif
+
+    //slice data of a batch has to fit into the memory budget, but each
+    //thread gets at least one slice of the batch
+    size = 0;
+    for (end = begin; end < _slices.size(); end++) {
+        size += 6.0 * _slices[end].GetNumberOfVoxels() * sizeof(irtkRealPixel);
+        if ((size > _scratch_budget) && (end >= begin + threads))
+            break;
+    }
+    return end;
+}
+
+void irtkReconstruction::ReleaseSlices(size_t begin, size_t end)
+{
+    size_t i, k;
+    vector<irtkRealImage>* data[6] = { &_slices, &_simulated_slices, &_simulated_weights,
+                                       &_simulated_inside, &_weights, &_bias };
+
+    if (_scratch_folder.empty())
+        return;
+
+    for (k = 0; k < 6; k++)
+        for (i = begin; (i < end) && (i < data[k]->size()); i++)
+            (*data[k])[i].ReleaseMappedMemory();
+}
+
 void irtkReconstruction::CreateSlicesAndTransformations( vector<irtkRealImage> &stacks,
                                                          vector<irtkRigidTransformation> &stack_transformations,
                                                          vector<double> &thickness,
@@ -1714,6 +1841,10 @@ void irtkReconstruction::CreateSlicesAndTransformations( vector<irtkRealImage> &
     }
     cout << "Number of slices: " << _slices.size() << endl;
 
+    //slice-volume matrices need to be recomputed for new slices
+    _volcoeffs_matrices.clear();
+
+    MapSlices();
 }
 
 void irtkReconstruction::ResetSlices(vector<irtkRealImage>& stacks,
@@ -1745,6 +1876,11 @@ void irtkReconstruction::ResetSlices(vector<irtkRealImage>& stacks,
         _bias[i].Initialize( _slices[i].GetImageAttributes() );
         _weights[i].Initialize( _slices[i].GetImageAttributes() );
     }
+
+    //slice-volume matrices need to be recomputed for new slices
+    _volcoeffs_matrices.clear();
+
+    MapSlices();
 }
 
 void irtkReconstruction::SetSlicesAndTransformations( vector<irtkRealImage>& slices,
@@ -1771,6 +1907,11 @@ void irtkReconstruction::SetSlicesAndTransformations( vector<irtkRealImage>& sli
         //get slice transformation
         _transformations.push_back(slice_transformations[i]);
     }
+
+    //slice-volume matrices need to be recomputed for new slices
+    _volcoeffs_matrices.clear();
+
+    MapSlices();
 }
 
 void irtkReconstruction::UpdateSlices(vector<irtkRealImage>& stacks, vector<double>& thickness)
@@ -1793,6 +1934,10 @@ void irtkReconstruction::UpdateSlices(vector<irtkRealImage>& stacks, vector<doub
 	}
 	cout << "Number of slices: " << _slices.size() << endl;
 
+    //slice-volume matrices need to be recomputed for new slices
+    _volcoeffs_matrices.clear();
+
+    MapSlices();
 }
 
 void irtkReconstruction::MaskSlices()
@@ -1841,6 +1986,10 @@ void irtkReconstruction::MaskSlices()
         //remember masked slice
         //_slices[inputIndex] = slice;
     }
+
+    //slice-volume matrices need to be recomputed for masked slices
+    _volcoeffs_matrices.clear();
+
     cout << "done." << endl;
 }
 
@@ -1900,8 +2049,13 @@ public:
     // execute
     void operator() () const {
         task_scheduler_init init(tbb_no_threads);
-        parallel_for( blocked_range<size_t>(0, reconstructor->_slices.size() ),
-                      *this );
+        size_t begin, end;
+        for (begin = 0; begin < reconstructor->_slices.size(); begin = end) {
+            end = reconstructor->SliceBatchEnd(begin);
+            parallel_for( blocked_range<size_t>(begin, end),
+                          *this );
+            reconstructor->ReleaseSlices(begin, end);
+        }
         init.terminate();
     }
 
@@ -1925,6 +2079,7 @@ void irtkReconstruction::CoeffInitBSpline()
   //clear slice-volume matrix
   _volcoeffs.clear();
   _slice_inside.clear();
+  _volcoeffs_matrices.clear();
 
 
   cout<<"Initialising matrix coefficients...";
@@ -1938,9 +2093,8 @@ void irtkReconstruction::CoeffInitBSpline()
     slice=_slices[inputIndex];
 
     //prepare structures for storage  
-    POINT3D p;
-    VOXELCOEFFS empty;
-    SLICECOEFFS slicecoeffs(slice.GetX(),vector<VOXELCOEFFS>(slice.GetY(),empty));
+    irtkSliceToVolumeMatrix slicecoeffs;
+    slicecoeffs.Initialize(slice.GetX(), slice.GetY());
     
     _slice_inside.push_back(true);
     
@@ -1987,14 +2141,11 @@ void irtkReconstruction::CoeffInitBSpline()
 		        if ((n>=0)&&(n<_reconstructed.GetZ()))
 			{
 			  weight=(1 - fabs(l - x))*(1 - fabs(m - y))*(1 - fabs(n - z));
-			  p.x=l;
-			  p.y=m;
-			  p.z=n;
-			  p.value=weight/sum;
-			  slicecoeffs[i][j].push_back(p);
+			  slicecoeffs.Add(_reconstructed.VoxelToIndex(l, m, n), weight/sum);
 			}
 	    }
 	  }
+          slicecoeffs.EndRow();
       }
     }
     _volcoeffs.push_back(slicecoeffs);
@@ -2013,6 +2164,10 @@ public:
         
         for ( size_t inputIndex = r.begin(); inputIndex != r.end(); ++inputIndex ) {
 
+            //keep slice-volume matrix of slices which have not moved
+            if (!reconstructor->_volcoeffs_update[inputIndex])
+                continue;
+
             bool slice_inside;
 
             //current slice
@@ -2031,9 +2186,8 @@ public:
             irtkRealImage& slice = reconstructor->_slices[inputIndex];
 
             //prepare structures for storage
-            POINT3D p;
-            VOXELCOEFFS empty;
-            SLICECOEFFS slicecoeffs(slice.GetX(), vector < VOXELCOEFFS > (slice.GetY(), empty));
+            irtkSliceToVolumeMatrix& slicecoeffs = reconstructor->_volcoeffs[inputIndex];
+            slicecoeffs.Initialize(slice.GetX(), slice.GetY());
 
             //to check whether the slice has an overlap with mask ROI
             slice_inside = false;
@@ -2148,7 +2302,7 @@ public:
             int l, m, n;
             double weight;
             for (i = 0; i < slice.GetX(); i++)
-                for (j = 0; j < slice.GetY(); j++)
+                for (j = 0; j < slice.GetY(); j++) {
                     if (slice(i, j, 0) != -1) {
                         //calculate centrepoint of slice voxel in volume space (tx,ty,tz)
                         x = i;
@@ -2285,15 +2439,12 @@ public:
                             for (jj = 0; jj < dim; jj++)
                                 for (kk = 0; kk < dim; kk++)
                                     if (tPSF(ii, jj, kk) > 0) {
-                                        p.x = ii + tx - centre;
-                                        p.y = jj + ty - centre;
-                                        p.z = kk + tz - centre;
-                                        p.value = tPSF(ii, jj, kk);
-                                        slicecoeffs[i][j].push_back(p);
+                                        slicecoeffs.Add(reconstructor->_reconstructed.VoxelToIndex(ii + tx - centre, jj + ty - centre, kk + tz - centre), tPSF(ii, jj, kk));
                                     }
-                    } //end of loop for slice voxels
+                    }
+                    slicecoeffs.EndRow();
+                } //end of loop for slice voxels
 
-            reconstructor->_volcoeffs[inputIndex] = slicecoeffs;
             reconstructor->_slice_inside[inputIndex] = slice_inside;
 
         }  //end of loop through the slices                            
@@ -2303,45 +2454,126 @@ public:
     // execute
     void operator() () const {
         task_scheduler_init init(tbb_no_threads);
-        parallel_for( blocked_range<size_t>(0, reconstructor->_slices.size() ),
-                      *this );
+        size_t begin, end;
+        for (begin = 0; begin < reconstructor->_slices.size(); begin = end) {
+            end = reconstructor->SliceBatchEnd(begin);
+            parallel_for( blocked_range<size_t>(begin, end),
+                          *this );
+            reconstructor->ReleaseSlices(begin, end);
+        }
         init.terminate();
     }
 
 };
 
+double irtkReconstruction::SliceDisplacement(int inputIndex)
+{
+    int i, j, k;
+    double x, y, z, dx, dy, dz, d, dmax;
+
+    //difference between current transformation and transformation for which
+    //the slice-volume matrix was computed
+    irtkMatrix m = _transformations[inputIndex].GetMatrix() - _volcoeffs_matrices[inputIndex];
+
+    //the PSF of a slice voxel extends by one voxel size in each direction, so the
+    //slice-volume matrix depends on the box [-1,X]x[-1,Y]x[-1,1] in slice image
+    //coordinates. The length of the displacement is a convex function of the
+    //position, hence it is largest at one of the corners of this box
+    irtkRealImage& slice = _slices[inputIndex];
+    dmax = 0;
+    for (i = 0; i < 2; i++)
+        for (j = 0; j < 2; j++)
+            for (k = 0; k < 2; k++) {
+                x = i * (slice.GetX() + 1) - 1;
+                y = j * (slice.GetY() + 1) - 1;
+                z = 2 * k - 1;
+                slice.ImageToWorld(x, y, z);
+                dx = m(0, 0) * x + m(0, 1) * y + m(0, 2) * z + m(0, 3);
+                dy = m(1, 0) * x + m(1, 1) * y + m(1, 2) * z + m(1, 3);
+                dz = m(2, 0) * x + m(2, 1) * y + m(2, 2) * z + m(2, 3);
+                d = sqrt(dx * dx + dy * dy + dz * dz);
+                if (d > dmax)
+                    dmax = d;
+            }
+    return dmax;
+}
+
 void irtkReconstruction::CoeffInit()
 {
     if (_debug)
         cout << "CoeffInit" << endl;
     
-    //clear slice-volume matrix from previous iteration
-    _volcoeffs.clear();
-    _volcoeffs.resize(_slices.size());
+    unsigned int inputIndex;
+    int i, j;
+
+    //slice-volume matrices from previous iteration can be kept if the volume,
+    //the mask and the slices have not changed
+    bool keep = (_volcoeffs_matrices.size() == _slices.size())
+        && (_volcoeffs_quality_factor == _quality_factor)
+        && (_volcoeffs_mask.GetImageAttributes() == _reconstructed.GetImageAttributes())
+        && (_volcoeffs_mask.GetImageAttributes() == _mask.GetImageAttributes());
+    if (keep) {
+        irtkRealPixel *pm = _mask.GetPointerToVoxels();
+        irtkRealPixel *pv = _volcoeffs_mask.GetPointerToVoxels();
+        for (i = 0; i < _mask.GetNumberOfVoxels(); i++) {
+            if (pm[i] != pv[i]) {
+                keep = false;
+                break;
+            }
+        }
+    }
+
+    //find slices which moved since their slice-volume matrix was computed. The
+    //PSF is sampled at steps of the voxel size divided by the quality factor,
+    //a fraction of this step moves each PSF sample by less than that fraction
+    //of the distance to its neighbours
+    double tolerance = _coeff_init_tolerance * _reconstructed.GetXSize() / _quality_factor;
+    _volcoeffs_update.assign(_slices.size(), true);
+    if (keep) {
+        for (inputIndex = 0; inputIndex < _slices.size(); ++inputIndex)
+            if (SliceDisplacement(inputIndex) <= tolerance)
+                _volcoeffs_update[inputIndex] = false;
+    }
+    else {
+        //clear slice-volume matrix from previous iteration
+        _volcoeffs.clear();
+        _volcoeffs.resize(_slices.size());
+
+        //clear indicator of slice having and overlap with volumetric mask
+        _slice_inside.clear();
+        _slice_inside.resize(_slices.size());
 
-    //clear indicator of slice having and overlap with volumetric mask
-    _slice_inside.clear();
-    _slice_inside.resize(_slices.size());
+        _volcoeffs_matrices.resize(_slices.size());
+        _volcoeffs_mask = _mask;
+        _volcoeffs_quality_factor = _quality_factor;
+    }
 
     cout << "Initialising matrix coefficients...";
     ParallelCoeffInit coeffinit(this);
     coeffinit();
     cout << " ... done." << endl;
 
+    //remember transformations of updated slices
+    int updated = 0;
+    for (inputIndex = 0; inputIndex < _slices.size(); ++inputIndex)
+        if (_volcoeffs_update[inputIndex]) {
+            _volcoeffs_matrices[inputIndex] = _transformations[inputIndex].GetMatrix();
+            updated++;
+        }
+    if (_debug)
+        cout << "Updated matrix coefficients of " << updated << " of " << _slices.size() << " slices" << endl;
+
+    //transposed slice-volume matrix is rebuilt when the slices are gathered
+    _voxcoeffs.Clear();
+
     //prepare image for volume weights, will be needed for Gaussian Reconstruction
     _volume_weights.Initialize( _reconstructed.GetImageAttributes() );
     _volume_weights = 0;
 
-    int inputIndex, i, j, n, k;
-    POINT3D p;
     for ( inputIndex = 0; inputIndex < _slices.size(); ++inputIndex) {
         for ( i = 0; i < _slices[inputIndex].GetX(); i++)
             for ( j = 0; j < _slices[inputIndex].GetY(); j++) {
-                n = _volcoeffs[inputIndex][i][j].size();
-                for (k = 0; k < n; k++) {
-                    p = _volcoeffs[inputIndex][i][j][k];
-                    _volume_weights(p.x, p.y, p.z) += p.value;
-                }
+                _volcoeffs[inputIndex].Adjoint(i, j, 1, _volume_weights.GetPointerToVoxels());
             }
     }
     if (_debug)
@@ -2374,10 +2606,9 @@ void irtkReconstruction::GaussianReconstruction()
 {
     cout << "Gaussian reconstruction ... ";
     unsigned int inputIndex;
-    int i, j, k, n;
+    int i, j, n;
     irtkRealImage slice;
     double scale;
-    POINT3D p;
     vector<int> voxel_num;  
     int slice_vox_num;
 
@@ -2403,7 +2634,7 @@ void irtkReconstruction::GaussianReconstruction()
 
                     //number of volume voxels with non-zero coefficients
                     //for current slice voxel
-                    n = _volcoeffs[inputIndex][i][j].size();
+                    n = _volcoeffs[inputIndex].GetSize(i, j);
 
                     //if given voxel is not present in reconstructed volume at all,
                     //pad it
@@ -2416,12 +2647,10 @@ void irtkReconstruction::GaussianReconstruction()
 
                     //add contribution of current slice voxel to all voxel volumes
                     //to which it contributes
-                    for (k = 0; k < n; k++) {
-                        p = _volcoeffs[inputIndex][i][j][k];
-                        _reconstructed(p.x, p.y, p.z) += p.value * slice(i, j, 0);
-                    }
+                    _volcoeffs[inputIndex].Adjoint(i, j, slice(i, j, 0), _reconstructed.GetPointerToVoxels());
                 }
         voxel_num.push_back(slice_vox_num);
+        ReleaseSlices(inputIndex, inputIndex + 1);
         //end of loop for a slice inputIndex
     }
 
@@ -2535,6 +2764,8 @@ void irtkReconstruction::InitializeEM()
             ptr++;
         }
     }
+
+    MapSlices();
 }
 
 void irtkReconstruction::InitializeEMValues()
@@ -2566,6 +2797,8 @@ void irtkReconstruction::InitializeEMValues()
 
         //Initialise scaling factors for intensity matching
         _scale[i] = 1;
+
+        ReleaseSlices(i, i + 1);
     }        
 }
 
@@ -2601,6 +2834,8 @@ void irtkReconstruction::InitializeRobustStatistics()
         //if slice does not have an overlap with ROI, set its weight to zero
         if (!_slice_inside[inputIndex])
             _slice_weight[inputIndex] = 0;
+
+        ReleaseSlices(inputIndex, inputIndex + 1);
     }
 
     //Force exclusion of slices predefined by user
@@ -2654,7 +2889,7 @@ public:
 
                         //number of volumetric voxels to which
                         // current slice voxel contributes
-                        int n = reconstructor->_volcoeffs[inputIndex][i][j].size();
+                        int n = reconstructor->_volcoeffs[inputIndex].GetSize(i, j);
 
                         // if n == 0, slice voxel has no overlap with volumetric ROI,
                         // do not process it
@@ -2700,8 +2935,13 @@ public:
     // execute
     void operator() () const {
         task_scheduler_init init(tbb_no_threads);
-        parallel_for( blocked_range<size_t>(0, reconstructor->_slices.size() ),
-                      *this );
+        size_t begin, end;
+        for (begin = 0; begin < reconstructor->_slices.size(); begin = end) {
+            end = reconstructor->SliceBatchEnd(begin);
+            parallel_for( blocked_range<size_t>(begin, end),
+                          *this );
+            reconstructor->ReleaseSlices(begin, end);
+        }
         init.terminate();
     }
     
@@ -2997,8 +3237,13 @@ public:
     // execute
     void operator() () const {
         task_scheduler_init init(tbb_no_threads);
-        parallel_for( blocked_range<size_t>(0, reconstructor->_slices.size() ),
-                      *this );
+        size_t begin, end;
+        for (begin = 0; begin < reconstructor->_slices.size(); begin = end) {
+            end = reconstructor->SliceBatchEnd(begin);
+            parallel_for( blocked_range<size_t>(begin, end),
+                          *this );
+            reconstructor->ReleaseSlices(begin, end);
+        }
         init.terminate();
     }
 
@@ -3134,8 +3379,13 @@ public:
     // execute
     void operator() () const {
         task_scheduler_init init(tbb_no_threads);
-        parallel_for( blocked_range<size_t>(0, reconstructor->_slices.size() ),
-                      *this );
+        size_t begin, end;
+        for (begin = 0; begin < reconstructor->_slices.size(); begin = end) {
+            end = reconstructor->SliceBatchEnd(begin);
+            parallel_for( blocked_range<size_t>(begin, end),
+                          *this );
+            reconstructor->ReleaseSlices(begin, end);
+        }
         init.terminate();
     }
     
@@ -3154,6 +3404,97 @@ void irtkReconstruction::Bias()
 }
 
 
+class ParallelSuperresolutionValues {
+    irtkReconstruction* reconstructor;
+    double *error;
+    double *weight;
+public:
+    
+    void operator()( const blocked_range<size_t>& r ) const {
+        for ( size_t inputIndex = r.begin(); inputIndex < r.end(); ++inputIndex) {
+            // alias the current slice
+            irtkRealImage& slice = reconstructor->_slices[inputIndex];
+                
+            //alias the current weight image
+            irtkRealImage& w = reconstructor->_weights[inputIndex];
+                
+            //alias the current bias image
+            irtkRealImage& b = reconstructor->_bias[inputIndex];
+                
+            //identify scale factor
+            double scale = reconstructor->_scale[inputIndex];
+
+            //compute error and weight of each slice voxel
+            int n = reconstructor->_voxcoeffs.GetOffset(inputIndex);
+            for ( int i = 0; i < slice.GetX(); i++)
+                for ( int j = 0; j < slice.GetY(); j++, n++)
+                    if (slice(i, j, 0) != -1) {
+                        //bias correct and scale the slice
+                        double e = slice(i, j, 0) * exp(-b(i, j, 0)) * scale;
+                        
+                        if ( reconstructor->_simulated_slices[inputIndex](i,j,0) > 0 )
+                            e -= reconstructor->_simulated_slices[inputIndex](i,j,0);
+                        else
+                            e = 0;
+
+                        error[n] = e * w(i, j, 0) * reconstructor->_slice_weight[inputIndex];
+                        weight[n] = w(i, j, 0) * reconstructor->_slice_weight[inputIndex];
+                    }
+                    else {
+                        error[n] = 0;
+                        weight[n] = 0;
+                    }
+        } //end of loop for a slice inputIndex
+    }
+
+    ParallelSuperresolutionValues( irtkReconstruction *reconstructor,
+                                   double *error,
+                                   double *weight ) :
+    reconstructor(reconstructor), error(error), weight(weight)
+    { }
+
+    // execute
+    void operator() () const {
+        task_scheduler_init init(tbb_no_threads);
+        size_t begin, end;
+        for (begin = 0; begin < reconstructor->_slices.size(); begin = end) {
+            end = reconstructor->SliceBatchEnd(begin);
+            parallel_for( blocked_range<size_t>(begin, end),
+                          *this );
+            reconstructor->ReleaseSlices(begin, end);
+        }
+        init.terminate();
+    }
+};
+
+class ParallelGather {
+    irtkReconstruction* reconstructor;
+    const double *values;
+    irtkRealImage *volume;
+public:
+    
+    void operator()( const blocked_range<size_t>& r ) const {
+        irtkRealPixel *ptr = volume->GetPointerToVoxels();
+        for ( size_t n = r.begin(); n < r.end(); ++n) {
+            ptr[n] = reconstructor->_voxcoeffs.Gather(n, values);
+        }
+    }
+
+    ParallelGather( irtkReconstruction *reconstructor,
+                    const double *values,
+                    irtkRealImage *volume ) :
+    reconstructor(reconstructor), values(values), volume(volume)
+    { }
+
+    // execute
+    void operator() () const {
+        task_scheduler_init init(tbb_no_threads);
+        parallel_for( blocked_range<size_t>(0, volume->GetNumberOfVoxels() ),
+                      *this );
+        init.terminate();
+    }
+};
+
 class ParallelSuperresolution {
     irtkReconstruction* reconstructor;
 public:
@@ -3177,7 +3518,7 @@ public:
             //Update reconstructed volume using current slice
 
             //Distribute error to the volume
-            POINT3D p;
+            const irtkSliceToVolumeMatrix& coeffs = reconstructor->_volcoeffs[inputIndex];
             for ( int i = 0; i < slice.GetX(); i++)
                 for ( int j = 0; j < slice.GetY(); j++)
                     if (slice(i, j, 0) != -1) {
@@ -3189,12 +3530,8 @@ public:
                         else
                             slice(i,j,0) = 0;
 
-                        int n = reconstructor->_volcoeffs[inputIndex][i][j].size();
-                        for (int k = 0; k < n; k++) {
-                            p = reconstructor->_volcoeffs[inputIndex][i][j][k];
-                            addon(p.x, p.y, p.z) += p.value * slice(i, j, 0) * w(i, j, 0) * reconstructor->_slice_weight[inputIndex];
-                            confidence_map(p.x, p.y, p.z) += p.value * w(i, j, 0) * reconstructor->_slice_weight[inputIndex];
-                        }
+                        coeffs.Adjoint(i, j, slice(i, j, 0) * w(i, j, 0) * reconstructor->_slice_weight[inputIndex], addon.GetPointerToVoxels());
+                        coeffs.Adjoint(i, j, w(i, j, 0) * reconstructor->_slice_weight[inputIndex], confidence_map.GetPointerToVoxels());
                     }
         } //end of loop for a slice inputIndex
     }
@@ -3231,8 +3568,13 @@ public:
     // execute
     void operator() () {
         task_scheduler_init init(tbb_no_threads);
-        parallel_reduce( blocked_range<size_t>(0,reconstructor->_slices.size()),
-                         *this );
+        size_t begin, end;
+        for (begin = 0; begin < reconstructor->_slices.size(); begin = end) {
+            end = reconstructor->SliceBatchEnd(begin);
+            parallel_reduce( blocked_range<size_t>(begin, end),
+                             *this );
+            reconstructor->ReleaseSlices(begin, end);
+        }
         init.terminate();
     }         
 };
@@ -3249,10 +3591,28 @@ void irtkReconstruction::Superresolution(int iter)
     //Remember current reconstruction for edge-preserving smoothing
     original = _reconstructed;
 
-    ParallelSuperresolution parallelSuperresolution(this);
-    parallelSuperresolution();
-    addon = parallelSuperresolution.addon;
-    _confidence_map = parallelSuperresolution.confidence_map;
+    if (_gather) {
+        //compute error and weight of all slice voxels and gather them into the volume
+        if (_voxcoeffs.IsEmpty())
+            _voxcoeffs.Initialize(_volcoeffs, _reconstructed.GetNumberOfVoxels());
+        vector<double> error(_voxcoeffs.GetNumberOfSliceVoxels());
+        vector<double> weight(_voxcoeffs.GetNumberOfSliceVoxels());
+        ParallelSuperresolutionValues parallelSuperresolutionValues(this, &error[0], &weight[0]);
+        parallelSuperresolutionValues();
+
+        addon.Initialize( _reconstructed.GetImageAttributes() );
+        _confidence_map.Initialize( _reconstructed.GetImageAttributes() );
+        ParallelGather gatherAddon(this, &error[0], &addon);
+        gatherAddon();
+        ParallelGather gatherConfidence(this, &weight[0], &_confidence_map);
+        gatherConfidence();
+    }
+    else {
+        ParallelSuperresolution parallelSuperresolution(this);
+        parallelSuperresolution();
+        addon = parallelSuperresolution.addon;
+        _confidence_map = parallelSuperresolution.confidence_map;
+    }
     //_confidence4mask = _confidence_map;
     
     if(_debug) {
@@ -3381,8 +3741,13 @@ public:
     // execute
     void operator() () {
         task_scheduler_init init(tbb_no_threads);
-        parallel_reduce( blocked_range<size_t>(0,reconstructor->_slices.size()),
-                         *this );
+        size_t begin, end;
+        for (begin = 0; begin < reconstructor->_slices.size(); begin = end) {
+            end = reconstructor->SliceBatchEnd(begin);
+            parallel_reduce( blocked_range<size_t>(begin, end),
+                             *this );
+            reconstructor->ReleaseSlices(begin, end);
+        }
         init.terminate();
     }    
 };
@@ -3698,6 +4063,55 @@ void irtkReconstruction::Evaluate(int iter)
 }
 
 
+class ParallelNormaliseBiasValues {
+    irtkReconstruction* reconstructor;
+    double *bias;
+public:
+    
+    void operator()( const blocked_range<size_t>& r ) const {
+        for ( size_t inputIndex = r.begin(); inputIndex < r.end(); ++inputIndex) {
+            // alias the current slice
+            irtkRealImage& slice = reconstructor->_slices[inputIndex];
+                
+            //alias the current bias image
+            irtkRealImage& b = reconstructor->_bias[inputIndex];
+                
+            //read current scale factor
+            double scale = reconstructor->_scale[inputIndex];
+
+            //compute bias of each slice voxel
+            int n = reconstructor->_voxcoeffs.GetOffset(inputIndex);
+            for (int i = 0; i < slice.GetX(); i++)
+                for (int j = 0; j < slice.GetY(); j++, n++)
+                    if (slice(i, j, 0) != -1) {
+                        bias[n] = b(i, j, 0);
+                        if ((slice(i, j, 0) > -1) && (scale > 0))
+                            bias[n] -= log(scale);
+                    }
+                    else
+                        bias[n] = 0;
+        }
+    }
+
+    ParallelNormaliseBiasValues( irtkReconstruction *reconstructor,
+                                 double *bias ) :
+    reconstructor(reconstructor), bias(bias)
+    { }
+
+    // execute
+    void operator() () const {
+        task_scheduler_init init(tbb_no_threads);
+        size_t begin, end;
+        for (begin = 0; begin < reconstructor->_slices.size(); begin = end) {
+            end = reconstructor->SliceBatchEnd(begin);
+            parallel_for( blocked_range<size_t>(begin, end),
+                          *this );
+            reconstructor->ReleaseSlices(begin, end);
+        }
+        init.terminate();
+    }
+};
+
 class ParallelNormaliseBias{
     irtkReconstruction* reconstructor;
 public:
@@ -3729,18 +4143,12 @@ public:
             }
                 
             //Distribute slice intensities to the volume
-            POINT3D p;
             for (int i = 0; i < slice.GetX(); i++)
                 for (int j = 0; j < slice.GetY(); j++)
                     if (slice(i, j, 0) != -1) {
-                        //number of volume voxels with non-zero coefficients for current slice voxel
-                        int n = reconstructor->_volcoeffs[inputIndex][i][j].size();
                         //add contribution of current slice voxel to all voxel volumes
                         //to which it contributes
-                        for (int k = 0; k < n; k++) {
-                            p = reconstructor->_volcoeffs[inputIndex][i][j][k];
-                            bias(p.x, p.y, p.z) += p.value * b(i, j, 0);
-                        }
+                        reconstructor->_volcoeffs[inputIndex].Adjoint(i, j, b(i, j, 0), bias.GetPointerToVoxels());
                     }
             //end of loop for a slice inputIndex                
         }
@@ -3767,8 +4175,13 @@ public:
     // execute
     void operator() () {
         task_scheduler_init init(tbb_no_threads);
-        parallel_reduce( blocked_range<size_t>(0,reconstructor->_slices.size()),
-                         *this );
+        size_t begin, end;
+        for (begin = 0; begin < reconstructor->_slices.size(); begin = end) {
+            end = reconstructor->SliceBatchEnd(begin);
+            parallel_reduce( blocked_range<size_t>(begin, end),
+                             *this );
+            reconstructor->ReleaseSlices(begin, end);
+        }
         init.terminate();
     }        
 };
@@ -3779,9 +4192,24 @@ void irtkReconstruction::NormaliseBias(int iter)
     if(_debug)
         cout << "Normalise Bias ... ";
 
-    ParallelNormaliseBias parallelNormaliseBias(this);
-    parallelNormaliseBias();
-    irtkRealImage bias = parallelNormaliseBias.bias;
+    irtkRealImage bias;
+    if (_gather) {
+        //compute bias of all slice voxels and gather them into the volume
+        if (_voxcoeffs.IsEmpty())
+            _voxcoeffs.Initialize(_volcoeffs, _reconstructed.GetNumberOfVoxels());
+        vector<double> values(_voxcoeffs.GetNumberOfSliceVoxels());
+        ParallelNormaliseBiasValues parallelNormaliseBiasValues(this, &values[0]);
+        parallelNormaliseBiasValues();
+
+        bias.Initialize( _reconstructed.GetImageAttributes() );
+        ParallelGather gatherBias(this, &values[0], &bias);
+        gatherBias();
+    }
+    else {
+        ParallelNormaliseBias parallelNormaliseBias(this);
+        parallelNormaliseBias();
+        bias = parallelNormaliseBias.bias;
+    }
     
     // normalize the volume by proportion of contributing slice voxels for each volume voxel
     bias /= _volume_weights;
@@ -3872,6 +4300,7 @@ void irtkReconstruction::SaveBiasFields()
     for (unsigned int inputIndex = 0; inputIndex < _slices.size(); inputIndex++) {
         sprintf(buffer, "bias%i.nii.gz", inputIndex);
         _bias[inputIndex].Write(buffer);
+        ReleaseSlices(inputIndex, inputIndex + 1);
     }
 }
 
@@ -3887,6 +4316,7 @@ void irtkReconstruction::SaveSlices()
         {
             sprintf(buffer, "slice%i.nii.gz", inputIndex);
             _slices[inputIndex].Write(buffer);
+            ReleaseSlices(inputIndex, inputIndex + 1);
         }
 }
 
@@ -3896,6 +4326,7 @@ void irtkReconstruction::SaveWeights()
     for (unsigned int inputIndex = 0; inputIndex < _slices.size(); inputIndex++) {
         sprintf(buffer, "weights%i.nii.gz", inputIndex);
         _weights[inputIndex].Write(buffer);
+        ReleaseSlices(inputIndex, inputIndex + 1);
     }
 }
 
@@ -3927,6 +4358,11 @@ void irtkReconstruction::SetSlices( vector<irtkRealImage> &slices )
     _slices.clear();    
     for (unsigned int i = 0; i < slices.size(); i++)
         _slices.push_back(slices[i]);
+
+    //slice-volume matrices need to be recomputed for new slices
+    _volcoeffs_matrices.clear();
+
+    MapSlices();
 }
 
 void irtkReconstruction::SaveProbabilityMap( int i )
@@ -0,0 +1,52 @@
+/*=========================================================================
+
+  Library   : Image Registration Toolkit (IRTK)
+  Module    : $Id$
+  Copyright : Imperial College, Department of Computing
+              Visual Information Processing (VIP), 2008 onwards
+  Date      : $Date$
+  Version   : $Revision$
+  Changes   : $Author$
+
+Copyright (c) 1999-2014 and onwards, Imperial College London
+All rights reserved.
+See LICENSE for details
+
+=========================================================================*/
+
+#include <irtkSliceToVolumeMatrix.h>
+
+irtkSliceToVolumeMatrix::irtkSliceToVolumeMatrix()
+{
+  _x = 0;
+  _y = 0;
+  _start.push_back(0);
+}
+
+void irtkSliceToVolumeMatrix::Initialize(int x, int y)
+{
+  _x = x;
+  _y = y;
+  _start.clear();
+  _index.clear();
+  _value.clear();
+  _start.reserve(x * y + 1);
+  _start.push_back(0);
+}
+
+void irtkSliceToVolumeMatrix::Clear()
+{
+  _x = 0;
+  _y = 0;
+
+  // Swap with empty vectors to release memory
+  vector<int>().swap(_start);
+  vector<int>().swap(_index);
+  vector<float>().swap(_value);
+  _start.push_back(0);
+}
+
+long irtkSliceToVolumeMatrix::GetMemorySize() const
+{
+  return _start.capacity() * sizeof(int) + _index.capacity() * sizeof(int) + _value.capacity() * sizeof(float);
+}
@@ -0,0 +1,92 @@
+/*=========================================================================
+
+  Library   : Image Registration Toolkit (IRTK)
+  Module    : $Id$
+  Copyright : Imperial College, Department of Computing
+              Visual Information Processing (VIP), 2008 onwards
+  Date      : $Date$
+  Version   : $Revision$
+  Changes   : $Author$
+
+Copyright (c) 1999-2014 and onwards, Imperial College London
+All rights reserved.
+See LICENSE for details
+
+=========================================================================*/
+
+#include <irtkVolumeToSliceMatrix.h>
+
+irtkVolumeToSliceMatrix::irtkVolumeToSliceMatrix()
+{
+  _offset.push_back(0);
+}
+
+void irtkVolumeToSliceMatrix::Initialize(const vector<irtkSliceToVolumeMatrix> &coeffs, int n)
+{
+  unsigned int s;
+  int i, j, k, m, index;
+  const int *indices;
+  const float *values;
+  vector<int> pos;
+
+  this->Clear();
+
+  // Index of first voxel of each slice
+  _offset.resize(coeffs.size() + 1);
+  for (s = 0; s < coeffs.size(); s++) {
+    _offset[s + 1] = _offset[s] + coeffs[s].GetX() * coeffs[s].GetY();
+  }
+
+  // Count entries of each volume voxel
+  _start.assign(n + 1, 0);
+  for (s = 0; s < coeffs.size(); s++) {
+    for (i = 0; i < coeffs[s].GetX(); i++) {
+      for (j = 0; j < coeffs[s].GetY(); j++) {
+        m       = coeffs[s].GetSize(i, j);
+        indices = coeffs[s].GetIndices(i, j);
+        for (k = 0; k < m; k++) {
+          _start[indices[k] + 1]++;
+        }
+      }
+    }
+  }
+  for (i = 0; i < n; i++) {
+    _start[i + 1] += _start[i];
+  }
+
+  // Fill rows in order of slice voxels
+  _index.resize(_start[n]);
+  _value.resize(_start[n]);
+  pos.assign(_start.begin(), _start.end() - 1);
+  for (s = 0; s < coeffs.size(); s++) {
+    index = _offset[s];
+    for (i = 0; i < coeffs[s].GetX(); i++) {
+      for (j = 0; j < coeffs[s].GetY(); j++) {
+        m       = coeffs[s].GetSize(i, j);
+        indices = coeffs[s].GetIndices(i, j);
+        values  = coeffs[s].GetValues(i, j);
+        for (k = 0; k < m; k++) {
+          _index[pos[indices[k]]] = index;
+          _value[pos[indices[k]]] = values[k];
+          pos[indices[k]]++;
+        }
+        index++;
+      }
+    }
+  }
+}
+
+void irtkVolumeToSliceMatrix::Clear()
+{
+  // Swap with empty vectors to release memory
+  vector<int>().swap(_offset);
+  vector<int>().swap(_start);
+  vector<int>().swap(_index);
+  vector<float>().swap(_value);
+  _offset.push_back(0);
+}
+
+long irtkVolumeToSliceMatrix::GetMemorySize() const
+{
+  return (_offset.capacity() + _start.capacity() + _index.capacity()) * sizeof(int) + _value.capacity() * sizeof(float);
+}
@@ -33,12 +33,16 @@ class irtkBSplineFreeFormTransformation3D : public irtkFreeFormTransformation3D
 
   friend class irtkImageFreeFormRegistration2;
 
+  friend class irtkMultiThreadedImageFreeFormRegistration2UpdateSource;
+
   friend class irtkImageGradientFreeFormRegistration2;
 
   friend class irtkMultipleImageFreeFormRegistration2;
 
   friend class irtkLinearFreeFormTransformation;
 
+  friend class irtkBSplineFreeFormTransformation3DIterator;
+
 protected:
 
   /// Returns the value of the first B-spline basis function
@@ -151,6 +155,14 @@ protected:
   /// Calculates a 3D FFD (for a point in FFD coordinates)
   virtual void FFD3D(double &, double &, double &) const;
 
+  /** Calculates a 3D FFD for a batch of points in world coordinates. The
+      points are replaced by their displacements, or by the transformed
+      points if the last argument is true. A point which lies in the same
+      lattice cell as its predecessor and has the same basis function values
+      along y and z, e.g. the next voxel of an image row aligned with the
+      lattice, reuses the tensor product along y and z of its predecessor. */
+  virtual void FFD3D(int, double *, double *, double *, bool) const;
+
   /// Calculate the bending energy of the transformation at control points (2D)
   virtual double Bending2D(int i, int j);
 
@@ -254,6 +266,15 @@ public:
   /// Calculates displacement using the local transformation component only
   virtual void LocalDisplacement(double &, double &, double &, double = 0);
 
+  /// Transforms a batch of points
+  virtual void Transform(int, double *, double *, double *, double = 0);
+
+  /// Calculates the displacements of a batch of points
+  virtual void Displacement(int, double *, double *, double *, double = 0);
+
+  /// Calculate displacement vectors for image
+  virtual void Displacement(irtkGenericImage<double> &, double = 0);
+
   /// Calculate the Jacobian of the transformation
   virtual void Jacobian(irtkMatrix &, double, double, double, double = 0);
 
@@ -0,0 +1,107 @@
+/*=========================================================================
+
+  Library   : Image Registration Toolkit (IRTK)
+  Module    : $Id$
+  Copyright : Imperial College, Department of Computing
+              Visual Information Processing (VIP), 2008 onwards
+  Date      : $Date$
+  Version   : $Revision$
+  Changes   : $Author$
+
+Copyright (c) IXICO LIMITED
+All rights reserved.
+See COPYRIGHT for details
+
+=========================================================================*/
+
+#ifndef _IRTKBSPLINEFREEFORMTRANSFORMATION3D_ITERATOR_H
+
+#define _IRTKBSPLINEFREEFORMTRANSFORMATION3D_ITERATOR_H
+
+/**
+ * Class for iterator for 3D B-spline free form transformations.
+ *
+ * This class evaluates the displacements of a B-spline FFD for all voxels
+ * of an image, one slice and one row at a time. If the image axes are
+ * aligned with the control point lattice, the tensor product is summed
+ * along z once per slice (for all control points of the slab), along y
+ * once per row, and only the basis functions along x are evaluated for
+ * each voxel. If the image is not aligned with the lattice, the iterator
+ * falls back to transforming the points of each row.
+ *
+ * NOTE: This class has NO copy constructor
+ */
+
+class irtkBSplineFreeFormTransformation3DIterator
+{
+
+  /// Pointer to transformation
+  irtkBSplineFreeFormTransformation3D *_transformation;
+
+  /// Pointer to image
+  irtkBaseImage *_image;
+
+  /// Image to lattice coordinates
+  double _matrix[3][4];
+
+  /// Flag whether image axes are aligned with the lattice
+  bool _aligned;
+
+  /// Flag whether current slice intersects the lattice support
+  bool _inside;
+
+  /// Current slice
+  int _k;
+
+  /// Lattice cell along x for each voxel of a row
+  int *_l;
+
+  /// Lookup table index along x for each voxel of a row (-1 if outside)
+  int *_S;
+
+  /// Range of control points along x and y needed by the image
+  int _i1, _i2, _j1, _j2;
+
+  /// Partial sums along z of the current slice
+  double *_slab;
+
+  /// Partial sums along y and z of the current row
+  double *_row;
+
+public:
+
+  /// Constructor
+  irtkBSplineFreeFormTransformation3DIterator(irtkBSplineFreeFormTransformation3D * = NULL);
+
+  /// Destructor
+  ~irtkBSplineFreeFormTransformation3DIterator();
+
+  /** Initialize iterator for an image. This function must be called again
+   *  whenever the lattice or the image geometry changes. */
+  void Initialize(irtkBaseImage *);
+
+  /** Computes the partial sums along z for slice k. This function must be
+   *  called again whenever the control point values change. */
+  void Slice(int);
+
+  /** Computes the displacements of all voxels of row j in the current slice */
+  void Row(int, double *, double *, double *);
+
+  /// Returns whether the image is aligned with the lattice
+  bool IsAligned() const;
+
+  /** Sets the transformation for the iterator. */
+  void SetTransformation(irtkBSplineFreeFormTransformation3D *);
+};
+
+inline bool irtkBSplineFreeFormTransformation3DIterator::IsAligned() const
+{
+  return _aligned;
+}
+
+inline void irtkBSplineFreeFormTransformation3DIterator::SetTransformation(irtkBSplineFreeFormTransformation3D *transformation)
+{
+  _transformation = transformation;
+}
+
+#endif
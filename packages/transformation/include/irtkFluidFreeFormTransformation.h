@@ -73,6 +73,15 @@ public:
   /// Calculates displacement using the local transformation component only
   virtual void LocalDisplacement(int, double &, double &, double &, double = 0);
 
+  /// Transforms a batch of points by composing the levels point by point
+  virtual void Transform(int, double *, double *, double *, double = 0);
+
+  /// Calculates the displacements of a batch of points
+  virtual void Displacement(int, double *, double *, double *, double = 0);
+
+  /// Calculate displacement vectors for image
+  virtual void Displacement(irtkGenericImage<double> &, double = 0);
+
   /** Convert the global transformation from a matrix representation to a
       FFD and incorporate it with any existing local displacement. **/
   virtual void MergeGlobalIntoLocalDisplacement();
@@ -29,11 +29,27 @@ See COPYRIGHT for details
 class irtkFreeFormTransformation : public irtkTransformation
 {
 
+protected:
+
+  /// Number of modifications of the control points or the lattice
+  unsigned long _NumberOfModifications;
+
 public:
 
+  /// Constructor
+  irtkFreeFormTransformation();
+
   /// Destructor
   virtual ~irtkFreeFormTransformation();
 
+  /// Records a modification of the control points or the lattice
+  void Modified();
+
+  /** Returns the number of modifications of the control points or the
+   *  lattice. Objects which cache results derived from the transformation
+   *  compare this number to detect that their cache is out of date. */
+  unsigned long GetNumberOfModifications() const;
+
   /// Returns the number of control points in x
   virtual int GetX() const = 0;
 
@@ -62,6 +78,16 @@ public:
   virtual double Bending(double, double, double, double = 0.0) = 0;
 };
 
+inline void irtkFreeFormTransformation::Modified()
+{
+  _NumberOfModifications++;
+}
+
+inline unsigned long irtkFreeFormTransformation::GetNumberOfModifications() const
+{
+  return _NumberOfModifications;
+}
+
 inline const char *irtkFreeFormTransformation::NameOfClass()
 {
   return "irtkFreeFormTransformation";
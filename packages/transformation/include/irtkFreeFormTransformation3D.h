@@ -321,6 +321,7 @@ inline void irtkFreeFormTransformation3D::Put(int index, double x)
       _data[k][j][i]._z = x;
     }
   }
+  this->Modified();
 }
 
 inline void irtkFreeFormTransformation3D::Put(int i, int j, int k, double x, double y, double z)
@@ -332,6 +333,7 @@ inline void irtkFreeFormTransformation3D::Put(int i, int j, int k, double x, dou
   _data[k][j][i]._x = x;
   _data[k][j][i]._y = y;
   _data[k][j][i]._z = z;
+  this->Modified();
 }
 
 inline void irtkFreeFormTransformation3D::GetSpacing(double &dx, double &dy, double &dz) const
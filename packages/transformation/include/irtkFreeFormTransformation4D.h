@@ -351,6 +351,7 @@ inline void irtkFreeFormTransformation4D::Put(int index, double x)
 
     _zdata[l][k][j][i] = x;
   }
+  this->Modified();
 }
 
 inline void irtkFreeFormTransformation4D::Put(int i, int j, int k, int l, double x, double y, double z)
@@ -362,6 +363,7 @@ inline void irtkFreeFormTransformation4D::Put(int i, int j, int k, int l, double
   _xdata[l][k][j][i] = x;
   _ydata[l][k][j][i] = y;
   _zdata[l][k][j][i] = z;
+  this->Modified();
 }
 
 inline void irtkFreeFormTransformation4D::GetSpacing(double &dx, double &dy, double &dz, double &dt) const
@@ -89,6 +89,12 @@ public:
   /// Calculates displacement using the local transformation component only
   virtual void LocalDisplacement(double &, double &, double &, double = 0);
 
+  /// Transforms a batch of points
+  virtual void Transform(int, double *, double *, double *, double = 0);
+
+  /// Calculates the displacements of a batch of points
+  virtual void Displacement(int, double *, double *, double *, double = 0);
+
   /// Inverts the transformation
   virtual void Invert();
 
@@ -76,6 +76,17 @@ public:
   /// Flag whether input is 2D
   int _2D;
 
+  /** Transforms (or inverts the transformation for) the foreground voxels
+      of a row of the output image (row, slice, frame, time). The points are
+      returned in world coordinates in the order of the voxels. */
+  void TransformRow(int, int, int, double, double *, double *, double *);
+
+  /** Interpolates the input image at the transformed foreground voxels of a
+      row of the output image (row, slice, frame, input frame, 2D) and writes
+      the row. The points are given in world coordinates as returned by
+      TransformRow and are overwritten, the remaining arrays are workspace. */
+  void InterpolateRow(int, int, int, double, bool, double *, double *, double *, double *, int *);
+
 public:
 
   /** Constructor. This constructs an transformation filter with a given
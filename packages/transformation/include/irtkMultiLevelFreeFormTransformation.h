@@ -33,6 +33,39 @@ See COPYRIGHT for details
 class irtkMultiLevelFreeFormTransformation : public irtkAffineTransformation
 {
 
+protected:
+
+  /** Local displacement rasterized on a lattice (optional). The three
+      components are stored as frames of the image. */
+  irtkGenericImage<double> *_displacementCache;
+
+  /// Local transformations for which the cached displacement is valid
+  irtkFreeFormTransformation *_displacementCacheLevel[MAX_TRANS+1];
+
+  /// Number of modifications of each local transformation when the displacement was cached
+  unsigned long _displacementCacheModifications[MAX_TRANS+1];
+
+  /// Number of local transformations for which the cached displacement is valid
+  int _displacementCacheNumberOfLevels;
+
+  /// Time for which the displacement has been cached (if any level is 4D)
+  double _displacementCacheTime;
+
+  /// Whether the cached displacement depends on time
+  bool _displacementCacheTimeDependent;
+
+  /// Looks up the local displacement in the cache, returns false if not cached
+  bool CachedLocalDisplacement(double, double, double, double, double &, double &, double &);
+
+  /** Computes the local displacements of a batch of points (given by the
+      first triple of arrays) and stores them in the second triple of arrays */
+  void LocalDisplacement(int, const double *, const double *, const double *, double *, double *, double *, double);
+
+  /** Newton iteration for the inverse of a single point, starting from the
+      estimate passed in the second triple of arguments. The inverse of the
+      Jacobian at the last iterate is returned in the last argument. */
+  double NewtonInverse(double, double, double, double &, double &, double &, double, double [3][3]);
+
 public:
 
   /// Local transformations
@@ -98,6 +131,15 @@ public:
   /// Calculates displacement using the local transformation component only
   virtual void LocalDisplacement(double &, double &, double &, double = 0);
 
+  /// Transforms a batch of points
+  virtual void Transform(int, double *, double *, double *, double = 0);
+
+  /// Calculates the displacements of a batch of points
+  virtual void Displacement(int, double *, double *, double *, double = 0);
+
+  /// Calculate displacement vectors for image
+  virtual void Displacement(irtkGenericImage<double> &, double = 0);
+
   /** Convert the global transformation from a matrix representation to a
       FFD and incorporate it with any existing local displacement. **/
   virtual void MergeGlobalIntoLocalDisplacement();
@@ -114,6 +156,27 @@ public:
   /// Calculates displacement using the local transformation component only
   virtual void LocalDisplacement(int, double &, double &, double &, double = 0);
 
+  /** Rasterizes the local displacement of all levels on the given lattice.
+      Subsequent calls of Transform, Displacement, LocalTransform and
+      LocalDisplacement for points inside the lattice use trilinear
+      interpolation of the cached displacement instead of evaluating each
+      level. At the lattice points the result is exact. The cache is
+      ignored as soon as levels are added, removed or replaced, or when
+      the control points or the lattice of a level are modified. Nothing
+      is done if the cache is already valid for the lattice. The cache only
+      pays off if the same points are evaluated more than once, e.g. for
+      several channels or frames of an image. */
+  virtual void CacheDisplacement(const irtkImageAttributes &, double = 0);
+
+  /// Deletes the cached local displacement
+  virtual void InvalidateDisplacementCache();
+
+  /// Checks whether the cached local displacement is valid
+  virtual bool IsDisplacementCacheValid() const;
+
+  /// Checks whether the cached local displacement is valid and has been computed for the given lattice
+  virtual bool IsDisplacementCacheValid(const irtkImageAttributes &) const;
+
   /// Calculate the Jacobian of the transformation
   virtual void Jacobian(irtkMatrix &, double, double, double, double = 0);
 
@@ -140,6 +203,12 @@ public:
   /// Inverts the transformation
   virtual double Inverse(double &, double &, double &, double = 0, double = 0.01);
 
+  /// Inverts the transformation for a row of points using warm starts
+  virtual double InverseRow(int, double *, double *, double *, double = 0, double = 0.01);
+
+  /// Calculate displacement vectors of the inverse transformation for image
+  virtual void InverseDisplacement(irtkGenericImage<double> &, double = 0, double = 0.01);
+
   /// Checks whether transformation is an identity mapping
   virtual bool IsIdentity();
 
@@ -186,6 +255,7 @@ inline void irtkMultiLevelFreeFormTransformation::PutLocalTransformation(irtkFre
 {
   if (i < _NumberOfLevels) {
     _localTransformation[i] = transformation;
+    this->InvalidateDisplacementCache();
   } else {
     cerr << "irtkMultiLevelFreeFormTransformation::PutLocalTransformation: No such "
          << "transformation" << endl;
@@ -198,6 +268,7 @@ inline void irtkMultiLevelFreeFormTransformation::PushLocalTransformation(irtkFr
   if (_NumberOfLevels < MAX_TRANS) {
     _localTransformation[_NumberOfLevels] = transformation;
     _NumberOfLevels++;
+    this->InvalidateDisplacementCache();
   } else {
     cerr << "irtkMultiLevelFreeFormTransformation::PushLocalTransformation: Stack "
          << "overflow" << endl;
@@ -213,6 +284,7 @@ inline void irtkMultiLevelFreeFormTransformation::InsertLocalTransformation(irtk
   	for (i = pos; i < _NumberOfLevels + 1; i++) _localTransformation[i+1] = _localTransformation[i];
   	_localTransformation[pos] = transformation;
     _NumberOfLevels++;
+    this->InvalidateDisplacementCache();
   } else {
     cerr << "irtkMultiLevelFreeFormTransformation::Insert"
     		"LocalTransformation: Stack overflow" << endl;
@@ -228,6 +300,7 @@ inline irtkFreeFormTransformation *irtkMultiLevelFreeFormTransformation::PopLoca
     localTransformation = _localTransformation[_NumberOfLevels-1];
     _localTransformation[_NumberOfLevels-1] = NULL;
     _NumberOfLevels--;
+    this->InvalidateDisplacementCache();
   } else {
     cerr << "irtkMultiLevelFreeFormTransformation:PopLocalTransformation: Stack underflow" << endl;
     exit(1);
@@ -245,6 +318,7 @@ inline irtkFreeFormTransformation *irtkMultiLevelFreeFormTransformation::RemoveL
   	for (i = _NumberOfLevels-1; i > pos; i--) _localTransformation[i-1] = _localTransformation[i];
     _localTransformation[_NumberOfLevels-1] = NULL;
     _NumberOfLevels--;
+    this->InvalidateDisplacementCache();
   } else {
     cerr << "irtkMultiLevelFreeFormTransformation:DeleteLocalTransformation: No such " << "transformation" << endl;
     exit(1);
@@ -252,6 +326,40 @@ inline irtkFreeFormTransformation *irtkMultiLevelFreeFormTransformation::RemoveL
   return localTransformation;
 }
 
+inline void irtkMultiLevelFreeFormTransformation::InvalidateDisplacementCache()
+{
+  delete _displacementCache;
+  _displacementCache = NULL;
+  _displacementCacheNumberOfLevels = 0;
+}
+
+inline bool irtkMultiLevelFreeFormTransformation::IsDisplacementCacheValid() const
+{
+  int i;
+
+  if (_displacementCache == NULL) return false;
+  if (_displacementCacheNumberOfLevels != _NumberOfLevels) return false;
+  for (i = 0; i < _NumberOfLevels; i++) {
+    if (_displacementCacheLevel[i] != _localTransformation[i]) return false;
+    if (_displacementCacheModifications[i] != _localTransformation[i]->GetNumberOfModifications()) return false;
+  }
+  return true;
+}
+
+inline bool irtkMultiLevelFreeFormTransformation::IsDisplacementCacheValid(const irtkImageAttributes &attr) const
+{
+  irtkImageAttributes cacheAttr;
+
+  if (this->IsDisplacementCacheValid() == false) return false;
+
+  // Compare spatial attributes only, displacement components are stored as frames
+  cacheAttr = _displacementCache->GetImageAttributes();
+  cacheAttr._t       = attr._t;
+  cacheAttr._dt      = attr._dt;
+  cacheAttr._torigin = attr._torigin;
+  return (cacheAttr == attr);
+}
+
 inline const char *irtkMultiLevelFreeFormTransformation::NameOfClass()
 {
   return "irtkMultiLevelFreeFormTransformation";
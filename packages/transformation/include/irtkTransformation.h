@@ -123,9 +123,23 @@ public:
   /// Calculates displacement using the local transformation component only
   virtual void LocalDisplacement(double &, double &, double &, double = 0);
 
+  /** Transforms a batch of points in 4D. The default transforms each point
+      separately, subclasses override this to avoid a virtual function call
+      per point. */
+  virtual void Transform(int, double *, double *, double *, double = 0);
+
+  /// Calculates the displacements of a batch of points
+  virtual void Displacement(int, double *, double *, double *, double = 0);
+
   /// Inverts the transformation (abstract)
   virtual double Inverse(double &, double &, double &, double = 0, double = 0.01) = 0;
 
+  /** Inverts the transformation for a row of points. Consecutive points
+      should be close to each other so that implementations can start the
+      inversion of each point from the solution of its predecessor. The
+      function returns the maximum error. */
+  virtual double InverseRow(int, double *, double *, double *, double = 0, double = 0.01);
+
   /// Calculate the Jacobian of the transformation with respect to the transformation parameters
   virtual void JacobianDOFs(double [3], int, double, double, double, double = 0);
 
@@ -150,6 +164,9 @@ public:
   /// Calculate displacement vectors for image
   virtual void Displacement(irtkGenericImage<double> &, double = 0);
 
+  /// Calculate displacement vectors of the inverse transformation for image
+  virtual void InverseDisplacement(irtkGenericImage<double> &, double = 0, double = 0.01);
+
   /// Checks whether transformation is an identity mapping (abstract)
   virtual bool IsIdentity() = 0;
 
@@ -213,11 +230,25 @@ inline void irtkTransformation::Transform(irtkPoint &p)
 
 inline void irtkTransformation::Transform(irtkPointSet &pset)
 {
-  for (int i = 0; i < pset.Size(); i++) {
-    irtkPoint p = pset(i);
-    this->Transform(p._x, p._y, p._z);
-    pset(i) = p;
+  int i, n;
+  double *x, *y, *z;
+
+  n = pset.Size();
+  x = new double[n];
+  y = new double[n];
+  z = new double[n];
+  for (i = 0; i < n; i++) {
+    x[i] = pset(i)._x;
+    y[i] = pset(i)._y;
+    z[i] = pset(i)._z;
+  }
+  this->Transform(n, x, y, z);
+  for (i = 0; i < n; i++) {
+    pset(i) = irtkPoint(x[i], y[i], z[i]);
   }
+  delete []x;
+  delete []y;
+  delete []z;
 }
 
 inline void irtkTransformation::Displacement(double &x, double &y, double &z, double t)
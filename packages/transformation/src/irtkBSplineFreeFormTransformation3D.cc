@@ -16,6 +16,8 @@ See COPYRIGHT for details
 
 #include <irtkTransformation.h>
 
+#include <irtkBSplineFreeFormTransformation3DIterator.h>
+
 #define LUTSIZE (double)(FFDLOOKUPTABLESIZE-1)
 
 double irtkBSplineFreeFormTransformation3D::LookupTable   [FFDLOOKUPTABLESIZE][4];
@@ -701,6 +703,145 @@ void irtkBSplineFreeFormTransformation3D::FFD3D(double &x, double &y, double &z)
 	}
 }
 
+void irtkBSplineFreeFormTransformation3D::FFD3D(int n, double *x, double *y, double *z, bool add) const
+{
+	irtkVector3D<double> *data;
+	double u, v, w, B_I, B_J, B_K, col[4][3], m[3][4];
+	int a, i, j, k, l, p, q, r, S, T, U, l0, q0, r0, T0, U0;
+	bool valid;
+
+	// Copy world to lattice matrix once for all points
+	for (j = 0; j < 3; j++) {
+		for (i = 0; i < 4; i++) {
+			m[j][i] = _matW2L(j, i);
+		}
+	}
+
+	valid = false;
+	l0 = q0 = r0 = T0 = U0 = 0;
+	for (p = 0; p < n; p++) {
+		// Convert world coordinates in to FFD coordinates
+		u = m[0][0]*x[p]+m[0][1]*y[p]+m[0][2]*z[p]+m[0][3];
+		v = m[1][0]*x[p]+m[1][1]*y[p]+m[1][2]*z[p]+m[1][3];
+		w = m[2][0]*x[p]+m[2][1]*y[p]+m[2][2]*z[p]+m[2][3];
+
+		// Check if there is some work to do
+		if ((u < -2) || (v < -2) || (w < -2) || (u > _x+1) || (v > _y+1) || (w > _z+1)) {
+			if (add == false) {
+				x[p] = 0;
+				y[p] = 0;
+				z[p] = 0;
+			}
+			continue;
+		}
+
+		l = (int)floor(u);
+		q = (int)floor(v);
+		r = (int)floor(w);
+		S = round(LUTSIZE*(u-l));
+		T = round(LUTSIZE*(v-q));
+		U = round(LUTSIZE*(w-r));
+
+		// Tensor product along y and z for each of the four control points along x
+		if ((valid == false) || (l != l0) || (q != q0) || (r != r0) || (T != T0) || (U != U0)) {
+			for (a = 0; a < 4; a++) {
+				col[a][0] = 0;
+				col[a][1] = 0;
+				col[a][2] = 0;
+			}
+			data = &(_data[r-1][q-1][l-1]);
+			for (k = 0; k < 4; k++) {
+				B_K = this->LookupTable[U][k];
+				for (j = 0; j < 4; j++) {
+					B_J = this->LookupTable[T][j] * B_K;
+					for (a = 0; a < 4; a++) {
+						col[a][0] += B_J * data[a]._x;
+						col[a][1] += B_J * data[a]._y;
+						col[a][2] += B_J * data[a]._z;
+					}
+					data += _x + 8;
+				}
+				data += (_x + 8) * (_y + 4);
+			}
+			l0 = l;
+			q0 = q;
+			r0 = r;
+			T0 = T;
+			U0 = U;
+			valid = true;
+		}
+
+		// Basis functions along x
+		u = 0;
+		v = 0;
+		w = 0;
+		for (a = 0; a < 4; a++) {
+			B_I = this->LookupTable[S][a];
+			u += B_I * col[a][0];
+			v += B_I * col[a][1];
+			w += B_I * col[a][2];
+		}
+
+		if (add == true) {
+			x[p] += u;
+			y[p] += v;
+			z[p] += w;
+		} else {
+			x[p] = u;
+			y[p] = v;
+			z[p] = w;
+		}
+	}
+}
+
+void irtkBSplineFreeFormTransformation3D::Transform(int n, double *x, double *y, double *z, double t)
+{
+	if (_z == 1) {
+		this->irtkTransformation::Transform(n, x, y, z, t);
+	} else {
+		this->FFD3D(n, x, y, z, true);
+	}
+}
+
+void irtkBSplineFreeFormTransformation3D::Displacement(int n, double *x, double *y, double *z, double t)
+{
+	if (_z == 1) {
+		this->irtkTransformation::Displacement(n, x, y, z, t);
+	} else {
+		this->FFD3D(n, x, y, z, false);
+	}
+}
+
+void irtkBSplineFreeFormTransformation3D::Displacement(irtkGenericImage<double> &image, double)
+{
+	int i, j, k;
+	double *dx, *dy, *dz;
+
+	irtkBSplineFreeFormTransformation3DIterator iterator(this);
+	iterator.Initialize(&image);
+
+	dx = new double[image.GetX()];
+	dy = new double[image.GetX()];
+	dz = new double[image.GetX()];
+
+	// Calculate displacement field slice by slice and row by row
+	for (k = 0; k < image.GetZ(); k++) {
+		iterator.Slice(k);
+		for (j = 0; j < image.GetY(); j++) {
+			iterator.Row(j, dx, dy, dz);
+			for (i = 0; i < image.GetX(); i++) {
+				image(i, j, k, 0) = dx[i];
+				image(i, j, k, 1) = dy[i];
+				image(i, j, k, 2) = dz[i];
+			}
+		}
+	}
+
+	delete []dx;
+	delete []dy;
+	delete []dz;
+}
+
 void irtkBSplineFreeFormTransformation3D::Jacobian(irtkMatrix &jac, double x, double y, double z, double t)
 {
 	this->LocalJacobian(jac, x, y, z, t);
@@ -1631,6 +1772,7 @@ void irtkBSplineFreeFormTransformation3D::ApproximateAsNew3D(const double *x1, c
 
 void irtkBSplineFreeFormTransformation3D::ApproximateAsNew(const double *x1, const double *y1, const double *z1, double *x2, double *y2, double *z2, int no)
 {
+	this->Modified();
 	if (_z == 1) {
 		ApproximateAsNew2D(x1, y1, z1, x2, y2, z2, no);
 	} else {
@@ -2062,6 +2204,7 @@ double irtkBSplineFreeFormTransformation3D::Approximate3D(const double *x1, cons
 
 double irtkBSplineFreeFormTransformation3D::Approximate(const double *x1, const double *y1, const double *z1, double *x2, double *y2, double *z2, int no)
 {
+	this->Modified();
 	if (_z == 1) {
 		return Approximate2D(x1, y1, z1, x2, y2, z2, no);
 	} else {
@@ -2088,6 +2231,7 @@ void irtkBSplineFreeFormTransformation3D::Interpolate(const double* dxs, const d
 			}
 		}
 	}
+	this->Modified();
 }
 
 void irtkBSplineFreeFormTransformation3D::Subdivide()
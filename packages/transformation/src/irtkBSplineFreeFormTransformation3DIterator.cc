@@ -0,0 +1,249 @@
+/*=========================================================================
+
+  Library   : Image Registration Toolkit (IRTK)
+  Module    : $Id$
+  Copyright : Imperial College, Department of Computing
+              Visual Information Processing (VIP), 2008 onwards
+  Date      : $Date$
+  Version   : $Revision$
+  Changes   : $Author$
+
+Copyright (c) IXICO LIMITED
+All rights reserved.
+See COPYRIGHT for details
+
+=========================================================================*/
+
+#include <irtkTransformation.h>
+
+#include <irtkBSplineFreeFormTransformation3DIterator.h>
+
+#define LUTSIZE (double)(FFDLOOKUPTABLESIZE-1)
+
+irtkBSplineFreeFormTransformation3DIterator::irtkBSplineFreeFormTransformation3DIterator(irtkBSplineFreeFormTransformation3D *transformation)
+{
+  _transformation = transformation;
+  _image   = NULL;
+  _aligned = false;
+  _inside  = false;
+  _k       = 0;
+  _l       = NULL;
+  _S       = NULL;
+  _slab    = NULL;
+  _row     = NULL;
+  _i1 = _j1 = 0;
+  _i2 = _j2 = -1;
+}
+
+irtkBSplineFreeFormTransformation3DIterator::~irtkBSplineFreeFormTransformation3DIterator()
+{
+  delete []_l;
+  delete []_S;
+  delete []_slab;
+  delete []_row;
+}
+
+void irtkBSplineFreeFormTransformation3DIterator::Initialize(irtkBaseImage *image)
+{
+  int i, j, l, X, Y, Z;
+  double u;
+
+  if (_transformation == NULL) {
+    cerr << "irtkBSplineFreeFormTransformation3DIterator::Initialize(): Transformation has not been set." << endl;
+    exit(1);
+  }
+
+  if (image == NULL) {
+    cerr << "irtkBSplineFreeFormTransformation3DIterator::Initialize(): Image has not been set." << endl;
+    exit(1);
+  }
+  _image = image;
+
+  // Image to lattice coordinates
+  irtkMatrix matrix = _transformation->_matW2L * _image->GetImageToWorldMatrix();
+  for (j = 0; j < 3; j++) {
+    for (i = 0; i < 4; i++) {
+      _matrix[j][i] = matrix(j, i);
+    }
+  }
+
+  // Check whether lattice coordinates along each axis depend on the voxel index along that axis only,
+  // i.e. whether the other voxel indices change them by less than the tolerance anywhere in the image
+  X = _image->GetX() - 1;
+  Y = _image->GetY() - 1;
+  Z = _image->GetZ() - 1;
+  _aligned = (fabs(_matrix[0][1]) * Y + fabs(_matrix[0][2]) * Z < 1e-6) &&
+             (fabs(_matrix[1][0]) * X + fabs(_matrix[1][2]) * Z < 1e-6);
+  if (_transformation->_z > 1) {
+    _aligned = _aligned && (fabs(_matrix[2][0]) * X + fabs(_matrix[2][1]) * Y < 1e-6);
+  }
+
+  delete []_l;
+  delete []_S;
+  delete []_slab;
+  delete []_row;
+  _l    = new int[_image->GetX()];
+  _S    = new int[_image->GetX()];
+  _slab = NULL;
+  _row  = NULL;
+  _i1 = _j1 = 0;
+  _i2 = _j2 = -1;
+  _inside = false;
+
+  if (_aligned == false) return;
+
+  // Lattice cell and basis functions along x for each voxel of a row
+  _i1 = _transformation->_x + 3;
+  _i2 = -3;
+  for (i = 0; i < _image->GetX(); i++) {
+    u = _matrix[0][0] * i + _matrix[0][3];
+    if ((u < -2) || (u > _transformation->_x+1)) {
+      _l[i] = 0;
+      _S[i] = -1;
+    } else {
+      l = (int)floor(u);
+      _l[i] = l;
+      _S[i] = round(LUTSIZE*(u-l));
+      if (l-1 < _i1) _i1 = l-1;
+      if (l+2 > _i2) _i2 = l+2;
+    }
+  }
+
+  // Range of control points along y
+  _j1 = _transformation->_y + 3;
+  _j2 = -3;
+  for (j = 0; j < _image->GetY(); j++) {
+    u = _matrix[1][1] * j + _matrix[1][3];
+    if ((u >= -2) && (u <= _transformation->_y+1)) {
+      l = (int)floor(u);
+      if (l-1 < _j1) _j1 = l-1;
+      if (l+2 > _j2) _j2 = l+2;
+    }
+  }
+
+  if ((_i1 <= _i2) && (_j1 <= _j2)) {
+    _slab = new double[3 * (_i2 - _i1 + 1) * (_j2 - _j1 + 1)];
+    _row  = new double[3 * (_i2 - _i1 + 1)];
+  }
+}
+
+void irtkBSplineFreeFormTransformation3DIterator::Slice(int k)
+{
+  int a, c, i, j, r, U, X;
+  double w, B_K, *slab;
+  irtkVector3D<double> *data;
+
+  _k = k;
+  if ((_aligned == false) || (_slab == NULL)) return;
+
+  X    = _i2 - _i1 + 1;
+  slab = _slab;
+
+  if (_transformation->_z == 1) {
+    // Control points of 2D lattice, no displacements along z
+    for (j = _j1; j <= _j2; j++) {
+      data = &(_transformation->_data[0][j][_i1]);
+      for (i = 0; i < X; i++) {
+        slab[0] = data[i]._x;
+        slab[1] = data[i]._y;
+        slab[2] = 0;
+        slab += 3;
+      }
+    }
+    _inside = true;
+    return;
+  }
+
+  // Check if slice intersects the lattice support
+  w = _matrix[2][2] * k + _matrix[2][3];
+  if ((w < -2) || (w > _transformation->_z+1)) {
+    _inside = false;
+    return;
+  }
+  r = (int)floor(w);
+  U = round(LUTSIZE*(w-r));
+
+  // Sum tensor product along z for each control point of the slab
+  for (a = 0; a < 3 * X * (_j2 - _j1 + 1); a++) {
+    _slab[a] = 0;
+  }
+  for (c = 0; c < 4; c++) {
+    B_K  = _transformation->LookupTable[U][c];
+    slab = _slab;
+    for (j = _j1; j <= _j2; j++) {
+      data = &(_transformation->_data[r-1+c][j][_i1]);
+      for (i = 0; i < X; i++) {
+        slab[0] += B_K * data[i]._x;
+        slab[1] += B_K * data[i]._y;
+        slab[2] += B_K * data[i]._z;
+        slab += 3;
+      }
+    }
+  }
+  _inside = true;
+}
+
+void irtkBSplineFreeFormTransformation3DIterator::Row(int j, double *dx, double *dy, double *dz)
+{
+  int a, b, i, q, T, X;
+  double v, B_I, B_J, *row, *slab;
+
+  // Transform points of row if image is not aligned with the lattice
+  if (_aligned == false) {
+    for (i = 0; i < _image->GetX(); i++) {
+      dx[i] = i;
+      dy[i] = j;
+      dz[i] = _k;
+      _image->ImageToWorld(dx[i], dy[i], dz[i]);
+    }
+    _transformation->Displacement(_image->GetX(), dx, dy, dz);
+    return;
+  }
+
+  // Check if row intersects the lattice support
+  v = _matrix[1][1] * j + _matrix[1][3];
+  if ((_inside == false) || (_slab == NULL) || (v < -2) || (v > _transformation->_y+1)) {
+    for (i = 0; i < _image->GetX(); i++) {
+      dx[i] = 0;
+      dy[i] = 0;
+      dz[i] = 0;
+    }
+    return;
+  }
+  q = (int)floor(v);
+  T = round(LUTSIZE*(v-q));
+
+  // Sum tensor product along y for each control point of the row
+  X = _i2 - _i1 + 1;
+  for (a = 0; a < 3 * X; a++) {
+    _row[a] = 0;
+  }
+  for (b = 0; b < 4; b++) {
+    B_J  = _transformation->LookupTable[T][b];
+    slab = &(_slab[3 * (q-1+b - _j1) * X]);
+    for (a = 0; a < 3 * X; a++) {
+      _row[a] += B_J * slab[a];
+    }
+  }
+
+  // Basis functions along x
+  for (i = 0; i < _image->GetX(); i++) {
+    if (_S[i] < 0) {
+      dx[i] = 0;
+      dy[i] = 0;
+      dz[i] = 0;
+    } else {
+      row = &(_row[3 * (_l[i]-1 - _i1)]);
+      dx[i] = 0;
+      dy[i] = 0;
+      dz[i] = 0;
+      for (a = 0; a < 4; a++) {
+        B_I = _transformation->LookupTable[_S[i]][a];
+        dx[i] += B_I * row[0];
+        dy[i] += B_I * row[1];
+        dz[i] += B_I * row[2];
+        row += 3;
+      }
+    }
+  }
+}
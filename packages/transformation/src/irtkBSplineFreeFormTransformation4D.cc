@@ -431,6 +431,9 @@ double irtkBSplineFreeFormTransformation4D::Approximate(double *x1, double *y1,
   int a, b, c, d, i, j, k, l, I, J, K, L, S, T, U, V, index;
   double s, t, u, v, x, y, z, B_I, B_J, B_K, B_L, basis, basis2, error, phi, norm, time;
 
+  // Control points are modified
+  this->Modified();
+
   // Allocate memory
   double ****dx = NULL;
   double ****dy = NULL;
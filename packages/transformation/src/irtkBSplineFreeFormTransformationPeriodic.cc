@@ -533,6 +533,9 @@ double irtkBSplineFreeFormTransformationPeriodic::Approximate(double *x1, double
     double s, t, u, v, x, y, z, B_I, B_J, B_K, B_L, basis, basis2, error, phi, norm, time;
     int tp; // time point used for periodicity
 
+    // Control points are modified
+    this->Modified();
+
     // Allocate memory
     double ****dx = NULL;
     double ****dy = NULL;
@@ -110,6 +110,22 @@ void irtkFluidFreeFormTransformation::Transform(int n, double &x, double &y, dou
   }
 }
 
+void irtkFluidFreeFormTransformation::Transform(int n, double *x, double *y, double *z, double t)
+{
+  // Levels are composed rather than summed, so transform point by point
+  this->irtkTransformation::Transform(n, x, y, z, t);
+}
+
+void irtkFluidFreeFormTransformation::Displacement(int n, double *x, double *y, double *z, double t)
+{
+  this->irtkTransformation::Displacement(n, x, y, z, t);
+}
+
+void irtkFluidFreeFormTransformation::Displacement(irtkGenericImage<double> &image, double t)
+{
+  this->irtkTransformation::Displacement(image, t);
+}
+
 void irtkFluidFreeFormTransformation::GlobalTransform(double &, double &, double &, double)
 {
   cerr << "irtkFluidFreeFormTransformation::GlobalTransform: Does not make sense" << endl;
@@ -16,6 +16,11 @@ See COPYRIGHT for details
 
 #include <irtkTransformation.h>
 
+irtkFreeFormTransformation::irtkFreeFormTransformation()
+{
+  _NumberOfModifications = 0;
+}
+
 irtkFreeFormTransformation::~irtkFreeFormTransformation()
 {
 }
@@ -20,6 +20,9 @@ See COPYRIGHT for details
 
 void irtkFreeFormTransformation3D::UpdateMatrix()
 {
+  // Lattice has changed
+  this->Modified();
+
   // Update image to world coordinate system matrix
   _matL2W.Ident();
   _matL2W(0, 0) = _xaxis[0];
@@ -109,6 +109,52 @@ void irtkHomogeneousTransformation::Displacement(double &x, double &y, double &z
   z = c - z;
 }
 
+void irtkHomogeneousTransformation::Transform(int n, double *x, double *y, double *z, double)
+{
+  int i, j;
+  double a, b, c, m[3][4];
+
+  // Copy transformation matrix once for all points
+  for (j = 0; j < 3; j++) {
+    for (i = 0; i < 4; i++) {
+      m[j][i] = _matrix(j, i);
+    }
+  }
+
+  // Pre-multiply points with transformation matrix
+  for (i = 0; i < n; i++) {
+    a = m[0][0]*x[i]+m[0][1]*y[i]+m[0][2]*z[i]+m[0][3];
+    b = m[1][0]*x[i]+m[1][1]*y[i]+m[1][2]*z[i]+m[1][3];
+    c = m[2][0]*x[i]+m[2][1]*y[i]+m[2][2]*z[i]+m[2][3];
+    x[i] = a;
+    y[i] = b;
+    z[i] = c;
+  }
+}
+
+void irtkHomogeneousTransformation::Displacement(int n, double *x, double *y, double *z, double)
+{
+  int i, j;
+  double a, b, c, m[3][4];
+
+  // Copy transformation matrix once for all points
+  for (j = 0; j < 3; j++) {
+    for (i = 0; i < 4; i++) {
+      m[j][i] = _matrix(j, i);
+    }
+  }
+
+  // Pre-multiply points with transformation matrix
+  for (i = 0; i < n; i++) {
+    a = m[0][0]*x[i]+m[0][1]*y[i]+m[0][2]*z[i]+m[0][3];
+    b = m[1][0]*x[i]+m[1][1]*y[i]+m[1][2]*z[i]+m[1][3];
+    c = m[2][0]*x[i]+m[2][1]*y[i]+m[2][2]*z[i]+m[2][3];
+    x[i] = a - x[i];
+    y[i] = b - y[i];
+    z[i] = c - z[i];
+  }
+}
+
 double irtkHomogeneousTransformation::Inverse(double &x, double &y, double &z, double, double)
 {
   double a, b, c;
@@ -38,45 +38,31 @@ public:
   }
 
   void operator()(const blocked_range<int> &r) const {
-    int i, j, k;
-    double x, y, z, time;
+    int j, k, *index;
+    double time, *rx, *ry, *rz, *value;
 
     time = _imagetransformation->_output->ImageToTime(_toutput);
 
+    rx = new double[_imagetransformation->_output->GetX()];
+    ry = new double[_imagetransformation->_output->GetX()];
+    rz = new double[_imagetransformation->_output->GetX()];
+    value = new double[_imagetransformation->_output->GetX()];
+    index = new int[_imagetransformation->_output->GetX()];
+
     for (k = r.begin(); k != r.end(); k++) {
 
       for (j = 0; j < _imagetransformation->_output->GetY(); j++) {
-        for (i = 0; i < _imagetransformation->_output->GetX(); i++) {
-          if (_imagetransformation->_output->GetAsDouble(i, j, k, _toutput) > _imagetransformation->_TargetPaddingValue) {
-            x = i;
-            y = j;
-            z = k;
-            // Transform point into world coordinates
-            _imagetransformation->_output->ImageToWorld(x, y, z);
-            // Transform point
-            if (_imagetransformation->_Invert == false) {
-              _imagetransformation->_transformation->Transform(x, y, z, time);
-            } else {
-              _imagetransformation->_transformation->Inverse(x, y, z, time);
-            }
-            // Transform point into image coordinates
-            _imagetransformation->_input->WorldToImage(x, y, z);
-            // Check whether transformed point is in FOV of input
-            if ((x > -0.5) && (x < _imagetransformation->_input->GetX()-0.5) &&
-                (y > -0.5) && (y < _imagetransformation->_input->GetY()-0.5) &&
-                (z > -0.5) && (z < _imagetransformation->_input->GetZ()-0.5)) {
-            	_imagetransformation->_output->PutAsDouble(i, j, k, _toutput, _imagetransformation->_ScaleFactor * _imagetransformation->_interpolator->Evaluate(x, y, z, _tinput) + _imagetransformation->_Offset);
-            } else {
-              // Fill with padding value
-            	_imagetransformation->_output->PutAsDouble(i, j, k, _toutput, _imagetransformation->_SourcePaddingValue);
-            }
-          } else {
-            // Fill with padding value
-          	_imagetransformation->_output->PutAsDouble(i, j, k, _toutput, _imagetransformation->_SourcePaddingValue);
-          }
-        }
+        // Transform and interpolate all foreground voxels of the row at once
+        _imagetransformation->TransformRow(j, k, _toutput, time, rx, ry, rz);
+        _imagetransformation->InterpolateRow(j, k, _toutput, _tinput, false, rx, ry, rz, value, index);
       }
     }
+
+    delete []rx;
+    delete []ry;
+    delete []rz;
+    delete []value;
+    delete []index;
   }
 };
 
@@ -200,6 +186,74 @@ void irtkImageTransformation::SetOutput(irtkImage *image)
   }
 }
 
+void irtkImageTransformation::TransformRow(int j, int k, int l, double time, double *x, double *y, double *z)
+{
+  int i, n;
+
+  // Collect world coordinates of foreground voxels in row
+  n = 0;
+  for (i = 0; i < _output->GetX(); i++) {
+    if (_output->GetAsDouble(i, j, k, l) > _TargetPaddingValue) {
+      x[n] = i;
+      y[n] = j;
+      z[n] = k;
+      _output->ImageToWorld(x[n], y[n], z[n]);
+      n++;
+    }
+  }
+
+  // Transform or invert
+  if (_Invert == true) {
+    _transformation->InverseRow(n, x, y, z, time);
+  } else {
+    _transformation->Transform(n, x, y, z, time);
+  }
+}
+
+void irtkImageTransformation::InterpolateRow(int j, int k, int l, double t, bool twod, double *x, double *y, double *z, double *value, int *index)
+{
+  int i, m, n;
+  irtkInterpolateImageFunction *interpolator;
+
+  // Collect image coordinates of transformed voxels which are in FOV of input
+  m = 0;
+  n = 0;
+  for (i = 0; i < _output->GetX(); i++) {
+    if (_output->GetAsDouble(i, j, k, l) > _TargetPaddingValue) {
+      _input->WorldToImage(x[n], y[n], z[n]);
+      if ((x[n] > -0.5) && (x[n] < _input->GetX()-0.5) &&
+          (y[n] > -0.5) && (y[n] < _input->GetY()-0.5) &&
+          (((z[n] > -0.5) && (z[n] < _input->GetZ()-0.5)) || twod)) {
+        x[m] = x[n];
+        y[m] = y[n];
+        z[m] = (twod == true) ? k : z[n];
+        index[m] = i;
+        m++;
+      } else {
+        // Fill with padding value
+        _output->PutAsDouble(i, j, k, l, _SourcePaddingValue);
+      }
+      n++;
+    } else {
+      // Fill with padding value
+      _output->PutAsDouble(i, j, k, l, _SourcePaddingValue);
+    }
+  }
+
+  // Interpolate input at all of them at once
+  interpolator = dynamic_cast<irtkInterpolateImageFunction *>(_interpolator);
+  if (interpolator != NULL) {
+    interpolator->Evaluate(m, x, y, z, value, t);
+  } else {
+    for (n = 0; n < m; n++) {
+      value[n] = _interpolator->Evaluate(x[n], y[n], z[n], t);
+    }
+  }
+  for (n = 0; n < m; n++) {
+    _output->PutAsDouble(index[n], j, k, l, _ScaleFactor * value[n] + _Offset);
+  }
+}
+
 void irtkImageTransformation::Run()
 {
   int i, j, k, l;
@@ -207,7 +261,8 @@ void irtkImageTransformation::Run()
 #ifdef HAS_TBB
   double t;
 #else
-  double x, y, z, t;
+  int *index;
+  double t, *rx, *ry, *rz, *value;
 #endif
 
   // Check inputs and outputs
@@ -263,43 +318,26 @@ void irtkImageTransformation::Run()
 
       double time = this->_output->ImageToTime(l);
 
+      rx = new double[_output->GetX()];
+      ry = new double[_output->GetX()];
+      rz = new double[_output->GetX()];
+      value = new double[_output->GetX()];
+      index = new int[_output->GetX()];
+
       for (k = 0; k < _output->GetZ(); k++) {
         for (j = 0; j < _output->GetY(); j++) {
-          for (i = 0; i < _output->GetX(); i++) {
-            if (this->_output->GetAsDouble(i, j, k, l) > _TargetPaddingValue) {
-              x = i;
-              y = j;
-              z = k;
-              // Transform point into world coordinates
-              _output->ImageToWorld(x, y, z);
-              // Transform point
-              if (_Invert == false) {
-                _transformation->Transform(x, y, z, time);
-              } else {
-                _transformation->Inverse(x, y, z, time);
-              }
-              // Transform point into image coordinates
-              _input->WorldToImage(x, y, z);
-              // Check whether transformed point is in FOV of input
-              if ((x > -0.5) && (x < _input->GetX()-0.5) &&
-                  (y > -0.5) && (y < _input->GetY()-0.5) &&
-                  (((z > -0.5) && (z < _input->GetZ()-0.5)) || _2D)) {
-					  if(_2D)
-						  this->_output->PutAsDouble(i, j, k, l, _ScaleFactor * _interpolator->Evaluate(x, y, k, t) + _Offset);
-					  else
-						  this->_output->PutAsDouble(i, j, k, l, _ScaleFactor * _interpolator->Evaluate(x, y, z, t) + _Offset);
-              } else {
-                // Fill with padding value
-              	this->_output->PutAsDouble(i, j, k, l, _SourcePaddingValue);
-              }
-            } else {
-              // Fill with padding value
-            	this->_output->PutAsDouble(i, j, k, l, _SourcePaddingValue);
-            }
-          }
+          // Transform and interpolate all foreground voxels of the row at once
+          this->TransformRow(j, k, l, time, rx, ry, rz);
+          this->InterpolateRow(j, k, l, t, _2D, rx, ry, rz, value, index);
         }
       }
 
+      delete []rx;
+      delete []ry;
+      delete []rz;
+      delete []value;
+      delete []index;
+
 #endif
 
     } else {
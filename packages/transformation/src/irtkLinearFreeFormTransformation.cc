@@ -474,6 +474,9 @@ double irtkLinearFreeFormTransformation::Approximate(const double *x1, const dou
     int i, j, k, l, m, n, I, J, K, index;
     double s[2], t[2], u[2], x, y, z, B_I, B_J, B_K, basis;
 
+    // Control points are modified
+    this->Modified();
+
     // Allocate memory for control points
     irtkVector3D<double> ***data = NULL;
     data = Allocate(data, _x, _y, _z);
@@ -16,7 +16,12 @@ See COPYRIGHT for details
 
 #include <irtkTransformation.h>
 
-#include <newt2.h>
+#include <irtkBSplineFreeFormTransformation3DIterator.h>
+
+// Parameters of Newton iteration for the inverse transformation
+#define INVERSE_MAX_ITERATIONS 100
+#define INVERSE_TOLERANCE      1.0e-4
+#define INVERSE_MIN_STEP       1.0e-3
 
 irtkMultiLevelFreeFormTransformation::irtkMultiLevelFreeFormTransformation()
 {
@@ -28,6 +33,10 @@ irtkMultiLevelFreeFormTransformation::irtkMultiLevelFreeFormTransformation()
   }
 
   _NumberOfLevels = 0;
+
+  // No cached displacement
+  _displacementCache = NULL;
+  _displacementCacheNumberOfLevels = 0;
 }
 
 irtkMultiLevelFreeFormTransformation::irtkMultiLevelFreeFormTransformation(const irtkMultiLevelFreeFormTransformation &transformation) : irtkAffineTransformation(transformation)
@@ -59,6 +68,10 @@ irtkMultiLevelFreeFormTransformation::irtkMultiLevelFreeFormTransformation(const
   }
 
   _NumberOfLevels = transformation._NumberOfLevels;
+
+  // No cached displacement
+  _displacementCache = NULL;
+  _displacementCacheNumberOfLevels = 0;
 }
 
 irtkMultiLevelFreeFormTransformation::irtkMultiLevelFreeFormTransformation(const irtkRigidTransformation &transformation) : irtkAffineTransformation(transformation)
@@ -71,6 +84,10 @@ irtkMultiLevelFreeFormTransformation::irtkMultiLevelFreeFormTransformation(const
   }
 
   _NumberOfLevels = 0;
+
+  // No cached displacement
+  _displacementCache = NULL;
+  _displacementCacheNumberOfLevels = 0;
 }
 
 irtkMultiLevelFreeFormTransformation::irtkMultiLevelFreeFormTransformation(const irtkAffineTransformation &transformation) : irtkAffineTransformation(transformation)
@@ -83,6 +100,10 @@ irtkMultiLevelFreeFormTransformation::irtkMultiLevelFreeFormTransformation(const
   }
 
   _NumberOfLevels = 0;
+
+  // No cached displacement
+  _displacementCache = NULL;
+  _displacementCacheNumberOfLevels = 0;
 }
 
 irtkMultiLevelFreeFormTransformation::~irtkMultiLevelFreeFormTransformation()
@@ -95,6 +116,9 @@ irtkMultiLevelFreeFormTransformation::~irtkMultiLevelFreeFormTransformation()
   }
 
   _NumberOfLevels = 0;
+
+  // Delete cached displacement
+  this->InvalidateDisplacementCache();
 }
 
 void irtkMultiLevelFreeFormTransformation::Transform(double &x, double &y, double &z, double t)
@@ -108,20 +132,22 @@ void irtkMultiLevelFreeFormTransformation::Transform(double &x, double &y, doubl
   dz = 0;
 
   // Compute local transformation
-  for (i = 0; i < _NumberOfLevels; i++) {
+  if (this->CachedLocalDisplacement(x, y, z, t, dx, dy, dz) == false) {
+    for (i = 0; i < _NumberOfLevels; i++) {
 
-    // Reset
-    u = x;
-    v = y;
-    w = z;
+      // Reset
+      u = x;
+      v = y;
+      w = z;
 
-    // Displacement
-    _localTransformation[i]->LocalDisplacement(u, v, w, t);
+      // Displacement
+      _localTransformation[i]->LocalDisplacement(u, v, w, t);
 
-    // Add to displacement
-    dx += u;
-    dy += v;
-    dz += w;
+      // Add to displacement
+      dx += u;
+      dy += v;
+      dz += w;
+    }
   }
 
   // Compute global transformation
@@ -158,6 +184,217 @@ void irtkMultiLevelFreeFormTransformation::Displacement(double& x, double& y, do
   z = globalZ + localZ;
 }
 
+void irtkMultiLevelFreeFormTransformation::LocalDisplacement(int n, const double *x, const double *y, const double *z, double *dx, double *dy, double *dz, double t)
+{
+  int i, l;
+  double *u, *v, *w;
+
+  // Initialize displacements
+  for (i = 0; i < n; i++) {
+    dx[i] = 0;
+    dy[i] = 0;
+    dz[i] = 0;
+  }
+
+  // Look up cached displacements point by point
+  if (this->IsDisplacementCacheValid() == true) {
+    for (i = 0; i < n; i++) {
+      dx[i] = x[i];
+      dy[i] = y[i];
+      dz[i] = z[i];
+      this->LocalDisplacement(dx[i], dy[i], dz[i], t);
+    }
+    return;
+  }
+
+  u = new double[n];
+  v = new double[n];
+  w = new double[n];
+
+  // Compute local transformation level by level for all points
+  for (l = 0; l < _NumberOfLevels; l++) {
+    for (i = 0; i < n; i++) {
+      u[i] = x[i];
+      v[i] = y[i];
+      w[i] = z[i];
+    }
+    _localTransformation[l]->Displacement(n, u, v, w, t);
+    for (i = 0; i < n; i++) {
+      dx[i] += u[i];
+      dy[i] += v[i];
+      dz[i] += w[i];
+    }
+  }
+
+  delete []u;
+  delete []v;
+  delete []w;
+}
+
+void irtkMultiLevelFreeFormTransformation::Transform(int n, double *x, double *y, double *z, double t)
+{
+  int i;
+  double *dx, *dy, *dz;
+
+  dx = new double[n];
+  dy = new double[n];
+  dz = new double[n];
+
+  // Compute local transformation
+  this->LocalDisplacement(n, x, y, z, dx, dy, dz, t);
+
+  // Compute global transformation
+  this->irtkHomogeneousTransformation::Transform(n, x, y, z, t);
+
+  // Compute sum
+  for (i = 0; i < n; i++) {
+    x[i] += dx[i];
+    y[i] += dy[i];
+    z[i] += dz[i];
+  }
+
+  delete []dx;
+  delete []dy;
+  delete []dz;
+}
+
+void irtkMultiLevelFreeFormTransformation::Displacement(int n, double *x, double *y, double *z, double t)
+{
+  int i;
+  double *dx, *dy, *dz;
+
+  dx = new double[n];
+  dy = new double[n];
+  dz = new double[n];
+
+  // Compute local displacement
+  this->LocalDisplacement(n, x, y, z, dx, dy, dz, t);
+
+  // Compute global displacement
+  this->irtkHomogeneousTransformation::Displacement(n, x, y, z, t);
+
+  // Compute sum
+  for (i = 0; i < n; i++) {
+    x[i] += dx[i];
+    y[i] += dy[i];
+    z[i] += dz[i];
+  }
+
+  delete []dx;
+  delete []dy;
+  delete []dz;
+}
+
+void irtkMultiLevelFreeFormTransformation::Displacement(irtkGenericImage<double> &image, double t)
+{
+  int i, j, k, l, n;
+  double *x, *y, *z, *dx, *dy, *dz;
+  irtkBSplineFreeFormTransformation3DIterator **iterator;
+
+  // Copy cached displacements if they have been computed for the same lattice
+  if ((this->IsDisplacementCacheValid(image.GetImageAttributes()) == true) &&
+      ((_displacementCacheTimeDependent == false) || (t == _displacementCacheTime))) {
+    n  = image.GetX();
+    x  = new double[n];
+    y  = new double[n];
+    z  = new double[n];
+    for (k = 0; k < image.GetZ(); k++) {
+      for (j = 0; j < image.GetY(); j++) {
+        for (i = 0; i < n; i++) {
+          x[i] = i;
+          y[i] = j;
+          z[i] = k;
+          image.ImageToWorld(x[i], y[i], z[i]);
+        }
+        this->irtkHomogeneousTransformation::Displacement(n, x, y, z, t);
+        for (i = 0; i < n; i++) {
+          image(i, j, k, 0) = x[i] + _displacementCache->Get(i, j, k, 0);
+          image(i, j, k, 1) = y[i] + _displacementCache->Get(i, j, k, 1);
+          image(i, j, k, 2) = z[i] + _displacementCache->Get(i, j, k, 2);
+        }
+      }
+    }
+    delete []x;
+    delete []y;
+    delete []z;
+    return;
+  }
+
+  // Evaluate 3D B-spline FFD levels slice by slice and row by row
+  iterator = new irtkBSplineFreeFormTransformation3DIterator *[_NumberOfLevels];
+  for (l = 0; l < _NumberOfLevels; l++) {
+    if (strcmp(_localTransformation[l]->NameOfClass(), "irtkBSplineFreeFormTransformation3D") == 0) {
+      iterator[l] = new irtkBSplineFreeFormTransformation3DIterator(dynamic_cast<irtkBSplineFreeFormTransformation3D *>(_localTransformation[l]));
+      iterator[l]->Initialize(&image);
+    } else {
+      iterator[l] = NULL;
+    }
+  }
+
+  n  = image.GetX();
+  x  = new double[n];
+  y  = new double[n];
+  z  = new double[n];
+  dx = new double[n];
+  dy = new double[n];
+  dz = new double[n];
+
+  for (k = 0; k < image.GetZ(); k++) {
+    for (l = 0; l < _NumberOfLevels; l++) {
+      if (iterator[l] != NULL) iterator[l]->Slice(k);
+    }
+    for (j = 0; j < image.GetY(); j++) {
+
+      // Compute global displacement
+      for (i = 0; i < n; i++) {
+        x[i] = i;
+        y[i] = j;
+        z[i] = k;
+        image.ImageToWorld(x[i], y[i], z[i]);
+      }
+      this->irtkHomogeneousTransformation::Displacement(n, x, y, z, t);
+
+      // Compute local displacement
+      for (l = 0; l < _NumberOfLevels; l++) {
+        if (iterator[l] != NULL) {
+          iterator[l]->Row(j, dx, dy, dz);
+        } else {
+          for (i = 0; i < n; i++) {
+            dx[i] = i;
+            dy[i] = j;
+            dz[i] = k;
+            image.ImageToWorld(dx[i], dy[i], dz[i]);
+          }
+          _localTransformation[l]->Displacement(n, dx, dy, dz, t);
+        }
+        for (i = 0; i < n; i++) {
+          x[i] += dx[i];
+          y[i] += dy[i];
+          z[i] += dz[i];
+        }
+      }
+
+      // Store displacements
+      for (i = 0; i < n; i++) {
+        image(i, j, k, 0) = x[i];
+        image(i, j, k, 1) = y[i];
+        image(i, j, k, 2) = z[i];
+      }
+    }
+  }
+
+  for (l = 0; l < _NumberOfLevels; l++) {
+    delete iterator[l];
+  }
+  delete []iterator;
+  delete []x;
+  delete []y;
+  delete []z;
+  delete []dx;
+  delete []dy;
+  delete []dz;
+}
+
 void irtkMultiLevelFreeFormTransformation::Transform(int n, double &x, double &y, double &z, double t)
 {
   int i;
@@ -233,20 +470,22 @@ void irtkMultiLevelFreeFormTransformation::LocalTransform(double &x, double &y,
   dz = 0;
 
   // Compute local transformation
-  for (i = 0; i < _NumberOfLevels; i++) {
+  if (this->CachedLocalDisplacement(x, y, z, t, dx, dy, dz) == false) {
+    for (i = 0; i < _NumberOfLevels; i++) {
 
-    // Reset
-    u = x;
-    v = y;
-    w = z;
+      // Reset
+      u = x;
+      v = y;
+      w = z;
 
-    // Displacement
-    _localTransformation[i]->LocalDisplacement(u, v, w, t);
+      // Displacement
+      _localTransformation[i]->LocalDisplacement(u, v, w, t);
 
-    // Add to displacement
-    dx += u;
-    dy += v;
-    dz += w;
+      // Add to displacement
+      dx += u;
+      dy += v;
+      dz += w;
+    }
   }
 
   // Compute sum
@@ -344,20 +583,22 @@ void irtkMultiLevelFreeFormTransformation::LocalDisplacement(double &x, double &
   dz = 0;
 
   // Compute local transformation
-  for (i = 0; i < _NumberOfLevels; i++) {
+  if (this->CachedLocalDisplacement(x, y, z, t, dx, dy, dz) == false) {
+    for (i = 0; i < _NumberOfLevels; i++) {
 
-    // Reset
-    u = x;
-    v = y;
-    w = z;
+      // Reset
+      u = x;
+      v = y;
+      w = z;
 
-    // Displacement
-    _localTransformation[i]->LocalDisplacement(u, v, w, t);
+      // Displacement
+      _localTransformation[i]->LocalDisplacement(u, v, w, t);
 
-    // Add to displacement
-    dx += u;
-    dy += v;
-    dz += w;
+      // Add to displacement
+      dx += u;
+      dy += v;
+      dz += w;
+    }
   }
 
   // Compute sum
@@ -366,6 +607,145 @@ void irtkMultiLevelFreeFormTransformation::LocalDisplacement(double &x, double &
   z = dz;
 }
 
+class irtkMultiThreadedMultiLevelFreeFormTransformationCache
+{
+
+  /// Pointer to transformation
+  irtkMultiLevelFreeFormTransformation *_transformation;
+
+  /// Displacement cache
+  irtkGenericImage<double> *_cache;
+
+  /// Time
+  double _t;
+
+public:
+
+  irtkMultiThreadedMultiLevelFreeFormTransformationCache(irtkMultiLevelFreeFormTransformation *transformation, irtkGenericImage<double> *cache, double t) {
+    _transformation = transformation;
+    _cache = cache;
+    _t = t;
+  }
+
+  void operator()(const blocked_range<int> &r) const {
+    int i, j, k, n;
+    double x, y, z, *ptr;
+
+    n = _cache->GetX() * _cache->GetY() * _cache->GetZ();
+    for (k = r.begin(); k != r.end(); k++) {
+      ptr = _cache->GetPointerToVoxels(0, 0, k, 0);
+      for (j = 0; j < _cache->GetY(); j++) {
+        for (i = 0; i < _cache->GetX(); i++) {
+          x = i;
+          y = j;
+          z = k;
+          _cache->ImageToWorld(x, y, z);
+          _transformation->LocalDisplacement(x, y, z, _t);
+          ptr[0]   = x;
+          ptr[n]   = y;
+          ptr[2*n] = z;
+          ptr++;
+        }
+      }
+    }
+  }
+
+  void operator()() const {
+    task_scheduler_init init(tbb_no_threads);
+    parallel_for(blocked_range<int>(0, _cache->GetZ(), 1), *this);
+    init.terminate();
+  }
+};
+
+void irtkMultiLevelFreeFormTransformation::CacheDisplacement(const irtkImageAttributes &attr, double t)
+{
+  int i;
+  irtkImageAttributes cacheAttr;
+
+  // Nothing to do if the displacement has already been cached for this lattice
+  if ((this->IsDisplacementCacheValid(attr) == true) &&
+      ((_displacementCacheTimeDependent == false) || (t == _displacementCacheTime))) {
+    return;
+  }
+
+  // Evaluate levels without the old cache
+  this->InvalidateDisplacementCache();
+
+  // Three displacement components per lattice point
+  cacheAttr = attr;
+  cacheAttr._t = 3;
+  cacheAttr._dt = 1;
+  irtkGenericImage<double> *cache = new irtkGenericImage<double>(cacheAttr);
+
+  // Rasterize local displacement
+  irtkMultiThreadedMultiLevelFreeFormTransformationCache evaluate(this, cache, t);
+  evaluate();
+
+  // Remember the levels for which the cache is valid
+  _displacementCacheTimeDependent = false;
+  for (i = 0; i < _NumberOfLevels; i++) {
+    _displacementCacheLevel[i] = _localTransformation[i];
+    _displacementCacheModifications[i] = _localTransformation[i]->GetNumberOfModifications();
+    if (dynamic_cast<irtkFreeFormTransformation3D *>(_localTransformation[i]) == NULL) {
+      _displacementCacheTimeDependent = true;
+    }
+  }
+  _displacementCacheNumberOfLevels = _NumberOfLevels;
+  _displacementCacheTime = t;
+  _displacementCache = cache;
+}
+
+bool irtkMultiLevelFreeFormTransformation::CachedLocalDisplacement(double x, double y, double z, double t, double &dx, double &dy, double &dz)
+{
+  int a, b, c, i, j, k, i1, j1, k1, n, offset;
+  double wx, wy, wz, *ptr;
+
+  if (this->IsDisplacementCacheValid() == false) return false;
+  if ((_displacementCacheTimeDependent == true) && (t != _displacementCacheTime)) return false;
+
+  // Convert point into lattice coordinates
+  _displacementCache->WorldToImage(x, y, z);
+
+  // Check whether point is inside lattice
+  if ((x < 0) || (y < 0) || (z < 0) || (x > _displacementCache->GetX()-1) ||
+      (y > _displacementCache->GetY()-1) || (z > _displacementCache->GetZ()-1)) {
+    return false;
+  }
+
+  i = (int)floor(x);
+  j = (int)floor(y);
+  k = (int)floor(z);
+  x -= i;
+  y -= j;
+  z -= k;
+
+  // Neighbours are only needed if the point is not on a lattice plane
+  i1 = (x > 0) ? 1 : 0;
+  j1 = (y > 0) ? 1 : 0;
+  k1 = (z > 0) ? 1 : 0;
+
+  // Trilinear interpolation of displacement
+  n   = _displacementCache->GetX() * _displacementCache->GetY() * _displacementCache->GetZ();
+  ptr = _displacementCache->GetPointerToVoxels(i, j, k, 0);
+  dx  = 0;
+  dy  = 0;
+  dz  = 0;
+  for (c = 0; c <= k1; c++) {
+    wz = (c == 0) ? 1 - z : z;
+    for (b = 0; b <= j1; b++) {
+      wy = ((b == 0) ? 1 - y : y) * wz;
+      for (a = 0; a <= i1; a++) {
+        wx = ((a == 0) ? 1 - x : x) * wy;
+        offset = (c * _displacementCache->GetY() + b) * _displacementCache->GetX() + a;
+        dx += wx * ptr[offset];
+        dy += wx * ptr[offset + n];
+        dz += wx * ptr[offset + 2*n];
+      }
+    }
+  }
+  return true;
+}
+
 void irtkMultiLevelFreeFormTransformation::InterpolateGlobalDisplacement(irtkBSplineFreeFormTransformation3D *f)
 {
 	int i, j, k, count, noOfCPs;
@@ -453,6 +833,9 @@ void irtkMultiLevelFreeFormTransformation::MergeGlobalIntoLocalDisplacement()
   // Reset matrix previously used for global transform to identity
   this->Reset();
 
+  // Delete cached displacement
+  this->InvalidateDisplacementCache();
+
   // Clean up.
   delete ffdCopy;
 }
@@ -522,6 +905,9 @@ void irtkMultiLevelFreeFormTransformation::ApproximateAsNew(double *x1, double *
     int level, i;
     double error, rms_error, max_error;
 
+    // Delete cached displacement
+    this->InvalidateDisplacementCache();
+
     // Loop over all levels
     rms_error = 0;
     for (level = 0; level < _NumberOfLevels; level++) {
@@ -563,6 +949,9 @@ double irtkMultiLevelFreeFormTransformation::Approximate(double *x1, double *y1,
   int level, i;
   double error, rms_error, max_error;
 
+  // Delete cached displacement
+  this->InvalidateDisplacementCache();
+
   // Loop over all levels
   rms_error = 0;
   for (level = 0; level < _NumberOfLevels; level++) {
@@ -636,6 +1025,9 @@ istream& irtkMultiLevelFreeFormTransformation::Import(istream &from)
     if (_localTransformation[i] != NULL) delete _localTransformation[i];
   }
 
+  // Delete cached displacement
+  this->InvalidateDisplacementCache();
+
   // Check whether this is a transformation in MFFD file format
   if ((strcmp(buffer, "MFFD:") == 0) || (strcmp(buffer, "TC:") == 0)) {
 
@@ -729,6 +1121,9 @@ irtkCifstream& irtkMultiLevelFreeFormTransformation::Read(irtkCifstream& from)
     if (_localTransformation[i] != NULL) delete _localTransformation[i];
   }
 
+  // Delete cached displacement
+  this->InvalidateDisplacementCache();
+
   // Read magic no. for transformations
   from.ReadAsUInt(&magic_no, 1);
   if (magic_no != IRTKTRANSFORMATION_MAGIC) {
@@ -840,47 +1235,226 @@ bool irtkMultiLevelFreeFormTransformation::IsIdentity()
   return true;
 }
 
-double irtkMultiLevelFreeFormTransformation::Inverse(double &x, double &y, double &z, double t, double tolerance)
+double irtkMultiLevelFreeFormTransformation::NewtonInverse(double x, double y, double z, double &u, double &v, double &w, double t, double jacinv[3][3])
 {
-  int check;
-  double error;
+  int i, j, iter;
+  double fx, fy, fz, nx, ny, nz, du, dv, dw, error, nerror, det, lambda, inv[3][3];
+  irtkMatrix jac(3, 3);
+
+  // Residual of initial estimate
+  fx = u;
+  fy = v;
+  fz = w;
+  this->Transform(fx, fy, fz, t);
+  fx -= x;
+  fy -= y;
+  fz -= z;
+  error = fx*fx + fy*fy + fz*fz;
+
+  for (iter = 0; iter < INVERSE_MAX_ITERATIONS; iter++) {
+
+    // Check for convergence
+    if (fabs(fx) + fabs(fy) + fabs(fz) < INVERSE_TOLERANCE) break;
+
+    // Invert Jacobian at current estimate
+    this->Jacobian(jac, u, v, w, t);
+    inv[0][0] = jac(1, 1) * jac(2, 2) - jac(1, 2) * jac(2, 1);
+    inv[0][1] = jac(0, 2) * jac(2, 1) - jac(0, 1) * jac(2, 2);
+    inv[0][2] = jac(0, 1) * jac(1, 2) - jac(0, 2) * jac(1, 1);
+    inv[1][0] = jac(1, 2) * jac(2, 0) - jac(1, 0) * jac(2, 2);
+    inv[1][1] = jac(0, 0) * jac(2, 2) - jac(0, 2) * jac(2, 0);
+    inv[1][2] = jac(0, 2) * jac(1, 0) - jac(0, 0) * jac(1, 2);
+    inv[2][0] = jac(1, 0) * jac(2, 1) - jac(1, 1) * jac(2, 0);
+    inv[2][1] = jac(0, 1) * jac(2, 0) - jac(0, 0) * jac(2, 1);
+    inv[2][2] = jac(0, 0) * jac(1, 1) - jac(0, 1) * jac(1, 0);
+    det = jac(0, 0) * inv[0][0] + jac(0, 1) * inv[1][0] + jac(0, 2) * inv[2][0];
+    if (det == 0) break;
+    for (i = 0; i < 3; i++) {
+      for (j = 0; j < 3; j++) {
+        jacinv[i][j] = inv[i][j] / det;
+      }
+    }
 
-  // Initialize global variables
-  irtkTransformationPointer  = this;
-  x_invert = x;
-  y_invert = y;
-  z_invert = z;
+    // Newton step
+    du = -(jacinv[0][0] * fx + jacinv[0][1] * fy + jacinv[0][2] * fz);
+    dv = -(jacinv[1][0] * fx + jacinv[1][1] * fy + jacinv[1][2] * fz);
+    dw = -(jacinv[2][0] * fx + jacinv[2][1] * fy + jacinv[2][2] * fz);
+
+    // Backtrack until the residual decreases
+    for (lambda = 1; lambda > INVERSE_MIN_STEP; lambda /= 2) {
+      nx = u + lambda * du;
+      ny = v + lambda * dv;
+      nz = w + lambda * dw;
+      this->Transform(nx, ny, nz, t);
+      nx -= x;
+      ny -= y;
+      nz -= z;
+      nerror = nx*nx + ny*ny + nz*nz;
+      if (nerror < error) break;
+    }
+    if (lambda <= INVERSE_MIN_STEP) break;
+
+    // Accept step
+    u += lambda * du;
+    v += lambda * dv;
+    w += lambda * dw;
+    fx = nx;
+    fy = ny;
+    fz = nz;
+    error = nerror;
+  }
 
-  // Pointer to B-spline wrapper
-  void (*Newton_function)(int, float [], float []) = irtkTransformationEvaluate;
+  return sqrt(error);
+}
 
-  // Calculate initial estimate using affine transformation
-  this->irtkHomogeneousTransformation::Inverse(x, y, z, t);
+double irtkMultiLevelFreeFormTransformation::Inverse(double &x, double &y, double &z, double t, double tolerance)
+{
+  double u, v, w, error, jacinv[3][3];
 
-  // Inverse
-  float invert[3], f_invert[3];
-  invert[0] = x;
-  invert[1] = y;
-  invert[2] = z;
+  // Calculate initial estimate using affine transformation
+  u = x;
+  v = y;
+  w = z;
+  this->irtkHomogeneousTransformation::Inverse(u, v, w, t);
 
   // Numerically approximate the inverse transformation
-  newt2(invert-1, 3, &check, Newton_function);
-
-  // Calculate error
-  irtkTransformationEvaluate(3, invert-1, f_invert-1);
-  error = sqrt(f_invert[0]*f_invert[0]+f_invert[1]*f_invert[1]+f_invert[2]*f_invert[2]);
+  error = this->NewtonInverse(x, y, z, u, v, w, t, jacinv);
   if (error > tolerance) {
     cout << "irtkMultiLevelFreeFormTransformation::Inverse: RMS error = " << error << "\n";
   }
 
   // Set output to solution
-  x = invert[0];
-  y = invert[1];
-  z = invert[2];
+  x = u;
+  y = v;
+  z = w;
 
   return error;
 }
 
+double irtkMultiLevelFreeFormTransformation::InverseRow(int n, double *x, double *y, double *z, double t, double tolerance)
+{
+  int i, j, k;
+  bool warm;
+  double u, v, w, dx, dy, dz, px, py, pz, error, max_error, jacinv[3][3];
+
+  // Jacobian of inverse affine transformation (used until Newton updates it)
+  irtkMatrix matrix = this->GetMatrix();
+  matrix.Invert();
+  for (j = 0; j < 3; j++) {
+    for (k = 0; k < 3; k++) {
+      jacinv[j][k] = matrix(j, k);
+    }
+  }
+
+  u = v = w = 0;
+  px = py = pz = 0;
+  warm = false;
+  max_error = 0;
+  for (i = 0; i < n; i++) {
+    if (warm == true) {
+      // Initial estimate by linear extrapolation from the previous point
+      dx = x[i] - px;
+      dy = y[i] - py;
+      dz = z[i] - pz;
+      u += jacinv[0][0] * dx + jacinv[0][1] * dy + jacinv[0][2] * dz;
+      v += jacinv[1][0] * dx + jacinv[1][1] * dy + jacinv[1][2] * dz;
+      w += jacinv[2][0] * dx + jacinv[2][1] * dy + jacinv[2][2] * dz;
+    } else {
+      // Initial estimate using affine transformation
+      u = x[i];
+      v = y[i];
+      w = z[i];
+      this->irtkHomogeneousTransformation::Inverse(u, v, w, t);
+    }
+
+    // Numerically approximate the inverse transformation
+    error = this->NewtonInverse(x[i], y[i], z[i], u, v, w, t, jacinv);
+    if (error > max_error) max_error = error;
+
+    // Only converged solutions are used as initial estimates
+    warm = (error <= tolerance);
+
+    // Set output to solution
+    px = x[i];
+    py = y[i];
+    pz = z[i];
+    x[i] = u;
+    y[i] = v;
+    z[i] = w;
+  }
+
+  return max_error;
+}
+
+class irtkMultiThreadedMultiLevelFreeFormTransformationInverse
+{
+
+  /// Pointer to transformation
+  irtkMultiLevelFreeFormTransformation *_transformation;
+
+  /// Inverse displacement field
+  irtkGenericImage<double> *_image;
+
+  /// Time and tolerance
+  double _t, _tolerance;
+
+public:
+
+  irtkMultiThreadedMultiLevelFreeFormTransformationInverse(irtkMultiLevelFreeFormTransformation *transformation, irtkGenericImage<double> *image, double t, double tolerance) {
+    _transformation = transformation;
+    _image = image;
+    _t = t;
+    _tolerance = tolerance;
+  }
+
+  void operator()(const blocked_range<int> &r) const {
+    int i, j, k, l;
+    double u, v, w, *x, *y, *z;
+
+    x = new double[_image->GetX()];
+    y = new double[_image->GetX()];
+    z = new double[_image->GetX()];
+
+    // Loop over rows
+    for (l = r.begin(); l != r.end(); l++) {
+      j = l % _image->GetY();
+      k = l / _image->GetY();
+      for (i = 0; i < _image->GetX(); i++) {
+        x[i] = i;
+        y[i] = j;
+        z[i] = k;
+        _image->ImageToWorld(x[i], y[i], z[i]);
+      }
+      _transformation->InverseRow(_image->GetX(), x, y, z, _t, _tolerance);
+      for (i = 0; i < _image->GetX(); i++) {
+        u = i;
+        v = j;
+        w = k;
+        _image->ImageToWorld(u, v, w);
+        _image->Put(i, j, k, 0, x[i] - u);
+        _image->Put(i, j, k, 1, y[i] - v);
+        _image->Put(i, j, k, 2, z[i] - w);
+      }
+    }
+
+    delete []x;
+    delete []y;
+    delete []z;
+  }
+
+  void operator()() const {
+    task_scheduler_init init(tbb_no_threads);
+    parallel_for(blocked_range<int>(0, _image->GetY() * _image->GetZ(), 1), *this);
+    init.terminate();
+  }
+};
+
+void irtkMultiLevelFreeFormTransformation::InverseDisplacement(irtkGenericImage<double> &image, double t, double tolerance)
+{
+  irtkMultiThreadedMultiLevelFreeFormTransformationInverse inverse(this, &image, t, tolerance);
+  inverse();
+}
+
 void irtkMultiLevelFreeFormTransformation::Print()
 {
   int i;
@@ -192,29 +192,106 @@ irtkTransformation *irtkTransformation::New(char *name)
   }
 }
 
+void irtkTransformation::Transform(int n, double *x, double *y, double *z, double t)
+{
+  int i;
+
+  for (i = 0; i < n; i++) {
+    this->Transform(x[i], y[i], z[i], t);
+  }
+}
+
+void irtkTransformation::Displacement(int n, double *x, double *y, double *z, double t)
+{
+  int i;
+
+  for (i = 0; i < n; i++) {
+    this->Displacement(x[i], y[i], z[i], t);
+  }
+}
+
 void irtkTransformation::Displacement(irtkGenericImage<double> &image, double t)
 {
-	int i, j, k;
-	double x, y, z;
+  int i, j, k;
+  double *x, *y, *z;
 
-  // Calculate displacement field
+  x = new double[image.GetX()];
+  y = new double[image.GetX()];
+  z = new double[image.GetX()];
+
+  // Calculate displacement field row by row
   for (k = 0; k < image.GetZ(); k++) {
     for (j = 0; j < image.GetY(); j++) {
       for (i = 0; i < image.GetX(); i++) {
-        x = i;
-        y = j;
-        z = k;
+        x[i] = i;
+        y[i] = j;
+        z[i] = k;
         // Transform point into world coordinates
-        image.ImageToWorld(x, y, z);
-        // Calculate displacement
-        this->Displacement(x, y, z, t);
-        // Store displacement
-        image(i, j, k, 0) = x;
-        image(i, j, k, 1) = y;
-        image(i, j, k, 2) = z;
-       }
+        image.ImageToWorld(x[i], y[i], z[i]);
+      }
+      // Calculate displacements
+      this->Displacement(image.GetX(), x, y, z, t);
+      // Store displacements
+      for (i = 0; i < image.GetX(); i++) {
+        image(i, j, k, 0) = x[i];
+        image(i, j, k, 1) = y[i];
+        image(i, j, k, 2) = z[i];
+      }
+    }
+  }
+
+  delete []x;
+  delete []y;
+  delete []z;
+}
+
+double irtkTransformation::InverseRow(int n, double *x, double *y, double *z, double t, double tolerance)
+{
+  int i;
+  double error, max_error;
+
+  max_error = 0;
+  for (i = 0; i < n; i++) {
+    error = this->Inverse(x[i], y[i], z[i], t, tolerance);
+    if (error > max_error) max_error = error;
+  }
+  return max_error;
+}
+
+void irtkTransformation::InverseDisplacement(irtkGenericImage<double> &image, double t, double tolerance)
+{
+  int i, j, k;
+  double u, v, w, *x, *y, *z;
+
+  x = new double[image.GetX()];
+  y = new double[image.GetX()];
+  z = new double[image.GetX()];
+
+  // Calculate inverse displacement field row by row
+  for (k = 0; k < image.GetZ(); k++) {
+    for (j = 0; j < image.GetY(); j++) {
+      for (i = 0; i < image.GetX(); i++) {
+        x[i] = i;
+        y[i] = j;
+        z[i] = k;
+        image.ImageToWorld(x[i], y[i], z[i]);
+      }
+      this->InverseRow(image.GetX(), x, y, z, t, tolerance);
+      for (i = 0; i < image.GetX(); i++) {
+        u = i;
+        v = j;
+        w = k;
+        image.ImageToWorld(u, v, w);
+        image(i, j, k, 0) = x[i] - u;
+        image(i, j, k, 1) = y[i] - v;
+        image(i, j, k, 2) = z[i] - w;
+      }
     }
   }
+
+  delete []x;
+  delete []y;
+  delete []z;
 }
 
 void irtkTransformation::Read(char *name)
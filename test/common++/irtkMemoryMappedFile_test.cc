@@ -0,0 +1,96 @@
+#include "gtest/gtest.h"
+
+#include <unistd.h>
+
+#include <irtkImage.h>
+
+TEST(Common_irtkMemoryMappedFile, SliceRoundtrip) {
+   if (irtkMemoryMappedFile::IsSupported() == false) return;
+
+   irtkRealImage slices[2], mapped[2];
+   long offset[2], length, page;
+   int i, n;
+
+   irtkImageAttributes attr;
+   attr._x  = 67;
+   attr._y  = 45;
+   attr._z  = 1;
+   attr._dx = 1.25;
+   attr._dy = 1.25;
+   attr._dz = 3;
+
+   for (n = 0; n < 2; n++) {
+      slices[n].Initialize(attr);
+      for (int j = 0; j < attr._y; j++) {
+         for (i = 0; i < attr._x; i++) {
+            slices[n](i, j, 0) = 0.5 * i - 1.75 * j + 100 * n;
+         }
+      }
+   }
+
+   // Slices are mapped separately and thus start at multiples of the page size
+   page   = irtkMemoryMappedFile::GetPageSize();
+   length = slices[0].GetNumberOfVoxels() * sizeof(irtkRealPixel);
+   offset[0] = 0;
+   offset[1] = ((length + page - 1) / page) * page;
+
+   char name[] = "irtkMemoryMappedFile_test-XXXXXX";
+   int fd = mkstemp(name);
+   ASSERT_NE(-1, fd);
+   close(fd);
+   ASSERT_TRUE(irtkMemoryMappedFile::Create(name, offset[1] + length));
+
+   // Write slice data to scratch file
+   for (n = 0; n < 2; n++) {
+      irtkMemoryMappedFile *file = new irtkMemoryMappedFile;
+      ASSERT_TRUE(file->Open(name, MemoryMap_ReadWrite, offset[n], length));
+      memcpy(file->GetPointer(), slices[n].GetPointerToVoxels(), length);
+      mapped[n].Initialize(slices[n].GetImageAttributes(), file, 0);
+      ASSERT_TRUE(mapped[n].IsMemoryMapped());
+      mapped[n].ReleaseMappedMemory();
+   }
+
+   // Released pages are read back from the file
+   for (n = 0; n < 2; n++) {
+      for (i = 0; i < length / static_cast<long>(sizeof(irtkRealPixel)); i++) {
+         ASSERT_EQ(slices[n].GetPointerToVoxels()[i], mapped[n].GetPointerToVoxels()[i]);
+      }
+   }
+
+   // Changes are written back to the file
+   mapped[1](3, 4, 0) = -1;
+   mapped[1].ReleaseMappedMemory();
+   ASSERT_EQ(-1, mapped[1](3, 4, 0));
+
+   // Whole file maps with the size of the opened file
+   irtkMemoryMappedFile file;
+   ASSERT_TRUE(file.Open(name, MemoryMap_ReadOnly));
+   ASSERT_EQ(offset[1] + length, file.GetSize());
+   irtkRealPixel *data = reinterpret_cast<irtkRealPixel *>(file.GetPointer(offset[1]));
+   ASSERT_EQ(-1, data[4 * slices[1].GetX() + 3]);
+   ASSERT_EQ(slices[1](5, 6, 0), data[6 * slices[1].GetX() + 5]);
+   file.Close();
+
+   unlink(name);
+}
+
+TEST(Common_irtkMemoryMappedFile, RejectEmptyAndCompressedFiles) {
+   if (irtkMemoryMappedFile::IsSupported() == false) return;
+
+   irtkMemoryMappedFile file;
+   const char *name = "irtkMemoryMappedFile_test.gz";
+
+   ASSERT_TRUE(irtkMemoryMappedFile::Create(name, 0));
+   ASSERT_FALSE(file.Open(name, MemoryMap_ReadOnly));
+
+   FILE *fp = fopen(name, "wb");
+   ASSERT_TRUE(fp != NULL);
+   fputc(0x1f, fp);
+   fputc(0x8b, fp);
+   fputc(0x08, fp);
+   fclose(fp);
+   ASSERT_FALSE(file.Open(name, MemoryMap_ReadOnly));
+   ASSERT_TRUE(file.Open(name, MemoryMap_ReadOnly, 0, 3));
+
+   unlink(name);
+}
@@ -0,0 +1,49 @@
+#include "gtest/gtest.h"
+
+#include <irtkImage.h>
+#include <irtkCityBlockDistanceTransform.h>
+
+TEST(Contrib_irtkCityBlockDistanceTransform, SingletonDimension) {
+   irtkGreyImage planar(9, 7, 1), sagittal(1, 9, 7), coronal(9, 1, 7);
+   for (int j = 0; j < 7; j++) {
+      for (int i = 0; i < 9; i++) {
+         irtkGreyPixel value = ((i > 0) && (i < 8) && (j > 1) && (j < 7) && (i != 4 || j != 4)) ? 1 : 0;
+         planar(i, j, 0)   = value;
+         sagittal(0, i, j) = value;
+         coronal(i, 0, j)  = value;
+      }
+   }
+
+   irtkGreyImage expected, output;
+   irtkCityBlockDistanceTransform<irtkGreyPixel> transform;
+   transform.SetInput(&planar);
+   transform.SetOutput(&expected);
+   transform.Run();
+   ASSERT_EQ(2, expected(2, 4, 0));
+
+   // Images whose singleton dimension is not z give the same distances and
+   // are left unchanged
+   transform.SetInput(&sagittal);
+   transform.SetOutput(&output);
+   transform.Run();
+   ASSERT_EQ(1, sagittal.GetX());
+   ASSERT_EQ(1, output.GetX());
+   for (int j = 0; j < 7; j++) {
+      for (int i = 0; i < 9; i++) {
+         ASSERT_EQ(planar(i, j, 0), sagittal(0, i, j));
+         ASSERT_EQ(expected(i, j, 0), output(0, i, j));
+      }
+   }
+
+   transform.SetInput(&coronal);
+   transform.SetOutput(&output);
+   transform.Run();
+   ASSERT_EQ(1, coronal.GetY());
+   ASSERT_EQ(1, output.GetY());
+   for (int j = 0; j < 7; j++) {
+      for (int i = 0; i < 9; i++) {
+         ASSERT_EQ(planar(i, j, 0), coronal(i, 0, j));
+         ASSERT_EQ(expected(i, j, 0), output(i, 0, j));
+      }
+   }
+}
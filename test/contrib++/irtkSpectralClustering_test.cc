@@ -0,0 +1,121 @@
+#include "gtest/gtest.h"
+
+#include <stdio.h>
+#include <unistd.h>
+
+#include <irtkImage.h>
+#include <irtkSpectralClustering.h>
+
+// Gives the test access to the sparse graph and the similarities
+class irtkSpectralClusteringTest : public irtkSpectralClustering
+{
+
+public:
+
+   irtkSpectralClusteringTest(int nrSubjects, int nrFeatures) : irtkSpectralClustering(nrSubjects, nrFeatures) {
+   }
+
+   double Weight(int i, int j) {
+      for (int n = _graphStart[i]; n < _graphStart[i + 1]; n++) {
+         if (_graphIndex[n] == j) return _graphWeight[n];
+      }
+      return 0;
+   }
+};
+
+TEST(Contrib_irtkSpectralClustering, SparseMatchesDense) {
+   int n = 60;
+
+   // Points along an open curve, so that the graph is connected and its
+   // leading eigenvalues are distinct
+   double **data = new double*[n];
+   for (int i = 0; i < n; i++) {
+      data[i] = new double[2];
+      data[i][0] = i + 0.3 * sin(1.7 * i);
+      data[i][1] = 5 * sin(0.05 * i) + 0.2 * cos(2.3 * i);
+   }
+
+   // Sparse embedding uses a basis smaller than the number of subjects and
+   // is restarted
+   irtkSpectralClusteringTest sparse(n, 3);
+   sparse.InitializeNeighbourGraph(data, 2, 6);
+   ASSERT_TRUE(sparse.HasNeighbourGraph());
+   sparse.DoSpectralEmbedding();
+
+   // Dense embedding of the same graph, which adds the transposed matrix
+   irtkMatrix w(n, n);
+   for (int i = 0; i < n; i++) {
+      for (int j = 0; j < n; j++) {
+         w(i, j) = sparse.Weight(i, j) / 2;
+      }
+   }
+   irtkSpectralClusteringTest dense(n, 3);
+   dense.Initialize(w);
+   ASSERT_FALSE(dense.HasNeighbourGraph());
+   dense.DoSpectralEmbedding();
+
+   // Eigenvectors are equal up to their sign, the dense eigenvectors are
+   // computed in single precision
+   double **expected = dense.GetEmbedding();
+   double **features = sparse.GetEmbedding();
+   for (int j = 0; j < 3; j++) {
+      double sign = (expected[0][j] * features[0][j] < 0) ? -1 : 1;
+      for (int i = 0; i < n; i++) {
+         ASSERT_NEAR(expected[i][j], sign * features[i][j], 1e-4);
+      }
+   }
+
+   for (int i = 0; i < n; i++) {
+      delete []data[i];
+   }
+   delete []data;
+}
+
+TEST(Contrib_irtkSpectralClustering, StreamedSimilarities) {
+   int n = 9, k = 3;
+
+   // Symmetric similarities of the atlases, the last subject is the target
+   irtkMatrix w(n, n);
+   for (int i = 0; i < n; i++) {
+      for (int j = i + 1; j < n; j++) {
+         w(i, j) = w(j, i) = cos(1.3 * i + 0.7 * j) + cos(1.3 * j + 0.7 * i);
+      }
+   }
+   FILE *fp = fopen("irtkSpectralClustering_test-atlases.csv", "w");
+   ASSERT_TRUE(fp != NULL);
+   for (int i = 0; i < n - 1; i++) {
+      for (int j = 0; j < n - 1; j++) {
+         fprintf(fp, (j < n - 2) ? "%.17g," : "%.17g\n", w(i, j));
+      }
+   }
+   fclose(fp);
+   fp = fopen("irtkSpectralClustering_test-target.csv", "w");
+   ASSERT_TRUE(fp != NULL);
+   for (int i = 0; i < n - 1; i++) {
+      fprintf(fp, "%.17g\n", w(i, n - 1));
+   }
+   fclose(fp);
+
+   irtkSpectralClusteringTest graph(n, 2);
+   graph.InitializeNeighbourGraph("irtkSpectralClustering_test-atlases.csv", "irtkSpectralClustering_test-target.csv", k);
+   unlink("irtkSpectralClustering_test-atlases.csv");
+   unlink("irtkSpectralClustering_test-target.csv");
+
+   // Graph is the sum of the matrix of the k largest similarities of each
+   // subject and its transpose
+   irtkMatrix selected(n, n);
+   for (int i = 0; i < n; i++) {
+      for (int m = 0; m < k; m++) {
+         int next = -1;
+         for (int j = 0; j < n; j++) {
+            if (j != i && selected(i, j) == 0 && (next < 0 || w(i, j) > w(i, next))) next = j;
+         }
+         selected(i, next) = 1;
+      }
+   }
+   for (int i = 0; i < n; i++) {
+      for (int j = 0; j < n; j++) {
+         ASSERT_NEAR(selected(i, j) * w(i, j) + selected(j, i) * w(j, i), graph.Weight(i, j), 1e-12);
+      }
+   }
+}
@@ -0,0 +1,63 @@
+#include "gtest/gtest.h"
+
+#include <irtkImage.h>
+#include <irtkImageFunction.h>
+
+TEST(Image_irtkBSplineInterpolateImageFunction, Evaluate) {
+  irtkImageAttributes attr;
+  attr._x = 11;
+  attr._y = 9;
+  attr._z = 7;
+
+  // Image of double precision values which are not representable as float
+  irtkGenericImage<double> image(attr);
+  for (int k = 0; k < attr._z; k++) {
+    for (int j = 0; j < attr._y; j++) {
+      for (int i = 0; i < attr._x; i++) {
+        image(i, j, k) = 100 * sin(0.7 * i + 0.1) + 37 * cos(1.3 * j * k + 0.2 * i) + 0.01 * (i * j);
+      }
+    }
+  }
+
+  // Locations inside, near the boundary and outside of the image
+  const int N = 7;
+  double x[N] = { 5.3, 0.2, -0.4, 10.4, 7.77, 2.5, -2.6 };
+  double y[N] = { 4.1, 0.45, 8.3, -0.3, 2.25, 3.5, 10.9 };
+  double z[N] = { 3.7, 0.1, 6.2, 2.5, 5.9, 1.5, 8.4 };
+  double value[N];
+
+  // Values of the reference implementation for spline degrees 2 to 5
+  double reference[4][N] = {
+    { -97.820184829631984, 50.647911580056011, 51.039983225808911, 50.825654736193393, -59.63356604152861, 88.370466369831547, 107.99424603578719 },
+    { -98.536420697381672, 51.188742608097883, 50.878074730963824, 51.515196833087892, -58.331314124475313, 84.699143382962703, 108.63071444926584 },
+    { -98.760166576657753, 50.707803742997342, 50.839675569145882, 51.526659256796087, -56.966173510684165, 80.249940088859091, 108.68711238456255 },
+    { -98.751210048479095, 50.692352237328777, 50.775077973088457, 51.517944988691411, -56.163494473894168, 77.231258475758779, 108.62144339724047 }
+  };
+
+  for (int degree = 2; degree <= 5; degree++) {
+    irtkBSplineInterpolateImageFunction interpolator(degree);
+    irtkInterpolateImageFunction *function = &interpolator;
+    function->SetInput(&image);
+    function->Initialize();
+    for (int n = 0; n < N; n++) {
+      ASSERT_EQ(reference[degree-2][n], interpolator.Evaluate(x[n], y[n], z[n]));
+    }
+    ASSERT_EQ(reference[degree-2][0], interpolator.EvaluateInside(x[0], y[0], z[0]));
+
+    // Batch evaluation gives the same values
+    function->Evaluate(N, x, y, z, value);
+    for (int n = 0; n < N; n++) {
+      ASSERT_EQ(reference[degree-2][n], value[n]);
+    }
+  }
+
+  // Default batch implementation of the base class
+  irtkLinearInterpolateImageFunction interpolator;
+  irtkInterpolateImageFunction *function = &interpolator;
+  function->SetInput(&image);
+  function->Initialize();
+  function->Evaluate(N, x, y, z, value);
+  for (int n = 0; n < N; n++) {
+    ASSERT_EQ(function->Evaluate(x[n], y[n], z[n]), value[n]);
+  }
+}
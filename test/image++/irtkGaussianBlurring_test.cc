@@ -0,0 +1,190 @@
+#include "gtest/gtest.h"
+
+#include <irtkImage.h>
+#include <irtkConvolution.h>
+#include <irtkGaussianBlurring.h>
+#include <irtkGaussianBlurring4D.h>
+#include <irtkGaussianBlurringWithPadding.h>
+#include <irtkConvolutionWithGaussianDerivative.h>
+#include <irtkConvolutionWithGaussianDerivative2.h>
+#include <irtkScalarFunctionToImage.h>
+#include <irtkScalarGaussianDx.h>
+#include <irtkScalarGaussianDxDx.h>
+
+// Per-voxel convolution along x with a Gaussian (order 0) or its first or
+// second derivative, as computed before the filters operated on views
+static void ConvolveX(irtkGenericImage<irtkRealPixel> &image, int order, double sigma, irtkConvolution_1D<irtkRealPixel> &convolution)
+{
+   irtkScalarGaussian   gaussian(sigma, 1, 1, 0, 0, 0);
+   irtkScalarGaussianDx gaussianDx(sigma, 1, 1, 0, 0, 0);
+   irtkScalarGaussianDxDx gaussianDxDx(sigma, 1, 1, 0, 0, 0);
+
+   irtkGenericImage<irtkRealPixel> kernel(2*round(4*sigma)+1, 1, 1);
+   irtkScalarFunctionToImage<irtkRealPixel> source;
+   if (order == 0) source.SetInput(&gaussian);
+   if (order == 1) source.SetInput(&gaussianDx);
+   if (order == 2) source.SetInput(&gaussianDxDx);
+   source.SetOutput(&kernel);
+   source.Run();
+
+   convolution.SetInput (&image);
+   convolution.SetInput2(&kernel);
+   convolution.SetOutput(&image);
+   convolution.SetNormalization(order == 0);
+   convolution.irtkImageToImage<irtkRealPixel>::Run();
+}
+
+// Separable filter which flips the axes of the image to convolve along y, z
+// and (for 4D filters) t with the same per-voxel convolution along x
+static void FlipBasedFilter(irtkGenericImage<irtkRealPixel> &image, double sigma, int ox, int oy, int oz, int ot, irtkConvolution_1D<irtkRealPixel> &convolution)
+{
+   double xsize, ysize, zsize, tsize;
+   image.GetPixelSize(&xsize, &ysize, &zsize, &tsize);
+
+   ConvolveX(image, ox, sigma / xsize, convolution);
+   image.FlipXY(1);
+   ConvolveX(image, oy, sigma / ysize, convolution);
+   image.FlipXZ(1);
+   if (image.GetX() != 1) ConvolveX(image, oz, sigma / zsize, convolution);
+   if (ot >= 0) {
+      image.FlipXT(1);
+      ConvolveX(image, ot, sigma / tsize, convolution);
+      image.FlipXT(1);
+   }
+   image.FlipXZ(1);
+   image.FlipXY(1);
+}
+
+// Anisotropic image with structure at several scales and some padded voxels
+static void InitializeImage(irtkGenericImage<irtkRealPixel> &image, int z, int t)
+{
+   irtkImageAttributes attr;
+   attr._x  = 23;
+   attr._y  = 19;
+   attr._z  = z;
+   attr._t  = t;
+   attr._dx = 1.0;
+   attr._dy = 0.7;
+   attr._dz = 2.5;
+   attr._dt = 1.5;
+
+   image.Initialize(attr);
+   for (int l = 0; l < attr._t; l++) {
+      for (int k = 0; k < attr._z; k++) {
+         for (int j = 0; j < attr._y; j++) {
+            for (int i = 0; i < attr._x; i++) {
+               image(i, j, k, l) = 100 * sin(0.4 * i + 0.2 * j * l) + 50 * cos(0.9 * j - 0.3 * k) + 7 * ((i * j + k) % 5);
+               if ((i + 2 * j + 3 * k + l) % 11 == 0) image(i, j, k, l) = -1;
+            }
+         }
+      }
+   }
+}
+
+static void ExpectEqual(irtkGenericImage<irtkRealPixel> &expected, irtkGenericImage<irtkRealPixel> &image)
+{
+   ASSERT_TRUE(expected.GetImageAttributes() == image.GetImageAttributes());
+   for (int n = 0; n < expected.GetNumberOfVoxels(); n++) {
+      ASSERT_EQ(expected.GetPointerToVoxels()[n], image.GetPointerToVoxels()[n]);
+   }
+}
+
+TEST(Image_irtkGaussianBlurring, FlipBasedReference) {
+   int z[3] = { 9, 9, 1 };
+   int t[3] = { 1, 3, 2 };
+
+   // 3D, 4D and 2D images
+   for (int n = 0; n < 3; n++) {
+      irtkGenericImage<irtkRealPixel> image, output, expected;
+      InitializeImage(image, z[n], t[n]);
+
+      irtkGaussianBlurring<irtkRealPixel> blurring(1.8);
+      blurring.SetInput(&image);
+      blurring.SetOutput(&output);
+      blurring.Run();
+
+      expected = image;
+      irtkConvolution_1D<irtkRealPixel> convolution;
+      FlipBasedFilter(expected, 1.8, 0, 0, 0, -1, convolution);
+      ExpectEqual(expected, output);
+
+      irtkGaussianBlurringWithPadding<irtkRealPixel> padded(1.8, -1);
+      padded.SetInput(&image);
+      padded.SetOutput(&output);
+      padded.Run();
+
+      expected = image;
+      irtkConvolutionWithPadding_1D<irtkRealPixel> convolutionWithPadding(-1);
+      FlipBasedFilter(expected, 1.8, 0, 0, 0, -1, convolutionWithPadding);
+      ExpectEqual(expected, output);
+   }
+}
+
+TEST(Image_irtkGaussianBlurring4D, FlipBasedReference) {
+   irtkGenericImage<irtkRealPixel> image, output, expected;
+   InitializeImage(image, 9, 6);
+
+   irtkGaussianBlurring4D<irtkRealPixel> blurring(2.1);
+   blurring.SetInput(&image);
+   blurring.SetOutput(&output);
+   blurring.Run();
+
+   expected = image;
+   irtkConvolution_1D<irtkRealPixel> convolution;
+   FlipBasedFilter(expected, 2.1, 0, 0, 0, 0, convolution);
+   ExpectEqual(expected, output);
+}
+
+TEST(Image_irtkConvolutionWithGaussianDerivative, FlipBasedReference) {
+   int t[2] = { 1, 3 };
+
+   for (int n = 0; n < 2; n++) {
+      irtkGenericImage<irtkRealPixel> image, output, expected;
+      InitializeImage(image, 9, t[n]);
+
+      irtkConvolutionWithGaussianDerivative<irtkRealPixel> derivative(1.3);
+      derivative.SetInput(&image);
+      derivative.SetOutput(&output);
+
+      for (int axis = 0; axis < 3; axis++) {
+         if (axis == 0) derivative.Ix();
+         if (axis == 1) derivative.Iy();
+         if (axis == 2) derivative.Iz();
+
+         expected = image;
+         irtkConvolution_1D<irtkRealPixel> convolution;
+         FlipBasedFilter(expected, 1.3, axis == 0, axis == 1, axis == 2, -1, convolution);
+         ExpectEqual(expected, output);
+      }
+   }
+}
+
+TEST(Image_irtkConvolutionWithGaussianDerivative2, FlipBasedReference) {
+   int t[2] = { 1, 3 };
+
+   // Order of the derivative along x, y and z for Ixx, Iyy, Izz, Ixy, Ixz, Iyz
+   int order[6][3] = { { 2, 0, 0 }, { 0, 2, 0 }, { 0, 0, 2 }, { 1, 1, 0 }, { 1, 0, 1 }, { 0, 1, 1 } };
+
+   for (int n = 0; n < 2; n++) {
+      irtkGenericImage<irtkRealPixel> image, output, expected;
+      InitializeImage(image, 9, t[n]);
+
+      irtkConvolutionWithGaussianDerivative2<irtkRealPixel> derivative(1.3);
+      derivative.SetInput(&image);
+      derivative.SetOutput(&output);
+
+      for (int m = 0; m < 6; m++) {
+         if (m == 0) derivative.Ixx();
+         if (m == 1) derivative.Iyy();
+         if (m == 2) derivative.Izz();
+         if (m == 3) derivative.Ixy();
+         if (m == 4) derivative.Ixz();
+         if (m == 5) derivative.Iyz();
+
+         expected = image;
+         irtkConvolution_1D<irtkRealPixel> convolution;
+         FlipBasedFilter(expected, 1.3, order[m][0], order[m][1], order[m][2], -1, convolution);
+         ExpectEqual(expected, output);
+      }
+   }
+}
@@ -0,0 +1,169 @@
+#include "gtest/gtest.h"
+
+#include <irtkImage.h>
+#include <irtkConvolution.h>
+
+TEST(Image_irtkGenericImageView, Indexing) {
+   irtkGenericImage<float> image(7, 5, 4, 3);
+   for (int l = 0; l < 3; l++) {
+      for (int k = 0; k < 4; k++) {
+         for (int j = 0; j < 5; j++) {
+            for (int i = 0; i < 7; i++) {
+               image(i, j, k, l) = i + 10 * j + 100 * k + 1000 * l;
+            }
+         }
+      }
+   }
+
+   // View of whole image has the strides of the image buffer
+   irtkGenericImageView<float> view(image);
+   ASSERT_EQ(7 * 5 * 4 * 3, view.GetNumberOfVoxels());
+   ASSERT_EQ(1, view.GetXStride());
+   ASSERT_EQ(7, view.GetYStride());
+   ASSERT_EQ(35, view.GetZStride());
+   ASSERT_EQ(140, view.GetTStride());
+   ASSERT_TRUE(view.IsContiguous());
+   ASSERT_EQ(image.GetPointerToVoxels(3, 2, 1, 2), view.GetPointerToVoxels(3, 2, 1, 2));
+
+   // Regions and frames share the memory of the image
+   irtkGenericImageView<float> region = view.Region(2, 1, 1, 1, 6, 4, 3, 3);
+   ASSERT_EQ(4, region.GetX());
+   ASSERT_EQ(3, region.GetY());
+   ASSERT_EQ(2, region.GetZ());
+   ASSERT_EQ(2, region.GetT());
+   ASSERT_EQ(view.GetYStride(), region.GetYStride());
+   ASSERT_FALSE(region.IsContiguous());
+   ASSERT_EQ(image(5, 3, 2, 2), region(3, 2, 1, 1));
+   region(0, 0, 0, 0) = -1;
+   ASSERT_EQ(-1, image(2, 1, 1, 1));
+
+   irtkGenericImageView<float> frame = view.Frame(2);
+   ASSERT_EQ(1, frame.GetT());
+   ASSERT_TRUE(frame.IsContiguous());
+   ASSERT_EQ(image(6, 4, 3, 2), frame(6, 4, 3));
+
+   // Region of a region is relative to the first voxel of the region
+   ASSERT_EQ(image(4, 3, 2, 2), region.Region(1, 1, 1, 1, 3, 3, 2, 2)(1, 1, 0, 0));
+}
+
+TEST(Image_irtkGenericImageView, FlipAndReflect) {
+   irtkGenericImage<short> image(6, 4, 3, 2);
+   for (int l = 0; l < 2; l++) {
+      for (int k = 0; k < 3; k++) {
+         for (int j = 0; j < 4; j++) {
+            for (int i = 0; i < 6; i++) {
+               image(i, j, k, l) = i + 10 * j + 100 * k + 1000 * l;
+            }
+         }
+      }
+   }
+   irtkGenericImageView<short> view(image);
+
+   // Permuted and reflected views have the voxel order of the flipped image
+   for (int n = 0; n < 7; n++) {
+      irtkGenericImage<short> flipped(image);
+      irtkGenericImageView<short> permuted;
+      switch (n) {
+         case 0: flipped.FlipXY(0); permuted = view.FlipXY(); break;
+         case 1: flipped.FlipXZ(0); permuted = view.FlipXZ(); break;
+         case 2: flipped.FlipYZ(0); permuted = view.FlipYZ(); break;
+         case 3: flipped.FlipXT(0); permuted = view.FlipXT(); break;
+         case 4: flipped.ReflectX(); permuted = view.ReflectX(); break;
+         case 5: flipped.ReflectY(); permuted = view.ReflectY(); break;
+         case 6: flipped.ReflectZ(); permuted = view.ReflectZ(); break;
+      }
+      ASSERT_EQ(flipped.GetX(), permuted.GetX());
+      ASSERT_EQ(flipped.GetY(), permuted.GetY());
+      ASSERT_EQ(flipped.GetZ(), permuted.GetZ());
+      ASSERT_EQ(flipped.GetT(), permuted.GetT());
+      for (int l = 0; l < flipped.GetT(); l++) {
+         for (int k = 0; k < flipped.GetZ(); k++) {
+            for (int j = 0; j < flipped.GetY(); j++) {
+               for (int i = 0; i < flipped.GetX(); i++) {
+                  ASSERT_EQ(flipped(i, j, k, l), permuted(i, j, k, l));
+               }
+            }
+         }
+      }
+   }
+
+   // Copy into a contiguous view gives the flipped image
+   irtkGenericImage<short> flipped(image), copy(4, 6, 3, 2);
+   flipped.FlipXY(0);
+   irtkGenericImageView<short>(copy).Copy(view.FlipXY());
+   for (int n = 0; n < copy.GetNumberOfVoxels(); n++) {
+      ASSERT_EQ(flipped.GetPointerToVoxels()[n], copy.GetPointerToVoxels()[n]);
+   }
+}
+
+TEST(Image_irtkGenericImageView, Convolution) {
+   irtkGenericImage<double> image(9, 21, 5, 2), output(9, 21, 5, 2);
+   for (int l = 0; l < 2; l++) {
+      for (int k = 0; k < 5; k++) {
+         for (int j = 0; j < 21; j++) {
+            for (int i = 0; i < 9; i++) {
+               image(i, j, k, l) = sin(0.3 * i + 0.7 * j) + cos(1.1 * k + l);
+            }
+         }
+      }
+   }
+
+   irtkGenericImage<irtkRealPixel> kernel(5, 1, 1);
+   kernel(0, 0, 0) = 1;
+   kernel(1, 0, 0) = 3;
+   kernel(2, 0, 0) = 5;
+   kernel(3, 0, 0) = 2;
+   kernel(4, 0, 0) = 1;
+
+   // Convolution along y of a view of a region, other voxels are unchanged
+   irtkConvolution_1D<double> convolution(true);
+   convolution.SetInput2(&kernel);
+   irtkGenericImageView<double> input(image), result(output);
+   convolution.Run(input.Region(1, 0, 1, 8, 21, 4).FlipXY(), result.Region(1, 0, 1, 8, 21, 4).FlipXY());
+
+   for (int l = 0; l < 2; l++) {
+      for (int k = 0; k < 5; k++) {
+         for (int j = 0; j < 21; j++) {
+            for (int i = 0; i < 9; i++) {
+               if ((i < 1) || (i >= 8) || (k < 1) || (k >= 4)) {
+                  ASSERT_EQ(0, output(i, j, k, l));
+                  continue;
+               }
+               double value = 0, sum = 0;
+               for (int n = -2; n <= 2; n++) {
+                  if ((j + n >= 0) && (j + n < 21)) {
+                     value += kernel(n + 2, 0, 0) * image(i, j + n, k, l);
+                     sum   += kernel(n + 2, 0, 0);
+                  }
+               }
+               ASSERT_NEAR(value / sum, output(i, j, k, l), 1e-12);
+            }
+         }
+      }
+   }
+
+   // In-place convolution of the same view gives the same result
+   convolution.Run(input.Region(1, 0, 1, 8, 21, 4).FlipXY(), input.Region(1, 0, 1, 8, 21, 4).FlipXY());
+   for (int n = 0; n < image.GetNumberOfVoxels(); n++) {
+      if (output.GetPointerToVoxels()[n] != 0) {
+         ASSERT_EQ(output.GetPointerToVoxels()[n], image.GetPointerToVoxels()[n]);
+      }
+   }
+}
+
+TEST(Image_irtkGenericImageViewDeathTest, ConvolutionRejectsOverlap) {
+   irtkGenericImage<float> image(10, 8, 3);
+   irtkGenericImage<irtkRealPixel> kernel(3, 1, 1);
+   kernel = 1;
+
+   irtkConvolution_1D<float> convolution;
+   convolution.SetInput2(&kernel);
+   irtkGenericImageView<float> view(image);
+
+   // Shifted region and permuted view share voxels with the input
+   ASSERT_EXIT(convolution.Run(view.Region(0, 0, 0, 9, 8, 3), view.Region(1, 0, 0, 10, 8, 3)), ::testing::ExitedWithCode(1), "overlap");
+   ASSERT_EXIT(convolution.Run(view.Region(0, 0, 0, 8, 8, 3), view.Region(0, 0, 0, 8, 8, 3).FlipXY()), ::testing::ExitedWithCode(1), "overlap");
+
+   // Disjoint regions of the same image are accepted
+   convolution.Run(view.Region(0, 0, 0, 10, 8, 1), view.Region(0, 0, 2, 10, 8, 3));
+}
@@ -0,0 +1,102 @@
+#include "gtest/gtest.h"
+
+#include <stdio.h>
+#include <unistd.h>
+
+#include <irtkImage.h>
+
+TEST(Image_irtkGenericImage, MemoryMappedRead) {
+   if (irtkMemoryMappedFile::IsSupported() == false) return;
+
+   irtkImageAttributes attr;
+   attr._x = 23;
+   attr._y = 17;
+   attr._z = 5;
+
+   irtkRealImage image(attr);
+   for (int k = 0; k < attr._z; k++) {
+      for (int j = 0; j < attr._y; j++) {
+         for (int i = 0; i < attr._x; i++) {
+            image(i, j, k) = 0.25 * i - 3 * j + 100 * k;
+         }
+      }
+   }
+   image.Write("irtkGenericImage_test-mapped.nii");
+
+   irtkRealImage expected;
+   expected.Read("irtkGenericImage_test-mapped.nii");
+
+   // Mapped images have the same voxels as the image which is read
+   irtkMemoryMapMode mode[3] = { MemoryMap_ReadOnly, MemoryMap_CopyOnWrite, MemoryMap_ReadWrite };
+   for (int m = 0; m < 3; m++) {
+      irtkRealImage mapped;
+      mapped.Read("irtkGenericImage_test-mapped.nii", mode[m]);
+      ASSERT_TRUE(mapped.IsMemoryMapped());
+      ASSERT_TRUE(mapped.GetImageAttributes() == expected.GetImageAttributes());
+      for (int n = 0; n < expected.GetNumberOfVoxels(); n++) {
+         ASSERT_EQ(expected.GetPointerToVoxels()[n], mapped.GetPointerToVoxels()[n]);
+      }
+   }
+
+   // Initializing a read-write mapped image leaves the file unchanged
+   irtkRealImage mapped;
+   mapped.Read("irtkGenericImage_test-mapped.nii", MemoryMap_ReadWrite);
+   mapped.Initialize(attr);
+   ASSERT_FALSE(mapped.IsMemoryMapped());
+   ASSERT_EQ(0, mapped(3, 4, 2));
+   mapped.Read("irtkGenericImage_test-mapped.nii");
+   ASSERT_EQ(expected(3, 4, 2), mapped(3, 4, 2));
+
+   unlink("irtkGenericImage_test-mapped.nii");
+}
+
+TEST(Image_irtkGenericImage, MemoryMappedReadScaled) {
+   if (irtkMemoryMappedFile::IsSupported() == false) return;
+
+   irtkImageAttributes attr;
+   attr._x = 19;
+   attr._y = 11;
+   attr._z = 7;
+
+   irtkRealImage image(attr);
+   for (int k = 0; k < attr._z; k++) {
+      for (int j = 0; j < attr._y; j++) {
+         for (int i = 0; i < attr._x; i++) {
+            image(i, j, k) = 2 * i + 5 * j - 7 * k;
+         }
+      }
+   }
+   image.Write("irtkGenericImage_test-scaled.nii");
+
+   // Set slope and intercept in the NIfTI-1 header, which the writer leaves at zero
+   float scaling[2] = { 2.5, -4 };
+   FILE *fp = fopen("irtkGenericImage_test-scaled.nii", "r+b");
+   ASSERT_TRUE(fp != NULL);
+   ASSERT_EQ(0, fseek(fp, 112, SEEK_SET));
+   ASSERT_EQ(2u, fwrite(scaling, sizeof(float), 2, fp));
+   fclose(fp);
+
+   irtkRealImage expected;
+   expected.Read("irtkGenericImage_test-scaled.nii");
+   ASSERT_FALSE(expected.IsMemoryMapped());
+   ASSERT_EQ(2.5 * image(3, 4, 5) - 4, expected(3, 4, 5));
+
+   // Scaled intensities of mapped images are never written to the file
+   irtkMemoryMapMode mode[3] = { MemoryMap_ReadOnly, MemoryMap_CopyOnWrite, MemoryMap_ReadWrite };
+   for (int m = 0; m < 3; m++) {
+      irtkRealImage mapped;
+      mapped.Read("irtkGenericImage_test-scaled.nii", mode[m]);
+      for (int n = 0; n < expected.GetNumberOfVoxels(); n++) {
+         ASSERT_EQ(expected.GetPointerToVoxels()[n], mapped.GetPointerToVoxels()[n]);
+      }
+      mapped.Clear();
+
+      irtkRealImage reread;
+      reread.Read("irtkGenericImage_test-scaled.nii");
+      for (int n = 0; n < expected.GetNumberOfVoxels(); n++) {
+         ASSERT_EQ(expected.GetPointerToVoxels()[n], reread.GetPointerToVoxels()[n]);
+      }
+   }
+
+   unlink("irtkGenericImage_test-scaled.nii");
+}
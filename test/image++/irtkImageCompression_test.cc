@@ -0,0 +1,72 @@
+#include "gtest/gtest.h"
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <zlib.h>
+
+#include <irtkImage.h>
+
+TEST(Image_irtkImageCompression, Roundtrip) {
+   irtkImageAttributes attr;
+   attr._x  = 128;
+   attr._y  = 96;
+   attr._z  = 48;
+   attr._dx = 0.9;
+   attr._dy = 1.1;
+   attr._dz = 2.5;
+   attr._xorigin = 3.5;
+   attr._yorigin = -12.25;
+   attr._zorigin = 40;
+
+   // Image which is larger than one compressed block
+   irtkGreyImage image(attr);
+   for (int k = 0; k < attr._z; k++) {
+      for (int j = 0; j < attr._y; j++) {
+         for (int i = 0; i < attr._x; i++) {
+            image(i, j, k) = (i * 7 + j * 13 + k * 29) % 1000 - 200;
+         }
+      }
+   }
+   image.Write("irtkImageCompression_test.nii.gz");
+   image.Write("irtkImageCompression_test.hdr.gz");
+
+   // Files must be readable as plain gzip files, and header and image of the
+   // ANALYZE pair are both compressed
+   long size = image.GetNumberOfVoxels() * static_cast<long>(sizeof(irtkGreyPixel));
+   const char *name[3] = { "irtkImageCompression_test.nii.gz", "irtkImageCompression_test.hdr.gz", "irtkImageCompression_test.img.gz" };
+   long expected[3] = { 352 + size, 348, size };
+   for (int n = 0; n < 3; n++) {
+      struct stat buf;
+      ASSERT_EQ(0, stat(name[n], &buf));
+
+      char buffer[65536];
+      long length = 0;
+      int len;
+      gzFile file = gzopen(name[n], "rb");
+      ASSERT_TRUE(file != NULL);
+      while ((len = gzread(file, buffer, sizeof(buffer))) > 0) length += len;
+      gzclose(file);
+      ASSERT_EQ(expected[n], length);
+   }
+
+   // Images which are read back are unchanged
+   for (int n = 0; n < 2; n++) {
+      irtkGreyImage input;
+      input.Read(name[n]);
+
+      ASSERT_EQ(image.GetX(), input.GetX());
+      ASSERT_EQ(image.GetY(), input.GetY());
+      ASSERT_EQ(image.GetZ(), input.GetZ());
+      ASSERT_NEAR(image.GetXSize(), input.GetXSize(), 1e-5);
+      ASSERT_NEAR(image.GetYSize(), input.GetYSize(), 1e-5);
+      ASSERT_NEAR(image.GetZSize(), input.GetZSize(), 1e-5);
+      for (int i = 0; i < image.GetNumberOfVoxels(); i++) {
+         ASSERT_EQ(image.GetPointerToVoxels()[i], input.GetPointerToVoxels()[i]);
+      }
+   }
+
+   for (int n = 0; n < 3; n++) {
+      unlink(name[n]);
+   }
+}
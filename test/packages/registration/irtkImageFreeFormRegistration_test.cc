@@ -0,0 +1,207 @@
+#include "gtest/gtest.h"
+
+#include <irtkImage.h>
+#include <irtkRegistration.h>
+#include <irtkTransformation.h>
+
+// Gives the test access to the protected members of the registration
+class irtkImageFreeFormRegistrationTest : public irtkImageFreeFormRegistration
+{
+
+public:
+
+   void Setup() {
+      irtkSimilarityMeasure measure = _SimilarityMeasure;
+      this->GuessParameter();
+      _SimilarityMeasure = measure;
+      this->_NumberOfLevels = 1;
+      this->_AnalyticGradient = true;
+      this->Initialize();
+      this->Initialize(0);
+      this->Evaluate();
+   }
+
+   void Cleanup() {
+      this->Finalize(0);
+      this->Finalize();
+   }
+
+   double *Gradient(int threads, double *table) {
+      int i, n;
+
+      n = _affd->NumberOfDOFs();
+      float *dx = new float[n];
+      double *gradient = new double[n];
+
+      task_scheduler_init init(threads);
+      this->EvaluateGradient(1, dx);
+      init.terminate();
+
+      for (i = 0; i < n; i++) gradient[i] = dx[i];
+      delete []dx;
+
+      n = this->NumberOfBins();
+      for (i = 0; i < n; i++) table[i] = _metricDerivativeTable[i];
+      return gradient;
+   }
+
+   double SerialMetricDerivative(int i, int j) {
+      irtkHistogramSimilarityMetric *metric = dynamic_cast<irtkHistogramSimilarityMetric *>(_metric);
+      int ny = metric->NumberOfBinsY();
+      if (metric->GetPointerToHistogram()->irtkHistogram_2D<double>::operator()(i, j) > 0) {
+         return this->EvaluateMetricDerivative(metric, i, j, ny - 1);
+      }
+      return 0;
+   }
+
+   int NumberOfBins() {
+      irtkHistogramSimilarityMetric *metric = dynamic_cast<irtkHistogramSimilarityMetric *>(_metric);
+      return metric->NumberOfBinsX() * metric->NumberOfBinsY();
+   }
+
+   int NumberOfBinsY() {
+      return dynamic_cast<irtkHistogramSimilarityMetric *>(_metric)->NumberOfBinsY();
+   }
+
+   // Normalised gradient of the analytic projection or of central differences
+   double *Gradient(bool analytic, double step) {
+      int i, n;
+
+      n = _affd->NumberOfDOFs();
+      float *dx = new float[n];
+      double *gradient = new double[n];
+
+      _AnalyticGradient = analytic;
+      this->EvaluateGradient(step, dx);
+      _AnalyticGradient = true;
+
+      for (i = 0; i < n; i++) gradient[i] = dx[i];
+      delete []dx;
+      return gradient;
+   }
+
+   void SetSimilarityMeasure(irtkSimilarityMeasure measure) {
+      _SimilarityMeasure = measure;
+   }
+
+   int NumberOfDOFs() {
+      return _affd->NumberOfDOFs();
+   }
+};
+
+TEST(Packages_Registration_irtkImageFreeFormRegistration, AnalyticGradientThreadedVersusSerial) {
+   irtkImageAttributes attr;
+   attr._x = 32;
+   attr._y = 32;
+   attr._z = 16;
+
+   irtkGreyImage target(attr);
+   irtkGreyImage source(attr);
+   for (int k = 0; k < attr._z; k++) {
+      for (int j = 0; j < attr._y; j++) {
+         for (int i = 0; i < attr._x; i++) {
+            double r1 = (i-15)*(i-15) + (j-16)*(j-16) + 2*(k-8)*(k-8);
+            double r2 = (i-17)*(i-17) + (j-15)*(j-15) + 2*(k-7)*(k-7);
+            target(i, j, k) = static_cast<irtkGreyPixel>(1000 * exp(-r1 / 60.0) + 10 * (i % 3));
+            source(i, j, k) = static_cast<irtkGreyPixel>(800 * exp(-r2 / 50.0) + 10 * (j % 3));
+         }
+      }
+   }
+
+   irtkMultiLevelFreeFormTransformation transformation;
+
+   irtkImageFreeFormRegistrationTest registration;
+   registration.SetInput(&target, &source);
+   registration.SetOutput(&transformation);
+   registration.Setup();
+
+   int n = registration.NumberOfDOFs();
+   int m = registration.NumberOfBins();
+   double *table1 = new double[m];
+   double *table2 = new double[m];
+
+   double *gradient1 = registration.Gradient(1, table1);
+   double *gradient2 = registration.Gradient(4, table2);
+
+   // Table of metric derivatives is independent of the number of threads
+   int ny = registration.NumberOfBinsY();
+   for (int i = 0; i < m; i++) {
+      ASSERT_EQ(table1[i], table2[i]);
+      ASSERT_DOUBLE_EQ(registration.SerialMetricDerivative(i / ny, i % ny), table1[i]);
+   }
+
+   // Gradient only differs by the order in which the threads are joined
+   double norm = 0;
+   for (int i = 0; i < n; i++) {
+      norm += gradient1[i] * gradient1[i];
+   }
+   ASSERT_GT(norm, 0);
+   for (int i = 0; i < n; i++) {
+      ASSERT_NEAR(gradient1[i], gradient2[i], 1e-5 * sqrt(norm));
+   }
+
+   registration.Cleanup();
+
+   delete []table1;
+   delete []table2;
+   delete []gradient1;
+   delete []gradient2;
+}
+
+TEST(Packages_Registration_irtkImageFreeFormRegistration, AnalyticGradientVersusFiniteDifferences) {
+   irtkImageAttributes attr;
+   attr._x = 32;
+   attr._y = 32;
+   attr._z = 24;
+
+   // Smooth blobs which are displaced against each other and vanish towards the
+   // boundary, so that the padding excludes samples entering or leaving the source
+   irtkGreyImage target(attr);
+   irtkGreyImage source(attr);
+   for (int k = 0; k < attr._z; k++) {
+      for (int j = 0; j < attr._y; j++) {
+         for (int i = 0; i < attr._x; i++) {
+            double r1 = (i-15)*(i-15) + (j-16)*(j-16) + 2*(k-12)*(k-12);
+            double r2 = (i-17)*(i-17) + (j-15)*(j-15) + 2*(k-11)*(k-11);
+            target(i, j, k) = static_cast<irtkGreyPixel>(1000 * exp(-r1 / 20.0));
+            source(i, j, k) = static_cast<irtkGreyPixel>(1000 * exp(-r2 / 20.0));
+         }
+      }
+   }
+
+   // Histogram based similarities are piecewise constant in the DOFs, so their
+   // central differences only approach the analytic gradient for larger steps
+   irtkSimilarityMeasure measure[2] = { SSD, NMI };
+   double step[2] = { 0.5, 4 };
+   double cosine[2] = { 0.99, 0.85 };
+
+   for (int m = 0; m < 2; m++) {
+      irtkMultiLevelFreeFormTransformation transformation;
+
+      irtkImageFreeFormRegistrationTest registration;
+      registration.SetInput(&target, &source);
+      registration.SetOutput(&transformation);
+      registration.SetSimilarityMeasure(measure[m]);
+      registration.Setup();
+
+      int n = registration.NumberOfDOFs();
+      double *gradient1 = registration.Gradient(true, step[m]);
+      double *gradient2 = registration.Gradient(false, step[m]);
+
+      // Both gradients are normalised, so they must point in nearly the same direction
+      double dot = 0, norm1 = 0, norm2 = 0;
+      for (int i = 0; i < n; i++) {
+         dot   += gradient1[i] * gradient2[i];
+         norm1 += gradient1[i] * gradient1[i];
+         norm2 += gradient2[i] * gradient2[i];
+      }
+      ASSERT_NEAR(1, norm1, 1e-5);
+      ASSERT_NEAR(1, norm2, 1e-5);
+      ASSERT_GT(dot, cosine[m]);
+
+      registration.Cleanup();
+
+      delete []gradient1;
+      delete []gradient2;
+   }
+}
@@ -0,0 +1,127 @@
+#include "gtest/gtest.h"
+
+#include <irtkImage.h>
+#include <irtkRegistration2.h>
+#include <irtkTransformation.h>
+
+// Gives the test access to the protected members of the registration
+class irtkImageRegistration2Test : public irtkImageRigidRegistration2
+{
+
+public:
+
+   void Setup(irtkSamplingStrategy strategy, double ratio) {
+      this->GuessParameter();
+      this->_NumberOfLevels = 1;
+      this->_TargetPadding = 0;
+      this->_SamplingStrategy = strategy;
+      this->_SamplingRatio[0] = ratio;
+      this->Initialize();
+      this->_CurrentLevel = 0;
+      this->Initialize(0);
+   }
+
+   void Cleanup() {
+      this->Finalize(0);
+      this->Finalize();
+   }
+
+   // Draws a sample and returns the number of sampled and of domain voxels
+   void Sample(int &samples, int &domain, int &outside) {
+      this->irtkImageRigidRegistration2::Sample();
+
+      samples = domain = outside = 0;
+      irtkGreyPixel *ptr2domain = _domainMask.GetPointerToVoxels();
+      irtkGreyPixel *ptr2mask   = _distanceMask.GetPointerToVoxels();
+      for (int i = 0; i < _distanceMask.GetNumberOfVoxels(); i++) {
+         if (ptr2domain[i] == 0) domain++;
+         if (ptr2mask[i] == 0) {
+            samples++;
+            if (ptr2domain[i] != 0) outside++;
+         }
+      }
+   }
+
+   int CellSize() {
+      return _SamplingCellSize;
+   }
+};
+
+TEST(Packages_Registration2_irtkImageRegistration2, Sampling) {
+   irtkImageAttributes attr;
+   attr._x = 40;
+   attr._y = 37;
+   attr._z = 33;
+
+   // Ball of intensities inside a larger image, so that the domain of target voxels is not a box
+   irtkRealImage target(attr), source(attr);
+   for (int k = 0; k < attr._z; k++) {
+      for (int j = 0; j < attr._y; j++) {
+         for (int i = 0; i < attr._x; i++) {
+            double r = (i-19)*(i-19) + (j-18)*(j-18) + (k-16)*(k-16);
+            if (r < 15*15) {
+               target(i, j, k) = 100 + 50 * sin(0.3 * i) + 30 * cos(0.2 * j * k / 10.0);
+               source(i, j, k) = target(i, j, k);
+            }
+         }
+      }
+   }
+
+   // Integer cell sizes of stratified sampling only approximate the requested ratio
+   irtkSamplingStrategy strategy[4] = { SamplingRandom, SamplingStratified, SamplingStratified, SamplingGradient };
+   double ratio[4]     = { 0.1, 0.125, 0.05, 0.1 };
+   double tolerance[4] = { 0.05, 0.2, 0.3, 0.05 };
+
+   for (int m = 0; m < 4; m++) {
+      irtkRigidTransformation transformation;
+
+      irtkImageRegistration2Test registration;
+      registration.SetInput(&target, &source);
+      registration.SetOutput(&transformation);
+      registration.Setup(strategy[m], ratio[m]);
+
+      // Every sample lies inside the domain and the achieved ratio is close to the requested one
+      for (int n = 0; n < 3; n++) {
+         int samples, domain, outside;
+         registration.Sample(samples, domain, outside);
+         ASSERT_GT(domain, 0);
+         ASSERT_EQ(0, outside);
+         ASSERT_NEAR(ratio[m], double(samples) / domain, tolerance[m] * ratio[m]);
+      }
+
+      registration.Cleanup();
+   }
+
+   irtkRigidTransformation transformation;
+
+   irtkImageRegistration2Test registration;
+   registration.SetInput(&target, &source);
+   registration.SetOutput(&transformation);
+   registration.Setup(SamplingStratified, 0.125);
+
+   int samples, domain, outside;
+   registration.Sample(samples, domain, outside);
+
+   // Cells of stratified sampling which contain domain voxels give exactly one sample
+   int size = registration.CellSize();
+   ASSERT_EQ(2, size);
+   int cells = 0;
+   for (int k0 = 0; k0 < target.GetZ(); k0 += size) {
+      for (int j0 = 0; j0 < target.GetY(); j0 += size) {
+         for (int i0 = 0; i0 < target.GetX(); i0 += size) {
+            bool found = false;
+            for (int k = k0; k < min(k0 + size, target.GetZ()); k++) {
+               for (int j = j0; j < min(j0 + size, target.GetY()); j++) {
+                  for (int i = i0; i < min(i0 + size, target.GetX()); i++) {
+                     if (target(i, j, k) > 0) found = true;
+                  }
+               }
+            }
+            if (found) cells++;
+         }
+      }
+   }
+   ASSERT_EQ(cells, samples);
+
+   registration.Cleanup();
+}
@@ -0,0 +1,55 @@
+#include "gtest/gtest.h"
+
+#include <irtkImage.h>
+#include <irtkRegistration2.h>
+#include <irtkTransformation.h>
+
+TEST(Packages_Registration2_irtkOptimizer2, RecoversTranslation) {
+   irtkImageAttributes attr;
+   attr._x = 32;
+   attr._y = 30;
+   attr._z = 24;
+
+   // Smooth blob with some texture, the source is shifted by the translation
+   double translation[3] = { 1.5, -1.0, 0.8 };
+   irtkRealImage target(attr), source(attr);
+   for (int k = 0; k < attr._z; k++) {
+      for (int j = 0; j < attr._y; j++) {
+         for (int i = 0; i < attr._x; i++) {
+            for (int n = 0; n < 2; n++) {
+               double x = i, y = j, z = k;
+               target.ImageToWorld(x, y, z);
+               if (n == 1) {
+                  x -= translation[0];
+                  y -= translation[1];
+                  z -= translation[2];
+               }
+               double value = 100 * exp(-(x*x / 72 + y*y / 50 + z*z / 32)) + 20 * sin(0.3 * x + 0.1 * z) * cos(0.25 * y) + 40;
+               if (n == 0) target(i, j, k) = value;
+               if (n == 1) source(i, j, k) = value;
+            }
+         }
+      }
+   }
+
+   // Rigid registration recovers the translation with L-BFGS and with
+   // conjugate gradients
+   irtkOptimizationMethod method[2] = { LimitedMemoryBFGS, ConjugateGradientDescent };
+   for (int m = 0; m < 2; m++) {
+      irtkRigidTransformation transformation;
+
+      irtkImageRigidRegistration2 registration;
+      registration.SetInput(&target, &source);
+      registration.SetOutput(&transformation);
+      registration.GuessParameter();
+      registration.SetOptimizationMethod(method[m]);
+      registration.Run();
+
+      ASSERT_NEAR(translation[0], transformation.GetTranslationX(), 0.05);
+      ASSERT_NEAR(translation[1], transformation.GetTranslationY(), 0.05);
+      ASSERT_NEAR(translation[2], transformation.GetTranslationZ(), 0.05);
+      ASSERT_NEAR(0, transformation.GetRotationX(), 0.2);
+      ASSERT_NEAR(0, transformation.GetRotationY(), 0.2);
+      ASSERT_NEAR(0, transformation.GetRotationZ(), 0.2);
+   }
+}
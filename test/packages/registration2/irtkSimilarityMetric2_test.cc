@@ -0,0 +1,63 @@
+#include "gtest/gtest.h"
+
+#include <irtkImage.h>
+#include <irtkRegistration2.h>
+
+TEST(Packages_Registration2_irtkSimilarityMetric2, Gradient)
+{
+   irtkImageAttributes attr;
+   attr._x = 16;
+   attr._y = 16;
+   attr._z = 8;
+
+   irtkRealImage target(attr), source(attr);
+   for (int k = 0; k < attr._z; k++) {
+      for (int j = 0; j < attr._y; j++) {
+         for (int i = 0; i < attr._x; i++) {
+            target(i, j, k) = sin(0.4 * i) + cos(0.3 * j) + 0.2 * k;
+            source(i, j, k) = 0.5 * sin(0.4 * i + 0.3) + cos(0.25 * j) * cos(0.5 * k) + 0.01 * i * j;
+         }
+      }
+   }
+
+   // Unit source gradient in x, so that the similarity gradient in x is the
+   // derivative of the metric with respect to the source intensities
+   attr._t = 3;
+   irtkRealImage sourceGradient(attr), similarityGradient(attr);
+   for (int k = 0; k < attr._z; k++) {
+      for (int j = 0; j < attr._y; j++) {
+         for (int i = 0; i < attr._x; i++) {
+            sourceGradient(i, j, k, 0) = 1;
+         }
+      }
+   }
+
+   irtkCrossCorrelationSimilarityMetric2 cc;
+   irtkLocalCrossCorrelationSimilarityMetric2 gaussian(2, LocalWindowGaussian);
+   irtkLocalCrossCorrelationSimilarityMetric2 box(2, LocalWindowBox);
+   irtkSimilarityMetric2 *metric[3] = { &cc, &gaussian, &box };
+
+   // Analytic gradient agrees with central differences
+   const double h = 0.01;
+   int voxels[4][3] = {{3, 4, 2}, {8, 8, 4}, {12, 5, 6}, {1, 14, 0}};
+   for (int m = 0; m < 3; m++) {
+      metric[m]->SetInput(&target, &source, NULL, -1000);
+      metric[m]->EvaluateGradient(&sourceGradient, &similarityGradient);
+
+      for (int n = 0; n < 4; n++) {
+         int i = voxels[n][0], j = voxels[n][1], k = voxels[n][2];
+         double s = source(i, j, k);
+         source(i, j, k) = s + h;
+         double f1 = metric[m]->Evaluate();
+         source(i, j, k) = s - h;
+         double f2 = metric[m]->Evaluate();
+         source(i, j, k) = s;
+
+         double numerical = (f1 - f2) / (2 * h);
+         double analytic  = similarityGradient(i, j, k, 0);
+         ASSERT_NEAR(numerical, analytic, 0.001 * fabs(numerical) + 1e-8);
+         ASSERT_EQ(0, similarityGradient(i, j, k, 1));
+         ASSERT_EQ(0, similarityGradient(i, j, k, 2));
+      }
+   }
+}
@@ -0,0 +1,158 @@
+#include "gtest/gtest.h"
+
+#include <irtkImage.h>
+#include <irtkSegmentationFunction.h>
+
+// Gives the test access to the seed of the random search
+class irtkPatchMatchTest : public irtkPatchMatch
+{
+
+public:
+
+   irtkPatchMatchTest(irtkGreyImage *target, irtkGreyImage *source, unsigned int seed) : irtkPatchMatch(target, source, 2, 1) {
+      randomseed = seed;
+   }
+};
+
+class irtkMAPatchMatchTest : public irtkMAPatchMatch
+{
+
+public:
+
+   irtkMAPatchMatchTest(irtkGreyImage *target, irtkGreyImage **sources, int nimages, unsigned int seed) : irtkMAPatchMatch(target, sources, 2, nimages, 1) {
+      randomseed = seed;
+      initialguess();
+   }
+};
+
+// Texture without repeating patches, shifted by the given offset
+static void InitializeImage(irtkGreyImage &image, int dx, int dy, int dz)
+{
+   irtkImageAttributes attr;
+   attr._x = 24;
+   attr._y = 22;
+   attr._z = 12;
+
+   image.Initialize(attr);
+   for (int k = 0; k < image.GetZ(); k++) {
+      for (int j = 0; j < image.GetY(); j++) {
+         for (int i = 0; i < image.GetX(); i++) {
+            unsigned int h = patchmatchseed(17, 0, ((k - dz) * 64 + (j - dy)) * 64 + (i - dx));
+            image(i, j, k) = h % 1000;
+         }
+      }
+   }
+}
+
+// Patch of radius 2 around the voxel lies inside the image
+static bool Inside(irtkGreyImage &image, int i, int j, int k)
+{
+   return (i >= 2) && (i < image.GetX() - 2) && (j >= 2) && (j < image.GetY() - 2) && (k >= 2) && (k < image.GetZ() - 2);
+}
+
+TEST(Packages_Segmentation_irtkPatchMatch, ConvergesToOffset) {
+   irtkGreyImage target, source;
+   InitializeImage(target, 0, 0, 0);
+   InitializeImage(source, 3, -2, 1);
+
+   irtkPatchMatchTest patchmatch(&target, &source, 42);
+   patchmatch.run(10);
+
+   // The flow is relative to the voxel. Voxels whose patch lies inside both
+   // images find the patch at the offset, patches at the boundary are
+   // penalised for voxels outside the image and may match elsewhere
+   NearstNeighborFlow **nnfs = patchmatch.getNearstNeighbor();
+   int index = 0, count = 0, total = 0;
+   for (int k = 0; k < target.GetZ(); k++) {
+      for (int j = 0; j < target.GetY(); j++) {
+         for (int i = 0; i < target.GetX(); i++, index++) {
+            if (Inside(target, i, j, k) == false || Inside(source, i + 3, j - 2, k + 1) == false) continue;
+            total++;
+            if (nnfs[index][0].x == 3 && nnfs[index][0].y == -2 && nnfs[index][0].z == 1) count++;
+         }
+      }
+   }
+   ASSERT_GT(total, 0);
+   ASSERT_EQ(total, count);
+}
+
+TEST(Packages_Segmentation_irtkPatchMatch, DeterministicAcrossThreads) {
+   irtkGreyImage target, source;
+   InitializeImage(target, 0, 0, 0);
+   InitializeImage(source, 3, -2, 1);
+
+   int threads = tbb_no_threads;
+
+   // Same seed gives the same field for one and four threads
+   tbb_no_threads = 1;
+   irtkPatchMatchTest patchmatch1(&target, &source, 7);
+   patchmatch1.run(3);
+   tbb_no_threads = 4;
+   irtkPatchMatchTest patchmatch4(&target, &source, 7);
+   patchmatch4.run(3);
+   tbb_no_threads = threads;
+
+   NearstNeighborFlow **nnfs1 = patchmatch1.getNearstNeighbor();
+   NearstNeighborFlow **nnfs4 = patchmatch4.getNearstNeighbor();
+   for (int index = 0; index < target.GetNumberOfVoxels(); index++) {
+      ASSERT_EQ(nnfs1[index][0].x, nnfs4[index][0].x);
+      ASSERT_EQ(nnfs1[index][0].y, nnfs4[index][0].y);
+      ASSERT_EQ(nnfs1[index][0].z, nnfs4[index][0].z);
+      ASSERT_EQ(nnfs1[index][0].weight, nnfs4[index][0].weight);
+   }
+}
+
+TEST(Packages_Segmentation_irtkMAPatchMatch, ConvergesToOffset) {
+   irtkGreyImage target, source;
+   InitializeImage(target, 0, 0, 0);
+   InitializeImage(source, -2, 1, 1);
+   irtkGreyImage *sources[1] = { &source };
+
+   irtkMAPatchMatchTest patchmatch(&target, sources, 1, 42);
+   patchmatch.run(10);
+
+   // The field stores the matching voxel of the atlas
+   NearstNeighbor **nnfs = patchmatch.getNearstNeighbor();
+   int index = 0, count = 0, total = 0;
+   for (int k = 0; k < target.GetZ(); k++) {
+      for (int j = 0; j < target.GetY(); j++) {
+         for (int i = 0; i < target.GetX(); i++, index++) {
+            if (Inside(target, i, j, k) == false || Inside(source, i - 2, j + 1, k + 1) == false) continue;
+            total++;
+            if (nnfs[index][0].x == i - 2 && nnfs[index][0].y == j + 1 && nnfs[index][0].z == k + 1) count++;
+         }
+      }
+   }
+   ASSERT_GT(total, 0);
+   ASSERT_EQ(total, count);
+}
+
+TEST(Packages_Segmentation_irtkMAPatchMatch, DeterministicAcrossThreads) {
+   irtkGreyImage target, source1, source2;
+   InitializeImage(target, 0, 0, 0);
+   InitializeImage(source1, -2, 1, 1);
+   InitializeImage(source2, 1, 2, 0);
+   irtkGreyImage *sources[2] = { &source1, &source2 };
+
+   int threads = tbb_no_threads;
+
+   // Same seed gives the same field for one and four threads, including the
+   // atlases of the initial guess
+   tbb_no_threads = 1;
+   irtkMAPatchMatchTest patchmatch1(&target, sources, 2, 7);
+   patchmatch1.run(3);
+   tbb_no_threads = 4;
+   irtkMAPatchMatchTest patchmatch4(&target, sources, 2, 7);
+   patchmatch4.run(3);
+   tbb_no_threads = threads;
+
+   NearstNeighbor **nnfs1 = patchmatch1.getNearstNeighbor();
+   NearstNeighbor **nnfs4 = patchmatch4.getNearstNeighbor();
+   for (int index = 0; index < target.GetNumberOfVoxels(); index++) {
+      ASSERT_EQ(nnfs1[index][0].x, nnfs4[index][0].x);
+      ASSERT_EQ(nnfs1[index][0].y, nnfs4[index][0].y);
+      ASSERT_EQ(nnfs1[index][0].z, nnfs4[index][0].z);
+      ASSERT_EQ(nnfs1[index][0].n, nnfs4[index][0].n);
+      ASSERT_EQ(nnfs1[index][0].weight, nnfs4[index][0].weight);
+   }
+}
@@ -0,0 +1,146 @@
+#include "gtest/gtest.h"
+
+#include <irtkReconstruction.h>
+
+// Gives the test access to the protected members of the reconstruction
+class irtkReconstructionTest : public irtkReconstruction
+{
+
+public:
+
+   int NumberOfUpdatedSlices() {
+      int n = 0;
+      for (unsigned int i = 0; i < _volcoeffs_update.size(); i++) {
+         if (_volcoeffs_update[i]) n++;
+      }
+      return n;
+   }
+
+   bool IsUpdated(int inputIndex) {
+      return _volcoeffs_update[inputIndex];
+   }
+
+   const irtkSliceToVolumeMatrix &Coefficients(int inputIndex) {
+      return _volcoeffs[inputIndex];
+   }
+};
+
+TEST(Packages_Segmentation_irtkReconstruction, CoeffInitKeepsUnchangedSlices) {
+   irtkImageAttributes attr;
+   attr._x  = 24;
+   attr._y  = 20;
+   attr._z  = 6;
+   attr._dz = 2.5;
+
+   irtkRealImage stack(attr);
+   for (int k = 0; k < attr._z; k++) {
+      for (int j = 0; j < attr._y; j++) {
+         for (int i = 0; i < attr._x; i++) {
+            stack(i, j, k) = 100 + 50 * sin(0.3 * i) * cos(0.2 * j) + 10 * k;
+         }
+      }
+   }
+
+   vector<irtkRealImage> stacks(1, stack);
+   vector<irtkRigidTransformation> transformations(1);
+   vector<double> thickness(1, 2.5);
+
+   irtkReconstructionTest reconstruction;
+   reconstruction.CreateTemplate(stack, 1.0);
+   reconstruction.SetMask(NULL, 0);
+   reconstruction.CreateSlicesAndTransformations(stacks, transformations, thickness);
+
+   // Matrices of all slices are computed initially
+   reconstruction.CoeffInit();
+   ASSERT_EQ(attr._z, reconstruction.NumberOfUpdatedSlices());
+
+   vector<irtkSliceToVolumeMatrix> coefficients;
+   for (int k = 0; k < attr._z; k++) {
+      coefficients.push_back(reconstruction.Coefficients(k));
+   }
+
+   // Unchanged slices keep their matrices
+   reconstruction.CoeffInit();
+   ASSERT_EQ(0, reconstruction.NumberOfUpdatedSlices());
+
+   // Slice moved well below the PSF sampling step (0.5 mm at 1 mm resolution
+   // and default quality factor) keeps its matrix, a slice moved by half a
+   // voxel gets a new one
+   vector<irtkRigidTransformation> slices;
+   reconstruction.GetTransformations(slices);
+   slices[1].PutTranslationX(0.01);
+   slices[3].PutTranslationY(0.5);
+   reconstruction.SetTransformations(slices);
+   reconstruction.CoeffInit();
+   ASSERT_EQ(1, reconstruction.NumberOfUpdatedSlices());
+   ASSERT_TRUE(reconstruction.IsUpdated(3));
+
+   // Kept matrices are unchanged
+   for (int k = 0; k < attr._z; k++) {
+      if (k == 3) continue;
+      const irtkSliceToVolumeMatrix &matrix = reconstruction.Coefficients(k);
+      ASSERT_EQ(coefficients[k].GetNumberOfEntries(), matrix.GetNumberOfEntries());
+      for (int j = 0; j < attr._y; j++) {
+         for (int i = 0; i < attr._x; i++) {
+            ASSERT_EQ(coefficients[k].GetSize(i, j), matrix.GetSize(i, j));
+            for (int n = 0; n < matrix.GetSize(i, j); n++) {
+               ASSERT_EQ(coefficients[k].GetIndices(i, j)[n], matrix.GetIndices(i, j)[n]);
+               ASSERT_EQ(coefficients[k].GetValues(i, j)[n], matrix.GetValues(i, j)[n]);
+            }
+         }
+      }
+   }
+}
+
+TEST(Packages_Segmentation_irtkReconstruction, ScratchFolder) {
+   if (irtkMemoryMappedFile::IsSupported() == false) return;
+
+   irtkImageAttributes attr;
+   attr._x  = 24;
+   attr._y  = 20;
+   attr._z  = 6;
+   attr._dz = 2.5;
+
+   irtkRealImage stack(attr);
+   for (int k = 0; k < attr._z; k++) {
+      for (int j = 0; j < attr._y; j++) {
+         for (int i = 0; i < attr._x; i++) {
+            stack(i, j, k) = 100 + 50 * sin(0.3 * i) * cos(0.2 * j) + 10 * k;
+         }
+      }
+   }
+
+   vector<irtkRealImage> stacks(1, stack);
+   vector<irtkRigidTransformation> transformations(1);
+   vector<double> thickness(1, 2.5);
+
+   // Slice data stored in a scratch file with a budget of less than one slice
+   // gives the same results as slice data kept in memory
+   irtkRealImage reconstructed[2], simulated[2];
+   for (int n = 0; n < 2; n++) {
+      irtkReconstruction reconstruction;
+      reconstruction.CreateTemplate(stack, 1.0);
+      reconstruction.SetMask(NULL, 0);
+      reconstruction.CreateSlicesAndTransformations(stacks, transformations, thickness);
+      reconstruction.InitializeEM();
+      if (n == 1) reconstruction.SetScratchFolder(".", 0.001);
+      reconstruction.InitializeEMValues();
+      reconstruction.CoeffInit();
+      reconstruction.GaussianReconstruction();
+      reconstruction.SimulateSlices();
+      reconstruction.InitializeRobustStatistics();
+      reconstruction.ScaleVolume();
+      reconstructed[n] = reconstruction.GetReconstructed();
+
+      vector<irtkRealImage> simulatedStacks(1, stack);
+      reconstruction.SimulateStacks(simulatedStacks);
+      simulated[n] = simulatedStacks[0];
+   }
+
+   for (int n = 0; n < reconstructed[0].GetNumberOfVoxels(); n++) {
+      ASSERT_EQ(reconstructed[0].GetPointerToVoxels()[n], reconstructed[1].GetPointerToVoxels()[n]);
+   }
+   for (int n = 0; n < simulated[0].GetNumberOfVoxels(); n++) {
+      ASSERT_EQ(simulated[0].GetPointerToVoxels()[n], simulated[1].GetPointerToVoxels()[n]);
+   }
+}
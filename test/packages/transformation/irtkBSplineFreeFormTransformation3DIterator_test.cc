@@ -0,0 +1,72 @@
+#include "gtest/gtest.h"
+
+#include <irtkImage.h>
+#include <irtkTransformation.h>
+#include <irtkBSplineFreeFormTransformation3DIterator.h>
+
+TEST(Packages_Transformation_irtkBSplineFreeFormTransformation3DIterator, Displacement)
+{
+   double xaxis[3] = { 1, 0, 0 };
+   double yaxis[3] = { 0, 1, 0 };
+   double zaxis[3] = { 0, 0, 1 };
+
+   // Lattice of 3 mm spacing with smoothly varying control points
+   irtkBSplineFreeFormTransformation3D transformation(-15, -10, -8, 15, 10, 8, 3, 3, 3, xaxis, yaxis, zaxis);
+   for (int k = 0; k < transformation.GetZ(); k++) {
+      for (int j = 0; j < transformation.GetY(); j++) {
+         for (int i = 0; i < transformation.GetX(); i++) {
+            transformation.Put(i, j, k, 2 * sin(0.7 * i + j), 2 * cos(0.3 * j * k), 2 * sin(0.5 * k - i));
+         }
+      }
+   }
+
+   // Images which extend beyond the lattice, rotated around z. The rotation
+   // of 1e-12 is below the tolerance across the image, but may move lattice
+   // coordinates across the rounding to the next entry of the lookup table.
+   // The rotation of 2e-6 is below the tolerance per voxel but not across
+   // the image.
+   double angle[4]     = { 0, 1e-12, M_PI / 6, 2e-6 };
+   bool   aligned[4]   = { true, true, false, false };
+   double tolerance[4] = { 1e-9, 1e-2, 1e-9, 1e-9 };
+
+   for (int n = 0; n < 4; n++) {
+      irtkImageAttributes attr;
+      attr._x  = 35;
+      attr._y  = 27;
+      attr._z  = 20;
+      attr._dx = 1.1;
+      attr._dy = 0.9;
+      attr._dz = 1.0;
+      attr._xorigin = 0.3;
+      attr._yorigin = -0.2;
+      attr._zorigin = 0.5;
+      attr._xaxis[0] = cos(angle[n]);
+      attr._xaxis[1] = sin(angle[n]);
+      attr._xaxis[2] = 0;
+      attr._yaxis[0] = -sin(angle[n]);
+      attr._yaxis[1] = cos(angle[n]);
+      attr._yaxis[2] = 0;
+      irtkGreyImage image(attr);
+
+      irtkBSplineFreeFormTransformation3DIterator iterator(&transformation);
+      iterator.Initialize(&image);
+      ASSERT_EQ(aligned[n], iterator.IsAligned());
+
+      // Displacements of the iterator agree with those of the transformation at every voxel
+      vector<double> dx(image.GetX()), dy(image.GetX()), dz(image.GetX());
+      for (int k = 0; k < image.GetZ(); k++) {
+         iterator.Slice(k);
+         for (int j = 0; j < image.GetY(); j++) {
+            iterator.Row(j, &dx[0], &dy[0], &dz[0]);
+            for (int i = 0; i < image.GetX(); i++) {
+               double x = i, y = j, z = k;
+               image.ImageToWorld(x, y, z);
+               transformation.Displacement(x, y, z);
+               ASSERT_NEAR(x, dx[i], tolerance[n]);
+               ASSERT_NEAR(y, dy[i], tolerance[n]);
+               ASSERT_NEAR(z, dz[i], tolerance[n]);
+            }
+         }
+      }
+   }
+}
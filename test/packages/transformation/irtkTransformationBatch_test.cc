@@ -0,0 +1,103 @@
+#include "gtest/gtest.h"
+
+#include <irtkTransformation.h>
+
+const double EPSILON = 1e-9;
+
+TEST(Packages_Transformation_irtkTransformationBatch, Transform)
+{
+   double xaxis[3] = { 1, 0, 0 };
+   double yaxis[3] = { 0, 1, 0 };
+   double zaxis[3] = { 0, 0, 1 };
+
+   irtkRigidTransformation rigid;
+   rigid.PutTranslationX(2.5);
+   rigid.PutTranslationY(-1.25);
+   rigid.PutTranslationZ(4);
+   rigid.PutRotationX(10);
+   rigid.PutRotationY(-5);
+   rigid.PutRotationZ(30);
+
+   irtkAffineTransformation affine;
+   affine.PutTranslationX(-3);
+   affine.PutRotationZ(12);
+   affine.PutScaleX(110);
+   affine.PutScaleY(95);
+   affine.PutScaleZ(102);
+   affine.PutShearXY(5);
+   affine.PutShearXZ(-3);
+
+   // Lattices of 3 mm and 6 mm spacing with smoothly varying control points,
+   // the levels are deleted by the multi-level transformation
+   irtkBSplineFreeFormTransformation3D ffd(-15, -10, -8, 15, 10, 8, 3, 3, 3, xaxis, yaxis, zaxis);
+   irtkBSplineFreeFormTransformation3D *level1 = new irtkBSplineFreeFormTransformation3D(-15, -10, -8, 15, 10, 8, 6, 6, 6, xaxis, yaxis, zaxis);
+   irtkBSplineFreeFormTransformation3D *level2 = new irtkBSplineFreeFormTransformation3D(-15, -10, -8, 15, 10, 8, 3, 3, 3, xaxis, yaxis, zaxis);
+   for (int k = 0; k < ffd.GetZ(); k++) {
+      for (int j = 0; j < ffd.GetY(); j++) {
+         for (int i = 0; i < ffd.GetX(); i++) {
+            ffd.Put(i, j, k, 2 * sin(0.7 * i + j), 2 * cos(0.3 * j * k), 2 * sin(0.5 * k - i));
+            level2->Put(i, j, k, sin(0.7 * i + j), cos(0.3 * j * k), sin(0.5 * k - i));
+         }
+      }
+   }
+   for (int k = 0; k < level1->GetZ(); k++) {
+      for (int j = 0; j < level1->GetY(); j++) {
+         for (int i = 0; i < level1->GetX(); i++) {
+            level1->Put(i, j, k, 3 * sin(0.7 * i + j), 3 * cos(0.3 * j * k), 3 * sin(0.5 * k - i));
+         }
+      }
+   }
+
+   irtkAffineTransformation global;
+   global.PutTranslationY(1.5);
+   global.PutRotationX(8);
+   global.PutScaleZ(105);
+   irtkMultiLevelFreeFormTransformation mffd(global);
+   mffd.PushLocalTransformation(level1);
+   mffd.PushLocalTransformation(level2);
+
+   // Points along a row, which share the support of the B-spline, followed by
+   // scattered points some of which are outside the lattice
+   const int N = 40;
+   double px[N], py[N], pz[N];
+   for (int i = 0; i < N; i++) {
+      if (i < N / 2) {
+         px[i] = -12 + 1.3 * i;
+         py[i] = 3.25;
+         pz[i] = -1.5;
+      } else {
+         px[i] = 30 * sin(1.7 * i);
+         py[i] = 25 * cos(0.9 * i);
+         pz[i] = 20 * sin(0.4 * i + 1);
+      }
+   }
+
+   irtkTransformation *transformation[4] = { &rigid, &affine, &ffd, &mffd };
+   for (int n = 0; n < 4; n++) {
+      double x[N], y[N], z[N], dx[N], dy[N], dz[N];
+      for (int i = 0; i < N; i++) {
+         x[i] = dx[i] = px[i];
+         y[i] = dy[i] = py[i];
+         z[i] = dz[i] = pz[i];
+      }
+      transformation[n]->Transform(N, x, y, z);
+      transformation[n]->Displacement(N, dx, dy, dz);
+
+      // Batch and per-point evaluation agree for every point
+      for (int i = 0; i < N; i++) {
+         double a = px[i], b = py[i], c = pz[i];
+         transformation[n]->Transform(a, b, c);
+         ASSERT_NEAR(a, x[i], EPSILON);
+         ASSERT_NEAR(b, y[i], EPSILON);
+         ASSERT_NEAR(c, z[i], EPSILON);
+
+         a = px[i];
+         b = py[i];
+         c = pz[i];
+         transformation[n]->Displacement(a, b, c);
+         ASSERT_NEAR(a, dx[i], EPSILON);
+         ASSERT_NEAR(b, dy[i], EPSILON);
+         ASSERT_NEAR(c, dz[i], EPSILON);
+      }
+   }
+}